@@ -0,0 +1,134 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// compare rebuilding a namespace entry by entry against restoring it from a checkpoint image.
+// reports building the tree with fskit_mkdir/fskit_mknod, writing the image, and restoring it into a new core.
+// usage: bench-checkpoint [NUM_DIRS [FILES_PER_DIR [IMAGE_PATH]]]
+// (the default is 1M entries; bench-checkpoint 10000 1000 makes 10M, which needs several GB of RAM)
+
+#include "bench-checkpoint.h"
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_core* restored = NULL;
+   uint64_t num_dirs = fskit_bench_arg( argc, argv, 1, 1000 );
+   uint64_t files_per_dir = fskit_bench_arg( argc, argv, 2, 1000 );
+   uint64_t num_entries = num_dirs * (files_per_dir + 1);
+   char image_path[PATH_MAX];
+   char path[PATH_MAX];
+   struct stat sb;
+   double start = 0, stop = 0;
+   int rc = 0;
+
+   if( argc > 3 ) {
+      snprintf( image_path, PATH_MAX, "%s", argv[3] );
+   }
+   else {
+      snprintf( image_path, PATH_MAX, "/tmp/bench-checkpoint-%d.img", getpid() );
+   }
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   printf("entries: %" PRIu64 " (%" PRIu64 " dirs x %" PRIu64 " files)\n", num_entries, num_dirs, files_per_dir );
+
+   // build it the slow way
+   start = fskit_bench_now();
+
+   for( uint64_t i = 0; i < num_dirs; i++ ) {
+
+      snprintf( path, PATH_MAX, "/d%" PRIu64, i );
+
+      rc = fskit_bench_populate_dir( core, path, files_per_dir );
+      if( rc != 0 ) {
+         exit(1);
+      }
+   }
+
+   stop = fskit_bench_now();
+
+   printf("mkdir/mknod:  %.3f s (%.0f entries/s)\n", stop - start, num_entries / (stop - start) );
+
+   // checkpoint
+   start = fskit_bench_now();
+
+   rc = fskit_core_checkpoint( core, image_path );
+
+   stop = fskit_bench_now();
+
+   if( rc != 0 ) {
+      fskit_error("fskit_core_checkpoint('%s') rc = %d\n", image_path, rc );
+      exit(1);
+   }
+
+   if( stat( image_path, &sb ) != 0 ) {
+      exit(1);
+   }
+
+   printf("checkpoint:   %.3f s (%.0f entries/s, %.1f MB image)\n", stop - start, num_entries / (stop - start), sb.st_size / 1048576.0 );
+
+   // restore into a new core
+   restored = fskit_core_new();
+   if( restored == NULL ) {
+      exit(1);
+   }
+
+   rc = fskit_core_init( restored, NULL );
+   if( rc != 0 ) {
+      fskit_error("fskit_core_init rc = %d\n", rc );
+      exit(1);
+   }
+
+   start = fskit_bench_now();
+
+   rc = fskit_core_restore( restored, image_path );
+
+   stop = fskit_bench_now();
+
+   if( rc != 0 ) {
+      fskit_error("fskit_core_restore('%s') rc = %d\n", image_path, rc );
+      exit(1);
+   }
+
+   printf("restore:      %.3f s (%.0f entries/s)\n", stop - start, num_entries / (stop - start) );
+
+   // spot-check it
+   snprintf( path, PATH_MAX, "/d%" PRIu64 "/f%" PRIu64, num_dirs - 1, files_per_dir - 1 );
+
+   rc = fskit_stat( restored, path, 0, 0, &sb );
+   if( rc != 0 || !S_ISREG( sb.st_mode ) ) {
+      fskit_error("fskit_stat('%s') rc = %d\n", path, rc );
+      exit(1);
+   }
+
+   unlink( image_path );
+
+   fskit_detach_all( restored, "/" );
+   fskit_core_destroy( restored, NULL );
+   free( restored );
+
+   fskit_bench_end( core );
+
+   return 0;
+}
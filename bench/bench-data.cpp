@@ -0,0 +1,327 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// file data throughput: fskit's paged data routes versus a demo-style store that keeps each file in one
+// realloc-doubled buffer behind FSKIT_SEQUENTIAL read and write routes.
+// each thread fills its own FILE_MB-megabyte file with 4K appends, then does OPS random 4K overwrites and
+// OPS random 4K reads, with 1 and then MAX_THREADS threads.
+// usage: bench-data [FILE_MB [OPS [MAX_THREADS]]]
+
+#include "bench-data.h"
+
+#include <pthread.h>
+
+#define IO_SIZE 4096
+
+// realloc-doubled file, as in demo/fuse-demo.c
+struct realloc_inode {
+   char* buf;
+   size_t capacity;
+   size_t size;
+};
+
+int realloc_create_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, mode_t mode, void** inode_data, void** handle_data ) {
+
+   struct realloc_inode* ri = (struct realloc_inode*)calloc( 1, sizeof(struct realloc_inode) );
+   if( ri == NULL ) {
+      return -ENOMEM;
+   }
+
+   *inode_data = ri;
+   return 0;
+}
+
+int realloc_read_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data ) {
+
+   struct realloc_inode* ri = (struct realloc_inode*)fskit_entry_get_user_data( fent );
+
+   if( (size_t)offset >= ri->size ) {
+      return 0;
+   }
+
+   if( offset + buflen > ri->size ) {
+      buflen = ri->size - offset;
+   }
+
+   memcpy( buf, ri->buf + offset, buflen );
+   return buflen;
+}
+
+int realloc_write_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data ) {
+
+   struct realloc_inode* ri = (struct realloc_inode*)fskit_entry_get_user_data( fent );
+   size_t capacity = (ri->capacity > 0 ? ri->capacity : 1);
+   char* tmp = NULL;
+
+   if( offset + buflen > ri->capacity ) {
+
+      while( capacity < offset + buflen ) {
+         capacity *= 2;
+      }
+
+      tmp = (char*)realloc( ri->buf, capacity );
+      if( tmp == NULL ) {
+         return -ENOMEM;
+      }
+
+      memset( tmp + ri->capacity, 0, capacity - ri->capacity );
+
+      ri->buf = tmp;
+      ri->capacity = capacity;
+   }
+
+   memcpy( ri->buf + offset, buf, buflen );
+
+   if( offset + buflen > ri->size ) {
+      ri->size = offset + buflen;
+   }
+
+   return buflen;
+}
+
+int realloc_destroy_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, void* inode_data ) {
+
+   struct realloc_inode* ri = (struct realloc_inode*)inode_data;
+
+   if( ri != NULL ) {
+      free( ri->buf );
+      free( ri );
+   }
+
+   return 0;
+}
+
+struct bench_io {
+
+   struct fskit_core* core;
+   int id;
+   uint64_t file_size;
+   uint64_t num_ops;
+   pthread_barrier_t* barrier;
+
+   double fill_time;
+   double write_time;
+   double read_time;
+   int rc;
+   pthread_t thread;
+};
+
+static void* bench_io_main( void* arg ) {
+
+   struct bench_io* io = (struct bench_io*)arg;
+   struct fskit_file_handle* fh = NULL;
+   char path[PATH_MAX];
+   char buf[IO_SIZE];
+   unsigned int seed = io->id + 1;
+   off_t offset = 0;
+   double start = 0;
+   ssize_t nr = 0;
+   int rc = 0;
+
+   memset( buf, 'a' + io->id, IO_SIZE );
+   snprintf( path, PATH_MAX, "/file-%d", io->id );
+
+   fh = fskit_open( io->core, path, 0, 0, O_CREAT | O_RDWR, 0644, &rc );
+   if( fh == NULL ) {
+      fskit_error("fskit_open('%s') rc = %d\n", path, rc );
+      io->rc = rc;
+      return NULL;
+   }
+
+   pthread_barrier_wait( io->barrier );
+
+   // fill
+   start = fskit_bench_now();
+
+   for( offset = 0; (uint64_t)offset < io->file_size; offset += IO_SIZE ) {
+
+      nr = fskit_write( io->core, fh, buf, IO_SIZE, offset );
+      if( nr != IO_SIZE ) {
+         fskit_error("fskit_write('%s') rc = %zd\n", path, nr );
+         io->rc = -EIO;
+         break;
+      }
+   }
+
+   io->fill_time = fskit_bench_now() - start;
+
+   pthread_barrier_wait( io->barrier );
+
+   // random overwrites
+   start = fskit_bench_now();
+
+   for( uint64_t i = 0; i < io->num_ops && io->rc == 0; i++ ) {
+
+      offset = (off_t)(rand_r( &seed ) % (io->file_size - IO_SIZE));
+
+      nr = fskit_write( io->core, fh, buf, IO_SIZE, offset );
+      if( nr != IO_SIZE ) {
+         fskit_error("fskit_write('%s') rc = %zd\n", path, nr );
+         io->rc = -EIO;
+      }
+   }
+
+   io->write_time = fskit_bench_now() - start;
+
+   pthread_barrier_wait( io->barrier );
+
+   // random reads
+   start = fskit_bench_now();
+
+   for( uint64_t i = 0; i < io->num_ops && io->rc == 0; i++ ) {
+
+      offset = (off_t)(rand_r( &seed ) % (io->file_size - IO_SIZE));
+
+      nr = fskit_read( io->core, fh, buf, IO_SIZE, offset );
+      if( nr != IO_SIZE ) {
+         fskit_error("fskit_read('%s') rc = %zd\n", path, nr );
+         io->rc = -EIO;
+      }
+   }
+
+   io->read_time = fskit_bench_now() - start;
+
+   fskit_close( io->core, fh );
+
+   rc = fskit_unlink( io->core, path, 0, 0 );
+   if( rc != 0 && io->rc == 0 ) {
+      io->rc = rc;
+   }
+
+   return NULL;
+}
+
+// run num_threads threads, and report each phase's aggregate throughput
+static int bench_io_run( struct fskit_core* core, char const* label, int num_threads, uint64_t file_size, uint64_t num_ops ) {
+
+   struct bench_io* ios = (struct bench_io*)calloc( num_threads, sizeof(struct bench_io) );
+   pthread_barrier_t barrier;
+   double fill_time = 0, write_time = 0, read_time = 0;
+   int rc = 0;
+
+   if( ios == NULL ) {
+      return -ENOMEM;
+   }
+
+   pthread_barrier_init( &barrier, NULL, num_threads );
+
+   for( int i = 0; i < num_threads; i++ ) {
+
+      ios[i].core = core;
+      ios[i].id = i;
+      ios[i].file_size = file_size;
+      ios[i].num_ops = num_ops;
+      ios[i].barrier = &barrier;
+
+      pthread_create( &ios[i].thread, NULL, bench_io_main, &ios[i] );
+   }
+
+   for( int i = 0; i < num_threads; i++ ) {
+
+      pthread_join( ios[i].thread, NULL );
+
+      if( ios[i].rc != 0 ) {
+         rc = ios[i].rc;
+      }
+
+      fill_time = (ios[i].fill_time > fill_time ? ios[i].fill_time : fill_time);
+      write_time = (ios[i].write_time > write_time ? ios[i].write_time : write_time);
+      read_time = (ios[i].read_time > read_time ? ios[i].read_time : read_time);
+   }
+
+   pthread_barrier_destroy( &barrier );
+   free( ios );
+
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   printf("%-8s %2d threads: fill %8.1f MB/s   random write %9.0f ops/s   random read %9.0f ops/s\n",
+          label, num_threads,
+          (double)num_threads * file_size / (1024 * 1024) / fill_time,
+          num_threads * num_ops / write_time,
+          num_threads * num_ops / read_time );
+
+   return 0;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* paged = NULL;
+   struct fskit_core* flat = NULL;
+   uint64_t file_size = fskit_bench_arg( argc, argv, 1, 64 ) * 1024 * 1024;
+   uint64_t num_ops = fskit_bench_arg( argc, argv, 2, 200000 );
+   int max_threads = (int)fskit_bench_arg( argc, argv, 3, 4 );
+   int rc = 0;
+
+   if( file_size < 2 * IO_SIZE ) {
+      file_size = 2 * IO_SIZE;
+   }
+
+   rc = fskit_bench_begin( &paged );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   flat = fskit_core_new();
+   if( flat == NULL ) {
+      exit(1);
+   }
+
+   rc = fskit_core_init( flat, NULL );
+   if( rc != 0 ) {
+      fskit_error("fskit_core_init rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_data_route( paged, FSKIT_ROUTE_ANY );
+   if( rc != 0 ) {
+      fskit_error("fskit_data_route rc = %d\n", rc );
+      exit(1);
+   }
+
+   fskit_route_create( flat, FSKIT_ROUTE_ANY, realloc_create_cb, FSKIT_CONCURRENT );
+   fskit_route_read( flat, FSKIT_ROUTE_ANY, realloc_read_cb, FSKIT_SEQUENTIAL );
+   fskit_route_write( flat, FSKIT_ROUTE_ANY, realloc_write_cb, FSKIT_SEQUENTIAL );
+   fskit_route_destroy( flat, FSKIT_ROUTE_ANY, realloc_destroy_cb, FSKIT_CONCURRENT );
+
+   printf("file size: %" PRIu64 " MB, %" PRIu64 " random ops per thread, %d-byte I/O\n", file_size / (1024 * 1024), num_ops, IO_SIZE );
+
+   for( int num_threads = 1; num_threads <= max_threads; num_threads *= 2 ) {
+
+      rc = bench_io_run( flat, "realloc:", num_threads, file_size, num_ops );
+      if( rc != 0 ) {
+         exit(1);
+      }
+
+      rc = bench_io_run( paged, "paged:", num_threads, file_size, num_ops );
+      if( rc != 0 ) {
+         exit(1);
+      }
+   }
+
+   fskit_detach_all( flat, "/" );
+   fskit_core_destroy( flat, NULL );
+   free( flat );
+
+   fskit_bench_end( paged );
+   return 0;
+}
@@ -0,0 +1,91 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// remove a large directory synchronously (fskit_detach_all), then in the background (fskit_deferred_remove_all).
+// reports how long the caller is blocked in each case, and how long the reapers take to finish.
+// usage: bench-deferred [NUM_ENTRIES [NUM_THREADS]]
+
+#include "bench-deferred.h"
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   uint64_t num_entries = fskit_bench_arg( argc, argv, 1, 1000000 );
+   uint64_t num_threads = fskit_bench_arg( argc, argv, 2, FSKIT_DEFERRED_DEFAULT_THREADS );
+   double start = 0, sync_done = 0, async_start = 0, async_returned = 0, async_done = 0;
+   int rc = 0;
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_deferred_set_threads( core, (int)num_threads );
+   if( rc != 0 ) {
+      fskit_error("fskit_deferred_set_threads rc = %d\n", rc );
+      exit(1);
+   }
+
+   // synchronous
+   rc = fskit_bench_populate_dir( core, "/sync", num_entries );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   start = fskit_bench_now();
+
+   rc = fskit_detach_all( core, "/sync" );
+   if( rc != 0 ) {
+      fskit_error("fskit_detach_all rc = %d\n", rc );
+      exit(1);
+   }
+
+   sync_done = fskit_bench_now();
+
+   // deferred
+   rc = fskit_bench_populate_dir( core, "/async", num_entries );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   async_start = fskit_bench_now();
+
+   rc = fskit_deferred_remove_all( core, "/async", NULL );
+   if( rc != 0 ) {
+      fskit_error("fskit_deferred_remove_all rc = %d\n", rc );
+      exit(1);
+   }
+
+   async_returned = fskit_bench_now();
+
+   fskit_deferred_wait( core );
+
+   async_done = fskit_bench_now();
+
+   printf("entries: %" PRIu64 "\n", num_entries );
+   printf("reapers: %" PRIu64 "\n", num_threads );
+   printf("detach_all: %.3f s\n", sync_done - start );
+   printf("deferred_remove_all: %.1f us to return, %.3f s to reclaim\n", (async_returned - async_start) * 1e6, async_done - async_start );
+
+   fskit_bench_end( core );
+
+   return 0;
+}
@@ -0,0 +1,206 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// tear down a deep tree with fskit_detach_all, with and without a destroy route, and report the
+// time and the peak heap growth per detached entry.  Queued entries only carry full paths when a
+// destroy route needs them, so the no-route run shows what the queue itself costs.
+// usage: bench-detach-queue [DEPTH [FILES_PER_DIR [NAME_LEN]]]
+
+#include "bench-detach-queue.h"
+
+#include <malloc.h>
+
+static volatile int sampling = 0;
+static size_t heap_peak = 0;
+
+// bytes currently malloc'ed
+static size_t heap_used(void) {
+   return mallinfo2().uordblks;
+}
+
+// track the heap high-water mark while the teardown runs
+static void* sampler_main( void* arg ) {
+
+   while( sampling ) {
+
+      size_t used = heap_used();
+      if( used > heap_peak ) {
+         heap_peak = used;
+      }
+
+      usleep( 1000 );
+   }
+
+   return NULL;
+}
+
+// does nothing, but makes fskit build every entry's path
+int destroy_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, void* inode_data ) {
+   return 0;
+}
+
+// build DEPTH nested directories with long names, each holding files_per_dir files
+static int build_tree( struct fskit_core* core, uint64_t depth, uint64_t files_per_dir, uint64_t name_len ) {
+
+   char path[PATH_MAX];
+   char name[NAME_MAX + 1];
+   size_t len = 0;
+   int rc = 0;
+
+   memset( name, 'd', name_len );
+   name[name_len] = 0;
+
+   len = snprintf( path, PATH_MAX, "/tree" );
+
+   rc = fskit_mkdir( core, path, 0755, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   for( uint64_t i = 0; i < depth; i++ ) {
+
+      if( len + name_len + 2 >= PATH_MAX ) {
+         break;
+      }
+
+      len += snprintf( path + len, PATH_MAX - len, "/%s", name );
+
+      rc = fskit_bench_populate_dir( core, path, files_per_dir );
+      if( rc != 0 ) {
+         return rc;
+      }
+   }
+
+   return 0;
+}
+
+// build the tree and detach it, optionally sampling the heap while it goes
+static int detach_tree( struct fskit_core* core, uint64_t depth, uint64_t files_per_dir, uint64_t name_len, bool sample, double* elapsed, size_t* heap_growth ) {
+
+   pthread_t sampler;
+   double start = 0;
+   size_t heap_base = 0;
+   int rc = 0;
+
+   rc = build_tree( core, depth, files_per_dir, name_len );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   heap_base = heap_used();
+   heap_peak = heap_base;
+
+   if( sample ) {
+      sampling = 1;
+      pthread_create( &sampler, NULL, sampler_main, NULL );
+   }
+
+   start = fskit_bench_now();
+
+   rc = fskit_detach_all( core, "/tree" );
+
+   *elapsed = fskit_bench_now() - start;
+
+   if( sample ) {
+      sampling = 0;
+      pthread_join( sampler, NULL );
+   }
+
+   *heap_growth = heap_peak - heap_base;
+
+   if( rc != 0 ) {
+      fskit_error("fskit_detach_all rc = %d\n", rc );
+      return rc;
+   }
+
+   rc = fskit_rmdir( core, "/tree", 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_rmdir rc = %d\n", rc );
+      return rc;
+   }
+
+   return 0;
+}
+
+// time one teardown, then measure another's heap use (the sampler perturbs the timing)
+static int run( struct fskit_core* core, char const* label, uint64_t depth, uint64_t files_per_dir, uint64_t name_len ) {
+
+   uint64_t num_entries = depth * (files_per_dir + 1);
+   double elapsed = 0, unused = 0;
+   size_t heap_growth = 0;
+   int rc = 0;
+
+   rc = detach_tree( core, depth, files_per_dir, name_len, false, &elapsed, &heap_growth );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   rc = detach_tree( core, depth, files_per_dir, name_len, true, &unused, &heap_growth );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   // the queue peaks at about one directory's worth of files
+   printf("%-14s detach: %.3f s (%.0f ns/entry)  peak heap growth: %zu bytes (%.1f bytes/queued entry)\n",
+          label, elapsed, elapsed * 1e9 / num_entries, heap_growth, (double)heap_growth / (files_per_dir + 1) );
+
+   return 0;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   uint64_t depth = fskit_bench_arg( argc, argv, 1, 16 );
+   uint64_t files_per_dir = fskit_bench_arg( argc, argv, 2, 65536 );
+   uint64_t name_len = fskit_bench_arg( argc, argv, 3, 200 );
+   int rc = 0;
+
+   if( name_len == 0 || name_len > NAME_MAX ) {
+      name_len = NAME_MAX;
+   }
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   printf("entries: %" PRIu64 " (%" PRIu64 " levels x %" PRIu64 " files, %" PRIu64 "-byte directory names)\n", depth * (files_per_dir + 1), depth, files_per_dir, name_len );
+
+   rc = run( core, "no route:", depth, files_per_dir, name_len );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_route_destroy( core, FSKIT_ROUTE_ANY, destroy_cb, FSKIT_CONCURRENT );
+   if( rc < 0 ) {
+      exit(1);
+   }
+
+   rc = run( core, "destroy route:", depth, files_per_dir, name_len );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   fskit_bench_end( core );
+
+   return 0;
+}
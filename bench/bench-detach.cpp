@@ -0,0 +1,155 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// tear down a wide tree with fskit_detach_all_ex, using 1, 2, 4, ... MAX_THREADS threads.
+// each file carries an app buffer that its destroy route frees, so the routes do real work.
+// usage: bench-detach [NUM_DIRS [FILES_PER_DIR [MAX_THREADS [BUFFER_SIZE]]]]
+
+#include "bench-detach.h"
+
+static uint64_t buffer_size = 0;
+
+// give each new file an app buffer
+int mknod_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, mode_t mode, dev_t dev, void** inode_data ) {
+
+   char* buf = (char*)malloc( buffer_size );
+   if( buf == NULL ) {
+      return -ENOMEM;
+   }
+
+   memset( buf, 0x5a, buffer_size );
+   *inode_data = buf;
+   return 0;
+}
+
+// ...and free it on destroy
+int destroy_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, void* inode_data ) {
+
+   free( inode_data );
+   return 0;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_detach_ctx* ctx = NULL;
+   struct fskit_entry* dent = NULL;
+   fskit_entry_set* children = NULL;
+   uint64_t num_dirs = fskit_bench_arg( argc, argv, 1, 64 );
+   uint64_t files_per_dir = fskit_bench_arg( argc, argv, 2, 4096 );
+   uint64_t max_threads = fskit_bench_arg( argc, argv, 3, 16 );
+   char path[PATH_MAX];
+   double start = 0, stop = 0, base = 0;
+   int rc = 0;
+
+   buffer_size = fskit_bench_arg( argc, argv, 4, 4096 );
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_route_mknod( core, FSKIT_ROUTE_ANY, mknod_cb, FSKIT_CONCURRENT );
+   if( rc < 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_route_destroy( core, FSKIT_ROUTE_ANY, destroy_cb, FSKIT_CONCURRENT );
+   if( rc < 0 ) {
+      exit(1);
+   }
+
+   printf("entries: %" PRIu64 " (%" PRIu64 " dirs x %" PRIu64 " files, %" PRIu64 "-byte buffers)\n", num_dirs * files_per_dir, num_dirs, files_per_dir, buffer_size );
+
+   for( uint64_t num_threads = 1; num_threads <= max_threads; num_threads *= 2 ) {
+
+      rc = fskit_mkdir( core, "/tree", 0755, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mkdir rc = %d\n", rc );
+         exit(1);
+      }
+
+      for( uint64_t i = 0; i < num_dirs; i++ ) {
+
+         snprintf( path, PATH_MAX, "/tree/d%" PRIu64, i );
+
+         rc = fskit_bench_populate_dir( core, path, files_per_dir );
+         if( rc != 0 ) {
+            exit(1);
+         }
+      }
+
+      // same steps as fskit_detach_all, but with a multi-threaded context
+      dent = fskit_entry_resolve_path( core, "/tree", 0, 0, true, &rc );
+      if( dent == NULL ) {
+         exit(1);
+      }
+
+      rc = fskit_entry_tag_garbage( dent, &children );
+      fskit_entry_unlock( dent );
+
+      if( rc != 0 ) {
+         exit(1);
+      }
+
+      ctx = fskit_detach_ctx_new();
+      if( ctx == NULL ) {
+         exit(1);
+      }
+
+      fskit_detach_ctx_init( ctx );
+      fskit_detach_ctx_set_threads( ctx, (int)num_threads );
+
+      start = fskit_bench_now();
+
+      rc = fskit_detach_all_ex( core, "/tree", &children, ctx );
+
+      stop = fskit_bench_now();
+
+      if( rc != 0 ) {
+         fskit_error("fskit_detach_all_ex rc = %d\n", rc );
+         exit(1);
+      }
+
+      fskit_entry_set_free( children );
+      children = NULL;
+
+      fskit_detach_ctx_free( ctx );
+      free( ctx );
+
+      // the tagged /tree is still there; unlink it for the next round
+      rc = fskit_rmdir( core, "/tree", 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_rmdir rc = %d\n", rc );
+         exit(1);
+      }
+
+      if( num_threads == 1 ) {
+         base = stop - start;
+      }
+
+      printf("threads: %2" PRIu64 "  detach: %.3f s (%.0f entries/s, speedup %.2fx)\n", num_threads, stop - start, num_dirs * files_per_dir / (stop - start), base / (stop - start) );
+   }
+
+   fskit_bench_end( core );
+
+   return 0;
+}
@@ -0,0 +1,681 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// end-to-end FUSE benchmark: mounts a fskit_fuse filesystem (such as demo/fuse-demo) on a temporary
+// mountpoint, then runs fio-like data jobs and metadata jobs against it from NUM_PROCS processes at once.
+// data jobs: each process writes FILE_MB megabytes sequentially in 128K blocks, reads them back, and then does
+// NUM_OPS random 4K overwrites and NUM_OPS random 4K reads.  Files are reopened for each job, and fskit_fuse
+// doesn't keep the page cache across opens, so reads go to the daemon.
+// metadata jobs: each process creates, stats, lists (16 times), and unlinks NUM_FILES files in its own directory.
+// for each job, reports ops/s and MB/s, latency percentiles, and the daemon's CPU time, as JSON on stdout.
+// the filesystem is unmounted with fusermount (or umount, as root) when the jobs finish or fail.
+// usage: bench-fuse FUSE_FS [NUM_PROCS [FILE_MB [NUM_OPS [NUM_FILES]]]]
+
+#include "bench-fuse.h"
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/wait.h>
+
+#define SEQ_IO_SIZE     (128 * 1024)
+#define RAND_IO_SIZE    4096
+#define READDIR_PASSES  16
+
+struct bench_fuse_ctx {
+
+   char mountpoint[PATH_MAX];
+   uint64_t file_size;
+   uint64_t num_ops;
+   uint64_t num_files;
+};
+
+// one process's share of a job.  Lives in memory shared with the parent.
+struct bench_fuse_result {
+
+   int rc;
+   uint64_t num_ops;
+   uint64_t bytes;
+};
+
+typedef int (*bench_fuse_job_func)( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat );
+
+struct bench_fuse_job {
+
+   char const* name;
+   bench_fuse_job_func run;
+};
+
+// time one operation into lat[res->num_ops]
+#define BENCH_FUSE_TIMED( res, lat, op ) \
+   do { \
+      double _start = fskit_bench_now(); \
+      op; \
+      (lat)[(res)->num_ops] = (uint64_t)((fskit_bench_now() - _start) * 1e9); \
+      (res)->num_ops++; \
+   } while( 0 )
+
+// path is PATH_MAX bytes.  return -ENAMETOOLONG rather than use a truncated path.
+static int bench_fuse_file_path( struct bench_fuse_ctx* ctx, int proc, char* path ) {
+   return snprintf( path, PATH_MAX, "%s/p%d", ctx->mountpoint, proc ) < PATH_MAX ? 0 : -ENAMETOOLONG;
+}
+
+static int bench_fuse_dir_path( struct bench_fuse_ctx* ctx, int proc, char* path ) {
+   return snprintf( path, PATH_MAX, "%s/d%d", ctx->mountpoint, proc ) < PATH_MAX ? 0 : -ENAMETOOLONG;
+}
+
+static int bench_fuse_dir_file_path( char const* dir, uint64_t i, char* path ) {
+   return snprintf( path, PATH_MAX, "%s/f%" PRIu64, dir, i ) < PATH_MAX ? 0 : -ENAMETOOLONG;
+}
+
+// sequential I/O over the whole file
+static int bench_fuse_seq( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat, bool write ) {
+
+   char path[PATH_MAX];
+   char* buf = NULL;
+   ssize_t nr = 0;
+   int fd = -1;
+   int rc = 0;
+
+   rc = bench_fuse_file_path( ctx, proc, path );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   buf = (char*)malloc( SEQ_IO_SIZE );
+   if( buf == NULL ) {
+      return -ENOMEM;
+   }
+
+   memset( buf, proc, SEQ_IO_SIZE );
+
+   fd = open( path, write ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY, 0644 );
+   if( fd < 0 ) {
+      free( buf );
+      return -errno;
+   }
+
+   for( uint64_t off = 0; off < ctx->file_size; off += SEQ_IO_SIZE ) {
+
+      if( write ) {
+         BENCH_FUSE_TIMED( res, lat, nr = pwrite( fd, buf, SEQ_IO_SIZE, off ) );
+      }
+      else {
+         BENCH_FUSE_TIMED( res, lat, nr = pread( fd, buf, SEQ_IO_SIZE, off ) );
+      }
+
+      if( nr != SEQ_IO_SIZE ) {
+         res->rc = (nr < 0 ? -errno : -EIO);
+         break;
+      }
+
+      res->bytes += nr;
+   }
+
+   close( fd );
+   free( buf );
+   return res->rc;
+}
+
+// random block-aligned I/O within the file
+static int bench_fuse_rand( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat, bool write ) {
+
+   char path[PATH_MAX];
+   char buf[RAND_IO_SIZE];
+   uint64_t num_blocks = ctx->file_size / RAND_IO_SIZE;
+   unsigned int seed = (unsigned int)proc + 1;
+   off_t off = 0;
+   ssize_t nr = 0;
+   int fd = -1;
+   int rc = 0;
+
+   rc = bench_fuse_file_path( ctx, proc, path );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   memset( buf, proc, RAND_IO_SIZE );
+
+   fd = open( path, write ? O_WRONLY : O_RDONLY );
+   if( fd < 0 ) {
+      return -errno;
+   }
+
+   for( uint64_t i = 0; i < ctx->num_ops; i++ ) {
+
+      off = (off_t)(rand_r( &seed ) % num_blocks) * RAND_IO_SIZE;
+
+      if( write ) {
+         BENCH_FUSE_TIMED( res, lat, nr = pwrite( fd, buf, RAND_IO_SIZE, off ) );
+      }
+      else {
+         BENCH_FUSE_TIMED( res, lat, nr = pread( fd, buf, RAND_IO_SIZE, off ) );
+      }
+
+      if( nr != RAND_IO_SIZE ) {
+         res->rc = (nr < 0 ? -errno : -EIO);
+         break;
+      }
+
+      res->bytes += nr;
+   }
+
+   close( fd );
+   return res->rc;
+}
+
+static int bench_fuse_seq_write( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat ) {
+   return bench_fuse_seq( ctx, proc, res, lat, true );
+}
+
+static int bench_fuse_seq_read( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat ) {
+   return bench_fuse_seq( ctx, proc, res, lat, false );
+}
+
+static int bench_fuse_rand_write( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat ) {
+   return bench_fuse_rand( ctx, proc, res, lat, true );
+}
+
+static int bench_fuse_rand_read( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat ) {
+   return bench_fuse_rand( ctx, proc, res, lat, false );
+}
+
+static int bench_fuse_create( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat ) {
+
+   char dir[PATH_MAX];
+   char path[PATH_MAX];
+   int fd = -1;
+   int rc = 0;
+
+   rc = bench_fuse_dir_path( ctx, proc, dir );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   if( mkdir( dir, 0755 ) != 0 ) {
+      return -errno;
+   }
+
+   for( uint64_t i = 0; i < ctx->num_files; i++ ) {
+
+      res->rc = bench_fuse_dir_file_path( dir, i, path );
+      if( res->rc != 0 ) {
+         break;
+      }
+
+      BENCH_FUSE_TIMED( res, lat, fd = open( path, O_WRONLY | O_CREAT | O_EXCL, 0644 ); if( fd >= 0 ) close( fd ) );
+
+      if( fd < 0 ) {
+         res->rc = -errno;
+         break;
+      }
+   }
+
+   return res->rc;
+}
+
+static int bench_fuse_stat( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat ) {
+
+   char dir[PATH_MAX];
+   char path[PATH_MAX];
+   struct stat sb;
+   int rc = 0;
+
+   rc = bench_fuse_dir_path( ctx, proc, dir );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   for( uint64_t i = 0; i < ctx->num_files; i++ ) {
+
+      res->rc = bench_fuse_dir_file_path( dir, i, path );
+      if( res->rc != 0 ) {
+         break;
+      }
+
+      BENCH_FUSE_TIMED( res, lat, rc = stat( path, &sb ) );
+
+      if( rc != 0 ) {
+         res->rc = -errno;
+         break;
+      }
+   }
+
+   return res->rc;
+}
+
+static int bench_fuse_readdir( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat ) {
+
+   char dir[PATH_MAX];
+   DIR* dh = NULL;
+   uint64_t num_entries = 0;
+   int rc = 0;
+
+   rc = bench_fuse_dir_path( ctx, proc, dir );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   for( int i = 0; i < READDIR_PASSES; i++ ) {
+
+      num_entries = 0;
+
+      BENCH_FUSE_TIMED( res, lat, dh = opendir( dir ); if( dh != NULL ) { while( readdir( dh ) != NULL ) num_entries++; closedir( dh ); } );
+
+      if( dh == NULL ) {
+         res->rc = -errno;
+         break;
+      }
+
+      // . and .., plus each file
+      if( num_entries != ctx->num_files + 2 ) {
+         res->rc = -EIO;
+         break;
+      }
+   }
+
+   return res->rc;
+}
+
+static int bench_fuse_unlink( struct bench_fuse_ctx* ctx, int proc, struct bench_fuse_result* res, uint64_t* lat ) {
+
+   char dir[PATH_MAX];
+   char path[PATH_MAX];
+   int rc = 0;
+
+   rc = bench_fuse_dir_path( ctx, proc, dir );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   for( uint64_t i = 0; i < ctx->num_files; i++ ) {
+
+      res->rc = bench_fuse_dir_file_path( dir, i, path );
+      if( res->rc != 0 ) {
+         break;
+      }
+
+      BENCH_FUSE_TIMED( res, lat, rc = unlink( path ) );
+
+      if( rc != 0 ) {
+         res->rc = -errno;
+         break;
+      }
+   }
+
+   if( res->rc == 0 && rmdir( dir ) != 0 ) {
+      res->rc = -errno;
+   }
+
+   return res->rc;
+}
+
+// in order.  Each job leaves behind what the next one needs.
+static struct bench_fuse_job bench_fuse_jobs[] = {
+   { "seq_write",  bench_fuse_seq_write },
+   { "seq_read",   bench_fuse_seq_read },
+   { "rand_write", bench_fuse_rand_write },
+   { "rand_read",  bench_fuse_rand_read },
+   { "create",     bench_fuse_create },
+   { "stat",       bench_fuse_stat },
+   { "readdir",    bench_fuse_readdir },
+   { "unlink",     bench_fuse_unlink },
+};
+
+#define BENCH_FUSE_NUM_JOBS (sizeof(bench_fuse_jobs) / sizeof(bench_fuse_jobs[0]))
+
+// CPU time used so far by a process (user + system), in seconds
+static double bench_fuse_cpu_time( pid_t pid ) {
+
+   char path[64];
+   char buf[1024];
+   char* p = NULL;
+   unsigned long utime = 0, stime = 0;
+   ssize_t len = 0;
+   int fd = -1;
+
+   snprintf( path, sizeof(path), "/proc/%d/stat", (int)pid );
+
+   fd = open( path, O_RDONLY );
+   if( fd < 0 ) {
+      return 0;
+   }
+
+   len = read( fd, buf, sizeof(buf) - 1 );
+   close( fd );
+
+   if( len <= 0 ) {
+      return 0;
+   }
+
+   buf[len] = 0;
+
+   // skip past the command name, which may contain spaces.  utime and stime are fields 14 and 15.
+   p = strrchr( buf, ')' );
+   if( p == NULL || sscanf( p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime ) != 2 ) {
+      return 0;
+   }
+
+   return (double)(utime + stime) / sysconf( _SC_CLK_TCK );
+}
+
+static int bench_fuse_cmp( void const* a, void const* b ) {
+
+   uint64_t x = *(uint64_t const*)a;
+   uint64_t y = *(uint64_t const*)b;
+
+   return (x > y) - (x < y);
+}
+
+// p-th percentile of a sorted array, in microseconds
+static double bench_fuse_percentile( uint64_t* lat, uint64_t n, double p ) {
+
+   if( n == 0 ) {
+      return 0;
+   }
+
+   return lat[ (uint64_t)(p / 100 * (n - 1)) ] / 1e3;
+}
+
+// run a job in num_procs processes at once, and print its JSON record
+static int bench_fuse_run_job( struct bench_fuse_ctx* ctx, struct bench_fuse_job* job, int num_procs, uint64_t max_ops, pid_t daemon_pid, bool last ) {
+
+   struct bench_fuse_result* results = NULL;
+   uint64_t* lat = NULL;
+   uint64_t* all_lat = NULL;
+   uint64_t total_ops = 0, total_bytes = 0;
+   size_t results_len = sizeof(struct bench_fuse_result) * num_procs;
+   size_t lat_len = sizeof(uint64_t) * num_procs * max_ops;
+   double start = 0, elapsed = 0, cpu_start = 0, cpu = 0;
+   pid_t* pids = NULL;
+   int gate[2];
+   int status = 0;
+   int rc = 0;
+   char c = 0;
+
+   results = (struct bench_fuse_result*)mmap( NULL, results_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+   lat = (uint64_t*)mmap( NULL, lat_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+   pids = (pid_t*)calloc( num_procs, sizeof(pid_t) );
+
+   if( results == MAP_FAILED || lat == MAP_FAILED || pids == NULL ) {
+      return -ENOMEM;
+   }
+
+   if( pipe( gate ) != 0 ) {
+      return -errno;
+   }
+
+   for( int i = 0; i < num_procs; i++ ) {
+
+      pids[i] = fork();
+      if( pids[i] < 0 ) {
+         rc = -errno;
+         fskit_error("fork rc = %d\n", rc );
+         break;
+      }
+
+      if( pids[i] == 0 ) {
+
+         // wait for the parent to close the gate's write end, so all processes start together
+         close( gate[1] );
+         while( read( gate[0], &c, 1 ) > 0 );
+
+         job->run( ctx, i, &results[i], lat + i * max_ops );
+         _exit( 0 );
+      }
+   }
+
+   cpu_start = bench_fuse_cpu_time( daemon_pid );
+   start = fskit_bench_now();
+
+   close( gate[0] );
+   close( gate[1] );
+
+   for( int i = 0; i < num_procs; i++ ) {
+
+      if( pids[i] <= 0 ) {
+         continue;
+      }
+
+      waitpid( pids[i], &status, 0 );
+
+      if( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 ) {
+         rc = -ECHILD;
+      }
+   }
+
+   elapsed = fskit_bench_now() - start;
+   cpu = bench_fuse_cpu_time( daemon_pid ) - cpu_start;
+
+   // gather latencies
+   all_lat = (uint64_t*)calloc( num_procs * max_ops + 1, sizeof(uint64_t) );
+   if( all_lat == NULL ) {
+      rc = -ENOMEM;
+   }
+
+   for( int i = 0; i < num_procs && rc == 0; i++ ) {
+
+      if( results[i].rc != 0 ) {
+         fskit_error("%s: process %d rc = %d\n", job->name, i, results[i].rc );
+         rc = results[i].rc;
+         break;
+      }
+
+      memcpy( all_lat + total_ops, lat + i * max_ops, results[i].num_ops * sizeof(uint64_t) );
+
+      total_ops += results[i].num_ops;
+      total_bytes += results[i].bytes;
+   }
+
+   if( rc == 0 ) {
+
+      qsort( all_lat, total_ops, sizeof(uint64_t), bench_fuse_cmp );
+
+      printf("    { \"name\": \"%s\", \"ops\": %" PRIu64 ", \"seconds\": %.6f, \"ops_per_sec\": %.1f, \"mb_per_sec\": %.2f, ",
+             job->name, total_ops, elapsed, total_ops / elapsed, total_bytes / elapsed / (1024 * 1024) );
+
+      printf("\"latency_us\": { \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p99.9\": %.1f, \"max\": %.1f }, ",
+             bench_fuse_percentile( all_lat, total_ops, 50 ), bench_fuse_percentile( all_lat, total_ops, 90 ),
+             bench_fuse_percentile( all_lat, total_ops, 99 ), bench_fuse_percentile( all_lat, total_ops, 99.9 ),
+             bench_fuse_percentile( all_lat, total_ops, 100 ) );
+
+      printf("\"daemon_cpu_sec\": %.3f, \"daemon_cpu_us_per_op\": %.2f }%s\n",
+             cpu, (total_ops > 0 ? cpu * 1e6 / total_ops : 0), (last ? "" : ",") );
+
+      fflush( stdout );
+   }
+
+   free( all_lat );
+   free( pids );
+   munmap( lat, lat_len );
+   munmap( results, results_len );
+
+   return rc;
+}
+
+// start the filesystem in the foreground on mountpoint, and wait up to 10 seconds for it to appear
+static pid_t bench_fuse_mount( char const* fs_path, char const* mountpoint ) {
+
+   struct stat before, after;
+   pid_t pid = 0;
+   int status = 0;
+
+   if( stat( mountpoint, &before ) != 0 ) {
+      return -errno;
+   }
+
+   pid = fork();
+   if( pid < 0 ) {
+      return -errno;
+   }
+
+   if( pid == 0 ) {
+
+      execl( fs_path, fs_path, "-f", mountpoint, (char*)NULL );
+
+      fprintf( stderr, "exec %s: %s\n", fs_path, strerror( errno ) );
+      _exit( 1 );
+   }
+
+   for( int i = 0; i < 1000; i++ ) {
+
+      if( waitpid( pid, &status, WNOHANG ) == pid ) {
+
+         fskit_error("%s exited before mounting (status %d)\n", fs_path, status );
+         return -ENODEV;
+      }
+
+      if( stat( mountpoint, &after ) == 0 && after.st_dev != before.st_dev ) {
+         return pid;
+      }
+
+      usleep( 10000 );
+   }
+
+   fskit_error("%s did not mount %s\n", fs_path, mountpoint );
+   kill( pid, SIGTERM );
+   waitpid( pid, &status, 0 );
+
+   return -ETIMEDOUT;
+}
+
+// unmount, and wait for the filesystem to exit
+static int bench_fuse_unmount( pid_t pid, char const* mountpoint ) {
+
+   char const* helpers[] = { "fusermount3", "fusermount" };
+   int status = 0;
+   pid_t helper = 0;
+
+   if( umount( mountpoint ) != 0 ) {
+
+      // not root.  Ask the setuid helper.
+      for( size_t i = 0; i < sizeof(helpers) / sizeof(helpers[0]); i++ ) {
+
+         helper = fork();
+         if( helper == 0 ) {
+
+            execlp( helpers[i], helpers[i], "-u", mountpoint, (char*)NULL );
+            _exit( 127 );
+         }
+
+         if( helper > 0 && waitpid( helper, &status, 0 ) == helper && WIFEXITED( status ) && WEXITSTATUS( status ) == 0 ) {
+            break;
+         }
+      }
+   }
+
+   for( int i = 0; i < 1000; i++ ) {
+
+      if( waitpid( pid, &status, WNOHANG ) == pid ) {
+         return 0;
+      }
+
+      usleep( 10000 );
+   }
+
+   fskit_error("filesystem %d did not exit after unmounting %s\n", (int)pid, mountpoint );
+   kill( pid, SIGKILL );
+   waitpid( pid, &status, 0 );
+
+   return -ETIMEDOUT;
+}
+
+int main( int argc, char** argv ) {
+
+   struct bench_fuse_ctx ctx;
+   char const* fs_path = NULL;
+   uint64_t num_procs = fskit_bench_arg( argc, argv, 2, 4 );
+   uint64_t file_mb = fskit_bench_arg( argc, argv, 3, 64 );
+   uint64_t max_ops = 0;
+   pid_t daemon_pid = 0;
+   int rc = 0;
+
+   if( argc < 2 ) {
+      fprintf( stderr, "Usage: %s FUSE_FS [NUM_PROCS [FILE_MB [NUM_OPS [NUM_FILES]]]]\n", argv[0] );
+      exit(1);
+   }
+
+   fs_path = argv[1];
+
+   memset( &ctx, 0, sizeof(struct bench_fuse_ctx) );
+
+   ctx.file_size = (file_mb > 0 ? file_mb : 1) * 1024 * 1024;
+   ctx.num_ops = fskit_bench_arg( argc, argv, 4, 20000 );
+   ctx.num_files = fskit_bench_arg( argc, argv, 5, 10000 );
+
+   if( num_procs == 0 ) {
+      num_procs = 1;
+   }
+
+   // room for the longest job's latencies
+   max_ops = ctx.file_size / SEQ_IO_SIZE;
+   if( ctx.num_ops > max_ops ) {
+      max_ops = ctx.num_ops;
+   }
+   if( ctx.num_files > max_ops ) {
+      max_ops = ctx.num_files;
+   }
+   if( READDIR_PASSES > max_ops ) {
+      max_ops = READDIR_PASSES;
+   }
+
+   snprintf( ctx.mountpoint, PATH_MAX, "/tmp/fskit-bench-fuse-XXXXXX" );
+   if( mkdtemp( ctx.mountpoint ) == NULL ) {
+      fskit_error("mkdtemp rc = %d\n", -errno );
+      exit(1);
+   }
+
+   daemon_pid = bench_fuse_mount( fs_path, ctx.mountpoint );
+   if( daemon_pid < 0 ) {
+      rmdir( ctx.mountpoint );
+      exit(1);
+   }
+
+   printf("{\n");
+   printf("  \"benchmark\": \"fuse\",\n");
+   printf("  \"filesystem\": \"%s\",\n", fs_path );
+   printf("  \"procs\": %" PRIu64 ",\n", num_procs );
+   printf("  \"file_mb\": %" PRIu64 ",\n", ctx.file_size / (1024 * 1024) );
+   printf("  \"rand_ops\": %" PRIu64 ",\n", ctx.num_ops );
+   printf("  \"files\": %" PRIu64 ",\n", ctx.num_files );
+   printf("  \"jobs\": [\n");
+
+   for( size_t j = 0; j < BENCH_FUSE_NUM_JOBS; j++ ) {
+
+      rc = bench_fuse_run_job( &ctx, &bench_fuse_jobs[j], (int)num_procs, max_ops, daemon_pid, j + 1 == BENCH_FUSE_NUM_JOBS );
+      if( rc != 0 ) {
+         fskit_error("job %s rc = %d\n", bench_fuse_jobs[j].name, rc );
+         break;
+      }
+   }
+
+   printf("  ]\n");
+   printf("}\n");
+
+   if( bench_fuse_unmount( daemon_pid, ctx.mountpoint ) != 0 ) {
+      rc = -EBUSY;
+   }
+
+   rmdir( ctx.mountpoint );
+
+   return (rc == 0 ? 0 : 1);
+}
@@ -0,0 +1,203 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// measure what the per-inode and per-handle locks cost: heap bytes per inode, the
+// uncontended lock/unlock round trip, and throughput when threads share a few hot inodes.
+// with LOCKSTAT=1, lock contention profiling is on, and its table is printed at the end.
+// usage: bench-lock [NUM_FILES [ROUNDS [NUM_THREADS [LOCKSTAT]]]]
+
+#include "bench-lock.h"
+
+#include <malloc.h>
+
+#define NUM_HOT 4
+
+struct lock_thread_args {
+   struct fskit_entry** hot;
+   uint64_t ops;
+   int id;
+};
+
+// bytes currently malloc'ed
+static size_t heap_used(void) {
+   return mallinfo2().uordblks;
+}
+
+// mostly read-lock a few shared inodes, and write-lock one every 16th time
+static void* lock_thread_main( void* arg ) {
+
+   struct lock_thread_args* args = (struct lock_thread_args*)arg;
+
+   for( uint64_t i = 0; i < args->ops; i++ ) {
+
+      struct fskit_entry* fent = args->hot[ (i + args->id) % NUM_HOT ];
+
+      if( (i & 15) == 0 ) {
+         fskit_entry_wlock( fent );
+      }
+      else {
+         fskit_entry_rlock( fent );
+      }
+
+      fskit_entry_unlock( fent );
+   }
+
+   return NULL;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   uint64_t num_files = fskit_bench_arg( argc, argv, 1, 100000 );
+   uint64_t rounds = fskit_bench_arg( argc, argv, 2, 20 );
+   uint64_t num_threads = fskit_bench_arg( argc, argv, 3, 4 );
+   uint64_t lockstat = fskit_bench_arg( argc, argv, 4, 0 );
+   struct fskit_entry** ents = NULL;
+   struct fskit_file_handle* fh = NULL;
+   struct lock_thread_args* args = NULL;
+   pthread_t* threads = NULL;
+   char path[PATH_MAX];
+   size_t heap_base = 0;
+   double start = 0, elapsed = 0;
+   int rc = 0;
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   ents = (struct fskit_entry**)calloc( num_files, sizeof(struct fskit_entry*) );
+   threads = (pthread_t*)calloc( num_threads, sizeof(pthread_t) );
+   args = (struct lock_thread_args*)calloc( num_threads, sizeof(struct lock_thread_args) );
+   if( ents == NULL || threads == NULL || args == NULL || num_files < NUM_HOT ) {
+      exit(1);
+   }
+
+   // what an inode costs
+   heap_base = heap_used();
+
+   rc = fskit_bench_populate_dir( core, "/x", num_files );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   printf("files: %" PRIu64 "  heap: %.1f bytes/inode\n", num_files, (double)(heap_used() - heap_base) / num_files );
+
+   fskit_lockstat_set_enabled( lockstat != 0 );
+
+   for( uint64_t i = 0; i < num_files; i++ ) {
+
+      snprintf( path, PATH_MAX, "/x/f%" PRIu64, i );
+
+      ents[i] = fskit_entry_resolve_path( core, path, 0, 0, false, &rc );
+      if( ents[i] == NULL ) {
+         fskit_error("fskit_entry_resolve_path('%s') rc = %d\n", path, rc );
+         exit(1);
+      }
+
+      fskit_entry_unlock( ents[i] );
+   }
+
+   // uncontended, across all inodes
+   start = fskit_bench_now();
+
+   for( uint64_t r = 0; r < rounds; r++ ) {
+      for( uint64_t i = 0; i < num_files; i++ ) {
+
+         fskit_entry_rlock( ents[i] );
+         fskit_entry_unlock( ents[i] );
+      }
+   }
+
+   elapsed = fskit_bench_now() - start;
+   printf("entry rlock+unlock: %.1f ns/op\n", elapsed * 1e9 / (rounds * num_files) );
+
+   start = fskit_bench_now();
+
+   for( uint64_t r = 0; r < rounds; r++ ) {
+      for( uint64_t i = 0; i < num_files; i++ ) {
+
+         fskit_entry_wlock( ents[i] );
+         fskit_entry_unlock( ents[i] );
+      }
+   }
+
+   elapsed = fskit_bench_now() - start;
+   printf("entry wlock+unlock: %.1f ns/op\n", elapsed * 1e9 / (rounds * num_files) );
+
+   // uncontended, on one handle
+   fh = fskit_open( core, "/x/f0", 0, 0, O_RDWR, 0644, &rc );
+   if( fh == NULL ) {
+      fskit_error("fskit_open rc = %d\n", rc );
+      exit(1);
+   }
+
+   start = fskit_bench_now();
+
+   for( uint64_t i = 0; i < rounds * num_files; i++ ) {
+
+      fskit_file_handle_rlock( fh );
+      fskit_file_handle_unlock( fh );
+   }
+
+   elapsed = fskit_bench_now() - start;
+   printf("handle rlock+unlock: %.1f ns/op\n", elapsed * 1e9 / (rounds * num_files) );
+
+   rc = fskit_close( core, fh );
+   if( rc != 0 ) {
+      fskit_error("fskit_close rc = %d\n", rc );
+      exit(1);
+   }
+
+   // contended, on a few hot inodes
+   start = fskit_bench_now();
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      args[i].hot = ents;
+      args[i].ops = rounds * num_files / num_threads;
+      args[i].id = (int)i;
+
+      rc = pthread_create( &threads[i], NULL, lock_thread_main, &args[i] );
+      if( rc != 0 ) {
+         fskit_error("pthread_create rc = %d\n", rc );
+         exit(1);
+      }
+   }
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   elapsed = fskit_bench_now() - start;
+   printf("%" PRIu64 " threads, %d hot inodes: %.1f ns/op\n", num_threads, NUM_HOT, elapsed * 1e9 / (args[0].ops * num_threads) );
+
+   if( lockstat != 0 ) {
+      fskit_lockstat_dump( stdout );
+   }
+
+   free( args );
+   free( threads );
+   free( ents );
+
+   fskit_bench_end( core );
+   return 0;
+}
@@ -0,0 +1,132 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// what a log message costs the thread that logs it: disabled, through the per-thread rings, written
+// synchronously, and through stdio with an fflush each time (how fskit_debug used to log).
+// messages go to /dev/null.
+// usage: bench-log [NUM_MESSAGES [NUM_THREADS]]
+
+#include "bench-log.h"
+
+#define LOG_DISABLED    0
+#define LOG_ASYNC       1
+#define LOG_SYNC        2
+#define LOG_STDIO       3
+
+struct log_thread_args {
+   uint64_t num_messages;
+   int mode;
+   FILE* out;
+};
+
+static void* log_thread_main( void* arg ) {
+
+   struct log_thread_args* args = (struct log_thread_args*)arg;
+
+   for( uint64_t i = 0; i < args->num_messages; i++ ) {
+
+      if( args->mode == LOG_STDIO ) {
+         fprintf( args->out, FSKIT_WHERESTR "message %" PRIu64 " of %" PRIu64 "\n", FSKIT_WHEREARG, "DEBUG", i, args->num_messages );
+         fflush( args->out );
+      }
+      else {
+         fskit_debug( "message %" PRIu64 " of %" PRIu64 "\n", i, args->num_messages );
+      }
+   }
+
+   return NULL;
+}
+
+// log from num_threads threads at once, and return ns per message
+static double run( int mode, uint64_t num_messages, uint64_t num_threads, FILE* out ) {
+
+   pthread_t* threads = (pthread_t*)calloc( num_threads, sizeof(pthread_t) );
+   struct log_thread_args args;
+   double start = 0, elapsed = 0;
+
+   if( threads == NULL ) {
+      exit(1);
+   }
+
+   args.num_messages = num_messages / num_threads;
+   args.mode = mode;
+   args.out = out;
+
+   fskit_set_debug_level( mode == LOG_DISABLED ? 0 : 1 );
+   fskit_log_set_async( mode == LOG_ASYNC );
+
+   start = fskit_bench_now();
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+      pthread_create( &threads[i], NULL, log_thread_main, &args );
+   }
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   elapsed = fskit_bench_now() - start;
+
+   fskit_set_debug_level( 0 );
+   fskit_log_flush();
+
+   free( threads );
+   return elapsed * 1e9 / (args.num_messages * num_threads);
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   uint64_t num_messages = fskit_bench_arg( argc, argv, 1, 1000000 );
+   uint64_t num_threads = fskit_bench_arg( argc, argv, 2, 4 );
+   uint64_t dropped = 0;
+   FILE* out = NULL;
+   int rc = 0;
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   out = fopen( "/dev/null", "w" );
+   if( out == NULL ) {
+      exit(1);
+   }
+
+   fskit_log_set_fd( fileno( out ) );
+
+   printf("messages: %" PRIu64 ", threads: %" PRIu64 "\n", num_messages, num_threads );
+   printf("disabled:     %.1f ns/msg\n", run( LOG_DISABLED, num_messages, num_threads, out ) );
+
+   dropped = fskit_log_get_dropped();
+   printf("async:        %.1f ns/msg", run( LOG_ASYNC, num_messages, num_threads, out ) );
+   printf("  (%" PRIu64 " dropped)\n", fskit_log_get_dropped() - dropped );
+
+   printf("sync:         %.1f ns/msg\n", run( LOG_SYNC, num_messages, num_threads, out ) );
+   printf("stdio+fflush: %.1f ns/msg\n", run( LOG_STDIO, num_messages, num_threads, out ) );
+
+   fskit_log_set_async( true );
+   fskit_log_set_fd( STDERR_FILENO );
+   fclose( out );
+
+   fskit_bench_end( core );
+   return 0;
+}
@@ -0,0 +1,446 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// mdtest-style metadata throughput: NUM_THREADS threads each work on ITEMS_PER_THREAD files through a sequence of phases.
+// files go in a per-thread directory (unique), one directory for all threads (shared), or one directory DEPTH levels down (deep).
+// the phases cover create/stat/unlink in each layout, xattr set/get, readdir of the shared directory, and renames within it.
+// the suite runs ITERATIONS times on an empty core.  Each phase takes as long as its slowest thread.
+// the results are printed to stdout as JSON, so releases can be compared.
+// usage: bench-mdtest [NUM_THREADS [ITEMS_PER_THREAD [DEPTH [ITERATIONS]]]]
+
+#include "bench-mdtest.h"
+
+#include <pthread.h>
+
+#define BENCH_MD_UNIQUE      0
+#define BENCH_MD_SHARED      1
+#define BENCH_MD_DEEP        2
+
+#define BENCH_MD_CREATE      0
+#define BENCH_MD_STAT        1
+#define BENCH_MD_SETXATTR    2
+#define BENCH_MD_GETXATTR    3
+#define BENCH_MD_RENAME      4
+#define BENCH_MD_UNLINK      5
+#define BENCH_MD_READDIR     6
+
+#define BENCH_MD_XATTR_NAME  "user.bench"
+#define BENCH_MD_XATTR_VALUE "0123456789abcdef0123456789abcdef"
+
+struct bench_md_phase {
+
+   char const* name;
+   int op;
+   int layout;
+   char const* prefix;       // name prefix of the files operated on
+   char const* to_prefix;    // renames only: new name prefix
+};
+
+// in order.  Each phase leaves behind what the next one needs.
+static struct bench_md_phase bench_md_phases[] = {
+   { "create_unique",   BENCH_MD_CREATE,   BENCH_MD_UNIQUE, "f", NULL },
+   { "stat_unique",     BENCH_MD_STAT,     BENCH_MD_UNIQUE, "f", NULL },
+   { "setxattr_unique", BENCH_MD_SETXATTR, BENCH_MD_UNIQUE, "f", NULL },
+   { "getxattr_unique", BENCH_MD_GETXATTR, BENCH_MD_UNIQUE, "f", NULL },
+   { "unlink_unique",   BENCH_MD_UNLINK,   BENCH_MD_UNIQUE, "f", NULL },
+   { "create_shared",   BENCH_MD_CREATE,   BENCH_MD_SHARED, "f", NULL },
+   { "stat_shared",     BENCH_MD_STAT,     BENCH_MD_SHARED, "f", NULL },
+   { "readdir_shared",  BENCH_MD_READDIR,  BENCH_MD_SHARED, NULL, NULL },
+   { "rename_shared",   BENCH_MD_RENAME,   BENCH_MD_SHARED, "f", "r" },
+   { "unlink_shared",   BENCH_MD_UNLINK,   BENCH_MD_SHARED, "r", NULL },
+   { "create_deep",     BENCH_MD_CREATE,   BENCH_MD_DEEP,   "f", NULL },
+   { "stat_deep",       BENCH_MD_STAT,     BENCH_MD_DEEP,   "f", NULL },
+   { "unlink_deep",     BENCH_MD_UNLINK,   BENCH_MD_DEEP,   "f", NULL },
+};
+
+#define BENCH_MD_NUM_PHASES (sizeof(bench_md_phases) / sizeof(bench_md_phases[0]))
+
+struct bench_md_worker {
+
+   struct fskit_core* core;
+   int id;
+   uint64_t num_items;
+   char const* deep_dir;
+   struct bench_md_phase* phase;
+   pthread_barrier_t* barrier;
+
+   uint64_t ops;
+   double elapsed;
+   int rc;
+   pthread_t thread;
+};
+
+// path to this worker's j-th file with the given name prefix
+static void bench_md_path( struct bench_md_worker* w, int layout, char const* prefix, uint64_t j, char* path ) {
+
+   switch( layout ) {
+
+      case BENCH_MD_UNIQUE:
+         snprintf( path, PATH_MAX, "/unique/t%d/%s%" PRIu64, w->id, prefix, j );
+         break;
+
+      case BENCH_MD_SHARED:
+         snprintf( path, PATH_MAX, "/shared/t%d.%s%" PRIu64, w->id, prefix, j );
+         break;
+
+      default:
+         snprintf( path, PATH_MAX, "%s/t%d.%s%" PRIu64, w->deep_dir, w->id, prefix, j );
+         break;
+   }
+}
+
+// list the phase's directory once, in batches
+// return the number of entries read, or negative on error
+static int64_t bench_md_readdir( struct bench_md_worker* w, char const* dir_path ) {
+
+   struct fskit_dir_handle* dh = NULL;
+   struct fskit_dir_entry** dents = NULL;
+   uint64_t num_read = 0;
+   int64_t total = 0;
+   int rc = 0;
+
+   dh = fskit_opendir( w->core, dir_path, 0, 0, &rc );
+   if( dh == NULL ) {
+      fskit_error("fskit_opendir('%s') rc = %d\n", dir_path, rc );
+      return rc;
+   }
+
+   while( (dents = fskit_readdir( w->core, dh, 256, &num_read, &rc )) != NULL ) {
+
+      total += num_read;
+      fskit_dir_entry_free_list( dents );
+   }
+
+   if( rc != 0 ) {
+      fskit_error("fskit_readdir('%s') rc = %d\n", dir_path, rc );
+      total = rc;
+   }
+
+   fskit_closedir( w->core, dh );
+   return total;
+}
+
+// run one operation on this worker's j-th file
+static int bench_md_op( struct bench_md_worker* w, uint64_t j ) {
+
+   struct bench_md_phase* phase = w->phase;
+   char path[PATH_MAX];
+   char new_path[PATH_MAX];
+   char value[64];
+   struct stat sb;
+   int rc = 0;
+
+   bench_md_path( w, phase->layout, phase->prefix, j, path );
+
+   switch( phase->op ) {
+
+      case BENCH_MD_CREATE:
+         rc = fskit_mknod( w->core, path, S_IFREG | 0644, 0, 0, 0 );
+         break;
+
+      case BENCH_MD_STAT:
+         rc = fskit_stat( w->core, path, 0, 0, &sb );
+         break;
+
+      case BENCH_MD_SETXATTR:
+         rc = fskit_setxattr( w->core, path, 0, 0, BENCH_MD_XATTR_NAME, BENCH_MD_XATTR_VALUE, strlen(BENCH_MD_XATTR_VALUE), 0 );
+         break;
+
+      case BENCH_MD_GETXATTR:
+         rc = fskit_getxattr( w->core, path, 0, 0, BENCH_MD_XATTR_NAME, value, sizeof(value) );
+         if( rc == (int)strlen(BENCH_MD_XATTR_VALUE) ) {
+            rc = 0;
+         }
+         break;
+
+      case BENCH_MD_RENAME:
+         bench_md_path( w, phase->layout, phase->to_prefix, j, new_path );
+         rc = fskit_rename( w->core, path, new_path, 0, 0 );
+         break;
+
+      case BENCH_MD_UNLINK:
+         rc = fskit_unlink( w->core, path, 0, 0 );
+         break;
+   }
+
+   if( rc != 0 ) {
+      fskit_error("%s('%s') rc = %d\n", phase->name, path, rc );
+   }
+
+   return rc;
+}
+
+static void* bench_md_worker_main( void* arg ) {
+
+   struct bench_md_worker* w = (struct bench_md_worker*)arg;
+   double start = 0;
+   int64_t num_read = 0;
+
+   pthread_barrier_wait( w->barrier );
+
+   start = fskit_bench_now();
+
+   if( w->phase->op == BENCH_MD_READDIR ) {
+
+      num_read = bench_md_readdir( w, w->phase->layout == BENCH_MD_DEEP ? w->deep_dir : "/shared" );
+      if( num_read < 0 ) {
+         w->rc = (int)num_read;
+      }
+      else {
+         w->ops = num_read;
+      }
+   }
+   else {
+
+      for( uint64_t j = 0; j < w->num_items; j++ ) {
+
+         w->rc = bench_md_op( w, j );
+         if( w->rc != 0 ) {
+            break;
+         }
+
+         w->ops++;
+      }
+   }
+
+   w->elapsed = fskit_bench_now() - start;
+   return NULL;
+}
+
+// make the directories the phases expect: /unique/t$i for each thread, /shared, and the deep directory
+static int bench_md_setup( struct fskit_core* core, uint64_t num_threads, uint64_t depth, char* deep_dir ) {
+
+   char path[PATH_MAX];
+   size_t len = 0;
+   int rc = 0;
+
+   rc = fskit_mkdir( core, "/unique", 0755, 0, 0 );
+   if( rc == 0 ) {
+      rc = fskit_mkdir( core, "/shared", 0755, 0, 0 );
+   }
+   if( rc == 0 ) {
+      rc = fskit_mkdir( core, "/deep", 0755, 0, 0 );
+   }
+
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir rc = %d\n", rc );
+      return rc;
+   }
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      snprintf( path, PATH_MAX, "/unique/t%" PRIu64, i );
+
+      rc = fskit_mkdir( core, path, 0755, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mkdir('%s') rc = %d\n", path, rc );
+         return rc;
+      }
+   }
+
+   len = snprintf( deep_dir, PATH_MAX, "/deep" );
+   for( uint64_t i = 0; i < depth; i++ ) {
+
+      len += snprintf( deep_dir + len, PATH_MAX - len, "/d%" PRIu64, i );
+
+      rc = fskit_mkdir( core, deep_dir, 0755, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mkdir('%s') rc = %d\n", deep_dir, rc );
+         return rc;
+      }
+   }
+
+   return 0;
+}
+
+// remove everything bench_md_setup made
+static int bench_md_teardown( struct fskit_core* core ) {
+
+   char const* dirs[] = { "/unique", "/shared", "/deep" };
+   int rc = 0;
+
+   for( size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++ ) {
+
+      rc = fskit_detach_all( core, dirs[i] );
+      if( rc == 0 ) {
+         rc = fskit_rmdir( core, dirs[i], 0, 0 );
+      }
+
+      if( rc != 0 ) {
+         fskit_error("removing %s rc = %d\n", dirs[i], rc );
+         return rc;
+      }
+   }
+
+   return 0;
+}
+
+// run one phase on all workers
+// return the number of operations per second, or negative on error
+static double bench_md_run_phase( struct bench_md_worker* workers, uint64_t num_threads, struct bench_md_phase* phase, uint64_t* ops ) {
+
+   pthread_barrier_t barrier;
+   double elapsed = 0;
+
+   pthread_barrier_init( &barrier, NULL, num_threads );
+
+   *ops = 0;
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      workers[i].phase = phase;
+      workers[i].barrier = &barrier;
+      workers[i].ops = 0;
+      workers[i].elapsed = 0;
+      workers[i].rc = 0;
+
+      pthread_create( &workers[i].thread, NULL, bench_md_worker_main, &workers[i] );
+   }
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      pthread_join( workers[i].thread, NULL );
+
+      if( workers[i].rc != 0 ) {
+         pthread_barrier_destroy( &barrier );
+         return -1;
+      }
+
+      // threads run side by side, so count the slowest one
+      if( workers[i].elapsed > elapsed ) {
+         elapsed = workers[i].elapsed;
+      }
+
+      *ops += workers[i].ops;
+   }
+
+   pthread_barrier_destroy( &barrier );
+
+   return elapsed > 0 ? *ops / elapsed : 0;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct bench_md_worker* workers = NULL;
+   uint64_t num_threads = fskit_bench_arg( argc, argv, 1, 4 );
+   uint64_t num_items = fskit_bench_arg( argc, argv, 2, 10000 );
+   uint64_t depth = fskit_bench_arg( argc, argv, 3, 10 );
+   uint64_t num_iterations = fskit_bench_arg( argc, argv, 4, 3 );
+   uint64_t ops[BENCH_MD_NUM_PHASES];
+   double* rates = NULL;        // rates[phase * num_iterations + iteration]
+   char deep_dir[PATH_MAX];
+   int rc = 0;
+
+   if( num_threads == 0 ) {
+      num_threads = 1;
+   }
+
+   if( num_iterations == 0 ) {
+      num_iterations = 1;
+   }
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   workers = (struct bench_md_worker*)calloc( num_threads, sizeof(struct bench_md_worker) );
+   rates = (double*)calloc( BENCH_MD_NUM_PHASES * num_iterations, sizeof(double) );
+   if( workers == NULL || rates == NULL ) {
+      exit(1);
+   }
+
+   for( uint64_t it = 0; it < num_iterations; it++ ) {
+
+      rc = bench_md_setup( core, num_threads, depth, deep_dir );
+      if( rc != 0 ) {
+         exit(1);
+      }
+
+      for( uint64_t i = 0; i < num_threads; i++ ) {
+
+         workers[i].core = core;
+         workers[i].id = (int)i;
+         workers[i].num_items = num_items;
+         workers[i].deep_dir = deep_dir;
+      }
+
+      for( size_t p = 0; p < BENCH_MD_NUM_PHASES; p++ ) {
+
+         rates[p * num_iterations + it] = bench_md_run_phase( workers, num_threads, &bench_md_phases[p], &ops[p] );
+         if( rates[p * num_iterations + it] < 0 ) {
+            exit(1);
+         }
+      }
+
+      rc = bench_md_teardown( core );
+      if( rc != 0 ) {
+         exit(1);
+      }
+   }
+
+   // report
+   printf("{\n");
+   printf("  \"benchmark\": \"mdtest\",\n");
+   printf("  \"threads\": %" PRIu64 ",\n", num_threads );
+   printf("  \"items_per_thread\": %" PRIu64 ",\n", num_items );
+   printf("  \"depth\": %" PRIu64 ",\n", depth );
+   printf("  \"iterations\": %" PRIu64 ",\n", num_iterations );
+   printf("  \"phases\": [\n");
+
+   for( size_t p = 0; p < BENCH_MD_NUM_PHASES; p++ ) {
+
+      double* r = &rates[p * num_iterations];
+      double min = r[0], max = r[0], sum = 0;
+
+      for( uint64_t it = 0; it < num_iterations; it++ ) {
+
+         sum += r[it];
+
+         if( r[it] < min ) {
+            min = r[it];
+         }
+         if( r[it] > max ) {
+            max = r[it];
+         }
+      }
+
+      printf("    { \"name\": \"%s\", \"ops\": %" PRIu64 ", \"ops_per_sec\": { \"mean\": %.1f, \"min\": %.1f, \"max\": %.1f }, \"samples\": [",
+             bench_md_phases[p].name, ops[p], sum / num_iterations, min, max );
+
+      for( uint64_t it = 0; it < num_iterations; it++ ) {
+         printf("%s%.1f", (it > 0 ? ", " : ""), r[it] );
+      }
+
+      printf("] }%s\n", (p + 1 < BENCH_MD_NUM_PHASES ? "," : "") );
+   }
+
+   printf("  ]\n");
+   printf("}\n");
+
+   free( rates );
+   free( workers );
+
+   fskit_bench_end( core );
+
+   return 0;
+}
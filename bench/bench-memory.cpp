@@ -0,0 +1,232 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// build NUM_FILES empty files in a few tree shapes, and report what each costs per inode, as broken down by
+// fskit_core_memory_report, next to what the heap actually grew by.  The shapes are:
+// * flat: every file in one directory
+// * wide: WIDE_FANOUT files in each of NUM_FILES / WIDE_FANOUT directories
+// * deep: a tree with DEEP_FANOUT entries per directory, with the files at the leaves
+// try NUM_FILES = 10000000 for a large tree (it needs a few GB).
+// usage: bench-memory [NUM_FILES [WIDE_FANOUT [DEEP_FANOUT]]]
+
+#include "bench-memory.h"
+
+#include <malloc.h>
+
+// bytes currently malloc'ed
+static size_t heap_used(void) {
+   return mallinfo2().uordblks;
+}
+
+static int bench_mkdir( struct fskit_core* core, char const* path ) {
+
+   int rc = fskit_mkdir( core, path, 0755, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir('%s') rc = %d\n", path, rc );
+   }
+
+   return rc;
+}
+
+static int bench_mknod( struct fskit_core* core, char const* path ) {
+
+   int rc = fskit_mknod( core, path, S_IFREG | 0644, 0, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mknod('%s') rc = %d\n", path, rc );
+   }
+
+   return rc;
+}
+
+// /wide/d$i/f$j
+static int bench_build_wide( struct fskit_core* core, uint64_t num_files, uint64_t fanout ) {
+
+   char path[PATH_MAX];
+   int rc = 0;
+
+   for( uint64_t i = 0; i < num_files && rc == 0; i++ ) {
+
+      if( i % fanout == 0 ) {
+
+         snprintf( path, PATH_MAX, "/wide/d%" PRIu64, i / fanout );
+         rc = bench_mkdir( core, path );
+         if( rc != 0 ) {
+            break;
+         }
+      }
+
+      snprintf( path, PATH_MAX, "/wide/d%" PRIu64 "/f%" PRIu64, i / fanout, i % fanout );
+      rc = bench_mknod( core, path );
+   }
+
+   return rc;
+}
+
+// file i goes at /deep/d$a/d$b/.../f$z, where a, b, ..., z are the digits of i in base fanout
+static int bench_build_deep( struct fskit_core* core, uint64_t num_files, uint64_t fanout ) {
+
+   char path[PATH_MAX];
+   uint64_t digits[64];
+   int num_digits = 1;
+   uint64_t span = fanout;
+   size_t len = 0;
+   int rc = 0;
+
+   while( span < num_files && num_digits < 64 ) {
+      span *= fanout;
+      num_digits++;
+   }
+
+   for( uint64_t i = 0; i < num_files && rc == 0; i++ ) {
+
+      uint64_t n = i;
+      for( int k = num_digits - 1; k >= 0; k-- ) {
+         digits[k] = n % fanout;
+         n /= fanout;
+      }
+
+      // make each directory on the way down when its first file goes in
+      len = snprintf( path, PATH_MAX, "/deep" );
+      for( int k = 0; k < num_digits - 1; k++ ) {
+
+         len += snprintf( path + len, PATH_MAX - len, "/d%" PRIu64, digits[k] );
+
+         bool first = true;
+         for( int j = k + 1; j < num_digits; j++ ) {
+            if( digits[j] != 0 ) {
+               first = false;
+               break;
+            }
+         }
+
+         if( first ) {
+            rc = bench_mkdir( core, path );
+            if( rc != 0 ) {
+               return rc;
+            }
+         }
+      }
+
+      snprintf( path + len, PATH_MAX - len, "/f%" PRIu64, digits[ num_digits - 1 ] );
+      rc = bench_mknod( core, path );
+   }
+
+   return rc;
+}
+
+// build one shape under /name, report on it, and remove it
+static int bench_shape( struct fskit_core* core, char const* name, uint64_t num_files, uint64_t fanout ) {
+
+   struct fskit_memory_report before;
+   struct fskit_memory_report after;
+   char path[PATH_MAX];
+   size_t heap_base = 0;
+   size_t heap = 0;
+   uint64_t inodes = 0;
+   double start = 0, built = 0, reported = 0;
+   int rc = 0;
+
+   snprintf( path, PATH_MAX, "/%s", name );
+
+   fskit_core_memory_report( core, &before );
+   heap_base = heap_used();
+   start = fskit_bench_now();
+
+   if( strcmp( name, "flat" ) == 0 ) {
+      rc = fskit_bench_populate_dir( core, path, num_files );
+   }
+   else {
+
+      rc = bench_mkdir( core, path );
+      if( rc == 0 && strcmp( name, "wide" ) == 0 ) {
+         rc = bench_build_wide( core, num_files, fanout );
+      }
+      else if( rc == 0 ) {
+         rc = bench_build_deep( core, num_files, fanout );
+      }
+   }
+
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   built = fskit_bench_now();
+   heap = heap_used() - heap_base;
+
+   fskit_core_memory_report( core, &after );
+   reported = fskit_bench_now();
+
+   inodes = after.num_entries - before.num_entries;
+
+#define BENCH_PER_INODE( field ) (after.field - before.field), (double)(after.field - before.field) / inodes
+
+   printf("%s: %" PRIu64 " inodes (%" PRIu64 " directories), built in %.3f s\n", name, inodes, inodes - num_files, built - start );
+   printf("  entries:            %12" PRIu64 " bytes  %7.1f bytes/inode\n", BENCH_PER_INODE( entries ) );
+   printf("  entry set nodes:    %12" PRIu64 " bytes  %7.1f bytes/inode\n", BENCH_PER_INODE( entry_set_nodes ) );
+   printf("  names:              %12" PRIu64 " bytes  %7.1f bytes/inode\n", BENCH_PER_INODE( names ) );
+   printf("  allocator overhead: %12" PRIu64 " bytes  %7.1f bytes/inode\n", BENCH_PER_INODE( allocator_overhead ) );
+   printf("  total:              %12" PRIu64 " bytes  %7.1f bytes/inode\n", BENCH_PER_INODE( total ) );
+   printf("  heap growth:        %12zu bytes  %7.1f bytes/inode\n", heap, (double)heap / inodes );
+   printf("  report: %.1f us\n", (reported - built) * 1e6 );
+
+#undef BENCH_PER_INODE
+
+   rc = fskit_detach_all( core, path );
+   if( rc != 0 ) {
+      fskit_error("fskit_detach_all('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   rc = fskit_rmdir( core, path, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_rmdir('%s') rc = %d\n", path, rc );
+   }
+
+   return rc;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   uint64_t num_files = fskit_bench_arg( argc, argv, 1, 1000000 );
+   uint64_t wide_fanout = fskit_bench_arg( argc, argv, 2, 1000 );
+   uint64_t deep_fanout = fskit_bench_arg( argc, argv, 3, 10 );
+   int rc = 0;
+
+   if( num_files == 0 || wide_fanout == 0 || deep_fanout < 2 ) {
+      fprintf( stderr, "Usage: %s [NUM_FILES [WIDE_FANOUT [DEEP_FANOUT]]]\n", argv[0] );
+      exit(1);
+   }
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   if( bench_shape( core, "flat", num_files, 0 ) != 0 ||
+       bench_shape( core, "wide", num_files, wide_fanout ) != 0 ||
+       bench_shape( core, "deep", num_files, deep_fanout ) != 0 ) {
+      exit(1);
+   }
+
+   fskit_bench_end( core );
+   return 0;
+}
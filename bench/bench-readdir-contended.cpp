@@ -0,0 +1,169 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// list a large directory while other threads chmod its children, which write-locks them.
+// reports listing throughput alongside the writers' throughput.
+// usage: bench-readdir-contended [NUM_ENTRIES [NUM_WRITERS [NUM_ROUNDS [BATCH_SIZE]]]]
+
+#include "bench-readdir-contended.h"
+
+#include <pthread.h>
+
+struct bench_writer {
+
+   struct fskit_core* core;
+   uint64_t num_entries;
+   uint64_t seed;
+   uint64_t num_ops;
+   volatile bool* stop;
+   pthread_t thread;
+};
+
+// chmod random children of /dir until told to stop
+static void* bench_writer_main( void* arg ) {
+
+   struct bench_writer* w = (struct bench_writer*)arg;
+   char path[64];
+   uint64_t x = w->seed;
+   int rc = 0;
+
+   while( !*w->stop ) {
+
+      // xorshift
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+
+      snprintf( path, sizeof(path), "/dir/f%" PRIu64, x % w->num_entries );
+
+      rc = fskit_chmod( w->core, path, 0, 0, (w->num_ops & 1) ? 0644 : 0600 );
+      if( rc != 0 ) {
+         fskit_error("fskit_chmod('%s') rc = %d\n", path, rc );
+         break;
+      }
+
+      w->num_ops++;
+   }
+
+   return NULL;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_dir_handle* dh = NULL;
+   struct fskit_dir_entry** dents = NULL;
+   uint64_t num_entries = fskit_bench_arg( argc, argv, 1, 100000 );
+   uint64_t num_writers = fskit_bench_arg( argc, argv, 2, 4 );
+   uint64_t num_rounds = fskit_bench_arg( argc, argv, 3, 10 );
+   uint64_t batch_size = fskit_bench_arg( argc, argv, 4, 256 );
+   uint64_t num_read = 0;
+   uint64_t total_read = 0;
+   uint64_t total_ops = 0;
+   double start = 0, stop = 0;
+   volatile bool stopped = false;
+   struct bench_writer* writers = NULL;
+   int rc = 0;
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_bench_populate_dir( core, "/dir", num_entries );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   writers = (struct bench_writer*)calloc( num_writers + 1, sizeof(struct bench_writer) );
+   if( writers == NULL ) {
+      exit(1);
+   }
+
+   for( uint64_t i = 0; i < num_writers; i++ ) {
+
+      writers[i].core = core;
+      writers[i].num_entries = num_entries;
+      writers[i].seed = 0x9E3779B97F4A7C15ULL * (i + 1);
+      writers[i].stop = &stopped;
+
+      rc = pthread_create( &writers[i].thread, NULL, bench_writer_main, &writers[i] );
+      if( rc != 0 ) {
+         fskit_error("pthread_create rc = %d\n", rc );
+         exit(1);
+      }
+   }
+
+   start = fskit_bench_now();
+
+   for( uint64_t r = 0; r < num_rounds; r++ ) {
+
+      dh = fskit_opendir( core, "/dir", 0, 0, &rc );
+      if( dh == NULL ) {
+         fskit_error("fskit_opendir rc = %d\n", rc );
+         exit(1);
+      }
+
+      while( true ) {
+
+         dents = fskit_readdir( core, dh, batch_size, &num_read, &rc );
+         if( rc != 0 ) {
+            fskit_error("fskit_readdir rc = %d\n", rc );
+            exit(1);
+         }
+
+         if( dents == NULL || num_read == 0 ) {
+            break;
+         }
+
+         total_read += num_read;
+         fskit_dir_entry_free_list( dents );
+      }
+
+      fskit_closedir( core, dh );
+   }
+
+   stop = fskit_bench_now();
+
+   stopped = true;
+   for( uint64_t i = 0; i < num_writers; i++ ) {
+
+      pthread_join( writers[i].thread, NULL );
+      total_ops += writers[i].num_ops;
+   }
+
+   // includes . and ..
+   if( total_read != (num_entries + 2) * num_rounds ) {
+      fskit_error("read %" PRIu64 " entries, expected %" PRIu64 "\n", total_read, (num_entries + 2) * num_rounds );
+      exit(1);
+   }
+
+   printf("entries: %" PRIu64 "\n", num_entries );
+   printf("writers: %" PRIu64 "\n", num_writers );
+   printf("rounds: %" PRIu64 "\n", num_rounds );
+   printf("list: %.3f s (%.0f entries/s)\n", stop - start, total_read / (stop - start) );
+   printf("chmod: %" PRIu64 " ops (%.0f ops/s)\n", total_ops, total_ops / (stop - start) );
+
+   free( writers );
+   fskit_bench_end( core );
+
+   return 0;
+}
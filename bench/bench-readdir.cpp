@@ -0,0 +1,136 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// list a large directory in fixed-size batches, as a FUSE readdir or getdents loop would.
+// the directory is listed twice: once with fskit_readdir, and once with fskit_readdir_packed
+// into a buffer sized for about BATCH_SIZE records.
+// usage: bench-readdir [NUM_ENTRIES [BATCH_SIZE]]
+
+#include "bench-readdir.h"
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_dir_handle* dh = NULL;
+   struct fskit_dir_entry** dents = NULL;
+   uint64_t num_entries = fskit_bench_arg( argc, argv, 1, 1000000 );
+   uint64_t batch_size = fskit_bench_arg( argc, argv, 2, 256 );
+   uint64_t num_read = 0;
+   uint64_t total_read = 0;
+   uint64_t num_batches = 0;
+   uint64_t total_packed = 0;
+   uint64_t num_fills = 0;
+   double start = 0, populated = 0, listed = 0, packed = 0;
+   struct fskit_readdir_cookie cookie;
+   size_t buf_len = 0;
+   char* buf = NULL;
+   ssize_t len = 0;
+   int rc = 0;
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   start = fskit_bench_now();
+
+   rc = fskit_bench_populate_dir( core, "/dir", num_entries );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   populated = fskit_bench_now();
+
+   dh = fskit_opendir( core, "/dir", 0, 0, &rc );
+   if( dh == NULL ) {
+      fskit_error("fskit_opendir rc = %d\n", rc );
+      exit(1);
+   }
+
+   while( true ) {
+
+      dents = fskit_readdir( core, dh, batch_size, &num_read, &rc );
+      if( rc != 0 ) {
+         fskit_error("fskit_readdir rc = %d\n", rc );
+         exit(1);
+      }
+
+      if( dents == NULL || num_read == 0 ) {
+         break;
+      }
+
+      total_read += num_read;
+      num_batches++;
+
+      fskit_dir_entry_free_list( dents );
+   }
+
+   listed = fskit_bench_now();
+
+   // same listing, packed into a reusable buffer
+   memset( &cookie, 0, sizeof(struct fskit_readdir_cookie) );
+   buf_len = batch_size * FSKIT_PACKED_DIRENT_RECLEN( 8 );
+   buf = (char*)malloc( buf_len );
+   if( buf == NULL ) {
+      exit(1);
+   }
+
+   while( (len = fskit_readdir_packed( core, dh, &cookie, buf, buf_len )) > 0 ) {
+
+      for( struct fskit_packed_dirent* d = (struct fskit_packed_dirent*)buf; (char*)d < buf + len; d = FSKIT_PACKED_DIRENT_NEXT( d ) ) {
+         total_packed++;
+      }
+
+      num_fills++;
+   }
+
+   if( len < 0 ) {
+      fskit_error("fskit_readdir_packed rc = %zd\n", len );
+      exit(1);
+   }
+
+   packed = fskit_bench_now();
+
+   free( buf );
+   fskit_closedir( core, dh );
+
+   // includes . and ..
+   if( total_read != num_entries + 2 ) {
+      fskit_error("read %" PRIu64 " entries, expected %" PRIu64 "\n", total_read, num_entries + 2 );
+      exit(1);
+   }
+
+   if( total_packed != total_read ) {
+      fskit_error("packed %" PRIu64 " entries, expected %" PRIu64 "\n", total_packed, total_read );
+      exit(1);
+   }
+
+   printf("entries: %" PRIu64 "\n", num_entries );
+   printf("batch size: %" PRIu64 "\n", batch_size );
+   printf("batches: %" PRIu64 "\n", num_batches );
+   printf("populate: %.3f s\n", populated - start );
+   printf("list: %.3f s (%.0f entries/s, %.2f us/batch)\n", listed - populated, total_read / (listed - populated), (listed - populated) * 1e6 / num_batches );
+   printf("list packed: %.3f s (%.0f entries/s, %" PRIu64 " fills of %zu bytes)\n", packed - listed, total_packed / (packed - listed), num_fills, buf_len );
+
+   fskit_bench_end( core );
+
+   return 0;
+}
@@ -0,0 +1,280 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// mv-heavy build workload: each thread renames object files within its build directory (like a compiler
+// renaming its temporary output into place), then moves them into an output directory and back.
+// reports same-directory and cross-directory rename throughput for 1, 2, 4, ... MAX_THREADS threads.
+// then, swaps two directories of SWAP_ENTRIES entries each back and forth with FSKIT_RENAME_EXCHANGE.
+// usage: bench-rename [FILES_PER_THREAD [MAX_THREADS [NUM_ROUNDS [DEPTH [SWAP_ENTRIES]]]]]
+
+#include "bench-rename.h"
+
+#include <pthread.h>
+
+struct bench_renamer {
+
+   struct fskit_core* core;
+   int id;
+   uint64_t num_files;
+   uint64_t num_rounds;
+   uint64_t depth;
+   pthread_barrier_t* barrier;
+
+   double same_dir_time;
+   double cross_dir_time;
+   int rc;
+   pthread_t thread;
+};
+
+// rename from_dir/from_prefix$i to to_dir/to_prefix$i for each file
+static int bench_rename_all( struct bench_renamer* r, char const* from_dir, char const* from_prefix, char const* to_dir, char const* to_prefix ) {
+
+   char from[PATH_MAX];
+   char to[PATH_MAX];
+   int rc = 0;
+
+   for( uint64_t i = 0; i < r->num_files; i++ ) {
+
+      snprintf( from, PATH_MAX, "%s/%s%" PRIu64, from_dir, from_prefix, i );
+      snprintf( to, PATH_MAX, "%s/%s%" PRIu64, to_dir, to_prefix, i );
+
+      rc = fskit_rename( r->core, from, to, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_rename('%s', '%s') rc = %d\n", from, to, rc );
+         return rc;
+      }
+   }
+
+   return 0;
+}
+
+static void* bench_renamer_main( void* arg ) {
+
+   struct bench_renamer* r = (struct bench_renamer*)arg;
+   char obj_dir[PATH_MAX];
+   char out_dir[PATH_MAX];
+   size_t len = 0;
+   double start = 0;
+
+   // a deep object directory, and a shallow output directory
+   len = snprintf( obj_dir, PATH_MAX, "/build/t%d", r->id );
+   for( uint64_t i = 0; i < r->depth; i++ ) {
+      len += snprintf( obj_dir + len, PATH_MAX - len, "/src%" PRIu64, i );
+   }
+
+   snprintf( out_dir, PATH_MAX, "/build/t%d/out", r->id );
+
+   pthread_barrier_wait( r->barrier );
+
+   for( uint64_t round = 0; round < r->num_rounds && r->rc == 0; round++ ) {
+
+      // temporary output into place
+      start = fskit_bench_now();
+      r->rc = bench_rename_all( r, obj_dir, "f", obj_dir, "o" );
+      r->same_dir_time += fskit_bench_now() - start;
+
+      if( r->rc != 0 ) {
+         break;
+      }
+
+      // install, and put back for the next round
+      start = fskit_bench_now();
+
+      r->rc = bench_rename_all( r, obj_dir, "o", out_dir, "f" );
+      if( r->rc == 0 ) {
+         r->rc = bench_rename_all( r, out_dir, "f", obj_dir, "f" );
+      }
+
+      r->cross_dir_time += fskit_bench_now() - start;
+   }
+
+   return NULL;
+}
+
+// build /build/t$id/src0/.../src$depth with num_files files, and an empty /build/t$id/out
+static int bench_setup( struct fskit_core* core, int id, uint64_t num_files, uint64_t depth ) {
+
+   char path[PATH_MAX];
+   size_t len = 0;
+   int rc = 0;
+
+   len = snprintf( path, PATH_MAX, "/build/t%d", id );
+
+   rc = fskit_mkdir( core, path, 0755, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   for( uint64_t i = 0; i + 1 < depth; i++ ) {
+
+      len += snprintf( path + len, PATH_MAX - len, "/src%" PRIu64, i );
+
+      rc = fskit_mkdir( core, path, 0755, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mkdir('%s') rc = %d\n", path, rc );
+         return rc;
+      }
+   }
+
+   snprintf( path + len, PATH_MAX - len, "/src%" PRIu64, depth - 1 );
+
+   rc = fskit_bench_populate_dir( core, path, num_files );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   snprintf( path, PATH_MAX, "/build/t%d/out", id );
+
+   rc = fskit_mkdir( core, path, 0755, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir('%s') rc = %d\n", path, rc );
+   }
+
+   return rc;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct bench_renamer* renamers = NULL;
+   pthread_barrier_t barrier;
+   uint64_t num_files = fskit_bench_arg( argc, argv, 1, 10000 );
+   uint64_t max_threads = fskit_bench_arg( argc, argv, 2, 8 );
+   uint64_t num_rounds = fskit_bench_arg( argc, argv, 3, 5 );
+   uint64_t depth = fskit_bench_arg( argc, argv, 4, 6 );
+   uint64_t swap_entries = fskit_bench_arg( argc, argv, 5, 1000000 );
+   uint64_t num_swaps = 10000;
+   double start = 0, stop = 0;
+   int rc = 0;
+
+   if( depth == 0 ) {
+      depth = 1;
+   }
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   renamers = (struct bench_renamer*)calloc( max_threads, sizeof(struct bench_renamer) );
+   if( renamers == NULL ) {
+      exit(1);
+   }
+
+   printf("files per thread: %" PRIu64 ", rounds: %" PRIu64 ", object directory depth: %" PRIu64 "\n", num_files, num_rounds, depth );
+
+   for( uint64_t num_threads = 1; num_threads <= max_threads; num_threads *= 2 ) {
+
+      double same_dir_time = 0, cross_dir_time = 0;
+
+      rc = fskit_mkdir( core, "/build", 0755, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mkdir('/build') rc = %d\n", rc );
+         exit(1);
+      }
+
+      pthread_barrier_init( &barrier, NULL, num_threads );
+
+      for( uint64_t i = 0; i < num_threads; i++ ) {
+
+         rc = bench_setup( core, (int)i, num_files, depth );
+         if( rc != 0 ) {
+            exit(1);
+         }
+
+         memset( &renamers[i], 0, sizeof(struct bench_renamer) );
+
+         renamers[i].core = core;
+         renamers[i].id = (int)i;
+         renamers[i].num_files = num_files;
+         renamers[i].num_rounds = num_rounds;
+         renamers[i].depth = depth;
+         renamers[i].barrier = &barrier;
+      }
+
+      for( uint64_t i = 0; i < num_threads; i++ ) {
+         pthread_create( &renamers[i].thread, NULL, bench_renamer_main, &renamers[i] );
+      }
+
+      for( uint64_t i = 0; i < num_threads; i++ ) {
+
+         pthread_join( renamers[i].thread, NULL );
+
+         if( renamers[i].rc != 0 ) {
+            exit(1);
+         }
+
+         // threads run side by side, so count the slowest one
+         if( renamers[i].same_dir_time > same_dir_time ) {
+            same_dir_time = renamers[i].same_dir_time;
+         }
+
+         if( renamers[i].cross_dir_time > cross_dir_time ) {
+            cross_dir_time = renamers[i].cross_dir_time;
+         }
+      }
+
+      pthread_barrier_destroy( &barrier );
+
+      rc = fskit_detach_all( core, "/build" );
+      if( rc == 0 ) {
+         rc = fskit_rmdir( core, "/build", 0, 0 );
+      }
+
+      if( rc != 0 ) {
+         fskit_error("removing /build rc = %d\n", rc );
+         exit(1);
+      }
+
+      printf("threads: %2" PRIu64 "  same-directory: %.0f renames/s  cross-directory: %.0f renames/s\n", num_threads,
+             num_threads * num_files * num_rounds / same_dir_time, 2 * num_threads * num_files * num_rounds / cross_dir_time );
+   }
+
+   free( renamers );
+
+   // publish a freshly-built directory over a live one, and back
+   if( swap_entries > 0 ) {
+
+      if( fskit_bench_populate_dir( core, "/live", swap_entries ) != 0 || fskit_bench_populate_dir( core, "/staging", swap_entries ) != 0 ) {
+         exit(1);
+      }
+
+      start = fskit_bench_now();
+
+      for( uint64_t i = 0; i < num_swaps; i++ ) {
+
+         rc = fskit_rename2( core, "/staging", "/live", 0, 0, FSKIT_RENAME_EXCHANGE );
+         if( rc != 0 ) {
+            fskit_error("fskit_rename2 rc = %d\n", rc );
+            exit(1);
+         }
+      }
+
+      stop = fskit_bench_now();
+
+      printf("exchange two %" PRIu64 "-entry directories: %.2f us/swap\n", swap_entries, (stop - start) * 1e6 / num_swaps );
+   }
+
+   fskit_bench_end( core );
+
+   return 0;
+}
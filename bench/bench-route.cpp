@@ -0,0 +1,298 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// route dispatch overhead: all threads read and write one file through their own handles, with trivial
+// read and write callbacks, so the time is spent in fskit_route_call (the regex match, the route metadata,
+// the route lock, and the consistency discipline's lock).
+// each consistency discipline is timed with a single FSKIT_ROUTE_ANY route, and then with route tables
+// of 1, 4, 16, ... MAX_ROUTES entries where only the last one matches, for 1, 2, 4, ... MAX_THREADS threads.
+// reports ns/op as seen by each thread, and heap allocations/op (counted by wrapping malloc).
+// usage: bench-route [OPS_PER_THREAD [MAX_THREADS [MAX_ROUTES]]]
+
+#include "bench-route.h"
+
+#include <pthread.h>
+
+#define IO_SIZE 64
+
+// count this thread's heap allocations.  glibc routes its own allocations through these too.
+extern "C" void* __libc_malloc( size_t size );
+extern "C" void* __libc_calloc( size_t nmemb, size_t size );
+extern "C" void* __libc_realloc( void* ptr, size_t size );
+extern "C" void __libc_free( void* ptr );
+
+static __thread uint64_t bench_route_allocs = 0;
+
+extern "C" void* malloc( size_t size ) {
+   bench_route_allocs++;
+   return __libc_malloc( size );
+}
+
+extern "C" void* calloc( size_t nmemb, size_t size ) {
+   bench_route_allocs++;
+   return __libc_calloc( nmemb, size );
+}
+
+extern "C" void* realloc( void* ptr, size_t size ) {
+   bench_route_allocs++;
+   return __libc_realloc( ptr, size );
+}
+
+extern "C" void free( void* ptr ) {
+   __libc_free( ptr );
+}
+
+struct bench_route_worker {
+
+   struct fskit_core* core;
+   uint64_t num_ops;
+   pthread_barrier_t* barrier;
+
+   double read_time;
+   double write_time;
+   uint64_t read_allocs;
+   uint64_t write_allocs;
+   int rc;
+   pthread_t thread;
+};
+
+static int bench_route_io_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data ) {
+   return buflen;
+}
+
+static void* bench_route_worker_main( void* arg ) {
+
+   struct bench_route_worker* w = (struct bench_route_worker*)arg;
+   struct fskit_file_handle* fh = NULL;
+   char buf[IO_SIZE];
+   ssize_t nr = 0;
+   uint64_t allocs = 0;
+   double start = 0;
+   int rc = 0;
+
+   memset( buf, 0, IO_SIZE );
+
+   fh = fskit_open( w->core, "/f", 0, 0, O_RDWR, 0644, &rc );
+   if( fh == NULL ) {
+      fskit_error("fskit_open('/f') rc = %d\n", rc );
+      w->rc = rc;
+   }
+
+   // reads
+   pthread_barrier_wait( w->barrier );
+
+   start = fskit_bench_now();
+   allocs = bench_route_allocs;
+
+   for( uint64_t i = 0; i < w->num_ops && w->rc == 0; i++ ) {
+
+      nr = fskit_read( w->core, fh, buf, IO_SIZE, 0 );
+      if( nr != IO_SIZE ) {
+         fskit_error("fskit_read rc = %zd\n", nr );
+         w->rc = -EIO;
+      }
+   }
+
+   w->read_allocs = bench_route_allocs - allocs;
+   w->read_time = fskit_bench_now() - start;
+
+   // writes
+   pthread_barrier_wait( w->barrier );
+
+   start = fskit_bench_now();
+   allocs = bench_route_allocs;
+
+   for( uint64_t i = 0; i < w->num_ops && w->rc == 0; i++ ) {
+
+      nr = fskit_write( w->core, fh, buf, IO_SIZE, 0 );
+      if( nr != IO_SIZE ) {
+         fskit_error("fskit_write rc = %zd\n", nr );
+         w->rc = -EIO;
+      }
+   }
+
+   w->write_allocs = bench_route_allocs - allocs;
+   w->write_time = fskit_bench_now() - start;
+
+   if( fh != NULL ) {
+      fskit_close( w->core, fh );
+   }
+
+   return NULL;
+}
+
+// install num_routes read and write routes, of which only the last matches /f.
+// num_routes == 0 means a single FSKIT_ROUTE_ANY route.
+static int bench_route_install( struct fskit_core* core, uint64_t num_routes, int discipline ) {
+
+   char regex[64];
+   int rc = 0;
+
+   for( uint64_t i = 0; i < num_routes || (num_routes == 0 && i == 0); i++ ) {
+
+      if( num_routes == 0 ) {
+         snprintf( regex, sizeof(regex), "%s", FSKIT_ROUTE_ANY );
+      }
+      else if( i + 1 < num_routes ) {
+         snprintf( regex, sizeof(regex), "/other%" PRIu64, i );
+      }
+      else {
+         snprintf( regex, sizeof(regex), "/f" );
+      }
+
+      rc = fskit_route_read( core, regex, bench_route_io_cb, discipline );
+      if( rc < 0 ) {
+         fskit_error("fskit_route_read('%s') rc = %d\n", regex, rc );
+         return rc;
+      }
+
+      rc = fskit_route_write( core, regex, bench_route_io_cb, discipline );
+      if( rc < 0 ) {
+         fskit_error("fskit_route_write('%s') rc = %d\n", regex, rc );
+         return rc;
+      }
+   }
+
+   return 0;
+}
+
+// time reads and writes on a fresh core with the given routes
+static int bench_route_run( struct bench_route_worker* workers, uint64_t num_threads, uint64_t num_ops, uint64_t num_routes, int discipline, char const* discipline_name ) {
+
+   struct fskit_core* core = NULL;
+   pthread_barrier_t barrier;
+   double read_time = 0, write_time = 0;
+   uint64_t read_allocs = 0, write_allocs = 0;
+   char routes_str[32];
+   int rc = 0;
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   rc = bench_route_install( core, num_routes, discipline );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   rc = fskit_mknod( core, "/f", S_IFREG | 0644, 0, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mknod('/f') rc = %d\n", rc );
+      return rc;
+   }
+
+   pthread_barrier_init( &barrier, NULL, num_threads );
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      memset( &workers[i], 0, sizeof(struct bench_route_worker) );
+
+      workers[i].core = core;
+      workers[i].num_ops = num_ops;
+      workers[i].barrier = &barrier;
+
+      pthread_create( &workers[i].thread, NULL, bench_route_worker_main, &workers[i] );
+   }
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      pthread_join( workers[i].thread, NULL );
+
+      if( workers[i].rc != 0 ) {
+         rc = workers[i].rc;
+      }
+
+      // threads run side by side, so count the slowest one
+      if( workers[i].read_time > read_time ) {
+         read_time = workers[i].read_time;
+      }
+
+      if( workers[i].write_time > write_time ) {
+         write_time = workers[i].write_time;
+      }
+
+      read_allocs += workers[i].read_allocs;
+      write_allocs += workers[i].write_allocs;
+   }
+
+   pthread_barrier_destroy( &barrier );
+
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   if( num_routes == 0 ) {
+      snprintf( routes_str, sizeof(routes_str), "any" );
+   }
+   else {
+      snprintf( routes_str, sizeof(routes_str), "%" PRIu64, num_routes );
+   }
+
+   printf("%-16s  routes: %4s  threads: %2" PRIu64 "  read: %7.0f ns/op %5.2f allocs/op  write: %7.0f ns/op %5.2f allocs/op\n",
+          discipline_name, routes_str, num_threads,
+          read_time * 1e9 / num_ops, (double)read_allocs / (num_threads * num_ops),
+          write_time * 1e9 / num_ops, (double)write_allocs / (num_threads * num_ops) );
+
+   return fskit_bench_end( core );
+}
+
+int main( int argc, char** argv ) {
+
+   struct bench_route_worker* workers = NULL;
+   uint64_t num_ops = fskit_bench_arg( argc, argv, 1, 200000 );
+   uint64_t max_threads = fskit_bench_arg( argc, argv, 2, 4 );
+   uint64_t max_routes = fskit_bench_arg( argc, argv, 3, 64 );
+   int rc = 0;
+
+   int disciplines[] = { FSKIT_SEQUENTIAL, FSKIT_CONCURRENT, FSKIT_INODE_SEQUENTIAL, FSKIT_INODE_CONCURRENT };
+   char const* discipline_names[] = { "SEQUENTIAL", "CONCURRENT", "INODE_SEQUENTIAL", "INODE_CONCURRENT" };
+
+   if( max_threads == 0 ) {
+      max_threads = 1;
+   }
+
+   workers = (struct bench_route_worker*)calloc( max_threads, sizeof(struct bench_route_worker) );
+   if( workers == NULL ) {
+      exit(1);
+   }
+
+   printf("ops per thread: %" PRIu64 ", I/O size: %d\n", num_ops, IO_SIZE );
+
+   for( size_t d = 0; d < sizeof(disciplines) / sizeof(disciplines[0]); d++ ) {
+
+      // 0 means FSKIT_ROUTE_ANY
+      for( uint64_t num_routes = 0; num_routes <= max_routes; num_routes = (num_routes == 0 ? 1 : num_routes * 4) ) {
+
+         for( uint64_t num_threads = 1; num_threads <= max_threads; num_threads *= 2 ) {
+
+            rc = bench_route_run( workers, num_threads, num_ops, num_routes, disciplines[d], discipline_names[d] );
+            if( rc != 0 ) {
+               exit(1);
+            }
+         }
+      }
+   }
+
+   free( workers );
+
+   return 0;
+}
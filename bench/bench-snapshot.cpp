@@ -0,0 +1,205 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// compare a copy-on-write clone of a tree against copying it file by file.
+// the files are kept by the built-in data routes, and each holds FILE_SIZE bytes.
+// reports the clone itself, the first visit of every file in the clone (which fills in its directories), and a full copy.
+// usage: bench-snapshot [NUM_DIRS [FILES_PER_DIR [FILE_SIZE]]]
+
+#include "bench-snapshot.h"
+
+// open a file in the tree, or die
+static struct fskit_file_handle* open_or_die( struct fskit_core* core, char const* path, int flags ) {
+
+   int rc = 0;
+
+   struct fskit_file_handle* fh = fskit_open( core, path, 0, 0, flags, 0644, &rc );
+   if( fh == NULL ) {
+      fskit_error("fskit_open('%s') rc = %d\n", path, rc );
+      exit(1);
+   }
+
+   return fh;
+}
+
+// copy the file at src to dest
+static void copy_file( struct fskit_core* core, char const* src, char const* dest, char* buf, uint64_t file_size ) {
+
+   struct fskit_file_handle* in = open_or_die( core, src, O_RDONLY );
+   struct fskit_file_handle* out = open_or_die( core, dest, O_CREAT | O_WRONLY );
+
+   ssize_t nr = fskit_read( core, in, buf, file_size, 0 );
+   if( nr < 0 || fskit_write( core, out, buf, nr, 0 ) != nr ) {
+      fskit_error("copy '%s' to '%s' failed\n", src, dest );
+      exit(1);
+   }
+
+   fskit_close( core, in );
+   fskit_close( core, out );
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_file_handle* fh = NULL;
+   uint64_t num_dirs = fskit_bench_arg( argc, argv, 1, 64 );
+   uint64_t files_per_dir = fskit_bench_arg( argc, argv, 2, 256 );
+   uint64_t file_size = fskit_bench_arg( argc, argv, 3, 16384 );
+   uint64_t num_files = num_dirs * files_per_dir;
+   char path[PATH_MAX];
+   char path2[PATH_MAX];
+   char* buf = NULL;
+   struct stat sb;
+   double start = 0, stop = 0;
+   int rc = 0;
+
+   buf = (char*)malloc( file_size + 1 );
+   if( buf == NULL ) {
+      exit(1);
+   }
+
+   memset( buf, 0x5a, file_size );
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_data_route( core, FSKIT_ROUTE_ANY );
+   if( rc != 0 ) {
+      fskit_error("fskit_data_route rc = %d\n", rc );
+      exit(1);
+   }
+
+   printf("files: %" PRIu64 " (%" PRIu64 " dirs x %" PRIu64 " files, %" PRIu64 " bytes each)\n", num_files, num_dirs, files_per_dir, file_size );
+
+   rc = fskit_mkdir( core, "/tree", 0755, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir rc = %d\n", rc );
+      exit(1);
+   }
+
+   for( uint64_t i = 0; i < num_dirs; i++ ) {
+
+      snprintf( path, PATH_MAX, "/tree/d%" PRIu64, i );
+
+      rc = fskit_bench_populate_dir( core, path, files_per_dir );
+      if( rc != 0 ) {
+         exit(1);
+      }
+
+      for( uint64_t j = 0; j < files_per_dir; j++ ) {
+
+         snprintf( path, PATH_MAX, "/tree/d%" PRIu64 "/f%" PRIu64, i, j );
+
+         fh = open_or_die( core, path, O_WRONLY );
+         fskit_write( core, fh, buf, file_size, 0 );
+         fskit_close( core, fh );
+      }
+   }
+
+   // clone
+   start = fskit_bench_now();
+
+   rc = fskit_clone( core, "/tree", "/clone", 0, 0 );
+
+   stop = fskit_bench_now();
+
+   if( rc != 0 ) {
+      fskit_error("fskit_clone rc = %d\n", rc );
+      exit(1);
+   }
+
+   printf("clone:             %.6f s\n", stop - start );
+
+   // first visit of everything in the clone
+   start = fskit_bench_now();
+
+   for( uint64_t i = 0; i < num_dirs; i++ ) {
+      for( uint64_t j = 0; j < files_per_dir; j++ ) {
+
+         snprintf( path, PATH_MAX, "/clone/d%" PRIu64 "/f%" PRIu64, i, j );
+
+         rc = fskit_stat( core, path, 0, 0, &sb );
+         if( rc != 0 || (uint64_t)sb.st_size != file_size ) {
+            fskit_error("fskit_stat('%s') rc = %d\n", path, rc );
+            exit(1);
+         }
+      }
+   }
+
+   stop = fskit_bench_now();
+
+   printf("first visit:       %.3f s (%.0f files/s)\n", stop - start, num_files / (stop - start) );
+
+   // second visit, for comparison
+   start = fskit_bench_now();
+
+   for( uint64_t i = 0; i < num_dirs; i++ ) {
+      for( uint64_t j = 0; j < files_per_dir; j++ ) {
+
+         snprintf( path, PATH_MAX, "/clone/d%" PRIu64 "/f%" PRIu64, i, j );
+         fskit_stat( core, path, 0, 0, &sb );
+      }
+   }
+
+   stop = fskit_bench_now();
+
+   printf("second visit:      %.3f s (%.0f files/s)\n", stop - start, num_files / (stop - start) );
+
+   // copy, file by file
+   start = fskit_bench_now();
+
+   rc = fskit_mkdir( core, "/copy", 0755, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir rc = %d\n", rc );
+      exit(1);
+   }
+
+   for( uint64_t i = 0; i < num_dirs; i++ ) {
+
+      snprintf( path, PATH_MAX, "/copy/d%" PRIu64, i );
+
+      rc = fskit_mkdir( core, path, 0755, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mkdir('%s') rc = %d\n", path, rc );
+         exit(1);
+      }
+
+      for( uint64_t j = 0; j < files_per_dir; j++ ) {
+
+         snprintf( path, PATH_MAX, "/tree/d%" PRIu64 "/f%" PRIu64, i, j );
+         snprintf( path2, PATH_MAX, "/copy/d%" PRIu64 "/f%" PRIu64, i, j );
+
+         copy_file( core, path, path2, buf, file_size );
+      }
+   }
+
+   stop = fskit_bench_now();
+
+   printf("file-by-file copy: %.3f s (%.0f files/s)\n", stop - start, num_files / (stop - start) );
+
+   fskit_bench_end( core );
+
+   free( buf );
+
+   return 0;
+}
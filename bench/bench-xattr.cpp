@@ -0,0 +1,152 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// give many files the same handful of small xattrs, and report the heap they cost per inode and
+// how long fskit_fgetxattr takes to find one.
+// usage: bench-xattr [NUM_FILES [ROUNDS]]
+
+#include "bench-xattr.h"
+
+#include <malloc.h>
+
+// what a file typically carries
+static char const* xattr_names[] = {
+   "security.selinux",
+   "system.posix_acl_access",
+   "user.mime_type",
+   "user.checksum",
+   "trusted.owner",
+};
+
+static char const* xattr_values[] = {
+   "system_u:object_r:user_home_t:s0",
+   "\x02\x00\x00\x00\x01\x00\x06\x00\xff\xff\xff\xff\x04\x00\x04\x00\xff\xff\xff\xff\x20\x00\x04\x00\xff\xff\xff\xff",
+   "text/plain",
+   "sha1:da39a3ee5e6b4b0d3255bfef95601890afd80709",
+   "uid=1000",
+};
+
+#define NUM_XATTRS (sizeof(xattr_names) / sizeof(xattr_names[0]))
+
+// bytes currently malloc'ed
+static size_t heap_used(void) {
+   return mallinfo2().uordblks;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   uint64_t num_files = fskit_bench_arg( argc, argv, 1, 100000 );
+   uint64_t rounds = fskit_bench_arg( argc, argv, 2, 20 );
+   struct fskit_entry** ents = NULL;
+   char path[PATH_MAX];
+   char buf[256];
+   size_t heap_base = 0;
+   uint64_t lookups = 0;
+   double start = 0, elapsed = 0;
+   int rc = 0;
+
+   rc = fskit_bench_begin( &core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   ents = (struct fskit_entry**)calloc( num_files, sizeof(struct fskit_entry*) );
+   if( ents == NULL ) {
+      exit(1);
+   }
+
+   rc = fskit_bench_populate_dir( core, "/x", num_files );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   for( uint64_t i = 0; i < num_files; i++ ) {
+
+      snprintf( path, PATH_MAX, "/x/f%" PRIu64, i );
+
+      ents[i] = fskit_entry_resolve_path( core, path, 0, 0, false, &rc );
+      if( ents[i] == NULL ) {
+         fskit_error("fskit_entry_resolve_path('%s') rc = %d\n", path, rc );
+         exit(1);
+      }
+
+      fskit_entry_unlock( ents[i] );
+   }
+
+   // set the xattrs
+   heap_base = heap_used();
+   start = fskit_bench_now();
+
+   for( uint64_t i = 0; i < num_files; i++ ) {
+
+      fskit_entry_wlock( ents[i] );
+
+      for( unsigned int j = 0; j < NUM_XATTRS; j++ ) {
+
+         rc = fskit_fsetxattr( core, "/x/f", ents[i], xattr_names[j], xattr_values[j], strlen( xattr_values[j] ), 0 );
+         if( rc != 0 ) {
+            fskit_error("fskit_fsetxattr('%s') rc = %d\n", xattr_names[j], rc );
+            exit(1);
+         }
+      }
+
+      fskit_entry_unlock( ents[i] );
+   }
+
+   elapsed = fskit_bench_now() - start;
+
+   printf("files: %" PRIu64 ", %zu xattrs each\n", num_files, NUM_XATTRS );
+   printf("setxattr: %.0f ns/op  heap: %.1f bytes/inode\n",
+          elapsed * 1e9 / (num_files * NUM_XATTRS), (double)(heap_used() - heap_base) / num_files );
+
+   // look them up
+   start = fskit_bench_now();
+
+   for( uint64_t r = 0; r < rounds; r++ ) {
+
+      for( uint64_t i = 0; i < num_files; i++ ) {
+
+         fskit_entry_rlock( ents[i] );
+
+         for( unsigned int j = 0; j < NUM_XATTRS; j++ ) {
+
+            rc = fskit_fgetxattr( core, "/x/f", ents[i], xattr_names[j], buf, sizeof(buf) );
+            if( rc < 0 ) {
+               fskit_error("fskit_fgetxattr('%s') rc = %d\n", xattr_names[j], rc );
+               exit(1);
+            }
+         }
+
+         fskit_entry_unlock( ents[i] );
+         lookups += NUM_XATTRS;
+      }
+   }
+
+   elapsed = fskit_bench_now() - start;
+
+   printf("getxattr: %.0f ns/op\n", elapsed * 1e9 / lookups );
+
+   free( ents );
+
+   fskit_bench_end( core );
+   return 0;
+}
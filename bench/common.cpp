@@ -0,0 +1,115 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "common.h"
+
+// wall-clock time, in seconds
+double fskit_bench_now(void) {
+
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+
+   return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// parse argv[i] as an unsigned integer, or return dflt if it isn't given
+uint64_t fskit_bench_arg( int argc, char** argv, int i, uint64_t dflt ) {
+
+   if( i >= argc ) {
+      return dflt;
+   }
+
+   return strtoull( argv[i], NULL, 10 );
+}
+
+// start a benchmark: set up the library and a core, with debug messages off
+int fskit_bench_begin( struct fskit_core** core ) {
+
+   int rc = 0;
+
+   fskit_set_debug_level( 0 );
+
+   rc = fskit_library_init();
+   if( rc != 0 ) {
+      fskit_error("fskit_library_init rc = %d\n", rc );
+      return rc;
+   }
+
+   *core = fskit_core_new();
+   if( *core == NULL ) {
+      return -ENOMEM;
+   }
+
+   rc = fskit_core_init( *core, NULL );
+   if( rc != 0 ) {
+      fskit_error("fskit_core_init rc = %d\n", rc );
+   }
+
+   return rc;
+}
+
+// end a benchmark
+int fskit_bench_end( struct fskit_core* core ) {
+
+   int rc = 0;
+
+   rc = fskit_detach_all( core, "/" );
+   if( rc != 0 ) {
+      fskit_error("fskit_detach_all(\"/\") rc = %d\n", rc );
+      return rc;
+   }
+
+   rc = fskit_core_destroy( core, NULL );
+   if( rc != 0 ) {
+      fskit_error("fskit_core_destroy rc = %d\n", rc );
+      return rc;
+   }
+
+   free( core );
+
+   return fskit_library_shutdown();
+}
+
+// create a directory with num_files regular files named f0, f1, ...
+int fskit_bench_populate_dir( struct fskit_core* core, char const* path, uint64_t num_files ) {
+
+   int rc = 0;
+   char child_path[PATH_MAX];
+
+   rc = fskit_mkdir( core, path, 0755, 0, 0 );
+   if( rc != 0 && rc != -EEXIST ) {
+      fskit_error("fskit_mkdir('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   for( uint64_t i = 0; i < num_files; i++ ) {
+
+      snprintf( child_path, PATH_MAX, "%s/f%" PRIu64, path, i );
+
+      rc = fskit_mknod( core, child_path, S_IFREG | 0644, 0, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mknod('%s') rc = %d\n", child_path, rc );
+         return rc;
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,39 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _BENCH_COMMON_H_
+#define _BENCH_COMMON_H_
+
+#include <fskit/fskit.h>
+
+// wall-clock time, in seconds
+double fskit_bench_now(void);
+
+// parse an unsigned integer argument, or use a default
+uint64_t fskit_bench_arg( int argc, char** argv, int i, uint64_t dflt );
+
+int fskit_bench_begin( struct fskit_core** core );
+int fskit_bench_end( struct fskit_core* core );
+
+// create a directory with num_files regular files named f0, f1, ...
+int fskit_bench_populate_dir( struct fskit_core* core, char const* path, uint64_t num_files );
+
+#endif
@@ -0,0 +1,67 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _FSKIT_TRACE_H_
+#define _FSKIT_TRACE_H_
+
+// USDT (statically-defined tracing) probes, for perf, bpftrace, and SystemTap.
+// build with USDT=1 (which defines FSKIT_USDT) to compile them in; this needs <sys/sdt.h> from systemtap-sdt-dev.
+// each probe is then a single nop until a tracer attaches.  Without FSKIT_USDT, they compile to nothing.
+//
+// provider "fskit", in libfskit:
+//   path__start( core, path, user )                  entering fskit_entry_resolve_path_cls
+//   path__component( parent_id, name, child_id )     looked up one name; child_id is 0 if it isn't there
+//   path__error( path, err )                         resolution failed with -errno err
+//   path__end( path, file_id, err )                  leaving; file_id is 0 on error
+//   route__match( path, route_type, regex )          looked up the route for a path and operation; regex is NULL if none matched
+//   route__dispatch( path, route_type, regex )       about to call a route's callback
+//   route__done( path, route_type, rc )              the callback returned rc
+//   lock__wait__begin( lock, write )                 a rwlock is held, so this thread is about to wait for it
+//   lock__wait__end( lock, write )                   got the lock after waiting.  For inodes, lock is &fent->lock
+//   readdir__batch( dir_id, num_entries )            a batch of directory entries is ready
+//   entry__detach( parent_id, name, child_id )       unlinked a name from a directory
+//   entry__destroy( file_id, type )                  freeing an inode's state
+//
+// provider "fskit", in libfskit_fuse, while per-operation stats are enabled (the default):
+//   fuse__op__begin( op, path )                      op is one of FSKIT_FUSE_OP_*
+//   fuse__op__end( op, path, rc )
+//
+// for example, to see where path resolution spends its time:
+//   bpftrace -e 'usdt:libfskit.so:fskit:path__start { @s[tid] = nsecs; }
+//                usdt:libfskit.so:fskit:path__end /@s[tid]/ { @ns = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+
+#ifdef FSKIT_USDT
+
+#include <sys/sdt.h>
+
+#define FSKIT_TRACE1( name, a1 )                        DTRACE_PROBE1( fskit, name, a1 )
+#define FSKIT_TRACE2( name, a1, a2 )                    DTRACE_PROBE2( fskit, name, a1, a2 )
+#define FSKIT_TRACE3( name, a1, a2, a3 )                DTRACE_PROBE3( fskit, name, a1, a2, a3 )
+
+#else
+
+#define FSKIT_TRACE1( name, a1 )                        do { } while( 0 )
+#define FSKIT_TRACE2( name, a1, a2 )                    do { } while( 0 )
+#define FSKIT_TRACE3( name, a1, a2, a3 )                do { } while( 0 )
+
+#endif
+
+#endif
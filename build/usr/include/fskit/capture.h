@@ -0,0 +1,120 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _FSKIT_CAPTURE_H_
+#define _FSKIT_CAPTURE_H_
+
+#include <fskit/common.h>
+#include <fskit/debug.h>
+
+// API call capture.
+// a capture is a compact binary trace of fskit calls: each one's arguments, result, start time, and duration.
+// fskit_fuse records one with fskit_fuse_capture_start(), and fskit_repl_replay() re-executes one against a core.
+//
+// caveats:
+// * file contents and xattr values are not recorded, only their lengths.  Replayed writes write zeros.
+// * handles are recorded as opaque IDs, which may be reused once the handle is closed.
+// * captures are only readable on hosts with the same byte order.
+
+#define FSKIT_CAPTURE_VERSION           1
+
+// recorded calls, and what they keep in args[]
+#define FSKIT_CAPTURE_OP_STAT           1       // path
+#define FSKIT_CAPTURE_OP_FSTAT          2       // handle; args[0] is the handle's FSKIT_ENTRY_TYPE_*
+#define FSKIT_CAPTURE_OP_READLINK       3       // path; args[0] is the buffer size
+#define FSKIT_CAPTURE_OP_MKNOD          4       // path; args[0] is the mode, args[1] the device
+#define FSKIT_CAPTURE_OP_MKDIR          5       // path; args[0] is the mode
+#define FSKIT_CAPTURE_OP_UNLINK         6       // path
+#define FSKIT_CAPTURE_OP_RMDIR          7       // path
+#define FSKIT_CAPTURE_OP_SYMLINK        8       // path is the target, path2 is the new link
+#define FSKIT_CAPTURE_OP_RENAME         9       // path to path2; args[0] is the FSKIT_RENAME_* flags
+#define FSKIT_CAPTURE_OP_LINK           10      // path to path2
+#define FSKIT_CAPTURE_OP_CHMOD          11      // path; args[0] is the mode
+#define FSKIT_CAPTURE_OP_CHOWN          12      // path; args[0] and args[1] are the new owner and group
+#define FSKIT_CAPTURE_OP_TRUNC          13      // path; args[0] is the size
+#define FSKIT_CAPTURE_OP_FTRUNC         14      // handle; args[0] is the size
+#define FSKIT_CAPTURE_OP_UTIME          15      // path; args[0] and args[1] are the atime and mtime in microseconds, if args[2] is set
+#define FSKIT_CAPTURE_OP_OPEN           16      // path, and the new handle; args[0] is the flags, args[1] the mode
+#define FSKIT_CAPTURE_OP_CREATE         17      // path, and the new handle; args[0] is the mode
+#define FSKIT_CAPTURE_OP_READ           18      // handle; args[0] is the length, args[1] the offset
+#define FSKIT_CAPTURE_OP_WRITE          19      // handle; args[0] is the length, args[1] the offset
+#define FSKIT_CAPTURE_OP_SYNC           20      // handle
+#define FSKIT_CAPTURE_OP_CLOSE          21      // handle
+#define FSKIT_CAPTURE_OP_STATVFS        22      // path
+#define FSKIT_CAPTURE_OP_SETXATTR       23      // path; path2 is the name; args[0] is the value length, args[1] the flags
+#define FSKIT_CAPTURE_OP_GETXATTR       24      // path; path2 is the name; args[0] is the buffer size
+#define FSKIT_CAPTURE_OP_LISTXATTR      25      // path; args[0] is the buffer size
+#define FSKIT_CAPTURE_OP_REMOVEXATTR    26      // path; path2 is the name
+#define FSKIT_CAPTURE_OP_OPENDIR        27      // path, and the new handle
+#define FSKIT_CAPTURE_OP_READDIR        28      // handle; the whole directory is listed
+#define FSKIT_CAPTURE_OP_CLOSEDIR       29      // handle
+#define FSKIT_CAPTURE_OP_ACCESS         30      // path; args[0] is the mask
+#define FSKIT_CAPTURE_OP_MAX            31
+
+struct fskit_capture;
+
+// one recorded call
+struct fskit_capture_rec {
+
+   int op;
+   int64_t rc;
+   uint64_t user;
+   uint64_t group;
+   uint64_t start_ns;           // since the capture began
+   uint64_t duration_ns;
+   uint64_t handle;             // ID of the handle the call used or returned, or 0
+   uint64_t args[3];
+   char const* path;
+   char const* path2;           // second path or xattr name, or NULL
+};
+
+// a capture, loaded into memory
+struct fskit_capture_trace {
+
+   struct fskit_capture_rec* recs;
+   uint64_t num_recs;
+
+   void* buf;                   // the mapped file; the records' strings point into it
+   size_t len;
+};
+
+FSKIT_C_LINKAGE_BEGIN 
+
+// recording
+int fskit_capture_open( struct fskit_capture** cap, char const* path );
+int fskit_capture_close( struct fskit_capture* cap );
+void fskit_capture_free( struct fskit_capture* cap );
+
+uint64_t fskit_capture_begin( struct fskit_capture* cap );
+int fskit_capture_record( struct fskit_capture* cap, uint64_t start, int op, uint64_t user, uint64_t group, uint64_t handle,
+                          char const* path, char const* path2, uint64_t arg0, uint64_t arg1, uint64_t arg2, int64_t rc );
+
+uint64_t fskit_capture_get_count( struct fskit_capture* cap );
+
+// reading
+int fskit_capture_trace_load( struct fskit_capture_trace* trace, char const* path );
+void fskit_capture_trace_free( struct fskit_capture_trace* trace );
+
+char const* fskit_capture_op_name( int op );
+
+FSKIT_C_LINKAGE_END 
+
+#endif
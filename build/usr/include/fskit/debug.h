@@ -0,0 +1,97 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _FSKIT_DEBUG_H_
+#define _FSKIT_DEBUG_H_
+
+#include <fskit/common.h>
+
+#define FSKIT_WHERESTR "%05d:%016llX: [fskit %16s:%04u] %s %s: "
+#define FSKIT_WHEREARG (int)getpid(), fskit_pthread_self(), __FILE__, __LINE__, __func__
+
+// log subsystems.  Each message belongs to one, by the file it comes from; see fskit_log_set_mask().
+#define FSKIT_LOG_CORE                  0       // entries, paths, locks, and library and core setup
+#define FSKIT_LOG_OPS                   1       // filesystem operations (open, mkdir, read, rename, ...)
+#define FSKIT_LOG_ROUTE                 2       // route tables and dispatch
+#define FSKIT_LOG_XATTR                 3       // extended attributes
+#define FSKIT_LOG_DATA                  4       // built-in file data
+#define FSKIT_LOG_DEFERRED              5       // background reclamation
+#define FSKIT_LOG_SNAPSHOT              6       // clones, snapshots, and checkpoints
+#define FSKIT_LOG_REPL                  7       // the REPL
+#define FSKIT_LOG_FUSE                  8       // fskit_fuse
+#define FSKIT_LOG_APP                   9       // everything outside of fskit
+#define FSKIT_LOG_NUM_SUBSYSTEMS        10
+
+#define FSKIT_LOG_ALL                   ((1ULL << FSKIT_LOG_NUM_SUBSYSTEMS) - 1)
+
+// longest message kept, including the prefix; longer ones are cut short
+#define FSKIT_LOG_MSG_MAX               512
+
+// a disabled level costs one branch.  An enabled one formats the message into this thread's log ring,
+// which a background thread writes out (see fskit_log_set_async()).
+// each call site works out its subsystem once, and keeps it in _fskit_log_subsystem.
+#define fskit_debug( format, ... ) \
+   do { \
+      if( FSKIT_GLOBAL_DEBUG_MESSAGES ) { \
+         static int _fskit_log_subsystem = -1; \
+         fskit_log( &_fskit_log_subsystem, "DEBUG", __FILE__, __LINE__, __func__, format, __VA_ARGS__ ); \
+      } \
+   } while(0)
+
+
+#define fskit_error( format, ... ) \
+   do { \
+      if( FSKIT_GLOBAL_ERROR_MESSAGES ) { \
+         static int _fskit_log_subsystem = -1; \
+         fskit_log( &_fskit_log_subsystem, "ERROR", __FILE__, __LINE__, __func__, format, __VA_ARGS__ ); \
+      } \
+   } while(0)
+
+
+FSKIT_C_LINKAGE_BEGIN 
+
+extern int FSKIT_GLOBAL_DEBUG_LOCKS;
+extern int FSKIT_GLOBAL_DEBUG_MESSAGES;
+extern int FSKIT_GLOBAL_ERROR_MESSAGES;
+
+void fskit_set_debug_level( int d );
+void fskit_set_error_level( int e );
+int fskit_get_debug_level();
+int fskit_get_error_level();
+
+// logging
+void fskit_log( int* subsystem, char const* level, char const* file, int line, char const* func, char const* format, ... ) __attribute__((format(printf, 6, 7)));
+
+void fskit_log_set_mask( uint64_t mask );
+uint64_t fskit_log_get_mask(void);
+void fskit_log_set_async( bool async );
+bool fskit_log_get_async(void);
+void fskit_log_set_fd( int fd );
+void fskit_log_flush(void);
+uint64_t fskit_log_get_dropped(void);
+char const* fskit_log_subsystem_name( int subsystem );
+
+// portable cast pthread_t to uint64_t 
+unsigned long long int fskit_pthread_self(void);
+
+FSKIT_C_LINKAGE_END 
+
+#endif
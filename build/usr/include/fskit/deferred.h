@@ -0,0 +1,46 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _FSKIT_DEFERRED_H_
+#define _FSKIT_DEFERRED_H_
+
+#include <fskit/common.h>
+#include <fskit/debug.h>
+#include <fskit/entry.h>
+
+// default number of reaper threads per core
+#define FSKIT_DEFERRED_DEFAULT_THREADS  1
+
+FSKIT_C_LINKAGE_BEGIN 
+
+// unlink now, reclaim in the background
+int fskit_deferred_remove( struct fskit_core* core, char const* child_path, struct fskit_entry* child );
+int fskit_deferred_remove_all( struct fskit_core* core, char const* child_path, struct fskit_entry* child );
+
+// reclamation control
+int fskit_deferred_set_threads( struct fskit_core* core, int num_threads );
+int fskit_deferred_set_max_pending( struct fskit_core* core, uint64_t max_pending );
+uint64_t fskit_deferred_get_pending( struct fskit_core* core );
+int fskit_deferred_wait( struct fskit_core* core );
+
+FSKIT_C_LINKAGE_END 
+
+#endif
@@ -0,0 +1,93 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _FSKIT_FUSE_STATS_H_
+#define _FSKIT_FUSE_STATS_H_
+
+#include <fskit/fuse/fskit_fuse.h>
+
+// reserved virtual paths.  These are served by fskit_fuse, and are never routed to the application.
+// reading FSKIT_FUSE_STATS_PATH yields the per-operation counters; writing to it resets them.
+#define FSKIT_FUSE_STATS_DIR            "/.fskit"
+#define FSKIT_FUSE_STATS_PATH           "/.fskit/stats"
+
+// latency histogram buckets: bucket i counts operations that took less than 2^i microseconds.
+// the last bucket counts everything slower.
+#define FSKIT_FUSE_STATS_NUM_BUCKETS    24
+
+// instrumented operations
+#define FSKIT_FUSE_OP_GETATTR           0
+#define FSKIT_FUSE_OP_READLINK          1
+#define FSKIT_FUSE_OP_MKNOD             2
+#define FSKIT_FUSE_OP_MKDIR             3
+#define FSKIT_FUSE_OP_UNLINK            4
+#define FSKIT_FUSE_OP_RMDIR             5
+#define FSKIT_FUSE_OP_SYMLINK           6
+#define FSKIT_FUSE_OP_RENAME            7
+#define FSKIT_FUSE_OP_LINK              8
+#define FSKIT_FUSE_OP_CHMOD             9
+#define FSKIT_FUSE_OP_CHOWN             10
+#define FSKIT_FUSE_OP_TRUNCATE          11
+#define FSKIT_FUSE_OP_UTIME             12
+#define FSKIT_FUSE_OP_OPEN              13
+#define FSKIT_FUSE_OP_READ              14
+#define FSKIT_FUSE_OP_WRITE             15
+#define FSKIT_FUSE_OP_STATFS            16
+#define FSKIT_FUSE_OP_FLUSH             17
+#define FSKIT_FUSE_OP_RELEASE           18
+#define FSKIT_FUSE_OP_FSYNC             19
+#define FSKIT_FUSE_OP_SETXATTR          20
+#define FSKIT_FUSE_OP_GETXATTR          21
+#define FSKIT_FUSE_OP_LISTXATTR         22
+#define FSKIT_FUSE_OP_REMOVEXATTR       23
+#define FSKIT_FUSE_OP_OPENDIR           24
+#define FSKIT_FUSE_OP_READDIR           25
+#define FSKIT_FUSE_OP_RELEASEDIR        26
+#define FSKIT_FUSE_OP_FSYNCDIR          27
+#define FSKIT_FUSE_OP_ACCESS            28
+#define FSKIT_FUSE_OP_CREATE            29
+#define FSKIT_FUSE_OP_FTRUNCATE         30
+#define FSKIT_FUSE_OP_FGETATTR          31
+#define FSKIT_FUSE_OP_NUM_OPS           32
+
+FSKIT_C_LINKAGE_BEGIN
+
+struct fskit_fuse_stats;
+
+// lifecycle
+struct fskit_fuse_stats* fskit_fuse_stats_new();
+void fskit_fuse_stats_free( struct fskit_fuse_stats* stats );
+
+// recording
+void fskit_fuse_stats_begin( struct timespec* start );
+void fskit_fuse_stats_record( struct fskit_fuse_stats* stats, int op, struct timespec const* start, ssize_t rc );
+void fskit_fuse_stats_reset( struct fskit_fuse_stats* stats );
+
+// reporting
+char const* fskit_fuse_stats_op_name( int op );
+int fskit_fuse_stats_render( struct fskit_fuse_stats* stats, char** buf, size_t* len );
+
+// instrumented operations that wrap the state's operations and serve the reserved paths
+struct fuse_operations fskit_fuse_stats_get_opers( struct fuse_operations const* ops );
+
+FSKIT_C_LINKAGE_END
+
+#endif
@@ -0,0 +1,71 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _FSKIT_READDIR_H_
+#define _FSKIT_READDIR_H_
+
+#include <fskit/debug.h>
+#include <fskit/entry.h>
+
+#include <stddef.h>
+
+// packed directory record, as filled in by fskit_readdir_packed (cf. getdents(2)).
+// records are variable-length and 8-byte aligned; name is NUL-terminated.
+struct fskit_packed_dirent {
+   uint64_t file_id;    // file ID
+   uint16_t reclen;     // length of this record, including padding
+   uint16_t namelen;    // length of name, not including the NUL
+   uint8_t type;        // type of file
+   char name[];         // name of file
+};
+
+// size of a packed record for a name of the given length
+#define FSKIT_PACKED_DIRENT_RECLEN( namelen ) ((offsetof(struct fskit_packed_dirent, name) + (namelen) + 1 + 7) & ~((size_t)7))
+
+// advance to the next packed record in a buffer
+#define FSKIT_PACKED_DIRENT_NEXT( d ) ((struct fskit_packed_dirent*)((char*)(d) + (d)->reclen))
+
+// position in a packed directory stream.  A zeroed cookie means "start of directory".
+// it is independent of the directory handle, so several streams can share one handle.
+struct fskit_readdir_cookie {
+   char name[FSKIT_FILESYSTEM_NAMEMAX+1];       // last name returned
+};
+
+FSKIT_C_LINKAGE_BEGIN 
+
+struct fskit_dir_entry** fskit_readdir( struct fskit_core* core, struct fskit_dir_handle* dirh, uint64_t num_children, uint64_t* num_read, int* err );
+struct fskit_dir_entry** fskit_listdir( struct fskit_core* core, struct fskit_dir_handle* dirh, uint64_t* num_read, int* err );
+struct fskit_dir_entry** fskit_listdir_locked( struct fskit_core* core, struct fskit_entry* dent, uint64_t* num_read, int* err );
+
+ssize_t fskit_readdir_packed( struct fskit_core* core, struct fskit_dir_handle* dirh, struct fskit_readdir_cookie* cookie, void* buf, size_t buf_len );
+
+void fskit_dir_entry_free_list( struct fskit_dir_entry** dir_ents );
+void fskit_dir_entry_free( struct fskit_dir_entry* d_ent );
+
+int fskit_readdir_omit( struct fskit_dir_entry** dents, int i );
+
+void fskit_seekdir( struct fskit_dir_handle* dirh, off_t loc );
+off_t fskit_telldir( struct fskit_dir_handle* dirh );
+void fskit_rewinddir( struct fskit_dir_handle* dirh );
+
+FSKIT_C_LINKAGE_END 
+
+#endif
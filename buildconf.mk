@@ -53,11 +53,44 @@ ifeq ($(REPL),1)
    REPL_DEF := -D_FSKIT_REPL
 endif
 
+# build libfskit_fuse against libfuse3 instead of libfuse2
+FUSE3 ?= 0
+FUSE_DEF :=
+FUSE_PKG := fuse
+FUSE_LIB := -lfuse
+ifeq ($(FUSE3),1)
+   FUSE_DEF := -DFSKIT_FUSE3
+   FUSE_PKG := fuse3
+   FUSE_LIB := -lfuse3
+endif
+
+# track the writer in each inode, handle, and route lock, to catch self-deadlock and foreign unlocks
+LOCK_DEBUG ?= 0
+LOCK_DEBUG_DEF :=
+ifeq ($(LOCK_DEBUG),1)
+   LOCK_DEBUG_DEF := -DFSKIT_RWLOCK_DEBUG
+endif
+
+# compile in USDT probes for perf and bpftrace (see include/fskit_private/trace.h).  Needs <sys/sdt.h>.
+USDT ?= 0
+USDT_DEF :=
+ifeq ($(USDT),1)
+   USDT_DEF := -DFSKIT_USDT
+endif
+
+# build everything with ThreadSanitizer (e.g. to run test/test-torture).  Use a clean tree when toggling this.
+TSAN ?= 0
+TSAN_FLAGS :=
+ifeq ($(TSAN),1)
+   TSAN_FLAGS := -fsanitize=thread
+endif
+
 # compiler
-CCFLAGS     := -Wall -std=c11 -g -fPIC -fstack-protector -fstack-protector-all -pthread -Wno-unused-variable -Wno-unused-but-set-variable
-CXXFLAGS   := -Wall -g -fPIC -fstack-protector -fstack-protector-all -pthread -Wno-unused-variable -Wno-unused-but-set-variable
+CCFLAGS     := -Wall -std=c11 -g -fPIC -fstack-protector -fstack-protector-all -pthread -Wno-unused-variable -Wno-unused-but-set-variable $(TSAN_FLAGS)
+CXXFLAGS   := -Wall -g -fPIC -fstack-protector -fstack-protector-all -pthread -Wno-unused-variable -Wno-unused-but-set-variable $(TSAN_FLAGS)
+CFLAGS     += $(TSAN_FLAGS)
 INC      := -I. -I$(ROOT_DIR) -I$(BUILD_INCLUDEDIR) -I$(BUILD)
-DEFS     := -D_THREAD_SAFE -D__STDC_FORMAT_MACROS $(REPL_DEF)
+DEFS     := -D_THREAD_SAFE -D__STDC_FORMAT_MACROS $(REPL_DEF) $(LOCK_DEBUG_DEF) $(USDT_DEF)
 LIBINC   := -L. -L$(BUILD_USRLIB)
 CC       ?= cc
 CXX      ?= c++
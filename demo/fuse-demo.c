@@ -25,17 +25,12 @@
  *
  * Usage:
  *    ./fuse-demo [fuse opts] mountpoint_dir
+ *
+ * Set FSKIT_CAPTURE to a path to record every call there, for replay with the REPL's "replay" command.
  */
 
 #include "fuse-demo.h"
 
-// fskit inode data 
-struct demo_inode {
-   char* buf;
-   size_t capacity;
-   size_t size;
-};
-
 // fskit file handle data
 struct demo_fd {
    uint64_t num_reads;
@@ -43,30 +38,18 @@ struct demo_fd {
 };
 
 // file create callback
-// create a file descriptor to a new file backed by RAM
+// create a file descriptor to a new file.  fskit keeps its data (see fskit_data_route).
 int create_cb( struct fskit_core* core, struct fskit_route_metadata* grp, struct fskit_entry* fent, mode_t mode, void** inode_data, void** handle_data ) {
 
-   char buf[17];
-   char* path = NULL;
-   int rc = 0;
-   
-   struct demo_inode* di = (struct demo_inode*)calloc( sizeof(struct demo_inode), 1 );
-
-   if( di == NULL ) {
-       return -ENOMEM;
-   }
-   
    struct demo_fd* dfd = (struct demo_fd*)calloc( sizeof(struct demo_fd), 1 );
    
    if( dfd == NULL ) {
-       free( di );
        return -ENOMEM;
    }
    
-   *inode_data = (void*)di;
    *handle_data = (void*)dfd;
    
-   return rc;
+   return 0;
 }
 
 // file open callback
@@ -105,78 +88,31 @@ int close_cb( struct fskit_core* core, struct fskit_route_metadata* grp, struct
 }
 
 // file read callback
-// copy out of the inode's buffer
+// read from fskit's copy of the data, and count the bytes
 int read_cb( struct fskit_core* core, struct fskit_route_metadata* grp, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data ) {
 
    struct demo_fd* dfd = (struct demo_fd*)handle_data;
-   struct demo_inode* di = (struct demo_inode*)fskit_entry_get_user_data( fent );
    
-   int max_read = 0;
-   
-   if( offset < 0 || (unsigned)offset >= di->size ) {
-       // EOF 
-       return 0;
+   int rc = fskit_data_read_cb( core, grp, fent, buf, buflen, offset, handle_data );
+   if( rc > 0 ) {
+      __atomic_fetch_add( &dfd->num_reads, rc, __ATOMIC_RELAXED );
    }
-   
-   max_read = (offset + buflen > di->size ? (di->size - offset) : buflen );
-   
-   memcpy( buf, di->buf + offset, max_read );
-   
-   dfd->num_reads += max_read;
 
-   return max_read;
+   return rc;
 }
 
 // file write callback
-// fill in the inode's buffer
+// write to fskit's copy of the data, and count the bytes
 int write_cb( struct fskit_core* core, struct fskit_route_metadata* grp, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data ) {
 
    struct demo_fd* dfd = (struct demo_fd*)handle_data;
-   struct demo_inode* di = (struct demo_inode*)fskit_entry_get_user_data( fent );
    
-   if( buflen + offset > di->capacity ) {
-       
-       if( di->capacity == 0 ) {
-           di->capacity = 1;
-       }
-       
-       int exp = (int)(log2( buflen + offset )) + 1;
-       di->capacity = 1L << exp;
-       
-       char* tmp = (char*)realloc( di->buf, di->capacity );
-       if( tmp == NULL ) {
-           return -ENOMEM;
-       }
-       
-       di->buf = tmp;
+   int rc = fskit_data_write_cb( core, grp, fent, buf, buflen, offset, handle_data );
+   if( rc > 0 ) {
+      __atomic_fetch_add( &dfd->num_writes, rc, __ATOMIC_RELAXED );
    }
-   
-   memcpy( di->buf, buf, buflen );
-   
-   dfd->num_writes += buflen;
-   
-   di->size = (di->size > buflen + offset ? di->size : buflen + offset);
-
-   return (int)buflen;
-}
-
-// file destroy callback
-// free memory 
-int destroy_cb( struct fskit_core* core, struct fskit_route_metadata* grp, struct fskit_entry* fent, void* inode_data ) {
-
-   struct demo_inode* di = (struct demo_inode*)fskit_entry_get_user_data( fent );
-   
-   if( di == NULL ) {
-       return 0;
-   }
-   
-   if( di->buf != NULL ) {
-      free( di->buf );
-   }
-   
-   free( di );
 
-   return 0;
+   return rc;
 }
 
 void usage( char const* progname ) {
@@ -212,19 +148,29 @@ int main( int argc, char** argv ) {
 
    core = fskit_fuse_get_core( state );
 
-   // add handlers.  reads and writes must happen sequentially, since we seek and then perform I/O
+   // add handlers.  fskit's page store does its own locking, so reads and writes can all run concurrently.
    // NOTE: FSKIT_ROUTE_ANY matches any path, and is a macro for the regex "/([^/]+[/]*)*"
    fskit_route_create( core, FSKIT_ROUTE_ANY, create_cb,  FSKIT_CONCURRENT );
    fskit_route_open(   core, FSKIT_ROUTE_ANY, open_cb,    FSKIT_CONCURRENT );
-   fskit_route_read(   core, FSKIT_ROUTE_ANY, read_cb,    FSKIT_SEQUENTIAL );
-   fskit_route_write(  core, FSKIT_ROUTE_ANY, write_cb,   FSKIT_SEQUENTIAL );
+   fskit_route_read(   core, FSKIT_ROUTE_ANY, read_cb,    FSKIT_CONCURRENT );
+   fskit_route_write(  core, FSKIT_ROUTE_ANY, write_cb,   FSKIT_CONCURRENT );
+   fskit_route_trunc(  core, FSKIT_ROUTE_ANY, fskit_data_trunc_cb, FSKIT_CONCURRENT );
    fskit_route_close(  core, FSKIT_ROUTE_ANY, close_cb,   FSKIT_CONCURRENT );
-   fskit_route_destroy(core, FSKIT_ROUTE_ANY, destroy_cb, FSKIT_CONCURRENT );
 
    // set the root to be owned by the effective UID and GID of user
    fskit_chown( core, "/", 0, 0, geteuid(), getegid() );
    fskit_chmod( core, "/", 0, 0, 0755 );
 
+   // capture calls, if asked
+   if( getenv("FSKIT_CAPTURE") != NULL ) {
+
+      rc = fskit_fuse_capture_start( state, getenv("FSKIT_CAPTURE") );
+      if( rc != 0 ) {
+         fprintf(stderr, "fskit_fuse_capture_start('%s') rc = %d\n", getenv("FSKIT_CAPTURE"), rc );
+         exit(1);
+      }
+   }
+
    // run
    rc = fskit_fuse_main( state, argc, argv );
 
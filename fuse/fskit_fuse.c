@@ -20,8 +20,11 @@
 */
 
 #include <fskit/fuse/fskit_fuse.h>
+#include <fskit/fuse/fskit_fuse_stats.h>
 #include <sys/types.h>
 
+#include "fskit_private/trace.h"
+
 struct fskit_fuse_state {
 
    struct fskit_core* core;
@@ -34,10 +37,24 @@ struct fskit_fuse_state {
    fskit_fuse_postmount_callback_t postmount;
    void* postmount_cls;
 
+   // (libfuse3 only) maximum number of idle worker threads (0 for libfuse's default)
+   unsigned int max_idle_threads;
+
    // operations
    struct fuse_operations ops;
+
+   // per-operation stats, and the instrumented operations that FUSE calls when they're enabled
+   struct fskit_fuse_stats* stats;
+   struct fuse_operations stats_ops;
+
+   // call capture, if one was started.  Once set, it stays until the state is freed.
+   struct fskit_capture* capture;
 };
 
+// time a call, and record it to the state's capture (if there is one)
+#define FSKIT_FUSE_CAPTURE_BEGIN( state ) fskit_capture_begin( __atomic_load_n( &(state)->capture, __ATOMIC_ACQUIRE ) )
+#define FSKIT_FUSE_CAPTURE( state, cap_start, ... ) fskit_capture_record( __atomic_load_n( &(state)->capture, __ATOMIC_ACQUIRE ), cap_start, __VA_ARGS__ )
+
 
 struct fskit_fuse_state* fskit_fuse_state_new() {
    return (struct fskit_fuse_state*)calloc( sizeof( struct fskit_fuse_state ), 1 );
@@ -45,6 +62,8 @@ struct fskit_fuse_state* fskit_fuse_state_new() {
 
 void fskit_fuse_state_free( struct fskit_fuse_state* state ) {
    if( state != NULL ) {
+       fskit_fuse_stats_free( state->stats );
+       fskit_capture_free( state->capture );
        free( state );
    }
 }
@@ -107,6 +126,57 @@ struct fuse_operations* fskit_fuse_get_ops( struct fskit_fuse_state* state ) {
    return &state->ops;
 }
 
+// get per-operation stats (NULL if they could not be allocated)
+struct fskit_fuse_stats* fskit_fuse_get_stats( struct fskit_fuse_state* state ) {
+   return state->stats;
+}
+
+// start capturing calls to a new capture file at path (see fskit/capture.h).
+// only one capture can be taken per state.
+// return 0 on success
+// return -EALREADY if a capture was already started
+// return -errno if the capture could not be created
+int fskit_fuse_capture_start( struct fskit_fuse_state* state, char const* path ) {
+
+   struct fskit_capture* cap = NULL;
+   struct fskit_capture* expected = NULL;
+   int rc = 0;
+
+   if( __atomic_load_n( &state->capture, __ATOMIC_ACQUIRE ) != NULL ) {
+      return -EALREADY;
+   }
+
+   rc = fskit_capture_open( &cap, path );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   if( !__atomic_compare_exchange_n( &state->capture, &expected, cap, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED ) ) {
+
+      // lost a race
+      fskit_capture_free( cap );
+      unlink( path );
+      return -EALREADY;
+   }
+
+   return 0;
+}
+
+// stop capturing calls, and flush the capture to disk.
+// return 0 on success
+// return -EINVAL if no capture was started
+// return -errno if the capture could not be written
+int fskit_fuse_capture_stop( struct fskit_fuse_state* state ) {
+
+   struct fskit_capture* cap = __atomic_load_n( &state->capture, __ATOMIC_ACQUIRE );
+
+   if( cap == NULL ) {
+      return -EINVAL;
+   }
+
+   return fskit_capture_close( cap );
+}
+
 // enable a setting
 int fskit_fuse_setting_enable( struct fskit_fuse_state* state, uint64_t flag ) {
    state->settings |= flag;
@@ -119,6 +189,13 @@ int fskit_fuse_setting_disable( struct fskit_fuse_state* state, uint64_t flag )
    return 0;
 }
 
+// set the maximum number of idle worker threads.
+// only meaningful for the libfuse3 frontend; libfuse2 does not bound its thread pool
+int fskit_fuse_set_max_idle_threads( struct fskit_fuse_state* state, unsigned int max_idle_threads ) {
+   state->max_idle_threads = max_idle_threads;
+   return 0;
+}
+
 // enable a callback
 int fskit_fuse_callback_enable( struct fskit_fuse_state* state, uint64_t callback_id ) {
    state->callbacks |= callback_id;
@@ -166,7 +243,18 @@ struct fskit_fuse_file_info* fskit_fuse_make_dir_handle( struct fskit_dir_handle
    return ffi;
 }
 
+#ifdef FSKIT_FUSE3
+int fskit_fuse_fgetattr(const char *path, struct stat *statbuf, struct fuse_file_info *fi);
+
+// libfuse3 folds fgetattr into getattr
+int fskit_fuse_getattr(const char *path, struct stat *statbuf, struct fuse_file_info *fi) {
+
+   if( fi != NULL ) {
+      return fskit_fuse_fgetattr( path, statbuf, fi );
+   }
+#else
 int fskit_fuse_getattr(const char *path, struct stat *statbuf) {
+#endif
 
    struct fskit_fuse_state* state = fskit_fuse_get_state();
    if( (state->callbacks & FSKIT_FUSE_GETATTR) == 0 ) {
@@ -178,7 +266,11 @@ int fskit_fuse_getattr(const char *path, struct stat *statbuf) {
 
    fskit_debug("getattr(%s, %p, %d, %d)\n", path, statbuf, uid, gid );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_GETATTR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_stat( state->core, path, uid, gid, statbuf );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_STAT, uid, gid, 0, path, NULL, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_GETATTR, path, rc );
 
    fskit_debug("getattr(%s, %p, %d, %d) rc = %d\n", path, statbuf, uid, gid, rc );
 
@@ -199,7 +291,11 @@ int fskit_fuse_readlink(const char *path, char *link, size_t size) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_READLINK, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    rc = fskit_readlink( state->core, path, uid, gid, link, size );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_READLINK, uid, gid, 0, path, NULL, size, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_READLINK, path, rc );
 
    if( rc >= 0 ) {
       rc = 0;
@@ -223,7 +319,11 @@ int fskit_fuse_mknod(const char *path, mode_t mode, dev_t dev) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_MKNOD, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_mknod( state->core, path, mode, dev, uid, gid );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_MKNOD, uid, gid, 0, path, NULL, mode, dev, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_MKNOD, path, rc );
 
    fskit_debug("mknod(%s, %o, %d, %d) rc = %d\n", path, mode, major(dev), minor(dev), rc );
 
@@ -242,7 +342,11 @@ int fskit_fuse_mkdir(const char *path, mode_t mode) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_MKDIR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_mkdir( state->core, path, mode, uid, gid );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_MKDIR, uid, gid, 0, path, NULL, mode, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_MKDIR, path, rc );
 
    fskit_debug("mkdir(%s, %o) rc = %d\n", path, mode, rc );
 
@@ -261,7 +365,11 @@ int fskit_fuse_unlink(const char *path) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_UNLINK, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_unlink( state->core, path, uid, gid );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_UNLINK, uid, gid, 0, path, NULL, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_UNLINK, path, rc );
 
    fskit_debug("unlink(%s) rc = %d\n", path, rc );
 
@@ -280,7 +388,11 @@ int fskit_fuse_rmdir(const char *path) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_RMDIR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_rmdir( state->core, path, uid, gid );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_RMDIR, uid, gid, 0, path, NULL, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_RMDIR, path, rc );
 
    fskit_debug("rmdir(%s) rc = %d\n", path, rc );
 
@@ -300,27 +412,45 @@ int fskit_fuse_symlink(const char *target, const char *linkpath) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_SYMLINK, linkpath );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    rc = fskit_symlink( state->core, target, linkpath, uid, gid );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_SYMLINK, uid, gid, 0, target, linkpath, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_SYMLINK, linkpath, rc );
 
    fskit_debug("symlink(%s, %s) rc = %d\n", target, linkpath, rc );
    return rc;
 }
 
+#ifdef FSKIT_FUSE3
+int fskit_fuse_rename(const char *path, const char *newpath, unsigned int flags) {
+#else
 int fskit_fuse_rename(const char *path, const char *newpath) {
+#endif
 
    struct fskit_fuse_state* state = fskit_fuse_get_state();
    if( (state->callbacks & FSKIT_FUSE_RENAME) == 0 ) {
       return -ENOSYS;
    }
 
-   fskit_debug("rename(%s, %s)\n", path, newpath );
+#ifndef FSKIT_FUSE3
+   // no renameat2(2) flags in this FUSE version
+   unsigned int flags = 0;
+#endif
+
+   fskit_debug("rename(%s, %s, %x)\n", path, newpath, flags );
 
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
-   int rc = fskit_rename( state->core, path, newpath, uid, gid );
+   // RENAME_NOREPLACE and RENAME_EXCHANGE have the same values as FSKIT_RENAME_NOREPLACE and FSKIT_RENAME_EXCHANGE
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_RENAME, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
+   int rc = fskit_rename2( state->core, path, newpath, uid, gid, flags );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_RENAME, uid, gid, 0, path, newpath, flags, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_RENAME, path, rc );
 
-   fskit_debug("rename(%s, %s) rc = %d\n", path, newpath, rc );
+   fskit_debug("rename(%s, %s, %x) rc = %d\n", path, newpath, flags, rc );
 
    return rc;
 }
@@ -337,14 +467,22 @@ int fskit_fuse_link(const char *path, const char *newpath) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_LINK, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_link( state->core, path, newpath, uid, gid );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_LINK, uid, gid, 0, path, newpath, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_LINK, path, rc );
 
    fskit_debug("link(%s, %s) rc = %d\n", path, newpath, rc );
 
    return 0;
 }
 
+#ifdef FSKIT_FUSE3
+int fskit_fuse_chmod(const char *path, mode_t mode, struct fuse_file_info *fi) {
+#else
 int fskit_fuse_chmod(const char *path, mode_t mode) {
+#endif
 
    struct fskit_fuse_state* state = fskit_fuse_get_state();
    if( (state->callbacks & FSKIT_FUSE_CHMOD) == 0 ) {
@@ -356,14 +494,22 @@ int fskit_fuse_chmod(const char *path, mode_t mode) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_CHMOD, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_chmod( state->core, path, uid, gid, mode );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_CHMOD, uid, gid, 0, path, NULL, mode, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_CHMOD, path, rc );
 
    fskit_debug("chmod(%s, %o) rc = %d\n", path, mode, rc );
 
    return rc;
 }
 
+#ifdef FSKIT_FUSE3
+int fskit_fuse_chown(const char *path, uid_t new_uid, gid_t new_gid, struct fuse_file_info *fi) {
+#else
 int fskit_fuse_chown(const char *path, uid_t new_uid, gid_t new_gid) {
+#endif
 
    struct fskit_fuse_state* state = fskit_fuse_get_state();
    if( (state->callbacks & FSKIT_FUSE_CHOWN) == 0 ) {
@@ -375,14 +521,29 @@ int fskit_fuse_chown(const char *path, uid_t new_uid, gid_t new_gid) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_CHOWN, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_chown( state->core, path, uid, gid, new_uid, new_gid );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_CHOWN, uid, gid, 0, path, NULL, new_uid, new_gid, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_CHOWN, path, rc );
 
    fskit_debug("chown(%s, %d, %d) rc = %d\n", path, new_uid, new_gid, rc );
 
    return rc;
 }
 
+#ifdef FSKIT_FUSE3
+int fskit_fuse_ftruncate(const char *path, off_t new_size, struct fuse_file_info *fi);
+
+// libfuse3 folds ftruncate into truncate
+int fskit_fuse_truncate(const char *path, off_t newsize, struct fuse_file_info *fi) {
+
+   if( fi != NULL ) {
+      return fskit_fuse_ftruncate( path, newsize, fi );
+   }
+#else
 int fskit_fuse_truncate(const char *path, off_t newsize) {
+#endif
 
    struct fskit_fuse_state* state = fskit_fuse_get_state();
    if( (state->callbacks & FSKIT_FUSE_TRUNCATE) == 0 ) {
@@ -394,13 +555,78 @@ int fskit_fuse_truncate(const char *path, off_t newsize) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_TRUNCATE, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_trunc( state->core, path, uid, gid, newsize );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_TRUNC, uid, gid, 0, path, NULL, newsize, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_TRUNCATE, path, rc );
 
    fskit_debug("truncate(%s, %jd) rc = %d\n", path, newsize, rc );
 
    return rc;
 }
 
+#ifdef FSKIT_FUSE3
+
+// libfuse3 replaces utime with utimens.
+// UTIME_NOW and UTIME_OMIT are resolved here, since fskit_utimes sets both times.
+int fskit_fuse_utimens(const char *path, const struct timespec tv[2], struct fuse_file_info *fi) {
+
+   struct fskit_fuse_state* state = fskit_fuse_get_state();
+   if( (state->callbacks & FSKIT_FUSE_UTIME) == 0 ) {
+      return -ENOSYS;
+   }
+
+   fskit_debug("utimens(%s, %p)\n", path, tv );
+
+   uid_t uid = fskit_fuse_get_uid( state );
+   gid_t gid = fskit_fuse_get_gid( state );
+   struct timeval times[2];
+   struct timespec now;
+   struct stat sb;
+   int rc = 0;
+
+   memset( &sb, 0, sizeof(struct stat) );
+   clock_gettime( CLOCK_REALTIME, &now );
+
+   if( tv != NULL && (tv[0].tv_nsec == UTIME_OMIT || tv[1].tv_nsec == UTIME_OMIT) ) {
+
+      rc = fskit_stat( state->core, path, uid, gid, &sb );
+      if( rc != 0 ) {
+
+         fskit_debug("utimens(%s, %p) rc = %d\n", path, tv, rc );
+         return rc;
+      }
+   }
+
+   for( int i = 0; i < 2; i++ ) {
+
+      struct timespec ts = now;
+
+      if( tv != NULL && tv[i].tv_nsec == UTIME_OMIT ) {
+         ts = (i == 0 ? sb.st_atim : sb.st_mtim);
+      }
+      else if( tv != NULL && tv[i].tv_nsec != UTIME_NOW ) {
+         ts = tv[i];
+      }
+
+      times[i].tv_sec = ts.tv_sec;
+      times[i].tv_usec = ts.tv_nsec / 1000;
+   }
+
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_UTIME, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
+   rc = fskit_utimes( state->core, path, uid, gid, times );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_UTIME, uid, gid, 0, path, NULL, (uint64_t)times[0].tv_sec * 1000000 + times[0].tv_usec, (uint64_t)times[1].tv_sec * 1000000 + times[1].tv_usec, 1, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_UTIME, path, rc );
+
+   fskit_debug("utimens(%s, %p) rc = %d\n", path, tv, rc );
+
+   return rc;
+}
+
+#else
+
 int fskit_fuse_utime(const char *path, struct utimbuf *ubuf) {
 
    struct fskit_fuse_state* state = fskit_fuse_get_state();
@@ -413,13 +639,19 @@ int fskit_fuse_utime(const char *path, struct utimbuf *ubuf) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_UTIME, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_utime( state->core, path, uid, gid, ubuf );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_UTIME, uid, gid, 0, path, NULL, ubuf != NULL ? (uint64_t)ubuf->actime * 1000000 : 0, ubuf != NULL ? (uint64_t)ubuf->modtime * 1000000 : 0, ubuf != NULL, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_UTIME, path, rc );
 
    fskit_debug("utime(%s, %ld.%ld) rc = %d\n", path, ubuf->actime, ubuf->modtime, rc );
 
    return rc;
 }
 
+#endif
+
 int fskit_fuse_open(const char *path, struct fuse_file_info *fi) {
 
    struct fskit_fuse_state* state = fskit_fuse_get_state();
@@ -435,7 +667,11 @@ int fskit_fuse_open(const char *path, struct fuse_file_info *fi) {
    struct fskit_fuse_file_info* ffi = NULL;
    int rc = 0;
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_OPEN, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    struct fskit_file_handle* fh = fskit_open( state->core, path, uid, gid, fi->flags, ~umask, &rc );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_OPEN, uid, gid, (uintptr_t)fh, path, NULL, fi->flags, ~umask, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_OPEN, path, rc );
 
    if( rc != 0 ) {
 
@@ -446,7 +682,9 @@ int fskit_fuse_open(const char *path, struct fuse_file_info *fi) {
    ffi = fskit_fuse_make_file_handle( fh );
    if( ffi == NULL ) {
 
-      fskit_close( state->core, fh );
+      cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
+      rc = fskit_close( state->core, fh );
+      FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_CLOSE, uid, gid, (uintptr_t)fh, NULL, NULL, 0, 0, 0, rc );
       return -ENOMEM;
    }
 
@@ -473,7 +711,11 @@ int fskit_fuse_read(const char *path, char *buf, size_t size, off_t offset, stru
    struct fskit_fuse_file_info* ffi = (struct fskit_fuse_file_info*)((uintptr_t)fi->fh);
    ssize_t num_read = 0;
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_READ, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    num_read = fskit_read( state->core, ffi->handle.fh, buf, size, offset );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_READ, 0, 0, (uintptr_t)ffi->handle.fh, NULL, NULL, size, offset, 0, num_read );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_READ, path, num_read );
 
    fskit_debug("read(%s, %p, %zu, %jd, %p) rc = %zd\n", path, buf, size, offset, fi, num_read);
 
@@ -492,7 +734,11 @@ int fskit_fuse_write(const char *path, const char *buf, size_t size, off_t offse
    struct fskit_fuse_file_info* ffi = (struct fskit_fuse_file_info*)((uintptr_t)fi->fh);
    ssize_t num_written = 0;
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_WRITE, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    num_written = fskit_write( state->core, ffi->handle.fh, buf, size, offset );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_WRITE, 0, 0, (uintptr_t)ffi->handle.fh, NULL, NULL, size, offset, 0, num_written );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_WRITE, path, num_written );
 
    fskit_debug("write(%s, %p, %zu, %jd, %p) rc = %zd\n", path, buf, size, offset, fi, num_written);
 
@@ -511,7 +757,11 @@ int fskit_fuse_statfs(const char *path, struct statvfs *statv) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_STATFS, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_statvfs( state->core, path, uid, gid, statv );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_STATVFS, uid, gid, 0, path, NULL, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_STATFS, path, rc );
 
    fskit_debug("statfs(%s, %p) rc = %d\n", path, statv, rc );
 
@@ -530,11 +780,15 @@ int fskit_fuse_flush(const char *path, struct fuse_file_info *fi) {
   
    // if this is a file, then fsync it
    struct fskit_fuse_file_info* ffi = (struct fskit_fuse_file_info*)((uintptr_t)fi->fh);
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_FLUSH, path );
    if( ffi->type == FSKIT_ENTRY_TYPE_FILE ) {
 
        // same as fsync 
+       uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
        rc = fskit_fsync( state->core, ffi->handle.fh );
+       FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_SYNC, 0, 0, (uintptr_t)ffi->handle.fh, NULL, NULL, 0, 0, 0, rc );
    }
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_FLUSH, path, rc );
 
    fskit_debug("flush(%s, %p) rc = %d\n", path, fi, rc);
    return rc;
@@ -551,7 +805,11 @@ int fskit_fuse_release(const char *path, struct fuse_file_info *fi) {
 
    struct fskit_fuse_file_info* ffi = (struct fskit_fuse_file_info*)((uintptr_t)fi->fh);
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_RELEASE, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_close( state->core, ffi->handle.fh );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_CLOSE, 0, 0, (uintptr_t)ffi->handle.fh, NULL, NULL, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_RELEASE, path, rc );
 
    if( rc == 0 ) {
       free( ffi );
@@ -572,7 +830,11 @@ int fskit_fuse_fsync(const char *path, int datasync, struct fuse_file_info *fi)
 
    struct fskit_fuse_file_info* ffi = (struct fskit_fuse_file_info*)((uintptr_t)fi->fh);
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_FSYNC, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_fsync( state->core, ffi->handle.fh );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_SYNC, 0, 0, (uintptr_t)ffi->handle.fh, NULL, NULL, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_FSYNC, path, rc );
 
    fskit_debug("fsync(%s, %d, %p) rc = %d\n", path, datasync, fi, rc );
    return rc;
@@ -590,7 +852,11 @@ int fskit_fuse_setxattr(const char *path, const char *name, const char *value, s
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_SETXATTR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_setxattr( state->core, path, uid, gid, name, value, size, flags );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_SETXATTR, uid, gid, 0, path, name, size, flags, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_SETXATTR, path, rc );
 
    fskit_debug("setxattr(%s, %s, %p, %zu, %X) rc = %d\n", path, name, value, size, flags, rc );
    return rc;
@@ -608,7 +874,11 @@ int fskit_fuse_getxattr(const char *path, const char *name, char *value, size_t
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_GETXATTR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_getxattr( state->core, path, uid, gid, name, value, size );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_GETXATTR, uid, gid, 0, path, name, size, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_GETXATTR, path, rc );
 
    fskit_debug("getxattr(%s, %s, %p, %zu) rc = %d\n", path, name, value, size, rc );
    return rc;
@@ -626,7 +896,11 @@ int fskit_fuse_listxattr(const char *path, char *list, size_t size) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_LISTXATTR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_listxattr( state->core, path, uid, gid, list, size );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_LISTXATTR, uid, gid, 0, path, NULL, size, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_LISTXATTR, path, rc );
 
    fskit_debug("listxattr(%s, %p, %zu) rc = %d\n", path, list, size, rc );
    return rc;
@@ -644,7 +918,11 @@ int fskit_fuse_removexattr(const char *path, const char *name) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_REMOVEXATTR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_removexattr( state->core, path, uid, gid, name );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_REMOVEXATTR, uid, gid, 0, path, name, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_REMOVEXATTR, path, rc );
 
    fskit_debug("removexattr(%s, %s) rc = %d\n", path, name, rc );
    return rc;
@@ -664,7 +942,11 @@ int fskit_fuse_opendir(const char *path, struct fuse_file_info *fi) {
    struct fskit_fuse_file_info* ffi = NULL;
    int rc = 0;
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_OPENDIR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    struct fskit_dir_handle* dh = fskit_opendir( state->core, path, uid, gid, &rc );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_OPENDIR, uid, gid, (uintptr_t)dh, path, NULL, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_OPENDIR, path, rc );
 
    if( rc != 0 ) {
 
@@ -675,7 +957,10 @@ int fskit_fuse_opendir(const char *path, struct fuse_file_info *fi) {
    ffi = fskit_fuse_make_dir_handle( dh );
 
    if( ffi == NULL ) {
-      fskit_closedir( state->core, dh );
+
+      cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
+      rc = fskit_closedir( state->core, dh );
+      FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_CLOSEDIR, uid, gid, (uintptr_t)dh, NULL, NULL, 0, 0, 0, rc );
 
       fskit_debug("opendir(%s, %p) rc = %d\n", path, fi, -ENOMEM );
       return -ENOMEM;
@@ -687,7 +972,11 @@ int fskit_fuse_opendir(const char *path, struct fuse_file_info *fi) {
    return 0;
 }
 
+#ifdef FSKIT_FUSE3
+int fskit_fuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi, enum fuse_readdir_flags flags) {
+#else
 int fskit_fuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi) {
+#endif
 
    struct fskit_fuse_state* state = fskit_fuse_get_state();
    if( (state->callbacks & FSKIT_FUSE_READDIR) == 0 ) {
@@ -704,7 +993,11 @@ int fskit_fuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_
    ffi = (struct fskit_fuse_file_info*)((uintptr_t)fi->fh);
    fdh = ffi->handle.dh;
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_READDIR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    struct fskit_dir_entry** dirents = fskit_listdir( state->core, fdh, &num_read, &rc );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_READDIR, 0, 0, (uintptr_t)fdh, NULL, NULL, num_read, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_READDIR, path, rc );
 
    if( dirents == NULL || rc != 0 ) {
       fskit_debug("readdir(%s, %jd, %p, %p) rc = %d\n", path, offset, buf, fi, rc );
@@ -713,7 +1006,11 @@ int fskit_fuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_
 
    for( uint64_t i = 0; i < num_read; i++ ) {
 
+#ifdef FSKIT_FUSE3
+      rc = filler( buf, dirents[i]->name, NULL, 0, 0 );
+#else
       rc = filler( buf, dirents[i]->name, NULL, 0 );
+#endif
       if( rc != 0 ) {
          rc = -ENOMEM;
          break;
@@ -744,7 +1041,11 @@ int fskit_fuse_releasedir(const char *path, struct fuse_file_info *fi) {
 
    ffi = (struct fskit_fuse_file_info*)((uintptr_t)fi->fh);
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_RELEASEDIR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    rc = fskit_closedir( state->core, ffi->handle.dh );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_CLOSEDIR, 0, 0, (uintptr_t)ffi->handle.dh, NULL, NULL, 0, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_RELEASEDIR, path, rc );
 
    free( ffi );
 
@@ -764,6 +1065,8 @@ int fskit_fuse_fsyncdir(const char *path, int datasync, struct fuse_file_info *f
 
 
    // not addressed by fskit
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_FSYNCDIR, path );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_FSYNCDIR, path, 0 );
 
    fskit_debug("fsyncdir(%s, %d, %p) rc = %d\n", path, datasync, fi, 0);
    return 0;
@@ -781,7 +1084,11 @@ int fskit_fuse_access(const char *path, int mask) {
    uid_t uid = fskit_fuse_get_uid( state );
    gid_t gid = fskit_fuse_get_gid( state );
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_ACCESS, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_access( state->core, path, uid, gid, mask );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_ACCESS, uid, gid, 0, path, NULL, mask, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_ACCESS, path, rc );
 
    fskit_debug("access(%s, %X) rc = %d\n", path, mask, rc );
 
@@ -802,7 +1109,11 @@ int fskit_fuse_create(const char *path, mode_t mode, struct fuse_file_info *fi)
    struct fskit_fuse_file_info* ffi = NULL;
    int rc = 0;
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_CREATE, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    struct fskit_file_handle* fh = fskit_create( state->core, path, uid, gid, mode, &rc );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_CREATE, uid, gid, (uintptr_t)fh, path, NULL, mode, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_CREATE, path, rc );
 
    if( rc != 0 ) {
 
@@ -814,7 +1125,9 @@ int fskit_fuse_create(const char *path, mode_t mode, struct fuse_file_info *fi)
    ffi = fskit_fuse_make_file_handle( fh );
    if( ffi == NULL ) {
 
-      fskit_close( state->core, fh );
+      cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
+      rc = fskit_close( state->core, fh );
+      FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_CLOSE, uid, gid, (uintptr_t)fh, NULL, NULL, 0, 0, 0, rc );
 
       fskit_debug("create(%s, %o, %p) rc = %d\n", path, mode, fi, -ENOMEM );
 
@@ -845,7 +1158,11 @@ int fskit_fuse_ftruncate(const char *path, off_t new_size, struct fuse_file_info
 
    ffi = (struct fskit_fuse_file_info*)((uintptr_t)fi->fh);
 
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_FTRUNCATE, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
    int rc = fskit_ftrunc( state->core, ffi->handle.fh, new_size );
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_FTRUNC, 0, 0, (uintptr_t)ffi->handle.fh, NULL, NULL, new_size, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_FTRUNCATE, path, rc );
 
    fskit_debug("ftruncate(%s, %jd, %p) rc = %d\n", path, new_size, fi, rc );
 
@@ -866,6 +1183,8 @@ int fskit_fuse_fgetattr(const char *path, struct stat *statbuf, struct fuse_file
    ffi = (struct fskit_fuse_file_info*)((uintptr_t)fi->fh);
 
    int rc = 0;
+   FSKIT_TRACE2( fuse__op__begin, FSKIT_FUSE_OP_FGETATTR, path );
+   uint64_t cap_start = FSKIT_FUSE_CAPTURE_BEGIN( state );
 
    if( ffi->type == FSKIT_ENTRY_TYPE_FILE ) {
       rc = fskit_fstat( state->core, fskit_file_handle_get_path( ffi->handle.fh ), fskit_file_handle_get_entry( ffi->handle.fh ), statbuf );
@@ -874,14 +1193,34 @@ int fskit_fuse_fgetattr(const char *path, struct stat *statbuf, struct fuse_file
       rc = fskit_fstat( state->core, fskit_dir_handle_get_path( ffi->handle.dh ), fskit_dir_handle_get_entry( ffi->handle.dh ), statbuf );
    }
 
+   FSKIT_FUSE_CAPTURE( state, cap_start, FSKIT_CAPTURE_OP_FSTAT, 0, 0, (uintptr_t)ffi->handle.fh, NULL, NULL, ffi->type, 0, 0, rc );
+   FSKIT_TRACE3( fuse__op__end, FSKIT_FUSE_OP_FGETATTR, path, rc );
+
    fskit_debug("fgetattr(%s, %p, %p) rc = %d\n", path, statbuf, fi, rc );
 
    return rc;
 }
 
+#ifdef FSKIT_FUSE3
+void *fskit_fuse_fuse_init(struct fuse_conn_info *conn, struct fuse_config *cfg) {
+
+   struct fskit_fuse_state* state = fskit_fuse_get_state();
+
+   // fskit locks directories itself, so concurrent lookups and readdirs are safe
+   if( (state->settings & FSKIT_FUSE_PARALLEL_DIROPS) && (conn->capable & FUSE_CAP_PARALLEL_DIROPS) ) {
+      conn->want |= FUSE_CAP_PARALLEL_DIROPS;
+   }
+   else {
+      conn->want &= ~FUSE_CAP_PARALLEL_DIROPS;
+   }
+
+   return state;
+}
+#else
 void *fskit_fuse_fuse_init(struct fuse_conn_info *conn) {
    return fskit_fuse_get_state();
 }
+#endif
 
 void fskit_fuse_destroy(void *userdata) {
    return;
@@ -905,7 +1244,11 @@ struct fuse_operations fskit_fuse_get_opers() {
    fo.chmod = fskit_fuse_chmod;
    fo.chown = fskit_fuse_chown;
    fo.truncate = fskit_fuse_truncate;
+#ifdef FSKIT_FUSE3
+   fo.utimens = fskit_fuse_utimens;
+#else
    fo.utime = fskit_fuse_utime;
+#endif
    fo.open = fskit_fuse_open;
    fo.read = fskit_fuse_read;
    fo.write = fskit_fuse_write;
@@ -924,8 +1267,10 @@ struct fuse_operations fskit_fuse_get_opers() {
    fo.init = fskit_fuse_fuse_init;
    fo.access = fskit_fuse_access;
    fo.create = fskit_fuse_create;
+#ifndef FSKIT_FUSE3
    fo.ftruncate = fskit_fuse_ftruncate;
    fo.fgetattr = fskit_fuse_fgetattr;
+#endif
 
    return fo;
 }
@@ -944,6 +1289,13 @@ int fskit_fuse_init_fs( struct fskit_fuse_state* state, struct fskit_core* fs )
 
    // enable all callbacks by default
    state->callbacks = 0xFFFFFFFFFFFFFFFFL;
+
+   // keep stats by default.  Without them, we just run uninstrumented.
+   state->stats = fskit_fuse_stats_new();
+   if( state->stats != NULL ) {
+      state->settings |= FSKIT_FUSE_STATS;
+   }
+
    return 0;
 }
 
@@ -981,6 +1333,163 @@ int fskit_fuse_init( struct fskit_fuse_state* state, void* core_state ) {
 }
 
 
+// get the operations to hand to FUSE: the instrumented ones if stats are enabled, or the state's operations otherwise
+static struct fuse_operations* fskit_fuse_main_ops( struct fskit_fuse_state* state ) {
+
+   if( (state->settings & FSKIT_FUSE_STATS) && state->stats != NULL ) {
+
+      state->stats_ops = fskit_fuse_stats_get_opers( &state->ops );
+      return &state->stats_ops;
+   }
+
+   return &state->ops;
+}
+
+#ifdef FSKIT_FUSE3
+
+// run fskit with libfuse3.
+// the worker pool honors FSKIT_FUSE_CLONE_FD and fskit_fuse_set_max_idle_threads(), in addition
+// to the -o clone_fd and -o max_idle_threads command-line options.
+int fskit_fuse_main( struct fskit_fuse_state* state, int argc, char** argv ) {
+
+   int rc = 0;
+
+   // set up FUSE
+   struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+   struct fuse_cmdline_opts opts;
+   struct fuse_loop_config loop_config;
+   struct fuse_session* se = NULL;
+   struct fuse* fs = NULL;
+
+   memset( &opts, 0, sizeof(struct fuse_cmdline_opts) );
+   memset( &loop_config, 0, sizeof(struct fuse_loop_config) );
+
+   // parse command-line...
+   rc = fuse_parse_cmdline( &args, &opts );
+   if( rc != 0 ) {
+
+      fskit_error("fuse_parse_cmdline rc = %d\n", rc );
+      fuse_opt_free_args(&args);
+
+      return -EINVAL;
+   }
+
+   if( opts.mountpoint == NULL ) {
+
+      fskit_error("%s", "No mountpoint given\n");
+      fuse_opt_free_args(&args);
+
+      return -EINVAL;
+   }
+
+   state->mountpoint = strdup( opts.mountpoint );
+
+   // create the filesystem
+   fs = fuse_new( &args, fskit_fuse_main_ops( state ), sizeof(state->ops), state );
+   fuse_opt_free_args(&args);
+
+   if( fs == NULL ) {
+
+      // failed
+      rc = -errno;
+      fskit_error("fuse_new failed, errno = %d\n", rc );
+
+      free( opts.mountpoint );
+
+      if( rc == 0 ) {
+          rc = -EPERM;
+      }
+
+      return rc;
+   }
+
+   // mount
+   rc = fuse_mount( fs, opts.mountpoint );
+   if( rc != 0 ) {
+
+      fskit_error("fuse_mount(%s) rc = %d\n", opts.mountpoint, rc );
+
+      fuse_destroy( fs );
+      free( opts.mountpoint );
+
+      return -EPERM;
+   }
+
+   se = fuse_get_session( fs );
+
+   // daemonize if running in the background
+   fskit_debug("FUSE daemonize: foreground=%d\n", opts.foreground);
+   rc = fuse_daemonize( opts.foreground );
+   if( rc != 0 ) {
+
+      // failed
+      fskit_error("fuse_daemonize(%d) rc = %d\n", opts.foreground, rc );
+
+      fuse_unmount( fs );
+      fuse_destroy( fs );
+      free( opts.mountpoint );
+
+      return rc;
+   }
+
+   // set up FUSE signal handlers
+   rc = fuse_set_signal_handlers( se );
+   if( rc < 0 ) {
+
+      // failed
+      fskit_error("fuse_set_signal_handlers rc = %d\n", rc );
+
+      fuse_unmount( fs );
+      fuse_destroy( fs );
+      free( opts.mountpoint );
+
+      return rc;
+   }
+
+   // if we have a post-mount callback, call it now, since FUSE is ready to receive requests
+   if( state->postmount != NULL ) {
+
+      rc = (*state->postmount)( state, state->postmount_cls );
+      if( rc != 0 ) {
+
+         fskit_error("fskit postmount callback rc = %d\n", rc );
+
+         fuse_remove_signal_handlers( se );
+         fuse_unmount( fs );
+         fuse_destroy( fs );
+         free( opts.mountpoint );
+
+         return rc;
+      }
+   }
+
+   // run the filesystem--start processing requests
+   fskit_debug("%s", "FUSE main loop entered\n");
+   if( !opts.singlethread ) {
+
+      loop_config.clone_fd = (opts.clone_fd || (state->settings & FSKIT_FUSE_CLONE_FD)) ? 1 : 0;
+      loop_config.max_idle_threads = (state->max_idle_threads > 0 ? state->max_idle_threads : opts.max_idle_threads);
+
+      fskit_debug("FUSE worker pool: clone_fd=%d, max_idle_threads=%u\n", loop_config.clone_fd, loop_config.max_idle_threads );
+
+      rc = fuse_loop_mt( fs, &loop_config );
+   }
+   else {
+      rc = fuse_loop( fs );
+   }
+
+   fskit_debug("%s", "FUSE main loop finished\n");
+
+   fuse_remove_signal_handlers( se );
+   fuse_unmount( fs );
+   fuse_destroy( fs );
+   free( opts.mountpoint );
+
+   return rc;
+}
+
+#else
+
 // run fskit with fuse
 int fskit_fuse_main( struct fskit_fuse_state* state, int argc, char** argv ) {
 
@@ -1031,7 +1540,7 @@ int fskit_fuse_main( struct fskit_fuse_state* state, int argc, char** argv ) {
    }
 
    // create the filesystem
-   fs = fuse_new( ch, &args, &state->ops, sizeof(state->ops), state );
+   fs = fuse_new( ch, &args, fskit_fuse_main_ops( state ), sizeof(state->ops), state );
    fuse_opt_free_args(&args);
 
    if( fs == NULL ) {
@@ -1105,6 +1614,8 @@ int fskit_fuse_main( struct fskit_fuse_state* state, int argc, char** argv ) {
    return rc;
 }
 
+#endif
+
 // shut down fskit fuse
 int fskit_fuse_shutdown( struct fskit_fuse_state* state, void** core_state ) {
 
@@ -1135,6 +1646,11 @@ int fskit_fuse_shutdown( struct fskit_fuse_state* state, void** core_state ) {
        state->core = NULL;
    }
 
+   // finish the capture, if there is one
+   if( state->capture != NULL ) {
+      fskit_capture_close( state->capture );
+   }
+
    // free mountpoint
    if( state->mountpoint != NULL ) {
       free( state->mountpoint );
@@ -27,10 +27,21 @@
 
 #include <fskit/fskit.h>
 
+// build with -DFSKIT_FUSE3 (FUSE3=1) to use the libfuse3 frontend
+#ifdef FSKIT_FUSE3
+
+#define FUSE_USE_VERSION 32
+
+#include <fuse3/fuse.h>
+
+#else
+
 #define FUSE_USE_VERSION 28
 
 #include <fuse.h>
 
+#endif
+
 // allow the filesystem process to call arbitrary methods on itself externally, bypassing permissions checks
 #define FSKIT_FUSE_SET_FS_ACCESS        0x1
 
@@ -40,6 +51,15 @@
 // call route on stat even if the inode doesn't exist
 #define FSKIT_FUSE_STAT_ON_ABSENT       0x4
 
+// (libfuse3 only) give each worker thread its own /dev/fuse fd, instead of sharing one channel
+#define FSKIT_FUSE_CLONE_FD             0x8
+
+// (libfuse3 only) let the kernel issue lookups and readdirs on the same directory concurrently
+#define FSKIT_FUSE_PARALLEL_DIROPS      0x10
+
+// keep per-operation counters and latency histograms, and serve them at /.fskit/stats (enabled by default)
+#define FSKIT_FUSE_STATS                0x20
+
 // which FUSE operations do we support?
 #define FSKIT_FUSE_GETATTR              0x1L
 #define FSKIT_FUSE_READLINK             0x2L
@@ -77,6 +97,7 @@
 FSKIT_C_LINKAGE_BEGIN
 
 struct fskit_fuse_state;
+struct fskit_fuse_stats;
 typedef int (*fskit_fuse_postmount_callback_t)( struct fskit_fuse_state*, void* );
 
 // fskit fuse file handle
@@ -101,6 +122,9 @@ mode_t fskit_fuse_get_umask();
 int fskit_fuse_setting_enable( struct fskit_fuse_state* state, uint64_t flag );
 int fskit_fuse_setting_disable( struct fskit_fuse_state* state, uint64_t flag );
 
+// (libfuse3 only) bound on idle worker threads; 0 means use libfuse's default (or -o max_idle_threads)
+int fskit_fuse_set_max_idle_threads( struct fskit_fuse_state* state, unsigned int max_idle_threads );
+
 int fskit_fuse_callback_enable( struct fskit_fuse_state* state, uint64_t callback_id );
 int fskit_fuse_callback_disable( struct fskit_fuse_state* state, uint64_t callback_id );
 
@@ -108,6 +132,11 @@ char const* fskit_fuse_get_mountpoint( struct fskit_fuse_state* state );
 int fskit_fuse_postmount_callback( struct fskit_fuse_state* state, fskit_fuse_postmount_callback_t cb, void* cb_cls );
 
 struct fuse_operations* fskit_fuse_get_ops( struct fskit_fuse_state* state );
+struct fskit_fuse_stats* fskit_fuse_get_stats( struct fskit_fuse_state* state );
+
+// record every call to a capture file, for fskit_repl_replay()
+int fskit_fuse_capture_start( struct fskit_fuse_state* state, char const* path );
+int fskit_fuse_capture_stop( struct fskit_fuse_state* state );
 
 // default fs methods
 int fuse_fskit_getattr(const char *path, struct stat *statbuf);
@@ -0,0 +1,1061 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include <fskit/fuse/fskit_fuse_stats.h>
+#include <stdio.h>
+
+// counters for a single operation.
+// updated with relaxed atomics, so a snapshot may be slightly torn across fields.
+struct fskit_fuse_op_stats {
+
+   uint64_t count;
+   uint64_t errors;
+   uint64_t bytes;       // read/write only
+   uint64_t total_ns;
+   uint64_t max_ns;
+   uint64_t hist[ FSKIT_FUSE_STATS_NUM_BUCKETS ];
+};
+
+struct fskit_fuse_stats {
+
+   struct fskit_fuse_op_stats ops[ FSKIT_FUSE_OP_NUM_OPS ];
+};
+
+// contents of an open stats file: a snapshot taken at open time, so offset reads are consistent
+struct fskit_fuse_stats_snapshot {
+
+   char* buf;
+   size_t len;
+};
+
+// what a path refers to, relative to the reserved paths
+#define FSKIT_FUSE_STATS_PATH_NONE      0
+#define FSKIT_FUSE_STATS_PATH_DIR       1
+#define FSKIT_FUSE_STATS_PATH_FILE      2
+#define FSKIT_FUSE_STATS_PATH_OTHER     3      // beneath FSKIT_FUSE_STATS_DIR, but nonexistent
+
+static char const* fskit_fuse_op_names[ FSKIT_FUSE_OP_NUM_OPS ] = {
+   "getattr",
+   "readlink",
+   "mknod",
+   "mkdir",
+   "unlink",
+   "rmdir",
+   "symlink",
+   "rename",
+   "link",
+   "chmod",
+   "chown",
+   "truncate",
+   "utime",
+   "open",
+   "read",
+   "write",
+   "statfs",
+   "flush",
+   "release",
+   "fsync",
+   "setxattr",
+   "getxattr",
+   "listxattr",
+   "removexattr",
+   "opendir",
+   "readdir",
+   "releasedir",
+   "fsyncdir",
+   "access",
+   "create",
+   "ftruncate",
+   "fgetattr"
+};
+
+
+// allocate zeroed stats
+struct fskit_fuse_stats* fskit_fuse_stats_new() {
+   return (struct fskit_fuse_stats*)calloc( sizeof(struct fskit_fuse_stats), 1 );
+}
+
+// free stats
+void fskit_fuse_stats_free( struct fskit_fuse_stats* stats ) {
+   if( stats != NULL ) {
+      free( stats );
+   }
+}
+
+// name of an operation, or NULL if out of range
+char const* fskit_fuse_stats_op_name( int op ) {
+
+   if( op < 0 || op >= FSKIT_FUSE_OP_NUM_OPS ) {
+      return NULL;
+   }
+
+   return fskit_fuse_op_names[op];
+}
+
+// mark the start of an operation
+void fskit_fuse_stats_begin( struct timespec* start ) {
+   clock_gettime( CLOCK_MONOTONIC, start );
+}
+
+// which histogram bucket does a latency fall into?
+static int fskit_fuse_stats_bucket( uint64_t ns ) {
+
+   uint64_t us = ns / 1000;
+   int bucket = 0;
+
+   while( us > 0 && bucket < FSKIT_FUSE_STATS_NUM_BUCKETS - 1 ) {
+      us >>= 1;
+      bucket++;
+   }
+
+   return bucket;
+}
+
+// record the completion of an operation that began at start.
+// rc is the operation's return code; negative values count as errors, and positive values are byte counts for read and write.
+void fskit_fuse_stats_record( struct fskit_fuse_stats* stats, int op, struct timespec const* start, ssize_t rc ) {
+
+   struct timespec end;
+   struct fskit_fuse_op_stats* op_stats = NULL;
+   uint64_t ns = 0;
+   uint64_t max_ns = 0;
+
+   if( stats == NULL || op < 0 || op >= FSKIT_FUSE_OP_NUM_OPS ) {
+      return;
+   }
+
+   clock_gettime( CLOCK_MONOTONIC, &end );
+
+   if( end.tv_sec > start->tv_sec || (end.tv_sec == start->tv_sec && end.tv_nsec >= start->tv_nsec) ) {
+      ns = (uint64_t)(end.tv_sec - start->tv_sec) * 1000000000L + end.tv_nsec - start->tv_nsec;
+   }
+
+   op_stats = &stats->ops[op];
+
+   __atomic_fetch_add( &op_stats->count, 1, __ATOMIC_RELAXED );
+   __atomic_fetch_add( &op_stats->total_ns, ns, __ATOMIC_RELAXED );
+   __atomic_fetch_add( &op_stats->hist[ fskit_fuse_stats_bucket( ns ) ], 1, __ATOMIC_RELAXED );
+
+   if( rc < 0 ) {
+      __atomic_fetch_add( &op_stats->errors, 1, __ATOMIC_RELAXED );
+   }
+   else if( rc > 0 && (op == FSKIT_FUSE_OP_READ || op == FSKIT_FUSE_OP_WRITE) ) {
+      __atomic_fetch_add( &op_stats->bytes, (uint64_t)rc, __ATOMIC_RELAXED );
+   }
+
+   max_ns = __atomic_load_n( &op_stats->max_ns, __ATOMIC_RELAXED );
+   while( ns > max_ns ) {
+
+      if( __atomic_compare_exchange_n( &op_stats->max_ns, &max_ns, ns, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+         break;
+      }
+   }
+}
+
+// clear all counters
+void fskit_fuse_stats_reset( struct fskit_fuse_stats* stats ) {
+
+   if( stats == NULL ) {
+      return;
+   }
+
+   for( int i = 0; i < FSKIT_FUSE_OP_NUM_OPS; i++ ) {
+
+      struct fskit_fuse_op_stats* op_stats = &stats->ops[i];
+
+      __atomic_store_n( &op_stats->count, 0, __ATOMIC_RELAXED );
+      __atomic_store_n( &op_stats->errors, 0, __ATOMIC_RELAXED );
+      __atomic_store_n( &op_stats->bytes, 0, __ATOMIC_RELAXED );
+      __atomic_store_n( &op_stats->total_ns, 0, __ATOMIC_RELAXED );
+      __atomic_store_n( &op_stats->max_ns, 0, __ATOMIC_RELAXED );
+
+      for( int j = 0; j < FSKIT_FUSE_STATS_NUM_BUCKETS; j++ ) {
+         __atomic_store_n( &op_stats->hist[j], 0, __ATOMIC_RELAXED );
+      }
+   }
+}
+
+// upper bound, in microseconds, of the latency below which the given fraction of operations completed.
+// the result is a bucket boundary, except for the last bucket, where it is the maximum.
+static uint64_t fskit_fuse_stats_percentile_us( uint64_t const* hist, uint64_t count, uint64_t max_ns, double fraction ) {
+
+   uint64_t target = (uint64_t)(count * fraction);
+   uint64_t seen = 0;
+
+   if( target == 0 ) {
+      target = 1;
+   }
+
+   for( int i = 0; i < FSKIT_FUSE_STATS_NUM_BUCKETS - 1; i++ ) {
+
+      seen += hist[i];
+      if( seen >= target ) {
+         return (1ULL << i);
+      }
+   }
+
+   return max_ns / 1000;
+}
+
+// render the stats as text, one summary line and one histogram line per operation that has been called.
+// *buf is malloc'ed and must be freed by the caller.
+// return 0 on success
+// return -ENOMEM on OOM
+int fskit_fuse_stats_render( struct fskit_fuse_stats* stats, char** buf, size_t* len ) {
+
+   FILE* f = open_memstream( buf, len );
+   if( f == NULL ) {
+      return -ENOMEM;
+   }
+
+   fprintf( f, "# op: count errors bytes total_us max_us p50_us p90_us p99_us\n" );
+   fprintf( f, "# op.latency_us: count of operations faster than each bound\n" );
+
+   for( int i = 0; stats != NULL && i < FSKIT_FUSE_OP_NUM_OPS; i++ ) {
+
+      struct fskit_fuse_op_stats* op_stats = &stats->ops[i];
+      uint64_t hist[ FSKIT_FUSE_STATS_NUM_BUCKETS ];
+      uint64_t count = __atomic_load_n( &op_stats->count, __ATOMIC_RELAXED );
+      uint64_t errors = __atomic_load_n( &op_stats->errors, __ATOMIC_RELAXED );
+      uint64_t bytes = __atomic_load_n( &op_stats->bytes, __ATOMIC_RELAXED );
+      uint64_t total_ns = __atomic_load_n( &op_stats->total_ns, __ATOMIC_RELAXED );
+      uint64_t max_ns = __atomic_load_n( &op_stats->max_ns, __ATOMIC_RELAXED );
+
+      if( count == 0 ) {
+         continue;
+      }
+
+      for( int j = 0; j < FSKIT_FUSE_STATS_NUM_BUCKETS; j++ ) {
+         hist[j] = __atomic_load_n( &op_stats->hist[j], __ATOMIC_RELAXED );
+      }
+
+      fprintf( f, "%s: count=%" PRIu64 " errors=%" PRIu64 " bytes=%" PRIu64 " total_us=%" PRIu64 " max_us=%" PRIu64 " p50_us=%" PRIu64 " p90_us=%" PRIu64 " p99_us=%" PRIu64 "\n",
+               fskit_fuse_op_names[i], count, errors, bytes, total_ns / 1000, max_ns / 1000,
+               fskit_fuse_stats_percentile_us( hist, count, max_ns, 0.50 ),
+               fskit_fuse_stats_percentile_us( hist, count, max_ns, 0.90 ),
+               fskit_fuse_stats_percentile_us( hist, count, max_ns, 0.99 ) );
+
+      fprintf( f, "%s.latency_us:", fskit_fuse_op_names[i] );
+
+      for( int j = 0; j < FSKIT_FUSE_STATS_NUM_BUCKETS - 1; j++ ) {
+         fprintf( f, " <%llu=%" PRIu64, (1ULL << j), hist[j] );
+      }
+
+      fprintf( f, " inf=%" PRIu64 "\n", hist[ FSKIT_FUSE_STATS_NUM_BUCKETS - 1 ] );
+   }
+
+   if( fclose( f ) != 0 ) {
+      return -ENOMEM;
+   }
+
+   return 0;
+}
+
+
+// classify a path against the reserved paths
+static int fskit_fuse_stats_path_type( char const* path ) {
+
+   size_t dirlen = strlen( FSKIT_FUSE_STATS_DIR );
+
+   if( path == NULL || strncmp( path, FSKIT_FUSE_STATS_DIR, dirlen ) != 0 ) {
+      return FSKIT_FUSE_STATS_PATH_NONE;
+   }
+
+   if( path[dirlen] == '\0' || strcmp( path + dirlen, "/" ) == 0 ) {
+      return FSKIT_FUSE_STATS_PATH_DIR;
+   }
+
+   if( path[dirlen] != '/' ) {
+      // e.g. /.fskitfoo
+      return FSKIT_FUSE_STATS_PATH_NONE;
+   }
+
+   if( strcmp( path, FSKIT_FUSE_STATS_PATH ) == 0 ) {
+      return FSKIT_FUSE_STATS_PATH_FILE;
+   }
+
+   return FSKIT_FUSE_STATS_PATH_OTHER;
+}
+
+// is this path reserved?
+static bool fskit_fuse_stats_is_reserved( char const* path ) {
+   return fskit_fuse_stats_path_type( path ) != FSKIT_FUSE_STATS_PATH_NONE;
+}
+
+// get the running state's stats and operations
+static struct fskit_fuse_stats* fskit_fuse_stats_get( struct fskit_fuse_state** state, struct fuse_operations** ops ) {
+
+   *state = fskit_fuse_get_state();
+   *ops = fskit_fuse_get_ops( *state );
+
+   return fskit_fuse_get_stats( *state );
+}
+
+// stat a reserved path
+static int fskit_fuse_stats_stat( char const* path, struct stat* sb ) {
+
+   int type = fskit_fuse_stats_path_type( path );
+
+   memset( sb, 0, sizeof(struct stat) );
+
+   sb->st_uid = getuid();
+   sb->st_gid = getgid();
+
+   if( type == FSKIT_FUSE_STATS_PATH_DIR ) {
+
+      sb->st_mode = S_IFDIR | 0555;
+      sb->st_nlink = 2;
+      return 0;
+   }
+   else if( type == FSKIT_FUSE_STATS_PATH_FILE ) {
+
+      // size is unknown until opened; direct_io lets readers go to EOF anyway
+      sb->st_mode = S_IFREG | 0644;
+      sb->st_nlink = 1;
+      return 0;
+   }
+
+   return -ENOENT;
+}
+
+
+// instrumented operations.
+// each one serves the reserved paths itself, and otherwise times the state's operation.
+
+#define FSKIT_FUSE_STATS_CALL( op_id, call ) \
+   do { \
+      struct timespec _start; \
+      int _rc = 0; \
+      fskit_fuse_stats_begin( &_start ); \
+      _rc = (call); \
+      fskit_fuse_stats_record( stats, op_id, &_start, _rc ); \
+      return _rc; \
+   } while( 0 )
+
+#ifdef FSKIT_FUSE3
+static int fskit_fuse_stats_getattr( const char *path, struct stat *statbuf, struct fuse_file_info *fi ) {
+#else
+static int fskit_fuse_stats_getattr( const char *path, struct stat *statbuf ) {
+#endif
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return fskit_fuse_stats_stat( path, statbuf );
+   }
+
+   if( ops->getattr == NULL ) {
+      return -ENOSYS;
+   }
+
+#ifdef FSKIT_FUSE3
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_GETATTR, ops->getattr( path, statbuf, fi ) );
+#else
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_GETATTR, ops->getattr( path, statbuf ) );
+#endif
+}
+
+static int fskit_fuse_stats_readlink( const char *path, char *link, size_t size ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EINVAL;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_READLINK, ops->readlink( path, link, size ) );
+}
+
+static int fskit_fuse_stats_mknod( const char *path, mode_t mode, dev_t dev ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_MKNOD, ops->mknod( path, mode, dev ) );
+}
+
+static int fskit_fuse_stats_mkdir( const char *path, mode_t mode ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_MKDIR, ops->mkdir( path, mode ) );
+}
+
+static int fskit_fuse_stats_unlink( const char *path ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_UNLINK, ops->unlink( path ) );
+}
+
+static int fskit_fuse_stats_rmdir( const char *path ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_RMDIR, ops->rmdir( path ) );
+}
+
+static int fskit_fuse_stats_symlink( const char *target, const char *path ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_SYMLINK, ops->symlink( target, path ) );
+}
+
+#ifdef FSKIT_FUSE3
+static int fskit_fuse_stats_rename( const char *path, const char *newpath, unsigned int flags ) {
+#else
+static int fskit_fuse_stats_rename( const char *path, const char *newpath ) {
+#endif
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) || fskit_fuse_stats_is_reserved( newpath ) ) {
+      return -EPERM;
+   }
+
+#ifdef FSKIT_FUSE3
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_RENAME, ops->rename( path, newpath, flags ) );
+#else
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_RENAME, ops->rename( path, newpath ) );
+#endif
+}
+
+static int fskit_fuse_stats_link( const char *path, const char *newpath ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) || fskit_fuse_stats_is_reserved( newpath ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_LINK, ops->link( path, newpath ) );
+}
+
+#ifdef FSKIT_FUSE3
+static int fskit_fuse_stats_chmod( const char *path, mode_t mode, struct fuse_file_info *fi ) {
+#else
+static int fskit_fuse_stats_chmod( const char *path, mode_t mode ) {
+#endif
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+#ifdef FSKIT_FUSE3
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_CHMOD, ops->chmod( path, mode, fi ) );
+#else
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_CHMOD, ops->chmod( path, mode ) );
+#endif
+}
+
+#ifdef FSKIT_FUSE3
+static int fskit_fuse_stats_chown( const char *path, uid_t new_uid, gid_t new_gid, struct fuse_file_info *fi ) {
+#else
+static int fskit_fuse_stats_chown( const char *path, uid_t new_uid, gid_t new_gid ) {
+#endif
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+#ifdef FSKIT_FUSE3
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_CHOWN, ops->chown( path, new_uid, new_gid, fi ) );
+#else
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_CHOWN, ops->chown( path, new_uid, new_gid ) );
+#endif
+}
+
+// truncating the stats file (e.g. "echo > /.fskit/stats") resets it
+#ifdef FSKIT_FUSE3
+static int fskit_fuse_stats_truncate( const char *path, off_t newsize, struct fuse_file_info *fi ) {
+#else
+static int fskit_fuse_stats_truncate( const char *path, off_t newsize ) {
+#endif
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+   int type = fskit_fuse_stats_path_type( path );
+
+   if( type == FSKIT_FUSE_STATS_PATH_FILE ) {
+      fskit_fuse_stats_reset( stats );
+      return 0;
+   }
+   else if( type != FSKIT_FUSE_STATS_PATH_NONE ) {
+      return -EPERM;
+   }
+
+   if( ops->truncate == NULL ) {
+      return -ENOSYS;
+   }
+
+#ifdef FSKIT_FUSE3
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_TRUNCATE, ops->truncate( path, newsize, fi ) );
+#else
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_TRUNCATE, ops->truncate( path, newsize ) );
+#endif
+}
+
+#ifdef FSKIT_FUSE3
+static int fskit_fuse_stats_utimens( const char *path, const struct timespec tv[2], struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_UTIME, ops->utimens( path, tv, fi ) );
+}
+#else
+static int fskit_fuse_stats_utime( const char *path, struct utimbuf *ubuf ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_UTIME, ops->utime( path, ubuf ) );
+}
+#endif
+
+// opening the stats file snapshots it
+static int fskit_fuse_stats_open( const char *path, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+   int type = fskit_fuse_stats_path_type( path );
+   int rc = 0;
+
+   if( type == FSKIT_FUSE_STATS_PATH_FILE ) {
+
+      struct fskit_fuse_stats_snapshot* snapshot = (struct fskit_fuse_stats_snapshot*)calloc( sizeof(struct fskit_fuse_stats_snapshot), 1 );
+      if( snapshot == NULL ) {
+         return -ENOMEM;
+      }
+
+      if( fi->flags & O_TRUNC ) {
+         fskit_fuse_stats_reset( stats );
+      }
+
+      rc = fskit_fuse_stats_render( stats, &snapshot->buf, &snapshot->len );
+      if( rc != 0 ) {
+
+         free( snapshot );
+         return rc;
+      }
+
+      fi->fh = (uintptr_t)snapshot;
+      fi->direct_io = 1;
+      return 0;
+   }
+   else if( type == FSKIT_FUSE_STATS_PATH_DIR ) {
+      return -EISDIR;
+   }
+   else if( type != FSKIT_FUSE_STATS_PATH_NONE ) {
+      return -ENOENT;
+   }
+
+   if( ops->open == NULL ) {
+      return -ENOSYS;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_OPEN, ops->open( path, fi ) );
+}
+
+static int fskit_fuse_stats_read( const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_path_type( path ) == FSKIT_FUSE_STATS_PATH_FILE ) {
+
+      struct fskit_fuse_stats_snapshot* snapshot = (struct fskit_fuse_stats_snapshot*)((uintptr_t)fi->fh);
+
+      if( offset < 0 || (size_t)offset >= snapshot->len ) {
+         return 0;
+      }
+
+      if( size > snapshot->len - offset ) {
+         size = snapshot->len - offset;
+      }
+
+      memcpy( buf, snapshot->buf + offset, size );
+      return (int)size;
+   }
+
+   if( ops->read == NULL ) {
+      return -ENOSYS;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_READ, ops->read( path, buf, size, offset, fi ) );
+}
+
+// any write to the stats file resets it
+static int fskit_fuse_stats_write( const char *path, const char *buf, size_t size, off_t offset, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_path_type( path ) == FSKIT_FUSE_STATS_PATH_FILE ) {
+
+      fskit_fuse_stats_reset( stats );
+      return (int)size;
+   }
+
+   if( ops->write == NULL ) {
+      return -ENOSYS;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_WRITE, ops->write( path, buf, size, offset, fi ) );
+}
+
+static int fskit_fuse_stats_statfs( const char *path, struct statvfs *statv ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      path = "/";
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_STATFS, ops->statfs( path, statv ) );
+}
+
+static int fskit_fuse_stats_flush( const char *path, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return 0;
+   }
+
+   if( ops->flush == NULL ) {
+      return 0;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_FLUSH, ops->flush( path, fi ) );
+}
+
+static int fskit_fuse_stats_release( const char *path, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_path_type( path ) == FSKIT_FUSE_STATS_PATH_FILE ) {
+
+      struct fskit_fuse_stats_snapshot* snapshot = (struct fskit_fuse_stats_snapshot*)((uintptr_t)fi->fh);
+
+      if( snapshot != NULL ) {
+         free( snapshot->buf );
+         free( snapshot );
+      }
+
+      return 0;
+   }
+
+   if( ops->release == NULL ) {
+      return 0;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_RELEASE, ops->release( path, fi ) );
+}
+
+static int fskit_fuse_stats_fsync( const char *path, int datasync, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return 0;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_FSYNC, ops->fsync( path, datasync, fi ) );
+}
+
+static int fskit_fuse_stats_setxattr( const char *path, const char *name, const char *value, size_t size, int flags ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_SETXATTR, ops->setxattr( path, name, value, size, flags ) );
+}
+
+static int fskit_fuse_stats_getxattr( const char *path, const char *name, char *value, size_t size ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -ENODATA;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_GETXATTR, ops->getxattr( path, name, value, size ) );
+}
+
+static int fskit_fuse_stats_listxattr( const char *path, char *list, size_t size ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return 0;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_LISTXATTR, ops->listxattr( path, list, size ) );
+}
+
+static int fskit_fuse_stats_removexattr( const char *path, const char *name ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_REMOVEXATTR, ops->removexattr( path, name ) );
+}
+
+static int fskit_fuse_stats_opendir( const char *path, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+   int type = fskit_fuse_stats_path_type( path );
+
+   if( type == FSKIT_FUSE_STATS_PATH_DIR ) {
+
+      fi->fh = 0;
+      return 0;
+   }
+   else if( type == FSKIT_FUSE_STATS_PATH_FILE ) {
+      return -ENOTDIR;
+   }
+   else if( type != FSKIT_FUSE_STATS_PATH_NONE ) {
+      return -ENOENT;
+   }
+
+   if( ops->opendir == NULL ) {
+      return 0;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_OPENDIR, ops->opendir( path, fi ) );
+}
+
+#ifdef FSKIT_FUSE3
+static int fskit_fuse_stats_readdir( const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi, enum fuse_readdir_flags flags ) {
+#else
+static int fskit_fuse_stats_readdir( const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi ) {
+#endif
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_path_type( path ) == FSKIT_FUSE_STATS_PATH_DIR ) {
+
+#ifdef FSKIT_FUSE3
+      filler( buf, ".", NULL, 0, 0 );
+      filler( buf, "..", NULL, 0, 0 );
+      filler( buf, FSKIT_FUSE_STATS_PATH + strlen(FSKIT_FUSE_STATS_DIR) + 1, NULL, 0, 0 );
+#else
+      filler( buf, ".", NULL, 0 );
+      filler( buf, "..", NULL, 0 );
+      filler( buf, FSKIT_FUSE_STATS_PATH + strlen(FSKIT_FUSE_STATS_DIR) + 1, NULL, 0 );
+#endif
+      return 0;
+   }
+
+   if( ops->readdir == NULL ) {
+      return -ENOSYS;
+   }
+
+#ifdef FSKIT_FUSE3
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_READDIR, ops->readdir( path, buf, filler, offset, fi, flags ) );
+#else
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_READDIR, ops->readdir( path, buf, filler, offset, fi ) );
+#endif
+}
+
+static int fskit_fuse_stats_releasedir( const char *path, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return 0;
+   }
+
+   if( ops->releasedir == NULL ) {
+      return 0;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_RELEASEDIR, ops->releasedir( path, fi ) );
+}
+
+static int fskit_fuse_stats_fsyncdir( const char *path, int datasync, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return 0;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_FSYNCDIR, ops->fsyncdir( path, datasync, fi ) );
+}
+
+static int fskit_fuse_stats_access( const char *path, int mask ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+   int type = fskit_fuse_stats_path_type( path );
+
+   if( type == FSKIT_FUSE_STATS_PATH_DIR || type == FSKIT_FUSE_STATS_PATH_FILE ) {
+      return 0;
+   }
+   else if( type != FSKIT_FUSE_STATS_PATH_NONE ) {
+      return -ENOENT;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_ACCESS, ops->access( path, mask ) );
+}
+
+static int fskit_fuse_stats_create( const char *path, mode_t mode, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return -EPERM;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_CREATE, ops->create( path, mode, fi ) );
+}
+
+#ifndef FSKIT_FUSE3
+static int fskit_fuse_stats_ftruncate( const char *path, off_t new_size, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+   int type = fskit_fuse_stats_path_type( path );
+
+   if( type == FSKIT_FUSE_STATS_PATH_FILE ) {
+      fskit_fuse_stats_reset( stats );
+      return 0;
+   }
+   else if( type != FSKIT_FUSE_STATS_PATH_NONE ) {
+      return -EPERM;
+   }
+
+   if( ops->ftruncate == NULL ) {
+      return -ENOSYS;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_FTRUNCATE, ops->ftruncate( path, new_size, fi ) );
+}
+
+static int fskit_fuse_stats_fgetattr( const char *path, struct stat *statbuf, struct fuse_file_info *fi ) {
+
+   struct fskit_fuse_state* state = NULL;
+   struct fuse_operations* ops = NULL;
+   struct fskit_fuse_stats* stats = fskit_fuse_stats_get( &state, &ops );
+
+   if( fskit_fuse_stats_is_reserved( path ) ) {
+      return fskit_fuse_stats_stat( path, statbuf );
+   }
+
+   if( ops->fgetattr == NULL ) {
+      return -ENOSYS;
+   }
+
+   FSKIT_FUSE_STATS_CALL( FSKIT_FUSE_OP_FGETATTR, ops->fgetattr( path, statbuf, fi ) );
+}
+#endif
+
+// build the instrumented operation table for the given operations.
+// operations that are NULL in ops stay NULL, except for the ones needed to serve the reserved paths.
+struct fuse_operations fskit_fuse_stats_get_opers( struct fuse_operations const* ops ) {
+
+   struct fuse_operations fo;
+
+   // keep init, destroy, and anything we don't instrument
+   memcpy( &fo, ops, sizeof(fo) );
+
+   // needed for the reserved paths
+   fo.getattr = fskit_fuse_stats_getattr;
+   fo.truncate = fskit_fuse_stats_truncate;
+   fo.open = fskit_fuse_stats_open;
+   fo.read = fskit_fuse_stats_read;
+   fo.write = fskit_fuse_stats_write;
+   fo.flush = fskit_fuse_stats_flush;
+   fo.release = fskit_fuse_stats_release;
+   fo.opendir = fskit_fuse_stats_opendir;
+   fo.readdir = fskit_fuse_stats_readdir;
+   fo.releasedir = fskit_fuse_stats_releasedir;
+#ifndef FSKIT_FUSE3
+   fo.ftruncate = fskit_fuse_stats_ftruncate;
+   fo.fgetattr = fskit_fuse_stats_fgetattr;
+#endif
+
+   // everything else is only wrapped if present
+   if( ops->readlink != NULL ) {
+      fo.readlink = fskit_fuse_stats_readlink;
+   }
+   if( ops->mknod != NULL ) {
+      fo.mknod = fskit_fuse_stats_mknod;
+   }
+   if( ops->mkdir != NULL ) {
+      fo.mkdir = fskit_fuse_stats_mkdir;
+   }
+   if( ops->unlink != NULL ) {
+      fo.unlink = fskit_fuse_stats_unlink;
+   }
+   if( ops->rmdir != NULL ) {
+      fo.rmdir = fskit_fuse_stats_rmdir;
+   }
+   if( ops->symlink != NULL ) {
+      fo.symlink = fskit_fuse_stats_symlink;
+   }
+   if( ops->rename != NULL ) {
+      fo.rename = fskit_fuse_stats_rename;
+   }
+   if( ops->link != NULL ) {
+      fo.link = fskit_fuse_stats_link;
+   }
+   if( ops->chmod != NULL ) {
+      fo.chmod = fskit_fuse_stats_chmod;
+   }
+   if( ops->chown != NULL ) {
+      fo.chown = fskit_fuse_stats_chown;
+   }
+#ifdef FSKIT_FUSE3
+   if( ops->utimens != NULL ) {
+      fo.utimens = fskit_fuse_stats_utimens;
+   }
+#else
+   if( ops->utime != NULL ) {
+      fo.utime = fskit_fuse_stats_utime;
+   }
+#endif
+   if( ops->statfs != NULL ) {
+      fo.statfs = fskit_fuse_stats_statfs;
+   }
+   if( ops->fsync != NULL ) {
+      fo.fsync = fskit_fuse_stats_fsync;
+   }
+   if( ops->setxattr != NULL ) {
+      fo.setxattr = fskit_fuse_stats_setxattr;
+   }
+   if( ops->getxattr != NULL ) {
+      fo.getxattr = fskit_fuse_stats_getxattr;
+   }
+   if( ops->listxattr != NULL ) {
+      fo.listxattr = fskit_fuse_stats_listxattr;
+   }
+   if( ops->removexattr != NULL ) {
+      fo.removexattr = fskit_fuse_stats_removexattr;
+   }
+   if( ops->fsyncdir != NULL ) {
+      fo.fsyncdir = fskit_fuse_stats_fsyncdir;
+   }
+   if( ops->access != NULL ) {
+      fo.access = fskit_fuse_stats_access;
+   }
+   if( ops->create != NULL ) {
+      fo.create = fskit_fuse_stats_create;
+   }
+
+   return fo;
+}
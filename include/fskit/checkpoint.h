@@ -0,0 +1,50 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _FSKIT_CHECKPOINT_H_
+#define _FSKIT_CHECKPOINT_H_
+
+#include <fskit/common.h>
+#include <fskit/debug.h>
+#include <fskit/entry.h>
+
+// namespace checkpoints.
+// fskit_core_checkpoint() writes every entry reachable from the root (attributes, directory entries, xattrs, and
+// symlink targets) to a versioned binary image.  fskit_core_restore() maps such an image and rebuilds the namespace
+// from it directly, without path resolution or route dispatch, into a core whose root is still empty.
+//
+// caveats:
+// * no other thread may change the namespace while a checkpoint is being written.
+// * application-defined inode and handle data are not saved, and no routes are run on restore.
+// * file contents (including those of the built-in data routes) are not saved; restored files keep their sizes.
+// * restored entries keep their inode numbers, which did not come from the core's inode allocator.
+// * images are only readable on hosts with the same byte order.
+
+#define FSKIT_CHECKPOINT_VERSION        1
+
+FSKIT_C_LINKAGE_BEGIN 
+
+int fskit_core_checkpoint( struct fskit_core* core, char const* image_path );
+int fskit_core_restore( struct fskit_core* core, char const* image_path );
+
+FSKIT_C_LINKAGE_END 
+
+#endif
@@ -0,0 +1,63 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _FSKIT_DATA_H_
+#define _FSKIT_DATA_H_
+
+#include <fskit/common.h>
+#include <fskit/debug.h>
+#include <fskit/entry.h>
+#include <fskit/route.h>
+
+// built-in in-RAM file data.
+// each regular file's contents are kept in a radix tree of fixed-size pages, allocated as they are written.
+// holes read back as zeros.  I/O on different pages of the same file can proceed concurrently;
+// only truncation excludes other I/O on the file.
+// copy-on-write clones (see snapshot.h) share pages with the file they copy, until either one writes to them.
+// an entry's pages are freed along with the entry (once no clone shares them).
+
+// page size
+#define FSKIT_DATA_PAGE_SHIFT   12
+#define FSKIT_DATA_PAGE_SIZE    (1L << FSKIT_DATA_PAGE_SHIFT)
+
+struct fskit_route_metadata;
+
+FSKIT_C_LINKAGE_BEGIN 
+
+// install read, write, and trunc routes that keep matching files' data in RAM
+int fskit_data_route( struct fskit_core* core, char const* route_regex );
+
+// the routes themselves, for applications that wrap them in their own
+int fskit_data_read_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data );
+int fskit_data_write_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data );
+int fskit_data_trunc_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, off_t new_size, void* handle_data );
+
+// direct access.  fent must be referenced, but need not be locked.
+ssize_t fskit_data_read( struct fskit_entry* fent, char* buf, size_t buflen, off_t offset );
+ssize_t fskit_data_write( struct fskit_entry* fent, char const* buf, size_t buflen, off_t offset );
+int fskit_data_trunc( struct fskit_entry* fent, off_t new_size );
+
+// number of bytes of pages mapped into the file, including pages it shares with clones
+uint64_t fskit_data_get_allocated( struct fskit_entry* fent );
+
+FSKIT_C_LINKAGE_END 
+
+#endif
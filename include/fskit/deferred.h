@@ -26,7 +26,21 @@
 #include <fskit/debug.h>
 #include <fskit/entry.h>
 
+// default number of reaper threads per core
+#define FSKIT_DEFERRED_DEFAULT_THREADS  1
+
+FSKIT_C_LINKAGE_BEGIN 
+
+// unlink now, reclaim in the background
 int fskit_deferred_remove( struct fskit_core* core, char const* child_path, struct fskit_entry* child );
 int fskit_deferred_remove_all( struct fskit_core* core, char const* child_path, struct fskit_entry* child );
 
+// reclamation control
+int fskit_deferred_set_threads( struct fskit_core* core, int num_threads );
+int fskit_deferred_set_max_pending( struct fskit_core* core, uint64_t max_pending );
+uint64_t fskit_deferred_get_pending( struct fskit_core* core );
+int fskit_deferred_wait( struct fskit_core* core );
+
+FSKIT_C_LINKAGE_END 
+
 #endif
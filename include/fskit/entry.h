@@ -117,6 +117,7 @@ SGLIB_DEFINE_RBTREE_PROTOTYPES( fskit_entry_set, left, right, color, FSKIT_ENTRY
 typedef struct sglib_fskit_entry_set_iterator fskit_entry_set_itr;
 
 fskit_entry_set* fskit_entry_set_new( struct fskit_entry* node, struct fskit_entry* parent );
+fskit_entry_set* fskit_entry_set_new_empty( struct fskit_entry* dir );
 int fskit_entry_set_free( fskit_entry_set* set );
 int fskit_entry_set_insert( fskit_entry_set** set, char const* name, struct fskit_entry* child );
 struct fskit_entry* fskit_entry_set_find_name( fskit_entry_set* set, char const* name );
@@ -149,8 +150,12 @@ fskit_xattr_set* fskit_xattr_set_next( fskit_xattr_set_itr* itr );
 // iteration 
 fskit_entry_set* fskit_entry_set_begin( fskit_entry_set_itr* itr, fskit_entry_set* dirents );
 fskit_entry_set* fskit_entry_set_next( fskit_entry_set_itr* itr );
+fskit_entry_set* fskit_entry_set_begin_at( fskit_entry_set_itr* itr, fskit_entry_set* dirents, char const* name );
+fskit_entry_set* fskit_entry_set_begin_after( fskit_entry_set_itr* itr, fskit_entry_set* dirents, char const* name );
 char const* fskit_entry_set_name_at( fskit_entry_set* dp );
 struct fskit_entry* fskit_entry_set_child_at( fskit_entry_set* dp );
+uint8_t fskit_entry_set_type_at( fskit_entry_set* dp );
+uint64_t fskit_entry_set_file_id_at( fskit_entry_set* dp );
 
 // initialization
 struct fskit_entry* fskit_entry_new(void);
@@ -171,40 +176,69 @@ int fskit_entry_try_destroy_and_free_ex( struct fskit_core* core, char const* fs
 struct fskit_detach_ctx* fskit_detach_ctx_new();
 int fskit_detach_ctx_init( struct fskit_detach_ctx* ctx );
 int fskit_detach_ctx_set_flags( struct fskit_detach_ctx* ctx, int flags );
+int fskit_detach_ctx_set_threads( struct fskit_detach_ctx* ctx, int num_threads );
 int fskit_detach_ctx_get_cbrc( struct fskit_detach_ctx* ctx );
 int fskit_detach_ctx_free( struct fskit_detach_ctx* ctx );
 int fskit_entry_tag_garbage( struct fskit_entry* ent, fskit_entry_set** children );
 
 #define FSKIT_DETACH_CTX_CB_FAIL        0x1     // fail if a user route fails
 
-// locking
+// locking.  The *2 variants record the caller's file and line (for lock debugging and lockstat).
+// The plain names are macros that pass the call site to them; the functions of the same name
+// (for callers that take their address, or that #undef the macros) record no call site.
+int fskit_entry_rlock( struct fskit_entry* fent );
+int fskit_entry_wlock( struct fskit_entry* fent );
+int fskit_entry_unlock( struct fskit_entry* fent );
+
 int fskit_entry_rlock2( struct fskit_entry* fent, char const* from_str, int line_no );
 int fskit_entry_wlock2( struct fskit_entry* fent, char const* from_str, int line_no );
 int fskit_entry_unlock2( struct fskit_entry* fent, char const* from_str, int line_no );
 
-#define fskit_entry_rlock( fent ) fskit_entry_rlock2( fent, __FILE__, __LINE__ )
-#define fskit_entry_wlock( fent ) fskit_entry_wlock2( fent, __FILE__, __LINE__ )
-#define fskit_entry_unlock( fent ) fskit_entry_unlock2( fent, __FILE__, __LINE__ )
-
 int fskit_file_handle_rlock( struct fskit_file_handle* fh );
 int fskit_file_handle_wlock( struct fskit_file_handle* fh );
 int fskit_file_handle_unlock( struct fskit_file_handle* fh );
 
+int fskit_file_handle_rlock2( struct fskit_file_handle* fh, char const* from_str, int line_no );
+int fskit_file_handle_wlock2( struct fskit_file_handle* fh, char const* from_str, int line_no );
+
 int fskit_dir_handle_rlock( struct fskit_dir_handle* dh );
 int fskit_dir_handle_wlock( struct fskit_dir_handle* dh );
 int fskit_dir_handle_unlock( struct fskit_dir_handle* dh );
 
+int fskit_dir_handle_rlock2( struct fskit_dir_handle* dh, char const* from_str, int line_no );
+int fskit_dir_handle_wlock2( struct fskit_dir_handle* dh, char const* from_str, int line_no );
+
+int fskit_core_rlock( struct fskit_core* core );
+int fskit_core_wlock( struct fskit_core* core );
+int fskit_core_unlock( struct fskit_core* core );
+
 int fskit_core_rlock2( struct fskit_core* core, char const* from_str, int line_no );
 int fskit_core_wlock2( struct fskit_core* core, char const* from_str, int line_no );
 int fskit_core_unlock2( struct fskit_core* core, char const* from_str, int line_no );
 
+int fskit_core_route_rlock( struct fskit_core* core );
+int fskit_core_route_wlock( struct fskit_core* core );
+int fskit_core_route_unlock( struct fskit_core* core );
+
+int fskit_core_route_rlock2( struct fskit_core* core, char const* from_str, int line_no );
+int fskit_core_route_wlock2( struct fskit_core* core, char const* from_str, int line_no );
+
+#define fskit_entry_rlock( fent ) fskit_entry_rlock2( fent, __FILE__, __LINE__ )
+#define fskit_entry_wlock( fent ) fskit_entry_wlock2( fent, __FILE__, __LINE__ )
+#define fskit_entry_unlock( fent ) fskit_entry_unlock2( fent, __FILE__, __LINE__ )
+
+#define fskit_file_handle_rlock( fh ) fskit_file_handle_rlock2( fh, __FILE__, __LINE__ )
+#define fskit_file_handle_wlock( fh ) fskit_file_handle_wlock2( fh, __FILE__, __LINE__ )
+
+#define fskit_dir_handle_rlock( dh ) fskit_dir_handle_rlock2( dh, __FILE__, __LINE__ )
+#define fskit_dir_handle_wlock( dh ) fskit_dir_handle_wlock2( dh, __FILE__, __LINE__ )
+
 #define fskit_core_rlock( core ) fskit_core_rlock2( core, __FILE__, __LINE__ )
 #define fskit_core_wlock( core ) fskit_core_wlock2( core, __FILE__, __LINE__ )
 #define fskit_core_unlock( core ) fskit_core_unlock2( core, __FILE__, __LINE__ )
 
-int fskit_core_route_rlock( struct fskit_core* core );
-int fskit_core_route_wlock( struct fskit_core* core );
-int fskit_core_route_unlock( struct fskit_core* core );
+#define fskit_core_route_rlock( core ) fskit_core_route_rlock2( core, __FILE__, __LINE__ )
+#define fskit_core_route_wlock( core ) fskit_core_route_wlock2( core, __FILE__, __LINE__ )
 
 int fskit_xattr_rlock( struct fskit_entry* fent );
 int fskit_xattr_wlock( struct fskit_entry* fent );
@@ -223,6 +257,7 @@ uint64_t fskit_entry_get_owner( struct fskit_entry* ent );
 uint64_t fskit_entry_get_group( struct fskit_entry* ent );
 mode_t fskit_entry_get_mode( struct fskit_entry* ent );
 int32_t fskit_entry_get_link_count( struct fskit_entry* ent );
+int32_t fskit_entry_get_open_count( struct fskit_entry* ent );
 void fskit_entry_get_atime( struct fskit_entry* ent, int64_t* atime_sec, int32_t* atime_nsec );
 void fskit_entry_get_mtime( struct fskit_entry* ent, int64_t* mtime_sec, int32_t* mtime_nsec );
 void fskit_entry_get_ctime( struct fskit_entry* ent, int64_t* ctime_sec, int32_t* ctime_nsec );
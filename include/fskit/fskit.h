@@ -29,14 +29,19 @@
 #include <fskit/random.h>
 
 #include <fskit/access.h>
+#include <fskit/capture.h>
+#include <fskit/checkpoint.h>
 #include <fskit/chmod.h>
 #include <fskit/chown.h>
 #include <fskit/close.h>
 #include <fskit/closedir.h>
 #include <fskit/create.h>
+#include <fskit/data.h>
+#include <fskit/deferred.h>
 #include <fskit/getxattr.h>
 #include <fskit/link.h>
 #include <fskit/listxattr.h>
+#include <fskit/lockstat.h>
 #include <fskit/mkdir.h>
 #include <fskit/mknod.h>
 #include <fskit/open.h>
@@ -50,6 +55,7 @@
 #include <fskit/route.h>
 #include <fskit/rmdir.h>
 #include <fskit/setxattr.h>
+#include <fskit/snapshot.h>
 #include <fskit/stat.h>
 #include <fskit/statvfs.h>
 #include <fskit/symlink.h>
@@ -0,0 +1,64 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _FSKIT_LOCKSTAT_H_
+#define _FSKIT_LOCKSTAT_H_
+
+#include <fskit/debug.h>
+#include <fskit/common.h>
+
+// lock classes
+#define FSKIT_LOCK_CLASS_ENTRY          0       // inode locks
+#define FSKIT_LOCK_CLASS_CORE           1       // the core's lock
+#define FSKIT_LOCK_CLASS_ROUTE          2       // the route table's lock, and per-route consistency locks
+#define FSKIT_LOCK_CLASS_HANDLE         3       // file and directory handle locks
+#define FSKIT_LOCK_CLASS_NUM            4
+
+// what was seen at one call site, for one lock class and mode.
+// an acquisition is contended if the lock could not be taken right away.
+struct fskit_lockstat_site {
+
+   char const* file;                    // call site
+   int line;
+
+   int lock_class;                      // one of FSKIT_LOCK_CLASS_*
+   bool write;                          // write lock (true) or read lock (false)
+
+   uint64_t acquired;                   // number of times the lock was taken here
+   uint64_t contended;                  // number of those times it had to wait
+   uint64_t wait_ns;                    // total time spent waiting
+   uint64_t max_wait_ns;                // longest single wait
+};
+
+FSKIT_C_LINKAGE_BEGIN
+
+void fskit_lockstat_set_enabled( bool enabled );
+bool fskit_lockstat_get_enabled(void);
+
+int fskit_lockstat_snapshot( struct fskit_lockstat_site** sites, size_t* num_sites );
+int fskit_lockstat_dump( FILE* out );
+void fskit_lockstat_reset(void);
+
+char const* fskit_lockstat_class_name( int lock_class );
+
+FSKIT_C_LINKAGE_END
+
+#endif
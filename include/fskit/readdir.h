@@ -25,12 +25,38 @@
 #include <fskit/debug.h>
 #include <fskit/entry.h>
 
+#include <stddef.h>
+
+// packed directory record, as filled in by fskit_readdir_packed (cf. getdents(2)).
+// records are variable-length and 8-byte aligned; name is NUL-terminated.
+struct fskit_packed_dirent {
+   uint64_t file_id;    // file ID
+   uint16_t reclen;     // length of this record, including padding
+   uint16_t namelen;    // length of name, not including the NUL
+   uint8_t type;        // type of file
+   char name[];         // name of file
+};
+
+// size of a packed record for a name of the given length
+#define FSKIT_PACKED_DIRENT_RECLEN( namelen ) ((offsetof(struct fskit_packed_dirent, name) + (namelen) + 1 + 7) & ~((size_t)7))
+
+// advance to the next packed record in a buffer
+#define FSKIT_PACKED_DIRENT_NEXT( d ) ((struct fskit_packed_dirent*)((char*)(d) + (d)->reclen))
+
+// position in a packed directory stream.  A zeroed cookie means "start of directory".
+// it is independent of the directory handle, so several streams can share one handle.
+struct fskit_readdir_cookie {
+   char name[FSKIT_FILESYSTEM_NAMEMAX+1];       // last name returned
+};
+
 FSKIT_C_LINKAGE_BEGIN 
 
 struct fskit_dir_entry** fskit_readdir( struct fskit_core* core, struct fskit_dir_handle* dirh, uint64_t num_children, uint64_t* num_read, int* err );
 struct fskit_dir_entry** fskit_listdir( struct fskit_core* core, struct fskit_dir_handle* dirh, uint64_t* num_read, int* err );
 struct fskit_dir_entry** fskit_listdir_locked( struct fskit_core* core, struct fskit_entry* dent, uint64_t* num_read, int* err );
 
+ssize_t fskit_readdir_packed( struct fskit_core* core, struct fskit_dir_handle* dirh, struct fskit_readdir_cookie* cookie, void* buf, size_t buf_len );
+
 void fskit_dir_entry_free_list( struct fskit_dir_entry** dir_ents );
 void fskit_dir_entry_free( struct fskit_dir_entry* d_ent );
 
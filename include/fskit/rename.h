@@ -25,11 +25,16 @@
 #include <fskit/debug.h>
 #include <fskit/entry.h>
 
+// fskit_rename2 flags.  These have the same values as renameat2(2)'s, so they can be passed straight through.
+#define FSKIT_RENAME_NOREPLACE  (1 << 0)        // fail with -EEXIST if the destination exists
+#define FSKIT_RENAME_EXCHANGE   (1 << 1)        // atomically swap the source and the (existing) destination
+
 FSKIT_C_LINKAGE_BEGIN 
 
 int fskit_entry_rename_in_directory( struct fskit_entry* fent_parent, struct fskit_entry* fent, char const* old_name, char const* new_name );
 
 int fskit_rename( struct fskit_core* core, char const* old_path, char const* new_path, uint64_t user, uint64_t group );
+int fskit_rename2( struct fskit_core* core, char const* old_path, char const* new_path, uint64_t user, uint64_t group, unsigned int flags );
 
 FSKIT_C_LINKAGE_END 
 
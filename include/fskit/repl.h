@@ -22,6 +22,7 @@
 #ifndef _FSKIT_REPL_H_
 #define _FSKIT_REPL_H_
 
+#include <fskit/capture.h>
 #include <fskit/debug.h>
 #include <fskit/entry.h>
 
@@ -32,6 +33,17 @@ FSKIT_C_LINKAGE_BEGIN
 struct fskit_repl;
 struct fskit_repl_stmt;
 
+// what fskit_repl_replay did
+struct fskit_repl_replay_stats {
+
+   uint64_t num_ops;            // calls replayed
+   uint64_t num_mismatches;     // calls that returned something other than what was captured
+   uint64_t num_fences;         // calls that had to run alone
+   uint64_t num_skipped;        // calls on handles opened before the capture began
+   uint64_t elapsed_ns;         // time the replay took
+   uint64_t captured_ns;        // time the captured calls took, from the first start to the last finish
+};
+
 struct fskit_repl* fskit_repl_new( struct fskit_core* core );
 void fskit_repl_free( struct fskit_repl* repl );
 
@@ -46,6 +58,8 @@ int fskit_repl_stmt_dispatch( struct fskit_repl* repl, struct fskit_repl_stmt* s
 
 int fskit_repl_main( struct fskit_repl* repl, FILE* f );
 
+int fskit_repl_replay( struct fskit_core* core, struct fskit_capture_trace* trace, int num_threads, struct fskit_repl_replay_stats* stats );
+
 FSKIT_C_LINKAGE_END
 
 #endif
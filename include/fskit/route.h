@@ -158,6 +158,7 @@ char const* fskit_route_metadata_get_xattr_value( struct fskit_route_metadata* r
 char* fskit_route_metadata_get_xattr_buf( struct fskit_route_metadata* route_metadata, size_t* len );
 char const* fskit_route_metadata_get_xattr_name( struct fskit_route_metadata* route_metadata );
 bool fskit_route_metadata_renamed( struct fskit_route_metadata* route_metadata );
+unsigned int fskit_route_metadata_get_rename_flags( struct fskit_route_metadata* route_metadata );
 
 FSKIT_C_LINKAGE_END 
 
@@ -0,0 +1,50 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#ifndef _FSKIT_SNAPSHOT_H_
+#define _FSKIT_SNAPSHOT_H_
+
+#include <fskit/common.h>
+#include <fskit/debug.h>
+#include <fskit/entry.h>
+
+// copy-on-write clones.
+// fskit_clone() makes dest_path a copy of the file or directory tree at src_path, in constant time:
+// the copy's directories are filled in the first time a path walk visits them, and file data kept by
+// the built-in data routes (see data.h) is shared page by page until one side writes it.
+// after the call, neither tree sees changes made to the other.
+// fskit_snapshot() does the same, but clears the write permission bits of everything in the copy.
+//
+// caveats:
+// * copies get new inode numbers, and no routes are run for them, so they carry no application-defined inode data.
+// * hard links within the source become separate files in the copy.
+// * file handles open when the copy is made find their directories by the paths they were opened with.  Data written
+//   through a handle to a file that has since been renamed into another directory can show up in a copy of that directory,
+//   until the copy has been filled in.  The same goes for fskit_data_write() and fskit_data_trunc(), which take no path.
+
+FSKIT_C_LINKAGE_BEGIN 
+
+int fskit_clone( struct fskit_core* core, char const* src_path, char const* dest_path, uint64_t user, uint64_t group );
+int fskit_snapshot( struct fskit_core* core, char const* src_path, char const* dest_path, uint64_t user, uint64_t group );
+
+FSKIT_C_LINKAGE_END 
+
+#endif
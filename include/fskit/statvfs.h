@@ -28,11 +28,51 @@
 
 #include <sys/statvfs.h>
 
+// block size reported by statvfs
+#define FSKIT_STATVFS_BLOCK_SIZE        4096
+
+// live usage, summed over the core's counters
+struct fskit_usage_info {
+
+   uint64_t inodes;                                     // all inodes, including the root
+   uint64_t inodes_by_type[ FSKIT_ENTRY_TYPE_LNK + 1 ]; // indexed by FSKIT_ENTRY_TYPE_*
+   uint64_t dirents;                                    // directory entries, besides . and ..
+   uint64_t xattr_bytes;                                // extended attribute names and values
+   uint64_t data_bytes;                                 // regular file sizes, as set by the write and truncate routes
+
+   uint64_t max_inodes;                                 // 0 means no limit
+   uint64_t max_bytes;                                  // limit on xattr_bytes + data_bytes; 0 means no limit
+};
+
+// estimated memory footprint, in bytes, from the core's usage counters
+struct fskit_memory_report {
+
+   uint64_t entries;                                    // inodes
+   uint64_t entry_set_nodes;                            // directory entries, including . and ..
+   uint64_t names;                                      // directory entry names
+   uint64_t xattrs;                                     // extended attribute names and values
+   uint64_t symlink_targets;
+   uint64_t file_handles;                               // open file handles and their paths
+   uint64_t dir_handles;                                // open directory handles and their paths
+   uint64_t routes;                                     // installed routes and their regexes
+   uint64_t allocator_overhead;                         // estimated malloc headers and rounding for all of the above
+   uint64_t total;                                      // sum of the above
+
+   uint64_t num_entries;
+   uint64_t num_entry_set_nodes;
+   uint64_t num_file_handles;
+   uint64_t num_dir_handles;
+};
+
 FSKIT_C_LINKAGE_BEGIN 
 
 int fskit_statvfs( struct fskit_core* core, char const* fs_path, uint64_t user, uint64_t group, struct statvfs* vfs );
 int fskit_fstatvfs( struct fskit_core* core, struct fskit_entry* fent, struct statvfs* vfs );
 
+int fskit_core_set_limits( struct fskit_core* core, uint64_t max_inodes, uint64_t max_bytes );
+int fskit_core_get_usage( struct fskit_core* core, struct fskit_usage_info* info );
+int fskit_core_memory_report( struct fskit_core* core, struct fskit_memory_report* report );
+
 FSKIT_C_LINKAGE_END 
 
 #endif
@@ -45,6 +45,35 @@ struct fskit_xattr_set_entry {
    char color;
 };
 
+// compact xattr storage (see xattr.c)
+struct fskit_xattr_names;
+struct fskit_xattr_packed;
+
+// an inode keeps its attributes in a packed block until it has more than this many,
+// or one longer than FSKIT_XATTR_INLINE_VALUE_MAX, or more than FSKIT_XATTR_INLINE_BYTES_MAX bytes of values in all.
+#define FSKIT_XATTR_INLINE_COUNT_MAX     8
+#define FSKIT_XATTR_INLINE_VALUE_MAX     64
+#define FSKIT_XATTR_INLINE_BYTES_MAX     256
+
+// built-in file data (see data.c)
+struct fskit_data;
+
+// compact reader-writer lock (see rwlock.c).  Waiting writers hold off new readers.
+// Build with -DFSKIT_RWLOCK_DEBUG to track the writer, and catch self-deadlock and foreign unlocks.
+typedef struct fskit_rwlock {
+   uint32_t state;               // reader count, plus the write-locked and has-waiters bits
+   uint32_t writers;             // number of writers waiting for the lock
+#ifdef FSKIT_RWLOCK_DEBUG
+   pid_t owner;                  // thread holding the write lock, or 0
+#endif
+} fskit_rwlock_t;
+
+// copy-on-write clone state (see snapshot.c)
+struct fskit_cow;
+
+// background reclamation state
+struct fskit_deferred;
+
 // fskit inode structure
 struct fskit_entry {
    uint64_t file_id;             // inode number
@@ -83,10 +112,20 @@ struct fskit_entry {
    dev_t dev;
 
    // lock governing access to the above structure fields
-   pthread_rwlock_t lock;
+   fskit_rwlock_t lock;
 
-   // extended attributes
+   // extended attributes.  Kept in xattrs_packed while there are few small ones, and in xattrs otherwise.
    fskit_xattr_set* xattrs;
+   struct fskit_xattr_packed* xattrs_packed;
+
+   // file data, if kept by the built-in data routes (see data.h)
+   struct fskit_data* data;
+
+   // if this directory is, or has, a pending copy-on-write clone (see snapshot.h)
+   struct fskit_cow* cow;
+
+   // the counters this entry is charged to, once it is part of a core (see statvfs.c)
+   struct fskit_usage* usage;
    
    // if this is a symlink, this is the target
    char* symlink_target;
@@ -101,8 +140,14 @@ struct fskit_file_handle {
    int flags;
    uint64_t file_id;
 
+   // the counters this handle is charged to (see statvfs.c)
+   struct fskit_usage* usage;
+
+   // the core's clone generation when the directories on path were last pushed (atomic; see snapshot.c)
+   uint64_t cow_generation;
+
    // lock governing access to this structure
-   pthread_rwlock_t lock;
+   fskit_rwlock_t lock;
 
    // application-defined data
    void* app_data;
@@ -117,6 +162,9 @@ struct fskit_dir_handle {
 
    char* path;
    uint64_t file_id;
+
+   // the counters this handle is charged to (see statvfs.c)
+   struct fskit_usage* usage;
    
    // for iteration
    char curr_name[ FSKIT_FILESYSTEM_NAMEMAX+1 ];
@@ -125,7 +173,7 @@ struct fskit_dir_handle {
    struct fskit_telldir_entry* telldir_list;
 
    // lock governing access to this structure
-   pthread_rwlock_t lock;
+   fskit_rwlock_t lock;
 
    // application-defined data
    void* app_data;
@@ -147,9 +195,6 @@ struct fskit_core {
    // application-defined fs-wide data
    void* app_fs_data;
 
-   // number of files and directories that exist
-   uint64_t num_files;
-
    // lock governing access to the above fields of this structure
    pthread_rwlock_t lock;
 
@@ -163,6 +208,21 @@ struct fskit_core {
 
    // extra features to enable 
    uint64_t features;
+
+   // background reclamation of removed entries (see deferred.h)
+   struct fskit_deferred* deferred;
+
+   // serializes renames between directories, so no directory changes parents while one is in progress
+   pthread_mutex_t rename_lock;
+
+   // interned xattr names, shared by all packed xattr blocks
+   struct fskit_xattr_names* xattr_names;
+
+   // live inode, directory entry, and byte counts, and capacity limits (see statvfs.c)
+   struct fskit_usage* usage;
+
+   // number of copy-on-write clones made so far, so file handles can tell when to push their directories (atomic)
+   uint64_t cow_generation;
 };
 
 // route method type 
@@ -203,6 +263,7 @@ struct fskit_route_metadata {
    
    bool garbage_collect;        // is this entry being unlinked due to garbage-collection, or due to an explicit command from userspace?
    bool renamed;                // is this entry being unlinked due to a rename?
+   unsigned int rename_flags;   // FSKIT_RENAME_* flags (rename() only)
    void* cls;                   // user-given argument to the method at hand
 
    char const* xattr_name;
@@ -244,6 +305,7 @@ struct fskit_route_dispatch_args {
    
    bool garbage_collect;        // is this entry being unlinked due to garbage-collection, or due to an explicit command from userspace?
    bool renamed;                // is this entry being unlinked due to rename?
+   unsigned int rename_flags;   // rename() only
 
    // for xattrs 
    char const* xattr_name;
@@ -271,11 +333,81 @@ struct fskit_path_route {
    int route_type;                      // one of FSKIT_ROUTE_MATCH_*
    union fskit_route_method method;           // which method to call
 
-   pthread_rwlock_t lock;               // lock used to enforce the consistency discipline
+   fskit_rwlock_t lock;                 // lock used to enforce the consistency discipline
 };
 
+// compact reader-writer lock (internal API).  These return 0 on success, or negative errno.
+int fskit_rwlock_init( fskit_rwlock_t* lock );
+int fskit_rwlock_destroy( fskit_rwlock_t* lock );
+int fskit_rwlock_rdlock( fskit_rwlock_t* lock );
+int fskit_rwlock_wrlock( fskit_rwlock_t* lock );
+int fskit_rwlock_tryrdlock( fskit_rwlock_t* lock );
+int fskit_rwlock_trywrlock( fskit_rwlock_t* lock );
+int fskit_rwlock_unlock( fskit_rwlock_t* lock );
+
+// lock contention profiling (internal API).  These take the lock like the plain lock functions, and record the wait.
+extern int FSKIT_GLOBAL_LOCKSTAT;
+#define FSKIT_LOCKSTAT_ON() __atomic_load_n( &FSKIT_GLOBAL_LOCKSTAT, __ATOMIC_RELAXED )
+
+int fskit_lockstat_rwlock( fskit_rwlock_t* lock, bool write, int lock_class, char const* from_str, int line_no );
+int fskit_lockstat_pthread_rwlock( pthread_rwlock_t* lock, bool write, int lock_class, char const* from_str, int line_no );
+
 // private--needed by closedir()
 int fskit_run_user_close( struct fskit_core* core, char const* path, struct fskit_entry* fent, void* handle_data );
+void fskit_telldir_list_free( struct fskit_dir_handle* dirh );
+
+// deferred removal lifecycle (internal API)
+int fskit_deferred_init( struct fskit_core* core );
+int fskit_deferred_shutdown( struct fskit_core* core );
+
+// compact xattr storage (internal API)
+int fskit_xattr_names_init( struct fskit_core* core );
+void fskit_xattr_names_shutdown( struct fskit_core* core );
+int fskit_entry_xattr_set( struct fskit_core* core, struct fskit_entry* fent, char const* name, char const* value, size_t value_len, int flags );
+char const* fskit_entry_xattr_find( struct fskit_entry* fent, char const* name, size_t* value_len );
+int fskit_entry_xattr_remove( struct fskit_entry* fent, char const* name );
+int fskit_entry_xattr_list( struct fskit_entry* fent, char* list, size_t size );
+int fskit_entry_xattr_expand( struct fskit_entry* fent );
+void fskit_entry_xattr_clear( struct fskit_entry* fent );
+int fskit_entry_xattr_copy( struct fskit_entry* dest, struct fskit_entry* src );
+
+// built-in file data (internal API)
+void fskit_data_free( struct fskit_entry* fent );
+int fskit_data_clone( struct fskit_entry* dest, struct fskit_entry* src );
+
+// copy-on-write clones (internal API)
+int fskit_cow_fixup( struct fskit_core* core, struct fskit_entry* dir, bool push );
+int fskit_cow_detach( struct fskit_core* core, struct fskit_entry* dir );
+void fskit_cow_forget( struct fskit_entry* fent );
+uint64_t fskit_cow_generation( struct fskit_core* core );
+int fskit_cow_fixup_handle( struct fskit_core* core, struct fskit_file_handle* fh );
+
+// usage counters (internal API).  Counter 0 counts all inodes, and counters 1 through 7 count inodes by type.
+// FSKIT_USAGE_NAME_BYTES counts the names of directory entries, not counting . and .., alongside FSKIT_USAGE_DIRENTS.
+#define FSKIT_USAGE_INODES              0
+#define FSKIT_USAGE_DIRENTS             (FSKIT_ENTRY_TYPE_LNK + 1)
+#define FSKIT_USAGE_XATTR_BYTES         (FSKIT_ENTRY_TYPE_LNK + 2)
+#define FSKIT_USAGE_DATA_BYTES          (FSKIT_ENTRY_TYPE_LNK + 3)
+#define FSKIT_USAGE_SYMLINK_BYTES       (FSKIT_ENTRY_TYPE_LNK + 4)
+#define FSKIT_USAGE_FILE_HANDLES        (FSKIT_ENTRY_TYPE_LNK + 5)
+#define FSKIT_USAGE_FILE_HANDLE_BYTES   (FSKIT_ENTRY_TYPE_LNK + 6)
+#define FSKIT_USAGE_DIR_HANDLES         (FSKIT_ENTRY_TYPE_LNK + 7)
+#define FSKIT_USAGE_DIR_HANDLE_BYTES    (FSKIT_ENTRY_TYPE_LNK + 8)
+#define FSKIT_USAGE_NAME_BYTES          (FSKIT_ENTRY_TYPE_LNK + 9)
+#define FSKIT_USAGE_NUM_COUNTERS        (FSKIT_ENTRY_TYPE_LNK + 10)
+
+int fskit_usage_init( struct fskit_core* core );
+void fskit_usage_shutdown( struct fskit_core* core );
+void fskit_usage_add( struct fskit_usage* usage, int counter, int64_t delta );
+int fskit_usage_check_bytes( struct fskit_usage* usage, int64_t delta );
+int fskit_usage_check_size( struct fskit_entry* fent, off_t new_size );
+int fskit_usage_charge_entry( struct fskit_core* core, struct fskit_entry* fent, bool force );
+void fskit_usage_release_entry( struct fskit_entry* fent );
+uint64_t fskit_entry_xattr_bytes( struct fskit_entry* fent );
+uint64_t fskit_entry_symlink_bytes( struct fskit_entry* fent );
+size_t fskit_entry_set_node_size(void);
+uint64_t fskit_entry_set_name_bytes( fskit_entry_set* set );
+uint64_t fskit_route_table_bytes( fskit_route_table* route_table, uint64_t* num_allocs );
 
 // private--needed by open()
 int fskit_run_user_create( struct fskit_core* core, char const* path, struct fskit_entry* parent, struct fskit_entry* fent, mode_t mode, void* cls, void** inode_data, void** handle_data );
@@ -288,9 +420,15 @@ int fskit_run_user_open( struct fskit_core* core, char const* path, struct fskit
 // private--needed by read
 ssize_t fskit_run_user_read( struct fskit_core* core, char const* path, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data );
 
+// private--needed by write
+off_t fskit_entry_raise_size( struct fskit_entry* fent, off_t size );
+
 // private--needed by any detach logic
 int fskit_run_user_detach( struct fskit_core* core, char const* path, struct fskit_entry* parent, struct fskit_entry* fent );
 
+// private--needed by rename
+int fskit_entry_detach_lowlevel_move( struct fskit_entry* parent, char const* child_name );
+
 // routes 
 typedef struct fskit_path_route* fskit_path_route_entry;
 SGLIB_DEFINE_VECTOR_PROTOTYPES( fskit_path_route_entry );
@@ -323,7 +461,7 @@ int fskit_route_detach_args( struct fskit_route_dispatch_args* dargs, struct fsk
 int fskit_route_destroy_args( struct fskit_route_dispatch_args* dargs, struct fskit_entry* parent, char const* name, bool renamed, void* inode_data );
 int fskit_route_stat_args( struct fskit_route_dispatch_args* dargs, char const* name, struct stat* sb, bool fent_absent );
 int fskit_route_sync_args( struct fskit_route_dispatch_args* dargs );
-int fskit_route_rename_args( struct fskit_route_dispatch_args* dargs, struct fskit_entry* old_parent, char const* old_name, char const* new_path, struct fskit_entry* new_parent, struct fskit_entry* dest );
+int fskit_route_rename_args( struct fskit_route_dispatch_args* dargs, struct fskit_entry* old_parent, char const* old_name, char const* new_path, struct fskit_entry* new_parent, struct fskit_entry* dest, unsigned int flags );
 int fskit_route_link_args( struct fskit_route_dispatch_args* dargs, char const* name, char const* new_path, struct fskit_entry* new_parent );
 int fskit_route_getxattr_args( struct fskit_route_dispatch_args* args, char const* xattr_name, char* xattr_buf, size_t xattr_buf_len );
 int fskit_route_setxattr_args( struct fskit_route_dispatch_args* args, char const* xattr_name, char const* xattr_value, size_t xattr_value_len, int flags );
@@ -331,6 +469,10 @@ int fskit_route_listxattr_args( struct fskit_route_dispatch_args* args, char* xa
 int fskit_route_removexattr_args( struct fskit_route_dispatch_args* args, char const* xattr_name );
 int fskit_route_setmetadata_args( struct fskit_route_dispatch_args* dargs, struct fskit_inode_metadata* imd );
 
+// check for user-supplied routes (internal API)
+bool fskit_route_is_matched( struct fskit_core* core, int route_type, char const* path );
+bool fskit_route_is_defined( struct fskit_core* core, int route_type );
+
 // call user-supplied routes (internal API)
 int fskit_route_call_create( struct fskit_core* core, char const* path, struct fskit_entry* fent, struct fskit_route_dispatch_args* dargs, int* cbrc );
 int fskit_route_call_mknod( struct fskit_core* core, char const* path, struct fskit_entry* fent, struct fskit_route_dispatch_args* dargs, int* cbrc );
@@ -0,0 +1,530 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// capture format (all integers in host byte order):
+//
+//   header
+//   record 0, record 1, ...
+//
+// each record is a struct fskit_capture_rec_header, followed by its path and then its second path (if present),
+// each NUL-terminated and padded to 8 bytes.  Records are appended as calls finish, so they are ordered by
+// completion, not by start time.  There is no record count: a capture that was cut short (e.g. by a crash) is
+// read up to its last whole record.
+
+#include <fskit/capture.h>
+#include <fskit/util.h>
+
+#include "fskit_private/private.h"
+
+#include <sys/mman.h>
+
+#define FSKIT_CAPTURE_MAGIC             "FSKITCAP"
+#define FSKIT_CAPTURE_BYTE_ORDER        0x01020304
+
+#define FSKIT_CAPTURE_ALIGN( n )        (((n) + 7) & ~((uint64_t)7))
+
+// how much to buffer before writing
+#define FSKIT_CAPTURE_BUF_LEN           (1024 * 1024)
+
+#define FSKIT_CAPTURE_HAS_PATH          0x1
+#define FSKIT_CAPTURE_HAS_PATH2         0x2
+
+struct fskit_capture_header {
+
+   char magic[8];
+   uint32_t version;
+   uint32_t byte_order;         // FSKIT_CAPTURE_BYTE_ORDER, as the writer saw it
+   uint64_t start_time_ns;      // wall-clock time the capture began
+};
+
+struct fskit_capture_rec_header {
+
+   uint8_t op;
+   uint8_t flags;               // FSKIT_CAPTURE_HAS_*
+   uint16_t pad;
+   uint32_t path_len;           // not counting the NUL
+   uint32_t path2_len;
+   uint32_t pad2;
+   int64_t rc;
+   uint64_t user;
+   uint64_t group;
+   uint64_t start_ns;
+   uint64_t duration_ns;
+   uint64_t handle;
+   uint64_t args[3];
+};
+
+struct fskit_capture {
+
+   pthread_mutex_t lock;
+   FILE* f;                     // NULL once closed
+   char* buf;                   // f's buffer
+   uint64_t base_ns;            // monotonic time the capture began
+   uint64_t count;
+   int recording;               // cleared on close, so callers stop timing calls
+};
+
+static char const* fskit_capture_op_names[ FSKIT_CAPTURE_OP_MAX ] = {
+   NULL,
+   "stat",
+   "fstat",
+   "readlink",
+   "mknod",
+   "mkdir",
+   "unlink",
+   "rmdir",
+   "symlink",
+   "rename",
+   "link",
+   "chmod",
+   "chown",
+   "trunc",
+   "ftrunc",
+   "utime",
+   "open",
+   "create",
+   "read",
+   "write",
+   "sync",
+   "close",
+   "statvfs",
+   "setxattr",
+   "getxattr",
+   "listxattr",
+   "removexattr",
+   "opendir",
+   "readdir",
+   "closedir",
+   "access"
+};
+
+// get the name of a captured operation, or NULL if it's not one
+char const* fskit_capture_op_name( int op ) {
+
+   if( op <= 0 || op >= FSKIT_CAPTURE_OP_MAX ) {
+      return NULL;
+   }
+
+   return fskit_capture_op_names[ op ];
+}
+
+
+static uint64_t fskit_capture_now_ns( clockid_t clock ) {
+
+   struct timespec ts;
+
+   clock_gettime( clock, &ts );
+   return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+// write bytes to the capture, padded to 8 bytes
+// return 0 on success
+// return -errno on I/O error
+static int fskit_capture_write( FILE* f, void const* buf, size_t len ) {
+
+   static char const zeros[8] = { 0 };
+   size_t padded = FSKIT_CAPTURE_ALIGN( len );
+
+   if( len > 0 && fwrite( buf, 1, len, f ) != len ) {
+      return -errno;
+   }
+
+   if( padded > len && fwrite( zeros, 1, padded - len, f ) != padded - len ) {
+      return -errno;
+   }
+
+   return 0;
+}
+
+
+// start capturing to a new file at path, replacing whatever is there
+// return 0 on success, and set *ret_cap
+// return -ENOMEM on OOM
+// return -errno if the file could not be created
+int fskit_capture_open( struct fskit_capture** ret_cap, char const* path ) {
+
+   struct fskit_capture* cap = NULL;
+   struct fskit_capture_header header;
+   int rc = 0;
+
+   cap = CALLOC_LIST( struct fskit_capture, 1 );
+   if( cap == NULL ) {
+      return -ENOMEM;
+   }
+
+   cap->buf = CALLOC_LIST( char, FSKIT_CAPTURE_BUF_LEN );
+   if( cap->buf == NULL ) {
+
+      fskit_safe_free( cap );
+      return -ENOMEM;
+   }
+
+   cap->f = fopen( path, "w" );
+   if( cap->f == NULL ) {
+
+      rc = -errno;
+      fskit_error("fopen('%s') rc = %d\n", path, rc );
+
+      fskit_safe_free( cap->buf );
+      fskit_safe_free( cap );
+      return rc;
+   }
+
+   setvbuf( cap->f, cap->buf, _IOFBF, FSKIT_CAPTURE_BUF_LEN );
+
+   memset( &header, 0, sizeof(header) );
+   memcpy( header.magic, FSKIT_CAPTURE_MAGIC, sizeof(header.magic) );
+   header.version = FSKIT_CAPTURE_VERSION;
+   header.byte_order = FSKIT_CAPTURE_BYTE_ORDER;
+   header.start_time_ns = fskit_capture_now_ns( CLOCK_REALTIME );
+
+   rc = fskit_capture_write( cap->f, &header, sizeof(header) );
+   if( rc != 0 ) {
+
+      fskit_error("write('%s') rc = %d\n", path, rc );
+
+      fclose( cap->f );
+      fskit_safe_free( cap->buf );
+      fskit_safe_free( cap );
+      return rc;
+   }
+
+   pthread_mutex_init( &cap->lock, NULL );
+   cap->base_ns = fskit_capture_now_ns( CLOCK_MONOTONIC );
+   cap->recording = 1;
+
+   *ret_cap = cap;
+   return 0;
+}
+
+
+// stop capturing, and flush the capture to disk.
+// cap stays valid, so threads that are still recording can finish; later records are dropped.
+// return 0 on success
+// return -errno if the capture could not be written
+int fskit_capture_close( struct fskit_capture* cap ) {
+
+   int rc = 0;
+
+   __atomic_store_n( &cap->recording, 0, __ATOMIC_RELAXED );
+
+   pthread_mutex_lock( &cap->lock );
+
+   if( cap->f != NULL ) {
+
+      if( fflush( cap->f ) != 0 || fsync( fileno( cap->f ) ) != 0 ) {
+         rc = -errno;
+      }
+
+      if( fclose( cap->f ) != 0 && rc == 0 ) {
+         rc = -errno;
+      }
+
+      cap->f = NULL;
+   }
+
+   pthread_mutex_unlock( &cap->lock );
+
+   return rc;
+}
+
+
+// close (if need be) and free a capture.  No one may be recording to it.
+void fskit_capture_free( struct fskit_capture* cap ) {
+
+   if( cap == NULL ) {
+      return;
+   }
+
+   fskit_capture_close( cap );
+
+   pthread_mutex_destroy( &cap->lock );
+   fskit_safe_free( cap->buf );
+   fskit_safe_free( cap );
+}
+
+
+// get the start time to pass to fskit_capture_record.
+// return 0 if cap is NULL or closed, in which case the call should not be recorded.
+uint64_t fskit_capture_begin( struct fskit_capture* cap ) {
+
+   uint64_t now = 0;
+
+   if( cap == NULL || __atomic_load_n( &cap->recording, __ATOMIC_RELAXED ) == 0 ) {
+      return 0;
+   }
+
+   now = fskit_capture_now_ns( CLOCK_MONOTONIC );
+   return (now != 0 ? now : 1);
+}
+
+
+// record a call that began at start (from fskit_capture_begin) and just returned rc.
+// path and path2 may be NULL.
+// return 0 on success, or if start is 0
+// return -EINVAL if the call can't be recorded
+// return -errno on I/O error
+int fskit_capture_record( struct fskit_capture* cap, uint64_t start, int op, uint64_t user, uint64_t group, uint64_t handle,
+                          char const* path, char const* path2, uint64_t arg0, uint64_t arg1, uint64_t arg2, int64_t rc ) {
+
+   struct fskit_capture_rec_header rec;
+   uint64_t now = 0;
+   int write_rc = 0;
+
+   if( start == 0 ) {
+      return 0;
+   }
+
+   if( op <= 0 || op >= FSKIT_CAPTURE_OP_MAX ) {
+      return -EINVAL;
+   }
+
+   now = fskit_capture_now_ns( CLOCK_MONOTONIC );
+
+   memset( &rec, 0, sizeof(rec) );
+
+   rec.op = op;
+   rec.rc = rc;
+   rec.user = user;
+   rec.group = group;
+   rec.start_ns = (start > cap->base_ns ? start - cap->base_ns : 0);
+   rec.duration_ns = (now > start ? now - start : 0);
+   rec.handle = handle;
+   rec.args[0] = arg0;
+   rec.args[1] = arg1;
+   rec.args[2] = arg2;
+
+   if( path != NULL ) {
+      rec.flags |= FSKIT_CAPTURE_HAS_PATH;
+      rec.path_len = strlen( path );
+   }
+
+   if( path2 != NULL ) {
+      rec.flags |= FSKIT_CAPTURE_HAS_PATH2;
+      rec.path2_len = strlen( path2 );
+   }
+
+   pthread_mutex_lock( &cap->lock );
+
+   if( cap->f == NULL ) {
+
+      // closed while this call ran
+      pthread_mutex_unlock( &cap->lock );
+      return 0;
+   }
+
+   write_rc = fskit_capture_write( cap->f, &rec, sizeof(rec) );
+
+   if( write_rc == 0 && path != NULL ) {
+      write_rc = fskit_capture_write( cap->f, path, rec.path_len + 1 );
+   }
+
+   if( write_rc == 0 && path2 != NULL ) {
+      write_rc = fskit_capture_write( cap->f, path2, rec.path2_len + 1 );
+   }
+
+   if( write_rc == 0 ) {
+      cap->count++;
+   }
+
+   pthread_mutex_unlock( &cap->lock );
+
+   return write_rc;
+}
+
+
+// how many calls have been recorded
+uint64_t fskit_capture_get_count( struct fskit_capture* cap ) {
+
+   uint64_t count = 0;
+
+   pthread_mutex_lock( &cap->lock );
+   count = cap->count;
+   pthread_mutex_unlock( &cap->lock );
+
+   return count;
+}
+
+
+// get a recorded string at *offset, and advance past it.
+// return 0 on success
+// return -EIO if it runs off the end of the capture, or isn't NUL-terminated
+static int fskit_capture_trace_string( char const* buf, uint64_t len, uint64_t* offset, uint32_t str_len, char const** str ) {
+
+   uint64_t padded = FSKIT_CAPTURE_ALIGN( (uint64_t)str_len + 1 );
+
+   if( *offset + padded > len || buf[ *offset + str_len ] != '\0' ) {
+      return -EIO;
+   }
+
+   *str = buf + *offset;
+   *offset += padded;
+
+   return 0;
+}
+
+
+// walk the records in a mapped capture.
+// if recs is NULL, just count them.
+// return the number of whole records
+static uint64_t fskit_capture_trace_scan( char const* buf, uint64_t len, struct fskit_capture_rec* recs ) {
+
+   struct fskit_capture_rec_header const* hdr = NULL;
+   struct fskit_capture_rec rec;
+   uint64_t offset = sizeof(struct fskit_capture_header);
+   uint64_t n = 0;
+   int rc = 0;
+
+   while( offset + sizeof(struct fskit_capture_rec_header) <= len ) {
+
+      hdr = (struct fskit_capture_rec_header const*)(buf + offset);
+      offset += sizeof(struct fskit_capture_rec_header);
+
+      if( hdr->op == 0 || hdr->op >= FSKIT_CAPTURE_OP_MAX ) {
+         break;
+      }
+
+      memset( &rec, 0, sizeof(rec) );
+
+      if( hdr->flags & FSKIT_CAPTURE_HAS_PATH ) {
+         rc = fskit_capture_trace_string( buf, len, &offset, hdr->path_len, &rec.path );
+         if( rc != 0 ) {
+            break;
+         }
+      }
+
+      if( hdr->flags & FSKIT_CAPTURE_HAS_PATH2 ) {
+         rc = fskit_capture_trace_string( buf, len, &offset, hdr->path2_len, &rec.path2 );
+         if( rc != 0 ) {
+            break;
+         }
+      }
+
+      if( recs != NULL ) {
+
+         rec.op = hdr->op;
+         rec.rc = hdr->rc;
+         rec.user = hdr->user;
+         rec.group = hdr->group;
+         rec.start_ns = hdr->start_ns;
+         rec.duration_ns = hdr->duration_ns;
+         rec.handle = hdr->handle;
+         memcpy( rec.args, hdr->args, sizeof(rec.args) );
+
+         recs[n] = rec;
+      }
+
+      n++;
+   }
+
+   return n;
+}
+
+
+// load a capture into memory.  The records' strings point into the mapped file, so they last until
+// fskit_capture_trace_free.
+// return 0 on success, and fill in *trace
+// return -EINVAL if the file isn't a capture, or is from a host with a different byte order
+// return -ENOMEM on OOM
+// return -errno if the file could not be read
+int fskit_capture_trace_load( struct fskit_capture_trace* trace, char const* path ) {
+
+   struct fskit_capture_header const* header = NULL;
+   struct stat sb;
+   void* buf = MAP_FAILED;
+   int fd = -1;
+   int rc = 0;
+
+   memset( trace, 0, sizeof(struct fskit_capture_trace) );
+
+   fd = open( path, O_RDONLY );
+   if( fd < 0 ) {
+
+      rc = -errno;
+      fskit_error("open('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   if( fstat( fd, &sb ) != 0 ) {
+
+      rc = -errno;
+      close( fd );
+      return rc;
+   }
+
+   if( (uint64_t)sb.st_size < sizeof(struct fskit_capture_header) ) {
+
+      close( fd );
+      return -EINVAL;
+   }
+
+   buf = mmap( NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd );
+
+   if( buf == MAP_FAILED ) {
+
+      rc = -errno;
+      fskit_error("mmap('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   header = (struct fskit_capture_header const*)buf;
+
+   if( memcmp( header->magic, FSKIT_CAPTURE_MAGIC, sizeof(header->magic) ) != 0 || header->version != FSKIT_CAPTURE_VERSION || header->byte_order != FSKIT_CAPTURE_BYTE_ORDER ) {
+
+      munmap( buf, sb.st_size );
+      return -EINVAL;
+   }
+
+   trace->num_recs = fskit_capture_trace_scan( (char const*)buf, sb.st_size, NULL );
+
+   if( trace->num_recs > 0 ) {
+
+      trace->recs = CALLOC_LIST( struct fskit_capture_rec, trace->num_recs );
+      if( trace->recs == NULL ) {
+
+         munmap( buf, sb.st_size );
+         memset( trace, 0, sizeof(struct fskit_capture_trace) );
+         return -ENOMEM;
+      }
+
+      fskit_capture_trace_scan( (char const*)buf, sb.st_size, trace->recs );
+   }
+
+   trace->buf = buf;
+   trace->len = sb.st_size;
+
+   return 0;
+}
+
+
+// free a loaded capture
+void fskit_capture_trace_free( struct fskit_capture_trace* trace ) {
+
+   fskit_safe_free( trace->recs );
+
+   if( trace->buf != NULL ) {
+      munmap( trace->buf, trace->len );
+   }
+
+   memset( trace, 0, sizeof(struct fskit_capture_trace) );
+}
@@ -0,0 +1,945 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// namespace checkpoint image format (all integers in host byte order):
+//
+//   header
+//   entry record 0 (the root), entry record 1, ...
+//
+// each entry record is a struct fskit_checkpoint_entry, followed by its symlink target (if any), then its xattrs
+// (each a struct fskit_checkpoint_xattr followed by the name and the value), then its directory entries (each a
+// struct fskit_checkpoint_dirent followed by the name).  Names and targets are not NUL-terminated.  Every record
+// and every string is padded to 8 bytes, so a mapped image can be read in place.
+//
+// entries are numbered in the order they are written, which is breadth-first from the root.  A directory entry
+// refers to its child by that number, so a child directory always comes after its parent.
+
+#include <fskit/checkpoint.h>
+#include <fskit/util.h>
+
+#include "fskit_private/private.h"
+
+#include <sys/mman.h>
+
+#define FSKIT_CHECKPOINT_MAGIC          "FSKITCKP"
+#define FSKIT_CHECKPOINT_BYTE_ORDER     0x01020304
+
+#define FSKIT_CHECKPOINT_ALIGN( n )     (((n) + 7) & ~((uint64_t)7))
+
+struct fskit_checkpoint_header {
+
+   char magic[8];
+   uint32_t version;
+   uint32_t byte_order;         // FSKIT_CHECKPOINT_BYTE_ORDER, as the writer saw it
+   uint64_t num_entries;
+   uint64_t length;             // length of the whole image
+};
+
+struct fskit_checkpoint_entry {
+
+   uint64_t file_id;
+   uint64_t owner;
+   uint64_t group;
+   uint64_t dev;
+   int64_t size;
+
+   int64_t atime_sec;
+   int64_t mtime_sec;
+   int64_t ctime_sec;
+   int32_t atime_nsec;
+   int32_t mtime_nsec;
+   int32_t ctime_nsec;
+
+   uint32_t mode;
+   int32_t link_count;
+   uint32_t symlink_len;
+   uint32_t num_xattrs;
+   uint32_t pad;
+   uint64_t num_dirents;
+
+   uint8_t type;
+   uint8_t pad2[7];
+};
+
+struct fskit_checkpoint_xattr {
+
+   uint32_t name_len;
+   uint32_t value_len;
+};
+
+struct fskit_checkpoint_dirent {
+
+   uint64_t child;
+   uint32_t name_len;
+   uint32_t pad;
+};
+
+// entries in the order they get written, with an index from hard-linked entries to their numbers
+struct fskit_checkpoint_ctx {
+
+   FILE* f;
+   uint64_t length;
+
+   struct fskit_entry** ents;
+   uint64_t num_ents;
+   uint64_t max_ents;
+
+   struct fskit_entry** links;          // open-addressed; a slot's number is in link_ids
+   uint64_t* link_ids;
+   uint64_t num_links;
+   uint64_t max_links;                  // power of 2
+};
+
+
+// write bytes to the image, padded to 8 bytes
+// return 0 on success
+// return -errno on I/O error
+static int fskit_checkpoint_write( struct fskit_checkpoint_ctx* ctx, void const* buf, size_t len ) {
+
+   static char const zeros[8] = { 0 };
+   size_t padded = FSKIT_CHECKPOINT_ALIGN( len );
+
+   if( len > 0 && fwrite( buf, 1, len, ctx->f ) != len ) {
+      return -errno;
+   }
+
+   if( padded > len && fwrite( zeros, 1, padded - len, ctx->f ) != padded - len ) {
+      return -errno;
+   }
+
+   ctx->length += padded;
+   return 0;
+}
+
+
+// queue an entry to be written, and get its number
+// return 0 on success
+// return -ENOMEM on OOM
+static int fskit_checkpoint_queue( struct fskit_checkpoint_ctx* ctx, struct fskit_entry* fent, uint64_t* id ) {
+
+   struct fskit_entry** ents = NULL;
+
+   if( ctx->num_ents == ctx->max_ents ) {
+
+      ents = (struct fskit_entry**)realloc( ctx->ents, sizeof(struct fskit_entry*) * (ctx->max_ents * 2 + 1024) );
+      if( ents == NULL ) {
+         return -ENOMEM;
+      }
+
+      ctx->ents = ents;
+      ctx->max_ents = ctx->max_ents * 2 + 1024;
+   }
+
+   *id = ctx->num_ents;
+   ctx->ents[ ctx->num_ents ] = fent;
+   ctx->num_ents++;
+
+   return 0;
+}
+
+
+// find the slot for a hard-linked entry
+static uint64_t fskit_checkpoint_link_slot( struct fskit_entry** links, uint64_t max_links, struct fskit_entry* fent ) {
+
+   uint64_t i = ((uintptr_t)fent >> 4) * 0x9E3779B97F4A7C15ULL;
+
+   for( i &= (max_links - 1); links[i] != NULL && links[i] != fent; i = (i + 1) & (max_links - 1) );
+
+   return i;
+}
+
+
+// get the number of a child, queueing it if we haven't seen it yet.
+// entries with more than one link are remembered, so they only get written once.
+// return 0 on success
+// return -ENOMEM on OOM
+static int fskit_checkpoint_child_id( struct fskit_checkpoint_ctx* ctx, struct fskit_entry* child, uint64_t* id ) {
+
+   uint64_t slot = 0;
+   uint64_t new_max = 0;
+   struct fskit_entry** new_links = NULL;
+   uint64_t* new_ids = NULL;
+   int rc = 0;
+
+   if( child->type == FSKIT_ENTRY_TYPE_DIR || child->link_count <= 1 ) {
+      return fskit_checkpoint_queue( ctx, child, id );
+   }
+
+   if( ctx->max_links > 0 ) {
+
+      slot = fskit_checkpoint_link_slot( ctx->links, ctx->max_links, child );
+      if( ctx->links[slot] == child ) {
+
+         *id = ctx->link_ids[slot];
+         return 0;
+      }
+   }
+
+   // keep it at most half full
+   if( (ctx->num_links + 1) * 2 > ctx->max_links ) {
+
+      new_max = (ctx->max_links > 0 ? ctx->max_links * 2 : 1024);
+      new_links = CALLOC_LIST( struct fskit_entry*, new_max );
+      new_ids = CALLOC_LIST( uint64_t, new_max );
+
+      if( new_links == NULL || new_ids == NULL ) {
+
+         fskit_safe_free( new_links );
+         fskit_safe_free( new_ids );
+         return -ENOMEM;
+      }
+
+      for( uint64_t i = 0; i < ctx->max_links; i++ ) {
+
+         if( ctx->links[i] != NULL ) {
+
+            slot = fskit_checkpoint_link_slot( new_links, new_max, ctx->links[i] );
+            new_links[slot] = ctx->links[i];
+            new_ids[slot] = ctx->link_ids[i];
+         }
+      }
+
+      fskit_safe_free( ctx->links );
+      fskit_safe_free( ctx->link_ids );
+
+      ctx->links = new_links;
+      ctx->link_ids = new_ids;
+      ctx->max_links = new_max;
+   }
+
+   rc = fskit_checkpoint_queue( ctx, child, id );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   slot = fskit_checkpoint_link_slot( ctx->links, ctx->max_links, child );
+   ctx->links[slot] = child;
+   ctx->link_ids[slot] = *id;
+   ctx->num_links++;
+
+   return 0;
+}
+
+
+// can this directory entry go into the image?
+static bool fskit_checkpoint_dirent_ok( char const* name, struct fskit_entry* child ) {
+
+   // NOTE: deletion_in_progress is only written while the parent is write-locked
+   return name != NULL && child != NULL && strcmp( name, "." ) != 0 && strcmp( name, ".." ) != 0 &&
+          child->type != FSKIT_ENTRY_TYPE_DEAD && !child->deletion_in_progress;
+}
+
+
+// write one entry's record, queueing its children
+// return 0 on success
+// return -ENOMEM on OOM
+// return -errno on I/O error
+// NOTE: fent must be read-locked
+static int fskit_checkpoint_entry( struct fskit_checkpoint_ctx* ctx, struct fskit_entry* fent ) {
+
+   struct fskit_checkpoint_entry rec;
+   struct fskit_checkpoint_xattr xrec;
+   struct fskit_checkpoint_dirent drec;
+   fskit_entry_set_itr itr;
+   fskit_entry_set* dp = NULL;
+   struct fskit_entry* child = NULL;
+   char const* name = NULL;
+   char const* value = NULL;
+   char* names = NULL;
+   size_t value_len = 0;
+   int names_len = 0;
+   int rc = 0;
+
+   memset( &rec, 0, sizeof(rec) );
+
+   rec.file_id = fent->file_id;
+   rec.owner = fent->owner;
+   rec.group = fent->group;
+   rec.dev = fent->dev;
+   rec.size = __atomic_load_n( &fent->size, __ATOMIC_RELAXED );
+   rec.atime_sec = fent->atime_sec;
+   rec.atime_nsec = fent->atime_nsec;
+   rec.mtime_sec = fent->mtime_sec;
+   rec.mtime_nsec = fent->mtime_nsec;
+   rec.ctime_sec = fent->ctime_sec;
+   rec.ctime_nsec = fent->ctime_nsec;
+   rec.mode = fent->mode;
+   rec.link_count = fent->link_count;
+   rec.type = fent->type;
+
+   if( fent->type == FSKIT_ENTRY_TYPE_LNK && fent->symlink_target != NULL ) {
+      rec.symlink_len = strlen( fent->symlink_target );
+   }
+
+   // xattr names, NUL-separated
+   names_len = fskit_entry_xattr_list( fent, NULL, 0 );
+   if( names_len > 0 ) {
+
+      names = CALLOC_LIST( char, names_len );
+      if( names == NULL ) {
+         return -ENOMEM;
+      }
+
+      names_len = fskit_entry_xattr_list( fent, names, names_len );
+      if( names_len < 0 ) {
+
+         fskit_safe_free( names );
+         return names_len;
+      }
+
+      for( int i = 0; i < names_len; i += strlen( names + i ) + 1 ) {
+         rec.num_xattrs++;
+      }
+   }
+
+   if( fent->type == FSKIT_ENTRY_TYPE_DIR ) {
+
+      for( dp = fskit_entry_set_begin( &itr, fent->children ); dp != NULL; dp = fskit_entry_set_next( &itr ) ) {
+
+         if( fskit_checkpoint_dirent_ok( fskit_entry_set_name_at( dp ), fskit_entry_set_child_at( dp ) ) ) {
+            rec.num_dirents++;
+         }
+      }
+   }
+
+   rc = fskit_checkpoint_write( ctx, &rec, sizeof(rec) );
+
+   if( rc == 0 && rec.symlink_len > 0 ) {
+      rc = fskit_checkpoint_write( ctx, fent->symlink_target, rec.symlink_len );
+   }
+
+   for( int i = 0; rc == 0 && i < names_len; i += strlen( names + i ) + 1 ) {
+
+      name = names + i;
+      value = fskit_entry_xattr_find( fent, name, &value_len );
+
+      xrec.name_len = strlen( name );
+      xrec.value_len = (value != NULL ? value_len : 0);
+
+      rc = fskit_checkpoint_write( ctx, &xrec, sizeof(xrec) );
+      if( rc == 0 ) {
+         rc = fskit_checkpoint_write( ctx, name, xrec.name_len );
+      }
+
+      if( rc == 0 ) {
+         rc = fskit_checkpoint_write( ctx, value, xrec.value_len );
+      }
+   }
+
+   fskit_safe_free( names );
+
+   if( rc != 0 || fent->type != FSKIT_ENTRY_TYPE_DIR ) {
+      return rc;
+   }
+
+   for( dp = fskit_entry_set_begin( &itr, fent->children ); dp != NULL; dp = fskit_entry_set_next( &itr ) ) {
+
+      name = fskit_entry_set_name_at( dp );
+      child = fskit_entry_set_child_at( dp );
+
+      if( !fskit_checkpoint_dirent_ok( name, child ) ) {
+         continue;
+      }
+
+      memset( &drec, 0, sizeof(drec) );
+      drec.name_len = strlen( name );
+
+      rc = fskit_checkpoint_child_id( ctx, child, &drec.child );
+      if( rc == 0 ) {
+         rc = fskit_checkpoint_write( ctx, &drec, sizeof(drec) );
+      }
+
+      if( rc == 0 ) {
+         rc = fskit_checkpoint_write( ctx, name, drec.name_len );
+      }
+
+      if( rc != 0 ) {
+         return rc;
+      }
+   }
+
+   return 0;
+}
+
+
+// write the namespace to image_path.  The image is written to a temporary file next to it, and moved into place
+// once it is complete, so an existing image at image_path is replaced atomically.
+// return 0 on success
+// return -ENOMEM on OOM
+// return -errno on I/O error
+// NOTE: no other thread may change the namespace while this runs
+int fskit_core_checkpoint( struct fskit_core* core, char const* image_path ) {
+
+   struct fskit_checkpoint_ctx ctx;
+   struct fskit_checkpoint_header header;
+   struct fskit_entry* fent = NULL;
+   char* tmp_path = NULL;
+   uint64_t root_id = 0;
+   int rc = 0;
+
+   memset( &ctx, 0, sizeof(ctx) );
+   memset( &header, 0, sizeof(header) );
+
+   tmp_path = CALLOC_LIST( char, strlen(image_path) + 5 );
+   if( tmp_path == NULL ) {
+      return -ENOMEM;
+   }
+
+   sprintf( tmp_path, "%s.tmp", image_path );
+
+   ctx.f = fopen( tmp_path, "w" );
+   if( ctx.f == NULL ) {
+
+      rc = -errno;
+      fskit_error("fopen('%s') rc = %d\n", tmp_path, rc );
+
+      fskit_safe_free( tmp_path );
+      return rc;
+   }
+
+   // filled in at the end
+   rc = fskit_checkpoint_write( &ctx, &header, sizeof(header) );
+
+   if( rc == 0 ) {
+      rc = fskit_checkpoint_queue( &ctx, &core->root, &root_id );
+   }
+
+   for( uint64_t i = 0; rc == 0 && i < ctx.num_ents; i++ ) {
+
+      fent = ctx.ents[i];
+
+      rc = fskit_entry_rlock( fent );
+      if( rc != 0 ) {
+
+         fskit_error("BUG: entry %" PRIX64 " died during checkpoint\n", ctx.ents[i]->file_id );
+         rc = -EIO;
+         break;
+      }
+
+      if( fent->type == FSKIT_ENTRY_TYPE_DIR ) {
+
+         // fill it in if it is a copy-on-write clone
+         rc = fskit_cow_fixup( core, fent, false );
+      }
+
+      if( rc == 0 ) {
+         rc = fskit_checkpoint_entry( &ctx, fent );
+      }
+
+      fskit_entry_unlock( fent );
+   }
+
+   if( rc == 0 ) {
+
+      memcpy( header.magic, FSKIT_CHECKPOINT_MAGIC, sizeof(header.magic) );
+      header.version = FSKIT_CHECKPOINT_VERSION;
+      header.byte_order = FSKIT_CHECKPOINT_BYTE_ORDER;
+      header.num_entries = ctx.num_ents;
+      header.length = ctx.length;
+
+      if( fseek( ctx.f, 0, SEEK_SET ) != 0 || fwrite( &header, 1, sizeof(header), ctx.f ) != sizeof(header) || fflush( ctx.f ) != 0 || fsync( fileno( ctx.f ) ) != 0 ) {
+         rc = -errno;
+      }
+   }
+
+   if( fclose( ctx.f ) != 0 && rc == 0 ) {
+      rc = -errno;
+   }
+
+   if( rc == 0 && rename( tmp_path, image_path ) != 0 ) {
+      rc = -errno;
+   }
+
+   if( rc != 0 ) {
+
+      fskit_error("checkpoint to '%s' failed, rc = %d\n", image_path, rc );
+      unlink( tmp_path );
+   }
+
+   fskit_safe_free( tmp_path );
+   fskit_safe_free( ctx.ents );
+   fskit_safe_free( ctx.links );
+   fskit_safe_free( ctx.link_ids );
+
+   return rc;
+}
+
+
+// a mapped image, being read
+struct fskit_restore_ctx {
+
+   char const* image;
+   uint64_t length;
+   uint64_t offset;
+};
+
+// get the next len bytes of the image, skipping padding
+// return NULL if the image is too short
+static void const* fskit_restore_next( struct fskit_restore_ctx* ctx, uint64_t len ) {
+
+   void const* ret = NULL;
+   uint64_t padded = FSKIT_CHECKPOINT_ALIGN( len );
+
+   if( padded < len || ctx->offset + padded < ctx->offset || ctx->offset + padded > ctx->length ) {
+      return NULL;
+   }
+
+   ret = ctx->image + ctx->offset;
+   ctx->offset += padded;
+
+   return ret;
+}
+
+
+// free an entry built by fskit_core_restore that never got linked into the namespace
+static void fskit_restore_free_entry( struct fskit_entry* fent ) {
+
+   if( fent->children != NULL ) {
+      fskit_entry_set_free( fent->children );
+   }
+
+   fskit_safe_free( fent->symlink_target );
+   fskit_entry_xattr_clear( fent );
+
+   fskit_rwlock_destroy( &fent->lock );
+}
+
+
+// build an entry from its record, without its directory entries.
+// on success, skip the ctx past the record's xattrs, but not its directory entries.
+// return 0 on success
+// return -ENOMEM on OOM
+// return -EIO if the record is malformed
+static int fskit_restore_entry( struct fskit_core* core, struct fskit_restore_ctx* ctx, struct fskit_entry* fent ) {
+
+   struct fskit_checkpoint_entry const* rec = NULL;
+   struct fskit_checkpoint_xattr const* xrec = NULL;
+   char const* name = NULL;
+   char const* value = NULL;
+   char name_buf[ FSKIT_FILESYSTEM_NAMEMAX + 1 ];
+   int rc = 0;
+
+   rec = (struct fskit_checkpoint_entry const*)fskit_restore_next( ctx, sizeof(*rec) );
+   if( rec == NULL ) {
+      return -EIO;
+   }
+
+   switch( rec->type ) {
+
+      case FSKIT_ENTRY_TYPE_FILE:
+      case FSKIT_ENTRY_TYPE_DIR:
+      case FSKIT_ENTRY_TYPE_FIFO:
+      case FSKIT_ENTRY_TYPE_SOCK:
+      case FSKIT_ENTRY_TYPE_CHR:
+      case FSKIT_ENTRY_TYPE_BLK:
+      case FSKIT_ENTRY_TYPE_LNK:
+         break;
+
+      default:
+         return -EIO;
+   }
+
+   if( rec->type != FSKIT_ENTRY_TYPE_DIR && rec->num_dirents > 0 ) {
+      return -EIO;
+   }
+
+   fskit_entry_init_lowlevel( fent, rec->type, rec->file_id, rec->owner, rec->group, rec->mode );
+
+   fent->dev = rec->dev;
+   fent->size = rec->size;
+   fent->atime_sec = rec->atime_sec;
+   fent->atime_nsec = rec->atime_nsec;
+   fent->mtime_sec = rec->mtime_sec;
+   fent->mtime_nsec = rec->mtime_nsec;
+   fent->ctime_sec = rec->ctime_sec;
+   fent->ctime_nsec = rec->ctime_nsec;
+   fent->link_count = rec->link_count;
+
+   fskit_rwlock_init( &fent->lock );
+
+   if( rec->type == FSKIT_ENTRY_TYPE_DIR ) {
+
+      // .. gets filled in when we find its parent
+      fent->children = fskit_entry_set_new( fent, NULL );
+      if( fent->children == NULL ) {
+         return -ENOMEM;
+      }
+   }
+
+   if( rec->type == FSKIT_ENTRY_TYPE_LNK ) {
+
+      name = (char const*)fskit_restore_next( ctx, rec->symlink_len );
+      if( name == NULL ) {
+         return -EIO;
+      }
+
+      fent->symlink_target = strndup( name, rec->symlink_len );
+      if( fent->symlink_target == NULL ) {
+         return -ENOMEM;
+      }
+   }
+   else if( rec->symlink_len > 0 ) {
+      return -EIO;
+   }
+
+   for( uint32_t i = 0; i < rec->num_xattrs; i++ ) {
+
+      xrec = (struct fskit_checkpoint_xattr const*)fskit_restore_next( ctx, sizeof(*xrec) );
+      if( xrec == NULL || xrec->name_len == 0 || xrec->name_len > FSKIT_FILESYSTEM_NAMEMAX ) {
+         return -EIO;
+      }
+
+      name = (char const*)fskit_restore_next( ctx, xrec->name_len );
+      value = (char const*)fskit_restore_next( ctx, xrec->value_len );
+
+      if( name == NULL || value == NULL ) {
+         return -EIO;
+      }
+
+      memcpy( name_buf, name, xrec->name_len );
+      name_buf[ xrec->name_len ] = '\0';
+
+      rc = fskit_entry_xattr_set( core, fent, name_buf, value, xrec->value_len, 0 );
+      if( rc != 0 ) {
+         return rc;
+      }
+   }
+
+   return 0;
+}
+
+
+// rebuild a namespace from an image written by fskit_core_checkpoint.
+// the root takes on the image root's attributes and xattrs.
+// return 0 on success
+// return -ENOTEMPTY if the root already has children
+// return -EINVAL if image_path isn't a checkpoint image of this version and byte order
+// return -EIO if the image is truncated or malformed
+// return -ENOMEM on OOM
+// return -errno if the image can't be opened or mapped
+int fskit_core_restore( struct fskit_core* core, char const* image_path ) {
+
+   struct fskit_restore_ctx ctx;
+   struct fskit_checkpoint_header const* header = NULL;
+   struct fskit_checkpoint_dirent const* drec = NULL;
+   struct fskit_checkpoint_entry const* rec = NULL;
+   struct fskit_entry* root = &core->root;
+   struct fskit_entry root_attrs;
+   struct fskit_entry** ents = NULL;
+   struct fskit_entry* dir = NULL;
+   struct fskit_entry* child = NULL;
+   fskit_entry_set** children = NULL;
+   uint8_t* linked = NULL;
+   uint64_t* dirent_offsets = NULL;
+   uint64_t* num_dirents = NULL;
+   uint64_t num_entries = 0;
+   uint64_t built = 0;
+   char const* name = NULL;
+   char name_buf[ FSKIT_FILESYSTEM_NAMEMAX + 1 ];
+   struct stat sb;
+   void* image = MAP_FAILED;
+   int fd = -1;
+   int rc = 0;
+
+   memset( &ctx, 0, sizeof(ctx) );
+   memset( &root_attrs, 0, sizeof(root_attrs) );
+
+   // don't bother reading the image if we can't use it.  We check again once it's built.
+   fskit_entry_rlock( root );
+   rc = (root->num_children > 0 ? -ENOTEMPTY : 0);
+   fskit_entry_unlock( root );
+
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   fd = open( image_path, O_RDONLY );
+   if( fd < 0 ) {
+
+      rc = -errno;
+      fskit_error("open('%s') rc = %d\n", image_path, rc );
+      return rc;
+   }
+
+   if( fstat( fd, &sb ) != 0 ) {
+
+      rc = -errno;
+      close( fd );
+      return rc;
+   }
+
+   if( (uint64_t)sb.st_size < sizeof(struct fskit_checkpoint_header) ) {
+
+      close( fd );
+      return -EINVAL;
+   }
+
+   image = mmap( NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd );
+
+   if( image == MAP_FAILED ) {
+
+      rc = -errno;
+      fskit_error("mmap('%s') rc = %d\n", image_path, rc );
+      return rc;
+   }
+
+   // we read it front to back
+   posix_madvise( image, sb.st_size, POSIX_MADV_SEQUENTIAL );
+
+   ctx.image = (char const*)image;
+   ctx.length = sb.st_size;
+
+   header = (struct fskit_checkpoint_header const*)fskit_restore_next( &ctx, sizeof(*header) );
+
+   if( memcmp( header->magic, FSKIT_CHECKPOINT_MAGIC, sizeof(header->magic) ) != 0 || header->version != FSKIT_CHECKPOINT_VERSION || header->byte_order != FSKIT_CHECKPOINT_BYTE_ORDER ) {
+
+      munmap( image, sb.st_size );
+      return -EINVAL;
+   }
+
+   num_entries = header->num_entries;
+
+   if( header->length != (uint64_t)sb.st_size || num_entries == 0 || num_entries > (uint64_t)sb.st_size / sizeof(struct fskit_checkpoint_entry) ) {
+
+      munmap( image, sb.st_size );
+      return -EIO;
+   }
+
+   ents = CALLOC_LIST( struct fskit_entry*, num_entries );
+   children = CALLOC_LIST( fskit_entry_set*, num_entries );
+   dirent_offsets = CALLOC_LIST( uint64_t, num_entries );
+   num_dirents = CALLOC_LIST( uint64_t, num_entries );
+   linked = CALLOC_LIST( uint8_t, num_entries );
+
+   if( ents == NULL || children == NULL || dirent_offsets == NULL || num_dirents == NULL || linked == NULL ) {
+
+      rc = -ENOMEM;
+      goto fskit_core_restore_out;
+   }
+
+   // pass 1: build every entry.  The root's attributes go into root_attrs, and its children into a new set, until
+   // we know the image is good.
+   ents[0] = root;
+
+   for( uint64_t i = 0; i < num_entries; i++ ) {
+
+      if( i > 0 ) {
+
+         ents[i] = CALLOC_LIST( struct fskit_entry, 1 );
+         if( ents[i] == NULL ) {
+            rc = -ENOMEM;
+            break;
+         }
+      }
+
+      rec = (struct fskit_checkpoint_entry const*)(ctx.image + ctx.offset);
+
+      rc = fskit_restore_entry( core, &ctx, (i > 0 ? ents[i] : &root_attrs) );
+      built = i + 1;
+
+      if( rc != 0 ) {
+         break;
+      }
+
+      if( i == 0 && root_attrs.type != FSKIT_ENTRY_TYPE_DIR ) {
+         rc = -EIO;
+         break;
+      }
+
+      children[i] = (i > 0 ? ents[i]->children : root_attrs.children);
+
+      // skip its directory entries for now
+      dirent_offsets[i] = ctx.offset;
+      num_dirents[i] = rec->num_dirents;
+
+      for( uint64_t j = 0; j < rec->num_dirents && rc == 0; j++ ) {
+
+         drec = (struct fskit_checkpoint_dirent const*)fskit_restore_next( &ctx, sizeof(*drec) );
+         if( drec == NULL || fskit_restore_next( &ctx, drec->name_len ) == NULL ) {
+            rc = -EIO;
+         }
+      }
+
+      if( rc != 0 ) {
+         break;
+      }
+   }
+
+   if( rc != 0 ) {
+      goto fskit_core_restore_out;
+   }
+
+   // the root's . and .. are itself
+   fskit_entry_set_replace( root_attrs.children, ".", root );
+   fskit_entry_set_replace( root_attrs.children, "..", root );
+
+   // pass 2: link up directory entries
+   for( uint64_t i = 0; i < num_entries && rc == 0; i++ ) {
+
+      if( children[i] == NULL ) {
+         continue;
+      }
+
+      dir = ents[i];
+      ctx.offset = dirent_offsets[i];
+
+      // pass 1 made sure these are all in bounds
+      for( uint64_t j = 0; j < num_dirents[i] && rc == 0; j++ ) {
+
+         drec = (struct fskit_checkpoint_dirent const*)fskit_restore_next( &ctx, sizeof(*drec) );
+         name = (char const*)fskit_restore_next( &ctx, drec->name_len );
+
+         if( drec->child == 0 || drec->child >= num_entries || drec->name_len == 0 || drec->name_len > FSKIT_FILESYSTEM_NAMEMAX ||
+             memchr( name, '/', drec->name_len ) != NULL || memchr( name, '\0', drec->name_len ) != NULL ) {
+            rc = -EIO;
+            break;
+         }
+
+         child = ents[ drec->child ];
+
+         if( child->type == FSKIT_ENTRY_TYPE_DIR ) {
+
+            // a directory has exactly one parent, and comes after it
+            if( drec->child <= i || linked[ drec->child ] ) {
+               rc = -EIO;
+               break;
+            }
+
+            fskit_entry_set_replace( child->children, "..", dir );
+         }
+
+         memcpy( name_buf, name, drec->name_len );
+         name_buf[ drec->name_len ] = '\0';
+
+         if( fskit_entry_set_find_itr( children[i], name_buf ) != NULL ) {
+            rc = -EIO;
+            break;
+         }
+
+         rc = fskit_entry_set_insert( &children[i], name_buf, child );
+         if( rc != 0 ) {
+            break;
+         }
+
+         linked[ drec->child ] = 1;
+
+         if( i > 0 ) {
+            dir->num_children++;
+         }
+         else {
+            root_attrs.num_children++;
+         }
+      }
+
+      // inserting can move the head of the set
+      if( i > 0 ) {
+         dir->children = children[i];
+      }
+      else {
+         root_attrs.children = children[i];
+      }
+   }
+
+   for( uint64_t i = 1; i < num_entries && rc == 0; i++ ) {
+
+      if( !linked[i] ) {
+         rc = -EIO;
+      }
+   }
+
+   if( rc != 0 ) {
+      goto fskit_core_restore_out;
+   }
+
+   // install it all under the root
+   fskit_entry_wlock( root );
+
+   if( root->num_children > 0 ) {
+
+      fskit_entry_unlock( root );
+      rc = -ENOTEMPTY;
+      goto fskit_core_restore_out;
+   }
+
+   fskit_entry_set_free( fskit_entry_swap_children( root, root_attrs.children ) );
+   root_attrs.children = NULL;
+
+   fskit_usage_add( root->usage, FSKIT_USAGE_DIRENTS, root_attrs.num_children - root->num_children );
+   fskit_usage_add( root->usage, FSKIT_USAGE_NAME_BYTES, fskit_entry_set_name_bytes( root->children ) );
+   root->num_children = root_attrs.num_children;
+   root->owner = root_attrs.owner;
+   root->group = root_attrs.group;
+   root->mode = root_attrs.mode;
+   root->atime_sec = root_attrs.atime_sec;
+   root->atime_nsec = root_attrs.atime_nsec;
+   root->mtime_sec = root_attrs.mtime_sec;
+   root->mtime_nsec = root_attrs.mtime_nsec;
+   root->ctime_sec = root_attrs.ctime_sec;
+   root->ctime_nsec = root_attrs.ctime_nsec;
+
+   fskit_entry_xattr_clear( root );
+   root->xattrs = root_attrs.xattrs;
+   root->xattrs_packed = root_attrs.xattrs_packed;
+   root_attrs.xattrs = NULL;
+   root_attrs.xattrs_packed = NULL;
+
+   fskit_usage_add( root->usage, FSKIT_USAGE_XATTR_BYTES, fskit_entry_xattr_bytes( root ) );
+
+   // nothing else can reach the new entries until the root is unlocked
+   for( uint64_t i = 1; i < num_entries; i++ ) {
+      fskit_usage_charge_entry( core, ents[i], true );
+   }
+
+   fskit_entry_unlock( root );
+
+fskit_core_restore_out:
+
+   if( rc != 0 ) {
+
+      fskit_error("restore from '%s' failed, rc = %d\n", image_path, rc );
+
+      for( uint64_t i = 1; i < num_entries && ents != NULL && ents[i] != NULL; i++ ) {
+
+         if( i < built ) {
+            fskit_restore_free_entry( ents[i] );
+         }
+
+         fskit_safe_free( ents[i] );
+      }
+   }
+
+   if( built > 0 ) {
+
+      // whatever of the root's attributes didn't get installed
+      fskit_restore_free_entry( &root_attrs );
+   }
+
+   fskit_safe_free( ents );
+   fskit_safe_free( children );
+   fskit_safe_free( dirent_offsets );
+   fskit_safe_free( num_dirents );
+   fskit_safe_free( linked );
+
+   munmap( image, sb.st_size );
+
+   return rc;
+}
@@ -34,11 +34,14 @@ static int fskit_file_handle_destroy( struct fskit_file_handle* fh ) {
    fh->fent = NULL;
 
    if( fh->path ) {
+      fskit_usage_add( fh->usage, FSKIT_USAGE_FILE_HANDLES, -1 );
+      fskit_usage_add( fh->usage, FSKIT_USAGE_FILE_HANDLE_BYTES, -(int64_t)(strlen( fh->path ) + 1) );
+
       fskit_safe_free( fh->path );
       fh->path = NULL;
    }
 
-   pthread_rwlock_destroy( &fh->lock );
+   fskit_rwlock_destroy( &fh->lock );
 
    memset( fh, 0, sizeof(struct fskit_file_handle) );
 
@@ -31,11 +31,16 @@ static void fskit_dir_handle_destroy( struct fskit_dir_handle* dirh ) {
    dirh->dent = NULL;
 
    if( dirh->path != NULL ) {
+      fskit_usage_add( dirh->usage, FSKIT_USAGE_DIR_HANDLES, -1 );
+      fskit_usage_add( dirh->usage, FSKIT_USAGE_DIR_HANDLE_BYTES, -(int64_t)(strlen( dirh->path ) + 1) );
+
       fskit_safe_free( dirh->path );
       dirh->path = NULL;
    }
 
-   pthread_rwlock_destroy( &dirh->lock );
+   fskit_telldir_list_free( dirh );
+
+   fskit_rwlock_destroy( &dirh->lock );
 
    memset( dirh, 0, sizeof(struct fskit_dir_handle) );
 
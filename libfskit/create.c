@@ -101,6 +101,16 @@ int fskit_do_create( struct fskit_core* core, struct fskit_entry* parent, char c
    }
    else {
 
+      // count it, if there's room
+      rc = fskit_usage_charge_entry( core, child, false );
+      if( rc != 0 ) {
+
+         fskit_entry_destroy( core, child, false );
+         fskit_safe_free( child );
+
+         return rc;
+      }
+
       // get an inode for this file
       uint64_t child_inode = fskit_core_inode_alloc( core, parent, child );
       if( child_inode == 0 ) {
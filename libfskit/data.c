@@ -0,0 +1,752 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include <fskit/data.h>
+#include <fskit/util.h>
+
+#include "fskit_private/private.h"
+
+// each interior node of a file's page tree has this many slots
+#define FSKIT_DATA_NODE_SHIFT   9
+#define FSKIT_DATA_NODE_SLOTS   (1 << FSKIT_DATA_NODE_SHIFT)
+
+// deep enough to cover any non-negative off_t
+#define FSKIT_DATA_MAX_HEIGHT   ((63 - FSKIT_DATA_PAGE_SHIFT + FSKIT_DATA_NODE_SHIFT - 1) / FSKIT_DATA_NODE_SHIFT)
+
+// interior node
+struct fskit_data_node {
+   uint64_t refs;
+   void* slots[ FSKIT_DATA_NODE_SLOTS ];
+};
+
+// page
+struct fskit_data_page {
+   uint64_t refs;
+   char buf[ FSKIT_DATA_PAGE_SIZE ];
+};
+
+// a file's data.
+// the tree has height levels of nodes above the pages; at height 0, root is the file's only page.
+// nodes and pages are only ever added while the lock is read-locked (with compare-and-swap),
+// and only removed or restructured while it is write-locked.
+// nodes and pages are reference-counted, so cloned files can share them.  A shared node or page
+// (or anything beneath one) is never written in place; it gets copied first, under the write lock.
+struct fskit_data {
+
+   pthread_rwlock_t lock;
+
+   void* root;
+   int height;
+
+   uint64_t size;               // logical size; holes and the tail past it read as zeros
+   uint64_t num_pages;          // number of pages mapped, shared or not
+};
+
+
+// smallest tree height that can hold page pgno
+static int fskit_data_height_for( uint64_t pgno ) {
+
+   int height = 0;
+
+   while( height < FSKIT_DATA_MAX_HEIGHT && (pgno >> (FSKIT_DATA_NODE_SHIFT * height)) != 0 ) {
+      height++;
+   }
+
+   return height;
+}
+
+
+// reference count of a node or page (both start with it)
+static uint64_t* fskit_data_refs( void* block ) {
+   return (uint64_t*)block;
+}
+
+
+// size of a node or page at a given level
+static size_t fskit_data_block_size( int level ) {
+   return (level > 0 ? sizeof(struct fskit_data_node) : sizeof(struct fskit_data_page));
+}
+
+
+// get an entry's data, optionally creating it
+// return NULL if it has none (or on OOM, if create is set)
+static struct fskit_data* fskit_data_get( struct fskit_entry* fent, bool create ) {
+
+   struct fskit_data* data = __atomic_load_n( &fent->data, __ATOMIC_ACQUIRE );
+   struct fskit_data* expected = NULL;
+
+   if( data != NULL || !create ) {
+      return data;
+   }
+
+   data = CALLOC_LIST( struct fskit_data, 1 );
+   if( data == NULL ) {
+      return NULL;
+   }
+
+   pthread_rwlock_init( &data->lock, NULL );
+
+   if( !__atomic_compare_exchange_n( &fent->data, &expected, data, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+
+      // someone else got here first
+      pthread_rwlock_destroy( &data->lock );
+      fskit_safe_free( data );
+
+      data = expected;
+   }
+
+   return data;
+}
+
+
+// install a zeroed node or page into *slot, unless something is there already
+// return what's in the slot afterwards, or NULL on OOM
+static void* fskit_data_slot_fill( void** slot, int level, bool* created ) {
+
+   void* expected = NULL;
+   void* block = calloc( 1, fskit_data_block_size( level ) );
+
+   *created = false;
+
+   if( block == NULL ) {
+      return NULL;
+   }
+
+   *fskit_data_refs( block ) = 1;
+
+   if( !__atomic_compare_exchange_n( slot, &expected, block, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+
+      fskit_safe_free( block );
+      return expected;
+   }
+
+   *created = true;
+   return block;
+}
+
+
+// drop a reference to a node or page, freeing it (and unreferencing its children) if it was the last
+static void fskit_data_unref( void* block, int level ) {
+
+   struct fskit_data_node* node = (struct fskit_data_node*)block;
+
+   if( block == NULL || __atomic_sub_fetch( fskit_data_refs( block ), 1, __ATOMIC_ACQ_REL ) > 0 ) {
+      return;
+   }
+
+   if( level > 0 ) {
+      for( int i = 0; i < FSKIT_DATA_NODE_SLOTS; i++ ) {
+         fskit_data_unref( node->slots[i], level - 1 );
+      }
+   }
+
+   fskit_safe_free( block );
+}
+
+
+// count the pages in a subtree
+static uint64_t fskit_data_count_pages( void* block, int level ) {
+
+   struct fskit_data_node* node = (struct fskit_data_node*)block;
+   uint64_t count = 0;
+
+   if( block == NULL ) {
+      return 0;
+   }
+
+   if( level == 0 ) {
+      return 1;
+   }
+
+   for( int i = 0; i < FSKIT_DATA_NODE_SLOTS; i++ ) {
+      count += fskit_data_count_pages( node->slots[i], level - 1 );
+   }
+
+   return count;
+}
+
+
+// make the node or page in *slot private to this tree, copying it if it is shared
+// return the (possibly new) block, or NULL on OOM
+// NOTE: data must be write-locked, and whatever holds slot must already be private
+static void* fskit_data_own( void** slot, int level ) {
+
+   void* block = *slot;
+   void* copy = NULL;
+   struct fskit_data_node* node = NULL;
+
+   if( __atomic_load_n( fskit_data_refs( block ), __ATOMIC_ACQUIRE ) == 1 ) {
+      return block;
+   }
+
+   copy = malloc( fskit_data_block_size( level ) );
+   if( copy == NULL ) {
+      return NULL;
+   }
+
+   memcpy( copy, block, fskit_data_block_size( level ) );
+   *fskit_data_refs( copy ) = 1;
+
+   if( level > 0 ) {
+
+      // the copy shares the children
+      node = (struct fskit_data_node*)copy;
+
+      for( int i = 0; i < FSKIT_DATA_NODE_SLOTS; i++ ) {
+         if( node->slots[i] != NULL ) {
+            __atomic_add_fetch( fskit_data_refs( node->slots[i] ), 1, __ATOMIC_ACQ_REL );
+         }
+      }
+   }
+
+   *slot = copy;
+   fskit_data_unref( block, level );
+
+   return copy;
+}
+
+
+// find page pgno, optionally allocating it (and the nodes above it) for writing.
+// when writing, set *shared and return NULL if the page (or a node above it) is shared; see fskit_data_page_own.
+// return the page's bytes, or NULL if it's a hole (or on OOM, if write is set)
+// NOTE: data must be at least read-locked, and tall enough to hold pgno if write is set
+static char* fskit_data_page( struct fskit_data* data, uint64_t pgno, bool write, bool* shared ) {
+
+   void** slot = &data->root;
+   void* next = NULL;
+   bool created = false;
+
+   *shared = false;
+
+   if( fskit_data_height_for( pgno ) > data->height ) {
+      return NULL;
+   }
+
+   for( int level = data->height; level >= 0; level-- ) {
+
+      next = __atomic_load_n( slot, __ATOMIC_ACQUIRE );
+
+      if( next == NULL ) {
+
+         if( !write ) {
+            return NULL;
+         }
+
+         next = fskit_data_slot_fill( slot, level, &created );
+         if( next == NULL ) {
+            return NULL;
+         }
+
+         if( created && level == 0 ) {
+            __atomic_fetch_add( &data->num_pages, 1, __ATOMIC_RELAXED );
+         }
+      }
+      else if( write && __atomic_load_n( fskit_data_refs( next ), __ATOMIC_ACQUIRE ) > 1 ) {
+
+         // only a clone of this file can raise the count, and that takes the write lock
+         *shared = true;
+         return NULL;
+      }
+
+      if( level > 0 ) {
+         slot = &((struct fskit_data_node*)next)->slots[ (pgno >> (FSKIT_DATA_NODE_SHIFT * (level - 1))) & (FSKIT_DATA_NODE_SLOTS - 1) ];
+      }
+   }
+
+   return ((struct fskit_data_page*)next)->buf;
+}
+
+
+// find page pgno for writing, allocating it and copying it (and the nodes above it) out of any clones as needed
+// return the page's bytes, or NULL on OOM
+// NOTE: data must be write-locked, and tall enough to hold pgno
+static char* fskit_data_page_own( struct fskit_data* data, uint64_t pgno ) {
+
+   void** slot = &data->root;
+   void* next = NULL;
+
+   for( int level = data->height; level >= 0; level-- ) {
+
+      if( *slot == NULL ) {
+
+         next = calloc( 1, fskit_data_block_size( level ) );
+         if( next == NULL ) {
+            return NULL;
+         }
+
+         *fskit_data_refs( next ) = 1;
+         *slot = next;
+
+         if( level == 0 ) {
+            data->num_pages++;
+         }
+      }
+      else {
+
+         next = fskit_data_own( slot, level );
+         if( next == NULL ) {
+            return NULL;
+         }
+      }
+
+      if( level > 0 ) {
+         slot = &((struct fskit_data_node*)next)->slots[ (pgno >> (FSKIT_DATA_NODE_SHIFT * (level - 1))) & (FSKIT_DATA_NODE_SLOTS - 1) ];
+      }
+   }
+
+   return ((struct fskit_data_page*)next)->buf;
+}
+
+
+// make the tree tall enough to hold page pgno
+// return 0 on success
+// return -ENOMEM on OOM
+// NOTE: data must be write-locked
+static int fskit_data_grow( struct fskit_data* data, uint64_t pgno ) {
+
+   int height = fskit_data_height_for( pgno );
+   struct fskit_data_node* node = NULL;
+
+   if( data->root == NULL ) {
+
+      if( data->height < height ) {
+         data->height = height;
+      }
+
+      return 0;
+   }
+
+   while( data->height < height ) {
+
+      node = CALLOC_LIST( struct fskit_data_node, 1 );
+      if( node == NULL ) {
+         return -ENOMEM;
+      }
+
+      // the old root's reference moves into the new root
+      node->refs = 1;
+      node->slots[0] = data->root;
+
+      data->root = node;
+      data->height++;
+   }
+
+   return 0;
+}
+
+
+// drop every page at or after page cutoff from the subtree in *slot.
+// first is the number of the subtree's first page.
+// return true if the whole subtree was dropped (*slot is then NULL)
+// return false if something is left, or on OOM (in which case shared pages past the cutoff may remain)
+// NOTE: data must be write-locked
+static bool fskit_data_free_from( struct fskit_data* data, void** slot, int level, uint64_t first, uint64_t cutoff ) {
+
+   struct fskit_data_node* node = NULL;
+   uint64_t span = 0;
+   bool empty = true;
+
+   if( *slot == NULL ) {
+      return true;
+   }
+
+   if( first >= cutoff ) {
+
+      data->num_pages -= fskit_data_count_pages( *slot, level );
+
+      fskit_data_unref( *slot, level );
+      *slot = NULL;
+      return true;
+   }
+
+   if( level == 0 ) {
+      return false;
+   }
+
+   span = 1ULL << (FSKIT_DATA_NODE_SHIFT * (level - 1));
+
+   if( first + FSKIT_DATA_NODE_SLOTS * span <= cutoff ) {
+
+      // entirely before the cutoff
+      return false;
+   }
+
+   node = (struct fskit_data_node*)fskit_data_own( slot, level );
+   if( node == NULL ) {
+      return false;
+   }
+
+   for( int i = 0; i < FSKIT_DATA_NODE_SLOTS; i++ ) {
+
+      if( node->slots[i] == NULL ) {
+         continue;
+      }
+
+      if( !fskit_data_free_from( data, &node->slots[i], level - 1, first + i * span, cutoff ) ) {
+         empty = false;
+      }
+   }
+
+   if( empty ) {
+      fskit_data_unref( node, level );
+      *slot = NULL;
+   }
+
+   return empty;
+}
+
+
+// read up to buflen bytes at offset.  Holes read as zeros.
+// return the number of bytes read (0 at or past EOF)
+// return -EINVAL if offset is negative
+ssize_t fskit_data_read( struct fskit_entry* fent, char* buf, size_t buflen, off_t offset ) {
+
+   struct fskit_data* data = fskit_data_get( fent, false );
+   uint64_t size = 0;
+   size_t num_read = 0;
+   size_t pgoff = 0;
+   size_t len = 0;
+   char* page = NULL;
+   bool shared = false;
+
+   if( offset < 0 ) {
+      return -EINVAL;
+   }
+
+   if( data == NULL ) {
+      return 0;
+   }
+
+   pthread_rwlock_rdlock( &data->lock );
+
+   size = __atomic_load_n( &data->size, __ATOMIC_ACQUIRE );
+
+   if( (uint64_t)offset >= size ) {
+
+      pthread_rwlock_unlock( &data->lock );
+      return 0;
+   }
+
+   buflen = MIN( buflen, size - offset );
+
+   while( num_read < buflen ) {
+
+      pgoff = (offset + num_read) & (FSKIT_DATA_PAGE_SIZE - 1);
+      len = MIN( (size_t)FSKIT_DATA_PAGE_SIZE - pgoff, buflen - num_read );
+
+      page = fskit_data_page( data, (offset + num_read) >> FSKIT_DATA_PAGE_SHIFT, false, &shared );
+      if( page != NULL ) {
+         memcpy( buf + num_read, page + pgoff, len );
+      }
+      else {
+         memset( buf + num_read, 0, len );
+      }
+
+      num_read += len;
+   }
+
+   pthread_rwlock_unlock( &data->lock );
+
+   return num_read;
+}
+
+
+// write buflen bytes at offset, allocating pages as needed
+// return the number of bytes written
+// return -EINVAL if offset is negative
+// return -ENOMEM if no memory could be allocated for the first page (later failures yield a short write)
+ssize_t fskit_data_write( struct fskit_entry* fent, char const* buf, size_t buflen, off_t offset ) {
+
+   struct fskit_data* data = NULL;
+   uint64_t last_pgno = 0;
+   uint64_t end = 0;
+   uint64_t size = 0;
+   size_t num_written = 0;
+   size_t pgoff = 0;
+   size_t len = 0;
+   char* page = NULL;
+   bool shared = false;
+   int rc = 0;
+
+   if( offset < 0 || (uint64_t)offset + buflen > (uint64_t)INT64_MAX ) {
+      return -EINVAL;
+   }
+
+   if( buflen == 0 ) {
+      return 0;
+   }
+
+   data = fskit_data_get( fent, true );
+   if( data == NULL ) {
+      return -ENOMEM;
+   }
+
+   last_pgno = (offset + buflen - 1) >> FSKIT_DATA_PAGE_SHIFT;
+
+   pthread_rwlock_rdlock( &data->lock );
+
+   while( fskit_data_height_for( last_pgno ) > data->height ) {
+
+      // need a taller tree
+      pthread_rwlock_unlock( &data->lock );
+      pthread_rwlock_wrlock( &data->lock );
+
+      rc = fskit_data_grow( data, last_pgno );
+
+      pthread_rwlock_unlock( &data->lock );
+
+      if( rc != 0 ) {
+         return rc;
+      }
+
+      pthread_rwlock_rdlock( &data->lock );
+   }
+
+   while( num_written < buflen ) {
+
+      pgoff = (offset + num_written) & (FSKIT_DATA_PAGE_SIZE - 1);
+      len = MIN( (size_t)FSKIT_DATA_PAGE_SIZE - pgoff, buflen - num_written );
+
+      page = fskit_data_page( data, (offset + num_written) >> FSKIT_DATA_PAGE_SHIFT, true, &shared );
+      if( page == NULL && shared ) {
+
+         // shared with a clone: copy it out under the write lock
+         pthread_rwlock_unlock( &data->lock );
+         pthread_rwlock_wrlock( &data->lock );
+
+         page = fskit_data_page_own( data, (offset + num_written) >> FSKIT_DATA_PAGE_SHIFT );
+         if( page != NULL ) {
+            memcpy( page + pgoff, buf + num_written, len );
+         }
+
+         pthread_rwlock_unlock( &data->lock );
+         pthread_rwlock_rdlock( &data->lock );
+
+         if( page == NULL ) {
+            break;
+         }
+
+         num_written += len;
+         continue;
+      }
+
+      if( page == NULL ) {
+         break;
+      }
+
+      memcpy( page + pgoff, buf + num_written, len );
+      num_written += len;
+   }
+
+   // extend the file
+   end = offset + num_written;
+   size = __atomic_load_n( &data->size, __ATOMIC_ACQUIRE );
+
+   while( end > size && !__atomic_compare_exchange_n( &data->size, &size, end, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) );
+
+   pthread_rwlock_unlock( &data->lock );
+
+   if( num_written == 0 ) {
+      return -ENOMEM;
+   }
+
+   return num_written;
+}
+
+
+// set the file's size.  Pages past the new end are freed; growing leaves a hole.
+// return 0 on success
+// return -EINVAL if new_size is negative
+// return -ENOMEM on OOM
+int fskit_data_trunc( struct fskit_entry* fent, off_t new_size ) {
+
+   struct fskit_data* data = NULL;
+   uint64_t cutoff = 0;
+   char* page = NULL;
+   bool shared = false;
+
+   if( new_size < 0 ) {
+      return -EINVAL;
+   }
+
+   data = fskit_data_get( fent, new_size > 0 );
+   if( data == NULL ) {
+      return (new_size > 0 ? -ENOMEM : 0);
+   }
+
+   pthread_rwlock_wrlock( &data->lock );
+
+   if( (uint64_t)new_size < data->size ) {
+
+      // free whole pages past the end
+      cutoff = ((uint64_t)new_size + FSKIT_DATA_PAGE_SIZE - 1) >> FSKIT_DATA_PAGE_SHIFT;
+
+      fskit_data_free_from( data, &data->root, data->height, 0, cutoff );
+
+      // zero the rest of the last page, so growing the file again exposes zeros
+      if( (new_size & (FSKIT_DATA_PAGE_SIZE - 1)) != 0 && fskit_data_page( data, new_size >> FSKIT_DATA_PAGE_SHIFT, false, &shared ) != NULL ) {
+
+         page = fskit_data_page_own( data, new_size >> FSKIT_DATA_PAGE_SHIFT );
+         if( page == NULL ) {
+
+            pthread_rwlock_unlock( &data->lock );
+            return -ENOMEM;
+         }
+         else {
+            memset( page + (new_size & (FSKIT_DATA_PAGE_SIZE - 1)), 0, FSKIT_DATA_PAGE_SIZE - (new_size & (FSKIT_DATA_PAGE_SIZE - 1)) );
+         }
+      }
+   }
+
+   data->size = new_size;
+
+   pthread_rwlock_unlock( &data->lock );
+
+   return 0;
+}
+
+
+// number of bytes of pages allocated to the file
+uint64_t fskit_data_get_allocated( struct fskit_entry* fent ) {
+
+   struct fskit_data* data = fskit_data_get( fent, false );
+
+   if( data == NULL ) {
+      return 0;
+   }
+
+   return __atomic_load_n( &data->num_pages, __ATOMIC_RELAXED ) * FSKIT_DATA_PAGE_SIZE;
+}
+
+
+// give dest (which has no data yet) a copy of src's data.
+// this takes constant time: the two share src's pages until either one writes to them.
+// return 0 on success
+// return -ENOMEM on OOM
+// NOTE: dest must not be visible to other threads yet
+int fskit_data_clone( struct fskit_entry* dest, struct fskit_entry* src ) {
+
+   struct fskit_data* data = fskit_data_get( src, false );
+   struct fskit_data* copy = NULL;
+
+   if( data == NULL ) {
+      return 0;
+   }
+
+   copy = CALLOC_LIST( struct fskit_data, 1 );
+   if( copy == NULL ) {
+      return -ENOMEM;
+   }
+
+   pthread_rwlock_init( &copy->lock, NULL );
+
+   // no page may be written in place while we share it
+   pthread_rwlock_wrlock( &data->lock );
+
+   copy->root = data->root;
+   copy->height = data->height;
+   copy->size = data->size;
+   copy->num_pages = data->num_pages;
+
+   if( copy->root != NULL ) {
+      __atomic_add_fetch( fskit_data_refs( copy->root ), 1, __ATOMIC_ACQ_REL );
+   }
+
+   pthread_rwlock_unlock( &data->lock );
+
+   dest->data = copy;
+   return 0;
+}
+
+
+// free an entry's data.
+// NOTE: fent must not be undergoing I/O
+void fskit_data_free( struct fskit_entry* fent ) {
+
+   struct fskit_data* data = fent->data;
+
+   if( data == NULL ) {
+      return;
+   }
+
+   fskit_data_unref( data->root, data->height );
+
+   pthread_rwlock_destroy( &data->lock );
+   fskit_safe_free( data );
+
+   fent->data = NULL;
+}
+
+
+// read route
+int fskit_data_read_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data ) {
+
+   return (int)fskit_data_read( fent, buf, buflen, offset );
+}
+
+
+// write route
+int fskit_data_write_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data ) {
+
+   return (int)fskit_data_write( fent, buf, buflen, offset );
+}
+
+
+// trunc route
+int fskit_data_trunc_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, off_t new_size, void* handle_data ) {
+
+   return fskit_data_trunc( fent, new_size );
+}
+
+
+// install read, write, and trunc routes that keep the data of files matching route_regex in RAM.
+// the routes are concurrent; the page tree does its own locking.
+// return 0 on success
+// return -ENOMEM on OOM
+// return -EINVAL if the regex is invalid
+int fskit_data_route( struct fskit_core* core, char const* route_regex ) {
+
+   int read_rh = 0;
+   int write_rh = 0;
+   int trunc_rh = 0;
+
+   read_rh = fskit_route_read( core, route_regex, fskit_data_read_cb, FSKIT_CONCURRENT );
+   if( read_rh < 0 ) {
+      return read_rh;
+   }
+
+   write_rh = fskit_route_write( core, route_regex, fskit_data_write_cb, FSKIT_CONCURRENT );
+   if( write_rh < 0 ) {
+
+      fskit_unroute_read( core, read_rh );
+      return write_rh;
+   }
+
+   trunc_rh = fskit_route_trunc( core, route_regex, fskit_data_trunc_cb, FSKIT_CONCURRENT );
+   if( trunc_rh < 0 ) {
+
+      fskit_unroute_read( core, read_rh );
+      fskit_unroute_write( core, write_rh );
+      return trunc_rh;
+   }
+
+   return 0;
+}
@@ -19,14 +19,89 @@
    <http://www.isc.org/downloads/software-support-policy/isc-license/>.
 */
 
+// logging.
+// a message that passes the level check is formatted by the calling thread into a ring buffer of its own, so
+// threads don't contend on a lock or make a syscall to log.  A background thread drains the rings and writes
+// them out in batches.  A thread that fills its ring drains all the rings itself, unless another thread is
+// already draining; then its new messages are dropped and counted, rather than waiting.
+// the rings are drained on exit, on fskit_log_flush(), and on fskit_library_shutdown().
+// with fskit_log_set_async( false ), each message is instead written with a single write(2) by its caller.
+
 #include <fskit/debug.h>
 
 #include "fskit_private/private.h"
 
+#include <time.h>
+
+#define FSKIT_LOG_RING_SLOTS            512             // must be a power of 2
+#define FSKIT_LOG_DRAIN_INTERVAL_MS     10
+#define FSKIT_LOG_WRITE_BUF             65536
+
+// one thread's messages.  The thread writes at head; the drain thread reads at tail.
+struct fskit_log_ring {
+
+   uint64_t head;
+   uint64_t tail;
+   uint64_t dropped;
+   int exited;                          // set once the owning thread has exited
+
+   struct fskit_log_ring* next;
+
+   uint16_t lens[ FSKIT_LOG_RING_SLOTS ];
+   char slots[ FSKIT_LOG_RING_SLOTS ][ FSKIT_LOG_MSG_MAX ];
+};
+
 int FSKIT_GLOBAL_DEBUG_LOCKS = 1;
 int FSKIT_GLOBAL_DEBUG_MESSAGES = 1;
 int FSKIT_GLOBAL_ERROR_MESSAGES = 1;
 
+static uint64_t fskit_log_mask = FSKIT_LOG_ALL;
+static int fskit_log_async = 1;
+static int fskit_log_fd = STDERR_FILENO;
+
+static pthread_mutex_t fskit_log_lock = PTHREAD_MUTEX_INITIALIZER;    // guards the ring list
+static pthread_mutex_t fskit_log_drain_lock = PTHREAD_MUTEX_INITIALIZER;      // one drainer at a time
+static pthread_cond_t fskit_log_drain_cond = PTHREAD_COND_INITIALIZER;
+static struct fskit_log_ring* fskit_log_rings = NULL;
+static uint64_t fskit_log_dropped = 0;          // dropped from rings that have been freed
+static int fskit_log_pid = 0;                   // getpid() is a syscall, so keep it
+
+static pthread_once_t fskit_log_once = PTHREAD_ONCE_INIT;
+static pthread_key_t fskit_log_key;
+
+static _Thread_local struct fskit_log_ring* fskit_log_self = NULL;
+
+// which files belong to which subsystems.  Files not listed belong to FSKIT_LOG_APP
+static struct {
+   char const* name;
+   int subsystem;
+} fskit_log_files[] = {
+   { "entry.c", FSKIT_LOG_CORE },       { "path.c", FSKIT_LOG_CORE },        { "fskit.c", FSKIT_LOG_CORE },
+   { "debug.c", FSKIT_LOG_CORE },       { "random.c", FSKIT_LOG_CORE },      { "rwlock.c", FSKIT_LOG_CORE },
+   { "lockstat.c", FSKIT_LOG_CORE },    { "statvfs.c", FSKIT_LOG_CORE },
+   { "access.c", FSKIT_LOG_OPS },       { "chmod.c", FSKIT_LOG_OPS },        { "chown.c", FSKIT_LOG_OPS },
+   { "close.c", FSKIT_LOG_OPS },        { "closedir.c", FSKIT_LOG_OPS },     { "create.c", FSKIT_LOG_OPS },
+   { "link.c", FSKIT_LOG_OPS },         { "mkdir.c", FSKIT_LOG_OPS },        { "mknod.c", FSKIT_LOG_OPS },
+   { "open.c", FSKIT_LOG_OPS },         { "opendir.c", FSKIT_LOG_OPS },      { "read.c", FSKIT_LOG_OPS },
+   { "readdir.c", FSKIT_LOG_OPS },      { "readlink.c", FSKIT_LOG_OPS },     { "rename.c", FSKIT_LOG_OPS },
+   { "rmdir.c", FSKIT_LOG_OPS },        { "stat.c", FSKIT_LOG_OPS },         { "symlink.c", FSKIT_LOG_OPS },
+   { "sync.c", FSKIT_LOG_OPS },         { "trunc.c", FSKIT_LOG_OPS },        { "unlink.c", FSKIT_LOG_OPS },
+   { "utime.c", FSKIT_LOG_OPS },        { "write.c", FSKIT_LOG_OPS },
+   { "route.c", FSKIT_LOG_ROUTE },
+   { "xattr.c", FSKIT_LOG_XATTR },      { "getxattr.c", FSKIT_LOG_XATTR },   { "setxattr.c", FSKIT_LOG_XATTR },
+   { "listxattr.c", FSKIT_LOG_XATTR },  { "removexattr.c", FSKIT_LOG_XATTR },
+   { "data.c", FSKIT_LOG_DATA },
+   { "deferred.c", FSKIT_LOG_DEFERRED },
+   { "snapshot.c", FSKIT_LOG_SNAPSHOT },        { "checkpoint.c", FSKIT_LOG_SNAPSHOT },
+   { "repl.c", FSKIT_LOG_REPL },
+   { "fskit_fuse.c", FSKIT_LOG_FUSE },  { "fskit_fuse_stats.c", FSKIT_LOG_FUSE },
+   { NULL, 0 }
+};
+
+static char const* fskit_log_subsystem_names[ FSKIT_LOG_NUM_SUBSYSTEMS ] = {
+   "core", "ops", "route", "xattr", "data", "deferred", "snapshot", "repl", "fuse", "app"
+};
+
 void fskit_set_debug_level( int d ) {
    FSKIT_GLOBAL_DEBUG_MESSAGES = d;
    
@@ -64,3 +139,392 @@ unsigned long long int fskit_pthread_self(void) {
    fskit_thread.t = pthread_self();
    return fskit_thread.i;
 }
+
+// work out which subsystem a source file belongs to
+static int fskit_log_file_subsystem( char const* file ) {
+
+   char const* base = strrchr( file, '/' );
+   base = (base != NULL ? base + 1 : file);
+
+   for( int i = 0; fskit_log_files[i].name != NULL; i++ ) {
+      if( strcmp( fskit_log_files[i].name, base ) == 0 ) {
+         return fskit_log_files[i].subsystem;
+      }
+   }
+
+   return FSKIT_LOG_APP;
+}
+
+// write all of buf to fd, and give up on errors
+static void fskit_log_write_all( int fd, char const* buf, size_t len ) {
+
+   while( len > 0 ) {
+
+      ssize_t nw = write( fd, buf, len );
+      if( nw < 0 ) {
+         if( errno == EINTR ) {
+            continue;
+         }
+
+         return;
+      }
+
+      buf += nw;
+      len -= nw;
+   }
+}
+
+// move everything in the rings to the log fd, and free the rings of threads that have exited.
+// the caller must hold fskit_log_drain_lock
+static void fskit_log_drain_locked(void) {
+
+   static char buf[ FSKIT_LOG_WRITE_BUF ];
+   size_t len = 0;
+   uint64_t dropped = 0;
+   int fd = __atomic_load_n( &fskit_log_fd, __ATOMIC_RELAXED );
+
+   pthread_mutex_lock( &fskit_log_lock );
+
+   struct fskit_log_ring** prev = &fskit_log_rings;
+
+   while( *prev != NULL ) {
+
+      struct fskit_log_ring* ring = *prev;
+
+      // check before draining, so that nothing logged before exit is missed
+      int exited = __atomic_load_n( &ring->exited, __ATOMIC_ACQUIRE );
+      uint64_t tail = ring->tail;
+      uint64_t head = __atomic_load_n( &ring->head, __ATOMIC_ACQUIRE );
+
+      for( ; tail != head; tail++ ) {
+
+         unsigned int slot = tail & (FSKIT_LOG_RING_SLOTS - 1);
+
+         if( len + ring->lens[slot] > FSKIT_LOG_WRITE_BUF ) {
+            fskit_log_write_all( fd, buf, len );
+            len = 0;
+         }
+
+         memcpy( buf + len, ring->slots[slot], ring->lens[slot] );
+         len += ring->lens[slot];
+      }
+
+      __atomic_store_n( &ring->tail, tail, __ATOMIC_RELEASE );
+
+      dropped += __atomic_exchange_n( &ring->dropped, 0, __ATOMIC_RELAXED );
+
+      if( exited ) {
+
+         *prev = ring->next;
+         free( ring );
+      }
+      else {
+
+         prev = &ring->next;
+      }
+   }
+
+   pthread_mutex_unlock( &fskit_log_lock );
+
+   if( len > 0 ) {
+      fskit_log_write_all( fd, buf, len );
+   }
+
+   if( dropped > 0 ) {
+
+      __atomic_add_fetch( &fskit_log_dropped, dropped, __ATOMIC_RELAXED );
+
+      len = snprintf( buf, sizeof(buf), "%05d: [fskit] %" PRIu64 " log messages dropped\n", fskit_log_pid, dropped );
+      fskit_log_write_all( fd, buf, len );
+   }
+}
+
+static void fskit_log_drain(void) {
+
+   pthread_mutex_lock( &fskit_log_drain_lock );
+   fskit_log_drain_locked();
+   pthread_mutex_unlock( &fskit_log_drain_lock );
+}
+
+// background drainer
+static void* fskit_log_drain_main( void* arg ) {
+
+   struct timespec deadline;
+
+   while( true ) {
+
+      clock_gettime( CLOCK_REALTIME, &deadline );
+
+      deadline.tv_nsec += FSKIT_LOG_DRAIN_INTERVAL_MS * 1000000L;
+      if( deadline.tv_nsec >= 1000000000L ) {
+         deadline.tv_sec++;
+         deadline.tv_nsec -= 1000000000L;
+      }
+
+      pthread_mutex_lock( &fskit_log_drain_lock );
+      pthread_cond_timedwait( &fskit_log_drain_cond, &fskit_log_drain_lock, &deadline );
+      pthread_mutex_unlock( &fskit_log_drain_lock );
+
+      fskit_log_drain();
+   }
+
+   return NULL;
+}
+
+// mark a thread's ring as orphaned; the drainer frees it once it's empty
+static void fskit_log_thread_exit( void* arg ) {
+
+   struct fskit_log_ring* ring = (struct fskit_log_ring*)arg;
+
+   fskit_log_self = NULL;
+   __atomic_store_n( &ring->exited, 1, __ATOMIC_RELEASE );
+}
+
+// start the background drainer.  If we can't, fall back to writing synchronously.
+static void fskit_log_start_drainer(void) {
+
+   pthread_t drainer;
+   pthread_attr_t attrs;
+
+   pthread_attr_init( &attrs );
+   pthread_attr_setdetachstate( &attrs, PTHREAD_CREATE_DETACHED );
+
+   if( pthread_create( &drainer, &attrs, fskit_log_drain_main, NULL ) != 0 ) {
+      __atomic_store_n( &fskit_log_async, 0, __ATOMIC_RELAXED );
+   }
+
+   pthread_attr_destroy( &attrs );
+}
+
+// hold the log locks across a fork, so the child doesn't inherit them mid-update.
+// (same order as fskit_log_drain: the drain lock, then the ring list lock)
+static void fskit_log_atfork_prepare(void) {
+
+   pthread_mutex_lock( &fskit_log_drain_lock );
+   pthread_mutex_lock( &fskit_log_lock );
+}
+
+static void fskit_log_atfork_parent(void) {
+
+   pthread_mutex_unlock( &fskit_log_lock );
+   pthread_mutex_unlock( &fskit_log_drain_lock );
+}
+
+// the child of a fork has a new pid, only the forking thread, and no drainer.
+// the parent still writes out whatever was buffered before the fork, so the child starts with empty rings.
+static void fskit_log_atfork_child(void) {
+
+   struct fskit_log_ring* ring = fskit_log_rings;
+   struct fskit_log_ring* next = NULL;
+
+   fskit_log_pid = (int)getpid();
+
+   pthread_mutex_init( &fskit_log_lock, NULL );
+   pthread_mutex_init( &fskit_log_drain_lock, NULL );
+   pthread_cond_init( &fskit_log_drain_cond, NULL );
+
+   fskit_log_rings = NULL;
+
+   for( ; ring != NULL; ring = next ) {
+
+      next = ring->next;
+
+      if( ring == fskit_log_self ) {
+
+         ring->tail = ring->head;
+         ring->dropped = 0;
+         ring->next = NULL;
+         fskit_log_rings = ring;
+      }
+      else {
+
+         // its thread doesn't exist here
+         free( ring );
+      }
+   }
+
+   fskit_log_start_drainer();
+}
+
+static void fskit_log_setup(void) {
+
+   fskit_log_pid = (int)getpid();
+   pthread_atfork( fskit_log_atfork_prepare, fskit_log_atfork_parent, fskit_log_atfork_child );
+
+   pthread_key_create( &fskit_log_key, fskit_log_thread_exit );
+
+   fskit_log_start_drainer();
+
+   atexit( fskit_log_flush );
+}
+
+// get this thread's ring, making it if need be.
+// return NULL if we're out of memory
+static struct fskit_log_ring* fskit_log_thread_ring(void) {
+
+   struct fskit_log_ring* ring = fskit_log_self;
+
+   if( ring != NULL ) {
+      return ring;
+   }
+
+   ring = (struct fskit_log_ring*)calloc( 1, sizeof(struct fskit_log_ring) );
+   if( ring == NULL ) {
+      return NULL;
+   }
+
+   pthread_setspecific( fskit_log_key, ring );
+
+   pthread_mutex_lock( &fskit_log_lock );
+
+   ring->next = fskit_log_rings;
+   fskit_log_rings = ring;
+
+   pthread_mutex_unlock( &fskit_log_lock );
+
+   fskit_log_self = ring;
+   return ring;
+}
+
+// format a message: the usual prefix, then the caller's message.
+// return the length, which is cut short to fit in FSKIT_LOG_MSG_MAX
+static size_t fskit_log_format( char* buf, char const* level, char const* file, int line, char const* func, char const* format, va_list args ) {
+
+   int len = snprintf( buf, FSKIT_LOG_MSG_MAX, FSKIT_WHERESTR, fskit_log_pid, fskit_pthread_self(), file, line, func, level );
+
+   if( len >= 0 && len < FSKIT_LOG_MSG_MAX ) {
+      len += vsnprintf( buf + len, FSKIT_LOG_MSG_MAX - len, format, args );
+   }
+
+   if( len < 0 ) {
+      return 0;
+   }
+
+   if( len >= FSKIT_LOG_MSG_MAX ) {
+
+      // cut short, and say so
+      memcpy( buf + FSKIT_LOG_MSG_MAX - 5, "...\n", 4 );
+      len = FSKIT_LOG_MSG_MAX - 1;
+   }
+
+   return len;
+}
+
+// log a message, if its subsystem is enabled.
+// called by fskit_debug and fskit_error once the level check has passed.
+void fskit_log( int* subsystem, char const* level, char const* file, int line, char const* func, char const* format, ... ) {
+
+   int subsys = __atomic_load_n( subsystem, __ATOMIC_RELAXED );
+   struct fskit_log_ring* ring = NULL;
+   va_list args;
+
+   if( subsys < 0 ) {
+      subsys = fskit_log_file_subsystem( file );
+      __atomic_store_n( subsystem, subsys, __ATOMIC_RELAXED );
+   }
+
+   if( (__atomic_load_n( &fskit_log_mask, __ATOMIC_RELAXED ) & (1ULL << subsys)) == 0 ) {
+      return;
+   }
+
+   pthread_once( &fskit_log_once, fskit_log_setup );
+
+   va_start( args, format );
+
+   if( __atomic_load_n( &fskit_log_async, __ATOMIC_RELAXED ) ) {
+      ring = fskit_log_thread_ring();
+   }
+
+   if( ring == NULL ) {
+
+      // synchronous
+      char buf[ FSKIT_LOG_MSG_MAX ];
+      size_t len = fskit_log_format( buf, level, file, line, func, format, args );
+
+      fskit_log_write_all( __atomic_load_n( &fskit_log_fd, __ATOMIC_RELAXED ), buf, len );
+   }
+   else {
+
+      uint64_t head = ring->head;
+      uint64_t tail = __atomic_load_n( &ring->tail, __ATOMIC_ACQUIRE );
+
+      if( head - tail >= FSKIT_LOG_RING_SLOTS && pthread_mutex_trylock( &fskit_log_drain_lock ) == 0 ) {
+
+         // full, and no one is draining.  Do it ourselves, so a busy thread can't outrun the drainer.
+         fskit_log_drain_locked();
+         pthread_mutex_unlock( &fskit_log_drain_lock );
+
+         tail = __atomic_load_n( &ring->tail, __ATOMIC_ACQUIRE );
+      }
+
+      if( head - tail >= FSKIT_LOG_RING_SLOTS ) {
+
+         // still full; someone else is draining.  Don't wait for them.
+         __atomic_add_fetch( &ring->dropped, 1, __ATOMIC_RELAXED );
+      }
+      else {
+
+         unsigned int slot = head & (FSKIT_LOG_RING_SLOTS - 1);
+
+         ring->lens[slot] = fskit_log_format( ring->slots[slot], level, file, line, func, format, args );
+         __atomic_store_n( &ring->head, head + 1, __ATOMIC_RELEASE );
+
+         if( head - tail == FSKIT_LOG_RING_SLOTS / 2 ) {
+            pthread_cond_signal( &fskit_log_drain_cond );
+         }
+      }
+   }
+
+   va_end( args );
+}
+
+// set which subsystems to log, as a bitmask of (1 << FSKIT_LOG_*)
+void fskit_log_set_mask( uint64_t mask ) {
+   __atomic_store_n( &fskit_log_mask, mask, __ATOMIC_RELAXED );
+}
+
+uint64_t fskit_log_get_mask(void) {
+   return __atomic_load_n( &fskit_log_mask, __ATOMIC_RELAXED );
+}
+
+// log through the per-thread rings (true, the default), or write each message as it is logged (false).
+// switching to synchronous drains what is buffered first.
+void fskit_log_set_async( bool async ) {
+
+   __atomic_store_n( &fskit_log_async, async ? 1 : 0, __ATOMIC_RELAXED );
+
+   if( !async ) {
+      fskit_log_flush();
+   }
+}
+
+bool fskit_log_get_async(void) {
+   return __atomic_load_n( &fskit_log_async, __ATOMIC_RELAXED ) != 0;
+}
+
+// send log messages to fd instead of stderr.  Buffered messages go to the old fd first.
+void fskit_log_set_fd( int fd ) {
+
+   fskit_log_flush();
+   __atomic_store_n( &fskit_log_fd, fd, __ATOMIC_RELAXED );
+}
+
+// write out everything logged so far
+void fskit_log_flush(void) {
+   fskit_log_drain();
+}
+
+// number of messages dropped because a thread's ring was full, as of the last drain
+uint64_t fskit_log_get_dropped(void) {
+   return __atomic_load_n( &fskit_log_dropped, __ATOMIC_RELAXED );
+}
+
+// name of a subsystem
+char const* fskit_log_subsystem_name( int subsystem ) {
+
+   if( subsystem < 0 || subsystem >= FSKIT_LOG_NUM_SUBSYSTEMS ) {
+      return "unknown";
+   }
+
+   return fskit_log_subsystem_names[ subsystem ];
+}
@@ -0,0 +1,572 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include <fskit/deferred.h>
+#include <fskit/path.h>
+#include <fskit/util.h>
+
+#include "fskit_private/private.h"
+
+// a removed entry awaiting reclamation
+struct fskit_deferred_job {
+
+   char* path;                          // path the entry had when it was removed
+   struct fskit_entry* ent;             // the removed entry (referenced via open_count)
+   fskit_entry_set* children;           // its former children, if it was a non-empty directory
+
+   struct fskit_deferred_job* next;
+};
+
+// per-core reaper pool
+struct fskit_deferred {
+
+   struct fskit_core* core;
+
+   // FIFO of jobs not yet picked up
+   struct fskit_deferred_job* head;
+   struct fskit_deferred_job* tail;
+
+   // jobs queued or running
+   uint64_t num_pending;
+
+   // throttle: removals block while num_pending is at least this (0 means unlimited)
+   uint64_t max_pending;
+
+   // reaper threads, started on demand up to num_threads
+   pthread_t* threads;
+   int num_threads;
+   int num_started;
+
+   bool stop;
+
+   pthread_mutex_t lock;
+   pthread_cond_t work_cv;              // signaled when a job is queued, or on stop
+   pthread_cond_t done_cv;              // signaled when a job finishes
+};
+
+
+// reclaim a removed entry: run its detach route, detach and destroy its descendants, and destroy it once it is no longer open.
+// the job's reference to the entry is released here.
+static void fskit_deferred_reap( struct fskit_core* core, struct fskit_deferred_job* job ) {
+
+   int rc = 0;
+   struct fskit_entry* fent = job->ent;
+
+   // user detach handler
+   rc = fskit_run_user_detach( core, job->path, NULL, fent );
+   if( rc < 0 ) {
+      fskit_error("fskit_run_user_detach('%s') rc = %d\n", job->path, rc );
+   }
+
+   if( job->children != NULL ) {
+
+      struct fskit_detach_ctx* ctx = NULL;
+
+      // same as fskit_detach_all: retry until memory frees up
+      while( ctx == NULL ) {
+         ctx = fskit_detach_ctx_new();
+      }
+
+      fskit_detach_ctx_init( ctx );
+
+      while( true ) {
+
+         rc = fskit_detach_all_ex( core, job->path, &job->children, ctx );
+         if( rc != -ENOMEM ) {
+            break;
+         }
+      }
+
+      if( rc != 0 ) {
+         fskit_error("fskit_detach_all_ex('%s') rc = %d\n", job->path, rc );
+      }
+
+      fskit_entry_set_free( job->children );
+      job->children = NULL;
+
+      fskit_detach_ctx_free( ctx );
+      fskit_safe_free( ctx );
+   }
+
+   fskit_entry_wlock( fent );
+
+   // release our reference
+   fent->open_count--;
+
+   // NOTE: this unlocks and frees fent if it is fully unref'ed
+   rc = fskit_entry_try_destroy_and_free( core, job->path, NULL, fent );
+   if( rc == 0 ) {
+
+      // still open somewhere; the last close will destroy it
+      fskit_entry_unlock( fent );
+   }
+   else if( rc < 0 ) {
+
+      fskit_error("fskit_entry_try_destroy_and_free('%s') rc = %d\n", job->path, rc );
+      fskit_entry_unlock( fent );
+   }
+}
+
+
+// reaper thread: run jobs until told to stop and the queue is empty
+static void* fskit_deferred_main( void* arg ) {
+
+   struct fskit_deferred* deferred = (struct fskit_deferred*)arg;
+   struct fskit_deferred_job* job = NULL;
+
+   pthread_mutex_lock( &deferred->lock );
+
+   while( true ) {
+
+      while( deferred->head == NULL && !deferred->stop ) {
+         pthread_cond_wait( &deferred->work_cv, &deferred->lock );
+      }
+
+      if( deferred->head == NULL ) {
+         // stopped, and drained
+         break;
+      }
+
+      job = deferred->head;
+      deferred->head = job->next;
+      if( deferred->head == NULL ) {
+         deferred->tail = NULL;
+      }
+
+      pthread_mutex_unlock( &deferred->lock );
+
+      fskit_deferred_reap( deferred->core, job );
+
+      fskit_safe_free( job->path );
+      fskit_safe_free( job );
+
+      pthread_mutex_lock( &deferred->lock );
+
+      deferred->num_pending--;
+      pthread_cond_broadcast( &deferred->done_cv );
+   }
+
+   pthread_mutex_unlock( &deferred->lock );
+
+   return NULL;
+}
+
+
+// queue a job, and start another reaper if we're allowed to.
+// return 0 on success
+// return -ENOMEM if no reaper is running and we could not start one
+static int fskit_deferred_enqueue( struct fskit_deferred* deferred, struct fskit_deferred_job* job ) {
+
+   int rc = 0;
+
+   pthread_mutex_lock( &deferred->lock );
+
+   if( deferred->num_started < deferred->num_threads ) {
+
+      pthread_t* threads = (pthread_t*)realloc( deferred->threads, (deferred->num_started + 1) * sizeof(pthread_t) );
+      if( threads != NULL ) {
+
+         deferred->threads = threads;
+
+         rc = pthread_create( &deferred->threads[ deferred->num_started ], NULL, fskit_deferred_main, deferred );
+         if( rc == 0 ) {
+            deferred->num_started++;
+         }
+         else {
+            fskit_error("pthread_create rc = %d\n", rc );
+         }
+      }
+
+      if( deferred->num_started == 0 ) {
+
+         // nothing to run the job
+         pthread_mutex_unlock( &deferred->lock );
+         return -ENOMEM;
+      }
+   }
+
+   job->next = NULL;
+   if( deferred->tail == NULL ) {
+      deferred->head = job;
+      deferred->tail = job;
+   }
+   else {
+      deferred->tail->next = job;
+      deferred->tail = job;
+   }
+
+   deferred->num_pending++;
+
+   pthread_cond_signal( &deferred->work_cv );
+   pthread_mutex_unlock( &deferred->lock );
+
+   return 0;
+}
+
+
+// block while too much reclamation is outstanding
+static void fskit_deferred_throttle( struct fskit_deferred* deferred ) {
+
+   pthread_mutex_lock( &deferred->lock );
+
+   while( deferred->max_pending > 0 && deferred->num_pending >= deferred->max_pending && !deferred->stop ) {
+      pthread_cond_wait( &deferred->done_cv, &deferred->lock );
+   }
+
+   pthread_mutex_unlock( &deferred->lock );
+}
+
+
+// unlink the entry at child_path from its parent now, and reclaim it (and, if recursive, everything beneath it) on a reaper thread.
+// if child is not NULL, then child_path must still refer to it.
+// return 0 on success
+// return -ENAMETOOLONG if the path is too long
+// return -ENOENT if there is no such entry (or it is no longer child)
+// return -ENOTDIR if a path component isn't a directory
+// return -ENOTEMPTY if the entry is a non-empty directory and recursive is false
+// return -EBUSY for the root directory
+// return -ENOMEM on OOM
+static int fskit_deferred_remove_ex( struct fskit_core* core, char const* child_path, struct fskit_entry* child, bool recursive ) {
+
+   int rc = 0;
+   char path[PATH_MAX];
+   char* path_dirname = NULL;
+   char* path_basename = NULL;
+   struct fskit_entry* parent = NULL;
+   struct fskit_entry* fent = NULL;
+   struct fskit_deferred_job* job = NULL;
+   int64_t num_children = 0;
+
+   if( strlen(child_path) >= PATH_MAX ) {
+      return -ENAMETOOLONG;
+   }
+
+   if( fskit_basename_len(child_path) > FSKIT_FILESYSTEM_NAMEMAX ) {
+      return -ENAMETOOLONG;
+   }
+
+   memset( path, 0, PATH_MAX );
+   strncpy( path, child_path, PATH_MAX - 1 );
+
+   fskit_sanitize_path( path );
+
+   if( strcmp( path, "/" ) == 0 ) {
+      return -EBUSY;
+   }
+
+   // don't pile on more work than the reapers are allowed to have
+   fskit_deferred_throttle( core->deferred );
+
+   // set up the job now, so we can't fail once the entry is unlinked
+   job = CALLOC_LIST( struct fskit_deferred_job, 1 );
+   path_dirname = fskit_dirname( path, NULL );
+   path_basename = fskit_basename( path, NULL );
+
+   if( job != NULL ) {
+      job->path = strdup_or_null( path );
+   }
+
+   if( job == NULL || job->path == NULL || path_dirname == NULL || path_basename == NULL ) {
+
+      if( job != NULL ) {
+         fskit_safe_free( job->path );
+      }
+
+      fskit_safe_free( job );
+      fskit_safe_free( path_dirname );
+      fskit_safe_free( path_basename );
+      return -ENOMEM;
+   }
+
+   // look up the parent and write-lock it
+   parent = fskit_entry_resolve_path( core, path_dirname, 0, 0, true, &rc );
+   fskit_safe_free( path_dirname );
+
+   if( parent == NULL ) {
+
+      rc = (rc != 0 ? rc : -ENOENT);
+      goto fskit_deferred_remove_fail;
+   }
+
+   if( parent->type != FSKIT_ENTRY_TYPE_DIR ) {
+
+      fskit_entry_unlock( parent );
+      rc = -ENOTDIR;
+      goto fskit_deferred_remove_fail;
+   }
+
+   fent = fskit_entry_set_find_name( parent->children, path_basename );
+   if( fent == NULL || fent == parent || (child != NULL && fent != child) ) {
+
+      fskit_entry_unlock( parent );
+      rc = -ENOENT;
+      goto fskit_deferred_remove_fail;
+   }
+
+   fskit_entry_wlock( fent );
+
+   if( fent->type == FSKIT_ENTRY_TYPE_DIR ) {
+
+      // a pending clone only really has children if we're going to look at them
+      if( recursive ) {
+         rc = fskit_cow_detach( core, fent );
+      }
+      else {
+         rc = fskit_cow_fixup( core, fent, true );
+      }
+
+      if( rc != 0 ) {
+
+         fskit_entry_unlock( fent );
+         fskit_entry_unlock( parent );
+         goto fskit_deferred_remove_fail;
+      }
+
+      if( !recursive && fskit_entry_set_count( fent->children ) > 2 ) {
+
+         fskit_entry_unlock( fent );
+         fskit_entry_unlock( parent );
+         rc = -ENOTEMPTY;
+         goto fskit_deferred_remove_fail;
+      }
+
+      if( recursive ) {
+
+         // take the children away in O(1); the reaper will deal with them
+         num_children = fent->num_children;
+         rc = fskit_entry_tag_garbage( fent, &job->children );
+         if( rc != 0 ) {
+
+            fskit_error("fskit_entry_tag_garbage('%s') rc = %d\n", path, rc );
+            fskit_entry_unlock( fent );
+            fskit_entry_unlock( parent );
+            goto fskit_deferred_remove_fail;
+         }
+      }
+
+      // readdir checks this without fent's lock
+      __atomic_store_n( &fent->deletion_in_progress, true, __ATOMIC_RELAXED );
+   }
+
+   rc = fskit_entry_detach_lowlevel( parent, path_basename );
+   if( rc != 0 ) {
+
+      // shouldn't happen, since we hold both locks
+      fskit_error("BUG: fskit_entry_detach_lowlevel('%s') rc = %d\n", path, rc );
+
+      if( job->children != NULL ) {
+
+         // put them back
+         fskit_entry_set_free( fskit_entry_swap_children( fent, job->children ) );
+         fent->num_children = num_children;
+         fskit_usage_add( fent->usage, FSKIT_USAGE_DIRENTS, num_children );
+         fskit_usage_add( fent->usage, FSKIT_USAGE_NAME_BYTES, fskit_entry_set_name_bytes( fent->children ) );
+         job->children = NULL;
+      }
+
+      __atomic_store_n( &fent->deletion_in_progress, false, __ATOMIC_RELAXED );
+
+      fskit_entry_unlock( fent );
+      fskit_entry_unlock( parent );
+      goto fskit_deferred_remove_fail;
+   }
+
+   // keep fent alive until the reaper gets to it
+   fent->open_count++;
+   job->ent = fent;
+
+   fskit_entry_unlock( fent );
+   fskit_entry_unlock( parent );
+
+   fskit_safe_free( path_basename );
+
+   rc = fskit_deferred_enqueue( core->deferred, job );
+   if( rc != 0 ) {
+
+      // no reapers; do it ourselves
+      fskit_deferred_reap( core, job );
+
+      fskit_safe_free( job->path );
+      fskit_safe_free( job );
+      rc = 0;
+   }
+
+   return rc;
+
+fskit_deferred_remove_fail:
+
+   fskit_safe_free( path_basename );
+   fskit_safe_free( job->path );
+   fskit_safe_free( job );
+
+   return rc;
+}
+
+
+// remove a file or an empty directory.  It is unlinked immediately; its detach and destroy routes run in the background.
+// if child is not NULL, child_path must still refer to it.
+// return 0 on success, or the errors of fskit_deferred_remove_ex
+int fskit_deferred_remove( struct fskit_core* core, char const* child_path, struct fskit_entry* child ) {
+   return fskit_deferred_remove_ex( core, child_path, child, false );
+}
+
+
+// remove a file or a whole directory tree (i.e. rm -rf), in time independent of the tree's size.
+// The tree is unlinked immediately; its entries are detached and destroyed, and their routes run, in the background.
+// if child is not NULL, child_path must still refer to it.
+// return 0 on success, or the errors of fskit_deferred_remove_ex
+int fskit_deferred_remove_all( struct fskit_core* core, char const* child_path, struct fskit_entry* child ) {
+   return fskit_deferred_remove_ex( core, child_path, child, true );
+}
+
+
+// set the maximum number of reaper threads.  They are started on demand.
+// return 0 on success
+// return -EINVAL if num_threads is not positive
+// return -EBUSY if more than num_threads reapers are already running
+int fskit_deferred_set_threads( struct fskit_core* core, int num_threads ) {
+
+   int rc = 0;
+
+   if( num_threads <= 0 ) {
+      return -EINVAL;
+   }
+
+   pthread_mutex_lock( &core->deferred->lock );
+
+   if( core->deferred->num_started > num_threads ) {
+      rc = -EBUSY;
+   }
+   else {
+      core->deferred->num_threads = num_threads;
+   }
+
+   pthread_mutex_unlock( &core->deferred->lock );
+
+   return rc;
+}
+
+
+// set the maximum number of removals that may be outstanding before fskit_deferred_remove* blocks (0 means no limit).
+// NOTE: a detach or destroy route must not call fskit_deferred_remove* if a limit is set, since it could wait on itself.
+// return 0 always
+int fskit_deferred_set_max_pending( struct fskit_core* core, uint64_t max_pending ) {
+
+   pthread_mutex_lock( &core->deferred->lock );
+
+   core->deferred->max_pending = max_pending;
+
+   // let blocked removers re-check
+   pthread_cond_broadcast( &core->deferred->done_cv );
+
+   pthread_mutex_unlock( &core->deferred->lock );
+
+   return 0;
+}
+
+
+// get the number of removals that have not been fully reclaimed yet
+uint64_t fskit_deferred_get_pending( struct fskit_core* core ) {
+
+   uint64_t ret = 0;
+
+   pthread_mutex_lock( &core->deferred->lock );
+
+   ret = core->deferred->num_pending;
+
+   pthread_mutex_unlock( &core->deferred->lock );
+
+   return ret;
+}
+
+
+// wait for all outstanding removals to be reclaimed
+// NOTE: do not call this from a detach or destroy route
+// return 0 always
+int fskit_deferred_wait( struct fskit_core* core ) {
+
+   pthread_mutex_lock( &core->deferred->lock );
+
+   while( core->deferred->num_pending > 0 ) {
+      pthread_cond_wait( &core->deferred->done_cv, &core->deferred->lock );
+   }
+
+   pthread_mutex_unlock( &core->deferred->lock );
+
+   return 0;
+}
+
+
+// set up a core's reaper pool.  No threads are started until something is removed.
+// return 0 on success
+// return -ENOMEM on OOM
+int fskit_deferred_init( struct fskit_core* core ) {
+
+   struct fskit_deferred* deferred = CALLOC_LIST( struct fskit_deferred, 1 );
+   if( deferred == NULL ) {
+      return -ENOMEM;
+   }
+
+   deferred->core = core;
+   deferred->num_threads = FSKIT_DEFERRED_DEFAULT_THREADS;
+
+   pthread_mutex_init( &deferred->lock, NULL );
+   pthread_cond_init( &deferred->work_cv, NULL );
+   pthread_cond_init( &deferred->done_cv, NULL );
+
+   core->deferred = deferred;
+   return 0;
+}
+
+
+// drain outstanding removals, stop the reapers, and free the pool
+// return 0 always
+int fskit_deferred_shutdown( struct fskit_core* core ) {
+
+   struct fskit_deferred* deferred = core->deferred;
+
+   if( deferred == NULL ) {
+      return 0;
+   }
+
+   pthread_mutex_lock( &deferred->lock );
+
+   deferred->stop = true;
+   pthread_cond_broadcast( &deferred->work_cv );
+   pthread_cond_broadcast( &deferred->done_cv );
+
+   pthread_mutex_unlock( &deferred->lock );
+
+   // reapers exit once the queue is empty
+   for( int i = 0; i < deferred->num_started; i++ ) {
+      pthread_join( deferred->threads[i], NULL );
+   }
+
+   pthread_mutex_destroy( &deferred->lock );
+   pthread_cond_destroy( &deferred->work_cv );
+   pthread_cond_destroy( &deferred->done_cv );
+
+   fskit_safe_free( deferred->threads );
+   fskit_safe_free( deferred );
+
+   core->deferred = NULL;
+   return 0;
+}
@@ -21,6 +21,7 @@
 
 
 #include "fskit_private/private.h"
+#include "fskit_private/trace.h"
 
 #include <fskit/debug.h>
 #include <fskit/entry.h>
@@ -29,20 +30,39 @@
 #include <fskit/route.h>
 #include <fskit/util.h>
 
+#include <sched.h>
+
 struct fskit_entry_set_entry {
    
    char* name;
    struct fskit_entry* dirent;
+
+   // snapshot of dirent's type and file ID, taken when it was linked here.
+   // neither changes while the entry is linked, so readdir can use these without locking dirent.
+   uint8_t type;
+   uint64_t file_id;
    
    struct fskit_entry_set_entry* left;
    struct fskit_entry_set_entry* right;
    char color;
 };
 
+// a directory whose children are being detached.  Queued children refer to it instead of carrying their own paths,
+// so a full path is only built if a route needs one.
+struct fskit_detach_dir {
+
+   struct fskit_detach_dir* parent;     // NULL for the directory fskit_detach_all_ex was called on
+   char* name;                          // name in parent (or the full path, if parent is NULL)
+   char* path;                          // full path, built on demand (atomic)
+
+   int refcount;                        // queued children, child directories, and reapers referring to this (atomic)
+};
+
 // linked list entry for destroying an entry and all of its children
 struct fskit_detach_entry {
    
-   char* path;
+   struct fskit_detach_dir* dir;        // the directory it was in
+   char* name;                          // its name there
    struct fskit_entry* ent;
    
    struct fskit_detach_entry* next;
@@ -56,6 +76,9 @@ struct fskit_detach_ctx {
 
    int flags;
    int cbrc;
+
+   // number of threads to reap with (0 or 1 means the caller's thread only)
+   int num_threads;
 };
 
 struct fskit_inode_metadata {
@@ -85,6 +108,60 @@ fskit_entry_set* fskit_entry_set_next( fskit_entry_set_itr* itr ) {
    return sglib_fskit_entry_set_it_next( itr );
 }
 
+// position an in-order iterator at the first entry whose name is greater than (or, if inclusive, equal to) the given name.
+// this builds the iterator's stack directly while descending from the root, so it costs O(log n).
+// ancestors we descend left from stay on the stack, as if we had already visited their left subtrees; the rest are done.
+// return the entry, or NULL if there is none
+static fskit_entry_set* fskit_entry_set_seek( fskit_entry_set_itr* itr, fskit_entry_set* dirents, char const* name, bool inclusive ) {
+
+   fskit_entry_set* node = dirents;
+
+   memset( itr, 0, sizeof(fskit_entry_set_itr) );
+   itr->order = 1;
+
+   while( node != NULL ) {
+
+      int cmp = strcmp( node->name, name );
+
+      if( cmp > 0 || (inclusive && cmp == 0) ) {
+
+         // node is a candidate; anything smaller is to its left
+         itr->path[ itr->pathi ] = node;
+         itr->pass[ itr->pathi ] = 1;
+         itr->pathi++;
+
+         if( cmp == 0 ) {
+            break;
+         }
+
+         node = node->left;
+      }
+      else {
+
+         // node and its left subtree are before the name
+         node = node->right;
+      }
+   }
+
+   if( itr->pathi > 0 ) {
+      itr->currentelem = itr->path[ itr->pathi - 1 ];
+   }
+
+   return itr->currentelem;
+}
+
+// start iterating over a set of directory entries at the given name, or the first name after it if it is absent
+fskit_entry_set* fskit_entry_set_begin_at( fskit_entry_set_itr* itr, fskit_entry_set* dirents, char const* name ) {
+
+   return fskit_entry_set_seek( itr, dirents, name, true );
+}
+
+// start iterating over a set of directory entries at the first name after the given one
+fskit_entry_set* fskit_entry_set_begin_after( fskit_entry_set_itr* itr, fskit_entry_set* dirents, char const* name ) {
+
+   return fskit_entry_set_seek( itr, dirents, name, false );
+}
+
 // free up all entries in an fskit_entry_set, as well as the entry set itself.
 // don't free the contained entries
 int fskit_entry_set_free( fskit_entry_set* dirents ) {
@@ -130,6 +207,8 @@ fskit_entry_set* fskit_entry_set_new( struct fskit_entry* node, struct fskit_ent
    
    ret->name = name_dup;
    ret->dirent = node;
+   ret->type = node->type;
+   ret->file_id = node->file_id;
    
    rc = fskit_entry_set_insert( &ret, "..", parent );
    if( rc != 0 ) {
@@ -141,6 +220,31 @@ fskit_entry_set* fskit_entry_set_new( struct fskit_entry* node, struct fskit_ent
    return ret;
 }
 
+// make a new child set for a directory, with only its . and .. entries.
+// the parent may already have been reaped, so .. gets the cached type and ID from the directory's current set instead of reading the parent.
+// return NULL on OOM
+// NOTE: dir must be at least read-locked
+fskit_entry_set* fskit_entry_set_new_empty( struct fskit_entry* dir ) {
+
+   fskit_entry_set* parent = fskit_entry_set_find_itr( dir->children, ".." );
+   fskit_entry_set* ret = fskit_entry_set_new( dir, NULL );
+   fskit_entry_set* dotdot = NULL;
+
+   if( ret == NULL ) {
+      return NULL;
+   }
+
+   if( parent != NULL ) {
+
+      dotdot = fskit_entry_set_find_itr( ret, ".." );
+      dotdot->dirent = parent->dirent;
+      dotdot->type = parent->type;
+      dotdot->file_id = parent->file_id;
+   }
+
+   return ret;
+}
+
 // insert a child entry into an fskit_entry_set
 // return 0 on success
 // return -ENOMEM on OOM
@@ -164,6 +268,11 @@ int fskit_entry_set_insert( fskit_entry_set** set, char const* name, struct fski
    
    new_entry->name = name_dup;
    new_entry->dirent = child;
+
+   if( child != NULL ) {
+      new_entry->type = child->type;
+      new_entry->file_id = child->file_id;
+   }
    
    sglib_fskit_entry_set_add( set, new_entry );
    
@@ -248,6 +357,12 @@ bool fskit_entry_set_replace( fskit_entry_set* set, char const* name, struct fsk
    if( member != NULL ) {
       
       member->dirent = replacement;
+
+      if( replacement != NULL ) {
+         member->type = replacement->type;
+         member->file_id = replacement->file_id;
+      }
+
       return true;
    }
    else {
@@ -257,6 +372,33 @@ bool fskit_entry_set_replace( fskit_entry_set* set, char const* name, struct fsk
 }
 
 
+// size of one node of an fskit_entry_set, not counting its name
+size_t fskit_entry_set_node_size(void) {
+
+   return sizeof(struct fskit_entry_set_entry);
+}
+
+
+// bytes taken by the names in an fskit_entry_set, not counting . and ..
+uint64_t fskit_entry_set_name_bytes( fskit_entry_set* set ) {
+
+   fskit_entry_set_itr itr;
+   fskit_entry_set* dp = NULL;
+   uint64_t name_bytes = 0;
+
+   for( dp = fskit_entry_set_begin( &itr, set ); dp != NULL; dp = fskit_entry_set_next( &itr ) ) {
+
+      if( dp->name == NULL || strcmp( dp->name, "." ) == 0 || strcmp( dp->name, ".." ) == 0 ) {
+         continue;
+      }
+
+      name_bytes += strlen( dp->name ) + 1;
+   }
+
+   return name_bytes;
+}
+
+
 // count the number of slots available in an fskit_entry_set
 // not to be confused with the number of children, which is the number of non-NULL slots
 unsigned int fskit_entry_set_count( fskit_entry_set* set ) {
@@ -286,6 +428,30 @@ char const* fskit_entry_set_name_at( fskit_entry_set* dp ) {
    }
 }
 
+// get the child's type, as of when it was linked (or 0 if it's off the end of the set).
+// the child need not be locked; the set must be.
+uint8_t fskit_entry_set_type_at( fskit_entry_set* dp ) {
+
+   if( dp == NULL ) {
+      return 0;
+   }
+   else {
+      return dp->type;
+   }
+}
+
+// get the child's file ID, as of when it was linked (or 0 if it's off the end of the set).
+// the child need not be locked; the set must be.
+uint64_t fskit_entry_set_file_id_at( fskit_entry_set* dp ) {
+
+   if( dp == NULL ) {
+      return 0;
+   }
+   else {
+      return dp->file_id;
+   }
+}
+
 
 // find a child by name.
 // dir must be at least read-locked
@@ -313,6 +479,8 @@ int fskit_entry_attach_lowlevel( struct fskit_entry* parent, struct fskit_entry*
    }
    
    parent->num_children++;
+   fskit_usage_add( parent->usage, FSKIT_USAGE_DIRENTS, 1 );
+   fskit_usage_add( parent->usage, FSKIT_USAGE_NAME_BYTES, strlen( name ) + 1 );
 
    struct timespec ts;
    clock_gettime( CLOCK_REALTIME, &ts );
@@ -335,7 +503,8 @@ int fskit_entry_attach_lowlevel( struct fskit_entry* parent, struct fskit_entry*
 // parent must be write-locked
 // child must be write-locked, or otherwise inaccessible
 // the child will not be destroyed even if its link count reaches zero; the caller must take care of that.
-static int fskit_entry_detach_lowlevel_ex( struct fskit_entry* parent, char const* child_name, bool update_mtime ) {
+// if moving is true, the child is about to be attached elsewhere, so it need not be an empty directory.
+static int fskit_entry_detach_lowlevel_ex( struct fskit_entry* parent, char const* child_name, bool update_mtime, bool moving ) {
 
    struct fskit_entry* child = fskit_entry_set_find_name( parent->children, child_name );
    if( child == NULL ) {
@@ -349,8 +518,8 @@ static int fskit_entry_detach_lowlevel_ex( struct fskit_entry* parent, char cons
       return -ENOTEMPTY;
    }
    
-   // if the child is a directory, and it's not empty, then don't proceed
-   if( child->type == FSKIT_ENTRY_TYPE_DIR && fskit_entry_get_num_children( child ) > 2 ) {
+   // if the child is a directory, and it's not empty, then don't proceed (num_children does not count . and ..)
+   if( !moving && child->type == FSKIT_ENTRY_TYPE_DIR && fskit_entry_get_num_children( child ) > 0 ) {
       // not empty
       return -ENOTEMPTY;
    }
@@ -368,6 +537,8 @@ static int fskit_entry_detach_lowlevel_ex( struct fskit_entry* parent, char cons
    parent->mtime_sec = ts.tv_sec;
    parent->mtime_nsec = ts.tv_nsec;
    parent->num_children--;
+   fskit_usage_add( parent->usage, FSKIT_USAGE_DIRENTS, -1 );
+   fskit_usage_add( parent->usage, FSKIT_USAGE_NAME_BYTES, -(int64_t)(strlen( child_name ) + 1) );
 
    if( parent != child ) {
       
@@ -380,6 +551,7 @@ static int fskit_entry_detach_lowlevel_ex( struct fskit_entry* parent, char cons
       }
    }
 
+   FSKIT_TRACE3( entry__detach, parent->file_id, child_name, child->file_id );
    return 0;
 }
 
@@ -390,7 +562,15 @@ static int fskit_entry_detach_lowlevel_ex( struct fskit_entry* parent, char cons
 // parent must be write-locked, so it won't matter if the child is not.
 // the child will not be destroyed even if its link count reaches zero; the caller must take care of that.
 int fskit_entry_detach_lowlevel( struct fskit_entry* parent, char const* child_name ) {
-   return fskit_entry_detach_lowlevel_ex( parent, child_name, true );
+   return fskit_entry_detach_lowlevel_ex( parent, child_name, true, false );
+}
+
+
+// detach an entry from a parent, so it can be attached somewhere else (i.e. by rename).
+// unlike fskit_entry_detach_lowlevel, a non-empty directory will be detached.
+// both entries must be write-locked.
+int fskit_entry_detach_lowlevel_move( struct fskit_entry* parent, char const* child_name ) {
+   return fskit_entry_detach_lowlevel_ex( parent, child_name, true, true );
 }
 
 // default inode allocator: pick a random 64-bit number
@@ -430,169 +610,790 @@ int fskit_core_init( struct fskit_core* core, void* app_fs_data ) {
       return -ENOMEM;
    }
 
+   rc = fskit_usage_init( core );
+   if( rc != 0 ) {
+
+      fskit_safe_free( routes );
+      return rc;
+   }
+
    rc = fskit_entry_init_dir( &core->root, &core->root, 0, 0, 0, 0755 );
    if( rc != 0 ) {
       fskit_error("fskit_entry_init_dir(/) rc = %d\n", rc );
 
+      fskit_usage_shutdown( core );
       fskit_safe_free( routes );
       return rc;
    }
 
-   core->root.link_count = 1;
-   core->app_fs_data = app_fs_data;
+   fskit_usage_charge_entry( core, &core->root, true );
+
+   core->root.link_count = 1;
+   core->app_fs_data = app_fs_data;
+
+   core->fskit_inode_alloc = fskit_default_inode_alloc;
+   core->fskit_inode_free = fskit_default_inode_free;
+
+   core->routes = routes;
+
+   rc = fskit_xattr_names_init( core );
+   if( rc != 0 ) {
+      fskit_error("fskit_xattr_names_init rc = %d\n", rc );
+
+      fskit_entry_destroy( core, &core->root, false );
+      fskit_usage_shutdown( core );
+      fskit_route_table_free( routes );
+      return rc;
+   }
+
+   rc = fskit_deferred_init( core );
+   if( rc != 0 ) {
+      fskit_error("fskit_deferred_init rc = %d\n", rc );
+
+      fskit_entry_destroy( core, &core->root, false );
+      fskit_xattr_names_shutdown( core );
+      fskit_usage_shutdown( core );
+      fskit_route_table_free( routes );
+      return rc;
+   }
+
+   pthread_rwlock_init( &core->lock, NULL );
+   pthread_rwlock_init( &core->route_lock, NULL );
+   pthread_mutex_init( &core->rename_lock, NULL );
+
+   return 0;
+}
+
+
+// destroy the fskit core
+// core must be write-locked
+// return the app_fs_data from core upon distruction
+int fskit_core_destroy( struct fskit_core* core, void** app_fs_data ) {
+
+   void* fs_data = NULL;
+
+   // finish reclaiming deferred removals while the routes are still around
+   fskit_deferred_shutdown( core );
+   
+   fskit_entry_wlock( &core->root );
+   
+   // forcibly detach core->root 
+   core->root.open_count = 1;   // for referencing
+   core->root.link_count = 0;
+   core->root.deletion_in_progress = true;
+   
+   fskit_entry_unlock( &core->root );
+   
+   fskit_debug("%s", "Destroy root inode\n");
+   fskit_run_user_destroy( core, "/", NULL, &core->root );
+   
+   fskit_entry_destroy( core, &core->root, true );
+
+   fskit_route_table_free( core->routes );
+   fskit_xattr_names_shutdown( core );
+   fskit_usage_shutdown( core );
+   
+   fs_data = core->app_fs_data;
+   core->app_fs_data = NULL;
+
+   pthread_rwlock_destroy( &core->lock );
+   pthread_rwlock_destroy( &core->route_lock );
+   pthread_mutex_destroy( &core->rename_lock );
+
+   if( app_fs_data != NULL ) {
+      *app_fs_data = fs_data;
+   }
+   
+   memset( core, 0, sizeof(struct fskit_core) );
+
+   return 0;
+}
+
+
+// take a reference to a detach directory
+static void fskit_detach_dir_ref( struct fskit_detach_dir* dir ) {
+   __atomic_add_fetch( &dir->refcount, 1, __ATOMIC_RELAXED );
+}
+
+
+// drop a reference to a detach directory, freeing it (and possibly its ancestors) once unreferenced
+static void fskit_detach_dir_unref( struct fskit_detach_dir* dir ) {
+
+   struct fskit_detach_dir* parent = NULL;
+
+   while( dir != NULL ) {
+
+      if( __atomic_sub_fetch( &dir->refcount, 1, __ATOMIC_ACQ_REL ) > 0 ) {
+         break;
+      }
+
+      parent = dir->parent;
+
+      fskit_safe_free( dir->name );
+      fskit_safe_free( dir->path );
+      fskit_safe_free( dir );
+
+      dir = parent;
+   }
+}
+
+
+// make a detach directory for a directory being reaped, named name in parent (or with full path name, if parent is NULL).
+// it takes ownership of name, and starts with one reference (the caller's).
+// return NULL on OOM (name is not freed)
+static struct fskit_detach_dir* fskit_detach_dir_new( struct fskit_detach_dir* parent, char* name ) {
+
+   struct fskit_detach_dir* dir = CALLOC_LIST( struct fskit_detach_dir, 1 );
+   if( dir == NULL ) {
+      return NULL;
+   }
+
+   dir->parent = parent;
+   dir->name = name;
+   dir->refcount = 1;
+
+   if( parent != NULL ) {
+      fskit_detach_dir_ref( parent );
+   }
+
+   return dir;
+}
+
+
+// get a detach directory's full path, building (and remembering) it on first use.
+// safe to call concurrently.
+// return NULL on OOM
+static char const* fskit_detach_dir_path( struct fskit_detach_dir* dir ) {
+
+   char* path = __atomic_load_n( &dir->path, __ATOMIC_ACQUIRE );
+   char* expected = NULL;
+   char const* parent_path = NULL;
+
+   if( path != NULL ) {
+      return path;
+   }
+
+   if( dir->parent == NULL ) {
+      return dir->name;
+   }
+
+   parent_path = fskit_detach_dir_path( dir->parent );
+   if( parent_path == NULL ) {
+      return NULL;
+   }
+
+   path = fskit_fullpath( parent_path, dir->name, NULL );
+   if( path == NULL ) {
+      return NULL;
+   }
+
+   // someone may have beaten us to it
+   if( !__atomic_compare_exchange_n( &dir->path, &expected, path, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE ) ) {
+
+      fskit_safe_free( path );
+      path = expected;
+   }
+
+   return path;
+}
+
+
+// free a queued detach entry, and release its directory
+static void fskit_detach_entry_free( struct fskit_detach_entry* entry ) {
+
+   fskit_detach_dir_unref( entry->dir );
+
+   fskit_safe_free( entry->name );
+   fskit_safe_free( entry );
+}
+
+
+// queue a set of children for detaching.
+// the *dir_children set must refer to a set of entries that have just been removed from their parent (but not been modified themselves).
+// each queued child takes its name from dir_children, and is marked consumed there (already-consumed children are skipped),
+// so dir_children may only be freed afterwards.  Either all children get queued, or none do.
+// return 0 on success
+// return -ENOMEM if out of memory
+static int fskit_detach_queue_children( struct fskit_detach_ctx* ctx, struct fskit_detach_dir* dir, fskit_entry_set** dir_children ) {
+
+   fskit_entry_set_itr itr;
+   fskit_entry_set* dirent = NULL;
+   struct fskit_detach_entry* head = NULL;
+   struct fskit_detach_entry* tail = NULL;
+   struct fskit_detach_entry* next = NULL;
+   size_t size = 0;
+   
+   for( dirent = fskit_entry_set_begin( &itr, *dir_children ); dirent != NULL; dirent = fskit_entry_set_next( &itr ) ) {
+    
+      struct fskit_entry* child = dirent->dirent;
+      char const* name = dirent->name;
+
+      if( name == NULL ) {
+
+         // already queued
+         continue;
+      }
+      
+      if( strcmp( name, "." ) == 0 || strcmp( name, ".." ) == 0 ) {
+         
+         // skip
+         continue;
+      }
+      
+      if( child == NULL ) {
+         
+         // should never happen 
+         fskit_error("BUG: null child at %p ('%s')\n", dirent, name );
+         continue;
+      }
+      
+      if( child->type == FSKIT_ENTRY_TYPE_DEAD ) {
+         
+         // should never happen 
+         fskit_error("BUG: dead child at %p ('%s')\n", dirent, name );
+         continue;
+      }
+      
+      next = CALLOC_LIST( struct fskit_detach_entry, 1 );
+      if( next == NULL ) {
+
+         // leave dir_children as we found it
+         while( head != NULL ) {
+
+            next = head;
+            head = head->next;
+            fskit_safe_free( next );
+         }
+
+         return -ENOMEM;
+      }
+
+      next->ent = child;
+
+      if( head == NULL ) {
+         head = next;
+      }
+      else {
+         tail->next = next;
+      }
+
+      tail = next;
+      size++;
+   }
+
+   // take the names; no path gets built unless a route needs one
+   next = head;
+   for( dirent = fskit_entry_set_begin( &itr, *dir_children ); dirent != NULL && next != NULL; dirent = fskit_entry_set_next( &itr ) ) {
+
+      // same order as above
+      if( dirent->name == NULL || dirent->dirent != next->ent || strcmp( dirent->name, "." ) == 0 || strcmp( dirent->name, ".." ) == 0 ) {
+         continue;
+      }
+
+      next->dir = dir;
+      next->name = dirent->name;
+
+      fskit_detach_dir_ref( dir );
+
+      dirent->name = NULL;
+      dirent->dirent = NULL;
+
+      next = next->next;
+   }
+
+   if( head == NULL ) {
+      return 0;
+   }
+
+   // enqueue...
+   if( ctx->head == NULL ) {
+      ctx->head = head;
+   }
+   else {
+      ctx->tail->next = head;
+   }
+
+   ctx->tail = tail;
+   ctx->size += size;
+
+   return 0;
+}
+
+
+// reap one queued entry: tag it (and queue its children onto queue, if it is a directory), drop the link we hold, and destroy it if it is fully unref'ed.
+// the entry's full path is built only if need_paths is set (i.e. there is a destroy route to match it against).
+// set *consumed if the entry was dealt with, and should not be reaped again.
+// return 0 on success
+// return -ENOMEM if out of memory (*consumed will be false)
+// return -EIO if a copy-on-write clone of it couldn't be filled in (*consumed will be false)
+// return -EFAULT if FSKIT_DETACH_CTX_CB_FAIL is set in flags and the destroy route fails (*cbrc will be set)
+static int fskit_detach_reap( struct fskit_core* core, struct fskit_detach_ctx* queue, struct fskit_detach_entry* next, int flags, bool need_paths, int* cbrc, bool* consumed ) {
+
+   int rc = 0;
+   struct fskit_entry* fent = next->ent;
+   struct fskit_detach_dir* self_dir = NULL;
+   char const* fent_name = next->name;
+   char* fent_path = NULL;
+
+   *consumed = false;
+
+   fskit_entry_wlock( fent );
+
+   if( fent->type == FSKIT_ENTRY_TYPE_DIR ) {
+
+      // this directory's children will name it through self_dir.
+      // it shares our name, which moves there.
+      self_dir = fskit_detach_dir_new( next->dir, next->name );
+      if( self_dir == NULL ) {
+
+         fskit_entry_unlock( fent );
+         return -ENOMEM;
+      }
+
+      next->name = NULL;
+
+      // a pending clone has nothing to reap, and a clone source must fill in its clones before it goes
+      rc = fskit_cow_detach( core, fent );
+      if( rc != 0 ) {
+
+         fskit_error("fskit_cow_detach('%" PRIX64 "') rc = %d\n", fent->file_id, rc);
+
+         next->name = self_dir->name;
+         self_dir->name = NULL;
+         fskit_detach_dir_unref( self_dir );
+
+         fskit_entry_unlock( fent );
+         return rc;
+      }
+
+      // garbage-collect: detach children from their parent, and mark them as garbage
+      fskit_entry_set* children = NULL;
+      int64_t num_children = fent->num_children;
+
+      rc = fskit_entry_tag_garbage( fent, &children );
+      if( rc != 0 ) {
+         
+         fskit_error("fskit_entry_tag_garbage('%" PRIX64 "') rc = %d\n", fent->file_id, rc);
+
+         // give the name back
+         next->name = self_dir->name;
+         self_dir->name = NULL;
+         fskit_detach_dir_unref( self_dir );
+
+         fskit_entry_unlock( fent );
+         return rc;
+      }
+      
+      if( children != NULL ) {
+          
+         // add children into the unlink queue
+         rc = fskit_detach_queue_children( queue, self_dir, &children );
+         if( rc != 0 ) {
+             
+            fskit_error("fskit_detach_queue_children('%s') rc = %d\n", fent_name, rc );
+
+            // put the children back untouched, so a retry picks them up
+            fskit_entry_set_free( fskit_entry_swap_children( fent, children ) );
+            fent->num_children = num_children;
+            fskit_usage_add( fent->usage, FSKIT_USAGE_DIRENTS, num_children );
+            fskit_usage_add( fent->usage, FSKIT_USAGE_NAME_BYTES, fskit_entry_set_name_bytes( fent->children ) );
+
+            next->name = self_dir->name;
+            self_dir->name = NULL;
+            fskit_detach_dir_unref( self_dir );
+
+            fskit_entry_unlock( fent );
+            return rc;
+         }
+         
+         fskit_entry_set_free( children );
+         children = NULL;
+      }
+   }
+   
+   // mark this entry for garbage-collection.
+   // it was detached from exactly one parent by this method.
+   fent->link_count--;
+   
+   if( fent->type == FSKIT_ENTRY_TYPE_DIR ) {
+
+      // readdir checks this without fent's lock
+      __atomic_store_n( &fent->deletion_in_progress, true, __ATOMIC_RELAXED );
+   }
+
+   // from here on, reaping this entry again would drop the link twice
+   *consumed = true;
+
+   if( need_paths ) {
+
+      if( self_dir != NULL ) {
+
+         char const* self_path = fskit_detach_dir_path( self_dir );
+         fent_path = (self_path != NULL ? strdup( self_path ) : NULL);
+      }
+      else if( fskit_detach_dir_path( next->dir ) != NULL ) {
+
+         fent_path = fskit_fullpath( fskit_detach_dir_path( next->dir ), next->name, NULL );
+      }
+
+      if( fent_path == NULL ) {
+         fskit_error("WARN: out of memory building the path of '%s'\n", (self_dir != NULL ? self_dir->name : next->name) );
+      }
+   }
+
+   if( self_dir != NULL ) {
+      fent_name = self_dir->name;
+   }
+   
+   // maybe this entry is fully unref'ed...
+   // (without a path, the routes only get its name--but then, there are no routes to match it)
+   rc = fskit_entry_try_destroy_and_free_ex( core, (fent_path != NULL ? fent_path : fent_name), NULL, fent, cbrc );
+   if( rc == 0 ) {
+      // not destroyed--still opened somewhere
+      fskit_entry_unlock( fent );
+   }
+   else if( rc < 0 ) {
+      // shouldn't happen: failed to destroy and free
+      fskit_error("BUG: fskit_entry_try_destroy_and_free(%s) rc = %d\n", fent_name, rc );
+      
+      fskit_entry_unlock( fent );
+   }
+
+   fskit_safe_free( fent_path );
+
+   if( self_dir != NULL ) {
+      fskit_detach_dir_unref( self_dir );
+   }
+
+   if( rc < 0 ) {
+      return rc;
+   }
+
+   if( (flags & FSKIT_DETACH_CTX_CB_FAIL) && *cbrc < 0 ) {
+      fskit_error("Callback failed (rc = %d)\n", *cbrc );
+      return -EFAULT;
+   }
+
+   return 0;
+}
+
+
+// move all of src's queued entries to the end of dest's queue
+static void fskit_detach_queue_splice( struct fskit_detach_ctx* dest, struct fskit_detach_ctx* src ) {
+
+   if( src->head == NULL ) {
+      return;
+   }
+
+   if( dest->head == NULL ) {
+      dest->head = src->head;
+   }
+   else {
+      dest->tail->next = src->head;
+   }
+
+   dest->tail = src->tail;
+   dest->size += src->size;
+
+   src->head = NULL;
+   src->tail = NULL;
+   src->size = 0;
+}
+
+
+// parallel detach: one queue per worker, with work stealing.
+// each entry is queued only after its parent has been tagged as garbage (which empties the parent's child set),
+// so no thread can reach a queued entry through its parent.  Workers lock one entry at a time,
+// so the parent-before-child lock order is preserved no matter which thread reaps which subtree.
+struct fskit_detach_pool;
+
+struct fskit_detach_worker {
+
+   struct fskit_detach_ctx queue;       // this worker's queue; guarded by lock
+   pthread_mutex_t lock;
+
+   struct fskit_detach_pool* pool;
+   uint64_t seed;                       // for picking steal victims
+   pthread_t thread;
+};
+
+struct fskit_detach_pool {
+
+   struct fskit_core* core;
+   struct fskit_detach_worker* workers;
+   int num_workers;
+   int flags;
+   bool need_paths;                     // build full paths for the destroy route
+
+   uint64_t num_outstanding;            // entries queued but not yet reaped (atomic)
+   int abort;                           // set on the first error (atomic)
+
+   pthread_mutex_t lock;                // guards rc and cbrc
+   int rc;
+   int cbrc;
+};
+
+
+// take up to half of a victim's queue (at least one entry)
+// return the number of entries stolen
+static size_t fskit_detach_steal( struct fskit_detach_worker* thief, struct fskit_detach_worker* victim ) {
+
+   size_t n = 0;
+   struct fskit_detach_entry* last = NULL;
+   struct fskit_detach_ctx stolen;
+
+   memset( &stolen, 0, sizeof(struct fskit_detach_ctx) );
+
+   pthread_mutex_lock( &victim->lock );
+
+   if( victim->queue.size > 0 ) {
+
+      n = (victim->queue.size + 1) / 2;
+
+      // cut the first n entries from the victim
+      last = victim->queue.head;
+      for( size_t i = 1; i < n; i++ ) {
+         last = last->next;
+      }
+
+      stolen.head = victim->queue.head;
+      stolen.tail = last;
+      stolen.size = n;
+
+      victim->queue.head = last->next;
+      if( victim->queue.head == NULL ) {
+         victim->queue.tail = NULL;
+      }
+      victim->queue.size -= n;
+
+      last->next = NULL;
+   }
+
+   pthread_mutex_unlock( &victim->lock );
+
+   // never hold two workers' locks at once
+   if( n > 0 ) {
+
+      pthread_mutex_lock( &thief->lock );
+      fskit_detach_queue_splice( &thief->queue, &stolen );
+      pthread_mutex_unlock( &thief->lock );
+   }
+
+   return n;
+}
+
+
+// record the first error, and tell everyone to stop
+static void fskit_detach_pool_fail( struct fskit_detach_pool* pool, int rc, int cbrc ) {
+
+   pthread_mutex_lock( &pool->lock );
+
+   if( pool->rc == 0 ) {
+      pool->rc = rc;
+      pool->cbrc = cbrc;
+   }
+
+   pthread_mutex_unlock( &pool->lock );
+
+   __atomic_store_n( &pool->abort, 1, __ATOMIC_RELEASE );
+}
+
+
+// detach worker: reap from our own queue, and steal when it runs dry.
+// exits once nothing is outstanding anywhere, or on abort.
+static void* fskit_detach_worker_main( void* arg ) {
+
+   struct fskit_detach_worker* self = (struct fskit_detach_worker*)arg;
+   struct fskit_detach_pool* pool = self->pool;
+   struct fskit_detach_ctx children;
+   struct fskit_detach_entry* next = NULL;
+   int rc = 0;
+   int cbrc = 0;
+   bool consumed = false;
+
+   memset( &children, 0, sizeof(struct fskit_detach_ctx) );
+
+   while( !__atomic_load_n( &pool->abort, __ATOMIC_ACQUIRE ) ) {
+
+      // next entry from our own queue
+      pthread_mutex_lock( &self->lock );
+
+      next = self->queue.head;
+      if( next != NULL ) {
+
+         self->queue.head = next->next;
+         if( self->queue.head == NULL ) {
+            self->queue.tail = NULL;
+         }
+         self->queue.size--;
+         next->next = NULL;
+      }
+
+      pthread_mutex_unlock( &self->lock );
+
+      if( next == NULL ) {
+
+         if( __atomic_load_n( &pool->num_outstanding, __ATOMIC_ACQUIRE ) == 0 ) {
+            // all done
+            break;
+         }
+
+         // steal from someone, starting at a random victim
+         size_t stolen = 0;
+         self->seed = self->seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+         for( int i = 0; i < pool->num_workers && stolen == 0; i++ ) {
+
+            struct fskit_detach_worker* victim = &pool->workers[ ((self->seed >> 33) + i) % pool->num_workers ];
+            if( victim != self ) {
+               stolen = fskit_detach_steal( self, victim );
+            }
+         }
+
+         if( stolen == 0 ) {
+            // others are busy expanding their subtrees
+            sched_yield();
+         }
+
+         continue;
+      }
+
+      // children get queued locally, so thieves aren't locked out while we expand a large directory
+      cbrc = 0;
+      rc = fskit_detach_reap( pool->core, &children, next, pool->flags, pool->need_paths, &cbrc, &consumed );
+
+      if( children.size > 0 ) {
+
+         __atomic_add_fetch( &pool->num_outstanding, children.size, __ATOMIC_RELEASE );
+
+         pthread_mutex_lock( &self->lock );
+         fskit_detach_queue_splice( &self->queue, &children );
+         pthread_mutex_unlock( &self->lock );
+      }
+
+      if( consumed ) {
+
+         fskit_detach_entry_free( next );
+
+         __atomic_sub_fetch( &pool->num_outstanding, 1, __ATOMIC_RELEASE );
+      }
+      else {
+
+         // put it back, so the caller can retry it
+         pthread_mutex_lock( &self->lock );
+
+         next->next = self->queue.head;
+         self->queue.head = next;
+         if( self->queue.tail == NULL ) {
+            self->queue.tail = next;
+         }
+         self->queue.size++;
+
+         pthread_mutex_unlock( &self->lock );
+      }
+
+      if( rc != 0 ) {
+         fskit_detach_pool_fail( pool, rc, cbrc );
+         break;
+      }
+   }
+
+   return NULL;
+}
+
+
+// reap everything in ctx's queue with ctx->num_threads workers.
+// on error, whatever was not reaped is put back into ctx's queue.
+// return 0 on success, or the first error a worker encountered (see fskit_detach_reap)
+static int fskit_detach_all_parallel( struct fskit_core* core, struct fskit_detach_ctx* ctx, bool need_paths ) {
+
+   int rc = 0;
+   int num_started = 0;
+   struct fskit_detach_pool pool;
+   struct fskit_detach_entry* next = NULL;
+
+   memset( &pool, 0, sizeof(struct fskit_detach_pool) );
 
-   core->fskit_inode_alloc = fskit_default_inode_alloc;
-   core->fskit_inode_free = fskit_default_inode_free;
+   pool.workers = CALLOC_LIST( struct fskit_detach_worker, ctx->num_threads );
+   if( pool.workers == NULL ) {
+      return -ENOMEM;
+   }
 
-   core->routes = routes;
+   pool.core = core;
+   pool.num_workers = ctx->num_threads;
+   pool.flags = ctx->flags;
+   pool.need_paths = need_paths;
+   pool.num_outstanding = ctx->size;
 
-   pthread_rwlock_init( &core->lock, NULL );
-   pthread_rwlock_init( &core->route_lock, NULL );
+   pthread_mutex_init( &pool.lock, NULL );
 
-   return 0;
-}
+   for( int i = 0; i < pool.num_workers; i++ ) {
 
+      pthread_mutex_init( &pool.workers[i].lock, NULL );
+      pool.workers[i].pool = &pool;
+      pool.workers[i].seed = i + 1;
+   }
 
-// destroy the fskit core
-// core must be write-locked
-// return the app_fs_data from core upon distruction
-int fskit_core_destroy( struct fskit_core* core, void** app_fs_data ) {
+   // deal out the initial queue round-robin
+   for( int i = 0; ctx->head != NULL; i = (i + 1) % pool.num_workers ) {
 
-   void* fs_data = NULL;
-   
-   fskit_entry_wlock( &core->root );
-   
-   // forcibly detach core->root 
-   core->root.open_count = 1;   // for referencing
-   core->root.link_count = 0;
-   core->root.deletion_in_progress = true;
-   
-   fskit_entry_unlock( &core->root );
-   
-   fskit_debug("%s", "Destroy root inode\n");
-   fskit_run_user_destroy( core, "/", NULL, &core->root );
-   
-   fskit_entry_destroy( core, &core->root, true );
+      next = ctx->head;
+      ctx->head = next->next;
+      next->next = NULL;
 
-   fskit_route_table_free( core->routes );
-   
-   fs_data = core->app_fs_data;
-   core->app_fs_data = NULL;
+      struct fskit_detach_ctx one;
+      memset( &one, 0, sizeof(struct fskit_detach_ctx) );
 
-   pthread_rwlock_destroy( &core->lock );
-   pthread_rwlock_destroy( &core->route_lock );
+      one.head = next;
+      one.tail = next;
+      one.size = 1;
 
-   if( app_fs_data != NULL ) {
-      *app_fs_data = fs_data;
+      fskit_detach_queue_splice( &pool.workers[i].queue, &one );
    }
-   
-   memset( core, 0, sizeof(struct fskit_core) );
 
-   return 0;
-}
+   ctx->tail = NULL;
+   ctx->size = 0;
 
+   for( int i = 0; i < pool.num_workers; i++ ) {
 
-// queue a child for detach.  It must have been detached from a parent already (in fskit_detach_all_ex), but it may have children of its own.
-// NOTE: the child is not guaranteed to be locked
-// return 0 on success
-// return -ENOMEM on OOM
-// return -EPERM if the child is not fully unlinked
-int fskit_detach_queue_child( struct fskit_detach_ctx* ctx, char const* dir_path, char const* name, struct fskit_entry* child ) {
+      rc = pthread_create( &pool.workers[i].thread, NULL, fskit_detach_worker_main, &pool.workers[i] );
+      if( rc != 0 ) {
 
-   struct fskit_detach_entry* next = NULL;
-   char* child_path = NULL;
-   
-   child_path = fskit_fullpath( dir_path, name, NULL );
-   if( child_path == NULL ) {
+         // the ones we did start will steal this one's share
+         fskit_error("pthread_create rc = %d\n", rc );
+         break;
+      }
 
-      return -ENOMEM;
-   }
-   
-   next = CALLOC_LIST( struct fskit_detach_entry, 1 );
-   if( next == NULL ) {
-      
-      fskit_safe_free( child_path );
-      return -ENOMEM;
+      num_started++;
    }
-   
-   // enqueue...
-   next->path = child_path;
-   next->ent = child;
-   next->next = NULL;
-   
-   if( ctx->head == NULL ) {
-      ctx->head = next;
-      ctx->tail = next;
-   }
-   else {
-      ctx->tail->next = next;
-      ctx->tail = next;
-   }
-   
-   ctx->size++;
-   
-   return 0;
-}
 
+   if( num_started == 0 ) {
 
-// queue a set of children for detaching.
-// the *dir_children set must refer to a set of entries that have just been removed from their parent (but not been modified themselves).
-// consume all but . and .. from dir_children
-// return 0 on success
-// return -ENOMEM if out of memory
-int fskit_detach_queue_children( struct fskit_detach_ctx* ctx, char const* dir_path, fskit_entry_set** dir_children ) {
+      // do it ourselves
+      pool.num_workers = 1;
+      fskit_detach_worker_main( &pool.workers[0] );
+   }
 
-   int rc = 0;
-   fskit_entry_set_itr itr;
-   fskit_entry_set* dirent = NULL;
-   fskit_entry_set* children = NULL;
-    
-   struct fskit_detach_entry* erased = ctx->tail;
-   struct fskit_detach_entry* tmp = NULL;
-   
-   char erased_name[FSKIT_FILESYSTEM_NAMEMAX+1];
-   
-   for( dirent = fskit_entry_set_begin( &itr, *dir_children ); dirent != NULL; dirent = fskit_entry_set_next( &itr ) ) {
-    
-      struct fskit_entry* child = fskit_entry_set_child_at( dirent );
-      char const* name = fskit_entry_set_name_at( dirent );
-      
-      if( strcmp( name, "." ) == 0 || strcmp( name, ".." ) == 0 ) {
-         
-         // skip
-         continue;
-      }
-      
-      if( child == NULL ) {
-         
-         // should never happen 
-         fskit_error("BUG: null child at %p in '%s'\n", dirent, dir_path );
-         continue;
-      }
-      
-      if( child->type == FSKIT_ENTRY_TYPE_DEAD ) {
-         
-         // should never happen 
-         fskit_error("BUG: dead child at %p in '%s'\n", dirent, dir_path );
-         continue;
-      }
-      
-      rc = fskit_detach_queue_child( ctx, dir_path, name, child );
+   for( int i = 0; i < num_started; i++ ) {
+      pthread_join( pool.workers[i].thread, NULL );
+   }
 
-      if( rc != 0 ) {
-         return rc;
-      }
+   // hand back anything left over (only on error)
+   for( int i = 0; i < ctx->num_threads; i++ ) {
+
+      fskit_detach_queue_splice( ctx, &pool.workers[i].queue );
+      pthread_mutex_destroy( &pool.workers[i].lock );
    }
-   
-   // go through all the children we enqueued and remove them from the dir_children set
-   for( tmp = erased; tmp != NULL; tmp = tmp->next ) {
-      
-      fskit_dirname( tmp->path, erased_name );
-      
-      fskit_entry_set_remove( dir_children, erased_name );
+
+   rc = pool.rc;
+   if( rc == -EFAULT ) {
+      ctx->cbrc = pool.cbrc;
    }
 
-   return 0;
+   pthread_mutex_destroy( &pool.lock );
+   fskit_safe_free( pool.workers );
+
+   return rc;
 }
 
 
@@ -601,6 +1402,7 @@ int fskit_detach_queue_children( struct fskit_detach_ctx* ctx, char const* dir_p
 // (e.g. this is a "mass-unlink" function that takes care of updating all the children).
 // run any detach route callbacks if their link counts reach 0.
 // destroy the contents of dir_children for which the entries have been fully unlinked (besides . and ..).
+// if ctx has more than one thread (see fskit_detach_ctx_set_threads), independent subtrees are reaped in parallel.
 // return 0 on success
 // return -ENOMEM if out of memory
 // return -EFAULT if the FSKIT_DETACH_CTX_CB_FAIL flag is set, and the callback fails.
@@ -610,101 +1412,70 @@ int fskit_detach_queue_children( struct fskit_detach_ctx* ctx, char const* dir_p
 // If this occurs, free up some memory and call this method again with the same detach context, but NULL for dir_children
 int fskit_detach_all_ex( struct fskit_core* core, char const* dir_path, fskit_entry_set** dir_children, struct fskit_detach_ctx* ctx ) {
 
-   // NOTE: it is important that we go in breadth-first order.  This is because fskit
+   // NOTE: it is important that a node be reaped only after its parent.  This is because fskit
    // locks the parent before the child when resolving a path.  So it must be the case
-   // here to avoid deadlock.
+   // here to avoid deadlock.  Children are queued only once their parent has been tagged,
+   // so this holds for both the serial (breadth-first) and the parallel order.
 
    int rc = 0;
    int cbrc = 0;
+   bool consumed = false;
+
+   // only the destroy route sees paths; without one, queued entries stay path-free
+   bool need_paths = fskit_route_is_defined( core, FSKIT_ROUTE_MATCH_DESTROY );
 
    // queue immediate children for destruction
    if( dir_children != NULL ) {
 
-      rc = fskit_detach_queue_children( ctx, dir_path, dir_children );
+      char* root_path = strdup( dir_path );
+      if( root_path == NULL ) {
+         return -ENOMEM;
+      }
+
+      struct fskit_detach_dir* root = fskit_detach_dir_new( NULL, root_path );
+      if( root == NULL ) {
+
+         fskit_safe_free( root_path );
+         return -ENOMEM;
+      }
+
+      rc = fskit_detach_queue_children( ctx, root, dir_children );
+
+      // queued children hold their own references
+      fskit_detach_dir_unref( root );
+
       if( rc != 0 ) {
          // OOM
          return rc;
       }
    }
 
+   if( ctx->num_threads > 1 && ctx->size > 0 ) {
+      return fskit_detach_all_parallel( core, ctx, need_paths );
+   }
+
    while( ctx->size > 0 && rc == 0 ) {
 
       // reap unlinked children
       struct fskit_detach_entry* next = ctx->head;
-      struct fskit_entry* fent = next->ent;
-      char* fent_path = next->path;
-      
-      fskit_entry_wlock( fent );
 
-      if( fent->type == FSKIT_ENTRY_TYPE_DIR ) {
+      rc = fskit_detach_reap( core, ctx, next, ctx->flags, need_paths, &cbrc, &consumed );
 
-         // garbage-collect: detach children from their parent, and mark them as garbage
-         fskit_entry_set* children = NULL;
-         rc = fskit_entry_tag_garbage( fent, &children );
-         if( rc != 0 ) {
-            
-            fskit_error("fskit_entry_tag_garbage('%" PRIX64 "') rc = %d\n", fent->file_id, rc);
-            fskit_entry_unlock( fent );
-            return rc;
-         }
-         
-         if( children != NULL ) {
-             
-            // add children into the unlink queue
-            rc = fskit_detach_queue_children( ctx, fent_path, &children );
-            if( rc != 0 ) {
-                
-               fskit_error("fskit_detach_queue_children('%s') rc = %d\n", fent_path, rc );
-               fskit_entry_unlock( fent );
-               return rc;
-            }
-            
-            fskit_entry_set_free( children );
-            children = NULL;
-         }
-      }
-      
-      // mark this entry for garbage-collection.
-      // it was detached from exactly one parent by this method.
-      fent->link_count--;
-      
-      if( fent->type == FSKIT_ENTRY_TYPE_DIR ) {
-         fent->deletion_in_progress = true;
-      }
-      
-      // maybe this entry is fully unref'ed...
-      rc = fskit_entry_try_destroy_and_free_ex( core, fent_path, NULL, fent, &cbrc );
-      if( (ctx->flags & FSKIT_DETACH_CTX_CB_FAIL) && cbrc < 0 ) {
-         fskit_error("Callback failed (rc = %d)\n", cbrc );
-         fskit_entry_unlock( fent );
-         ctx->cbrc = cbrc;
-         return -EFAULT;
-      }
-      if( rc >= 0 ) {
+      if( consumed ) {
 
-         if( rc == 0 ) {
-            // not destroyed--still opened somewhere
-            fskit_entry_unlock( fent );
+         // consumed!
+         ctx->head = ctx->head->next;
+         if( ctx->head == NULL ) {
+            ctx->tail = NULL;
          }
-         else {
-            // destroyed
-            rc = 0;
-         }
-      }
-      else {
-         // shouldn't happen: failed to destroy and free
-         fskit_error("BUG: fskit_entry_try_destroy_and_free(%s) rc = %d\n", fent_path, rc );
+         ctx->size--;
          
-         fskit_entry_unlock( fent );
-         return rc;
+         fskit_detach_entry_free( next );
       }
 
-      // consumed!
-      ctx->head = ctx->head->next;
-      ctx->size--;
-      
-      fskit_safe_free( next->path );
-      fskit_safe_free( next );
+      if( rc == -EFAULT ) {
+         ctx->cbrc = cbrc;
+      }
    }
 
    // if all went well, then ctx's queues will be empty
@@ -732,6 +1503,19 @@ int fskit_detach_ctx_set_flags( struct fskit_detach_ctx* ctx, int flags ) {
    return old;
 }
 
+// set the number of threads fskit_detach_all_ex may use
+// return 0 on success
+// return -EINVAL if num_threads is not positive
+int fskit_detach_ctx_set_threads( struct fskit_detach_ctx* ctx, int num_threads ) {
+
+   if( num_threads <= 0 ) {
+      return -EINVAL;
+   }
+
+   ctx->num_threads = num_threads;
+   return 0;
+}
+
 // get the last callback return code 
 int fskit_detach_ctx_get_cbrc( struct fskit_detach_ctx* ctx ) {
    return ctx->cbrc;
@@ -748,12 +1532,12 @@ int fskit_detach_ctx_free( struct fskit_detach_ctx* ctx ) {
       tmp = to_erase;
       to_erase = to_erase->next;
       
-      fskit_safe_free( tmp->path );
-      fskit_safe_free( tmp );
+      fskit_detach_entry_free( tmp );
    }
    
    ctx->head = NULL;
    ctx->tail = NULL;
+   ctx->size = 0;
 
    return 0;
 }
@@ -778,6 +1562,14 @@ int fskit_detach_all( struct fskit_core* core, char const* root_path ) {
        return rc;
    }
    
+   rc = fskit_cow_detach( core, dent );
+   if( rc != 0 ) {
+       fskit_detach_ctx_free( &ctx );
+       fskit_error("fskit_cow_detach('%" PRIX64 "') rc = %d\n", dent->file_id, rc );
+       fskit_entry_unlock( dent );
+       return rc;
+   }
+
    // swap out the children, and mark this directory as garbage-collectable
    rc = fskit_entry_tag_garbage( dent, &dir_children );
    if( rc != 0 ) {
@@ -945,9 +1737,13 @@ int fskit_entry_init_common( struct fskit_entry* fent, uint8_t type, uint64_t fi
    fskit_entry_set_ctime( fent, &now );
    fskit_entry_set_mtime( fent, &now );
 
-   pthread_rwlock_init( &fent->lock, NULL );
+   fskit_rwlock_init( &fent->lock );
 
    fent->xattrs = NULL;
+   fent->xattrs_packed = NULL;
+   fent->data = NULL;
+   fent->cow = NULL;
+   fent->usage = NULL;
 
    return 0;
 }
@@ -976,19 +1772,21 @@ int fskit_entry_init_file( struct fskit_entry* fent, uint64_t file_id, uint64_t
 int fskit_entry_init_dir( struct fskit_entry* fent, struct fskit_entry* parent, uint64_t file_id, uint64_t owner, uint64_t group, mode_t mode ) {
 
    int rc = 0;
-   
-   fskit_entry_set* children = fskit_entry_set_new( fent, parent );
-   if( children == NULL ) {
-      return -ENOMEM;
-   }
+   fskit_entry_set* children = NULL;
 
    rc = fskit_entry_init_common( fent, FSKIT_ENTRY_TYPE_DIR, file_id, owner, group, mode );
    if( rc != 0 ) {
       fskit_error("fskit_entry_init_common(%" PRIX64 ") rc = %d\n", file_id, rc );
-      fskit_safe_free( children );
       return rc;
    }
 
+   // after init, so . (and .. at the root) snapshot the right type and file ID
+   children = fskit_entry_set_new( fent, parent );
+   if( children == NULL ) {
+      fskit_rwlock_destroy( &fent->lock );
+      return -ENOMEM;
+   }
+
    fent->children = children;
    return 0;
 }
@@ -1185,9 +1983,14 @@ int fskit_entry_destroy( struct fskit_core* core, struct fskit_entry* fent, bool
    }
 
    fskit_debug("fskit_entry_destroy %" PRIX64 "\n", fent->file_id);
+   FSKIT_TRACE2( entry__destroy, fent->file_id, fent->type );
+
+   fskit_usage_release_entry( fent );
 
    fent->type = FSKIT_ENTRY_TYPE_DEAD;      // next thread to hold this lock knows this is a dead entry
 
+   fskit_cow_forget( fent );
+
    // free common fields
    if( fent->children != NULL ) {
       fskit_entry_set_free( fent->children );
@@ -1199,17 +2002,15 @@ int fskit_entry_destroy( struct fskit_core* core, struct fskit_entry* fent, bool
       fent->symlink_target = NULL;
    }
    
-   if( fent->xattrs != NULL ) {
-      fskit_xattr_set_free( fent->xattrs );
-      fent->xattrs = NULL;
-   }
+   fskit_entry_xattr_clear( fent );
+   fskit_data_free( fent );
    
    (*core->fskit_inode_free)( fent->file_id, core->app_fs_data );
   
    if( needlock ) { 
        fskit_entry_unlock( fent );
    }
-   pthread_rwlock_destroy( &fent->lock );
+   fskit_rwlock_destroy( &fent->lock );
 
    return 0;
 }
@@ -1306,7 +2107,7 @@ int fskit_entry_try_garbage_collect( struct fskit_core* core, char const* path,
       child_inode_id = child->file_id;
 
       // detach from the parent, but don't update mtime (since it was already detached)
-      rc = fskit_entry_detach_lowlevel_ex( parent, path_basename, false );
+      rc = fskit_entry_detach_lowlevel_ex( parent, path_basename, false, false );
       if( rc < 0 ) {
          
          if( rc == -ENOENT ) {
@@ -1328,9 +2129,13 @@ int fskit_entry_try_garbage_collect( struct fskit_core* core, char const* path,
 
             if( rc > 0 ) {
                
-               // destroyed! clear its name from the parent's children
-               fskit_entry_set_remove( &parent->children, path_basename );
-               parent->num_children--;
+               // destroyed! clear its name from the parent's children, if the detach didn't already
+               if( fskit_entry_set_remove( &parent->children, path_basename ) ) {
+
+                  parent->num_children--;
+                  fskit_usage_add( parent->usage, FSKIT_USAGE_DIRENTS, -1 );
+                  fskit_usage_add( parent->usage, FSKIT_USAGE_NAME_BYTES, -(int64_t)(strlen( path_basename ) + 1) );
+               }
                
                fskit_debug( "Garbage-collected %s (%" PRIX64 ")\n", path, child_inode_id );
             }
@@ -1359,13 +2164,20 @@ int fskit_entry_rlock2( struct fskit_entry* fent, char const* from_str, int line
       fskit_debug( "%p: %" PRIX64 ", from %s:%d\n", fent, fent->file_id, from_str, line_no );
    }
 
-   int rc = pthread_rwlock_rdlock( &fent->lock );
+   int rc = 0;
+
+   if( FSKIT_LOCKSTAT_ON() ) {
+      rc = fskit_lockstat_rwlock( &fent->lock, false, FSKIT_LOCK_CLASS_ENTRY, from_str, line_no );
+   }
+   else {
+      rc = fskit_rwlock_rdlock( &fent->lock );
+   }
 
    if( rc != 0 ) {
-      fskit_error("pthread_rwlock_rdlock(%p) rc = %d (from %s:%d)\n", fent, rc, from_str, line_no );
+      fskit_error("fskit_rwlock_rdlock(%p) rc = %d (from %s:%d)\n", fent, rc, from_str, line_no );
    }
    else if( fent->type == FSKIT_ENTRY_TYPE_DEAD ) {
-      pthread_rwlock_unlock( &fent->lock );
+      fskit_rwlock_unlock( &fent->lock );
       return -ENOENT;
    }
 
@@ -1378,13 +2190,20 @@ int fskit_entry_wlock2( struct fskit_entry* fent, char const* from_str, int line
       fskit_debug( "%p: %" PRIX64 ", from %s:%d\n", fent, fent->file_id, from_str, line_no );
    }
 
-   int rc = pthread_rwlock_wrlock( &fent->lock );
+   int rc = 0;
+
+   if( FSKIT_LOCKSTAT_ON() ) {
+      rc = fskit_lockstat_rwlock( &fent->lock, true, FSKIT_LOCK_CLASS_ENTRY, from_str, line_no );
+   }
+   else {
+      rc = fskit_rwlock_wrlock( &fent->lock );
+   }
 
    if( rc != 0 ) {
-      fskit_error("pthread_rwlock_wrlock(%p) rc = %d (from %s:%d)\n", fent, rc, from_str, line_no );
+      fskit_error("fskit_rwlock_wrlock(%p) rc = %d (from %s:%d)\n", fent, rc, from_str, line_no );
    }
    else if( fent->type == FSKIT_ENTRY_TYPE_DEAD ) {
-      pthread_rwlock_unlock( &fent->lock );
+      fskit_rwlock_unlock( &fent->lock );
       return -ENOENT;
    }
 
@@ -1393,47 +2212,69 @@ int fskit_entry_wlock2( struct fskit_entry* fent, char const* from_str, int line
 
 // unlock a file
 int fskit_entry_unlock2( struct fskit_entry* fent, char const* from_str, int line_no ) {
-   int rc = pthread_rwlock_unlock( &fent->lock );
+   // fent may be freed by another thread as soon as it is unlocked
+   uint64_t file_id = fent->file_id;
+   int rc = fskit_rwlock_unlock( &fent->lock );
    if( rc == 0 ) {
       if( FSKIT_GLOBAL_DEBUG_LOCKS ) {
-         fskit_debug( "%p: %" PRIX64 ", from %s:%d\n", fent, fent->file_id, from_str, line_no );
+         fskit_debug( "%p: %" PRIX64 ", from %s:%d\n", fent, file_id, from_str, line_no );
       }
    }
    else {
-      fskit_error("pthread_rwlock_unlock(%p) rc = %d (from %s:%d)\n", fent, rc, from_str, line_no );
+      fskit_error("fskit_rwlock_unlock(%p) rc = %d (from %s:%d)\n", fent, rc, from_str, line_no );
    }
 
    return rc;
 }
 
 // lock a file handle for reading
-int fskit_file_handle_rlock( struct fskit_file_handle* fh ) {
-   return pthread_rwlock_rdlock( &fh->lock );
+int fskit_file_handle_rlock2( struct fskit_file_handle* fh, char const* from_str, int line_no ) {
+
+   if( FSKIT_LOCKSTAT_ON() ) {
+      return fskit_lockstat_rwlock( &fh->lock, false, FSKIT_LOCK_CLASS_HANDLE, from_str, line_no );
+   }
+
+   return fskit_rwlock_rdlock( &fh->lock );
 }
 
 // lock a file handle for writing
-int fskit_file_handle_wlock( struct fskit_file_handle* fh ) {
-   return pthread_rwlock_wrlock( &fh->lock );
+int fskit_file_handle_wlock2( struct fskit_file_handle* fh, char const* from_str, int line_no ) {
+
+   if( FSKIT_LOCKSTAT_ON() ) {
+      return fskit_lockstat_rwlock( &fh->lock, true, FSKIT_LOCK_CLASS_HANDLE, from_str, line_no );
+   }
+
+   return fskit_rwlock_wrlock( &fh->lock );
 }
 
 // unlock a file handle
 int fskit_file_handle_unlock( struct fskit_file_handle* fh ) {
-   return pthread_rwlock_unlock( &fh->lock );
+   return fskit_rwlock_unlock( &fh->lock );
 }
 
 // lock a directory handle for reading
-int fskit_dir_handle_rlock( struct fskit_dir_handle* dh ) {
-   return pthread_rwlock_rdlock( &dh->lock );
+int fskit_dir_handle_rlock2( struct fskit_dir_handle* dh, char const* from_str, int line_no ) {
+
+   if( FSKIT_LOCKSTAT_ON() ) {
+      return fskit_lockstat_rwlock( &dh->lock, false, FSKIT_LOCK_CLASS_HANDLE, from_str, line_no );
+   }
+
+   return fskit_rwlock_rdlock( &dh->lock );
 }
 
 // lock a directory handle for writing
-int fskit_dir_handle_wlock( struct fskit_dir_handle* dh ) {
-   return pthread_rwlock_wrlock( &dh->lock );
+int fskit_dir_handle_wlock2( struct fskit_dir_handle* dh, char const* from_str, int line_no ) {
+
+   if( FSKIT_LOCKSTAT_ON() ) {
+      return fskit_lockstat_rwlock( &dh->lock, true, FSKIT_LOCK_CLASS_HANDLE, from_str, line_no );
+   }
+
+   return fskit_rwlock_wrlock( &dh->lock );
 }
 
 // unlock a directory handle
 int fskit_dir_handle_unlock( struct fskit_dir_handle* dh ) {
-   return pthread_rwlock_unlock( &dh->lock );
+   return fskit_rwlock_unlock( &dh->lock );
 }
 
 // read-lock a filesystem core
@@ -1443,7 +2284,14 @@ int fskit_core_rlock2( struct fskit_core* core, char const* from_str, int lineno
       fskit_debug( "%p: from %s:%d\n", core, from_str, lineno );
    }
 
-   int rc = pthread_rwlock_rdlock( &core->lock );
+   int rc = 0;
+
+   if( FSKIT_LOCKSTAT_ON() ) {
+      rc = fskit_lockstat_pthread_rwlock( &core->lock, false, FSKIT_LOCK_CLASS_CORE, from_str, lineno );
+   }
+   else {
+      rc = pthread_rwlock_rdlock( &core->lock );
+   }
 
    if( rc != 0 ) {
       fskit_error("pthread_rwlock_rdlock(%p) rc = %d (from %s:%d)\n", core, rc, from_str, lineno );
@@ -1459,7 +2307,14 @@ int fskit_core_wlock2( struct fskit_core* core, char const* from_str, int lineno
       fskit_debug( "%p: from %s:%d\n", core, from_str, lineno );
    }
 
-   int rc = pthread_rwlock_wrlock( &core->lock );
+   int rc = 0;
+
+   if( FSKIT_LOCKSTAT_ON() ) {
+      rc = fskit_lockstat_pthread_rwlock( &core->lock, true, FSKIT_LOCK_CLASS_CORE, from_str, lineno );
+   }
+   else {
+      rc = pthread_rwlock_wrlock( &core->lock );
+   }
    
    if( rc != 0 ) {
       fskit_error("pthread_rwlock_wrlock(%p) rc = %d (from %s:%d)\n", core, rc, from_str, lineno );
@@ -1485,12 +2340,22 @@ int fskit_core_unlock2( struct fskit_core* core, char const* from_str, int linen
 }
 
 // read-lock routes
-int fskit_core_route_rlock( struct fskit_core* core ) {
+int fskit_core_route_rlock2( struct fskit_core* core, char const* from_str, int line_no ) {
+
+   if( FSKIT_LOCKSTAT_ON() ) {
+      return fskit_lockstat_pthread_rwlock( &core->route_lock, false, FSKIT_LOCK_CLASS_ROUTE, from_str, line_no );
+   }
+
    return pthread_rwlock_rdlock( &core->route_lock );
 }
 
 // write-lock routes
-int fskit_core_route_wlock( struct fskit_core* core ) {
+int fskit_core_route_wlock2( struct fskit_core* core, char const* from_str, int line_no ) {
+
+   if( FSKIT_LOCKSTAT_ON() ) {
+      return fskit_lockstat_pthread_rwlock( &core->route_lock, true, FSKIT_LOCK_CLASS_ROUTE, from_str, line_no );
+   }
+
    return pthread_rwlock_wrlock( &core->route_lock );
 }
 
@@ -1499,6 +2364,56 @@ int fskit_core_route_unlock( struct fskit_core* core ) {
    return pthread_rwlock_unlock( &core->route_lock );
 }
 
+// lock functions for callers that do not record call sites.
+// The names are parenthesized so the call-site macros in entry.h do not expand here.
+int (fskit_entry_rlock)( struct fskit_entry* fent ) {
+   return fskit_entry_rlock2( fent, NULL, 0 );
+}
+
+int (fskit_entry_wlock)( struct fskit_entry* fent ) {
+   return fskit_entry_wlock2( fent, NULL, 0 );
+}
+
+int (fskit_entry_unlock)( struct fskit_entry* fent ) {
+   return fskit_entry_unlock2( fent, NULL, 0 );
+}
+
+int (fskit_file_handle_rlock)( struct fskit_file_handle* fh ) {
+   return fskit_file_handle_rlock2( fh, NULL, 0 );
+}
+
+int (fskit_file_handle_wlock)( struct fskit_file_handle* fh ) {
+   return fskit_file_handle_wlock2( fh, NULL, 0 );
+}
+
+int (fskit_dir_handle_rlock)( struct fskit_dir_handle* dh ) {
+   return fskit_dir_handle_rlock2( dh, NULL, 0 );
+}
+
+int (fskit_dir_handle_wlock)( struct fskit_dir_handle* dh ) {
+   return fskit_dir_handle_wlock2( dh, NULL, 0 );
+}
+
+int (fskit_core_rlock)( struct fskit_core* core ) {
+   return fskit_core_rlock2( core, NULL, 0 );
+}
+
+int (fskit_core_wlock)( struct fskit_core* core ) {
+   return fskit_core_wlock2( core, NULL, 0 );
+}
+
+int (fskit_core_unlock)( struct fskit_core* core ) {
+   return fskit_core_unlock2( core, NULL, 0 );
+}
+
+int (fskit_core_route_rlock)( struct fskit_core* core ) {
+   return fskit_core_route_rlock2( core, NULL, 0 );
+}
+
+int (fskit_core_route_wlock)( struct fskit_core* core ) {
+   return fskit_core_route_wlock2( core, NULL, 0 );
+}
+
 // set user data in an fskit_entry (which must be write-locked)
 // return 0 always
 int fskit_entry_set_user_data( struct fskit_entry* ent, void* app_data ) {
@@ -1508,9 +2423,16 @@ int fskit_entry_set_user_data( struct fskit_entry* ent, void* app_data ) {
 
 // set the file ID
 // NOTE: don't do this outside of creat(), mkdir(), or mknod(), unless you want to suffer the consequences.
+// (in particular, readdir on the parent directory will report the file ID ent had when it was attached).
 // ent must be write-locked
 void fskit_entry_set_file_id( struct fskit_entry* ent, uint64_t file_id ) {
+   
    ent->file_id = file_id;
+
+   // keep . in sync.  The parent's copy is taken when ent is attached, which happens later.
+   if( ent->type == FSKIT_ENTRY_TYPE_DIR && ent->children != NULL ) {
+      fskit_entry_set_replace( ent->children, ".", ent );
+   }
 }
 
 // put a new set of children in place 
@@ -1520,13 +2442,27 @@ fskit_entry_set* fskit_entry_swap_children( struct fskit_entry* ent, fskit_entry
    return old_children;
 }
 
-// put a new set of xattrs in place
+// put a new set of xattrs in place.
+// packed attributes are moved into the returned set first (ent must be write-locked)
 fskit_xattr_set* fskit_entry_swap_xattrs( struct fskit_entry* ent, fskit_xattr_set* new_xattrs ) {
+   fskit_entry_xattr_expand( ent );
+   int64_t old_bytes = fskit_entry_xattr_bytes( ent );
    fskit_xattr_set* old_xattrs = ent->xattrs;
    ent->xattrs = new_xattrs;
+   fskit_usage_add( ent->usage, FSKIT_USAGE_XATTR_BYTES, (int64_t)fskit_entry_xattr_bytes( ent ) - old_bytes );
    return old_xattrs;
 }
 
+// count the bytes held by a symlink's target, including its terminator
+uint64_t fskit_entry_symlink_bytes( struct fskit_entry* fent ) {
+
+   if( fent->symlink_target == NULL ) {
+      return 0;
+   }
+
+   return strlen( fent->symlink_target ) + 1;
+}
+
 // put a new symlink target, and replace the old one
 // returns NULL if not a symlink 
 char* fskit_entry_swap_symlink_target( struct fskit_entry* ent, char* new_symlink_target ) {
@@ -1535,7 +2471,10 @@ char* fskit_entry_swap_symlink_target( struct fskit_entry* ent, char* new_symlin
    }
    
    char* old_target = ent->symlink_target;
+   uint64_t old_bytes = fskit_entry_symlink_bytes( ent );
+
    ent->symlink_target = new_symlink_target;
+   fskit_usage_add( ent->usage, FSKIT_USAGE_SYMLINK_BYTES, (int64_t)fskit_entry_symlink_bytes( ent ) - (int64_t)old_bytes );
    
    if( new_symlink_target != NULL ) {
       ent->size = strlen(new_symlink_target);
@@ -1566,15 +2505,15 @@ int fskit_entry_tag_garbage( struct fskit_entry* ent, fskit_entry_set** children
     if( ent->type == FSKIT_ENTRY_TYPE_DIR ) {
         
         // new, empty child set 
-        struct fskit_entry* parent = fskit_entry_set_find_name( ent->children, ".." );
-        if( parent == NULL ) {
+        fskit_entry_set* parent = fskit_entry_set_find_itr( ent->children, ".." );
+        if( parent == NULL || parent->dirent == NULL ) {
             
             // should *never* happen 
             fskit_error("BUG: directory %" PRIX64 " does not have a parent entry\n", ent->file_id );
             return -EIO;
         }
         
-        fskit_entry_set* empty_children = fskit_entry_set_new( ent, parent );
+        fskit_entry_set* empty_children = fskit_entry_set_new_empty( ent );
         if( empty_children == NULL ) {
             
             // OOM 
@@ -1584,11 +2523,14 @@ int fskit_entry_tag_garbage( struct fskit_entry* ent, fskit_entry_set** children
         // do the swap 
         *children = ent->children;
         ent->children = empty_children;
+
+        fskit_usage_add( ent->usage, FSKIT_USAGE_DIRENTS, -ent->num_children );
+        fskit_usage_add( ent->usage, FSKIT_USAGE_NAME_BYTES, -(int64_t)fskit_entry_set_name_bytes( *children ) );
         ent->num_children = 0;
-        ent->deletion_in_progress = true;
+        __atomic_store_n( &ent->deletion_in_progress, true, __ATOMIC_RELAXED );
     }
     else {
-       ent->deletion_in_progress = true;
+       __atomic_store_n( &ent->deletion_in_progress, true, __ATOMIC_RELAXED );
     }
 
     return 0;
@@ -1654,8 +2596,10 @@ fskit_entry_set* fskit_entry_get_children( struct fskit_entry* ent ) {
    return ent->children;
 }
 
-// get a pointer to the xattrs 
+// get a pointer to the xattrs.
+// packed attributes are moved into a set first (ent must be write-locked)
 fskit_xattr_set* fskit_entry_get_xattrs( struct fskit_entry* ent ) {
+   fskit_entry_xattr_expand( ent );
    return ent->xattrs;
 }
 
@@ -1689,7 +2633,7 @@ void fskit_entry_get_ctime( struct fskit_entry* ent, int64_t* ctime_sec, int32_t
 
 // get size (ent must be read-locked)
 off_t fskit_entry_get_size( struct fskit_entry* ent ) {
-   return ent->size;
+   return __atomic_load_n( &ent->size, __ATOMIC_RELAXED );
 }
 
 // get device major/minor, if this is a special file (ent must be read-lodked)
@@ -1707,6 +2651,11 @@ int32_t fskit_entry_get_link_count( struct fskit_entry* ent ) {
    return ent->link_count;
 }
 
+// get the number of open handles and in-flight references (ent must be read-locked)
+int32_t fskit_entry_get_open_count( struct fskit_entry* ent ) {
+   return ent->open_count;
+}
+
 // get number of children.  if this is not a directory, return -1
 // NOTE: ent must be read-locked
 int64_t fskit_entry_get_num_children( struct fskit_entry* ent ) {
@@ -36,7 +36,9 @@ int fskit_library_init() {
    return 0;
 }
 
-// shutdown the library (no-op)
+// shutdown the library.  Writes out any buffered log messages.
 int fskit_library_shutdown() {
+
+   fskit_log_flush();
    return 0;
 }
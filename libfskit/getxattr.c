@@ -83,7 +83,7 @@ int fskit_xattr_fgetxattr( struct fskit_core* core, struct fskit_entry* fent, ch
    char const* value = NULL;
    size_t value_len = 0;
 
-   value = fskit_xattr_set_find( fent->xattrs, name, &value_len );
+   value = fskit_entry_xattr_find( fent, name, &value_len );
    if( value == NULL ) {
       
       return -ENOATTR;
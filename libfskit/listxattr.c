@@ -69,72 +69,13 @@ int fskit_listxattr( struct fskit_core* core, char const* path, uint64_t user, u
 }
 
 
-// what's the total length of all attributes names (null-terminated)?
-static int fskit_listxattr_len( fskit_xattr_set* xattrs ) {
-
-   int size = 0;
-   char const* name = NULL;
-   fskit_xattr_set_itr itr;
-   fskit_xattr_set* xattr = NULL;
-
-   if( xattrs == NULL ) {
-      return 0;
-   }
-   
-   for( xattr = fskit_xattr_set_begin( &itr, xattrs ); xattr != NULL; xattr = fskit_xattr_set_next( &itr ) ) {
-      
-      name = fskit_xattr_set_name( xattr );
-      size += strlen(name) + 1;
-   }
-
-   return size;
-}
-
-
-// copy the xattr names into a buffer.
-// NOTE: no input validation occurs here.  The caller must ensure that list has enough space to hold all names, separated by \0's
-static void fskit_listxattr_copy_names( fskit_xattr_set* xattrs, char* list, size_t size ) {
-
-   off_t offset = 0;
-   char const* name = NULL;
-   fskit_xattr_set_itr itr;
-   fskit_xattr_set* xattr = NULL;
-   
-   for( xattr = fskit_xattr_set_begin( &itr, xattrs ); xattr != NULL; xattr = fskit_xattr_set_next( &itr ) ) {
-      
-      name = fskit_xattr_set_name( xattr );
-      memcpy( list + offset, name, strlen(name) );
-      
-      offset += strlen(name);
-      *(list + offset) = '\0';
-      offset++;
-   }
-}
-
-
 // low-level listxattr 
 // return length copied on success (or if size is 0)
 // return -ERANGE if the buffer is too short
 // fent must be read-locked
 int fskit_xattr_flistxattr( struct fskit_core* core, struct fskit_entry* fent, char* list, size_t size ) {
 
-   int total_size = 0;
-
-   total_size = fskit_listxattr_len( fent->xattrs );
-
-   // just a length query?
-   if( list == NULL || size == 0 ) {
-      return total_size;
-   }
-
-   // range check
-   if( (unsigned)total_size > size ) {
-      return -ERANGE;
-   }
-
-   // copy new names in
-   fskit_listxattr_copy_names( fent->xattrs, list, size );
-   return total_size;
+   return fskit_entry_xattr_list( fent, list, size );
 }
 
 
@@ -0,0 +1,490 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// lock contention profiling.
+// when enabled, each lock taken through the fskit lock functions is first tried without waiting.  If that fails,
+// the time spent waiting is measured.  Either way, the acquisition is counted against its call site, lock class,
+// and mode.
+// each thread counts into its own table, so recording never takes a shared lock or dirties a shared cache line.
+// the tables are summed on demand; when a thread exits, its table is folded into a retired table.
+
+#include <fskit/lockstat.h>
+#include <fskit/fskit.h>
+#include <fskit/util.h>
+
+#include "fskit_private/private.h"
+
+#include <time.h>
+
+#define FSKIT_LOCKSTAT_SLOT_BITS        10
+#define FSKIT_LOCKSTAT_NUM_SLOTS        (1 << FSKIT_LOCKSTAT_SLOT_BITS)
+
+// one thread's counts, as an open-addressed hash table keyed on (file, line, class, mode).
+// only the owning thread adds slots or bumps counters; readers see them through relaxed atomic loads.
+struct fskit_lockstat_buf {
+
+   struct fskit_lockstat_site slots[ FSKIT_LOCKSTAT_NUM_SLOTS ];
+   uint64_t dropped;                    // acquisitions not counted because the table was full
+
+   struct fskit_lockstat_buf* prev;
+   struct fskit_lockstat_buf* next;
+};
+
+int FSKIT_GLOBAL_LOCKSTAT = 0;
+
+static pthread_mutex_t fskit_lockstat_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct fskit_lockstat_buf* fskit_lockstat_bufs = NULL;          // tables of live threads
+static struct fskit_lockstat_buf* fskit_lockstat_retired = NULL;       // counts from exited threads
+
+static pthread_once_t fskit_lockstat_once = PTHREAD_ONCE_INIT;
+static pthread_key_t fskit_lockstat_key;
+
+// this thread's table, or NULL if it hasn't taken a lock since profiling was enabled
+static _Thread_local struct fskit_lockstat_buf* fskit_lockstat_self = NULL;
+
+static void fskit_lockstat_add( uint64_t* counter, uint64_t n ) {
+   __atomic_store_n( counter, __atomic_load_n( counter, __ATOMIC_RELAXED ) + n, __ATOMIC_RELAXED );
+}
+
+static uint64_t fskit_lockstat_get( uint64_t* counter ) {
+   return __atomic_load_n( counter, __ATOMIC_RELAXED );
+}
+
+static unsigned int fskit_lockstat_hash( char const* file, int line, int lock_class, bool write ) {
+
+   uint64_t h = (uintptr_t)file ^ (((uint64_t)line << 3) | ((uint64_t)lock_class << 1) | (write ? 1 : 0));
+   h *= 0x9E3779B97F4A7C15ULL;
+
+   return (unsigned int)(h >> (64 - FSKIT_LOCKSTAT_SLOT_BITS));
+}
+
+// find or add the slot for a call site.
+// only the thread that owns buf may call this.
+// return NULL if the table is full
+static struct fskit_lockstat_site* fskit_lockstat_slot( struct fskit_lockstat_buf* buf, char const* file, int line, int lock_class, bool write ) {
+
+   unsigned int i = fskit_lockstat_hash( file, line, lock_class, write );
+
+   for( int n = 0; n < FSKIT_LOCKSTAT_NUM_SLOTS; n++ ) {
+
+      struct fskit_lockstat_site* site = &buf->slots[i];
+      char const* site_file = __atomic_load_n( &site->file, __ATOMIC_ACQUIRE );
+
+      if( site_file == NULL ) {
+
+         // claim it.  Publish the file last, so readers never see a half-filled key.
+         site->line = line;
+         site->lock_class = lock_class;
+         site->write = write;
+
+         __atomic_store_n( &site->file, file, __ATOMIC_RELEASE );
+         return site;
+      }
+
+      if( site_file == file && site->line == line && site->lock_class == lock_class && site->write == write ) {
+         return site;
+      }
+
+      i = (i + 1) & (FSKIT_LOCKSTAT_NUM_SLOTS - 1);
+   }
+
+   return NULL;
+}
+
+// add everything in src to dest.
+// the caller must own dest, and hold fskit_lockstat_lock
+static void fskit_lockstat_merge( struct fskit_lockstat_buf* dest, struct fskit_lockstat_buf* src ) {
+
+   for( int i = 0; i < FSKIT_LOCKSTAT_NUM_SLOTS; i++ ) {
+
+      struct fskit_lockstat_site* site = &src->slots[i];
+      char const* file = __atomic_load_n( &site->file, __ATOMIC_ACQUIRE );
+
+      if( file == NULL ) {
+         continue;
+      }
+
+      struct fskit_lockstat_site* dest_site = fskit_lockstat_slot( dest, file, site->line, site->lock_class, site->write );
+      if( dest_site == NULL ) {
+
+         dest->dropped += fskit_lockstat_get( &site->acquired );
+         continue;
+      }
+
+      uint64_t max_wait_ns = fskit_lockstat_get( &site->max_wait_ns );
+
+      dest_site->acquired += fskit_lockstat_get( &site->acquired );
+      dest_site->contended += fskit_lockstat_get( &site->contended );
+      dest_site->wait_ns += fskit_lockstat_get( &site->wait_ns );
+
+      if( max_wait_ns > dest_site->max_wait_ns ) {
+         dest_site->max_wait_ns = max_wait_ns;
+      }
+   }
+
+   dest->dropped += fskit_lockstat_get( &src->dropped );
+}
+
+// fold an exiting thread's counts into the retired table
+static void fskit_lockstat_thread_exit( void* arg ) {
+
+   struct fskit_lockstat_buf* buf = (struct fskit_lockstat_buf*)arg;
+
+   pthread_mutex_lock( &fskit_lockstat_lock );
+
+   if( fskit_lockstat_retired == NULL ) {
+      fskit_lockstat_retired = CALLOC_LIST( struct fskit_lockstat_buf, 1 );
+   }
+
+   if( fskit_lockstat_retired != NULL ) {
+      fskit_lockstat_merge( fskit_lockstat_retired, buf );
+   }
+
+   if( buf->prev != NULL ) {
+      buf->prev->next = buf->next;
+   }
+   else {
+      fskit_lockstat_bufs = buf->next;
+   }
+
+   if( buf->next != NULL ) {
+      buf->next->prev = buf->prev;
+   }
+
+   pthread_mutex_unlock( &fskit_lockstat_lock );
+
+   fskit_lockstat_self = NULL;
+   free( buf );
+}
+
+static void fskit_lockstat_make_key(void) {
+   pthread_key_create( &fskit_lockstat_key, fskit_lockstat_thread_exit );
+}
+
+// get this thread's table, making it if need be.
+// return NULL if we're out of memory
+static struct fskit_lockstat_buf* fskit_lockstat_thread_buf(void) {
+
+   struct fskit_lockstat_buf* buf = fskit_lockstat_self;
+
+   if( buf != NULL ) {
+      return buf;
+   }
+
+   buf = CALLOC_LIST( struct fskit_lockstat_buf, 1 );
+   if( buf == NULL ) {
+      return NULL;
+   }
+
+   pthread_once( &fskit_lockstat_once, fskit_lockstat_make_key );
+   pthread_setspecific( fskit_lockstat_key, buf );
+
+   pthread_mutex_lock( &fskit_lockstat_lock );
+
+   buf->next = fskit_lockstat_bufs;
+   if( fskit_lockstat_bufs != NULL ) {
+      fskit_lockstat_bufs->prev = buf;
+   }
+
+   fskit_lockstat_bufs = buf;
+
+   pthread_mutex_unlock( &fskit_lockstat_lock );
+
+   fskit_lockstat_self = buf;
+   return buf;
+}
+
+// count one acquisition
+static void fskit_lockstat_record( char const* file, int line, int lock_class, bool write, bool contended, uint64_t wait_ns ) {
+
+   struct fskit_lockstat_buf* buf = fskit_lockstat_thread_buf();
+   struct fskit_lockstat_site* site = NULL;
+
+   if( buf == NULL ) {
+      return;
+   }
+
+   if( file == NULL ) {
+      // locked through a function that records no call site.  NULL marks an empty slot, so file these together.
+      file = "(unknown)";
+   }
+
+   site = fskit_lockstat_slot( buf, file, line, lock_class, write );
+   if( site == NULL ) {
+
+      fskit_lockstat_add( &buf->dropped, 1 );
+      return;
+   }
+
+   fskit_lockstat_add( &site->acquired, 1 );
+
+   if( contended ) {
+
+      fskit_lockstat_add( &site->contended, 1 );
+      fskit_lockstat_add( &site->wait_ns, wait_ns );
+
+      if( wait_ns > fskit_lockstat_get( &site->max_wait_ns ) ) {
+         __atomic_store_n( &site->max_wait_ns, wait_ns, __ATOMIC_RELAXED );
+      }
+   }
+}
+
+static uint64_t fskit_lockstat_elapsed_ns( struct timespec* start, struct timespec* end ) {
+   return (uint64_t)(end->tv_sec - start->tv_sec) * 1000000000ULL + end->tv_nsec - start->tv_nsec;
+}
+
+// take an fskit rwlock, and record how long it took.
+// return what fskit_rwlock_rdlock or fskit_rwlock_wrlock returns
+int fskit_lockstat_rwlock( fskit_rwlock_t* lock, bool write, int lock_class, char const* from_str, int line_no ) {
+
+   struct timespec start, end;
+   int rc = 0;
+
+   rc = write ? fskit_rwlock_trywrlock( lock ) : fskit_rwlock_tryrdlock( lock );
+   if( rc != -EBUSY ) {
+
+      if( rc == 0 ) {
+         fskit_lockstat_record( from_str, line_no, lock_class, write, false, 0 );
+      }
+
+      return rc;
+   }
+
+   clock_gettime( CLOCK_MONOTONIC, &start );
+
+   rc = write ? fskit_rwlock_wrlock( lock ) : fskit_rwlock_rdlock( lock );
+
+   clock_gettime( CLOCK_MONOTONIC, &end );
+
+   if( rc == 0 ) {
+      fskit_lockstat_record( from_str, line_no, lock_class, write, true, fskit_lockstat_elapsed_ns( &start, &end ) );
+   }
+
+   return rc;
+}
+
+// take a pthread rwlock, and record how long it took.
+// return what pthread_rwlock_rdlock or pthread_rwlock_wrlock returns
+int fskit_lockstat_pthread_rwlock( pthread_rwlock_t* lock, bool write, int lock_class, char const* from_str, int line_no ) {
+
+   struct timespec start, end;
+   int rc = 0;
+
+   rc = write ? pthread_rwlock_trywrlock( lock ) : pthread_rwlock_tryrdlock( lock );
+   if( rc != EBUSY ) {
+
+      if( rc == 0 ) {
+         fskit_lockstat_record( from_str, line_no, lock_class, write, false, 0 );
+      }
+
+      return rc;
+   }
+
+   clock_gettime( CLOCK_MONOTONIC, &start );
+
+   rc = write ? pthread_rwlock_wrlock( lock ) : pthread_rwlock_rdlock( lock );
+
+   clock_gettime( CLOCK_MONOTONIC, &end );
+
+   if( rc == 0 ) {
+      fskit_lockstat_record( from_str, line_no, lock_class, write, true, fskit_lockstat_elapsed_ns( &start, &end ) );
+   }
+
+   return rc;
+}
+
+// turn profiling on or off.  Counts are kept while it is off.
+void fskit_lockstat_set_enabled( bool enabled ) {
+   __atomic_store_n( &FSKIT_GLOBAL_LOCKSTAT, enabled ? 1 : 0, __ATOMIC_RELAXED );
+}
+
+bool fskit_lockstat_get_enabled(void) {
+   return FSKIT_LOCKSTAT_ON() != 0;
+}
+
+// sum up all threads' counts into a new table
+// return NULL if we're out of memory
+static struct fskit_lockstat_buf* fskit_lockstat_collect(void) {
+
+   struct fskit_lockstat_buf* total = CALLOC_LIST( struct fskit_lockstat_buf, 1 );
+   if( total == NULL ) {
+      return NULL;
+   }
+
+   pthread_mutex_lock( &fskit_lockstat_lock );
+
+   for( struct fskit_lockstat_buf* buf = fskit_lockstat_bufs; buf != NULL; buf = buf->next ) {
+      fskit_lockstat_merge( total, buf );
+   }
+
+   if( fskit_lockstat_retired != NULL ) {
+      fskit_lockstat_merge( total, fskit_lockstat_retired );
+   }
+
+   pthread_mutex_unlock( &fskit_lockstat_lock );
+
+   return total;
+}
+
+// most time spent waiting first, then most contended, then most acquired
+static int fskit_lockstat_site_cmp( const void* a, const void* b ) {
+
+   struct fskit_lockstat_site const* s1 = (struct fskit_lockstat_site const*)a;
+   struct fskit_lockstat_site const* s2 = (struct fskit_lockstat_site const*)b;
+
+   if( s1->wait_ns != s2->wait_ns ) {
+      return s1->wait_ns < s2->wait_ns ? 1 : -1;
+   }
+
+   if( s1->contended != s2->contended ) {
+      return s1->contended < s2->contended ? 1 : -1;
+   }
+
+   if( s1->acquired != s2->acquired ) {
+      return s1->acquired < s2->acquired ? 1 : -1;
+   }
+
+   return 0;
+}
+
+// get the summed counts for every call site seen, sorted with the most time spent waiting first,
+// and the number of acquisitions that could not be counted.
+// return 0 on success
+// return -ENOMEM on OOM
+static int fskit_lockstat_snapshot_ex( struct fskit_lockstat_site** sites, size_t* num_sites, uint64_t* dropped ) {
+
+   struct fskit_lockstat_buf* total = fskit_lockstat_collect();
+   struct fskit_lockstat_site* ret = NULL;
+   size_t n = 0;
+
+   if( total == NULL ) {
+      return -ENOMEM;
+   }
+
+   ret = CALLOC_LIST( struct fskit_lockstat_site, FSKIT_LOCKSTAT_NUM_SLOTS );
+   if( ret == NULL ) {
+
+      free( total );
+      return -ENOMEM;
+   }
+
+   for( int i = 0; i < FSKIT_LOCKSTAT_NUM_SLOTS; i++ ) {
+
+      if( total->slots[i].file != NULL && total->slots[i].acquired > 0 ) {
+         ret[n++] = total->slots[i];
+      }
+   }
+
+   *dropped = total->dropped;
+   free( total );
+
+   qsort( ret, n, sizeof(struct fskit_lockstat_site), fskit_lockstat_site_cmp );
+
+   *sites = ret;
+   *num_sites = n;
+   return 0;
+}
+
+// get the summed counts for every call site seen, sorted with the most time spent waiting first.
+// the caller must free *sites.
+// return 0 on success
+// return -ENOMEM on OOM
+int fskit_lockstat_snapshot( struct fskit_lockstat_site** sites, size_t* num_sites ) {
+
+   uint64_t dropped = 0;
+   return fskit_lockstat_snapshot_ex( sites, num_sites, &dropped );
+}
+
+// write a table of the summed counts to out
+// return 0 on success
+// return -ENOMEM on OOM
+int fskit_lockstat_dump( FILE* out ) {
+
+   struct fskit_lockstat_site* sites = NULL;
+   size_t num_sites = 0;
+   uint64_t dropped = 0;
+   int rc = 0;
+
+   rc = fskit_lockstat_snapshot_ex( &sites, &num_sites, &dropped );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   fprintf( out, "%-7s %-5s %12s %12s %14s %14s  %s\n", "class", "mode", "acquired", "contended", "wait_us", "max_wait_us", "site" );
+
+   for( size_t i = 0; i < num_sites; i++ ) {
+
+      fprintf( out, "%-7s %-5s %12" PRIu64 " %12" PRIu64 " %14.1f %14.1f  %s:%d\n",
+               fskit_lockstat_class_name( sites[i].lock_class ), sites[i].write ? "write" : "read",
+               sites[i].acquired, sites[i].contended, sites[i].wait_ns / 1e3, sites[i].max_wait_ns / 1e3,
+               sites[i].file, sites[i].line );
+   }
+
+   if( dropped > 0 ) {
+      fprintf( out, "(%" PRIu64 " acquisitions at other call sites were not counted)\n", dropped );
+   }
+
+   free( sites );
+   return 0;
+}
+
+// zero all counts.  Acquisitions that race with this may or may not be counted.
+void fskit_lockstat_reset(void) {
+
+   pthread_mutex_lock( &fskit_lockstat_lock );
+
+   for( struct fskit_lockstat_buf* buf = fskit_lockstat_bufs; buf != NULL; buf = buf->next ) {
+
+      for( int i = 0; i < FSKIT_LOCKSTAT_NUM_SLOTS; i++ ) {
+
+         struct fskit_lockstat_site* site = &buf->slots[i];
+
+         __atomic_store_n( &site->acquired, 0, __ATOMIC_RELAXED );
+         __atomic_store_n( &site->contended, 0, __ATOMIC_RELAXED );
+         __atomic_store_n( &site->wait_ns, 0, __ATOMIC_RELAXED );
+         __atomic_store_n( &site->max_wait_ns, 0, __ATOMIC_RELAXED );
+      }
+
+      __atomic_store_n( &buf->dropped, 0, __ATOMIC_RELAXED );
+   }
+
+   free( fskit_lockstat_retired );
+   fskit_lockstat_retired = NULL;
+
+   pthread_mutex_unlock( &fskit_lockstat_lock );
+}
+
+// name of a lock class
+char const* fskit_lockstat_class_name( int lock_class ) {
+
+   static char const* names[ FSKIT_LOCK_CLASS_NUM ] = {
+      "entry",
+      "core",
+      "route",
+      "handle",
+   };
+
+   if( lock_class < 0 || lock_class >= FSKIT_LOCK_CLASS_NUM ) {
+      return "unknown";
+   }
+
+   return names[ lock_class ];
+}
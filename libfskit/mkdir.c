@@ -137,6 +137,15 @@ static int fskit_mkdir_lowlevel( struct fskit_core* core, char const* path, stru
          return err;
       }
 
+      // count it, if there's room
+      err = fskit_usage_charge_entry( core, child, false );
+      if( err != 0 ) {
+
+         fskit_entry_destroy( core, child, false );
+         fskit_safe_free( child );
+         return err;
+      }
+
       // reference this directory, so it won't disappear during the user's route
       child->open_count++;
       
@@ -205,6 +205,19 @@ int fskit_mknod_ex( struct fskit_core* core, char const* fs_path, mode_t mode, d
 
    if( err == 0 ) {
 
+      // count it, if there's room
+      err = fskit_usage_charge_entry( core, child, false );
+      if( err != 0 ) {
+
+         fskit_entry_unlock( parent );
+         fskit_safe_free( path_basename );
+         fskit_entry_destroy( core, child, false );
+         fskit_safe_free( child );
+         fskit_safe_free( path );
+
+         return err;
+      }
+
       // success! get the inode number
       uint64_t file_id = fskit_core_inode_alloc( core, parent, child );
       if( file_id == 0 ) {
@@ -30,8 +30,9 @@
 #include "fskit_private/private.h"
 
 // create a file handle from a fskit_entry
+// cow_generation is the core's clone generation from before opened_path was walked
 // ent must be read-locked, or otherwise un-writable
-static struct fskit_file_handle* fskit_file_handle_create( struct fskit_core* core, struct fskit_entry* ent, char const* opened_path, int flags, void* handle_data ) {
+static struct fskit_file_handle* fskit_file_handle_create( struct fskit_core* core, struct fskit_entry* ent, char const* opened_path, int flags, void* handle_data, uint64_t cow_generation ) {
 
    struct fskit_file_handle* fh = CALLOC_LIST( struct fskit_file_handle, 1 );
 
@@ -44,8 +45,19 @@ static struct fskit_file_handle* fskit_file_handle_create( struct fskit_core* co
    fh->path = strdup( opened_path );
    fh->flags = flags;
    fh->app_data = handle_data;
+   fh->cow_generation = cow_generation;
 
-   pthread_rwlock_init( &fh->lock, NULL );
+   if( fh->path == NULL ) {
+
+      fskit_safe_free( fh );
+      return NULL;
+   }
+
+   fh->usage = core->usage;
+   fskit_usage_add( fh->usage, FSKIT_USAGE_FILE_HANDLES, 1 );
+   fskit_usage_add( fh->usage, FSKIT_USAGE_FILE_HANDLE_BYTES, strlen( fh->path ) + 1 );
+
+   fskit_rwlock_init( &fh->lock );
 
    return fh;
 }
@@ -131,7 +143,8 @@ static int fskit_do_parent_check( struct fskit_entry* parent, int flags, uint64_
 
 // do a file open
 // child must *not* be locked.
-// parent must be write-locked, but it will be unlocked and re-locked.  The child will be referenced during that time, so the parent is guaranteed not to disappear
+// parent must be write-locked, and it will be unlocked on return.  It is not re-locked after the user route runs:
+// the child stays referenced, but it can still be unlinked, after which nothing keeps the parent from being removed.
 // on success, fill in the handle data
 int fskit_do_open( struct fskit_core* core, char const* path, struct fskit_entry* parent, struct fskit_entry* child, int flags, uint64_t user, uint64_t group, void** handle_data ) {
 
@@ -169,21 +182,16 @@ int fskit_do_open( struct fskit_core* core, char const* path, struct fskit_entry
    }
    
    fskit_entry_unlock( child );
+   fskit_entry_unlock( parent );
 
    if( rc != 0 ) {
       // can't open
       return rc;
    }
    
-   // safe to allow access to the child while the user route is running, since the child (and thus the parent) can't get unlinked
-   fskit_entry_unlock( parent );
-   
    // open will succeed according to fskit.  invoke the user callback to generate handle data
    rc = fskit_run_user_open( core, path, child, flags, handle_data );
    
-   // reaquire...
-   fskit_entry_wlock( parent );
-   
    if( rc != 0 ) {
       fskit_error("fskit_run_user_open(%s) rc = %d\n", path, rc );
 
@@ -236,6 +244,9 @@ struct fskit_file_handle* fskit_open_ex( struct fskit_core* core, char const* _p
 
    struct fskit_file_handle* ret = NULL;
 
+   // walking the path pushes the clones made so far; later ones get pushed by the first write through the handle
+   uint64_t cow_generation = fskit_cow_generation( core );
+
    // write-lock parent--we need to ensure that the child does not disappear on us between attaching it and routing the user-given callback
    struct fskit_entry* parent = fskit_entry_resolve_path( core, path_dirname, user, group, true, err );
 
@@ -358,23 +369,28 @@ struct fskit_file_handle* fskit_open_ex( struct fskit_core* core, char const* _p
       
       // do the open
       // NOTE: do *not* lock it--it has to be unlocked for running user-given routes
+      // NOTE: this unlocks parent
       rc = fskit_do_open( core, path, parent, child, flags, user, group, &handle_data );
       if( rc != 0 ) {
 
          // open failed
-         fskit_entry_unlock( parent );
          fskit_safe_free( path );
          *err = rc;
          return NULL;
       }
    }
-   
-   // done with parent 
-   fskit_entry_unlock( parent );
+   else {
+
+      // done with parent
+      fskit_entry_unlock( parent );
+   }
 
    // still here--we can open the file now!
+   // child is referenced, so it's safe to lock it again
+   fskit_entry_wlock( child );
    fskit_entry_set_atime( child, NULL );
-   ret = fskit_file_handle_create( core, child, path, flags, handle_data );
+   fskit_entry_unlock( child );
+   ret = fskit_file_handle_create( core, child, path, flags, handle_data, cow_generation );
 
    fskit_safe_free( path );
 
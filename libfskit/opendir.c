@@ -40,7 +40,17 @@ static struct fskit_dir_handle* fskit_dir_handle_create( struct fskit_entry* dir
    dirh->file_id = dir->file_id;
    dirh->app_data = app_handle_data;
 
-   pthread_rwlock_init( &dirh->lock, NULL );
+   if( dirh->path == NULL ) {
+
+      fskit_safe_free( dirh );
+      return NULL;
+   }
+
+   dirh->usage = dir->usage;
+   fskit_usage_add( dirh->usage, FSKIT_USAGE_DIR_HANDLES, 1 );
+   fskit_usage_add( dirh->usage, FSKIT_USAGE_DIR_HANDLE_BYTES, strlen( dirh->path ) + 1 );
+
+   fskit_rwlock_init( &dirh->lock );
 
    return dirh;
 }
@@ -23,6 +23,7 @@
 #include <fskit/util.h>
 
 #include "fskit_private/private.h"
+#include "fskit_private/trace.h"
 
 struct fskit_path_iterator {
    
@@ -288,9 +289,9 @@ static int fskit_entry_ent_eval( struct fskit_entry* prev_ent, struct fskit_entr
    return eval_rc;
 }
 
-// resolve an absolute path, running a given function on each entry as the path is walked
+// walk an absolute path, running a given function on each entry
 // returns the locked fskit_entry at the end of the path on success
-struct fskit_entry* fskit_entry_resolve_path_cls( struct fskit_core* core, char const* path, uint64_t user, uint64_t group, bool writelock, int* err, int (*ent_eval)( struct fskit_entry*, void* ), void* cls ) {
+static struct fskit_entry* fskit_entry_resolve_path_walk( struct fskit_core* core, char const* path, uint64_t user, uint64_t group, bool writelock, int* err, int (*ent_eval)( struct fskit_entry*, void* ), void* cls ) {
 
    // if this path ends in '/', then append a '.'
    char* fpath = NULL;
@@ -370,8 +371,8 @@ struct fskit_entry* fskit_entry_resolve_path_cls( struct fskit_core* core, char
       // do we have permission to search this directory?
       if( cur_ent->type == FSKIT_ENTRY_TYPE_DIR && !FSKIT_ENTRY_IS_DIR_SEARCHABLE( cur_ent->mode, cur_ent->owner, cur_ent->group, user, group ) ) {
 
-         printf("User %" PRIu64 " of group %" PRIu64 " cannot read directory %" PRIX64 " owned by %" PRIu64 " in group %" PRIu64 "\n",
-                user, group, cur_ent->file_id, cur_ent->owner, cur_ent->group );
+         fskit_debug("User %" PRIu64 " of group %" PRIu64 " cannot read directory %" PRIX64 " owned by %" PRIu64 " in group %" PRIu64 "\n",
+                     user, group, cur_ent->file_id, cur_ent->owner, cur_ent->group );
 
          // the appropriate read flag is not set
          *err = -EACCES;
@@ -401,6 +402,7 @@ struct fskit_entry* fskit_entry_resolve_path_cls( struct fskit_core* core, char
          }
          else {
             cur_ent = fskit_entry_set_find_name( prev_ent->children, name );
+            FSKIT_TRACE3( path__component, prev_ent->file_id, name, (cur_ent != NULL ? cur_ent->file_id : 0) );
          }
       }
       else {
@@ -434,6 +436,22 @@ struct fskit_entry* fskit_entry_resolve_path_cls( struct fskit_core* core, char
             fskit_entry_rlock( cur_ent );
          }
 
+         // fill in copy-on-write clones we pass through, and materialize clones of directories we may change
+         if( cur_ent->type == FSKIT_ENTRY_TYPE_DIR ) {
+
+            int cow_rc = fskit_cow_fixup( core, cur_ent, writelock );
+            if( cow_rc != 0 ) {
+
+               fskit_entry_unlock( cur_ent );
+               fskit_entry_unlock( prev_ent );
+
+               *err = cow_rc;
+               fskit_safe_free( fpath );
+
+               return NULL;
+            }
+         }
+
          // before unlocking the previous ent, run our evaluator (if we have one)
          if( ent_eval ) {
             
@@ -494,6 +512,24 @@ struct fskit_entry* fskit_entry_resolve_path_cls( struct fskit_core* core, char
    }
 }
 
+// resolve an absolute path, running a given function on each entry as the path is walked
+// returns the locked fskit_entry at the end of the path on success
+struct fskit_entry* fskit_entry_resolve_path_cls( struct fskit_core* core, char const* path, uint64_t user, uint64_t group, bool writelock, int* err, int (*ent_eval)( struct fskit_entry*, void* ), void* cls ) {
+
+   struct fskit_entry* fent = NULL;
+
+   FSKIT_TRACE3( path__start, core, path, user );
+
+   fent = fskit_entry_resolve_path_walk( core, path, user, group, writelock, err, ent_eval, cls );
+
+   if( fent == NULL ) {
+      FSKIT_TRACE2( path__error, path, *err );
+   }
+
+   FSKIT_TRACE3( path__end, path, (fent != NULL ? fent->file_id : 0), (fent != NULL ? 0 : *err) );
+   return fent;
+}
+
 // resolve an absolute path.
 // returns the locked fskit_entry at the end of the path on success
 struct fskit_entry* fskit_entry_resolve_path( struct fskit_core* core, char const* path, uint64_t user, uint64_t group, bool writelock, int* err ) {
@@ -578,6 +614,7 @@ bool fskit_path_end( struct fskit_path_iterator* itr ) {
 // set itr->rc to -ENOTDIR if we encounter a file before running out of path
 // set itr->rc to -ENOMEM if we're OOM 
 // set itr->rc to -ENOENT if the named entry does not exist in the filesystem
+// set itr->rc to -EIO if a copy-on-write clone on the path couldn't be filled in
 void fskit_path_next( struct fskit_path_iterator* itr ) {
    
    char* tmp = NULL;
@@ -708,6 +745,12 @@ void fskit_path_next( struct fskit_path_iterator* itr ) {
       fskit_entry_rlock( itr->cur_ent );
    }
    
+   if( fskit_entry_get_type( itr->cur_ent ) == FSKIT_ENTRY_TYPE_DIR ) {
+      
+      // fill in copy-on-write clones (see fskit_entry_resolve_path_cls)
+      itr->rc = fskit_cow_fixup( itr->core, itr->cur_ent, itr->writelock );
+   }
+   
    // success!
    return;
 }
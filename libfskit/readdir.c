@@ -25,6 +25,7 @@
 #include <fskit/util.h>
 
 #include "fskit_private/private.h"
+#include "fskit_private/trace.h"
 
 
 // table entry for seekdir/telldir positions
@@ -38,10 +39,13 @@ struct fskit_telldir_entry {
 
 #define FSKIT_TELLDIR_ENTRY_CMP( t1, t2 ) (strcmp((t1)->name, (t2)->name))
 
-// initialize a directory entry from an fskit_entry
+// most positions a directory handle remembers.  Past this, telldir forgets the oldest one.
+#define FSKIT_TELLDIR_MAX       1024
+
+// initialize a directory entry from a directory's child set
 // return the new entry on success
 // return NULL if out-of-memory
-static struct fskit_dir_entry* fskit_make_dir_entry( struct fskit_entry* dent, char const* name ) {
+static struct fskit_dir_entry* fskit_make_dir_entry( fskit_entry_set* entry, char const* name ) {
 
    struct fskit_dir_entry* dir_ent = CALLOC_LIST( struct fskit_dir_entry, 1 );
    if( dir_ent == NULL ) {
@@ -49,8 +53,8 @@ static struct fskit_dir_entry* fskit_make_dir_entry( struct fskit_entry* dent, c
       return NULL;
    }
 
-   dir_ent->type = dent->type;
-   dir_ent->file_id = dent->file_id;
+   dir_ent->type = fskit_entry_set_type_at( entry );
+   dir_ent->file_id = fskit_entry_set_file_id_at( entry );
    memset( dir_ent->name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
    strncpy( dir_ent->name, name, FSKIT_FILESYSTEM_NAMEMAX );
    
@@ -109,61 +113,23 @@ int fskit_run_user_readdir( struct fskit_core* core, char const* path, struct fs
 }
 
 
-// find the starting point where we can begin to read a directory, based on the last-read name
-// set *read_itr and *read_start
+// find the starting point where we can begin to read a directory, based on the last-read name.
+// this is the first name after dirh->curr_name, whether or not curr_name is still present (O(log n)).
+// if nothing has been read yet (curr_name is empty), this is the first entry.
+// set *read_itr and *read_start (NULL at the end of the directory)
 static int fskit_readdir_find_start( struct fskit_dir_handle* dirh, fskit_entry_set_itr* read_itr, fskit_entry_set** read_start ) {
 
-    // find out where we can start reading
-    struct fskit_entry* dent = dirh->dent;
-    
-    fskit_entry_set* member = fskit_entry_set_find_itr( dent->children, dirh->curr_name );
-    if( member == NULL ) {
-        
-        // name is invalid--try to seek to the point where we left off 
-        fskit_entry_set* sought = NULL;
-        bool found = false;
-        
-        for( sought = fskit_entry_set_begin( read_itr, dent->children ); sought != NULL; sought = fskit_entry_set_next( read_itr ) ) {
-            
-            // if we reached the point where the names are lexicographically greater than where we left off last, then 
-            // that's the new read point 
-            char const* sought_name = fskit_entry_set_name_at( sought );
-            if( strcmp(dirh->curr_name, sought_name) < 0 ) {
-                
-                found = true;
-                break;
-            }
-        }
-        if( found ) {
-            
-            // scanned ahead!
-            *read_start = sought;
-        }
-        else {
-           
-            // end of directory!
-            *read_start = NULL;
-        }
-    }
-    else {
-        
-        *read_start = member;
-
-        // TODO: find out why sglib's init_on_equal method doesn't get us the right iterator
-        fskit_entry_set* tmp = NULL;
-        for( tmp = fskit_entry_set_begin( read_itr, dent->children ); tmp != NULL && tmp != member; tmp = fskit_entry_set_next( read_itr ) );
-    }
-    
+    *read_start = fskit_entry_set_begin_after( read_itr, dirh->dent->children, dirh->curr_name );
     return 0;
 }
 
 
 // iterate through dent->children and return a null-terminated list of fskit_dir_entry* pointers
+// dent must be at least read-locked; its children need not be.
 // On error, return NULL and:
 //    set *err to ENOMEM on OOM
 static struct fskit_dir_entry** fskit_readdir_itr( struct fskit_core* core, struct fskit_entry* dent, uint64_t num_children, uint64_t* num_read, fskit_entry_set* read_start, fskit_entry_set_itr* read_itr, int* err ) {
     
-   int rc = 0;
    uint64_t read_count = 0;
    fskit_entry_set* entry = NULL;
 
@@ -186,78 +152,16 @@ static struct fskit_dir_entry** fskit_readdir_itr( struct fskit_core* core, stru
          continue;
       }
       
-      // skip garbage-collectables
-      if( fent->deletion_in_progress || fent->type == FSKIT_ENTRY_TYPE_DEAD ) {
+      // skip garbage-collectables.  We don't hold the child's lock, so use the type the set caches, and load the
+      // deletion flag atomically.
+      if( __atomic_load_n( &fent->deletion_in_progress, __ATOMIC_RELAXED ) || fskit_entry_set_type_at( entry ) == FSKIT_ENTRY_TYPE_DEAD ) {
          
          continue;
       }
 
-      // next directory entry
-      struct fskit_dir_entry* dir_ent = NULL;
-
-      // handle . and .. separately--we only want to lock children (not the current or parent directory)
-      if( strcmp( fskit_name, "." ) == 0 ) { 
-
-         // handle .
-         dir_ent = fskit_make_dir_entry( dent, "." );
-      }
-      else if( strcmp( fskit_name, ".." ) == 0 ) {
-
-         // handle ..
-         // careful--the directory .. can be the same as dent if we're dealing with root.
-         if( dent != fent ) {
-
-            rc = fskit_entry_rlock( fent );
-            if( rc != 0 ) {
-
-               // shouldn't happen--indicates deadlock
-               fskit_error("fskit_entry_rlock(%p) rc = %d\n", fent, rc );
-               fskit_dir_entry_free_list( dir_ents );
-
-               *err = rc;
-               return NULL;
-            }
-         }
-
-         dir_ent = fskit_make_dir_entry( fent, ".." );
-
-         if( dent != fent ) {
-            fskit_entry_unlock( fent );
-         }
-         
-         if( dir_ent == NULL ) {
-             
-             // OOM--bail with what we have
-             *err = -ENOMEM;
-             break;
-         }
-      }
-      else {
-
-         // handle normal entry
-         rc = fskit_entry_rlock( fent );
-         if( rc != 0 ) {
-
-            // shouldn't happen--indicates deadlock
-            fskit_error("BUG: fskit_entry_rlock(%p) rc = %d\n", fent, rc );
-            fskit_dir_entry_free_list( dir_ents );
-
-            *err = rc;
-            return NULL;
-         }
-         
-         // snapshot this entry
-         dir_ent = fskit_make_dir_entry( fent, fskit_name );
-
-         fskit_entry_unlock( fent );
-         
-         if( dir_ent == NULL ) {
-             
-             // OOM--bail with what we have
-             *err = -ENOMEM;
-             break;
-         }
-      }
+      // snapshot this entry.  The set caches each child's type and file ID,
+      // so we need not lock the children (or worry about . and .. aliasing dent).
+      struct fskit_dir_entry* dir_ent = fskit_make_dir_entry( entry, fskit_name );
 
       // do we have an entry?
       if( dir_ent != NULL ) {
@@ -280,6 +184,8 @@ static struct fskit_dir_entry** fskit_readdir_itr( struct fskit_core* core, stru
        return NULL;
    }
 
+   FSKIT_TRACE2( readdir__batch, dent->file_id, read_count );
+
    *num_read = read_count;   
    return dir_ents;
 }
@@ -332,33 +238,13 @@ static struct fskit_dir_entry** fskit_readdir_lowlevel( struct fskit_core* core,
        return NULL;
    }
 
-   if( strlen(dirh->curr_name) == 0 ) {
-       
-       // haven't begun reading yet 
-       read_start = fskit_entry_set_begin( &read_itr, dent->children );
-       strncpy( dirh->curr_name, fskit_entry_set_name_at( read_start ), FSKIT_FILESYSTEM_NAMEMAX );
-   }
-   else {
-
-       fskit_entry_set_itr test_itr;
-       fskit_entry_set* test_entry;
+   // seek to the first unread entry
+   fskit_readdir_find_start( dirh, &read_itr, &read_start );
+   if( read_start == NULL ) {
 
-       fskit_readdir_find_start( dirh, &read_itr, &read_start );
-       if( read_start == NULL ) {
-           
-           // out of directory 
-           *num_read = 0;
-           return NULL;
-       }
-       
-       // advance to the next entry, since that's the first unread one 
-       read_start = fskit_entry_set_next( &read_itr );
-       if( read_start == NULL ) {
-           
-           // out of directory 
-           *num_read = 0;
-           return NULL;
-       }
+       // out of directory
+       *num_read = 0;
+       return NULL;
    }
    
    // UINT64_MAX means 'all children'
@@ -400,16 +286,12 @@ void fskit_seekdir( struct fskit_dir_handle* dirh, off_t loc ) {
         
         if( tent->offset == loc ) {
             
-            fskit_entry_set_itr read_itr;
-            fskit_entry_set* read_start = NULL;
-            
-            fskit_readdir_find_start( dirh, &read_itr, &read_start );
-            
-            if( read_start != NULL ) {
-                
-                // advance directory pointer 
-                strncpy( dirh->curr_name, fskit_entry_set_name_at( read_start ), FSKIT_FILESYSTEM_NAMEMAX );
-            }
+            // resume after the last name read at that point.
+            // the next read seeks there directly, even if that name has since been removed.
+            memset( dirh->curr_name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+            strncpy( dirh->curr_name, tent->name, FSKIT_FILESYSTEM_NAMEMAX );
+            dirh->eof = false;
+            break;
         }
     }
     fskit_dir_handle_unlock( dirh );
@@ -417,6 +299,7 @@ void fskit_seekdir( struct fskit_dir_handle* dirh, off_t loc ) {
 
 
 // telldir(3)--store the current point in the directory stream where we are reading currently, so we can jump to it later.
+// a position that is already stored gets its old offset back, and only the FSKIT_TELLDIR_MAX most recent positions are kept.
 off_t fskit_telldir( struct fskit_dir_handle* dirh ) {
     
     // random place...we just need it to be unique (w.h.p)
@@ -441,6 +324,34 @@ off_t fskit_telldir( struct fskit_dir_handle* dirh ) {
         memset( tent->name, 0, FSKIT_FILESYSTEM_NAMEMAX );
     }
     
+    // already stored?  Find the oldest entry while we're at it.
+    int count = 0;
+    struct fskit_telldir_entry* oldest_prev = NULL;
+    
+    for( struct fskit_telldir_entry* old = dirh->telldir_list; old != NULL; old = old->next ) {
+        
+        if( FSKIT_TELLDIR_ENTRY_CMP( old, tent ) == 0 ) {
+            
+            offset = old->offset;
+            
+            fskit_dir_handle_unlock( dirh );
+            fskit_safe_free( tent );
+            return offset;
+        }
+        
+        count++;
+        if( old->next != NULL && old->next->next == NULL ) {
+            oldest_prev = old;
+        }
+    }
+    
+    if( count >= FSKIT_TELLDIR_MAX && oldest_prev != NULL ) {
+        
+        // forget the oldest position
+        fskit_safe_free( oldest_prev->next );
+        oldest_prev->next = NULL;
+    }
+    
     // insert...
     struct fskit_telldir_entry* tmp = dirh->telldir_list;
     tent->next = tmp;
@@ -451,15 +362,31 @@ off_t fskit_telldir( struct fskit_dir_handle* dirh ) {
 }
 
 
+// free a directory handle's stored positions.
+// dirh must be write-locked, or be going away.
+void fskit_telldir_list_free( struct fskit_dir_handle* dirh ) {
+    
+    struct fskit_telldir_entry* tent = dirh->telldir_list;
+    
+    while( tent != NULL ) {
+        
+        struct fskit_telldir_entry* next = tent->next;
+        fskit_safe_free( tent );
+        tent = next;
+    }
+    
+    dirh->telldir_list = NULL;
+}
+
+
 // make the directory stream point to the beginning
 void fskit_rewinddir( struct fskit_dir_handle* dirh ) {
     
-    fskit_entry_set_itr read_itr;
-    
     fskit_dir_handle_wlock( dirh );
     
-    fskit_entry_set* start = fskit_entry_set_begin( &read_itr, dirh->dent->children );
-    strncpy( dirh->curr_name, fskit_entry_set_name_at( start ), FSKIT_FILESYSTEM_NAMEMAX );
+    // nothing read yet
+    memset( dirh->curr_name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+    dirh->eof = false;
     
     fskit_dir_handle_unlock( dirh );
 } 
@@ -529,10 +456,11 @@ struct fskit_dir_entry** fskit_readdir( struct fskit_core* core, struct fskit_di
 
    int rc = 0;
 
-   rc = fskit_dir_handle_rlock( dirh );
+   // write-lock, since we advance the handle's read position
+   rc = fskit_dir_handle_wlock( dirh );
    if( rc != 0 ) {
       // shouldn't happen--indicates deadlock
-      fskit_error("fskit_dir_handle_rlock(%p) rc = %d\n", dirh, rc );
+      fskit_error("fskit_dir_handle_wlock(%p) rc = %d\n", dirh, rc );
       *err = rc;
       return NULL;
    }
@@ -601,3 +529,246 @@ struct fskit_dir_entry** fskit_readdir( struct fskit_core* core, struct fskit_di
 struct fskit_dir_entry** fskit_listdir( struct fskit_core* core, struct fskit_dir_handle* dirh, uint64_t* num_read, int* err ) {
    return fskit_readdir( core, dirh, UINT64_MAX, num_read, err );
 }
+
+
+// append one packed record to buf at *off.
+// return 0 on success, and advance *off
+// return -ENOSPC if the record does not fit
+static int fskit_readdir_pack( char* buf, size_t buf_len, size_t* off, uint64_t file_id, uint8_t type, char const* name ) {
+
+   size_t namelen = strlen( name );
+   size_t reclen = FSKIT_PACKED_DIRENT_RECLEN( namelen );
+
+   if( *off + reclen > buf_len ) {
+      return -ENOSPC;
+   }
+
+   struct fskit_packed_dirent* d = (struct fskit_packed_dirent*)(buf + *off);
+
+   d->file_id = file_id;
+   d->reclen = (uint16_t)reclen;
+   d->namelen = (uint16_t)namelen;
+   d->type = type;
+
+   // copy the name and zero the tail, so no stale bytes leak out
+   memcpy( d->name, name, namelen );
+   memset( d->name + namelen, 0, reclen - offsetof(struct fskit_packed_dirent, name) - namelen );
+
+   *off += reclen;
+   return 0;
+}
+
+
+// remember the last name returned in a packed stream
+static void fskit_readdir_cookie_set( struct fskit_readdir_cookie* cookie, char const* name ) {
+
+   memset( cookie->name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+   strncpy( cookie->name, name, FSKIT_FILESYSTEM_NAMEMAX );
+}
+
+
+// fill buf directly from the directory's children, with no per-entry allocation.
+// only for directories with no readdir route.
+// dent must be read-locked
+static ssize_t fskit_readdir_packed_direct( struct fskit_entry* dent, struct fskit_readdir_cookie* cookie, char* buf, size_t buf_len ) {
+
+   int rc = 0;
+   size_t off = 0;
+   uint64_t num_packed = 0;
+   char const* last_name = NULL;
+
+   fskit_entry_set_itr itr;
+   fskit_entry_set* entry = NULL;
+
+   for( entry = fskit_entry_set_begin_after( &itr, dent->children, cookie->name ); entry != NULL; entry = fskit_entry_set_next( &itr ) ) {
+
+      struct fskit_entry* fent = fskit_entry_set_child_at( entry );
+      char const* name = fskit_entry_set_name_at( entry );
+
+      // skip NULL children and garbage-collectables (without the child's lock; see fskit_readdir_itr)
+      if( fent == NULL || __atomic_load_n( &fent->deletion_in_progress, __ATOMIC_RELAXED ) || fskit_entry_set_type_at( entry ) == FSKIT_ENTRY_TYPE_DEAD ) {
+         continue;
+      }
+
+      rc = fskit_readdir_pack( buf, buf_len, &off, fskit_entry_set_file_id_at( entry ), fskit_entry_set_type_at( entry ), name );
+      if( rc != 0 ) {
+
+         // buffer is full
+         break;
+      }
+
+      last_name = name;
+      num_packed++;
+   }
+
+   FSKIT_TRACE2( readdir__batch, dent->file_id, num_packed );
+
+   if( off == 0 && entry != NULL ) {
+
+      // buffer can't hold even one record
+      return -EINVAL;
+   }
+
+   if( last_name != NULL ) {
+      fskit_readdir_cookie_set( cookie, last_name );
+   }
+
+   return off;
+}
+
+
+// fill buf from batches of directory entries, filtered by the directory's readdir route.
+// dent must NOT be locked, since the route may call back into fskit.
+static ssize_t fskit_readdir_packed_routed( struct fskit_core* core, struct fskit_dir_handle* dirh, struct fskit_readdir_cookie* cookie, char* buf, size_t buf_len ) {
+
+   int rc = 0;
+   size_t off = 0;
+   uint64_t num_read = 0;
+   uint64_t batch_len = buf_len / FSKIT_PACKED_DIRENT_RECLEN(0);
+   char last_read[FSKIT_FILESYSTEM_NAMEMAX+1];
+
+   fskit_entry_set_itr itr;
+   fskit_entry_set* read_start = NULL;
+   struct fskit_dir_entry** dents = NULL;
+
+   if( batch_len == 0 ) {
+      return -EINVAL;
+   }
+
+   // keep reading batches until we pack something, or run out of entries
+   while( off == 0 ) {
+
+      rc = fskit_entry_rlock( dirh->dent );
+      if( rc != 0 ) {
+
+         // shouldn't happen--indicates deadlock
+         fskit_error("fskit_entry_rlock(%p) rc = %d\n", dirh->dent, rc );
+         return rc;
+      }
+
+      read_start = fskit_entry_set_begin_after( &itr, dirh->dent->children, cookie->name );
+      dents = fskit_readdir_itr( core, dirh->dent, batch_len, &num_read, read_start, &itr, &rc );
+
+      fskit_entry_unlock( dirh->dent );
+
+      if( dents == NULL ) {
+         return rc;
+      }
+
+      if( num_read == 0 ) {
+
+         // EOF
+         fskit_dir_entry_free_list( dents );
+         break;
+      }
+
+      // remember where this batch ends, since the route may omit the last entry
+      memset( last_read, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+      strncpy( last_read, dents[num_read-1]->name, FSKIT_FILESYSTEM_NAMEMAX );
+
+      rc = fskit_run_user_readdir( core, dirh->path, dirh->dent, dents, num_read );
+      if( rc != 0 ) {
+
+         // dents may have holes now
+         for( uint64_t i = 0; i < num_read; i++ ) {
+            fskit_dir_entry_free( dents[i] );
+         }
+         fskit_safe_free( dents );
+         return rc;
+      }
+
+      uint64_t i = 0;
+      for( i = 0; i < num_read; i++ ) {
+
+         if( dents[i] == NULL ) {
+            // omitted
+            continue;
+         }
+
+         rc = fskit_readdir_pack( buf, buf_len, &off, dents[i]->file_id, dents[i]->type, dents[i]->name );
+         if( rc != 0 ) {
+            break;
+         }
+
+         fskit_readdir_cookie_set( cookie, dents[i]->name );
+      }
+
+      if( i == num_read ) {
+
+         // consumed the whole batch, including omitted entries
+         fskit_readdir_cookie_set( cookie, last_read );
+      }
+
+      for( uint64_t j = 0; j < num_read; j++ ) {
+         fskit_dir_entry_free( dents[j] );
+      }
+      fskit_safe_free( dents );
+
+      if( rc != 0 ) {
+
+         if( off == 0 ) {
+            // buffer can't hold even one record
+            return -EINVAL;
+         }
+
+         break;
+      }
+   }
+
+   return off;
+}
+
+
+// read directory entries into a caller-supplied buffer as packed records (see struct fskit_packed_dirent),
+// resuming after the position in *cookie and advancing it.  There is no per-entry allocation unless the
+// directory has a readdir route.
+// Return the number of bytes filled in on success, or 0 at the end of the directory.
+// Return -EINVAL if buf is too small to hold the next record
+// Return -EBADF if the directory handle is invalid
+// Return -ENOMEM if OOM
+// Return -EDEADLK if there would be deadlock (this is a bug if it happens)
+ssize_t fskit_readdir_packed( struct fskit_core* core, struct fskit_dir_handle* dirh, struct fskit_readdir_cookie* cookie, void* buf, size_t buf_len ) {
+
+   int rc = 0;
+   ssize_t ret = 0;
+
+   // read-lock suffices, since the position lives in the cookie
+   rc = fskit_dir_handle_rlock( dirh );
+   if( rc != 0 ) {
+      // shouldn't happen--indicates deadlock
+      fskit_error("fskit_dir_handle_rlock(%p) rc = %d\n", dirh, rc );
+      return rc;
+   }
+
+   // sanity check
+   if( dirh->dent == NULL ) {
+
+      // invalid
+      fskit_dir_handle_unlock( dirh );
+      return -EBADF;
+   }
+
+   if( fskit_route_is_matched( core, FSKIT_ROUTE_MATCH_READDIR, dirh->path ) ) {
+
+      ret = fskit_readdir_packed_routed( core, dirh, cookie, (char*)buf, buf_len );
+   }
+   else {
+
+      rc = fskit_entry_rlock( dirh->dent );
+      if( rc != 0 ) {
+         // shouldn't happen--indicates deadlock
+         fskit_error("fskit_entry_rlock(%p) rc = %d\n", dirh->dent, rc );
+
+         fskit_dir_handle_unlock( dirh );
+         return rc;
+      }
+
+      ret = fskit_readdir_packed_direct( dirh->dent, cookie, (char*)buf, buf_len );
+
+      fskit_entry_unlock( dirh->dent );
+   }
+
+   fskit_dir_handle_unlock( dirh );
+
+   return ret;
+}
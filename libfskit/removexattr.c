@@ -40,7 +40,7 @@ int fskit_run_user_removexattr( struct fskit_core* core, char const* path, struc
 
    if( rc == -EPERM ) {
       // no routes
-      return 0;
+      return 1;
    }
    else if( rc < 0 ) {
       return rc;
@@ -76,17 +76,7 @@ int fskit_removexattr( struct fskit_core* core, char const* path, uint64_t user,
 // return -ENOATTR if the attribute doesn't exist 
 int fskit_xattr_fremovexattr( struct fskit_core* core, struct fskit_entry* fent, char const* name ) {
 
-   bool removed = false;
-   
-   removed = fskit_xattr_set_remove( &fent->xattrs, name );
-   if( removed ) {
-      
-      return 0;
-   }
-   else {
-      
-      return -ENOATTR;
-   }
+   return fskit_entry_xattr_remove( fent, name );
 }
 
 // remove an xattr.
@@ -120,19 +110,7 @@ int fskit_fremovexattr( struct fskit_core* core, char const* path, struct fskit_
 // NOTE: fent must be write-locked
 int fskit_fremovexattr_all( struct fskit_core* core, struct fskit_entry* fent ) {
    
-   fskit_xattr_set* old_xattrs = NULL;
-   fskit_xattr_set* new_xattrs = CALLOC_LIST( fskit_xattr_set, 1 );
-   
-   if( new_xattrs == NULL ) {
-      
-      return -ENOMEM;
-   }
-   
-   old_xattrs = fent->xattrs;
-   fent->xattrs = new_xattrs;
-   
-   fskit_xattr_set_free( old_xattrs );
-   
+   fskit_entry_xattr_clear( fent );
    return 0;
 }
 
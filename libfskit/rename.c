@@ -28,153 +28,68 @@
 #include "fskit_private/private.h"
 
 
-// set of entries 
-struct fskit_inode_set_entry_t {
-   
-   uint64_t file_id;
-   
-   struct fskit_inode_set_entry_t* left;
-   struct fskit_inode_set_entry_t* right;
-   char color;
-};
-
-typedef struct fskit_inode_set_entry_t fskit_inode_set;
-
-#define FSKIT_INODE_SET_CMP( i1, i2 ) ((i1)->file_id < (i2)->file_id ? -1 : (i1)->file_id == (i2)->file_id ? 0 : 1)
+// the directories on the way to a cross-directory rename's parent directory, indexed by depth (root is 0).
+// while the core's rename lock is held, no directory can change parents, so these stay valid.
+struct fskit_rename_path {
 
-SGLIB_DEFINE_RBTREE_PROTOTYPES( fskit_inode_set, left, right, color, FSKIT_INODE_SET_CMP );
-SGLIB_DEFINE_RBTREE_FUNCTIONS( fskit_inode_set, left, right, color, FSKIT_INODE_SET_CMP );
+   struct fskit_entry** ents;
+   int depth;   // number of entries
+   int max;
+};
 
 
-// see if an inode set contains an inode number 
-// return true if so; false if not 
-static bool fskit_inode_set_contains( fskit_inode_set* inode_set, uint64_t file_id ) {
-   
-   fskit_inode_set* member = NULL;
-   fskit_inode_set lookup;
-   memset( &lookup, 0, sizeof(fskit_inode_set) );
-   
-   member = sglib_fskit_inode_set_find_member( inode_set, &lookup );
-   if( member != NULL ) {
-      
-      return true;
-   }
-   else {
-      return false;
-   }
-}
+// callback to record each directory on a path as it gets resolved
+// return 0 on success
+// return -ENOMEM on OOM
+static int fskit_rename_path_cb( struct fskit_entry* fent, void* cls ) {
 
+   struct fskit_rename_path* path = (struct fskit_rename_path*)cls;
 
-// callback to accumulate the set of inodes in a path.
-// return 0 on success 
-// return -EINVAL if a duplicate was detected (i.e. there's a path loop; indicates a bug in fskit)
-// return -ENOMEM on OOM
-static int fskit_entry_resolve_inodes_cb( struct fskit_entry* fent, void* cls ) {
-   
-   int rc = 0;
-   fskit_inode_set** inode_set = (fskit_inode_set**)cls;
-   bool new_inode_set = false;
+   if( path->depth == path->max ) {
 
-   if( *inode_set == NULL ) {
-      // empty 
-      *inode_set = CALLOC_LIST( fskit_inode_set, 1 );
-      if( *inode_set == NULL ) {
+      int max = (path->max > 0 ? path->max * 2 : 16);
+      struct fskit_entry** ents = (struct fskit_entry**)realloc( path->ents, max * sizeof(struct fskit_entry*) );
+      if( ents == NULL ) {
          return -ENOMEM;
       }
 
-      new_inode_set = true;
+      path->ents = ents;
+      path->max = max;
    }
-   
-   fskit_inode_set* new_member = CALLOC_LIST( fskit_inode_set, 1 );
-   if( new_member == NULL ) {
-      return -ENOMEM;
-   }
-   
-   fskit_inode_set* member = NULL;
-   fskit_inode_set lookup;
-   
-   memset( &lookup, 0, sizeof(fskit_inode_set) );
-   
-   lookup.file_id = fent->file_id;
-  
-   if( !new_inode_set ) {
-       member = sglib_fskit_inode_set_find_member( *inode_set, &lookup );
-       if( member != NULL ) {
-      
-          // encountered this file ID before... 
-          fskit_debug("BUG: path loop: found %" PRIu64 " (%p) twice\n", fent->file_id, fent ); 
-          fskit_safe_free( new_member );
-          exit(1);
 
-          return -EINVAL;
-       }
-   }
-   
-   // insert 
-   sglib_fskit_inode_set_add( inode_set, new_member );
+   path->ents[ path->depth ] = fent;
+   path->depth++;
+
    return 0;
 }
 
 
-// free up an inode_set
-static int fskit_inode_set_free( fskit_inode_set* inode_set ) {
-   
-   if( inode_set != NULL ) {
-
-      struct sglib_fskit_inode_set_iterator itr;
-      fskit_inode_set* dp = NULL;
-      fskit_inode_set* old_dp = NULL;
-      
-      for( dp = sglib_fskit_inode_set_it_init_inorder( &itr, inode_set ); dp != NULL; ) {
+// is fent (which is depth levels below the root) on this path?
+// i.e. is it an ancestor of, or the same as, the directory at the end of the path?
+static bool fskit_rename_path_has( struct fskit_rename_path* path, struct fskit_entry* fent, int depth ) {
 
-         old_dp = dp;
-         dp = sglib_fskit_inode_set_it_next( &itr );
-         fskit_safe_free( old_dp );
-      }
-   }
-   
-   return 0;
+   return depth < path->depth && path->ents[depth] == fent;
 }
 
 
-// look up an entry and accumulate the set of inodes, i.e. so the caller can use it to verify that a rename won't introduce a loop.
-// return a pointer to the write-locked entry on success, and sets *ret_inode_set to a malloc(3)'ed set of fskit_inode_set structures
-// return NULL on failure, and set *err to:
-// * -EINVAL if there was a loop 
-// * -ENOMEM on OOM
-// * path_resolution(7) error for things like e.g. permissions and access control
-static struct fskit_entry* fskit_entry_resolve_inodes( struct fskit_core* core, char const* path, uint64_t user, uint64_t group, int* err, fskit_inode_set** ret_inode_set ) {
-   
-   fskit_inode_set* inode_set = NULL;
-   struct fskit_entry* dirent = NULL;
-   
-   dirent = fskit_entry_resolve_path_cls( core, path, user, group, true, err, fskit_entry_resolve_inodes_cb, &inode_set );
-   
-   *ret_inode_set = inode_set;
-   
-   return dirent;
+// can this user modify the given directory?
+static bool fskit_rename_can_modify( struct fskit_entry* dir, uint64_t user, uint64_t group ) {
+
+   return FSKIT_ENTRY_IS_DIR_SEARCHABLE( dir->mode, dir->owner, dir->group, user, group ) && FSKIT_ENTRY_IS_WRITEABLE( dir->mode, dir->owner, dir->group, user, group );
 }
 
 
-// unlock entries
-static int fskit_entry_rename_unlock( struct fskit_entry* fent_common_parent, struct fskit_entry* fent_old_parent, struct fskit_entry* fent_new_parent ) {
-   if( fent_old_parent ) {
-      fskit_entry_unlock( fent_old_parent );
-   }
-   if( fent_new_parent ) {
-      fskit_entry_unlock( fent_new_parent );
-   }
-   if( fent_common_parent ) {
-      fskit_entry_unlock( fent_common_parent );
-   }
+// is this entry still attached?
+static bool fskit_rename_is_live( struct fskit_entry* fent ) {
 
-   return 0;
+   return fent->link_count > 0 && !fent->deletion_in_progress && fent->type != FSKIT_ENTRY_TYPE_DEAD;
 }
 
+
 // user route to rename 
 // unlike all other routes on the system, this one *requres* both entries to be locked (since rename is atomic).
 // old_parent, old_vent, new_parent, and dest will all be write-locked (irrespective of route lock discipline)
-static int fskit_run_user_rename( struct fskit_core* core, char const* path, struct fskit_entry* old_parent, struct fskit_entry* old_fent, char const* new_path, struct fskit_entry* new_parent, struct fskit_entry* dest ) {
+static int fskit_run_user_rename( struct fskit_core* core, char const* path, struct fskit_entry* old_parent, struct fskit_entry* old_fent, char const* new_path, struct fskit_entry* new_parent, struct fskit_entry* dest, unsigned int flags ) {
    
    int rc = 0;
    int cbrc = 0;
@@ -185,7 +100,7 @@ static int fskit_run_user_rename( struct fskit_core* core, char const* path, str
    memset( name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
    fskit_basename( path, name );
    
-   fskit_route_rename_args( &dargs, old_parent, name, new_path, new_parent, dest );
+   fskit_route_rename_args( &dargs, old_parent, name, new_path, new_parent, dest, flags );
    
    rc = fskit_route_call_rename( core, path, old_fent, &dargs, &cbrc );
    
@@ -219,145 +134,104 @@ int fskit_entry_rename_in_directory( struct fskit_entry* fent_parent, struct fsk
 }
 
 
-// rename the inode at old_path to the one at new_path. This is an atomic operation.
-// return 0 on success
-// return negative on failure to resolve either old_path or new_path (see path_resolution(7))
-int fskit_rename( struct fskit_core* core, char const* old_path, char const* new_path, uint64_t user, uint64_t group ) {
-
-   int err_old = 0, err_new = 0, err = 0;
-
-   struct fskit_entry* fent_old_parent = NULL;
-   struct fskit_entry* fent_new_parent = NULL;
-   struct fskit_entry* fent_common_parent = NULL;
-   fskit_inode_set* new_path_inodes = NULL;
-
-   if( fskit_basename_len(old_path) > FSKIT_FILESYSTEM_NAMEMAX ) {
-      return -ENAMETOOLONG;
-   }
+// swap the entries at old_name in old_parent and new_name in new_parent.
+// this is O(1), no matter how big either entry is: only the two directory slots (and moved directories' ..) change.
+// NOTE: all four entries must be write-locked
+static void fskit_rename_exchange_lowlevel( struct fskit_entry* old_parent, char const* old_name, struct fskit_entry* fent_old,
+                                            struct fskit_entry* new_parent, char const* new_name, struct fskit_entry* fent_new ) {
 
-   if( fskit_basename_len(new_path) > FSKIT_FILESYSTEM_NAMEMAX ) {
-      return -ENAMETOOLONG;
-   }
-
-   // identify the parents of old_path and new_path
-   char* old_path_dirname = fskit_dirname( old_path, NULL );
-   char* new_path_dirname = fskit_dirname( new_path, NULL );
-   
-   if( old_path_dirname == NULL || new_path_dirname == NULL ) {
-      
-      fskit_safe_free( old_path_dirname );
-      fskit_safe_free( new_path_dirname );
-      return -ENOMEM;
-   }
+   struct timespec ts;
 
-   // resolve the parent *lower* in the FS hierarchy first.  order matters due to locking!
-   if( fskit_depth( old_path ) > fskit_depth( new_path ) ) {
+   fskit_entry_set_replace( old_parent->children, old_name, fent_new );
+   fskit_entry_set_replace( new_parent->children, new_name, fent_old );
 
-      fent_old_parent = fskit_entry_resolve_path( core, old_path_dirname, user, group, true, &err_old );
-      if( fent_old_parent != NULL ) {
+   if( old_parent != new_parent ) {
 
-         fent_new_parent = fskit_entry_resolve_inodes( core, new_path_dirname, user, group, &err_new, &new_path_inodes );
+      // moved directories point to their new parents
+      if( fent_old->type == FSKIT_ENTRY_TYPE_DIR ) {
+         fskit_entry_set_replace( fent_old->children, "..", new_parent );
       }
-   }
-   else if( fskit_depth( old_path ) < fskit_depth( new_path ) ) {
 
-      fent_new_parent = fskit_entry_resolve_inodes( core, new_path_dirname, user, group, &err_new, &new_path_inodes );
-      fent_old_parent = fskit_entry_resolve_path( core, old_path_dirname, user, group, true, &err_old );
-   }
-   else {
-      // do these paths have the same parent?
-      if( strcmp( old_path_dirname, new_path_dirname ) == 0 ) {
-         
-         // only resolve one path
-         fent_common_parent = fskit_entry_resolve_path( core, old_path_dirname, user, group, true, &err_old );
-      }
-      else {
-         
-         // parents are different; safe to lock both
-         fent_new_parent = fskit_entry_resolve_inodes( core, new_path_dirname, user, group, &err_new, &new_path_inodes );
-         fent_old_parent = fskit_entry_resolve_path( core, old_path_dirname, user, group, true, &err_old );
+      if( fent_new->type == FSKIT_ENTRY_TYPE_DIR ) {
+         fskit_entry_set_replace( fent_new->children, "..", old_parent );
       }
    }
 
-   fskit_safe_free( old_path_dirname );
-   fskit_safe_free( new_path_dirname );
+   clock_gettime( CLOCK_REALTIME, &ts );
 
-   if( err_new ) {
-      
-      fskit_entry_rename_unlock( fent_common_parent, fent_old_parent, fent_new_parent );
-      
-      if( new_path_inodes != NULL ) {
-         fskit_inode_set_free( new_path_inodes );
-      }
-      
-      return err_new;
-   }
+   old_parent->mtime_sec = ts.tv_sec;
+   old_parent->mtime_nsec = ts.tv_nsec;
 
-   if( err_old ) {
-      
-      fskit_entry_rename_unlock( fent_common_parent, fent_old_parent, fent_new_parent );
-      
-      if( new_path_inodes != NULL ) {
-         fskit_inode_set_free( new_path_inodes );
-      }
-      
-      return err_old;
-   }
+   new_parent->mtime_sec = ts.tv_sec;
+   new_parent->mtime_nsec = ts.tv_nsec;
+}
 
-   // check permission errors...
-   if( (fent_new_parent != NULL && (!FSKIT_ENTRY_IS_DIR_SEARCHABLE( fent_new_parent->mode, fent_new_parent->owner, fent_new_parent->group, user, group ) ||
-                                    !FSKIT_ENTRY_IS_WRITEABLE( fent_new_parent->mode, fent_new_parent->owner, fent_new_parent->group, user, group ))) ||
 
-       (fent_old_parent != NULL && (!FSKIT_ENTRY_IS_DIR_SEARCHABLE( fent_old_parent->mode, fent_old_parent->owner, fent_old_parent->group, user, group )
-                                 || !FSKIT_ENTRY_IS_WRITEABLE( fent_old_parent->mode, fent_old_parent->owner, fent_old_parent->group, user, group ))) ||
+// rename old_name in old_parent to new_name in new_parent (which may be the same directory), replacing whatever was there.
+// with FSKIT_RENAME_EXCHANGE, swap them instead; with FSKIT_RENAME_NOREPLACE, don't replace anything.
+// if this is a cross-directory rename, old_dirs and new_dirs are the directories on the way to each parent, so we can check for loops.
+// return 0 on success
+// return -ENOTDIR if either parent is not a directory
+// return -EACCES if the user can't modify either directory
+// return -ENOENT if old_name doesn't exist (or new_name doesn't, for FSKIT_RENAME_EXCHANGE)
+// return -EEXIST if new_name exists and FSKIT_RENAME_NOREPLACE is given
+// return -EISDIR, -ENOTDIR, -ENOTEMPTY if the destination can't be replaced
+// return -EINVAL if a directory would be moved beneath itself
+// return the user route's error if it fails
+// NOTE: old_parent and new_parent must be write-locked, and remain so
+static int fskit_rename_locked( struct fskit_core* core, char const* old_path, struct fskit_entry* old_parent, char const* old_name,
+                                char const* new_path, struct fskit_entry* new_parent, char const* new_name,
+                                uint64_t user, uint64_t group, unsigned int flags, struct fskit_rename_path* old_dirs, struct fskit_rename_path* new_dirs ) {
+
+   int err = 0;
+   struct fskit_entry* fent_old = NULL;
+   struct fskit_entry* fent_new = NULL;
 
-       (fent_common_parent != NULL && (!FSKIT_ENTRY_IS_DIR_SEARCHABLE( fent_common_parent->mode, fent_common_parent->owner, fent_common_parent->group, user, group )
-                                    || !FSKIT_ENTRY_IS_WRITEABLE( fent_common_parent->mode, fent_common_parent->owner, fent_common_parent->group, user, group ))) ) {
+   // both parents must be directories
+   if( old_parent->type != FSKIT_ENTRY_TYPE_DIR || new_parent->type != FSKIT_ENTRY_TYPE_DIR ) {
+      return -ENOTDIR;
+   }
 
-      fskit_entry_rename_unlock( fent_common_parent, fent_old_parent, fent_new_parent );
-      
-      if( new_path_inodes != NULL ) {
-         fskit_inode_set_free( new_path_inodes );
-      }
-      
+   // check permission errors...
+   if( !fskit_rename_can_modify( old_parent, user, group ) || !fskit_rename_can_modify( new_parent, user, group ) ) {
       return -EACCES;
    }
 
    // now, look up the children
-   char* new_path_basename = fskit_basename( new_path, NULL );
-   char* old_path_basename = fskit_basename( old_path, NULL );
+   fent_old = fskit_entry_set_find_name( old_parent->children, old_name );
+   fent_new = fskit_entry_set_find_name( new_parent->children, new_name );
 
-   struct fskit_entry* fent_old = NULL;
-   struct fskit_entry* fent_new = NULL;
-
-   if( fent_common_parent != NULL ) {
-      fent_new = fskit_entry_set_find_name( fent_common_parent->children, new_path_basename );
-      fent_old = fskit_entry_set_find_name( fent_common_parent->children, old_path_basename );
+   // old must exist...
+   if( fent_old == NULL ) {
+      return -ENOENT;
    }
-   else {
-      fent_new = fskit_entry_set_find_name( fent_new_parent->children, new_path_basename );
-      fent_old = fskit_entry_set_find_name( fent_old_parent->children, old_path_basename );
+
+   // ...and new must exist if we're swapping, and must not if we're told not to replace it
+   if( (flags & FSKIT_RENAME_EXCHANGE) && fent_new == NULL ) {
+      return -ENOENT;
    }
 
-   // old must exist...
-   err = 0;
-   if( fent_old == NULL ) {
-      err = -ENOENT;
+   if( (flags & FSKIT_RENAME_NOREPLACE) && fent_new != NULL ) {
+      return -EEXIST;
    }
 
    // if we rename a file into itself, then it's okay (i.e. we're done)
-   if( err != 0 || fent_old == fent_new ) {
-      
-      fskit_entry_rename_unlock( fent_common_parent, fent_old_parent, fent_new_parent );
-      
-      fskit_safe_free( new_path_basename );
-      fskit_safe_free( old_path_basename );
-      
-      if( new_path_inodes != NULL ) {
-         fskit_inode_set_free( new_path_inodes );
+   if( fent_old == fent_new ) {
+      return 0;
+   }
+
+   if( old_dirs != NULL && new_dirs != NULL ) {
+
+      // can't move a directory beneath itself
+      if( fent_old->type == FSKIT_ENTRY_TYPE_DIR && fskit_rename_path_has( new_dirs, fent_old, old_dirs->depth ) ) {
+         return -EINVAL;
+      }
+
+      // can't replace one of the source's ancestors (it's not empty), or swap it beneath itself.
+      // don't even lock it: it's above old_parent.
+      if( fent_new != NULL && fskit_rename_path_has( old_dirs, fent_new, new_dirs->depth ) ) {
+         return (flags & FSKIT_RENAME_EXCHANGE) ? -EINVAL : -ENOTEMPTY;
       }
-      
-      return err;
    }
 
    // lock the children, so we can check for EISDIR and ENOTDIR
@@ -366,7 +240,14 @@ int fskit_rename( struct fskit_core* core, char const* old_path, char const* new
       fskit_entry_wlock( fent_new );
    }
 
-   if( fent_new ) {
+   if( fent_new != NULL && (flags & FSKIT_RENAME_EXCHANGE) == 0 && fent_new->type == FSKIT_ENTRY_TYPE_DIR ) {
+
+      // fill it in if it is a copy-on-write clone (so we see its children), and fill in its clones before it goes
+      err = fskit_cow_fixup( core, fent_new, true );
+   }
+
+   if( err == 0 && fent_new != NULL && (flags & FSKIT_RENAME_EXCHANGE) == 0 ) {
+
       // don't proceed if one is a directory and the other is not
       if( fent_new->type != fent_old->type ) {
          if( fent_new->type == FSKIT_ENTRY_TYPE_DIR ) {
@@ -376,147 +257,263 @@ int fskit_rename( struct fskit_core* core, char const* old_path, char const* new
             err = -ENOTDIR;
          }
       }
-      if( fent_new->type == FSKIT_ENTRY_TYPE_DIR ) {
-         // must be empty 
-         if( fent_new->num_children > 0 ) {
-            err = -ENOTEMPTY;
-         }
+      else if( fent_new->type == FSKIT_ENTRY_TYPE_DIR && fent_new->num_children > 0 ) {
+         // must be empty
+         err = -ENOTEMPTY;
       }
    }
-   
-   if( err == 0 && fent_new != NULL ) {
-      
-      // verify no loops 
-      if( new_path_inodes != NULL && fskit_inode_set_contains( new_path_inodes, fent_new->file_id ) ) {
-         
-         // this rename would introduce a loop
-         err = -EINVAL;
-      }
-   }
-   
-   if( err != 0 ) {
-
-      // directory mismatch, or loop 
-      fskit_entry_rename_unlock( fent_common_parent, fent_old_parent, fent_new_parent );
-      
-      fskit_entry_unlock(fent_old);
-      if( fent_new ) {
-         fskit_entry_unlock( fent_new );
-      }
 
-      fskit_safe_free( new_path_basename );
-      fskit_safe_free( old_path_basename );
-      
-      if( new_path_inodes != NULL ) {
-         fskit_inode_set_free( new_path_inodes );
-      }
+   if( err == 0 ) {
 
-      return err;
+      // user rename...
+      // note that by construction, the consistency discipline will *not* be FSKIT_INODE_SEQUENTIAL.
+      // this means it's safe to lock these entries.
+      err = fskit_run_user_rename( core, old_path, old_parent, fent_old, new_path, new_parent, fent_new, flags );
    }
-   
-   if( new_path_inodes != NULL ) {
-      fskit_inode_set_free( new_path_inodes );
-      new_path_inodes = NULL;
-   }
-   
-   // user rename...
-   // note that by construction, the consistency discipline will *not* be FSKIT_INODE_SEQUENTIAL.
-   // this means it's safe to lock these entries.
-   if( fent_common_parent != NULL ) {
-      
-      err = fskit_run_user_rename( core, old_path, fent_common_parent, fent_old, new_path, fent_common_parent, fent_new );
-   }
-   else {
-      
-      err = fskit_run_user_rename( core, old_path, fent_old_parent, fent_old, new_path, fent_new_parent, fent_new );
-   }
-   
+
    if( err != 0 ) {
-     
-      if( err != -ENOENT ) { 
-          fskit_entry_unlock( fent_old );
-      }
 
+      // directory mismatch, or user rename failure
+      fskit_entry_unlock( fent_old );
       if( fent_new != NULL ) {
          fskit_entry_unlock( fent_new );
       }
-      
-      // user rename failure 
-      fskit_entry_rename_unlock( fent_common_parent, fent_old_parent, fent_new_parent );
-      fskit_safe_free( new_path_basename );
-      fskit_safe_free( old_path_basename );
-      
+
       return err;
    }
 
-   // perform the rename!
-   struct fskit_entry* dest_parent = NULL;
-   err = 0;
+   if( flags & FSKIT_RENAME_EXCHANGE ) {
 
-   if( fent_common_parent != NULL ) {
+      // just trade places; nothing gets linked or unlinked
+      fskit_rename_exchange_lowlevel( old_parent, old_name, fent_old, new_parent, new_name, fent_new );
 
-      // dealing with entries in the same directory
-      dest_parent = fent_common_parent;
-      
-      fskit_entry_detach_lowlevel( fent_common_parent, old_path_basename );
-      
-      // rename this fskit_entry
-      if( fent_new != NULL ) {
-         fskit_entry_detach_lowlevel( fent_common_parent, new_path_basename );
-      }
+      fskit_entry_unlock( fent_old );
+      fskit_entry_unlock( fent_new );
 
-      fskit_entry_attach_lowlevel( fent_common_parent, fent_old, new_path_basename );
+      return 0;
    }
-   else {
 
-      // dealing with entries in different directories
-      dest_parent = fent_new_parent;
+   // perform the rename!
+   fskit_entry_detach_lowlevel_move( old_parent, old_name );
 
-      fskit_entry_detach_lowlevel( fent_old_parent, old_path_basename );
+   if( fent_new != NULL ) {
+      fskit_entry_detach_lowlevel( new_parent, new_name );
+   }
 
-      // rename this fskit_entry
-      if( fent_new != NULL ) {
-         fskit_entry_detach_lowlevel( fent_new_parent, new_path_basename );
-      }
+   fskit_entry_attach_lowlevel( new_parent, fent_old, new_name );
 
-      fskit_entry_attach_lowlevel( fent_new_parent, fent_old, new_path_basename );
-   }
-   
    fskit_entry_unlock( fent_old );
-     
-   fskit_safe_free( old_path_basename );
-   fskit_safe_free( new_path_basename );
-   
-   if( fent_new != NULL && err == 0 ) {
+
+   if( fent_new != NULL ) {
 
       fent_new->deletion_through_rename = true;
 
-      if( fent_common_parent != NULL ) {
-         err = fskit_entry_try_destroy_and_free( core, new_path, fent_common_parent, fent_new );
-      }
-      else {
-         err = fskit_entry_try_destroy_and_free( core, new_path, fent_new_parent, fent_new );
-      }
-      
+      err = fskit_entry_try_destroy_and_free( core, new_path, new_parent, fent_new );
       if( err == 0 ) {
-         
+
          // not destroyed
-         fent_new->deletion_through_rename = false; 
+         fent_new->deletion_through_rename = false;
          fskit_entry_unlock( fent_new );
       }
-      else {
+      else if( err > 0 ) {
          // destroyed
          err = 0;
       }
    }
+
+   return err;
+}
+
+
+// drop the reference a cross-directory rename holds on a parent directory, and unlock it.
+// if the directory got removed in the meantime, this destroys it.
+// NOTE: parent must be write-locked
+static void fskit_rename_release_parent( struct fskit_core* core, char const* dir_path, struct fskit_entry* parent ) {
+
+   int rc = 0;
+
+   parent->open_count--;
+
+   if( parent->open_count <= 0 && parent->link_count <= 0 ) {
+
+      rc = fskit_entry_try_destroy_and_free( core, dir_path, NULL, parent );
+      if( rc > 0 ) {
+         // destroyed and freed
+         return;
+      }
+
+      if( rc < 0 ) {
+         fskit_error("fskit_entry_try_destroy_and_free('%s') rc = %d\n", dir_path, rc );
+      }
+   }
+
+   fskit_entry_unlock( parent );
+}
+
+
+// rename between two different directories.
+// only one cross-directory rename runs at a time, so no directory changes parents while we look at the two paths.
+// each parent gets resolved on its own (holding no other locks), and then both get locked ancestor-first.
+// return 0 on success
+// return negative on error (see fskit_rename_locked and path_resolution(7))
+static int fskit_rename_cross_dir( struct fskit_core* core, char const* old_path, char const* old_dirname, char const* old_name,
+                                   char const* new_path, char const* new_dirname, char const* new_name, uint64_t user, uint64_t group, unsigned int flags ) {
+
+   int err = 0;
+   struct fskit_entry* old_parent = NULL;
+   struct fskit_entry* new_parent = NULL;
+   struct fskit_rename_path old_dirs;
+   struct fskit_rename_path new_dirs;
+
+   memset( &old_dirs, 0, sizeof(struct fskit_rename_path) );
+   memset( &new_dirs, 0, sizeof(struct fskit_rename_path) );
+
+   pthread_mutex_lock( &core->rename_lock );
+
+   old_parent = fskit_entry_resolve_path_cls( core, old_dirname, user, group, true, &err, fskit_rename_path_cb, &old_dirs );
+   if( old_parent == NULL ) {
+      goto fskit_rename_cross_dir_out;
+   }
+
+   // keep it around while we go find the other one
+   fskit_entry_ref_entry( old_parent );
+   fskit_entry_unlock( old_parent );
+
+   new_parent = fskit_entry_resolve_path_cls( core, new_dirname, user, group, true, &err, fskit_rename_path_cb, &new_dirs );
+   if( new_parent == NULL ) {
+
+      fskit_entry_wlock( old_parent );
+      fskit_rename_release_parent( core, old_dirname, old_parent );
+      goto fskit_rename_cross_dir_out;
+   }
+
+   if( new_parent == old_parent ) {
+
+      // different paths to the same directory
+      err = fskit_rename_locked( core, old_path, old_parent, old_name, new_path, old_parent, new_name, user, group, flags, NULL, NULL );
+      fskit_rename_release_parent( core, old_dirname, old_parent );
+
+      goto fskit_rename_cross_dir_out;
+   }
+
+   fskit_entry_ref_entry( new_parent );
+
+   // lock the ancestor first, if one is the other's ancestor.  Otherwise, the order doesn't matter--no other
+   // cross-directory rename can be holding either one, and everyone else locks from the root down.
+   // either one may have been cloned while we weren't holding it, so fill in its clones (see snapshot.c) before
+   // we change it.  This may briefly release the one being filled in, so only do so while holding its ancestors.
+   if( fskit_rename_path_has( &new_dirs, old_parent, old_dirs.depth - 1 ) ) {
+
+      fskit_entry_unlock( new_parent );
+
+      fskit_entry_wlock( old_parent );
+      err = fskit_cow_fixup( core, old_parent, true );
+
+      fskit_entry_wlock( new_parent );
+      if( err == 0 ) {
+         err = fskit_cow_fixup( core, new_parent, true );
+      }
+   }
+   else {
+
+      fskit_entry_wlock( old_parent );
+      err = fskit_cow_fixup( core, old_parent, true );
+   }
+
+   // either one may have been removed while we weren't holding it
+   if( err == 0 && (!fskit_rename_is_live( old_parent ) || !fskit_rename_is_live( new_parent )) ) {
+      err = -ENOENT;
+   }
+
+   if( err == 0 ) {
+      err = fskit_rename_locked( core, old_path, old_parent, old_name, new_path, new_parent, new_name, user, group, flags, &old_dirs, &new_dirs );
+   }
+
+   fskit_rename_release_parent( core, new_dirname, new_parent );
+   fskit_rename_release_parent( core, old_dirname, old_parent );
+
+fskit_rename_cross_dir_out:
+
+   pthread_mutex_unlock( &core->rename_lock );
+
+   fskit_safe_free( old_dirs.ents );
+   fskit_safe_free( new_dirs.ents );
+
+   return err;
+}
+
+
+// rename the inode at old_path to the one at new_path. This is an atomic operation.
+// return 0 on success
+// return negative on failure to resolve either old_path or new_path (see path_resolution(7))
+int fskit_rename( struct fskit_core* core, char const* old_path, char const* new_path, uint64_t user, uint64_t group ) {
+   return fskit_rename2( core, old_path, new_path, user, group, 0 );
+}
+
+
+// rename the inode at old_path to the one at new_path, like renameat2(2).  This is an atomic operation.
+// flags can be FSKIT_RENAME_NOREPLACE, or FSKIT_RENAME_EXCHANGE to swap the two (e.g. to switch a freshly-built directory into place).
+// renames within one directory lock only that directory.
+// return 0 on success
+// return -EINVAL if the flags are invalid
+// return negative on failure to resolve either old_path or new_path (see path_resolution(7))
+int fskit_rename2( struct fskit_core* core, char const* old_path, char const* new_path, uint64_t user, uint64_t group, unsigned int flags ) {
+
+   int err = 0;
+   char old_name[ FSKIT_FILESYSTEM_NAMEMAX+1 ];
+   char new_name[ FSKIT_FILESYSTEM_NAMEMAX+1 ];
+   struct fskit_entry* parent = NULL;
+
+   if( fskit_basename_len(old_path) > FSKIT_FILESYSTEM_NAMEMAX ) {
+      return -ENAMETOOLONG;
+   }
+
+   if( fskit_basename_len(new_path) > FSKIT_FILESYSTEM_NAMEMAX ) {
+      return -ENAMETOOLONG;
+   }
+
+   if( (flags & ~(FSKIT_RENAME_NOREPLACE | FSKIT_RENAME_EXCHANGE)) != 0 ) {
+      return -EINVAL;
+   }
+
+   if( (flags & FSKIT_RENAME_NOREPLACE) && (flags & FSKIT_RENAME_EXCHANGE) ) {
+      return -EINVAL;
+   }
+
+   memset( old_name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+   memset( new_name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+
+   fskit_basename( old_path, old_name );
+   fskit_basename( new_path, new_name );
+
+   // identify the parents of old_path and new_path
+   char* old_path_dirname = fskit_dirname( old_path, NULL );
+   char* new_path_dirname = fskit_dirname( new_path, NULL );
    
-   // unlock everything
-   fskit_entry_rename_unlock( fent_common_parent, fent_old_parent, fent_new_parent );
-   
-   if( err != 0 ) {
-      // NOTE: passed into fent_old on success, so we need to consider the error code
-      fskit_safe_free( new_path_basename );
+   if( old_path_dirname == NULL || new_path_dirname == NULL ) {
+      
+      fskit_safe_free( old_path_dirname );
+      fskit_safe_free( new_path_dirname );
+      return -ENOMEM;
    }
 
+   if( strcmp( old_path_dirname, new_path_dirname ) == 0 ) {
+
+      // same parent: no loops are possible, and only one directory needs locking
+      parent = fskit_entry_resolve_path( core, old_path_dirname, user, group, true, &err );
+      if( parent != NULL ) {
+
+         err = fskit_rename_locked( core, old_path, parent, old_name, new_path, parent, new_name, user, group, flags, NULL, NULL );
+         fskit_entry_unlock( parent );
+      }
+   }
+   else {
+
+      err = fskit_rename_cross_dir( core, old_path, old_path_dirname, old_name, new_path, new_path_dirname, new_name, user, group, flags );
+   }
+
+   fskit_safe_free( old_path_dirname );
+   fskit_safe_free( new_path_dirname );
+
    return err;
 }
@@ -28,11 +28,14 @@
 #ifdef _FSKIT_REPL
 
 #include <fskit/fskit.h>
+#include <fskit/repl.h>
 #include <fskit/util.h>
 #include "fskit_private/private.h"
 
 #define FSKIT_REPL_ARGC_MAX 10 
-#define FSKIT_REPL_FILE_HANDLE_MAX 1024
+
+// initial size of the descriptor tables; they double as needed
+#define FSKIT_REPL_FILE_HANDLE_INIT 16
 
 // REPL statement
 struct fskit_repl_stmt {
@@ -47,8 +50,12 @@ struct fskit_repl_stmt {
 struct fskit_repl {
 
    struct fskit_core* core;
-   struct fskit_file_handle* filedes[ FSKIT_REPL_FILE_HANDLE_MAX ];
-   struct fskit_dir_handle* dirdes[ FSKIT_REPL_FILE_HANDLE_MAX ];
+
+   struct fskit_file_handle** filedes;
+   int max_filedes;
+
+   struct fskit_dir_handle** dirdes;
+   int max_dirdes;
 };
 
 
@@ -86,7 +93,7 @@ struct fskit_repl* fskit_repl_new( struct fskit_core* core ) {
 void fskit_repl_free( struct fskit_repl* repl ) {
 
    int rc = 0;
-   for( int i = 0; i < FSKIT_REPL_FILE_HANDLE_MAX; i++ ) {
+   for( int i = 0; i < repl->max_filedes; i++ ) {
 
       if( repl->filedes[i] == NULL ) {
          continue;
@@ -102,7 +109,7 @@ void fskit_repl_free( struct fskit_repl* repl ) {
       }
    }
 
-   for( int i = 0; i < FSKIT_REPL_FILE_HANDLE_MAX; i++ ) {
+   for( int i = 0; i < repl->max_dirdes; i++ ) {
 
       if( repl->dirdes[i] == NULL ) {
          continue;
@@ -118,6 +125,8 @@ void fskit_repl_free( struct fskit_repl* repl ) {
       }
    }
 
+   fskit_safe_free( repl->filedes );
+   fskit_safe_free( repl->dirdes );
    fskit_safe_free( repl );
 
    return;
@@ -238,19 +247,52 @@ struct fskit_repl_stmt* fskit_repl_stmt_parse( FILE* input, int* _rc ) {
 }
 
 
+// find a free slot in a descriptor table, doubling it if it's full
+// return the index (>= 0) on success
+// return -ENFILE if the table can't grow
+static int fskit_repl_table_slot( void*** table, int* max ) {
+
+   void** new_table = NULL;
+   int new_max = 0;
+
+   for( int i = 0; i < *max; i++ ) {
+      if( (*table)[i] == NULL ) {
+         return i;
+      }
+   }
+
+   if( *max > INT_MAX / 2 ) {
+      return -ENFILE;
+   }
+
+   new_max = (*max > 0 ? *max * 2 : FSKIT_REPL_FILE_HANDLE_INIT);
+
+   new_table = (void**)realloc( *table, sizeof(void*) * new_max );
+   if( new_table == NULL ) {
+      return -ENFILE;
+   }
+
+   memset( new_table + *max, 0, sizeof(void*) * (new_max - *max) );
+
+   // the first new slot is free
+   *table = new_table;
+   *max = new_max;
+
+   return (new_max > FSKIT_REPL_FILE_HANDLE_INIT ? new_max / 2 : 0);
+}
+
+
 // insert a filedes 
 // return the index (>= 0) on success
 // return -ENFILE if we're out of space
 static int fskit_repl_filedes_insert( struct fskit_repl* repl, struct fskit_file_handle* fh ) {
 
-   for( int i = 0; i < FSKIT_REPL_FILE_HANDLE_MAX; i++ ) {
-      if( repl->filedes[i] == NULL ) {
-         repl->filedes[i] = fh;
-         return i;
-      }
+   int i = fskit_repl_table_slot( (void***)&repl->filedes, &repl->max_filedes );
+   if( i >= 0 ) {
+      repl->filedes[i] = fh;
    }
 
-   return -ENFILE;
+   return i;
 }
 
 
@@ -259,14 +301,12 @@ static int fskit_repl_filedes_insert( struct fskit_repl* repl, struct fskit_file
 // return -ENFILE if we're out of space 
 static int fskit_repl_dirdes_insert( struct fskit_repl* repl, struct fskit_dir_handle* dh ) {
 
-   for( int i = 0; i < FSKIT_REPL_FILE_HANDLE_MAX; i++ ) {
-      if( repl->dirdes[i] == NULL ) {
-         repl->dirdes[i] = dh;
-         return i;
-      }
+   int i = fskit_repl_table_slot( (void***)&repl->dirdes, &repl->max_dirdes );
+   if( i >= 0 ) {
+      repl->dirdes[i] = dh;
    }
 
-   return -ENFILE;
+   return i;
 }
 
 
@@ -276,7 +316,7 @@ static int fskit_repl_dirdes_insert( struct fskit_repl* repl, struct fskit_dir_h
 static int fskit_repl_filedes_close( struct fskit_repl* repl, int fd ) {
 
    int rc = 0;
-   if( fd < 0 || fd >= FSKIT_REPL_FILE_HANDLE_MAX ) {
+   if( fd < 0 || fd >= repl->max_filedes ) {
       return -EBADF;
    }
 
@@ -299,7 +339,7 @@ static int fskit_repl_filedes_close( struct fskit_repl* repl, int fd ) {
 static int fskit_repl_dirdes_close( struct fskit_repl* repl, int dfd ) {
 
    int rc = 0;
-   if( dfd < 0 || dfd >= FSKIT_REPL_FILE_HANDLE_MAX ) {
+   if( dfd < 0 || dfd >= repl->max_dirdes ) {
       return -EBADF;
    }
 
@@ -321,7 +361,7 @@ static int fskit_repl_dirdes_close( struct fskit_repl* repl, int dfd ) {
 // return NULL if not present 
 static struct fskit_file_handle* fskit_repl_filedes_lookup( struct fskit_repl* repl, int fd ) {
    
-   if( fd < 0 || fd >= FSKIT_REPL_FILE_HANDLE_MAX ) {
+   if( fd < 0 || fd >= repl->max_filedes ) {
       return NULL;
    }
 
@@ -334,7 +374,7 @@ static struct fskit_file_handle* fskit_repl_filedes_lookup( struct fskit_repl* r
 // return NULL if not present 
 static struct fskit_dir_handle* fskit_repl_dirdes_lookup( struct fskit_repl* repl, int dfd ) {
 
-   if( dfd < 0 || dfd >= FSKIT_REPL_FILE_HANDLE_MAX ) {
+   if( dfd < 0 || dfd >= repl->max_dirdes ) {
       return NULL;
    }
 
@@ -429,6 +469,8 @@ int fskit_repl_stmt_dispatch( struct fskit_repl* repl, struct fskit_repl_stmt* s
    struct fskit_dir_entry** children = NULL;
    struct fskit_file_handle* fh = NULL;
    struct fskit_dir_handle* dh = NULL;
+   struct fskit_capture_trace trace;
+   struct fskit_repl_replay_stats replay_stats;
    struct fskit_core* core = repl->core;
    
    // sanity check... 
@@ -967,6 +1009,40 @@ int fskit_repl_stmt_dispatch( struct fskit_repl* repl, struct fskit_repl_stmt* s
          goto fskit_repl_stmt_dispatch_out;
       }
    }
+   else if( strcmp(stmt->cmd, "replay") == 0 ) {
+
+      // capture_path num_threads
+      if( stmt->argc != 2 ) {
+         rc = -EINVAL;
+         goto fskit_repl_stmt_dispatch_out;
+      }
+
+      path = stmt->argv[0];
+      rc = fskit_repl_stmt_parse_uint64( stmt->argv[1], &len );
+      if( rc != 0 || len == 0 || len > INT_MAX ) {
+         rc = -EINVAL;
+         goto fskit_repl_stmt_dispatch_out;
+      }
+
+      rc = fskit_capture_trace_load( &trace, path );
+      if( rc != 0 ) {
+         fskit_error("fskit_capture_trace_load('%s') rc = %d\n", path, rc );
+         goto fskit_repl_stmt_dispatch_out;
+      }
+
+      fskit_debug("replay('%s', %" PRIu64 ")\n", path, len );
+      rc = fskit_repl_replay( core, &trace, (int)len, &replay_stats );
+      fskit_debug("replay('%s', %" PRIu64 ") rc = %d\n", path, len, rc );
+
+      fskit_capture_trace_free( &trace );
+
+      if( rc != 0 ) {
+         goto fskit_repl_stmt_dispatch_out;
+      }
+
+      printf("ops=%" PRIu64 ", mismatches=%" PRIu64 ", fences=%" PRIu64 ", skipped=%" PRIu64 ", elapsed_ns=%" PRIu64 ", captured_ns=%" PRIu64 "\n",
+             replay_stats.num_ops, replay_stats.num_mismatches, replay_stats.num_fences, replay_stats.num_skipped, replay_stats.elapsed_ns, replay_stats.captured_ns );
+   }
    else if( strcmp(stmt->cmd, "rmdir") == 0 ) {
 
       // user group path 
@@ -1285,6 +1361,688 @@ fskit_repl_stmt_dispatch_out:
 }
 
 
+// replay plan for one record
+struct fskit_repl_replay_plan {
+
+   uint32_t epoch;              // which epoch it runs in
+   uint32_t slot;               // handle slot, for calls that open or use a handle
+};
+
+// open-addressed map from captured handle IDs to slots, built while planning
+struct fskit_repl_replay_handle {
+
+   uint64_t id;                 // 0 if empty, UINT64_MAX if removed
+   uint64_t key;                // key of the path it was opened with
+   uint32_t slot;
+};
+
+// replay state shared by the workers
+struct fskit_repl_replay_ctx {
+
+   struct fskit_core* core;
+   struct fskit_capture_trace* trace;
+   struct fskit_repl_replay_plan* plan;
+
+   // handles opened by the replay, by slot.  Only the worker that owns a slot's path touches it.
+   void** handles;
+   uint8_t* slot_types;         // FSKIT_ENTRY_TYPE_* of each slot's handle
+   uint32_t num_slots;
+
+   // each worker's records, in trace order
+   uint64_t** worker_recs;
+   uint64_t* worker_num_recs;
+
+   // records that have to run alone, in trace order
+   uint64_t* fences;
+   uint64_t num_fences;
+
+   uint32_t num_epochs;
+   int num_threads;
+
+   pthread_barrier_t barrier;
+
+   // workers wait here until they've all started.  go is 1 to run, or -1 if we couldn't start them all.
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+   int go;
+};
+
+// one replay worker
+struct fskit_repl_replay_worker {
+
+   struct fskit_repl_replay_ctx* ctx;
+   int id;
+
+   char* buf;                   // for reads
+   size_t buf_len;
+   char* zeros;                 // for writes
+   size_t zeros_len;
+
+   uint64_t num_ops;
+   uint64_t num_mismatches;
+};
+
+
+// is this a call that can't be reordered against calls on other paths?
+static bool fskit_repl_replay_is_fence( int op ) {
+   return (op == FSKIT_CAPTURE_OP_MKDIR || op == FSKIT_CAPTURE_OP_RMDIR || op == FSKIT_CAPTURE_OP_RENAME || op == FSKIT_CAPTURE_OP_LINK);
+}
+
+// does this call open a handle?
+static bool fskit_repl_replay_is_open( int op ) {
+   return (op == FSKIT_CAPTURE_OP_OPEN || op == FSKIT_CAPTURE_OP_CREATE || op == FSKIT_CAPTURE_OP_OPENDIR);
+}
+
+// does this call use a handle?
+static bool fskit_repl_replay_uses_handle( int op ) {
+   return (op == FSKIT_CAPTURE_OP_FSTAT || op == FSKIT_CAPTURE_OP_FTRUNC || op == FSKIT_CAPTURE_OP_READ || op == FSKIT_CAPTURE_OP_WRITE ||
+           op == FSKIT_CAPTURE_OP_SYNC || op == FSKIT_CAPTURE_OP_CLOSE || op == FSKIT_CAPTURE_OP_READDIR || op == FSKIT_CAPTURE_OP_CLOSEDIR);
+}
+
+// FNV-1a hash of a path
+static uint64_t fskit_repl_replay_key( char const* path ) {
+
+   uint64_t h = 0xcbf29ce484222325ULL;
+
+   for( ; path != NULL && *path != '\0'; path++ ) {
+      h = (h ^ (unsigned char)*path) * 0x100000001b3ULL;
+   }
+
+   return h;
+}
+
+// find the slot in the handle map for a handle ID, or the first free one on its probe path
+static struct fskit_repl_replay_handle* fskit_repl_replay_handle_find( struct fskit_repl_replay_handle* map, uint64_t max, uint64_t id, bool insert ) {
+
+   struct fskit_repl_replay_handle* free_slot = NULL;
+   uint64_t i = (id >> 4) * 0x9E3779B97F4A7C15ULL;
+
+   for( i &= (max - 1); map[i].id != 0; i = (i + 1) & (max - 1) ) {
+
+      if( map[i].id == id ) {
+         return &map[i];
+      }
+
+      if( map[i].id == UINT64_MAX && free_slot == NULL ) {
+         free_slot = &map[i];
+      }
+   }
+
+   if( !insert ) {
+      return NULL;
+   }
+
+   return (free_slot != NULL ? free_slot : &map[i]);
+}
+
+
+// assign each record to a worker and an epoch.
+// calls on the same path (or on handles opened by that path) go to the same worker, so they stay in order.
+// fences end an epoch: they run alone, once every earlier call has finished.
+// calls on handles that were opened before the capture began are skipped.
+// return 0 on success, and set *num_skipped
+// return -ENOMEM on OOM
+static int fskit_repl_replay_plan( struct fskit_repl_replay_ctx* ctx, uint64_t* num_skipped ) {
+
+   struct fskit_capture_trace* trace = ctx->trace;
+   struct fskit_capture_rec* rec = NULL;
+   struct fskit_repl_replay_handle* map = NULL;
+   struct fskit_repl_replay_handle* h = NULL;
+   uint64_t max_handles = 16;
+   uint64_t num_opens = 0;
+   uint64_t key = 0;
+   uint32_t epoch = 0;
+   bool after_fence = false;
+   int w = 0;
+
+   *num_skipped = 0;
+
+   for( uint64_t i = 0; i < trace->num_recs; i++ ) {
+      if( fskit_repl_replay_is_open( trace->recs[i].op ) ) {
+         num_opens++;
+      }
+   }
+
+   // keep it at most half full
+   while( max_handles < num_opens * 2 ) {
+      max_handles *= 2;
+   }
+
+   map = CALLOC_LIST( struct fskit_repl_replay_handle, max_handles );
+   ctx->plan = CALLOC_LIST( struct fskit_repl_replay_plan, trace->num_recs + 1 );
+   ctx->slot_types = CALLOC_LIST( uint8_t, num_opens + 1 );
+   ctx->fences = CALLOC_LIST( uint64_t, trace->num_recs + 1 );
+   ctx->worker_recs = CALLOC_LIST( uint64_t*, ctx->num_threads );
+   ctx->worker_num_recs = CALLOC_LIST( uint64_t, ctx->num_threads );
+
+   if( map == NULL || ctx->plan == NULL || ctx->slot_types == NULL || ctx->fences == NULL || ctx->worker_recs == NULL || ctx->worker_num_recs == NULL ) {
+
+      fskit_safe_free( map );
+      return -ENOMEM;
+   }
+
+   for( int i = 0; i < ctx->num_threads; i++ ) {
+
+      ctx->worker_recs[i] = CALLOC_LIST( uint64_t, trace->num_recs + 1 );
+      if( ctx->worker_recs[i] == NULL ) {
+
+         fskit_safe_free( map );
+         return -ENOMEM;
+      }
+   }
+
+   for( uint64_t i = 0; i < trace->num_recs; i++ ) {
+
+      rec = &trace->recs[i];
+
+      if( fskit_repl_replay_is_fence( rec->op ) ) {
+
+         ctx->plan[i].epoch = epoch;
+         ctx->fences[ ctx->num_fences ] = i;
+         ctx->num_fences++;
+
+         after_fence = true;
+         continue;
+      }
+
+      if( after_fence ) {
+
+         epoch++;
+         after_fence = false;
+      }
+
+      ctx->plan[i].epoch = epoch;
+
+      if( fskit_repl_replay_uses_handle( rec->op ) ) {
+
+         h = fskit_repl_replay_handle_find( map, max_handles, rec->handle, false );
+         if( h == NULL ) {
+
+            // opened before the capture began
+            (*num_skipped)++;
+            continue;
+         }
+
+         key = h->key;
+         ctx->plan[i].slot = h->slot;
+
+         if( rec->op == FSKIT_CAPTURE_OP_CLOSE || rec->op == FSKIT_CAPTURE_OP_CLOSEDIR ) {
+
+            // the ID can be reused from here on
+            h->id = UINT64_MAX;
+         }
+      }
+      else {
+
+         // a symlink's new path is its second path
+         key = fskit_repl_replay_key( rec->op == FSKIT_CAPTURE_OP_SYMLINK ? rec->path2 : rec->path );
+
+         if( fskit_repl_replay_is_open( rec->op ) ) {
+
+            ctx->plan[i].slot = ctx->num_slots;
+            ctx->slot_types[ ctx->num_slots ] = (rec->op == FSKIT_CAPTURE_OP_OPENDIR ? FSKIT_ENTRY_TYPE_DIR : FSKIT_ENTRY_TYPE_FILE);
+            ctx->num_slots++;
+
+            if( rec->rc == 0 && rec->handle != 0 ) {
+
+               h = fskit_repl_replay_handle_find( map, max_handles, rec->handle, true );
+               h->id = rec->handle;
+               h->key = key;
+               h->slot = ctx->plan[i].slot;
+            }
+         }
+      }
+
+      w = (int)(key % ctx->num_threads);
+
+      ctx->worker_recs[w][ ctx->worker_num_recs[w] ] = i;
+      ctx->worker_num_recs[w]++;
+   }
+
+   ctx->num_epochs = epoch + 1;
+
+   fskit_safe_free( map );
+   return 0;
+}
+
+
+// make sure a worker buffer can hold len bytes.  Zero-filled buffers stay zero-filled.
+// return 0 on success
+// return -ENOMEM on OOM
+static int fskit_repl_replay_buf( char** buf, size_t* buf_len, size_t len, bool zero ) {
+
+   char* new_buf = NULL;
+
+   if( len <= *buf_len ) {
+      return 0;
+   }
+
+   new_buf = (char*)realloc( *buf, len );
+   if( new_buf == NULL ) {
+      return -ENOMEM;
+   }
+
+   if( zero ) {
+      memset( new_buf + *buf_len, 0, len - *buf_len );
+   }
+
+   *buf = new_buf;
+   *buf_len = len;
+
+   return 0;
+}
+
+
+// re-run one captured call
+// return what the call returned
+static int64_t fskit_repl_replay_one( struct fskit_repl_replay_worker* wk, uint64_t i ) {
+
+   struct fskit_repl_replay_ctx* ctx = wk->ctx;
+   struct fskit_core* core = ctx->core;
+   struct fskit_capture_rec* rec = &ctx->trace->recs[i];
+   void** handle = &ctx->handles[ ctx->plan[i].slot ];
+   struct fskit_file_handle* fh = NULL;
+   struct fskit_dir_handle* dh = NULL;
+   struct fskit_dir_entry** dirents = NULL;
+   struct timeval times[2];
+   struct stat sb;
+   struct statvfs svfs;
+   uint64_t num_read = 0;
+   int rc = 0;
+
+   if( fskit_repl_replay_uses_handle( rec->op ) && *handle == NULL ) {
+
+      // the open didn't succeed this time around
+      return -EBADF;
+   }
+
+   switch( rec->op ) {
+
+      case FSKIT_CAPTURE_OP_STAT:
+         return fskit_stat( core, rec->path, rec->user, rec->group, &sb );
+
+      case FSKIT_CAPTURE_OP_FSTAT:
+         if( rec->args[0] == FSKIT_ENTRY_TYPE_DIR ) {
+            dh = (struct fskit_dir_handle*)*handle;
+            return fskit_fstat( core, fskit_dir_handle_get_path( dh ), fskit_dir_handle_get_entry( dh ), &sb );
+         }
+         else {
+            fh = (struct fskit_file_handle*)*handle;
+            return fskit_fstat( core, fskit_file_handle_get_path( fh ), fskit_file_handle_get_entry( fh ), &sb );
+         }
+
+      case FSKIT_CAPTURE_OP_READLINK:
+         rc = fskit_repl_replay_buf( &wk->buf, &wk->buf_len, rec->args[0], false );
+         if( rc != 0 ) {
+            return rc;
+         }
+
+         return fskit_readlink( core, rec->path, rec->user, rec->group, wk->buf, rec->args[0] );
+
+      case FSKIT_CAPTURE_OP_MKNOD:
+         return fskit_mknod( core, rec->path, rec->args[0], rec->args[1], rec->user, rec->group );
+
+      case FSKIT_CAPTURE_OP_MKDIR:
+         return fskit_mkdir( core, rec->path, rec->args[0], rec->user, rec->group );
+
+      case FSKIT_CAPTURE_OP_UNLINK:
+         return fskit_unlink( core, rec->path, rec->user, rec->group );
+
+      case FSKIT_CAPTURE_OP_RMDIR:
+         return fskit_rmdir( core, rec->path, rec->user, rec->group );
+
+      case FSKIT_CAPTURE_OP_SYMLINK:
+         return fskit_symlink( core, rec->path, rec->path2, rec->user, rec->group );
+
+      case FSKIT_CAPTURE_OP_RENAME:
+         return fskit_rename2( core, rec->path, rec->path2, rec->user, rec->group, rec->args[0] );
+
+      case FSKIT_CAPTURE_OP_LINK:
+         return fskit_link( core, rec->path, rec->path2, rec->user, rec->group );
+
+      case FSKIT_CAPTURE_OP_CHMOD:
+         return fskit_chmod( core, rec->path, rec->user, rec->group, rec->args[0] );
+
+      case FSKIT_CAPTURE_OP_CHOWN:
+         return fskit_chown( core, rec->path, rec->user, rec->group, rec->args[0], rec->args[1] );
+
+      case FSKIT_CAPTURE_OP_TRUNC:
+         return fskit_trunc( core, rec->path, rec->user, rec->group, rec->args[0] );
+
+      case FSKIT_CAPTURE_OP_FTRUNC:
+         return fskit_ftrunc( core, (struct fskit_file_handle*)*handle, rec->args[0] );
+
+      case FSKIT_CAPTURE_OP_UTIME:
+         if( rec->args[2] != 0 ) {
+            times[0].tv_sec = rec->args[0] / 1000000;
+            times[0].tv_usec = rec->args[0] % 1000000;
+            times[1].tv_sec = rec->args[1] / 1000000;
+            times[1].tv_usec = rec->args[1] % 1000000;
+         }
+         else {
+            gettimeofday( &times[0], NULL );
+            times[1] = times[0];
+         }
+
+         return fskit_utimes( core, rec->path, rec->user, rec->group, times );
+
+      case FSKIT_CAPTURE_OP_OPEN:
+      case FSKIT_CAPTURE_OP_CREATE:
+         if( rec->op == FSKIT_CAPTURE_OP_OPEN ) {
+            fh = fskit_open( core, rec->path, rec->user, rec->group, rec->args[0], rec->args[1], &rc );
+         }
+         else {
+            fh = fskit_create( core, rec->path, rec->user, rec->group, rec->args[0], &rc );
+         }
+
+         if( rc == 0 && rec->rc != 0 ) {
+
+            // nothing in the capture will use it
+            fskit_close( core, fh );
+         }
+         else if( rc == 0 ) {
+            *handle = fh;
+         }
+
+         return rc;
+
+      case FSKIT_CAPTURE_OP_READ:
+         rc = fskit_repl_replay_buf( &wk->buf, &wk->buf_len, rec->args[0], false );
+         if( rc != 0 ) {
+            return rc;
+         }
+
+         return fskit_read( core, (struct fskit_file_handle*)*handle, wk->buf, rec->args[0], rec->args[1] );
+
+      case FSKIT_CAPTURE_OP_WRITE:
+         rc = fskit_repl_replay_buf( &wk->zeros, &wk->zeros_len, rec->args[0], true );
+         if( rc != 0 ) {
+            return rc;
+         }
+
+         return fskit_write( core, (struct fskit_file_handle*)*handle, wk->zeros, rec->args[0], rec->args[1] );
+
+      case FSKIT_CAPTURE_OP_SYNC:
+         return fskit_fsync( core, (struct fskit_file_handle*)*handle );
+
+      case FSKIT_CAPTURE_OP_CLOSE:
+         rc = fskit_close( core, (struct fskit_file_handle*)*handle );
+         if( rc == 0 ) {
+            *handle = NULL;
+         }
+
+         return rc;
+
+      case FSKIT_CAPTURE_OP_STATVFS:
+         return fskit_statvfs( core, rec->path, rec->user, rec->group, &svfs );
+
+      case FSKIT_CAPTURE_OP_SETXATTR:
+         rc = fskit_repl_replay_buf( &wk->zeros, &wk->zeros_len, rec->args[0] + 1, true );
+         if( rc != 0 ) {
+            return rc;
+         }
+
+         return fskit_setxattr( core, rec->path, rec->user, rec->group, rec->path2, wk->zeros, rec->args[0], rec->args[1] );
+
+      case FSKIT_CAPTURE_OP_GETXATTR:
+      case FSKIT_CAPTURE_OP_LISTXATTR:
+         rc = fskit_repl_replay_buf( &wk->buf, &wk->buf_len, rec->args[0] + 1, false );
+         if( rc != 0 ) {
+            return rc;
+         }
+
+         if( rec->op == FSKIT_CAPTURE_OP_GETXATTR ) {
+            return fskit_getxattr( core, rec->path, rec->user, rec->group, rec->path2, wk->buf, rec->args[0] );
+         }
+         else {
+            return fskit_listxattr( core, rec->path, rec->user, rec->group, wk->buf, rec->args[0] );
+         }
+
+      case FSKIT_CAPTURE_OP_REMOVEXATTR:
+         return fskit_removexattr( core, rec->path, rec->user, rec->group, rec->path2 );
+
+      case FSKIT_CAPTURE_OP_OPENDIR:
+         dh = fskit_opendir( core, rec->path, rec->user, rec->group, &rc );
+
+         if( rc == 0 && rec->rc != 0 ) {
+            fskit_closedir( core, dh );
+         }
+         else if( rc == 0 ) {
+            *handle = dh;
+         }
+
+         return rc;
+
+      case FSKIT_CAPTURE_OP_READDIR:
+         dirents = fskit_listdir( core, (struct fskit_dir_handle*)*handle, &num_read, &rc );
+         if( dirents != NULL ) {
+            fskit_dir_entry_free_list( dirents );
+         }
+
+         return rc;
+
+      case FSKIT_CAPTURE_OP_CLOSEDIR:
+         rc = fskit_closedir( core, (struct fskit_dir_handle*)*handle );
+         if( rc == 0 ) {
+            *handle = NULL;
+         }
+
+         return rc;
+
+      case FSKIT_CAPTURE_OP_ACCESS:
+         return fskit_access( core, rec->path, rec->user, rec->group, rec->args[0] );
+
+      default:
+         return -EINVAL;
+   }
+}
+
+
+// re-run a call, and check that it did what it did when it was captured
+static void fskit_repl_replay_run( struct fskit_repl_replay_worker* wk, uint64_t i ) {
+
+   struct fskit_capture_rec* rec = &wk->ctx->trace->recs[i];
+   int64_t rc = fskit_repl_replay_one( wk, i );
+
+   wk->num_ops++;
+
+   if( rc != rec->rc ) {
+
+      fskit_debug("replay %" PRIu64 ": %s('%s') rc = %" PRId64 ", captured %" PRId64 "\n", i, fskit_capture_op_name( rec->op ), rec->path != NULL ? rec->path : "", rc, rec->rc );
+      wk->num_mismatches++;
+   }
+}
+
+
+// replay worker: run this worker's calls for each epoch, and let worker 0 run the fences between them
+static void* fskit_repl_replay_main( void* arg ) {
+
+   struct fskit_repl_replay_worker* wk = (struct fskit_repl_replay_worker*)arg;
+   struct fskit_repl_replay_ctx* ctx = wk->ctx;
+   uint64_t* recs = ctx->worker_recs[ wk->id ];
+   uint64_t num_recs = ctx->worker_num_recs[ wk->id ];
+   uint64_t r = 0;
+   uint64_t f = 0;
+   int go = 0;
+
+   pthread_mutex_lock( &ctx->lock );
+
+   while( ctx->go == 0 ) {
+      pthread_cond_wait( &ctx->cond, &ctx->lock );
+   }
+
+   go = ctx->go;
+   pthread_mutex_unlock( &ctx->lock );
+
+   if( go < 0 ) {
+      return NULL;
+   }
+
+   for( uint32_t e = 0; e < ctx->num_epochs; e++ ) {
+
+      for( ; r < num_recs && ctx->plan[ recs[r] ].epoch == e; r++ ) {
+         fskit_repl_replay_run( wk, recs[r] );
+      }
+
+      if( f >= ctx->num_fences || ctx->plan[ ctx->fences[f] ].epoch != e ) {
+
+         // last epoch
+         continue;
+      }
+
+      pthread_barrier_wait( &ctx->barrier );
+
+      for( ; f < ctx->num_fences && ctx->plan[ ctx->fences[f] ].epoch == e; f++ ) {
+         if( wk->id == 0 ) {
+            fskit_repl_replay_run( wk, ctx->fences[f] );
+         }
+      }
+
+      pthread_barrier_wait( &ctx->barrier );
+   }
+
+   return NULL;
+}
+
+
+// replay a capture against a core, using num_threads threads.
+// calls on the same path run in the order they were captured; calls on different paths run concurrently,
+// except for mkdir, rmdir, rename, and link, which wait for every earlier call and run alone.
+// return 0 on success, and fill in *stats
+// return -EINVAL if num_threads is not positive
+// return -ENOMEM on OOM
+// return -errno if a thread could not be started
+int fskit_repl_replay( struct fskit_core* core, struct fskit_capture_trace* trace, int num_threads, struct fskit_repl_replay_stats* stats ) {
+
+   struct fskit_repl_replay_ctx ctx;
+   struct fskit_repl_replay_worker* workers = NULL;
+   pthread_t* threads = NULL;
+   struct timespec start, end;
+   uint64_t first_ns = UINT64_MAX;
+   uint64_t last_ns = 0;
+   int num_started = 0;
+   int rc = 0;
+
+   if( num_threads <= 0 ) {
+      return -EINVAL;
+   }
+
+   memset( &ctx, 0, sizeof(ctx) );
+   memset( stats, 0, sizeof(struct fskit_repl_replay_stats) );
+
+   ctx.core = core;
+   ctx.trace = trace;
+   ctx.num_threads = num_threads;
+
+   rc = fskit_repl_replay_plan( &ctx, &stats->num_skipped );
+
+   if( rc == 0 ) {
+
+      ctx.handles = CALLOC_LIST( void*, ctx.num_slots + 1 );
+      workers = CALLOC_LIST( struct fskit_repl_replay_worker, num_threads );
+      threads = CALLOC_LIST( pthread_t, num_threads );
+
+      if( ctx.handles == NULL || workers == NULL || threads == NULL ) {
+         rc = -ENOMEM;
+      }
+   }
+
+   if( rc == 0 ) {
+
+      pthread_barrier_init( &ctx.barrier, NULL, num_threads );
+      pthread_mutex_init( &ctx.lock, NULL );
+      pthread_cond_init( &ctx.cond, NULL );
+
+      for( num_started = 0; num_started < num_threads; num_started++ ) {
+
+         workers[ num_started ].ctx = &ctx;
+         workers[ num_started ].id = num_started;
+
+         rc = pthread_create( &threads[ num_started ], NULL, fskit_repl_replay_main, &workers[ num_started ] );
+         if( rc != 0 ) {
+
+            // can't replay with fewer threads than the barrier expects
+            fskit_error("pthread_create rc = %d\n", rc );
+            rc = -rc;
+            break;
+         }
+      }
+
+      clock_gettime( CLOCK_MONOTONIC, &start );
+
+      pthread_mutex_lock( &ctx.lock );
+      ctx.go = (rc == 0 ? 1 : -1);
+      pthread_cond_broadcast( &ctx.cond );
+      pthread_mutex_unlock( &ctx.lock );
+
+      for( int i = 0; i < num_started; i++ ) {
+         pthread_join( threads[i], NULL );
+      }
+
+      clock_gettime( CLOCK_MONOTONIC, &end );
+
+      pthread_cond_destroy( &ctx.cond );
+      pthread_mutex_destroy( &ctx.lock );
+      pthread_barrier_destroy( &ctx.barrier );
+
+      for( int i = 0; i < num_started; i++ ) {
+
+         stats->num_ops += workers[i].num_ops;
+         stats->num_mismatches += workers[i].num_mismatches;
+
+         fskit_safe_free( workers[i].buf );
+         fskit_safe_free( workers[i].zeros );
+      }
+
+      stats->num_fences = ctx.num_fences;
+      stats->elapsed_ns = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+
+      for( uint64_t i = 0; i < trace->num_recs; i++ ) {
+
+         if( trace->recs[i].start_ns < first_ns ) {
+            first_ns = trace->recs[i].start_ns;
+         }
+
+         if( trace->recs[i].start_ns + trace->recs[i].duration_ns > last_ns ) {
+            last_ns = trace->recs[i].start_ns + trace->recs[i].duration_ns;
+         }
+      }
+
+      stats->captured_ns = (last_ns > first_ns ? last_ns - first_ns : 0);
+
+      // close whatever the capture left open
+      for( uint32_t i = 0; i < ctx.num_slots; i++ ) {
+
+         if( ctx.handles[i] == NULL ) {
+            continue;
+         }
+
+         if( ctx.slot_types[i] == FSKIT_ENTRY_TYPE_DIR ) {
+            fskit_closedir( core, (struct fskit_dir_handle*)ctx.handles[i] );
+         }
+         else {
+            fskit_close( core, (struct fskit_file_handle*)ctx.handles[i] );
+         }
+      }
+   }
+
+   fskit_safe_free( ctx.handles );
+   fskit_safe_free( ctx.slot_types );
+   fskit_safe_free( ctx.plan );
+   fskit_safe_free( ctx.fences );
+
+   for( int i = 0; ctx.worker_recs != NULL && i < num_threads; i++ ) {
+      fskit_safe_free( ctx.worker_recs[i] );
+   }
+
+   fskit_safe_free( ctx.worker_recs );
+   fskit_safe_free( ctx.worker_num_recs );
+   fskit_safe_free( workers );
+   fskit_safe_free( threads );
+
+   return rc;
+}
+
 // main REPL loop
 // reads commands from the given file until EOF,
 // and dispatches them to the given repl.
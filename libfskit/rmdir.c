@@ -105,6 +105,17 @@ int fskit_rmdir( struct fskit_core* core, char const* _path, uint64_t user, uint
       return -ENOTDIR;
    }
 
+   // fill it in if it is a copy-on-write clone, and fill in its clones
+   rc = fskit_cow_fixup( core, dent, true );
+   if( rc != 0 ) {
+
+      fskit_entry_unlock( dent );
+      fskit_entry_unlock( parent );
+      fskit_safe_free( path_basename );
+
+      return rc;
+   }
+
    // IS THE PARENT EMPTY?
    if( fskit_entry_set_count( dent->children ) > 2 ) {
       // nope
@@ -24,6 +24,7 @@
 #include <fskit/util.h>
 
 #include "fskit_private/private.h"
+#include "fskit_private/trace.h"
 
 struct fskit_route_table_row {
 
@@ -153,6 +154,52 @@ int fskit_route_table_free( fskit_route_table* route_table ) {
 }
 
 
+// count the bytes a route table takes: its rows, their route lists, and the routes and their regex strings
+// (but not the compiled regexes, whose size the regex library doesn't tell us).
+// set *num_allocs to the number of allocations counted
+// NOTE: the core's routes must be at least read-locked
+uint64_t fskit_route_table_bytes( fskit_route_table* route_table, uint64_t* num_allocs ) {
+
+   fskit_route_table_itr itr;
+   struct fskit_route_table_row* row = NULL;
+   struct fskit_path_route* route = NULL;
+   uint64_t total = 0;
+   uint64_t allocs = 0;
+
+   for( row = fskit_route_table_begin( &itr, route_table ); row != NULL; row = fskit_route_table_next( &itr ) ) {
+
+      total += sizeof(struct fskit_route_table_row);
+      allocs++;
+
+      if( row->routes.buf != NULL ) {
+
+         total += (1UL << row->routes.exp) * sizeof(fskit_path_route_entry);
+         allocs++;
+      }
+
+      for( unsigned long i = 0; i < fskit_route_table_row_len( row ); i++ ) {
+
+         route = fskit_route_table_row_at_ref( row, i );
+         if( route == NULL ) {
+            continue;
+         }
+
+         total += sizeof(struct fskit_path_route);
+         allocs++;
+
+         if( route->path_regex_str != NULL ) {
+
+            total += strlen( route->path_regex_str ) + 1;
+            allocs++;
+         }
+      }
+   }
+
+   *num_allocs = allocs;
+   return total;
+}
+
+
 // insert a route into the route table.  Puts the pointer only; does not duplicate the route (i.e. the table owns the route now).
 // return a route ID on success (>= 0)
 // return -ENOMEM on OOM
@@ -468,11 +515,16 @@ static int fskit_route_enter( struct fskit_path_route* route, struct fskit_entry
    // enforce the consistency discipline for this route
    // does not apply to setmetadata operation, which *must* be atomic
    if( route->route_type != FSKIT_ROUTE_MATCH_SETMETADATA ) {
-      if( route->consistency_discipline == FSKIT_SEQUENTIAL ) {
-         rc = pthread_rwlock_wrlock( &route->lock );
-      }
-      else if( route->consistency_discipline == FSKIT_CONCURRENT ) {
-         rc = pthread_rwlock_rdlock( &route->lock );
+      if( route->consistency_discipline == FSKIT_SEQUENTIAL || route->consistency_discipline == FSKIT_CONCURRENT ) {
+
+         bool write = (route->consistency_discipline == FSKIT_SEQUENTIAL);
+
+         if( FSKIT_LOCKSTAT_ON() ) {
+            rc = fskit_lockstat_rwlock( &route->lock, write, FSKIT_LOCK_CLASS_ROUTE, __FILE__, __LINE__ );
+         }
+         else {
+            rc = write ? fskit_rwlock_wrlock( &route->lock ) : fskit_rwlock_rdlock( &route->lock );
+         }
       }
       else if( fent != NULL && route->consistency_discipline == FSKIT_INODE_SEQUENTIAL ) {
          rc = fskit_entry_wlock( fent );
@@ -499,7 +551,7 @@ static int fskit_route_leave( struct fskit_path_route* route, struct fskit_entry
           fskit_entry_unlock( fent );
        }
        else if( route->consistency_discipline == FSKIT_SEQUENTIAL || route->consistency_discipline == FSKIT_CONCURRENT ) {
-          pthread_rwlock_unlock( &route->lock );
+          fskit_rwlock_unlock( &route->lock );
        }
    }
 
@@ -520,8 +572,7 @@ static int fskit_route_dispatch( struct fskit_core* core, struct fskit_route_met
    rc = fskit_route_enter( route, fent, dargs );
    if( rc != 0 ) {
       // indicates deadlock
-      rc = -errno;
-      fskit_error("BUG: pthread_rwlock_wrlock(route %s) errno = %d\n", route->path_regex_str, rc );
+      fskit_error("BUG: fskit_route_enter(route %s) rc = %d\n", route->path_regex_str, rc );
       return rc;
    }
 
@@ -666,54 +717,53 @@ static struct fskit_path_route* fskit_route_match( fskit_route_table* route_tabl
       return NULL;
    }
 
-   if(fskit_route_table_row_len( row ) == 1) {
-       // most case, it has FSKIT_ROUTE_ANY
-       route = fskit_route_table_row_at_ref( row, 0 );
-       if( fskit_path_route_is_any( route ) ) {
-           size_t path_len = strlen(path);
-
-           char** argv = CALLOC_LIST( char*, route->num_expected_matches + 1 );
-           if( argv == NULL ) {
-              return NULL;
-           }
-
-           char* path_dup = strdup( path );
-           if( path_dup == NULL ) {
-              FREE_LIST( argv );
-              return NULL;
-           }
-
-           // accumulate matches
-           char* next_match = CALLOC_LIST( char, path_len + 1 );
-           if( next_match == NULL ) {
-             FREE_LIST( argv );
-             fskit_safe_free( argv );
-             return NULL;
-           }
-
-           strncpy( next_match, path, path_len );
-           argv[0] = next_match;
-
-           fskit_route_metadata_init( route_metadata, path_dup, 1, argv );
-           return route;
-       }
-   } else {
-       for( unsigned long i = 0; i < fskit_route_table_row_len( row ); i++ ) {
+   // most common case: a lone FSKIT_ROUTE_ANY, which matches without running the regex
+   route = (fskit_route_table_row_len( row ) == 1 ? fskit_route_table_row_at_ref( row, 0 ) : NULL);
+   if( route != NULL && fskit_path_route_is_any( route ) ) {
 
-          route = fskit_route_table_row_at_ref( row, i );
+      size_t path_len = strlen(path);
 
-          if( !fskit_path_route_is_defined( route ) ) {
-             continue;
-          }
+      char** argv = CALLOC_LIST( char*, route->num_expected_matches + 1 );
+      if( argv == NULL ) {
+         return NULL;
+      }
 
-          // match?
-          rc = fskit_match_regex( route_metadata, route, path );
-          if( rc == 0 ) {
+      char* path_dup = strdup( path );
+      if( path_dup == NULL ) {
+         FREE_LIST( argv );
+         return NULL;
+      }
 
-             // matched!
-             return route;
-          }
-       }
+      // accumulate matches
+      char* next_match = CALLOC_LIST( char, path_len + 1 );
+      if( next_match == NULL ) {
+         FREE_LIST( argv );
+         fskit_safe_free( argv );
+         return NULL;
+      }
+
+      strncpy( next_match, path, path_len );
+      argv[0] = next_match;
+
+      fskit_route_metadata_init( route_metadata, path_dup, 1, argv );
+      return route;
+   }
+
+   for( unsigned long i = 0; i < fskit_route_table_row_len( row ); i++ ) {
+
+      route = fskit_route_table_row_at_ref( row, i );
+
+      if( !fskit_path_route_is_defined( route ) ) {
+         continue;
+      }
+
+      // match?
+      rc = fskit_match_regex( route_metadata, route, path );
+      if( rc == 0 ) {
+
+         // matched!
+         return route;
+      }
    }
 
    // no match
@@ -743,6 +793,7 @@ static int fskit_route_metadata_populate( struct fskit_route_metadata* route_met
    route_metadata->xattr_buf = dargs->xattr_buf;
    route_metadata->xattr_buf_len = dargs->xattr_buf_len;
    route_metadata->renamed = dargs->renamed;
+   route_metadata->rename_flags = dargs->rename_flags;
    return 0;
 }
 
@@ -764,6 +815,8 @@ int fskit_route_call( struct fskit_core* core, int route_type, char const* path,
 
    route = fskit_route_match( core->routes, route_type, path, &route_metadata );
 
+   FSKIT_TRACE3( route__match, path, route_type, (route != NULL ? route->path_regex_str : NULL) );
+
    if( route == NULL ) {
       // no route found
       fskit_core_route_unlock( core );
@@ -784,8 +837,12 @@ int fskit_route_call( struct fskit_core* core, int route_type, char const* path,
    fskit_debug("Call route type %d (%d)\n", route->route_type, route_type );
 
    // dispatch
+   FSKIT_TRACE3( route__dispatch, path, route_type, route->path_regex_str );
+
    *cbrc = fskit_route_dispatch( core, &route_metadata, route, fent, dargs );
 
+   FSKIT_TRACE3( route__done, path, route_type, *cbrc );
+
    fskit_core_route_unlock( core );
 
    rc = fskit_route_metadata_free( &route_metadata );
@@ -793,6 +850,53 @@ int fskit_route_call( struct fskit_core* core, int route_type, char const* path,
 }
 
 
+// is there a route of the given type for this path?
+// this only matches; no callback is run.
+bool fskit_route_is_matched( struct fskit_core* core, int route_type, char const* path ) {
+
+   struct fskit_route_metadata route_metadata;
+   struct fskit_path_route* route = NULL;
+
+   memset( &route_metadata, 0, sizeof(struct fskit_route_metadata) );
+
+   fskit_core_route_rlock( core );
+
+   route = fskit_route_match( core->routes, route_type, path, &route_metadata );
+
+   fskit_core_route_unlock( core );
+
+   fskit_route_metadata_free( &route_metadata );
+
+   return (route != NULL);
+}
+
+
+// is there any route of the given type, for any path?
+bool fskit_route_is_defined( struct fskit_core* core, int route_type ) {
+
+   bool ret = false;
+   struct fskit_route_table_row* row = NULL;
+
+   fskit_core_route_rlock( core );
+
+   row = fskit_route_table_get_row( core->routes, route_type );
+   if( row != NULL ) {
+
+      for( unsigned long i = 0; i < fskit_route_table_row_len( row ); i++ ) {
+
+         if( fskit_path_route_is_defined( fskit_route_table_row_at_ref( row, i ) ) ) {
+            ret = true;
+            break;
+         }
+      }
+   }
+
+   fskit_core_route_unlock( core );
+
+   return ret;
+}
+
+
 // call the route to create a file.  The requisite inode_data and handle_data will be set in dargs on success.
 // return 0 if a route was called, or -EPERM if there are no routes.
 // set the route callback return code in *cbrc
@@ -999,7 +1103,7 @@ static int fskit_path_route_init( struct fskit_path_route* route, char const* re
    route->route_type = route_type;
    route->method = method;
 
-   pthread_rwlock_init( &route->lock, NULL );
+   fskit_rwlock_init( &route->lock );
 
    return 0;
 }
@@ -1014,7 +1118,7 @@ int fskit_path_route_free( struct fskit_path_route* route ) {
       // NOTE: the regex is only set if the string is set
       regfree( &route->path_regex );
 
-      pthread_rwlock_destroy( &route->lock );
+      fskit_rwlock_destroy( &route->lock );
    }
 
    memset( route, 0, sizeof(struct fskit_path_route) );
@@ -1685,7 +1789,7 @@ int fskit_route_sync_args( struct fskit_route_dispatch_args* dargs ) {
 }
 
 // set up dargs for rename()
-int fskit_route_rename_args( struct fskit_route_dispatch_args* dargs, struct fskit_entry* old_parent, char const* old_name, char const* new_path, struct fskit_entry* new_parent, struct fskit_entry* dest ) {
+int fskit_route_rename_args( struct fskit_route_dispatch_args* dargs, struct fskit_entry* old_parent, char const* old_name, char const* new_path, struct fskit_entry* new_parent, struct fskit_entry* dest, unsigned int flags ) {
 
    memset( dargs, 0, sizeof(struct fskit_route_dispatch_args) );
 
@@ -1694,6 +1798,7 @@ int fskit_route_rename_args( struct fskit_route_dispatch_args* dargs, struct fsk
    dargs->new_path = new_path;
    dargs->dest = dest;
    dargs->new_parent = new_parent;
+   dargs->rename_flags = flags;
 
    return 0;
 }
@@ -1826,3 +1931,9 @@ char* fskit_route_metadata_get_xattr_buf( struct fskit_route_metadata* route_met
 bool fskit_route_metadata_renamed( struct fskit_route_metadata* route_metadata ) {
    return route_metadata->renamed;
 }
+
+// get the FSKIT_RENAME_* flags (valid for rename() only).
+// with FSKIT_RENAME_EXCHANGE, the destination entry passed to the route gets moved to the source path.
+unsigned int fskit_route_metadata_get_rename_flags( struct fskit_route_metadata* route_metadata ) {
+   return route_metadata->rename_flags;
+}
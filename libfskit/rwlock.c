@@ -0,0 +1,306 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// compact reader-writer lock, built on futexes.
+// fskit keeps one of these in every inode, handle, and route, so it is kept to 8 bytes: a state word that holds
+// the reader count and the write-locked and has-waiters bits, and a count of writers waiting for the lock.
+// readers don't enter while a writer is waiting, so a stream of readers can't starve writers.
+// the uncontended paths are a single compare-and-swap.  Contended waiters sleep on the state word, and are all
+// woken when the lock becomes free.
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE             // for syscall(2)
+#endif
+
+#include <fskit/fskit.h>
+
+#include "fskit_private/private.h"
+#include "fskit_private/trace.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define FSKIT_RWLOCK_WLOCKED    0x80000000U
+#define FSKIT_RWLOCK_WAITERS    0x40000000U
+#define FSKIT_RWLOCK_READERS    0x3FFFFFFFU
+
+// sleep until the state word changes from state
+static void fskit_rwlock_wait( fskit_rwlock_t* lock, uint32_t state ) {
+   syscall( SYS_futex, &lock->state, FUTEX_WAIT_PRIVATE, state, NULL, NULL, 0 );
+}
+
+// wake everyone sleeping on the state word
+static void fskit_rwlock_wake_all( fskit_rwlock_t* lock ) {
+   syscall( SYS_futex, &lock->state, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0 );
+}
+
+// tell the unlocker that someone is about to sleep.
+// return true if the waiters bit is set, or false if the state changed first
+static bool fskit_rwlock_mark_waiting( fskit_rwlock_t* lock, uint32_t state ) {
+
+   if( state & FSKIT_RWLOCK_WAITERS ) {
+      return true;
+   }
+
+   // acquire, so a reader that lands on a just-released state also sees that writer leave the writers count
+   return __atomic_compare_exchange_n( &lock->state, &state, state | FSKIT_RWLOCK_WAITERS, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED );
+}
+
+// can a reader enter, given this state?
+static bool fskit_rwlock_can_read( fskit_rwlock_t* lock, uint32_t state ) {
+   return (state & FSKIT_RWLOCK_WLOCKED) == 0 && __atomic_load_n( &lock->writers, __ATOMIC_RELAXED ) == 0;
+}
+
+#ifdef FSKIT_RWLOCK_DEBUG
+
+static pid_t fskit_rwlock_self(void) {
+   return (pid_t)syscall( SYS_gettid );
+}
+
+#endif
+
+// set up a lock
+// always succeeds
+int fskit_rwlock_init( fskit_rwlock_t* lock ) {
+
+   memset( lock, 0, sizeof(fskit_rwlock_t) );
+   return 0;
+}
+
+// tear down a lock
+// return 0 on success
+// return -EBUSY if it is held
+int fskit_rwlock_destroy( fskit_rwlock_t* lock ) {
+
+   if( __atomic_load_n( &lock->state, __ATOMIC_RELAXED ) & (FSKIT_RWLOCK_WLOCKED | FSKIT_RWLOCK_READERS) ) {
+      return -EBUSY;
+   }
+
+   return 0;
+}
+
+// read-lock
+// return 0 on success
+// return -EAGAIN if there are too many readers
+// return -EDEADLK if this thread holds the write lock (debug builds only)
+int fskit_rwlock_rdlock( fskit_rwlock_t* lock ) {
+
+   uint32_t state = 0;
+   bool waited = false;
+
+#ifdef FSKIT_RWLOCK_DEBUG
+   if( __atomic_load_n( &lock->owner, __ATOMIC_RELAXED ) == fskit_rwlock_self() ) {
+      return -EDEADLK;
+   }
+#endif
+
+   while( true ) {
+
+      state = __atomic_load_n( &lock->state, __ATOMIC_RELAXED );
+
+      if( fskit_rwlock_can_read( lock, state ) ) {
+
+         if( (state & FSKIT_RWLOCK_READERS) == FSKIT_RWLOCK_READERS ) {
+            return -EAGAIN;
+         }
+
+         if( __atomic_compare_exchange_n( &lock->state, &state, state + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) ) {
+
+            if( waited ) {
+               FSKIT_TRACE2( lock__wait__end, lock, 0 );
+            }
+            return 0;
+         }
+
+         continue;
+      }
+
+      if( !fskit_rwlock_mark_waiting( lock, state ) ) {
+         continue;
+      }
+
+      // the writers count is not in the state word, so a writer may have come and gone since we looked, leaving the
+      // lock free with nobody left to wake us.  Check again now that the waiters bit is set.
+      if( fskit_rwlock_can_read( lock, state ) ) {
+         continue;
+      }
+
+      if( !waited ) {
+         FSKIT_TRACE2( lock__wait__begin, lock, 0 );
+         waited = true;
+      }
+
+      fskit_rwlock_wait( lock, state | FSKIT_RWLOCK_WAITERS );
+   }
+}
+
+// read-lock, if it can be done without waiting
+// return 0 on success
+// return -EBUSY if a writer holds or is waiting for the lock
+// return -EAGAIN if there are too many readers
+int fskit_rwlock_tryrdlock( fskit_rwlock_t* lock ) {
+
+   uint32_t state = __atomic_load_n( &lock->state, __ATOMIC_RELAXED );
+
+   while( fskit_rwlock_can_read( lock, state ) ) {
+
+      if( (state & FSKIT_RWLOCK_READERS) == FSKIT_RWLOCK_READERS ) {
+         return -EAGAIN;
+      }
+
+      if( __atomic_compare_exchange_n( &lock->state, &state, state + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) ) {
+         return 0;
+      }
+   }
+
+   return -EBUSY;
+}
+
+// write-lock
+// return 0 on success
+// return -EDEADLK if this thread already holds the write lock (debug builds only)
+int fskit_rwlock_wrlock( fskit_rwlock_t* lock ) {
+
+   uint32_t state = 0;
+   bool waited = false;
+
+#ifdef FSKIT_RWLOCK_DEBUG
+   if( __atomic_load_n( &lock->owner, __ATOMIC_RELAXED ) == fskit_rwlock_self() ) {
+      return -EDEADLK;
+   }
+#endif
+
+   // uncontended?
+   if( !__atomic_compare_exchange_n( &lock->state, &state, FSKIT_RWLOCK_WLOCKED, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) ) {
+
+      // hold off new readers until we're in
+      __atomic_add_fetch( &lock->writers, 1, __ATOMIC_RELAXED );
+
+      while( true ) {
+
+         state = __atomic_load_n( &lock->state, __ATOMIC_RELAXED );
+
+         if( (state & (FSKIT_RWLOCK_WLOCKED | FSKIT_RWLOCK_READERS)) == 0 ) {
+
+            if( __atomic_compare_exchange_n( &lock->state, &state, state | FSKIT_RWLOCK_WLOCKED, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) ) {
+               break;
+            }
+
+            continue;
+         }
+
+         if( !fskit_rwlock_mark_waiting( lock, state ) ) {
+            continue;
+         }
+
+         if( !waited ) {
+            FSKIT_TRACE2( lock__wait__begin, lock, 1 );
+            waited = true;
+         }
+
+         fskit_rwlock_wait( lock, state | FSKIT_RWLOCK_WAITERS );
+      }
+
+      // readers may be asleep waiting for the last writer to get through.  We unlock later and wake them then, but
+      // wake them now too, so none stays asleep on our behalf if the state word moved under it.
+      if( __atomic_sub_fetch( &lock->writers, 1, __ATOMIC_RELAXED ) == 0 && (__atomic_load_n( &lock->state, __ATOMIC_RELAXED ) & FSKIT_RWLOCK_WAITERS) ) {
+         fskit_rwlock_wake_all( lock );
+      }
+
+      if( waited ) {
+         FSKIT_TRACE2( lock__wait__end, lock, 1 );
+      }
+   }
+
+#ifdef FSKIT_RWLOCK_DEBUG
+   __atomic_store_n( &lock->owner, fskit_rwlock_self(), __ATOMIC_RELAXED );
+#endif
+
+   return 0;
+}
+
+// write-lock, if it can be done without waiting
+// return 0 on success
+// return -EBUSY if the lock is held
+int fskit_rwlock_trywrlock( fskit_rwlock_t* lock ) {
+
+   uint32_t state = __atomic_load_n( &lock->state, __ATOMIC_RELAXED );
+
+   while( (state & (FSKIT_RWLOCK_WLOCKED | FSKIT_RWLOCK_READERS)) == 0 ) {
+
+      if( __atomic_compare_exchange_n( &lock->state, &state, state | FSKIT_RWLOCK_WLOCKED, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED ) ) {
+
+#ifdef FSKIT_RWLOCK_DEBUG
+         __atomic_store_n( &lock->owner, fskit_rwlock_self(), __ATOMIC_RELAXED );
+#endif
+         return 0;
+      }
+   }
+
+   return -EBUSY;
+}
+
+// release a read or write lock.  When the lock becomes free, wake anyone waiting for it.
+// return 0 on success
+// return -EPERM if the lock is not held, or if another thread holds the write lock (debug builds only)
+int fskit_rwlock_unlock( fskit_rwlock_t* lock ) {
+
+   uint32_t state = __atomic_load_n( &lock->state, __ATOMIC_RELAXED );
+   uint32_t next = 0;
+
+   if( state & FSKIT_RWLOCK_WLOCKED ) {
+
+#ifdef FSKIT_RWLOCK_DEBUG
+      if( __atomic_load_n( &lock->owner, __ATOMIC_RELAXED ) != fskit_rwlock_self() ) {
+         return -EPERM;
+      }
+
+      __atomic_store_n( &lock->owner, 0, __ATOMIC_RELAXED );
+#endif
+   }
+
+   do {
+
+      if( state & FSKIT_RWLOCK_WLOCKED ) {
+
+         // only the waiters bit can change under a writer
+         next = state & ~(FSKIT_RWLOCK_WLOCKED | FSKIT_RWLOCK_WAITERS);
+      }
+      else if( (state & FSKIT_RWLOCK_READERS) == 0 ) {
+
+         return -EPERM;
+      }
+      else {
+
+         next = state - 1;
+         if( (next & FSKIT_RWLOCK_READERS) == 0 ) {
+            next &= ~FSKIT_RWLOCK_WAITERS;
+         }
+      }
+
+   } while( !__atomic_compare_exchange_n( &lock->state, &state, next, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED ) );
+
+   if( (state & FSKIT_RWLOCK_WAITERS) && (next & FSKIT_RWLOCK_WAITERS) == 0 ) {
+      fskit_rwlock_wake_all( lock );
+   }
+
+   return 0;
+}
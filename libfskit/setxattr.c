@@ -80,7 +80,7 @@ int fskit_setxattr( struct fskit_core* core, char const* path, uint64_t user, ui
 int fskit_xattr_fsetxattr( struct fskit_core* core, struct fskit_entry* fent, char const* name, char const* value, size_t value_len, int flags ) {
 
    int rc = 0;
-   rc = fskit_xattr_set_insert( &fent->xattrs, name, value, value_len, flags );
+   rc = fskit_entry_xattr_set( core, fent, name, value, value_len, flags );
    if( rc == -ENOMEM ) {
       
       rc = -ENOSPC;
@@ -0,0 +1,861 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// copy-on-write clones.
+// a clone of a directory starts out as one new directory that is "pending": it records the directory it copies
+// (its source), and sits on the source's list of dependents.  The first path walk through a pending directory fills
+// it in ("materializes" it): each of the source's children gets copied into it.  Copied files, symlinks, and devices
+// are complete copies (whose data pages are shared; see data.c), while copied directories are themselves pending
+// clones of the source's subdirectories.  So a clone takes constant time, and each directory is copied at most once,
+// when it is first visited.
+//
+// a source must not change while it has pending dependents, so the first write-locking path walk through it (or its
+// removal) materializes them first ("pushes" it).  Writes and truncations through file handles don't walk a path,
+// so a handle walks its path again first if any clone has been made since it last did (see fskit_cow_fixup_handle).
+//
+// locking: renames can put a clone anywhere in the tree relative to its source, so while holding one entry we only
+// ever try to lock an entry outside of the usual path order.  If that fails, we release what we hold and try again.
+// fskit_cow_lock guards the lists of dependents, and is never held while waiting on an entry lock.
+// an entry's src field only changes while the entry is write-locked and fskit_cow_lock is held.
+
+#include <fskit/snapshot.h>
+#include <fskit/path.h>
+#include <fskit/util.h>
+
+#include "fskit_private/private.h"
+
+#include <sched.h>
+
+struct fskit_cow {
+
+   struct fskit_entry* src;     // if pending, the directory this one copies
+   mode_t mode_mask;            // permission bits to clear in everything copied into this one
+
+   struct fskit_entry* deps;    // pending directories that copy this one
+   struct fskit_entry* next;    // siblings on src's list of dependents
+   struct fskit_entry* prev;
+};
+
+static pthread_mutex_t fskit_cow_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// is dir a pending clone?
+// NOTE: dir must be at least read-locked
+static bool fskit_cow_is_pending( struct fskit_entry* dir ) {
+
+   struct fskit_cow* cow = __atomic_load_n( &dir->cow, __ATOMIC_ACQUIRE );
+
+   return (cow != NULL && cow->src != NULL);
+}
+
+
+// get an entry's clone state, creating it if need be
+// return NULL on OOM
+// NOTE: fskit_cow_lock must be held, and fent must be at least read-locked
+static struct fskit_cow* fskit_cow_get( struct fskit_entry* fent ) {
+
+   struct fskit_cow* cow = fent->cow;
+
+   if( cow == NULL ) {
+
+      cow = CALLOC_LIST( struct fskit_cow, 1 );
+      if( cow == NULL ) {
+         return NULL;
+      }
+
+      __atomic_store_n( &fent->cow, cow, __ATOMIC_RELEASE );
+   }
+
+   return cow;
+}
+
+
+// put clone (which has clone state) on src's list of dependents
+// return 0 on success
+// return -ENOMEM on OOM
+// NOTE: fskit_cow_lock must be held, and src must be at least read-locked
+static int fskit_cow_link( struct fskit_entry* clone, struct fskit_entry* src ) {
+
+   struct fskit_cow* src_cow = fskit_cow_get( src );
+
+   if( src_cow == NULL ) {
+      return -ENOMEM;
+   }
+
+   clone->cow->src = src;
+   clone->cow->prev = NULL;
+   clone->cow->next = src_cow->deps;
+
+   if( src_cow->deps != NULL ) {
+      src_cow->deps->cow->prev = clone;
+   }
+
+   src_cow->deps = clone;
+   return 0;
+}
+
+
+// take a pending clone off of its source's list of dependents.  It stops being pending.
+// NOTE: fskit_cow_lock must be held
+static void fskit_cow_unlink( struct fskit_entry* clone ) {
+
+   struct fskit_cow* cow = clone->cow;
+
+   if( cow->prev != NULL ) {
+      cow->prev->cow->next = cow->next;
+   }
+   else {
+      cow->src->cow->deps = cow->next;
+   }
+
+   if( cow->next != NULL ) {
+      cow->next->cow->prev = cow->prev;
+   }
+
+   cow->src = NULL;
+   cow->next = NULL;
+   cow->prev = NULL;
+}
+
+
+// free an entry's clone state if it has none left
+// NOTE: fskit_cow_lock must be held, and fent must be write-locked
+static void fskit_cow_trim( struct fskit_entry* fent ) {
+
+   if( fent->cow != NULL && fent->cow->src == NULL && fent->cow->deps == NULL ) {
+
+      fskit_safe_free( fent->cow );
+      fent->cow = NULL;
+   }
+}
+
+
+// make a copy of src, to be put into parent under a new inode number.
+// directories become pending clones of their source, with its permission bits masked by mode_mask; everything else
+// is copied outright, also with masked permission bits.
+// return the copy (unlocked, unlinked, and not yet visible to any other thread) on success
+// return NULL on failure, and set *err to -ENOMEM on OOM, or -EIO if we couldn't allocate an inode
+// NOTE: src must be at least read-locked
+static struct fskit_entry* fskit_cow_copy_entry( struct fskit_core* core, struct fskit_entry* parent, struct fskit_entry* src, mode_t mode_mask, int* err ) {
+
+   struct fskit_entry* child = CALLOC_LIST( struct fskit_entry, 1 );
+   mode_t mode = src->mode & ~mode_mask;
+   uint64_t file_id = 0;
+   int rc = 0;
+
+   if( child == NULL ) {
+      *err = -ENOMEM;
+      return NULL;
+   }
+
+   file_id = fskit_core_inode_alloc( core, parent, child );
+   if( file_id == 0 ) {
+
+      fskit_error("fskit_core_inode_alloc(%" PRIX64 ") failed\n", src->file_id );
+
+      fskit_safe_free( child );
+      *err = -EIO;
+      return NULL;
+   }
+
+   switch( src->type ) {
+
+      case FSKIT_ENTRY_TYPE_FILE:
+         rc = fskit_entry_init_file( child, file_id, src->owner, src->group, mode );
+         break;
+
+      case FSKIT_ENTRY_TYPE_DIR:
+         rc = fskit_entry_init_dir( child, parent, file_id, src->owner, src->group, mode );
+         break;
+
+      case FSKIT_ENTRY_TYPE_FIFO:
+         rc = fskit_entry_init_fifo( child, file_id, src->owner, src->group, mode );
+         break;
+
+      case FSKIT_ENTRY_TYPE_SOCK:
+         rc = fskit_entry_init_sock( child, file_id, src->owner, src->group, mode );
+         break;
+
+      case FSKIT_ENTRY_TYPE_CHR:
+         rc = fskit_entry_init_chr( child, file_id, src->owner, src->group, mode, src->dev );
+         break;
+
+      case FSKIT_ENTRY_TYPE_BLK:
+         rc = fskit_entry_init_blk( child, file_id, src->owner, src->group, mode, src->dev );
+         break;
+
+      case FSKIT_ENTRY_TYPE_LNK:
+         rc = fskit_entry_init_symlink( child, file_id, src->symlink_target );
+         if( rc == 0 ) {
+
+            // permission bits of symlinks don't matter
+            child->owner = src->owner;
+            child->group = src->group;
+            child->mode = src->mode;
+         }
+         break;
+
+      default:
+         rc = -EINVAL;
+         break;
+   }
+
+   if( rc != 0 ) {
+
+      fskit_error("Failed to initialize copy of %" PRIX64 ", rc = %d\n", src->file_id, rc );
+
+      (*core->fskit_inode_free)( file_id, core->app_fs_data );
+      fskit_safe_free( child );
+      *err = (rc == -EINVAL ? -EIO : rc);
+      return NULL;
+   }
+
+   child->size = __atomic_load_n( &src->size, __ATOMIC_RELAXED );
+
+   child->atime_sec = src->atime_sec;
+   child->atime_nsec = src->atime_nsec;
+   child->mtime_sec = src->mtime_sec;
+   child->mtime_nsec = src->mtime_nsec;
+   child->ctime_sec = src->ctime_sec;
+   child->ctime_nsec = src->ctime_nsec;
+
+   rc = fskit_entry_xattr_copy( child, src );
+
+   if( rc == 0 && src->type == FSKIT_ENTRY_TYPE_FILE ) {
+      rc = fskit_data_clone( child, src );
+   }
+
+   if( rc == 0 && src->type == FSKIT_ENTRY_TYPE_DIR ) {
+
+      child->cow = CALLOC_LIST( struct fskit_cow, 1 );
+      if( child->cow == NULL ) {
+         rc = -ENOMEM;
+      }
+      else {
+
+         child->cow->mode_mask = mode_mask;
+
+         pthread_mutex_lock( &fskit_cow_lock );
+         rc = fskit_cow_link( child, src );
+         pthread_mutex_unlock( &fskit_cow_lock );
+      }
+   }
+
+   if( rc != 0 ) {
+
+      fskit_entry_destroy( core, child, false );
+      fskit_safe_free( child );
+      *err = rc;
+      return NULL;
+   }
+
+   // copies are made on demand, so they don't count against the inode limit
+   fskit_usage_charge_entry( core, child, true );
+
+   return child;
+}
+
+
+// try to read-lock an entry for copying, without waiting
+// return 0 on success
+// return -EAGAIN if someone else has it write-locked
+// return -ENOENT if it is dead
+static int fskit_cow_tryrlock( struct fskit_entry* fent ) {
+
+   if( fskit_rwlock_tryrdlock( &fent->lock ) != 0 ) {
+      return -EAGAIN;
+   }
+
+   if( fent->type == FSKIT_ENTRY_TYPE_DEAD ) {
+
+      fskit_entry_unlock( fent );
+      return -ENOENT;
+   }
+
+   return 0;
+}
+
+
+// destroy the copies in a child set built by fskit_cow_materialize, and free it.
+// copied directories are on their sources' lists of dependents, so a pusher may be holding them.
+static void fskit_cow_free_copies( struct fskit_core* core, fskit_entry_set* children ) {
+
+   fskit_entry_set_itr itr;
+   fskit_entry_set* dp = NULL;
+   struct fskit_entry* child = NULL;
+   char const* name = NULL;
+
+   for( dp = fskit_entry_set_begin( &itr, children ); dp != NULL; dp = fskit_entry_set_next( &itr ) ) {
+
+      child = fskit_entry_set_child_at( dp );
+      name = fskit_entry_set_name_at( dp );
+
+      if( strcmp( name, "." ) == 0 || strcmp( name, ".." ) == 0 || child == NULL ) {
+         continue;
+      }
+
+      fskit_entry_destroy( core, child, true );
+      fskit_safe_free( child );
+   }
+
+   fskit_entry_set_free( children );
+}
+
+
+// fill in a pending clone with copies of its source's children.
+// if src_locked is false, this locks the source (materializing it first, if it is pending itself).
+// every other lock taken here is only tried, since renames can put a clone anywhere relative to its source.
+// return 0 on success; dir is no longer pending
+// return -EAGAIN if a lock couldn't be had; the caller should release dir for a moment and try again
+// return -ENOMEM on OOM, or -EIO if we couldn't allocate an inode; dir stays pending
+// NOTE: dir must be write-locked, and pending
+static int fskit_cow_materialize( struct fskit_core* core, struct fskit_entry* dir, bool src_locked ) {
+
+   struct fskit_entry* src = dir->cow->src;
+   mode_t mode_mask = dir->cow->mode_mask;
+   fskit_entry_set* children = NULL;
+   fskit_entry_set* old_children = NULL;
+   fskit_entry_set* dp = NULL;
+   fskit_entry_set_itr itr;
+   struct fskit_entry* child = NULL;
+   struct fskit_entry* copy = NULL;
+   char const* name = NULL;
+   int64_t num_children = 0;
+   int rc = 0;
+
+   if( !src_locked ) {
+
+      // the source can't go away while dir depends on it; removing it would have to push dir first
+      if( fskit_rwlock_tryrdlock( &src->lock ) != 0 ) {
+         return -EAGAIN;
+      }
+
+      if( fskit_cow_is_pending( src ) ) {
+
+         fskit_entry_unlock( src );
+
+         if( fskit_rwlock_trywrlock( &src->lock ) != 0 ) {
+            return -EAGAIN;
+         }
+
+         if( fskit_cow_is_pending( src ) ) {
+
+            rc = fskit_cow_materialize( core, src, false );
+            if( rc != 0 ) {
+
+               fskit_entry_unlock( src );
+               return rc;
+            }
+         }
+      }
+   }
+
+   // new child set, with the same . and ..
+   children = fskit_entry_set_new_empty( dir );
+   if( children == NULL ) {
+      rc = -ENOMEM;
+      goto fskit_cow_materialize_out;
+   }
+
+   for( dp = fskit_entry_set_begin( &itr, src->children ); dp != NULL; dp = fskit_entry_set_next( &itr ) ) {
+
+      child = fskit_entry_set_child_at( dp );
+      name = fskit_entry_set_name_at( dp );
+
+      if( name == NULL || child == NULL || strcmp( name, "." ) == 0 || strcmp( name, ".." ) == 0 ) {
+         continue;
+      }
+
+      rc = fskit_cow_tryrlock( child );
+      if( rc == -ENOENT ) {
+
+         rc = 0;
+         continue;
+      }
+
+      if( rc != 0 ) {
+
+         fskit_cow_free_copies( core, children );
+         goto fskit_cow_materialize_out;
+      }
+
+      if( child->deletion_in_progress ) {
+
+         fskit_entry_unlock( child );
+         continue;
+      }
+
+      copy = fskit_cow_copy_entry( core, dir, child, mode_mask, &rc );
+
+      fskit_entry_unlock( child );
+
+      if( copy == NULL ) {
+
+         fskit_cow_free_copies( core, children );
+         goto fskit_cow_materialize_out;
+      }
+
+      rc = fskit_entry_set_insert( &children, name, copy );
+      if( rc != 0 ) {
+
+         fskit_entry_destroy( core, copy, true );
+         fskit_safe_free( copy );
+
+         fskit_cow_free_copies( core, children );
+         goto fskit_cow_materialize_out;
+      }
+
+      copy->link_count = 1;
+      num_children++;
+   }
+
+   // swap them in
+   old_children = dir->children;
+   dir->children = children;
+
+   fskit_usage_add( dir->usage, FSKIT_USAGE_DIRENTS, num_children - dir->num_children );
+   fskit_usage_add( dir->usage, FSKIT_USAGE_NAME_BYTES, (int64_t)fskit_entry_set_name_bytes( children ) - (int64_t)fskit_entry_set_name_bytes( old_children ) );
+   dir->num_children = num_children;
+
+   fskit_entry_set_free( old_children );
+
+   pthread_mutex_lock( &fskit_cow_lock );
+
+   fskit_cow_unlink( dir );
+   fskit_cow_trim( dir );
+
+   pthread_mutex_unlock( &fskit_cow_lock );
+
+fskit_cow_materialize_out:
+
+   if( !src_locked ) {
+      fskit_entry_unlock( src );
+   }
+
+   return rc;
+}
+
+
+// release a write-locked directory for a moment, so whoever holds the locks we want can finish
+// return 0 on success
+// return -ENOENT if dir died while it was unlocked
+static int fskit_cow_backoff( struct fskit_entry* dir ) {
+
+   fskit_entry_unlock( dir );
+
+   sched_yield();
+
+   fskit_rwlock_wrlock( &dir->lock );
+
+   if( dir->type == FSKIT_ENTRY_TYPE_DEAD ) {
+      return -ENOENT;
+   }
+
+   return 0;
+}
+
+
+// materialize all of a directory's pending clones, so the directory can be changed.
+// this may release and re-acquire dir's lock, so the caller must re-check dir's state afterwards.
+// return 0 on success
+// return -ENOENT if dir died while it was unlocked
+// return -ENOMEM or -EIO if a clone couldn't be materialized
+// NOTE: dir must be write-locked, and stays so.  It must stay referenced (e.g. by its locked parent) while unlocked.
+static int fskit_cow_push( struct fskit_core* core, struct fskit_entry* dir ) {
+
+   struct fskit_entry* clone = NULL;
+   int rc = 0;
+
+   while( true ) {
+
+      pthread_mutex_lock( &fskit_cow_lock );
+
+      clone = (dir->cow != NULL ? dir->cow->deps : NULL);
+      if( clone == NULL ) {
+
+         fskit_cow_trim( dir );
+
+         pthread_mutex_unlock( &fskit_cow_lock );
+         return 0;
+      }
+
+      if( fskit_rwlock_trywrlock( &clone->lock ) == 0 ) {
+
+         // still on our list, so still pending
+         pthread_mutex_unlock( &fskit_cow_lock );
+
+         rc = fskit_cow_materialize( core, clone, true );
+
+         fskit_entry_unlock( clone );
+
+         if( rc == 0 ) {
+            continue;
+         }
+
+         if( rc != -EAGAIN ) {
+            return rc;
+         }
+      }
+      else {
+
+         pthread_mutex_unlock( &fskit_cow_lock );
+      }
+
+      // whoever holds the clone (or one of our children) may be waiting for dir.
+      rc = fskit_cow_backoff( dir );
+      if( rc != 0 ) {
+         return rc;
+      }
+   }
+}
+
+
+// get a directory ready for a path walk: materialize it if it is a pending clone, and if push is set, materialize
+// its own pending clones as well, so it can be changed.
+// this may release and re-acquire dir's lock, so the caller must re-check dir's state afterwards.
+// dir comes back write-locked if it had to be materialized.
+// return 0 on success
+// return -ENOENT if dir died while it was unlocked
+// return -ENOMEM or -EIO if a clone couldn't be materialized
+// NOTE: dir must be read-locked if push is false, and write-locked if push is true.  It stays locked either way.
+// It must stay referenced (e.g. by its locked parent) while unlocked.
+int fskit_cow_fixup( struct fskit_core* core, struct fskit_entry* dir, bool push ) {
+
+   int rc = 0;
+   bool wlocked = push;
+
+   if( __atomic_load_n( &dir->cow, __ATOMIC_ACQUIRE ) == NULL ) {
+      return 0;
+   }
+
+   while( fskit_cow_is_pending( dir ) ) {
+
+      if( !wlocked ) {
+
+         // need the write lock
+         fskit_entry_unlock( dir );
+         fskit_rwlock_wrlock( &dir->lock );
+
+         if( dir->type == FSKIT_ENTRY_TYPE_DEAD ) {
+            return -ENOENT;
+         }
+
+         wlocked = true;
+         continue;
+      }
+
+      rc = fskit_cow_materialize( core, dir, false );
+      if( rc == -EAGAIN ) {
+
+         rc = fskit_cow_backoff( dir );
+      }
+
+      if( rc != 0 ) {
+         return rc;
+      }
+   }
+
+   if( push ) {
+      rc = fskit_cow_push( core, dir );
+   }
+
+   return rc;
+}
+
+
+// get a directory ready to have its children taken away and removed.
+// a pending clone simply forgets its source (it has nothing to remove), and a source gets its pending clones materialized.
+// this may release and re-acquire dir's lock, so the caller must re-check dir's state afterwards.
+// return 0 on success
+// return -ENOENT if dir died while it was unlocked
+// return -ENOMEM or -EIO if a clone couldn't be materialized
+// NOTE: dir must be write-locked, and stays so.  It must stay referenced while unlocked.
+int fskit_cow_detach( struct fskit_core* core, struct fskit_entry* dir ) {
+
+   if( __atomic_load_n( &dir->cow, __ATOMIC_ACQUIRE ) == NULL ) {
+      return 0;
+   }
+
+   pthread_mutex_lock( &fskit_cow_lock );
+
+   if( dir->cow->src != NULL ) {
+      fskit_cow_unlink( dir );
+   }
+
+   pthread_mutex_unlock( &fskit_cow_lock );
+
+   return fskit_cow_push( core, dir );
+}
+
+
+// drop an entry's clone state, as it is destroyed
+void fskit_cow_forget( struct fskit_entry* fent ) {
+
+   struct fskit_cow* cow = fent->cow;
+   struct fskit_entry* dep = NULL;
+
+   if( cow == NULL ) {
+      return;
+   }
+
+   pthread_mutex_lock( &fskit_cow_lock );
+
+   if( cow->src != NULL ) {
+      fskit_cow_unlink( fent );
+   }
+
+   while( cow->deps != NULL ) {
+
+      // should never happen: sources get pushed before they are removed
+      dep = cow->deps;
+      fskit_error("BUG: %" PRIX64 " destroyed with pending clone %" PRIX64 "\n", fent->file_id, dep->file_id );
+
+      fskit_cow_unlink( dep );
+   }
+
+   fent->cow = NULL;
+
+   pthread_mutex_unlock( &fskit_cow_lock );
+
+   fskit_safe_free( cow );
+}
+
+
+// get the number of clones made in the core so far
+uint64_t fskit_cow_generation( struct fskit_core* core ) {
+
+   return __atomic_load_n( &core->cow_generation, __ATOMIC_ACQUIRE );
+}
+
+
+// push the directories on a file handle's path, if any clone has been made since the handle last did (or was opened).
+// a write-locking path walk would have done this, but a handle changes its file without walking its path, and a
+// pending clone of its directory would otherwise copy the change.
+// the handle's path is all we have to find its directory by, so a file renamed since it was opened isn't covered.
+// return 0 on success, including if the path no longer leads anywhere
+// return -ENOMEM on OOM, or -EIO if a clone couldn't be materialized
+// NOTE: fh must be at least read-locked
+int fskit_cow_fixup_handle( struct fskit_core* core, struct fskit_file_handle* fh ) {
+
+   int rc = 0;
+   uint64_t generation = fskit_cow_generation( core );
+   struct fskit_entry* parent = NULL;
+   char* path_dirname = NULL;
+
+   if( __atomic_load_n( &fh->cow_generation, __ATOMIC_RELAXED ) == generation ) {
+      return 0;
+   }
+
+   path_dirname = fskit_dirname( fh->path, NULL );
+   if( path_dirname == NULL ) {
+      return -ENOMEM;
+   }
+
+   // the handle was already allowed to change the file, so walk as root
+   parent = fskit_entry_resolve_path( core, path_dirname, FSKIT_ROOT_USER_ID, 0, true, &rc );
+
+   fskit_safe_free( path_dirname );
+
+   if( parent != NULL ) {
+      fskit_entry_unlock( parent );
+   }
+   else if( rc == -ENOENT || rc == -ENOTDIR ) {
+
+      // the path no longer leads to a directory, so there is nothing to push
+      rc = 0;
+   }
+
+   if( rc == 0 ) {
+      __atomic_store_n( &fh->cow_generation, generation, __ATOMIC_RELAXED );
+   }
+
+   return rc;
+}
+
+
+// path walk callback for fskit_clone: the destination can't be inside the source
+static int fskit_clone_path_cb( struct fskit_entry* fent, void* cls ) {
+
+   if( fent == (struct fskit_entry*)cls ) {
+      return -EINVAL;
+   }
+
+   return 0;
+}
+
+
+// make dest_path a copy-on-write copy of src_path, masking its permission bits (and those of everything in it) with mode_mask.
+// return 0 on success
+// return -ENOENT if src_path or dest_path's parent doesn't exist
+// return -EEXIST if dest_path exists
+// return -EINVAL if dest_path is inside src_path
+// return -EACCES if src_path isn't readable, or dest_path's parent isn't writeable
+// return -ENOTDIR if dest_path's parent isn't a directory
+// return -ENAMETOOLONG if dest_path's name is too long
+// return -ENOMEM on OOM, or -EIO if we couldn't allocate an inode
+static int fskit_clone_ex( struct fskit_core* core, char const* src_path, char const* dest_path, uint64_t user, uint64_t group, mode_t mode_mask ) {
+
+   int rc = 0;
+   int rc2 = 0;
+   struct fskit_entry* src = NULL;
+   struct fskit_entry* parent = NULL;
+   struct fskit_entry* child = NULL;
+   char* fpath = NULL;
+   char* path_dirname = NULL;
+   char* path_basename = NULL;
+
+   if( fskit_basename_len( dest_path ) > FSKIT_FILESYSTEM_NAMEMAX ) {
+      return -ENAMETOOLONG;
+   }
+
+   fpath = strdup( dest_path );
+   if( fpath == NULL ) {
+      return -ENOMEM;
+   }
+
+   fskit_sanitize_path( fpath );
+
+   path_dirname = fskit_dirname( fpath, NULL );
+   path_basename = fskit_basename( fpath, NULL );
+
+   fskit_safe_free( fpath );
+
+   if( path_dirname == NULL || path_basename == NULL ) {
+
+      fskit_safe_free( path_dirname );
+      fskit_safe_free( path_basename );
+      return -ENOMEM;
+   }
+
+   // find the source, and reference it so it stays put while we find the destination
+   src = fskit_entry_resolve_path( core, src_path, user, group, true, &rc );
+   if( src == NULL ) {
+
+      fskit_safe_free( path_dirname );
+      fskit_safe_free( path_basename );
+      return rc;
+   }
+
+   if( !FSKIT_ENTRY_IS_READABLE( src->mode, src->owner, src->group, user, group ) ) {
+
+      fskit_entry_unlock( src );
+      fskit_safe_free( path_dirname );
+      fskit_safe_free( path_basename );
+      return -EACCES;
+   }
+
+   src->open_count++;
+   fskit_entry_unlock( src );
+
+   while( true ) {
+
+      parent = fskit_entry_resolve_path_cls( core, path_dirname, user, group, true, &rc, fskit_clone_path_cb, src );
+      if( parent == NULL ) {
+         goto fskit_clone_out;
+      }
+
+      if( parent->type != FSKIT_ENTRY_TYPE_DIR ) {
+         rc = -ENOTDIR;
+      }
+      else if( !FSKIT_ENTRY_IS_WRITEABLE( parent->mode, parent->owner, parent->group, user, group ) ) {
+         rc = -EACCES;
+      }
+      else if( fskit_entry_set_find_name( parent->children, path_basename ) != NULL ) {
+         rc = -EEXIST;
+      }
+
+      if( rc != 0 ) {
+
+         fskit_entry_unlock( parent );
+         goto fskit_clone_out;
+      }
+
+      // src may be anywhere relative to parent, so don't wait on it while holding parent
+      if( fskit_rwlock_tryrdlock( &src->lock ) == 0 ) {
+         break;
+      }
+
+      fskit_entry_unlock( parent );
+      sched_yield();
+   }
+
+   if( src->link_count <= 0 || src->deletion_in_progress ) {
+
+      // got removed in the meantime
+      rc = -ENOENT;
+   }
+   else {
+
+      child = fskit_cow_copy_entry( core, parent, src, mode_mask, &rc );
+      if( child != NULL ) {
+
+         // with src locked, no pusher can get at child yet
+         rc = fskit_entry_attach_lowlevel( parent, child, path_basename );
+         if( rc != 0 ) {
+
+            fskit_entry_destroy( core, child, true );
+            fskit_safe_free( child );
+         }
+         else {
+
+            // open file handles must push their paths before they next change anything
+            __atomic_add_fetch( &core->cow_generation, 1, __ATOMIC_RELEASE );
+         }
+      }
+   }
+
+   fskit_entry_unlock( src );
+   fskit_entry_unlock( parent );
+
+fskit_clone_out:
+
+   // drop our reference
+   fskit_entry_wlock( src );
+
+   src->open_count--;
+
+   // this unlocks src if it destroys it
+   rc2 = fskit_entry_try_destroy_and_free( core, src_path, NULL, src );
+   if( rc2 <= 0 ) {
+      fskit_entry_unlock( src );
+   }
+
+   fskit_safe_free( path_dirname );
+   fskit_safe_free( path_basename );
+
+   return rc;
+}
+
+
+// make dest_path a copy-on-write clone of src_path
+// return 0 on success
+// return -errno on failure (see fskit_clone_ex)
+int fskit_clone( struct fskit_core* core, char const* src_path, char const* dest_path, uint64_t user, uint64_t group ) {
+   return fskit_clone_ex( core, src_path, dest_path, user, group, 0 );
+}
+
+
+// make dest_path a read-only copy-on-write clone of src_path
+// return 0 on success
+// return -errno on failure (see fskit_clone_ex)
+int fskit_snapshot( struct fskit_core* core, char const* src_path, char const* dest_path, uint64_t user, uint64_t group ) {
+   return fskit_clone_ex( core, src_path, dest_path, user, group, S_IWUSR | S_IWGRP | S_IWOTH );
+}
@@ -129,7 +129,7 @@ int fskit_entry_fstat( struct fskit_entry* fent, struct stat* sb ) {
    sb->st_uid = fent->owner;
    sb->st_gid = fent->group;
    sb->st_rdev = fent->dev;
-   sb->st_size = fent->size;
+   sb->st_size = __atomic_load_n( &fent->size, __ATOMIC_RELAXED );     // write continuations raise it without the lock
    sb->st_blksize = 0;
    sb->st_blocks = 0;
 
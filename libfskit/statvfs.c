@@ -19,17 +19,344 @@
    <http://www.isc.org/downloads/software-support-policy/isc-license/>.
 */
 
+// filesystem statistics and capacity limits.
+// each core keeps a set of usage counters, sharded so that threads creating, removing, and writing to entries
+// don't contend on the same cache lines.  A thread always adds to the same shard; readers sum them all.
+// every entry points to the counters it has been charged to (fent->usage), so the low-level entry functions can
+// keep them up to date without needing the core.
+// limits are checked against a lock-free sum, so concurrent creators and writers can overshoot a limit by as much
+// as they add at once.
+
 #include <fskit/statvfs.h>
 #include <fskit/fskit.h>
+#include <fskit/util.h>
 
 #include "fskit_private/private.h"
 
+#include <unistd.h>
+
+#define FSKIT_USAGE_NUM_SHARDS          16
+
+struct fskit_usage_shard {
+
+   int64_t counters[ FSKIT_USAGE_NUM_COUNTERS ];
+
+} __attribute__((aligned(64)));
+
+struct fskit_usage {
+
+   struct fskit_usage_shard shards[ FSKIT_USAGE_NUM_SHARDS ];
+
+   uint64_t max_inodes;                 // 0 for no limit
+   uint64_t max_bytes;                  // 0 for no limit
+};
+
+// this thread's shard, or -1 if it hasn't picked one yet
+static _Thread_local int fskit_usage_shard = -1;
+
+// next shard to hand out
+static int fskit_usage_next_shard = 0;
+
+
+// set up a core's counters
+// return 0 on success
+// return -ENOMEM on OOM
+int fskit_usage_init( struct fskit_core* core ) {
+
+   struct fskit_usage* usage = NULL;
+
+   if( posix_memalign( (void**)&usage, 64, sizeof(struct fskit_usage) ) != 0 ) {
+      return -ENOMEM;
+   }
+
+   memset( usage, 0, sizeof(struct fskit_usage) );
+
+   core->usage = usage;
+   return 0;
+}
+
+
+// free a core's counters.  Every entry charged to them must be gone.
+void fskit_usage_shutdown( struct fskit_core* core ) {
+
+   fskit_safe_free( core->usage );
+}
+
+
+// add to one of the calling thread's counters
+void fskit_usage_add( struct fskit_usage* usage, int counter, int64_t delta ) {
+
+   int shard = fskit_usage_shard;
+
+   if( usage == NULL || delta == 0 ) {
+      return;
+   }
+
+   if( shard < 0 ) {
+
+      shard = __atomic_fetch_add( &fskit_usage_next_shard, 1, __ATOMIC_RELAXED ) % FSKIT_USAGE_NUM_SHARDS;
+      fskit_usage_shard = shard;
+   }
+
+   __atomic_add_fetch( &usage->shards[shard].counters[counter], delta, __ATOMIC_RELAXED );
+}
+
+
+// sum a counter over all shards
+static uint64_t fskit_usage_sum( struct fskit_usage* usage, int counter ) {
+
+   int64_t sum = 0;
+
+   for( int i = 0; i < FSKIT_USAGE_NUM_SHARDS; i++ ) {
+      sum += __atomic_load_n( &usage->shards[i].counters[counter], __ATOMIC_RELAXED );
+   }
+
+   // shards are read one at a time, so a concurrent add and remove can briefly look negative
+   return (sum > 0 ? (uint64_t)sum : 0);
+}
+
+
+// can we store delta more bytes?
+// return 0 if so (or if there is no limit)
+// return -ENOSPC if not
+int fskit_usage_check_bytes( struct fskit_usage* usage, int64_t delta ) {
+
+   uint64_t max_bytes = 0;
+
+   if( usage == NULL || delta <= 0 ) {
+      return 0;
+   }
+
+   max_bytes = __atomic_load_n( &usage->max_bytes, __ATOMIC_RELAXED );
+   if( max_bytes == 0 ) {
+      return 0;
+   }
+
+   if( fskit_usage_sum( usage, FSKIT_USAGE_XATTR_BYTES ) + fskit_usage_sum( usage, FSKIT_USAGE_DATA_BYTES ) + (uint64_t)delta > max_bytes ) {
+      return -ENOSPC;
+   }
+
+   return 0;
+}
+
+
+// can a file grow (or shrink) to new_size bytes?
+// return 0 if so (or if there is no limit)
+// return -ENOSPC if not
+// NOTE: fent need not be locked; its size is only an estimate here
+int fskit_usage_check_size( struct fskit_entry* fent, off_t new_size ) {
+
+   if( fent->usage == NULL || fent->type != FSKIT_ENTRY_TYPE_FILE ) {
+      return 0;
+   }
+
+   return fskit_usage_check_bytes( fent->usage, new_size - __atomic_load_n( &fent->size, __ATOMIC_RELAXED ) );
+}
+
+
+// charge a new entry, and whatever it already has (children, xattrs, and data), to the core's counters.
+// unless force is set, fail if the core is out of inodes.  Entries that already exist in some form (copies and
+// restored entries) are forced.
+// return 0 on success
+// return -ENOSPC if the core has reached its inode limit
+// NOTE: fent must be write-locked, or not yet reachable
+int fskit_usage_charge_entry( struct fskit_core* core, struct fskit_entry* fent, bool force ) {
+
+   struct fskit_usage* usage = core->usage;
+   uint64_t max_inodes = 0;
+
+   if( usage == NULL || fent->usage != NULL ) {
+      return 0;
+   }
+
+   if( !force ) {
+
+      max_inodes = __atomic_load_n( &usage->max_inodes, __ATOMIC_RELAXED );
+      if( max_inodes > 0 && fskit_usage_sum( usage, FSKIT_USAGE_INODES ) >= max_inodes ) {
+         return -ENOSPC;
+      }
+   }
+
+   fskit_usage_add( usage, FSKIT_USAGE_INODES, 1 );
+   fskit_usage_add( usage, fent->type, 1 );
+   fskit_usage_add( usage, FSKIT_USAGE_XATTR_BYTES, fskit_entry_xattr_bytes( fent ) );
+
+   if( fent->type == FSKIT_ENTRY_TYPE_DIR ) {
+      fskit_usage_add( usage, FSKIT_USAGE_DIRENTS, fent->num_children );
+      fskit_usage_add( usage, FSKIT_USAGE_NAME_BYTES, fskit_entry_set_name_bytes( fent->children ) );
+   }
+
+   if( fent->type == FSKIT_ENTRY_TYPE_FILE ) {
+      fskit_usage_add( usage, FSKIT_USAGE_DATA_BYTES, fent->size );
+   }
+
+   if( fent->type == FSKIT_ENTRY_TYPE_LNK ) {
+      fskit_usage_add( usage, FSKIT_USAGE_SYMLINK_BYTES, fskit_entry_symlink_bytes( fent ) );
+   }
+
+   fent->usage = usage;
+   return 0;
+}
+
+
+// give back everything an entry is charged for.  Called when it is destroyed.
+// NOTE: fent must be write-locked, or no longer reachable
+void fskit_usage_release_entry( struct fskit_entry* fent ) {
+
+   struct fskit_usage* usage = fent->usage;
+
+   if( usage == NULL ) {
+      return;
+   }
+
+   fskit_usage_add( usage, FSKIT_USAGE_INODES, -1 );
+   fskit_usage_add( usage, fent->type, -1 );
+   fskit_usage_add( usage, FSKIT_USAGE_XATTR_BYTES, -(int64_t)fskit_entry_xattr_bytes( fent ) );
+
+   if( fent->type == FSKIT_ENTRY_TYPE_DIR ) {
+      fskit_usage_add( usage, FSKIT_USAGE_DIRENTS, -fent->num_children );
+      fskit_usage_add( usage, FSKIT_USAGE_NAME_BYTES, -(int64_t)fskit_entry_set_name_bytes( fent->children ) );
+   }
+
+   if( fent->type == FSKIT_ENTRY_TYPE_FILE ) {
+      fskit_usage_add( usage, FSKIT_USAGE_DATA_BYTES, -fent->size );
+   }
+
+   if( fent->type == FSKIT_ENTRY_TYPE_LNK ) {
+      fskit_usage_add( usage, FSKIT_USAGE_SYMLINK_BYTES, -(int64_t)fskit_entry_symlink_bytes( fent ) );
+   }
+
+   fent->usage = NULL;
+}
+
+
+// set the core's capacity limits.  0 means no limit.
+// lowering a limit below what is in use doesn't remove anything; it only keeps more from being added.
+// creating an inode fails with -ENOSPC once max_inodes are in use.  Writing, truncating, or setting an xattr fails
+// with -ENOSPC if it would take the total of file sizes and xattr names and values past max_bytes.
+// copy-on-write clones and restored checkpoints are charged as they are filled in, and are not held to the limits.
+// always succeeds
+int fskit_core_set_limits( struct fskit_core* core, uint64_t max_inodes, uint64_t max_bytes ) {
+
+   __atomic_store_n( &core->usage->max_inodes, max_inodes, __ATOMIC_RELAXED );
+   __atomic_store_n( &core->usage->max_bytes, max_bytes, __ATOMIC_RELAXED );
+
+   return 0;
+}
+
+
+// get the core's current usage and limits.
+// the counts are summed without stopping other threads, so they are only exact if nothing is changing.
+// always succeeds
+int fskit_core_get_usage( struct fskit_core* core, struct fskit_usage_info* info ) {
+
+   struct fskit_usage* usage = core->usage;
+
+   memset( info, 0, sizeof(struct fskit_usage_info) );
+
+   info->inodes = fskit_usage_sum( usage, FSKIT_USAGE_INODES );
+
+   for( int i = FSKIT_ENTRY_TYPE_FILE; i <= FSKIT_ENTRY_TYPE_LNK; i++ ) {
+      info->inodes_by_type[i] = fskit_usage_sum( usage, i );
+   }
+
+   info->dirents = fskit_usage_sum( usage, FSKIT_USAGE_DIRENTS );
+   info->xattr_bytes = fskit_usage_sum( usage, FSKIT_USAGE_XATTR_BYTES );
+   info->data_bytes = fskit_usage_sum( usage, FSKIT_USAGE_DATA_BYTES );
+
+   info->max_inodes = __atomic_load_n( &usage->max_inodes, __ATOMIC_RELAXED );
+   info->max_bytes = __atomic_load_n( &usage->max_bytes, __ATOMIC_RELAXED );
+
+   return 0;
+}
+
+
+// estimate what the allocator adds to count allocations totalling bytes: a size word per chunk, and rounding up to
+// the next 16-byte chunk (32 at least), as glibc does on 64-bit hosts.  Variable-sized allocations are taken to be
+// their average size.
+static uint64_t fskit_malloc_overhead( uint64_t count, uint64_t bytes ) {
+
+   uint64_t avg = 0;
+   uint64_t chunk = 0;
+
+   if( count == 0 ) {
+      return 0;
+   }
+
+   avg = bytes / count;
+   chunk = (avg + sizeof(size_t) + 15) & ~(uint64_t)15;
+
+   if( chunk < 32 ) {
+      chunk = 32;
+   }
+
+   return count * (chunk - avg);
+}
+
+
+// estimate the memory the core's namespace takes, from the usage counters (no tree walk).
+// every directory has a . and a .. entry set node besides one per directory entry.  Extended attributes are counted
+// by their names and values only, and routes without their compiled regexes.  Allocator overhead is an estimate
+// (see fskit_malloc_overhead).
+// like fskit_core_get_usage, the counts are only exact if nothing is changing.
+// always succeeds
+int fskit_core_memory_report( struct fskit_core* core, struct fskit_memory_report* report ) {
+
+   struct fskit_usage* usage = core->usage;
+   uint64_t num_entries = 0;
+   uint64_t num_dirs = 0;
+   uint64_t num_set_nodes = 0;
+   uint64_t num_symlinks = 0;
+   uint64_t num_file_handles = 0;
+   uint64_t num_dir_handles = 0;
+   uint64_t route_allocs = 0;
+
+   memset( report, 0, sizeof(struct fskit_memory_report) );
+
+   num_entries = fskit_usage_sum( usage, FSKIT_USAGE_INODES );
+   num_dirs = fskit_usage_sum( usage, FSKIT_ENTRY_TYPE_DIR );
+   num_set_nodes = fskit_usage_sum( usage, FSKIT_USAGE_DIRENTS ) + 2 * num_dirs;
+   num_symlinks = fskit_usage_sum( usage, FSKIT_ENTRY_TYPE_LNK );
+   num_file_handles = fskit_usage_sum( usage, FSKIT_USAGE_FILE_HANDLES );
+   num_dir_handles = fskit_usage_sum( usage, FSKIT_USAGE_DIR_HANDLES );
+
+   report->entries = num_entries * sizeof(struct fskit_entry);
+   report->entry_set_nodes = num_set_nodes * fskit_entry_set_node_size();
+   report->names = fskit_usage_sum( usage, FSKIT_USAGE_NAME_BYTES ) + num_dirs * (sizeof(".") + sizeof(".."));
+   report->xattrs = fskit_usage_sum( usage, FSKIT_USAGE_XATTR_BYTES );
+   report->symlink_targets = fskit_usage_sum( usage, FSKIT_USAGE_SYMLINK_BYTES );
+   report->file_handles = num_file_handles * sizeof(struct fskit_file_handle) + fskit_usage_sum( usage, FSKIT_USAGE_FILE_HANDLE_BYTES );
+   report->dir_handles = num_dir_handles * sizeof(struct fskit_dir_handle) + fskit_usage_sum( usage, FSKIT_USAGE_DIR_HANDLE_BYTES );
+
+   fskit_core_route_rlock( core );
+   report->routes = fskit_route_table_bytes( core->routes, &route_allocs );
+   fskit_core_route_unlock( core );
+
+   // the root is part of the core, so it isn't an allocation of its own
+   report->allocator_overhead = (num_entries > 0 ? fskit_malloc_overhead( num_entries - 1, (num_entries - 1) * sizeof(struct fskit_entry) ) : 0)
+                              + fskit_malloc_overhead( num_set_nodes, num_set_nodes * fskit_entry_set_node_size() )
+                              + fskit_malloc_overhead( num_set_nodes, report->names )
+                              + fskit_malloc_overhead( num_symlinks, report->symlink_targets )
+                              + fskit_malloc_overhead( num_file_handles, num_file_handles * sizeof(struct fskit_file_handle) )
+                              + fskit_malloc_overhead( num_file_handles, report->file_handles - num_file_handles * sizeof(struct fskit_file_handle) )
+                              + fskit_malloc_overhead( num_dir_handles, num_dir_handles * sizeof(struct fskit_dir_handle) )
+                              + fskit_malloc_overhead( num_dir_handles, report->dir_handles - num_dir_handles * sizeof(struct fskit_dir_handle) )
+                              + fskit_malloc_overhead( route_allocs, report->routes );
+
+   report->num_entries = num_entries;
+   report->num_entry_set_nodes = num_set_nodes;
+   report->num_file_handles = num_file_handles;
+   report->num_dir_handles = num_dir_handles;
+
+   report->total = report->entries + report->entry_set_nodes + report->names + report->xattrs + report->symlink_targets
+                 + report->file_handles + report->dir_handles + report->routes + report->allocator_overhead;
+
+   return 0;
+}
+
+
 // stat the filesystem that holds the path.
-// the following fields are filled in:
-// * f_fsid
-// * f_files
-// * f_namemax
-// the rest are filled with 0's
+// see fskit_fstatvfs for what gets filled in.
 // return 0 and fill in the statvfs buffer on success.
 // return the usual path resolution errors.
 int fskit_statvfs( struct fskit_core* core, char const* fs_path, uint64_t user, uint64_t group, struct statvfs* vfs ) {
@@ -50,18 +377,57 @@ int fskit_statvfs( struct fskit_core* core, char const* fs_path, uint64_t user,
    return rc;
 }
 
-// stat the filesystem from an inode
+// stat the filesystem from an inode.
+// blocks are FSKIT_STATVFS_BLOCK_SIZE bytes; file sizes and xattrs count as used.  Without a byte limit, the
+// capacity is what is in use plus the host's free memory.  Without an inode limit, the free inodes are as many as
+// would fit in the free space.
 // fill in the statvfs buffer (always succeeds)
 int fskit_fstatvfs( struct fskit_core* core, struct fskit_entry* fent, struct statvfs* vfs ) {
 
-   vfs->f_bsize = 0;
-   vfs->f_frsize = 0;
-   vfs->f_blocks = 0;
-   vfs->f_bfree = 0;
-   vfs->f_bavail = 0;
-   vfs->f_files = 0;
-   vfs->f_ffree = 0;
-   vfs->f_favail = 0;
+   struct fskit_usage_info info;
+   uint64_t used_blocks = 0;
+   uint64_t free_blocks = 0;
+   uint64_t total_blocks = 0;
+   uint64_t free_inodes = 0;
+   long free_pages = 0;
+   long page_size = 0;
+
+   fskit_core_get_usage( core, &info );
+
+   used_blocks = (info.data_bytes + info.xattr_bytes + FSKIT_STATVFS_BLOCK_SIZE - 1) / FSKIT_STATVFS_BLOCK_SIZE;
+
+   if( info.max_bytes > 0 ) {
+
+      total_blocks = info.max_bytes / FSKIT_STATVFS_BLOCK_SIZE;
+      free_blocks = (total_blocks > used_blocks ? total_blocks - used_blocks : 0);
+   }
+   else {
+
+      free_pages = sysconf( _SC_AVPHYS_PAGES );
+      page_size = sysconf( _SC_PAGESIZE );
+
+      if( free_pages > 0 && page_size > 0 ) {
+         free_blocks = (uint64_t)free_pages * page_size / FSKIT_STATVFS_BLOCK_SIZE;
+      }
+
+      total_blocks = used_blocks + free_blocks;
+   }
+
+   if( info.max_inodes > 0 ) {
+      free_inodes = (info.max_inodes > info.inodes ? info.max_inodes - info.inodes : 0);
+   }
+   else {
+      free_inodes = free_blocks * FSKIT_STATVFS_BLOCK_SIZE / sizeof(struct fskit_entry);
+   }
+
+   vfs->f_bsize = FSKIT_STATVFS_BLOCK_SIZE;
+   vfs->f_frsize = FSKIT_STATVFS_BLOCK_SIZE;
+   vfs->f_blocks = total_blocks;
+   vfs->f_bfree = free_blocks;
+   vfs->f_bavail = free_blocks;
+   vfs->f_files = info.inodes + free_inodes;
+   vfs->f_ffree = free_inodes;
+   vfs->f_favail = free_inodes;
    vfs->f_fsid = FSKIT_FILESYSTEM_TYPE;
    vfs->f_flag = 0;
    vfs->f_namemax = FSKIT_FILESYSTEM_NAMEMAX;
@@ -105,6 +105,17 @@ int fskit_symlink( struct fskit_core* core, char const* target, char const* link
       return -EIO;
    }
 
+   // count it, if there's room
+   rc = fskit_usage_charge_entry( core, child, false );
+   if( rc != 0 ) {
+
+      fskit_entry_destroy( core, child, true );
+      fskit_safe_free( child );
+
+      fskit_entry_unlock( parent );
+      return rc;
+   }
+
    // insert
    rc = fskit_entry_attach_lowlevel( parent, child, child_name );
    if( rc != 0 ) {
@@ -26,16 +26,13 @@
 #include "fskit_private/private.h"
 
 
-// i/o continuation, called with the same locks held as the trunc()
+// i/o continuation, called with the same locks held as the trunc().
+// concurrent routes get here without fent's write lock, so only set the size here.  fskit_run_user_trunc sets the
+// times once it has the write lock.
 static int fskit_trunc_cont( struct fskit_core* core, struct fskit_entry* fent, off_t new_size, ssize_t trunc_rc ) {
 
    if( trunc_rc == 0 ) {
-
-      // update metadata
-      fskit_entry_set_mtime( fent, NULL );
-      fskit_entry_set_atime( fent, NULL );
-
-      fent->size = new_size;
+      fskit_entry_set_size( fent, new_size );
    }
 
    return 0;
@@ -55,6 +52,11 @@ int fskit_run_user_trunc( struct fskit_core* core, char const* path, struct fski
    memset( name, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
    fskit_basename( path, name );
 
+   rc = fskit_usage_check_size( fent, new_size );
+   if( rc != 0 ) {
+      return rc;
+   }
+
    fskit_route_trunc_args( &dargs, name, new_size, handle_data, fskit_trunc_cont );
 
    rc = fskit_route_call_trunc( core, path, fent, &dargs, &cbrc );
@@ -64,20 +66,60 @@ int fskit_run_user_trunc( struct fskit_core* core, char const* path, struct fski
       return 0;
    }
 
+   if( cbrc == 0 ) {
+
+      // update metadata
+      fskit_entry_wlock( fent );
+
+      fskit_entry_set_mtime( fent, NULL );
+      fskit_entry_set_atime( fent, NULL );
+
+      fskit_entry_unlock( fent );
+   }
+
    return cbrc;
 }
 
 
-// directly set the size.
+// directly set the size, and charge the difference to the core.
 // do not call the user callback.
+// the size is swapped atomically and only the difference from the value it replaced is charged, since a concurrent
+// write continuation may be raising it (see fskit_entry_raise_size).
 // always succeeds
-// NOTE; fent must be write-locked
+// NOTE; fent must be write-locked, or be in a write or truncate continuation
 int fskit_entry_set_size( struct fskit_entry* fent, off_t size ) {
-   
-   fent->size = size;
+
+   off_t old_size = __atomic_exchange_n( &fent->size, size, __ATOMIC_RELAXED );
+
+   if( fent->type == FSKIT_ENTRY_TYPE_FILE ) {
+      fskit_usage_add( fent->usage, FSKIT_USAGE_DATA_BYTES, size - old_size );
+   }
+
    return 0;
 }
 
+// raise the size to at least size, and charge the difference to the core.
+// the write continuation calls this without fent's write lock, so it never lowers the size.
+// return the size after the call
+off_t fskit_entry_raise_size( struct fskit_entry* fent, off_t size ) {
+
+   off_t old_size = __atomic_load_n( &fent->size, __ATOMIC_RELAXED );
+
+   while( size > old_size ) {
+
+      if( __atomic_compare_exchange_n( &fent->size, &old_size, size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) ) {
+
+         if( fent->type == FSKIT_ENTRY_TYPE_FILE ) {
+            fskit_usage_add( fent->usage, FSKIT_USAGE_DATA_BYTES, size - old_size );
+         }
+
+         return size;
+      }
+   }
+
+   return old_size;
+}
+
 // truncate a file to a given size
 // return zero on success
 // return negative on failure.
@@ -92,7 +134,15 @@ int fskit_ftrunc( struct fskit_core* core, struct fskit_file_handle* fh, off_t n
       return -EBADF;
    }
 
-   int rc = fskit_run_user_trunc( core, fh->path, fh->fent, new_size, fh->app_data );
+   // copies made since the handle was opened must not see this truncation
+   int rc = fskit_cow_fixup_handle( core, fh );
+   if( rc != 0 ) {
+
+      fskit_file_handle_unlock( fh );
+      return rc;
+   }
+
+   rc = fskit_run_user_trunc( core, fh->path, fh->fent, new_size, fh->app_data );
 
    fskit_file_handle_unlock( fh );
 
@@ -107,6 +157,7 @@ int fskit_trunc( struct fskit_core* core, char const* path, uint64_t user, uint6
 
    int err = 0;
    int rc = 0;
+   int trunc_rc = 0;
 
    if( fskit_basename_len(path) > FSKIT_FILESYSTEM_NAMEMAX ) {
       return -ENAMETOOLONG;
@@ -123,7 +174,7 @@ int fskit_trunc( struct fskit_core* core, char const* path, uint64_t user, uint6
 
    fskit_entry_unlock( fent );
 
-   rc = fskit_run_user_trunc( core, path, fent, new_size, NULL );
+   trunc_rc = fskit_run_user_trunc( core, path, fent, new_size, NULL );
 
    // unreference
    fskit_entry_wlock( fent );
@@ -152,5 +203,5 @@ int fskit_trunc( struct fskit_core* core, char const* path, uint64_t user, uint6
       fskit_entry_unlock( fent );
    }
 
-   return rc;
+   return trunc_rc;
 }
@@ -60,7 +60,9 @@ int fskit_unlink( struct fskit_core* core, char const* path, uint64_t owner, uin
 
    if( !parent || err ) {
 
-      fskit_entry_unlock( parent );
+      if( parent != NULL ) {
+         fskit_entry_unlock( parent );
+      }
 
       free( path_basename );
 
@@ -86,7 +88,10 @@ int fskit_unlink( struct fskit_core* core, char const* path, uint64_t owner, uin
       free( path_basename );
       return -ENOENT;
    }
-   
+
+   // hold fent while we detach it, so a concurrent close can't see it unlinked and free it under us
+   fskit_entry_wlock( fent );
+
    // detach fent from parent
    rc = fskit_entry_detach_lowlevel( parent, path_basename );
    free( path_basename );
@@ -95,10 +100,15 @@ int fskit_unlink( struct fskit_core* core, char const* path, uint64_t owner, uin
 
       fskit_error("fskit_entry_detach_lowlevel(%p) rc = %d\n", fent, rc );
 
+      fskit_entry_unlock( fent );
       fskit_entry_unlock( parent );
       return rc;
    }
 
+   // reference fent so it won't go anywhere while the user detach handler runs
+   fent->open_count++;
+   fskit_entry_unlock( fent );
+
    // user detach handler
    rc = fskit_run_user_detach( core, path, parent, fent );
    if( rc < 0 ) {
@@ -108,6 +118,9 @@ int fskit_unlink( struct fskit_core* core, char const* path, uint64_t owner, uin
    }
    
    fskit_entry_wlock( fent );
+
+   // unreference
+   fent->open_count--;
    
    // try to destroy fent
    // note that this unlocks fent and destroys it if it is fully unref'ed
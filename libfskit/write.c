@@ -25,20 +25,13 @@
 
 #include "fskit_private/private.h"
 
-// continuation for successful write
-// fent must be write-locked
+// continuation for successful write.
+// under FSKIT_CONCURRENT and FSKIT_INODE_CONCURRENT routes, several writers can get here at once without fent's
+// write lock, so only raise the size (atomically) here.  fskit_write sets the times once it has the write lock.
 int fskit_write_cont( struct fskit_core* core, struct fskit_entry* fent, off_t offset, ssize_t num_written ) {
 
    if( num_written >= 0 ) {
-      fskit_entry_set_mtime( fent, NULL );
-      fskit_entry_set_atime( fent, NULL );
-
-      off_t size_delta = 0;
-      if( offset + num_written > fent->size ) {
-         size_delta = (offset + num_written) - fent->size;
-      }
-
-      fent->size += size_delta;
+      fskit_entry_raise_size( fent, offset + num_written );
    }
 
    return 0;
@@ -79,6 +72,22 @@ ssize_t fskit_write( struct fskit_core* core, struct fskit_file_handle* fh, char
       return -EBADF;
    }
 
+   // room to grow?
+   int rc = fskit_usage_check_size( fh->fent, offset + buflen );
+   if( rc != 0 ) {
+
+      fskit_file_handle_unlock( fh );
+      return rc;
+   }
+
+   // copies made since the handle was opened must not see this write
+   rc = fskit_cow_fixup_handle( core, fh );
+   if( rc != 0 ) {
+
+      fskit_file_handle_unlock( fh );
+      return rc;
+   }
+
    ssize_t num_written = fskit_run_user_write( core, fh->path, fh->fent, buf, buflen, offset, fh->app_data );
 
    if( num_written >= 0 ) {
@@ -89,7 +98,8 @@ ssize_t fskit_write( struct fskit_core* core, struct fskit_file_handle* fh, char
       fskit_entry_set_mtime( fh->fent, NULL );
       fskit_entry_set_atime( fh->fent, NULL );
 
-      fh->fent->size = ((unsigned)(offset + buflen) > fh->fent->size ? offset + buflen : fh->fent->size);
+      // a concurrent write route may be raising the size without our lock
+      fskit_entry_raise_size( fh->fent, offset + buflen );
 
       fskit_entry_unlock( fh->fent );
    }
@@ -0,0 +1,798 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// compact xattr storage.
+// an inode's attributes live in one of two places:
+// * a packed block: one allocation holding a sorted index of (interned name, value) pairs, followed by the values.
+//   this is where small attributes go, as long as there are only a few of them.
+// * an fskit_xattr_set rbtree (fent->xattrs), once the inode has too many or too large attributes.
+// an inode uses the rbtree whenever fent->xattrs is non-NULL, and the packed block otherwise.
+// names in packed blocks are interned in a core-wide table, so each distinct name is stored once.
+
+#include <fskit/entry.h>
+#include <fskit/util.h>
+
+#include "fskit_private/private.h"
+
+#include <stddef.h>
+
+// an interned name.  It lives at the end of this structure, so the structure can be found from the name alone.
+struct fskit_xattr_name {
+
+   struct fskit_xattr_names* table;
+   struct fskit_xattr_name* next;       // hash chain
+   uint64_t hash;
+   uint64_t refcount;                   // number of packed attributes using this name (guarded by the table lock)
+
+   char name[];
+};
+
+// per-core table of interned names
+struct fskit_xattr_names {
+
+   struct fskit_xattr_name** buckets;
+   uint64_t num_buckets;
+   uint64_t count;
+
+   pthread_mutex_t lock;
+};
+
+// one attribute in a packed block
+struct fskit_xattr_inline {
+
+   char const* name;                    // interned
+   uint32_t value_off;                  // offset into the block's values
+   uint32_t value_len;
+};
+
+// a packed block of attributes, sorted by name.  The values follow the index.
+struct fskit_xattr_packed {
+
+   uint32_t count;
+   uint32_t value_bytes;
+
+   struct fskit_xattr_inline attrs[];
+};
+
+#define FSKIT_XATTR_NAMES_INITIAL_BUCKETS       64
+
+#define FSKIT_XATTR_PACKED_VALUES( packed )     ((char*)&(packed)->attrs[ (packed)->count ])
+#define FSKIT_XATTR_PACKED_SIZE( count, value_bytes ) (sizeof(struct fskit_xattr_packed) + (count) * sizeof(struct fskit_xattr_inline) + (value_bytes))
+
+
+// FNV-1a
+static uint64_t fskit_xattr_name_hash( char const* name ) {
+
+   uint64_t hash = 14695981039346656037ULL;
+
+   for( ; *name != '\0'; name++ ) {
+      hash ^= (unsigned char)(*name);
+      hash *= 1099511628211ULL;
+   }
+
+   return hash;
+}
+
+
+// set up a core's interned name table
+// return 0 on success
+// return -ENOMEM on OOM
+int fskit_xattr_names_init( struct fskit_core* core ) {
+
+   struct fskit_xattr_names* names = CALLOC_LIST( struct fskit_xattr_names, 1 );
+   if( names == NULL ) {
+      return -ENOMEM;
+   }
+
+   names->buckets = CALLOC_LIST( struct fskit_xattr_name*, FSKIT_XATTR_NAMES_INITIAL_BUCKETS );
+   if( names->buckets == NULL ) {
+
+      fskit_safe_free( names );
+      return -ENOMEM;
+   }
+
+   names->num_buckets = FSKIT_XATTR_NAMES_INITIAL_BUCKETS;
+
+   pthread_mutex_init( &names->lock, NULL );
+
+   core->xattr_names = names;
+   return 0;
+}
+
+
+// free a core's interned name table.
+// all entries must have been destroyed already.
+void fskit_xattr_names_shutdown( struct fskit_core* core ) {
+
+   struct fskit_xattr_names* names = core->xattr_names;
+   struct fskit_xattr_name* name = NULL;
+   struct fskit_xattr_name* next = NULL;
+
+   if( names == NULL ) {
+      return;
+   }
+
+   for( uint64_t i = 0; i < names->num_buckets; i++ ) {
+
+      for( name = names->buckets[i]; name != NULL; name = next ) {
+
+         next = name->next;
+         fskit_safe_free( name );
+      }
+   }
+
+   pthread_mutex_destroy( &names->lock );
+
+   fskit_safe_free( names->buckets );
+   fskit_safe_free( names );
+
+   core->xattr_names = NULL;
+}
+
+
+// double the number of buckets, if we can.
+// NOTE: names must be locked
+static void fskit_xattr_names_grow( struct fskit_xattr_names* names ) {
+
+   uint64_t num_buckets = names->num_buckets * 2;
+   struct fskit_xattr_name* name = NULL;
+   struct fskit_xattr_name* next = NULL;
+
+   struct fskit_xattr_name** buckets = CALLOC_LIST( struct fskit_xattr_name*, num_buckets );
+   if( buckets == NULL ) {
+      // just keep the longer chains
+      return;
+   }
+
+   for( uint64_t i = 0; i < names->num_buckets; i++ ) {
+
+      for( name = names->buckets[i]; name != NULL; name = next ) {
+
+         next = name->next;
+
+         name->next = buckets[ name->hash % num_buckets ];
+         buckets[ name->hash % num_buckets ] = name;
+      }
+   }
+
+   fskit_safe_free( names->buckets );
+
+   names->buckets = buckets;
+   names->num_buckets = num_buckets;
+}
+
+
+// get a reference to the interned copy of a name, interning it if need be
+// return the interned name on success
+// return NULL on OOM
+static char const* fskit_xattr_name_ref( struct fskit_xattr_names* names, char const* str ) {
+
+   uint64_t hash = fskit_xattr_name_hash( str );
+   struct fskit_xattr_name* name = NULL;
+   size_t len = 0;
+
+   pthread_mutex_lock( &names->lock );
+
+   for( name = names->buckets[ hash % names->num_buckets ]; name != NULL; name = name->next ) {
+
+      if( name->hash == hash && strcmp( name->name, str ) == 0 ) {
+         break;
+      }
+   }
+
+   if( name == NULL ) {
+
+      len = strlen( str );
+
+      name = (struct fskit_xattr_name*)calloc( 1, sizeof(struct fskit_xattr_name) + len + 1 );
+      if( name == NULL ) {
+
+         pthread_mutex_unlock( &names->lock );
+         return NULL;
+      }
+
+      name->table = names;
+      name->hash = hash;
+      memcpy( name->name, str, len + 1 );
+
+      if( names->count >= 2 * names->num_buckets ) {
+         fskit_xattr_names_grow( names );
+      }
+
+      name->next = names->buckets[ hash % names->num_buckets ];
+      names->buckets[ hash % names->num_buckets ] = name;
+      names->count++;
+   }
+
+   name->refcount++;
+
+   pthread_mutex_unlock( &names->lock );
+
+   return name->name;
+}
+
+
+// take another reference to an interned name
+static void fskit_xattr_name_dup( char const* str ) {
+
+   struct fskit_xattr_name* name = (struct fskit_xattr_name*)(str - offsetof( struct fskit_xattr_name, name ));
+
+   pthread_mutex_lock( &name->table->lock );
+   name->refcount++;
+   pthread_mutex_unlock( &name->table->lock );
+}
+
+
+// release a reference to an interned name, and forget it once it's unused
+static void fskit_xattr_name_unref( char const* str ) {
+
+   struct fskit_xattr_name* name = (struct fskit_xattr_name*)(str - offsetof( struct fskit_xattr_name, name ));
+   struct fskit_xattr_names* names = name->table;
+   struct fskit_xattr_name** prev = NULL;
+
+   pthread_mutex_lock( &names->lock );
+
+   name->refcount--;
+
+   if( name->refcount == 0 ) {
+
+      for( prev = &names->buckets[ name->hash % names->num_buckets ]; *prev != NULL; prev = &(*prev)->next ) {
+
+         if( *prev == name ) {
+
+            *prev = name->next;
+            names->count--;
+            break;
+         }
+      }
+
+      fskit_safe_free( name );
+   }
+
+   pthread_mutex_unlock( &names->lock );
+}
+
+
+// find an attribute in a packed block
+// return its index if found
+// return -(the index it would be inserted at) - 1 if not
+static int fskit_xattr_packed_search( struct fskit_xattr_packed* packed, char const* name ) {
+
+   int lo = 0;
+   int hi = (packed != NULL ? (int)packed->count - 1 : -1);
+
+   while( lo <= hi ) {
+
+      int mid = lo + (hi - lo) / 2;
+      int cmp = strcmp( packed->attrs[mid].name, name );
+
+      if( cmp == 0 ) {
+         return mid;
+      }
+      else if( cmp < 0 ) {
+         lo = mid + 1;
+      }
+      else {
+         hi = mid - 1;
+      }
+   }
+
+   return -lo - 1;
+}
+
+
+// append an attribute to a packed block under construction
+static void fskit_xattr_packed_append( struct fskit_xattr_packed* packed, uint32_t* j, uint32_t* off, char const* name, char const* value, uint32_t value_len ) {
+
+   packed->attrs[*j].name = name;
+   packed->attrs[*j].value_off = *off;
+   packed->attrs[*j].value_len = value_len;
+
+   memcpy( FSKIT_XATTR_PACKED_VALUES( packed ) + *off, value, value_len );
+
+   *off += value_len;
+   *j += 1;
+}
+
+
+// make a copy of a packed block with the attribute at index i replaced by (name, value), or
+// with (name, value) inserted at index i if insert is set, or with the attribute at index i removed if name is NULL.
+// the names are shared with the old block; no references are taken or released.
+// return the new block (or NULL if it would be empty) on success
+// return NULL and set *err to -ENOMEM on OOM
+static struct fskit_xattr_packed* fskit_xattr_packed_edit( struct fskit_xattr_packed* packed, int i, bool insert, char const* name, char const* value, size_t value_len, int* err ) {
+
+   uint32_t old_count = (packed != NULL ? packed->count : 0);
+   uint32_t count = old_count;
+   uint64_t value_bytes = (packed != NULL ? packed->value_bytes : 0);
+   struct fskit_xattr_packed* ret = NULL;
+   char const* old_values = (packed != NULL ? FSKIT_XATTR_PACKED_VALUES( packed ) : NULL);
+   uint32_t off = 0;
+   uint32_t j = 0;
+
+   *err = 0;
+
+   if( insert ) {
+      count++;
+   }
+   else {
+
+      value_bytes -= packed->attrs[i].value_len;
+
+      if( name == NULL ) {
+         count--;
+      }
+   }
+
+   if( name != NULL ) {
+      value_bytes += value_len;
+   }
+
+   if( count == 0 ) {
+      return NULL;
+   }
+
+   ret = (struct fskit_xattr_packed*)malloc( FSKIT_XATTR_PACKED_SIZE( count, value_bytes ) );
+   if( ret == NULL ) {
+
+      *err = -ENOMEM;
+      return NULL;
+   }
+
+   ret->count = count;
+   ret->value_bytes = value_bytes;
+
+   // attributes before i
+   for( uint32_t k = 0; k < (uint32_t)i; k++ ) {
+      fskit_xattr_packed_append( ret, &j, &off, packed->attrs[k].name, old_values + packed->attrs[k].value_off, packed->attrs[k].value_len );
+   }
+
+   // the new or replacement attribute
+   if( name != NULL ) {
+      fskit_xattr_packed_append( ret, &j, &off, name, value, value_len );
+   }
+
+   // attributes after i.  An inserted attribute goes in front of the old one at i.
+   for( uint32_t k = (insert ? i : i + 1); k < old_count; k++ ) {
+      fskit_xattr_packed_append( ret, &j, &off, packed->attrs[k].name, old_values + packed->attrs[k].value_off, packed->attrs[k].value_len );
+   }
+
+   return ret;
+}
+
+
+// free a packed block and release its names
+static void fskit_xattr_packed_free( struct fskit_xattr_packed* packed ) {
+
+   if( packed == NULL ) {
+      return;
+   }
+
+   for( uint32_t i = 0; i < packed->count; i++ ) {
+      fskit_xattr_name_unref( packed->attrs[i].name );
+   }
+
+   fskit_safe_free( packed );
+}
+
+
+// move an inode's packed attributes into an rbtree, so it can hold many or large ones.
+// return 0 on success
+// return -ENOMEM on OOM (nothing changes)
+// NOTE: fent must be write-locked
+int fskit_entry_xattr_expand( struct fskit_entry* fent ) {
+
+   struct fskit_xattr_packed* packed = fent->xattrs_packed;
+   fskit_xattr_set* set = NULL;
+   int rc = 0;
+
+   if( packed == NULL ) {
+      return 0;
+   }
+
+   for( uint32_t i = 0; i < packed->count; i++ ) {
+
+      rc = fskit_xattr_set_insert( &set, packed->attrs[i].name, FSKIT_XATTR_PACKED_VALUES( packed ) + packed->attrs[i].value_off, packed->attrs[i].value_len, 0 );
+      if( rc != 0 ) {
+
+         fskit_xattr_set_free( set );
+         return rc;
+      }
+   }
+
+   fent->xattrs = set;
+   fent->xattrs_packed = NULL;
+
+   fskit_xattr_packed_free( packed );
+   return 0;
+}
+
+
+// would an inode's packed block still be small enough after setting name to a value_len-byte value?
+static bool fskit_xattr_packed_fits( struct fskit_xattr_packed* packed, int i, size_t value_len ) {
+
+   uint64_t count = (packed != NULL ? packed->count : 0);
+   uint64_t value_bytes = (packed != NULL ? packed->value_bytes : 0);
+
+   if( value_len > FSKIT_XATTR_INLINE_VALUE_MAX ) {
+      return false;
+   }
+
+   if( i >= 0 ) {
+      value_bytes -= packed->attrs[i].value_len;
+   }
+   else {
+      count++;
+   }
+
+   return count <= FSKIT_XATTR_INLINE_COUNT_MAX && value_bytes + value_len <= FSKIT_XATTR_INLINE_BYTES_MAX;
+}
+
+
+// set an attribute on an inode, without charging for it
+static int fskit_entry_xattr_set_lowlevel( struct fskit_core* core, struct fskit_entry* fent, char const* name, char const* value, size_t value_len, int flags ) {
+
+   struct fskit_xattr_packed* packed = NULL;
+   char const* interned = NULL;
+   int i = 0;
+   int rc = 0;
+
+   if( fent->xattrs != NULL ) {
+      return fskit_xattr_set_insert( &fent->xattrs, name, value, value_len, flags );
+   }
+
+   i = fskit_xattr_packed_search( fent->xattrs_packed, name );
+
+   if( i >= 0 && (flags & XATTR_CREATE) ) {
+      return -EEXIST;
+   }
+
+   if( i < 0 && (flags & XATTR_REPLACE) ) {
+      return -ENOATTR;
+   }
+
+   if( !fskit_xattr_packed_fits( fent->xattrs_packed, i, value_len ) ) {
+
+      // too big for a packed block
+      rc = fskit_entry_xattr_expand( fent );
+      if( rc != 0 ) {
+         return rc;
+      }
+
+      return fskit_xattr_set_insert( &fent->xattrs, name, value, value_len, flags );
+   }
+
+   if( i >= 0 ) {
+
+      // replacing; keep the name we have
+      packed = fskit_xattr_packed_edit( fent->xattrs_packed, i, false, fent->xattrs_packed->attrs[i].name, value, value_len, &rc );
+      if( packed == NULL ) {
+         return rc;
+      }
+   }
+   else {
+
+      interned = fskit_xattr_name_ref( core->xattr_names, name );
+      if( interned == NULL ) {
+         return -ENOMEM;
+      }
+
+      packed = fskit_xattr_packed_edit( fent->xattrs_packed, -i - 1, true, interned, value, value_len, &rc );
+      if( packed == NULL ) {
+
+         fskit_xattr_name_unref( interned );
+         return rc;
+      }
+   }
+
+   // names carried over
+   fskit_safe_free( fent->xattrs_packed );
+   fent->xattrs_packed = packed;
+
+   return 0;
+}
+
+
+// set an attribute on an inode
+// return 0 on success
+// return -EEXIST if the member is already present, and XATTR_CREATE is set in flags
+// return -ENOATTR if the member is not present, and XATTR_REPLACE is set in flags
+// return -ENOSPC if the core is out of space
+// return -ENOMEM on OOM
+// NOTE: fent must be write-locked
+int fskit_entry_xattr_set( struct fskit_core* core, struct fskit_entry* fent, char const* name, char const* value, size_t value_len, int flags ) {
+
+   size_t old_len = 0;
+   int64_t delta = 0;
+   int rc = 0;
+
+   if( name == NULL || value == NULL ) {
+      return -EINVAL;
+   }
+
+   if( fskit_entry_xattr_find( fent, name, &old_len ) != NULL ) {
+
+      if( flags & XATTR_CREATE ) {
+         return -EEXIST;
+      }
+
+      delta = (int64_t)value_len - (int64_t)old_len;
+   }
+   else {
+
+      if( flags & XATTR_REPLACE ) {
+         return -ENOATTR;
+      }
+
+      delta = strlen( name ) + value_len;
+   }
+
+   rc = fskit_usage_check_bytes( fent->usage, delta );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   rc = fskit_entry_xattr_set_lowlevel( core, fent, name, value, value_len, flags );
+   if( rc == 0 ) {
+      fskit_usage_add( fent->usage, FSKIT_USAGE_XATTR_BYTES, delta );
+   }
+
+   return rc;
+}
+
+
+// look up an attribute on an inode
+// return a pointer to its value, and set *len to its length
+// return NULL if not found
+// NOTE: fent must be at least read-locked
+char const* fskit_entry_xattr_find( struct fskit_entry* fent, char const* name, size_t* len ) {
+
+   struct fskit_xattr_packed* packed = fent->xattrs_packed;
+   int i = 0;
+
+   if( fent->xattrs != NULL ) {
+      return fskit_xattr_set_find( fent->xattrs, name, len );
+   }
+
+   i = fskit_xattr_packed_search( packed, name );
+   if( i < 0 ) {
+      return NULL;
+   }
+
+   *len = packed->attrs[i].value_len;
+   return FSKIT_XATTR_PACKED_VALUES( packed ) + packed->attrs[i].value_off;
+}
+
+
+// remove an attribute from an inode, without refunding it
+static int fskit_entry_xattr_remove_lowlevel( struct fskit_entry* fent, char const* name ) {
+
+   struct fskit_xattr_packed* packed = NULL;
+   char const* interned = NULL;
+   int i = 0;
+   int rc = 0;
+
+   if( fent->xattrs != NULL ) {
+      return fskit_xattr_set_remove( &fent->xattrs, name ) ? 0 : -ENOATTR;
+   }
+
+   i = fskit_xattr_packed_search( fent->xattrs_packed, name );
+   if( i < 0 ) {
+      return -ENOATTR;
+   }
+
+   interned = fent->xattrs_packed->attrs[i].name;
+
+   packed = fskit_xattr_packed_edit( fent->xattrs_packed, i, false, NULL, NULL, 0, &rc );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   fskit_safe_free( fent->xattrs_packed );
+   fent->xattrs_packed = packed;
+
+   fskit_xattr_name_unref( interned );
+   return 0;
+}
+
+
+// remove an attribute from an inode
+// return 0 on success
+// return -ENOATTR if it's not present
+// return -ENOMEM on OOM
+// NOTE: fent must be write-locked
+int fskit_entry_xattr_remove( struct fskit_entry* fent, char const* name ) {
+
+   size_t old_len = 0;
+   int rc = 0;
+
+   if( fskit_entry_xattr_find( fent, name, &old_len ) == NULL ) {
+      return -ENOATTR;
+   }
+
+   rc = fskit_entry_xattr_remove_lowlevel( fent, name );
+   if( rc == 0 ) {
+      fskit_usage_add( fent->usage, FSKIT_USAGE_XATTR_BYTES, -(int64_t)(strlen( name ) + old_len) );
+   }
+
+   return rc;
+}
+
+
+// count the bytes in an inode's attribute names and values
+// NOTE: fent must be at least read-locked
+uint64_t fskit_entry_xattr_bytes( struct fskit_entry* fent ) {
+
+   struct fskit_xattr_packed* packed = fent->xattrs_packed;
+   fskit_xattr_set_itr itr;
+   fskit_xattr_set* xattr = NULL;
+   uint64_t total = 0;
+
+   if( fent->xattrs != NULL ) {
+
+      for( xattr = fskit_xattr_set_begin( &itr, fent->xattrs ); xattr != NULL; xattr = fskit_xattr_set_next( &itr ) ) {
+         total += strlen( fskit_xattr_set_name( xattr ) ) + fskit_xattr_set_value_len( xattr );
+      }
+
+      return total;
+   }
+
+   if( packed == NULL ) {
+      return 0;
+   }
+
+   for( uint32_t i = 0; i < packed->count; i++ ) {
+      total += strlen( packed->attrs[i].name );
+   }
+
+   return total + packed->value_bytes;
+}
+
+
+// remove all of an inode's attributes
+// NOTE: fent must be write-locked
+void fskit_entry_xattr_clear( struct fskit_entry* fent ) {
+
+   if( fent->usage != NULL ) {
+      fskit_usage_add( fent->usage, FSKIT_USAGE_XATTR_BYTES, -(int64_t)fskit_entry_xattr_bytes( fent ) );
+   }
+
+   fskit_xattr_set_free( fent->xattrs );
+   fent->xattrs = NULL;
+
+   fskit_xattr_packed_free( fent->xattrs_packed );
+   fent->xattrs_packed = NULL;
+}
+
+
+// give dest (which has no attributes) a copy of src's attributes
+// return 0 on success
+// return -ENOMEM on OOM (dest gets none)
+// NOTE: src must be at least read-locked, and dest write-locked
+int fskit_entry_xattr_copy( struct fskit_entry* dest, struct fskit_entry* src ) {
+
+   struct fskit_xattr_packed* packed = src->xattrs_packed;
+   struct fskit_xattr_packed* copy = NULL;
+   fskit_xattr_set_itr itr;
+   fskit_xattr_set* xattr = NULL;
+   fskit_xattr_set* set = NULL;
+   size_t len = 0;
+   int rc = 0;
+
+   if( src->xattrs != NULL ) {
+
+      for( xattr = fskit_xattr_set_begin( &itr, src->xattrs ); xattr != NULL; xattr = fskit_xattr_set_next( &itr ) ) {
+
+         rc = fskit_xattr_set_insert( &set, fskit_xattr_set_name( xattr ), fskit_xattr_set_value( xattr ), fskit_xattr_set_value_len( xattr ), 0 );
+         if( rc != 0 ) {
+
+            fskit_xattr_set_free( set );
+            return rc;
+         }
+      }
+
+      dest->xattrs = set;
+      fskit_usage_add( dest->usage, FSKIT_USAGE_XATTR_BYTES, fskit_entry_xattr_bytes( dest ) );
+      return 0;
+   }
+
+   if( packed == NULL ) {
+      return 0;
+   }
+
+   len = FSKIT_XATTR_PACKED_SIZE( packed->count, packed->value_bytes );
+
+   copy = (struct fskit_xattr_packed*)malloc( len );
+   if( copy == NULL ) {
+      return -ENOMEM;
+   }
+
+   memcpy( copy, packed, len );
+
+   // the copy holds its own references to the names
+   for( uint32_t i = 0; i < copy->count; i++ ) {
+      fskit_xattr_name_dup( copy->attrs[i].name );
+   }
+
+   dest->xattrs_packed = copy;
+   fskit_usage_add( dest->usage, FSKIT_USAGE_XATTR_BYTES, fskit_entry_xattr_bytes( dest ) );
+   return 0;
+}
+
+
+// list an inode's attribute names, each followed by '\0', in sorted order.
+// if list is NULL or size is 0, only find the length.
+// return the length of the list
+// return -ERANGE if list is too small
+// NOTE: fent must be at least read-locked
+int fskit_entry_xattr_list( struct fskit_entry* fent, char* list, size_t size ) {
+
+   struct fskit_xattr_packed* packed = fent->xattrs_packed;
+   fskit_xattr_set_itr itr;
+   fskit_xattr_set* xattr = NULL;
+   size_t total = 0;
+   size_t off = 0;
+   size_t len = 0;
+
+   // find the length
+   if( fent->xattrs != NULL ) {
+
+      for( xattr = fskit_xattr_set_begin( &itr, fent->xattrs ); xattr != NULL; xattr = fskit_xattr_set_next( &itr ) ) {
+         total += strlen( fskit_xattr_set_name( xattr ) ) + 1;
+      }
+   }
+   else if( packed != NULL ) {
+
+      for( uint32_t i = 0; i < packed->count; i++ ) {
+         total += strlen( packed->attrs[i].name ) + 1;
+      }
+   }
+
+   if( list == NULL || size == 0 ) {
+      return (int)total;
+   }
+
+   if( total > size ) {
+      return -ERANGE;
+   }
+
+   // copy the names
+   if( fent->xattrs != NULL ) {
+
+      for( xattr = fskit_xattr_set_begin( &itr, fent->xattrs ); xattr != NULL; xattr = fskit_xattr_set_next( &itr ) ) {
+
+         len = strlen( fskit_xattr_set_name( xattr ) ) + 1;
+         memcpy( list + off, fskit_xattr_set_name( xattr ), len );
+         off += len;
+      }
+   }
+   else if( packed != NULL ) {
+
+      for( uint32_t i = 0; i < packed->count; i++ ) {
+
+         len = strlen( packed->attrs[i].name ) + 1;
+         memcpy( list + off, packed->attrs[i].name, len );
+         off += len;
+      }
+   }
+
+   return (int)total;
+}
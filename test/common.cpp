@@ -244,3 +244,98 @@ int fskit_test_mkdir_LR_recursive( struct fskit_core* core, char const* path, in
 
    return 0;
 }
+
+
+// exit if rc is not what was expected
+void fskit_test_check_rc( char const* what, char const* path, int64_t rc, int64_t expected_rc ) {
+
+   if( rc != expected_rc ) {
+      fskit_error("%s('%s') rc = %" PRId64 ", expected %" PRId64 "\n", what, path, rc, expected_rc );
+      exit(1);
+   }
+}
+
+
+// make and initialize another core, besides the one from fskit_test_begin.  Exit on error.
+struct fskit_core* fskit_test_new_core(void) {
+
+   struct fskit_core* core = fskit_core_new();
+   if( core == NULL ) {
+      exit(1);
+   }
+
+   fskit_test_check_rc( "fskit_core_init", "/", fskit_core_init( core, NULL ), 0 );
+   return core;
+}
+
+
+// count the entries in a directory, besides . and ..
+uint64_t fskit_test_count_children( struct fskit_core* core, char const* path ) {
+
+   int rc = 0;
+   uint64_t num_read = 0;
+   uint64_t count = 0;
+
+   struct fskit_dir_handle* dh = fskit_opendir( core, path, 0, 0, &rc );
+   fskit_test_check_rc( "fskit_opendir", path, rc, 0 );
+
+   struct fskit_dir_entry** dents = fskit_listdir( core, dh, &num_read, &rc );
+   fskit_test_check_rc( "fskit_listdir", path, rc, 0 );
+
+   for( uint64_t i = 0; i < num_read; i++ ) {
+
+      if( strcmp( dents[i]->name, "." ) != 0 && strcmp( dents[i]->name, ".." ) != 0 ) {
+         count++;
+      }
+   }
+
+   fskit_dir_entry_free_list( dents );
+   fskit_closedir( core, dh );
+
+   return count;
+}
+
+
+// check that path looks the same in both cores: type, mode, size, links, number of children and link target.
+// if exact, then the owner, inode number, device and times must match too.  Exit if not.
+void fskit_test_check_same( struct fskit_core* orig, struct fskit_core* other, char const* path, bool exact ) {
+
+   struct stat sb;
+   struct stat sb2;
+   char buf[100];
+   char buf2[100];
+   ssize_t len = 0;
+   ssize_t len2 = 0;
+
+   fskit_test_check_rc( "fskit_stat", path, fskit_stat( orig, path, 0, 0, &sb ), 0 );
+   fskit_test_check_rc( "fskit_stat", path, fskit_stat( other, path, 0, 0, &sb2 ), 0 );
+
+   if( sb.st_mode != sb2.st_mode || sb.st_size != sb2.st_size || sb.st_nlink != sb2.st_nlink ||
+       (exact && (sb.st_uid != sb2.st_uid || sb.st_gid != sb2.st_gid || sb.st_ino != sb2.st_ino || sb.st_rdev != sb2.st_rdev ||
+                  sb.st_mtim.tv_sec != sb2.st_mtim.tv_sec || sb.st_mtim.tv_nsec != sb2.st_mtim.tv_nsec ||
+                  sb.st_atim.tv_sec != sb2.st_atim.tv_sec || sb.st_ctim.tv_sec != sb2.st_ctim.tv_sec)) ) {
+
+      fskit_error("'%s' differs: mode %o/%o, owner %d/%d, group %d/%d, size %jd/%jd, nlink %ju/%ju, ino %ju/%ju, mtime %jd/%jd\n",
+                  path, sb.st_mode, sb2.st_mode, (int)sb.st_uid, (int)sb2.st_uid, (int)sb.st_gid, (int)sb2.st_gid,
+                  (intmax_t)sb.st_size, (intmax_t)sb2.st_size, (uintmax_t)sb.st_nlink, (uintmax_t)sb2.st_nlink,
+                  (uintmax_t)sb.st_ino, (uintmax_t)sb2.st_ino, (intmax_t)sb.st_mtim.tv_sec, (intmax_t)sb2.st_mtim.tv_sec );
+      exit(1);
+   }
+
+   if( S_ISDIR( sb.st_mode ) && fskit_test_count_children( orig, path ) != fskit_test_count_children( other, path ) ) {
+
+      fskit_error("'%s' has %" PRIu64 " children, expected %" PRIu64 "\n", path, fskit_test_count_children( other, path ), fskit_test_count_children( orig, path ) );
+      exit(1);
+   }
+
+   if( S_ISLNK( sb.st_mode ) ) {
+
+      len = fskit_readlink( orig, path, 0, 0, buf, sizeof(buf) );
+      len2 = fskit_readlink( other, path, 0, 0, buf2, sizeof(buf2) );
+
+      if( len < 0 || len != len2 || memcmp( buf, buf2, len ) != 0 ) {
+         fskit_error("'%s' points to '%.*s', expected '%.*s'\n", path, (int)(len2 < 0 ? 0 : len2), buf2, (int)(len < 0 ? 0 : len), buf );
+         exit(1);
+      }
+   }
+}
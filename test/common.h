@@ -33,4 +33,9 @@ int fskit_test_end( struct fskit_core* core, void** test_data );
 
 int fskit_test_mkdir_LR_recursive( struct fskit_core* core, char const* path, int depth );
 
+void fskit_test_check_rc( char const* what, char const* path, int64_t rc, int64_t expected_rc );
+struct fskit_core* fskit_test_new_core(void);
+uint64_t fskit_test_count_children( struct fskit_core* core, char const* path );
+void fskit_test_check_same( struct fskit_core* orig, struct fskit_core* other, char const* path, bool exact );
+
 #endif
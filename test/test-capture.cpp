@@ -0,0 +1,295 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-capture.h"
+
+#ifdef _FSKIT_REPL
+
+#define NUM_DIRS        4
+#define NUM_FILES       8
+#define NUM_THREADS     4
+
+static struct fskit_capture* cap = NULL;
+
+// record a call the way fskit_fuse does
+static void record( uint64_t start, int op, uint64_t handle, char const* path, char const* path2, uint64_t arg0, uint64_t arg1, int64_t rc ) {
+
+   fskit_test_check_rc( "fskit_capture_record", path != NULL ? path : "", fskit_capture_record( cap, start, op, 0, 0, handle, path, path2, arg0, arg1, 0, rc ), 0 );
+}
+
+// make a file, and write two blocks to it
+static void make_file( struct fskit_core* core, char const* path ) {
+
+   char buf[4096];
+   uint64_t start = 0;
+   ssize_t nw = 0;
+   int rc = 0;
+
+   memset( buf, 0, sizeof(buf) );
+
+   start = fskit_capture_begin( cap );
+   struct fskit_file_handle* fh = fskit_create( core, path, 0, 0, 0644, &rc );
+   record( start, FSKIT_CAPTURE_OP_CREATE, (uintptr_t)fh, path, NULL, 0644, 0, rc );
+   fskit_test_check_rc( "fskit_create", path, rc, 0 );
+
+   for( int i = 0; i < 2; i++ ) {
+
+      start = fskit_capture_begin( cap );
+      nw = fskit_write( core, fh, buf, sizeof(buf), i * sizeof(buf) );
+      record( start, FSKIT_CAPTURE_OP_WRITE, (uintptr_t)fh, NULL, NULL, sizeof(buf), i * sizeof(buf), nw );
+   }
+
+   start = fskit_capture_begin( cap );
+   rc = fskit_close( core, fh );
+   record( start, FSKIT_CAPTURE_OP_CLOSE, (uintptr_t)fh, NULL, NULL, 0, 0, rc );
+}
+
+// list a directory
+static void list_dir( struct fskit_core* core, char const* path ) {
+
+   uint64_t start = 0;
+   uint64_t num_read = 0;
+   int rc = 0;
+
+   start = fskit_capture_begin( cap );
+   struct fskit_dir_handle* dh = fskit_opendir( core, path, 0, 0, &rc );
+   record( start, FSKIT_CAPTURE_OP_OPENDIR, (uintptr_t)dh, path, NULL, 0, 0, rc );
+   fskit_test_check_rc( "fskit_opendir", path, rc, 0 );
+
+   start = fskit_capture_begin( cap );
+   struct fskit_dir_entry** dents = fskit_listdir( core, dh, &num_read, &rc );
+   record( start, FSKIT_CAPTURE_OP_READDIR, (uintptr_t)dh, NULL, NULL, num_read, 0, rc );
+   fskit_dir_entry_free_list( dents );
+
+   start = fskit_capture_begin( cap );
+   rc = fskit_closedir( core, dh );
+   record( start, FSKIT_CAPTURE_OP_CLOSEDIR, (uintptr_t)dh, NULL, NULL, 0, 0, rc );
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_core* replayed = NULL;
+   struct fskit_capture_trace trace;
+   struct fskit_repl_replay_stats stats;
+   struct fskit_file_handle* early = NULL;
+   struct stat sb;
+   char path[PATH_MAX];
+   char path2[PATH_MAX];
+   char cap_path[PATH_MAX];
+   char bad_path[PATH_MAX];
+   char cmd[2 * PATH_MAX + 100];
+   uint64_t start = 0;
+   uint64_t expected_recs = 0;
+   int rc = 0;
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   fskit_test_check_rc( "fskit_data_route", "/", fskit_data_route( core, FSKIT_ROUTE_ANY ), 0 );
+
+   snprintf( cap_path, sizeof(cap_path), "/tmp/test-capture-%d.cap", getpid() );
+   snprintf( bad_path, sizeof(bad_path), "/tmp/test-capture-%d.bad", getpid() );
+
+   // not recording yet
+   if( fskit_capture_begin( NULL ) != 0 ) {
+      fskit_error("%s\n", "fskit_capture_begin(NULL) != 0");
+      exit(1);
+   }
+
+   // a handle opened before the capture began; calls on it can't be replayed
+   early = fskit_create( core, "/early", 0, 0, 0644, &rc );
+   fskit_test_check_rc( "fskit_create", "/early", rc, 0 );
+
+   fskit_test_check_rc( "fskit_capture_open", cap_path, fskit_capture_open( &cap, cap_path ), 0 );
+
+   start = fskit_capture_begin( cap );
+   rc = fskit_write( core, early, (char*)"x", 1, 0 );
+   record( start, FSKIT_CAPTURE_OP_WRITE, (uintptr_t)early, NULL, NULL, 1, 0, rc );
+
+   for( int d = 0; d < NUM_DIRS; d++ ) {
+
+      snprintf( path, sizeof(path), "/d%d", d );
+
+      start = fskit_capture_begin( cap );
+      rc = fskit_mkdir( core, path, 0755, 0, 0 );
+      record( start, FSKIT_CAPTURE_OP_MKDIR, 0, path, NULL, 0755, 0, rc );
+      fskit_test_check_rc( "fskit_mkdir", path, rc, 0 );
+
+      for( int f = 0; f < NUM_FILES; f++ ) {
+
+         snprintf( path, sizeof(path), "/d%d/f%d", d, f );
+         make_file( core, path );
+
+         start = fskit_capture_begin( cap );
+         rc = fskit_stat( core, path, 0, 0, &sb );
+         record( start, FSKIT_CAPTURE_OP_STAT, 0, path, NULL, 0, 0, rc );
+
+         start = fskit_capture_begin( cap );
+         rc = fskit_setxattr( core, path, 0, 0, "user.f", "value", 5, 0 );
+         record( start, FSKIT_CAPTURE_OP_SETXATTR, 0, path, "user.f", 5, 0, rc );
+
+         start = fskit_capture_begin( cap );
+         rc = fskit_getxattr( core, path, 0, 0, "user.f", cmd, sizeof(cmd) );
+         record( start, FSKIT_CAPTURE_OP_GETXATTR, 0, path, "user.f", sizeof(cmd), 0, rc );
+      }
+
+      // failures get replayed too
+      snprintf( path, sizeof(path), "/d%d/missing", d );
+
+      start = fskit_capture_begin( cap );
+      rc = fskit_unlink( core, path, 0, 0 );
+      record( start, FSKIT_CAPTURE_OP_UNLINK, 0, path, NULL, 0, 0, rc );
+      fskit_test_check_rc( "fskit_unlink", path, rc, -ENOENT );
+
+      snprintf( path, sizeof(path), "/d%d", d );
+      list_dir( core, path );
+
+      // shrink one, rename one, remove one, link to one
+      snprintf( path, sizeof(path), "/d%d/f0", d );
+
+      start = fskit_capture_begin( cap );
+      rc = fskit_trunc( core, path, 0, 0, 100 );
+      record( start, FSKIT_CAPTURE_OP_TRUNC, 0, path, NULL, 100, 0, rc );
+
+      start = fskit_capture_begin( cap );
+      rc = fskit_chmod( core, path, 0, 0, 0600 );
+      record( start, FSKIT_CAPTURE_OP_CHMOD, 0, path, NULL, 0600, 0, rc );
+
+      snprintf( path2, sizeof(path2), "/d%d/renamed", d );
+
+      start = fskit_capture_begin( cap );
+      rc = fskit_rename( core, path, path2, 0, 0 );
+      record( start, FSKIT_CAPTURE_OP_RENAME, 0, path, path2, 0, 0, rc );
+      fskit_test_check_rc( "fskit_rename", path, rc, 0 );
+
+      snprintf( path, sizeof(path), "/d%d/f1", d );
+
+      start = fskit_capture_begin( cap );
+      rc = fskit_unlink( core, path, 0, 0 );
+      record( start, FSKIT_CAPTURE_OP_UNLINK, 0, path, NULL, 0, 0, rc );
+
+      snprintf( path, sizeof(path), "/d%d/sym", d );
+
+      start = fskit_capture_begin( cap );
+      rc = fskit_symlink( core, "f2", path, 0, 0 );
+      record( start, FSKIT_CAPTURE_OP_SYMLINK, 0, "f2", path, 0, 0, rc );
+   }
+
+   // close the early handle, which the replay doesn't know about either
+   start = fskit_capture_begin( cap );
+   rc = fskit_close( core, early );
+   record( start, FSKIT_CAPTURE_OP_CLOSE, (uintptr_t)early, NULL, NULL, 0, 0, rc );
+
+   expected_recs = fskit_capture_get_count( cap );
+
+   fskit_test_check_rc( "fskit_capture_close", cap_path, fskit_capture_close( cap ), 0 );
+
+   // closed captures don't record
+   if( fskit_capture_begin( cap ) != 0 ) {
+      fskit_error("%s\n", "fskit_capture_begin on a closed capture != 0");
+      exit(1);
+   }
+
+   fskit_capture_free( cap );
+   cap = NULL;
+
+   fskit_test_check_rc( "fskit_capture_trace_load", cap_path, fskit_capture_trace_load( &trace, cap_path ), 0 );
+
+   if( trace.num_recs != expected_recs || trace.recs[1].op != FSKIT_CAPTURE_OP_MKDIR || strcmp( trace.recs[1].path, "/d0" ) != 0 ) {
+      fskit_error("loaded %" PRIu64 " records (expected %" PRIu64 "), second is %s('%s')\n", trace.num_recs, expected_recs,
+                  fskit_capture_op_name( trace.recs[1].op ), trace.recs[1].path );
+      exit(1);
+   }
+
+   // replay into a fresh core, across threads
+   replayed = fskit_test_new_core();
+   fskit_test_check_rc( "fskit_data_route", "/", fskit_data_route( replayed, FSKIT_ROUTE_ANY ), 0 );
+   fskit_test_check_rc( "fskit_repl_replay", cap_path, fskit_repl_replay( replayed, &trace, NUM_THREADS, &stats ), 0 );
+
+   fskit_debug("replayed %" PRIu64 " ops (%" PRIu64 " fences) in %" PRIu64 " ns, captured in %" PRIu64 " ns\n", stats.num_ops, stats.num_fences, stats.elapsed_ns, stats.captured_ns );
+
+   if( stats.num_mismatches != 0 || stats.num_skipped != 2 || stats.num_ops != expected_recs - 2 || stats.num_fences != 2 * NUM_DIRS ) {
+      fskit_error("replay: %" PRIu64 " ops, %" PRIu64 " mismatches, %" PRIu64 " skipped, %" PRIu64 " fences\n", stats.num_ops, stats.num_mismatches, stats.num_skipped, stats.num_fences );
+      exit(1);
+   }
+
+   for( int d = 0; d < NUM_DIRS; d++ ) {
+
+      snprintf( path, sizeof(path), "/d%d", d );
+      fskit_test_check_same( core, replayed, path, false );
+
+      // f0 and f1 are gone
+      for( int f = 2; f < NUM_FILES; f++ ) {
+
+         snprintf( path, sizeof(path), "/d%d/f%d", d, f );
+         fskit_test_check_same( core, replayed, path, false );
+      }
+
+      snprintf( path, sizeof(path), "/d%d/renamed", d );
+      fskit_test_check_same( core, replayed, path, false );
+
+      snprintf( path, sizeof(path), "/d%d/sym", d );
+      fskit_test_check_same( core, replayed, path, false );
+   }
+
+   fskit_capture_trace_free( &trace );
+
+   // a capture cut short loads up to its last whole record
+   snprintf( cmd, sizeof(cmd), "head -c %d '%s' > '%s'", 24 + 88 + 8 + 30, cap_path, bad_path );
+   if( system( cmd ) != 0 ) {
+      exit(1);
+   }
+
+   fskit_test_check_rc( "fskit_capture_trace_load", bad_path, fskit_capture_trace_load( &trace, bad_path ), 0 );
+   fskit_test_check_rc( "fskit_capture_trace_load", bad_path, trace.num_recs, 1 );
+   fskit_capture_trace_free( &trace );
+
+   // not a capture
+   snprintf( cmd, sizeof(cmd), "echo 'not a capture file at all' > '%s'", bad_path );
+   if( system( cmd ) != 0 ) {
+      exit(1);
+   }
+
+   fskit_test_check_rc( "fskit_capture_trace_load", bad_path, fskit_capture_trace_load( &trace, bad_path ), -EINVAL );
+   fskit_test_check_rc( "fskit_capture_trace_load", "/nonexistent", fskit_capture_trace_load( &trace, "/tmp/nonexistent/test-capture.cap" ), -ENOENT );
+
+   unlink( cap_path );
+   unlink( bad_path );
+
+   fskit_detach_all( replayed, "/" );
+   fskit_core_destroy( replayed, NULL );
+   free( replayed );
+
+   fskit_test_end( core, NULL );
+   return 0;
+}
+
+#else
+
+int main( int argc, char** argv ) {
+   printf("no repl support compiled (pass REPL=1 to the main Makefile to enable)\n");
+   return 0;
+}
+
+#endif
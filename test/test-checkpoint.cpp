@@ -0,0 +1,214 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-checkpoint.h"
+
+// make a file with some contents
+static void write_file( struct fskit_core* core, char const* path, char const* contents, size_t len ) {
+
+   int rc = 0;
+   ssize_t nw = 0;
+
+   struct fskit_file_handle* fh = fskit_open( core, path, 0, 0, O_CREAT | O_WRONLY, 0644, &rc );
+   if( fh == NULL ) {
+      fskit_error("fskit_open('%s') rc = %d\n", path, rc );
+      exit(1);
+   }
+
+   nw = fskit_write( core, fh, (char*)contents, len, 0 );
+   if( nw != (ssize_t)len ) {
+      fskit_error("fskit_write('%s') rc = %zd\n", path, nw );
+      exit(1);
+   }
+
+   fskit_close( core, fh );
+}
+
+static void check_xattr( struct fskit_core* core, char const* path, char const* name, char const* value, size_t value_len ) {
+
+   char buf[100];
+   int rc = fskit_getxattr( core, path, 0, 0, name, buf, sizeof(buf) );
+
+   if( rc != (int)value_len || memcmp( buf, value, value_len ) != 0 ) {
+      fskit_error("fskit_getxattr('%s', '%s') rc = %d, expected %zu\n", path, name, rc, value_len );
+      exit(1);
+   }
+}
+
+// write a copy of an image with some bytes replaced, or cut short
+static void write_bad_image( char const* src, char const* dest, off_t offset, char const* bytes, size_t len, off_t truncate_to ) {
+
+   char cmd[1000];
+   int fd = 0;
+
+   snprintf( cmd, sizeof(cmd), "cp '%s' '%s'", src, dest );
+   if( system( cmd ) != 0 ) {
+      exit(1);
+   }
+
+   fd = open( dest, O_RDWR );
+   if( fd < 0 ) {
+      exit(1);
+   }
+
+   if( len > 0 && pwrite( fd, bytes, len, offset ) != (ssize_t)len ) {
+      exit(1);
+   }
+
+   if( truncate_to >= 0 && ftruncate( fd, truncate_to ) != 0 ) {
+      exit(1);
+   }
+
+   close( fd );
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_core* restored = NULL;
+   struct fskit_core* bad = NULL;
+   struct utimbuf times;
+   struct stat sb;
+   char image_path[PATH_MAX];
+   char bad_path[PATH_MAX];
+   char const* paths[] = { "/", "/d1", "/d1/f1", "/d1/hard", "/d1/sub", "/d1/sub/f2", "/d2", "/sym", "/fifo", "/chr", NULL };
+   int rc = 0;
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_data_route( core, FSKIT_ROUTE_ANY );
+   if( rc != 0 ) {
+      fskit_error("fskit_data_route rc = %d\n", rc );
+      exit(1);
+   }
+
+   snprintf( image_path, sizeof(image_path), "/tmp/test-checkpoint-%d.img", getpid() );
+   snprintf( bad_path, sizeof(bad_path), "/tmp/test-checkpoint-%d.bad", getpid() );
+
+   // /{d1/{f1, hard, sub/f2}, d2, sym, fifo, chr}
+   fskit_test_check_rc( "fskit_mkdir", "/d1", fskit_mkdir( core, "/d1", 0750, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mkdir", "/d1/sub", fskit_mkdir( core, "/d1/sub", 0700, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mkdir", "/d2", fskit_mkdir( core, "/d2", 0755, 0, 0 ), 0 );
+
+   fskit_test_check_rc( "fskit_chown", "/d1/sub", fskit_chown( core, "/d1/sub", 0, 0, 1, 2 ), 0 );
+
+   write_file( core, "/d1/f1", "hello", 5 );
+   write_file( core, "/d1/sub/f2", "world!", 6 );
+
+   fskit_test_check_rc( "fskit_link", "/d1/hard", fskit_link( core, "/d1/f1", "/d1/hard", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_symlink", "/sym", fskit_symlink( core, "d1/f1", "/sym", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mknod", "/fifo", fskit_mknod( core, "/fifo", S_IFIFO | 0600, 0, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mknod", "/chr", fskit_mknod( core, "/chr", S_IFCHR | 0660, 259, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_chmod", "/d1/f1", fskit_chmod( core, "/d1/f1", 0, 0, 0640 ), 0 );
+
+   times.actime = 1000000;
+   times.modtime = 2000000;
+   fskit_test_check_rc( "fskit_utime", "/d1/sub/f2", fskit_utime( core, "/d1/sub/f2", 0, 0, &times ), 0 );
+
+   fskit_test_check_rc( "fskit_setxattr", "/", fskit_setxattr( core, "/", 0, 0, "user.root", "top", 3, 0 ), 0 );
+   fskit_test_check_rc( "fskit_setxattr", "/d1/f1", fskit_setxattr( core, "/d1/f1", 0, 0, "user.a", "alpha", 5, 0 ), 0 );
+   fskit_test_check_rc( "fskit_setxattr", "/d1/f1", fskit_setxattr( core, "/d1/f1", 0, 0, "user.empty", "", 0, 0 ), 0 );
+
+   // removed entries don't get saved
+   write_file( core, "/d2/gone", "x", 1 );
+   fskit_test_check_rc( "fskit_unlink", "/d2/gone", fskit_unlink( core, "/d2/gone", 0, 0 ), 0 );
+
+   fskit_test_check_rc( "fskit_core_checkpoint", image_path, fskit_core_checkpoint( core, image_path ), 0 );
+
+   // restore into a fresh core, and compare
+   restored = fskit_test_new_core();
+   fskit_test_check_rc( "fskit_core_restore", image_path, fskit_core_restore( restored, image_path ), 0 );
+
+   for( int i = 0; paths[i] != NULL; i++ ) {
+      fskit_test_check_same( core, restored, paths[i], true );
+   }
+
+   check_xattr( restored, "/", "user.root", "top", 3 );
+   check_xattr( restored, "/d1/f1", "user.a", "alpha", 5 );
+   check_xattr( restored, "/d1/hard", "user.empty", "", 0 );
+
+   // the hard link is still one inode
+   fskit_test_check_rc( "fskit_setxattr", "/d1/hard", fskit_setxattr( restored, "/d1/hard", 0, 0, "user.b", "beta", 4, 0 ), 0 );
+   check_xattr( restored, "/d1/f1", "user.b", "beta", 4 );
+
+   // the restored namespace can be changed and torn down
+   fskit_test_check_rc( "fskit_mkdir", "/d1/sub/new", fskit_mkdir( restored, "/d1/sub/new", 0755, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_rename", "/d1/sub", fskit_rename( restored, "/d1/sub", "/d2/sub", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_rmdir", "/d2/sub/new", fskit_rmdir( restored, "/d2/sub/new", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_unlink", "/d1/f1", fskit_unlink( restored, "/d1/f1", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_stat", "/d1/hard", fskit_stat( restored, "/d1/hard", 0, 0, &sb ), 0 );
+
+   if( sb.st_nlink != 1 ) {
+      fskit_error("'/d1/hard' has %ju links, expected 1\n", (uintmax_t)sb.st_nlink );
+      exit(1);
+   }
+
+   // only into an empty root
+   fskit_test_check_rc( "fskit_core_restore", image_path, fskit_core_restore( restored, image_path ), -ENOTEMPTY );
+
+   // not an image
+   bad = fskit_test_new_core();
+
+   write_bad_image( image_path, bad_path, 0, "NOTANIMG", 8, -1 );
+   fskit_test_check_rc( "fskit_core_restore", bad_path, fskit_core_restore( bad, bad_path ), -EINVAL );
+
+   // cut short
+   fskit_test_check_rc( "fskit_stat", "/", stat( image_path, &sb ), 0 );
+   write_bad_image( image_path, bad_path, 0, NULL, 0, sb.st_size - 8 );
+   fskit_test_check_rc( "fskit_core_restore", bad_path, fskit_core_restore( bad, bad_path ), -EIO );
+
+   write_bad_image( image_path, bad_path, 0, NULL, 0, sb.st_size / 2 );
+   fskit_test_check_rc( "fskit_core_restore", bad_path, fskit_core_restore( bad, bad_path ), -EIO );
+
+   // a directory entry that points out of the image: the root's first one, which follows the root record and
+   // its one xattr (user.root = top)
+   write_bad_image( image_path, bad_path, 32 + 112 + 8 + 16 + 8, "\xff\xff\xff\x7f", 4, -1 );
+   fskit_test_check_rc( "fskit_core_restore", bad_path, fskit_core_restore( bad, bad_path ), -EIO );
+
+   fskit_test_check_rc( "fskit_core_restore", "/nonexistent", fskit_core_restore( bad, "/tmp/nonexistent/test-checkpoint.img" ), -ENOENT );
+
+   // a failed restore leaves the core as it was
+   if( fskit_test_count_children( bad, "/" ) != 0 ) {
+      fskit_error("%s\n", "failed restores left entries behind" );
+      exit(1);
+   }
+
+   fskit_test_check_rc( "fskit_core_restore", image_path, fskit_core_restore( bad, image_path ), 0 );
+   fskit_test_check_same( core, bad, "/d1/sub/f2", true );
+
+   unlink( image_path );
+   unlink( bad_path );
+
+   fskit_detach_all( restored, "/" );
+   fskit_core_destroy( restored, NULL );
+   free( restored );
+
+   fskit_detach_all( bad, "/" );
+   fskit_core_destroy( bad, NULL );
+   free( bad );
+
+   fskit_test_end( core, NULL );
+
+   return 0;
+}
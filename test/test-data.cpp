@@ -0,0 +1,250 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-data.h"
+
+#define NUM_THREADS     4
+#define THREAD_PAGES    64
+
+struct writer_args {
+   struct fskit_core* core;
+   struct fskit_file_handle* fh;
+   int id;
+};
+
+// check the file's size, and that reading [offset, offset + len) gives expected (NULL for zeros)
+static void check_read( struct fskit_core* core, struct fskit_file_handle* fh, off_t offset, size_t len, char const* expected, ssize_t expected_rc ) {
+
+   char* buf = (char*)malloc( len + 1 );
+   ssize_t rc = 0;
+
+   if( buf == NULL ) {
+      exit(1);
+   }
+
+   memset( buf, 'X', len + 1 );
+
+   rc = fskit_read( core, fh, buf, len, offset );
+   if( rc != expected_rc ) {
+      fskit_error("fskit_read(%zu @ %jd) rc = %zd, expected %zd\n", len, (intmax_t)offset, rc, expected_rc );
+      exit(1);
+   }
+
+   for( ssize_t i = 0; i < rc; i++ ) {
+
+      char c = (expected != NULL ? expected[i] : 0);
+      if( buf[i] != c ) {
+         fskit_error("fskit_read(%zu @ %jd): byte %zd is %d, expected %d\n", len, (intmax_t)offset, i, buf[i], c );
+         exit(1);
+      }
+   }
+
+   free( buf );
+}
+
+static void check_size( struct fskit_core* core, char const* path, off_t size ) {
+
+   struct stat sb;
+
+   int rc = fskit_stat( core, path, 0, 0, &sb );
+   if( rc != 0 ) {
+      fskit_error("fskit_stat('%s') rc = %d\n", path, rc );
+      exit(1);
+   }
+
+   if( sb.st_size != size ) {
+      fskit_error("'%s' has size %jd, expected %jd\n", path, (intmax_t)sb.st_size, (intmax_t)size );
+      exit(1);
+   }
+}
+
+static void do_write( struct fskit_core* core, struct fskit_file_handle* fh, char const* buf, size_t len, off_t offset ) {
+
+   ssize_t rc = fskit_write( core, fh, buf, len, offset );
+   if( rc != (ssize_t)len ) {
+      fskit_error("fskit_write(%zu @ %jd) rc = %zd\n", len, (intmax_t)offset, rc );
+      exit(1);
+   }
+}
+
+// fill every NUM_THREADS'th page, starting at page id, with the byte 'a' + id
+static void* writer_main( void* arg ) {
+
+   struct writer_args* args = (struct writer_args*)arg;
+   char page[FSKIT_DATA_PAGE_SIZE];
+
+   memset( page, 'a' + args->id, FSKIT_DATA_PAGE_SIZE );
+
+   for( int i = args->id; i < THREAD_PAGES * NUM_THREADS; i += NUM_THREADS ) {
+      do_write( args->core, args->fh, page, FSKIT_DATA_PAGE_SIZE, (off_t)i * FSKIT_DATA_PAGE_SIZE );
+   }
+
+   return NULL;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   int rc;
+   void* output = NULL;
+   struct fskit_file_handle* fh = NULL;
+   struct fskit_entry* fent = NULL;
+   char buf[3 * FSKIT_DATA_PAGE_SIZE];
+   char expected[3 * FSKIT_DATA_PAGE_SIZE];
+   pthread_t threads[NUM_THREADS];
+   struct writer_args args[NUM_THREADS];
+   off_t far = (off_t)1 << 40;
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_data_route( core, FSKIT_ROUTE_ANY );
+   if( rc != 0 ) {
+      fskit_error("fskit_data_route rc = %d\n", rc );
+      exit(1);
+   }
+
+   fh = fskit_open( core, "/file", 0, 0, O_CREAT | O_RDWR, 0644, &rc );
+   if( fh == NULL ) {
+      fskit_error("fskit_open('/file') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fent = fskit_file_handle_get_entry( fh );
+
+   // empty
+   check_read( core, fh, 0, 10, NULL, 0 );
+
+   // a write that straddles a page boundary
+   for( unsigned int i = 0; i < sizeof(buf); i++ ) {
+      buf[i] = 'A' + (i % 26);
+   }
+
+   do_write( core, fh, buf, 100, FSKIT_DATA_PAGE_SIZE - 50 );
+   check_size( core, "/file", FSKIT_DATA_PAGE_SIZE + 50 );
+
+   memset( expected, 0, sizeof(expected) );
+   memcpy( expected + FSKIT_DATA_PAGE_SIZE - 50, buf, 100 );
+
+   check_read( core, fh, 0, sizeof(buf), expected, FSKIT_DATA_PAGE_SIZE + 50 );
+   check_read( core, fh, FSKIT_DATA_PAGE_SIZE - 50, 100, buf, 100 );
+
+   if( fskit_data_get_allocated( fent ) != 2 * FSKIT_DATA_PAGE_SIZE ) {
+      fskit_error("allocated %" PRIu64 " bytes, expected %ld\n", fskit_data_get_allocated( fent ), 2 * FSKIT_DATA_PAGE_SIZE );
+      exit(1);
+   }
+
+   // overwrite in place
+   do_write( core, fh, "hello", 5, 10 );
+   memcpy( expected + 10, "hello", 5 );
+   check_read( core, fh, 0, sizeof(buf), expected, FSKIT_DATA_PAGE_SIZE + 50 );
+
+   // far past the end: the file is sparse, and the hole reads as zeros
+   do_write( core, fh, "end", 3, far );
+   check_size( core, "/file", far + 3 );
+   check_read( core, fh, far - 5, 8, "\0\0\0\0\0end", 8 );
+   check_read( core, fh, far / 2, 100, NULL, 100 );
+   check_read( core, fh, far + 3, 10, NULL, 0 );
+
+   if( fskit_data_get_allocated( fent ) != 3 * FSKIT_DATA_PAGE_SIZE ) {
+      fskit_error("allocated %" PRIu64 " bytes, expected %ld\n", fskit_data_get_allocated( fent ), 3 * FSKIT_DATA_PAGE_SIZE );
+      exit(1);
+   }
+
+   // the earlier data survived the tree growing
+   check_read( core, fh, 0, sizeof(buf), expected, sizeof(buf) );
+
+   // shrink into the middle of a page, then grow again: the cut-off bytes are gone
+   rc = fskit_ftrunc( core, fh, 12 );
+   if( rc != 0 ) {
+      fskit_error("fskit_ftrunc(12) rc = %d\n", rc );
+      exit(1);
+   }
+
+   check_size( core, "/file", 12 );
+   check_read( core, fh, 0, 100, expected, 12 );
+
+   if( fskit_data_get_allocated( fent ) != FSKIT_DATA_PAGE_SIZE ) {
+      fskit_error("allocated %" PRIu64 " bytes after truncate, expected %ld\n", fskit_data_get_allocated( fent ), FSKIT_DATA_PAGE_SIZE );
+      exit(1);
+   }
+
+   rc = fskit_trunc( core, "/file", 0, 0, 2 * FSKIT_DATA_PAGE_SIZE );
+   if( rc != 0 ) {
+      fskit_error("fskit_trunc(grow) rc = %d\n", rc );
+      exit(1);
+   }
+
+   check_size( core, "/file", 2 * FSKIT_DATA_PAGE_SIZE );
+
+   memset( expected + 12, 0, sizeof(expected) - 12 );
+   check_read( core, fh, 0, sizeof(buf), expected, 2 * FSKIT_DATA_PAGE_SIZE );
+
+   rc = fskit_ftrunc( core, fh, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_ftrunc(0) rc = %d\n", rc );
+      exit(1);
+   }
+
+   check_read( core, fh, 0, 100, NULL, 0 );
+
+   if( fskit_data_get_allocated( fent ) != 0 ) {
+      fskit_error("allocated %" PRIu64 " bytes after truncate to 0\n", fskit_data_get_allocated( fent ) );
+      exit(1);
+   }
+
+   // concurrent writers to different pages
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+
+      args[i].core = core;
+      args[i].fh = fh;
+      args[i].id = i;
+
+      pthread_create( &threads[i], NULL, writer_main, &args[i] );
+   }
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   check_size( core, "/file", (off_t)THREAD_PAGES * NUM_THREADS * FSKIT_DATA_PAGE_SIZE );
+
+   for( int i = 0; i < THREAD_PAGES * NUM_THREADS; i++ ) {
+
+      memset( expected, 'a' + (i % NUM_THREADS), FSKIT_DATA_PAGE_SIZE );
+      check_read( core, fh, (off_t)i * FSKIT_DATA_PAGE_SIZE, FSKIT_DATA_PAGE_SIZE, expected, FSKIT_DATA_PAGE_SIZE );
+   }
+
+   fskit_close( core, fh );
+
+   // the pages go away with the file
+   rc = fskit_unlink( core, "/file", 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_unlink('/file') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fskit_test_end( core, &output );
+
+   return 0;
+}
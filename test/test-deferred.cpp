@@ -0,0 +1,111 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-deferred.h"
+
+static int num_destroyed = 0;
+
+int destroy_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, void* inode_data ) {
+   fskit_debug("Destroy %" PRIX64 " (%s)\n", fskit_entry_get_file_id( fent ), fskit_route_metadata_get_path( route_metadata ) );
+   __sync_fetch_and_add( &num_destroyed, 1 );
+   return 0;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   int rc;
+   void* output;
+   struct fskit_entry* fent = NULL;
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_route_destroy( core, FSKIT_ROUTE_ANY, destroy_cb, FSKIT_CONCURRENT );
+   if( rc < 0 ) {
+      fskit_error("fskit_route_destroy rc = %d\n", rc );
+      exit(1);
+   }
+
+   // 2^6 - 1 directories
+   rc = fskit_test_mkdir_LR_recursive( core, "/root", 6 );
+   if( rc != 0 ) {
+      fskit_error("fskit_test_mkdir_LR_recursive('/root') rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_deferred_set_threads( core, 2 );
+   if( rc != 0 ) {
+      fskit_error("fskit_deferred_set_threads rc = %d\n", rc );
+      exit(1);
+   }
+
+   fskit_deferred_set_max_pending( core, 1 );
+
+   // only removes empty directories
+   rc = fskit_deferred_remove( core, "/root", NULL );
+   if( rc != -ENOTEMPTY ) {
+      fskit_error("fskit_deferred_remove('/root') rc = %d\n", rc );
+      exit(1);
+   }
+
+   // must match the given entry
+   rc = fskit_deferred_remove_all( core, "/root/L", fskit_core_get_root( core ) );
+   if( rc != -ENOENT ) {
+      fskit_error("fskit_deferred_remove_all('/root/L', /) rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_deferred_remove( core, "/root/L/L/L/L/L", NULL );
+   if( rc != 0 ) {
+      fskit_error("fskit_deferred_remove('/root/L/L/L/L/L') rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_deferred_remove_all( core, "/root", NULL );
+   if( rc != 0 ) {
+      fskit_error("fskit_deferred_remove_all('/root') rc = %d\n", rc );
+      exit(1);
+   }
+
+   // gone immediately...
+   fent = fskit_entry_resolve_path( core, "/root", 0, 0, false, &rc );
+   if( fent != NULL || rc != -ENOENT ) {
+      fskit_error("fskit_entry_resolve_path('/root') rc = %d\n", rc );
+      exit(1);
+   }
+
+   // ...and reclaimed eventually
+   fskit_deferred_wait( core );
+
+   if( fskit_deferred_get_pending( core ) != 0 || num_destroyed != 63 ) {
+      fskit_error("pending = %" PRIu64 ", destroyed = %d\n", fskit_deferred_get_pending( core ), num_destroyed );
+      exit(1);
+   }
+
+   fskit_print_tree( stdout, fskit_core_get_root( core ) );
+
+   fskit_test_end( core, &output );
+
+   return 0;
+}
@@ -0,0 +1,130 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-detach.h"
+
+static int num_destroyed = 0;
+
+int destroy_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, void* inode_data ) {
+   fskit_debug("Destroy %" PRIX64 " (%s)\n", fskit_entry_get_file_id( fent ), fskit_route_metadata_get_path( route_metadata ) );
+   __sync_fetch_and_add( &num_destroyed, 1 );
+   return 0;
+}
+
+// like fskit_detach_all, but with the given number of threads
+int fskit_test_detach_all( struct fskit_core* core, char const* path, int num_threads ) {
+
+   int rc = 0;
+   struct fskit_detach_ctx* ctx = NULL;
+   fskit_entry_set* children = NULL;
+
+   struct fskit_entry* dent = fskit_entry_resolve_path( core, path, 0, 0, true, &rc );
+   if( dent == NULL ) {
+      fskit_error("fskit_entry_resolve_path('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   rc = fskit_entry_tag_garbage( dent, &children );
+   fskit_entry_unlock( dent );
+
+   if( rc != 0 ) {
+      fskit_error("fskit_entry_tag_garbage('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   ctx = fskit_detach_ctx_new();
+   if( ctx == NULL ) {
+      return -ENOMEM;
+   }
+
+   fskit_detach_ctx_init( ctx );
+
+   rc = fskit_detach_ctx_set_threads( ctx, num_threads );
+   if( rc != 0 ) {
+      fskit_error("fskit_detach_ctx_set_threads(%d) rc = %d\n", num_threads, rc );
+      return rc;
+   }
+
+   rc = fskit_detach_all_ex( core, path, &children, ctx );
+   if( rc != 0 ) {
+      fskit_error("fskit_detach_all_ex('%s') rc = %d\n", path, rc );
+   }
+
+   fskit_entry_set_free( children );
+   fskit_detach_ctx_free( ctx );
+   free( ctx );
+
+   return rc;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   int rc;
+   void* output;
+   int num_serial = 0;
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_route_destroy( core, FSKIT_ROUTE_ANY, destroy_cb, FSKIT_CONCURRENT );
+   if( rc < 0 ) {
+      fskit_error("fskit_route_destroy rc = %d\n", rc );
+      exit(1);
+   }
+
+   // two identical trees of 2^8 - 1 directories
+   rc = fskit_test_mkdir_LR_recursive( core, "/serial", 8 );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_test_mkdir_LR_recursive( core, "/parallel", 8 );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_test_detach_all( core, "/serial", 1 );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   num_serial = num_destroyed;
+
+   rc = fskit_test_detach_all( core, "/parallel", 8 );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   // everything below each root is destroyed, either way
+   if( num_serial != 254 || num_destroyed - num_serial != num_serial ) {
+      fskit_error("serial destroyed %d, parallel destroyed %d\n", num_serial, num_destroyed - num_serial );
+      exit(1);
+   }
+
+   fskit_print_tree( stdout, fskit_core_get_root( core ) );
+
+   fskit_test_end( core, &output );
+
+   return 0;
+}
@@ -0,0 +1,282 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-lock.h"
+
+#include <sched.h>
+
+#define NUM_THREADS 4
+#define NUM_ITERS 20000
+#define NUM_ROUNDS 100000
+#define ROUND_READS 4
+
+struct lock_state {
+   struct fskit_entry* fent;
+   struct fskit_file_handle* fh;
+   volatile int in_write;
+   volatile uint64_t count;
+   int errors;
+   int order;
+   int writer_order;
+   int reader_order;
+   pthread_barrier_t round;
+};
+
+// bump the count twice under the inode write lock, so readers can catch a torn update
+void* writer_main( void* arg ) {
+
+   struct lock_state* state = (struct lock_state*)arg;
+
+   for( int i = 0; i < NUM_ITERS; i++ ) {
+
+      fskit_entry_wlock( state->fent );
+
+      state->in_write = 1;
+      state->count++;
+
+      if( (i & 255) == 0 ) {
+         sched_yield();
+      }
+
+      state->count++;
+      state->in_write = 0;
+
+      fskit_entry_unlock( state->fent );
+   }
+
+   return NULL;
+}
+
+// make sure no writer is ever inside while we hold the read lock
+void* reader_main( void* arg ) {
+
+   struct lock_state* state = (struct lock_state*)arg;
+
+   for( int i = 0; i < NUM_ITERS; i++ ) {
+
+      fskit_entry_rlock( state->fent );
+
+      if( state->in_write || (state->count & 1) ) {
+         __sync_fetch_and_add( &state->errors, 1 );
+      }
+
+      fskit_entry_unlock( state->fent );
+   }
+
+   return NULL;
+}
+
+// bump the count under the file handle's write lock
+void* handle_main( void* arg ) {
+
+   struct lock_state* state = (struct lock_state*)arg;
+
+   for( int i = 0; i < NUM_ITERS; i++ ) {
+
+      fskit_file_handle_wlock( state->fh );
+      state->count++;
+      fskit_file_handle_unlock( state->fh );
+   }
+
+   return NULL;
+}
+
+// take the write lock, and note when we got it
+void* ordered_writer_main( void* arg ) {
+
+   struct lock_state* state = (struct lock_state*)arg;
+
+   fskit_entry_wlock( state->fent );
+   state->writer_order = __sync_add_and_fetch( &state->order, 1 );
+   fskit_entry_unlock( state->fent );
+
+   return NULL;
+}
+
+// take the read lock, and note when we got it
+void* ordered_reader_main( void* arg ) {
+
+   struct lock_state* state = (struct lock_state*)arg;
+
+   fskit_entry_rlock( state->fent );
+   state->reader_order = __sync_add_and_fetch( &state->order, 1 );
+   fskit_entry_unlock( state->fent );
+
+   return NULL;
+}
+
+// one contended write lock per round
+void* round_writer_main( void* arg ) {
+
+   struct lock_state* state = (struct lock_state*)arg;
+
+   for( int r = 0; r < NUM_ROUNDS; r++ ) {
+
+      pthread_barrier_wait( &state->round );
+
+      fskit_entry_wlock( state->fent );
+      state->count++;
+      fskit_entry_unlock( state->fent );
+
+      pthread_barrier_wait( &state->round );
+   }
+
+   return NULL;
+}
+
+// a few read locks per round.  If a reader misses its wakeup, nobody locks the inode again that round, and it hangs.
+void* round_reader_main( void* arg ) {
+
+   struct lock_state* state = (struct lock_state*)arg;
+
+   for( int r = 0; r < NUM_ROUNDS; r++ ) {
+
+      pthread_barrier_wait( &state->round );
+
+      for( int i = 0; i < ROUND_READS; i++ ) {
+         fskit_entry_rlock( state->fent );
+         fskit_entry_unlock( state->fent );
+      }
+
+      pthread_barrier_wait( &state->round );
+   }
+
+   return NULL;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct lock_state state;
+   pthread_t threads[ 2 * NUM_THREADS ];
+   int rc = 0;
+
+   memset( &state, 0, sizeof(state) );
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   state.fh = fskit_create( core, "/f", 0, 0, 0644, &rc );
+   if( state.fh == NULL ) {
+      fskit_error("fskit_create('/f') rc = %d\n", rc );
+      exit(1);
+   }
+
+   state.fent = fskit_file_handle_get_entry( state.fh );
+
+   // readers and writers on one inode
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_create( &threads[i], NULL, writer_main, &state );
+      pthread_create( &threads[NUM_THREADS + i], NULL, reader_main, &state );
+   }
+
+   for( int i = 0; i < 2 * NUM_THREADS; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   if( state.errors != 0 ) {
+      fskit_error("%d readers saw a writer\n", state.errors );
+      exit(1);
+   }
+
+   if( state.count != 2 * NUM_THREADS * NUM_ITERS ) {
+      fskit_error("count = %" PRIu64 ", expected %d\n", state.count, 2 * NUM_THREADS * NUM_ITERS );
+      exit(1);
+   }
+
+   // writers on one handle
+   state.count = 0;
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_create( &threads[i], NULL, handle_main, &state );
+   }
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   if( state.count != NUM_THREADS * NUM_ITERS ) {
+      fskit_error("handle count = %" PRIu64 ", expected %d\n", state.count, NUM_THREADS * NUM_ITERS );
+      exit(1);
+   }
+
+   // rounds of readers racing contended writers.  A lost wakeup leaves a reader asleep on a free lock, so let the
+   // alarm kill us if that happens.
+   state.count = 0;
+   pthread_barrier_init( &state.round, NULL, 2 * NUM_THREADS );
+   alarm( 120 );
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_create( &threads[i], NULL, (i & 1) ? round_writer_main : round_reader_main, &state );
+      pthread_create( &threads[NUM_THREADS + i], NULL, round_reader_main, &state );
+   }
+
+   for( int i = 0; i < 2 * NUM_THREADS; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   alarm( 0 );
+   pthread_barrier_destroy( &state.round );
+
+   if( state.count != (NUM_THREADS / 2) * NUM_ROUNDS ) {
+      fskit_error("round count = %" PRIu64 ", expected %d\n", state.count, (NUM_THREADS / 2) * NUM_ROUNDS );
+      exit(1);
+   }
+
+   // a waiting writer holds off new readers
+   fskit_entry_rlock( state.fent );
+
+   pthread_create( &threads[0], NULL, ordered_writer_main, &state );
+   usleep( 100000 );
+
+   pthread_create( &threads[1], NULL, ordered_reader_main, &state );
+   usleep( 100000 );
+
+   if( state.order != 0 ) {
+      fskit_error("order = %d while read-locked, expected 0\n", state.order );
+      exit(1);
+   }
+
+   fskit_entry_unlock( state.fent );
+
+   pthread_join( threads[0], NULL );
+   pthread_join( threads[1], NULL );
+
+   if( state.writer_order != 1 || state.reader_order != 2 ) {
+      fskit_error("writer got the lock %dth, reader %dth; expected writer first\n", state.writer_order, state.reader_order );
+      exit(1);
+   }
+
+   rc = fskit_close( core, state.fh );
+   if( rc != 0 ) {
+      fskit_error("fskit_close rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_test_end( core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   return 0;
+}
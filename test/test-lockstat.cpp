@@ -0,0 +1,182 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-lockstat.h"
+
+#define NUM_LOCKS 1000
+#define HOLD_USEC 50000
+
+static int reader_line = 0;
+
+// read-lock an entry that the main thread holds write-locked
+void* reader_main( void* arg ) {
+
+   struct fskit_entry* fent = (struct fskit_entry*)arg;
+
+   reader_line = __LINE__ + 1;
+   fskit_entry_rlock( fent );
+   fskit_entry_unlock( fent );
+
+   return NULL;
+}
+
+// find the counts for an entry lock taken in this file at the given line
+static struct fskit_lockstat_site* find_site( struct fskit_lockstat_site* sites, size_t num_sites, int line, bool write ) {
+
+   for( size_t i = 0; i < num_sites; i++ ) {
+      if( sites[i].lock_class == FSKIT_LOCK_CLASS_ENTRY && sites[i].line == line && sites[i].write == write && strstr( sites[i].file, "test-lockstat.cpp" ) != NULL ) {
+         return &sites[i];
+      }
+   }
+
+   return NULL;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_entry* fent = NULL;
+   struct fskit_lockstat_site* sites = NULL;
+   struct fskit_lockstat_site* site = NULL;
+   size_t num_sites = 0;
+   pthread_t reader;
+   int loop_line = 0;
+   int wlock_line = 0;
+   FILE* out = NULL;
+   char* dump = NULL;
+   size_t dump_len = 0;
+   int rc = 0;
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_mkdir( core, "/a", 0755, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir('/a') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fent = fskit_entry_resolve_path( core, "/a", 0, 0, false, &rc );
+   if( fent == NULL ) {
+      fskit_error("fskit_entry_resolve_path('/a') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fskit_entry_unlock( fent );
+
+   // nothing is counted while disabled
+   if( fskit_lockstat_get_enabled() ) {
+      fskit_error("%s", "lockstat enabled by default\n");
+      exit(1);
+   }
+
+   fskit_lockstat_set_enabled( true );
+
+   // uncontended
+   for( int i = 0; i < NUM_LOCKS; i++ ) {
+      loop_line = __LINE__ + 1;
+      fskit_entry_rlock( fent );
+      fskit_entry_unlock( fent );
+   }
+
+   // contended, from a thread that exits before we look
+   wlock_line = __LINE__ + 1;
+   fskit_entry_wlock( fent );
+
+   pthread_create( &reader, NULL, reader_main, fent );
+   usleep( HOLD_USEC );
+
+   fskit_entry_unlock( fent );
+   pthread_join( reader, NULL );
+
+   rc = fskit_lockstat_snapshot( &sites, &num_sites );
+   if( rc != 0 ) {
+      fskit_error("fskit_lockstat_snapshot rc = %d\n", rc );
+      exit(1);
+   }
+
+   site = find_site( sites, num_sites, loop_line, false );
+   if( site == NULL || site->acquired != NUM_LOCKS || site->contended != 0 || site->wait_ns != 0 ) {
+      fskit_error("loop site: %p, acquired %" PRIu64 ", expected %d uncontended\n", site, site != NULL ? site->acquired : 0, NUM_LOCKS );
+      exit(1);
+   }
+
+   site = find_site( sites, num_sites, wlock_line, true );
+   if( site == NULL || site->acquired != 1 || site->contended != 0 ) {
+      fskit_error("wlock site: %p, expected 1 uncontended\n", site );
+      exit(1);
+   }
+
+   site = find_site( sites, num_sites, reader_line, false );
+   if( site == NULL || site->acquired != 1 || site->contended != 1 || site->max_wait_ns < (HOLD_USEC / 2) * 1000ULL || site->wait_ns != site->max_wait_ns ) {
+      fskit_error("reader site: %p, expected 1 contended for at least %d us\n", site, HOLD_USEC / 2 );
+      exit(1);
+   }
+
+   // most waiting first
+   if( &sites[0] != site ) {
+      fskit_error("first site is %s:%d, expected the reader\n", sites[0].file, sites[0].line );
+      exit(1);
+   }
+
+   free( sites );
+
+   // the table names every site
+   out = open_memstream( &dump, &dump_len );
+   if( out == NULL ) {
+      exit(1);
+   }
+
+   rc = fskit_lockstat_dump( out );
+   fclose( out );
+
+   if( rc != 0 || strstr( dump, "test-lockstat.cpp" ) == NULL || strstr( dump, "entry" ) == NULL ) {
+      fskit_error("fskit_lockstat_dump rc = %d\n%s\n", rc, dump );
+      exit(1);
+   }
+
+   printf("%s", dump );
+   free( dump );
+
+   // reset, then turn off
+   fskit_lockstat_reset();
+   fskit_lockstat_set_enabled( false );
+
+   fskit_entry_rlock( fent );
+   fskit_entry_unlock( fent );
+
+   rc = fskit_lockstat_snapshot( &sites, &num_sites );
+   if( rc != 0 || num_sites != 0 ) {
+      fskit_error("fskit_lockstat_snapshot rc = %d, %zu sites after reset\n", rc, num_sites );
+      exit(1);
+   }
+
+   free( sites );
+
+   rc = fskit_test_end( core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   return 0;
+}
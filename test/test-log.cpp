@@ -0,0 +1,284 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-log.h"
+
+#include <sys/wait.h>
+
+#define NUM_THREADS 4
+#define NUM_MESSAGES 100
+#define NUM_FLOOD 5000
+
+static int log_fd = -1;
+
+// send log messages to the capture file
+static void capture_begin(void) {
+
+   ftruncate( log_fd, 0 );
+   lseek( log_fd, 0, SEEK_SET );
+
+   fskit_log_set_fd( log_fd );
+}
+
+// stop capturing, and get what was logged.  Log messages go to stderr again.
+static char* capture_end(void) {
+
+   struct stat sb;
+   char* buf = NULL;
+
+   fskit_log_set_fd( STDERR_FILENO );
+
+   fstat( log_fd, &sb );
+
+   buf = (char*)calloc( sb.st_size + 1, 1 );
+   if( buf == NULL ) {
+      exit(1);
+   }
+
+   pread( log_fd, buf, sb.st_size, 0 );
+   return buf;
+}
+
+// count lines containing needle
+static int count_lines( char const* buf, char const* needle ) {
+
+   int count = 0;
+
+   for( char const* line = buf; line != NULL && *line != '\0'; ) {
+
+      char const* end = strchr( line, '\n' );
+
+      if( strstr( line, needle ) != NULL && (end == NULL || strstr( line, needle ) < end) ) {
+         count++;
+      }
+
+      line = (end != NULL ? end + 1 : NULL);
+   }
+
+   return count;
+}
+
+void* logger_main( void* arg ) {
+
+   uint64_t n = (uint64_t)(uintptr_t)arg;
+
+   for( uint64_t i = 0; i < n; i++ ) {
+      fskit_error("test message %" PRIu64 "\n", i );
+   }
+
+   return NULL;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_entry* fent = NULL;
+   pthread_t threads[ NUM_THREADS ];
+   char path[] = "/tmp/test-log-XXXXXX";
+   char longmsg[ 2 * FSKIT_LOG_MSG_MAX ];
+   char* buf = NULL;
+   char* line = NULL;
+   uint64_t dropped = 0;
+   int count = 0;
+   int rc = 0;
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   log_fd = mkstemp( path );
+   if( log_fd < 0 ) {
+      fskit_error("mkstemp rc = %d\n", -errno );
+      exit(1);
+   }
+
+   unlink( path );
+
+   fskit_set_debug_level( 0 );
+   fskit_set_error_level( 1 );
+
+   if( !fskit_log_get_async() || fskit_log_get_mask() != FSKIT_LOG_ALL ) {
+      fskit_error("%s", "logging is not asynchronous and unmasked by default\n");
+      exit(1);
+   }
+
+   // every message from every thread, including threads that have exited
+   capture_begin();
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_create( &threads[i], NULL, logger_main, (void*)(uintptr_t)NUM_MESSAGES );
+   }
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   buf = capture_end();
+
+   count = count_lines( buf, "ERROR: test message" );
+   if( count != NUM_THREADS * NUM_MESSAGES || count_lines( buf, "test-log.cpp:" ) != count ) {
+      fskit_error("%d messages logged, expected %d\n%s\n", count, NUM_THREADS * NUM_MESSAGES, buf );
+      exit(1);
+   }
+
+   free( buf );
+
+   // a flood from one thread is either written or counted as dropped
+   dropped = fskit_log_get_dropped();
+   capture_begin();
+
+   pthread_create( &threads[0], NULL, logger_main, (void*)(uintptr_t)NUM_FLOOD );
+   pthread_join( threads[0], NULL );
+
+   buf = capture_end();
+
+   count = count_lines( buf, "ERROR: test message" );
+   dropped = fskit_log_get_dropped() - dropped;
+
+   if( count + dropped != NUM_FLOOD || (dropped > 0 && count_lines( buf, "log messages dropped" ) == 0) ) {
+      fskit_error("%d messages logged and %" PRIu64 " dropped, expected %d in all\n", count, dropped, NUM_FLOOD );
+      exit(1);
+   }
+
+   free( buf );
+
+   // disabled level
+   capture_begin();
+
+   fskit_set_error_level( 0 );
+   fskit_error("%s", "test message while disabled\n");
+   fskit_set_error_level( 1 );
+
+   buf = capture_end();
+
+   if( strlen( buf ) != 0 ) {
+      fskit_error("logged while disabled:\n%s\n", buf );
+      exit(1);
+   }
+
+   free( buf );
+
+   // masked subsystem: only the core's lock messages get through
+   capture_begin();
+
+   fskit_log_set_mask( 1ULL << FSKIT_LOG_CORE );
+   fskit_set_debug_level( 2 );
+
+   fskit_error("%s", "test message while masked\n");
+
+   fent = fskit_entry_resolve_path( core, "/", 0, 0, false, &rc );
+   if( fent == NULL ) {
+      exit(1);
+   }
+
+   fskit_entry_unlock( fent );
+
+   fskit_set_debug_level( 0 );
+   fskit_log_set_mask( FSKIT_LOG_ALL );
+
+   buf = capture_end();
+
+   if( count_lines( buf, "test message" ) != 0 || count_lines( buf, "entry.c:" ) == 0 ) {
+      fskit_error("masked log:\n%s\n", buf );
+      exit(1);
+   }
+
+   free( buf );
+
+   // synchronous, and cut short
+   fskit_log_set_async( false );
+   capture_begin();
+
+   memset( longmsg, 'x', sizeof(longmsg) - 1 );
+   longmsg[ sizeof(longmsg) - 1 ] = '\0';
+
+   fskit_error("test message %s\n", longmsg );
+
+   // no flush needed
+   buf = (char*)calloc( 2 * FSKIT_LOG_MSG_MAX, 1 );
+   pread( log_fd, buf, 2 * FSKIT_LOG_MSG_MAX, 0 );
+   fskit_log_set_fd( STDERR_FILENO );
+
+   line = strstr( buf, "test message" );
+   if( line == NULL || strlen( buf ) != FSKIT_LOG_MSG_MAX - 1 || strcmp( buf + strlen( buf ) - 4, "...\n" ) != 0 ) {
+      fskit_error("long message: %zu bytes\n%s\n", strlen( buf ), buf );
+      exit(1);
+   }
+
+   free( buf );
+   fskit_log_set_async( true );
+
+   // fork while other threads are logging.  The child must neither deadlock nor lose its messages for want of a
+   // drainer; it checks the capture file without flushing.
+   capture_begin();
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_create( &threads[i], NULL, logger_main, (void*)(uintptr_t)NUM_FLOOD );
+   }
+
+   pid_t child = fork();
+   if( child == 0 ) {
+
+      struct stat sb;
+
+      alarm( 30 );
+
+      for( int i = 0; i < NUM_MESSAGES; i++ ) {
+         fskit_error("child message %d\n", i );
+      }
+
+      usleep( 500000 );
+
+      fstat( log_fd, &sb );
+
+      buf = (char*)calloc( sb.st_size + 1, 1 );
+      if( buf == NULL ) {
+         _exit(1);
+      }
+
+      pread( log_fd, buf, sb.st_size, 0 );
+
+      count = count_lines( buf, "ERROR: child message" );
+      _exit( count == NUM_MESSAGES ? 0 : 2 );
+   }
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   if( child < 0 || waitpid( child, &rc, 0 ) != child || !WIFEXITED( rc ) || WEXITSTATUS( rc ) != 0 ) {
+      fskit_error("forked child failed: status = %d\n", rc );
+      exit(1);
+   }
+
+   buf = capture_end();
+   free( buf );
+
+   close( log_fd );
+
+   rc = fskit_test_end( core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   return 0;
+}
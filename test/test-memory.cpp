@@ -0,0 +1,193 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-memory.h"
+
+#define NUM_FILES       100
+
+// check one figure of the report
+static void check_count( char const* what, uint64_t count, uint64_t expected ) {
+
+   if( count != expected ) {
+      fskit_error("%s = %" PRIu64 ", expected %" PRIu64 "\n", what, count, expected );
+      exit(1);
+   }
+}
+
+// the total must be the sum of its parts
+static void check_total( struct fskit_memory_report* report ) {
+
+   check_count( "total", report->total, report->entries + report->entry_set_nodes + report->names + report->xattrs + report->symlink_targets
+                                        + report->file_handles + report->dir_handles + report->routes + report->allocator_overhead );
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_core* other = NULL;
+   struct fskit_memory_report base;
+   struct fskit_memory_report report;
+   struct fskit_file_handle* fh = NULL;
+   struct fskit_dir_handle* dirh = NULL;
+   uint64_t node_size = 0;
+   char path[100];
+   int rc = 0;
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   // just the root, with its . and ..
+   fskit_core_memory_report( core, &base );
+   check_count( "num_entries", base.num_entries, 1 );
+   check_count( "num_file_handles", base.num_file_handles, 0 );
+   check_count( "num_dir_handles", base.num_dir_handles, 0 );
+   check_count( "symlink_targets", base.symlink_targets, 0 );
+   check_total( &base );
+
+   check_count( "num_entry_set_nodes", base.num_entry_set_nodes, 2 );
+   check_count( "names", base.names, 2 + 3 );
+
+   if( base.entry_set_nodes % base.num_entry_set_nodes != 0 ) {
+      fskit_error("num_entry_set_nodes = %" PRIu64 ", entry_set_nodes = %" PRIu64 "\n", base.num_entry_set_nodes, base.entry_set_nodes );
+      exit(1);
+   }
+
+   node_size = base.entry_set_nodes / base.num_entry_set_nodes;
+
+   // /a/{xyz, s -> target}
+   fskit_test_check_rc( "fskit_mkdir", "/a", fskit_mkdir( core, "/a", 0755, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mknod", "/a/xyz", fskit_mknod( core, "/a/xyz", S_IFREG | 0644, 0, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_symlink", "/a/s", fskit_symlink( core, "target", "/a/s", 0, 0 ), 0 );
+
+   fskit_core_memory_report( core, &report );
+   check_count( "num_entries", report.num_entries, 4 );
+   check_count( "entries", report.entries, 4 * (base.entries / base.num_entries) );
+
+   // "a" in /, and ".", "..", "xyz", and "s" in /a
+   check_count( "num_entry_set_nodes", report.num_entry_set_nodes, base.num_entry_set_nodes + 5 );
+   check_count( "entry_set_nodes", report.entry_set_nodes, (base.num_entry_set_nodes + 5) * node_size );
+   check_count( "names", report.names, base.names + 2 + 2 + 3 + 4 + 2 );
+
+   check_count( "symlink_targets", report.symlink_targets, 7 );
+   check_total( &report );
+
+   // xattrs count their names and values
+   fskit_test_check_rc( "fskit_setxattr", "/a/xyz", fskit_setxattr( core, "/a/xyz", 0, 0, "user.x", "abc", 3, 0 ), 0 );
+
+   fskit_core_memory_report( core, &report );
+   check_count( "xattrs", report.xattrs, base.xattrs + 9 );
+
+   // open handles
+   fh = fskit_open( core, "/a/xyz", 0, 0, O_RDONLY, 0, &rc );
+   fskit_test_check_rc( "fskit_open", "/a/xyz", (fh == NULL ? rc : 0), 0 );
+
+   dirh = fskit_opendir( core, "/a", 0, 0, &rc );
+   fskit_test_check_rc( "fskit_opendir", "/a", (dirh == NULL ? rc : 0), 0 );
+
+   fskit_core_memory_report( core, &report );
+   check_count( "num_file_handles", report.num_file_handles, 1 );
+   check_count( "num_dir_handles", report.num_dir_handles, 1 );
+
+   if( report.file_handles <= strlen("/a/xyz") + 1 || report.dir_handles <= strlen("/a") + 1 ) {
+      fskit_error("file_handles = %" PRIu64 ", dir_handles = %" PRIu64 "\n", report.file_handles, report.dir_handles );
+      exit(1);
+   }
+
+   check_total( &report );
+
+   fskit_test_check_rc( "fskit_close", "/a/xyz", fskit_close( core, fh ), 0 );
+   fskit_test_check_rc( "fskit_closedir", "/a", fskit_closedir( core, dirh ), 0 );
+
+   fskit_core_memory_report( core, &report );
+   check_count( "num_file_handles", report.num_file_handles, 0 );
+   check_count( "num_dir_handles", report.num_dir_handles, 0 );
+   check_count( "file_handles", report.file_handles, 0 );
+   check_count( "dir_handles", report.dir_handles, 0 );
+
+   // routes
+   fskit_test_check_rc( "fskit_data_route", "/", fskit_data_route( core, FSKIT_ROUTE_ANY ), 0 );
+
+   fskit_core_memory_report( core, &report );
+   if( report.routes <= base.routes ) {
+      fskit_error("routes = %" PRIu64 ", was %" PRIu64 "\n", report.routes, base.routes );
+      exit(1);
+   }
+
+   base.routes = report.routes;
+
+   // renaming changes only the name
+   fskit_test_check_rc( "fskit_rename", "/a/xyz", fskit_rename( core, "/a/xyz", "/a/uvwxyz", 0, 0 ), 0 );
+
+   fskit_core_memory_report( core, &report );
+   check_count( "num_entry_set_nodes", report.num_entry_set_nodes, base.num_entry_set_nodes + 5 );
+   check_count( "names", report.names, base.names + 2 + 2 + 3 + 7 + 2 );
+
+   // a bigger directory, removed all at once
+   fskit_test_check_rc( "fskit_mkdir", "/b", fskit_mkdir( core, "/b", 0755, 0, 0 ), 0 );
+
+   for( int i = 0; i < NUM_FILES; i++ ) {
+
+      snprintf( path, sizeof(path), "/b/%d", i );
+      fskit_test_check_rc( "fskit_mknod", path, fskit_mknod( core, path, S_IFREG | 0644, 0, 0, 0 ), 0 );
+   }
+
+   fskit_test_check_rc( "fskit_symlink", "/b/s", fskit_symlink( core, "../a/s", "/b/s", 0, 0 ), 0 );
+
+   fskit_core_memory_report( core, &report );
+   check_count( "num_entries", report.num_entries, 4 + 1 + NUM_FILES + 1 );
+   check_count( "num_entry_set_nodes", report.num_entry_set_nodes, base.num_entry_set_nodes + 5 + 1 + 2 + NUM_FILES + 1 );
+   check_count( "symlink_targets", report.symlink_targets, 7 + 7 );
+   check_total( &report );
+
+   // another core's directories are not charged to this one
+   other = fskit_test_new_core();
+
+   fskit_core_memory_report( other, &report );
+   check_count( "other num_entry_set_nodes", report.num_entry_set_nodes, base.num_entry_set_nodes );
+   check_count( "other names", report.names, base.names );
+
+   fskit_detach_all( other, "/" );
+   fskit_core_destroy( other, NULL );
+   free( other );
+
+   fskit_test_check_rc( "fskit_deferred_remove_all", "/b", fskit_deferred_remove_all( core, "/b", NULL ), 0 );
+   fskit_test_check_rc( "fskit_deferred_wait", "/b", fskit_deferred_wait( core ), 0 );
+
+   // everything else, one at a time
+   fskit_test_check_rc( "fskit_unlink", "/a/uvwxyz", fskit_unlink( core, "/a/uvwxyz", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_unlink", "/a/s", fskit_unlink( core, "/a/s", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_rmdir", "/a", fskit_rmdir( core, "/a", 0, 0 ), 0 );
+
+   fskit_core_memory_report( core, &report );
+   check_count( "num_entries", report.num_entries, 1 );
+   check_count( "num_entry_set_nodes", report.num_entry_set_nodes, base.num_entry_set_nodes );
+   check_count( "names", report.names, base.names );
+   check_count( "symlink_targets", report.symlink_targets, 0 );
+   check_count( "xattrs", report.xattrs, base.xattrs );
+   check_count( "routes", report.routes, base.routes );
+   check_total( &report );
+
+   fskit_test_end( core, NULL );
+
+   return 0;
+}
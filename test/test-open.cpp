@@ -21,6 +21,47 @@
 
 #include "test-open.h"
 
+// unlink the file being opened, and remove its parent, while the open route runs
+int unlink_on_open( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, int flags, void** handle_data ) {
+
+   int rc = fskit_unlink( core, "/gone/file", 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_unlink('/gone/file') rc = %d\n", rc );
+      return rc;
+   }
+
+   rc = fskit_rmdir( core, "/gone", 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_rmdir('/gone') rc = %d\n", rc );
+      return rc;
+   }
+
+   return 0;
+}
+
+#define OPEN_THREADS 4
+#define OPEN_ROUNDS 1000
+
+// open and close the same file over and over
+static void* open_main( void* arg ) {
+
+   struct fskit_core* core = (struct fskit_core*)arg;
+   int rc = 0;
+
+   for( int i = 0; i < OPEN_ROUNDS; i++ ) {
+
+      struct fskit_file_handle* fh = fskit_open( core, "/0", 0, 0, O_RDONLY, 0, &rc );
+      if( fh == NULL ) {
+         fskit_error("fskit_open('/0') rc = %d\n", rc );
+         break;
+      }
+
+      fskit_close( core, fh );
+   }
+
+   return (void*)(intptr_t)rc;
+}
+
 int main( int argc, char** argv ) {
 
    struct fskit_core* core = NULL;
@@ -75,6 +116,48 @@ int main( int argc, char** argv ) {
       fskit_close( core, fh );
    }
 
+   // concurrent opens of one file all set its atime
+   pthread_t openers[OPEN_THREADS];
+   for( int i = 0; i < OPEN_THREADS; i++ ) {
+      pthread_create( &openers[i], NULL, open_main, core );
+   }
+
+   for( int i = 0; i < OPEN_THREADS; i++ ) {
+
+      void* open_rc = NULL;
+      pthread_join( openers[i], &open_rc );
+      if( open_rc != NULL ) {
+         exit(1);
+      }
+   }
+
+   // the parent can vanish while the open route runs
+   rc = fskit_route_open( core, "/gone/file", unlink_on_open, FSKIT_CONCURRENT );
+   if( rc < 0 ) {
+      fskit_error("fskit_route_open rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_mkdir( core, "/gone", 0755, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir('/gone') rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_mknod( core, "/gone/file", S_IFREG | 0644, 0, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mknod('/gone/file') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fh = fskit_open( core, "/gone/file", 0, 0, O_RDONLY, 0, &rc );
+   if( fh == NULL ) {
+      fskit_error("fskit_open('/gone/file') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fskit_close( core, fh );
+
    fskit_print_tree( stdout, fskit_core_get_root( core ) );
 
    fskit_test_end( core, &output );
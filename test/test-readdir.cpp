@@ -83,6 +83,284 @@ int fskit_test_readdir( struct fskit_core* core, char const* path ) {
 }
 
 
+// read a directory in batches of one, and check that telldir/seekdir and rewinddir resume at the right names
+int fskit_test_readdir_seek( struct fskit_core* core, char const* path ) {
+
+   int rc = 0;
+   uint64_t num_read = 0;
+   char after_tell[FSKIT_FILESYSTEM_NAMEMAX+1];
+   char after_rewind[FSKIT_FILESYSTEM_NAMEMAX+1];
+   struct fskit_dir_entry** dents = NULL;
+   off_t loc = 0;
+
+   memset( after_tell, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+   memset( after_rewind, 0, FSKIT_FILESYSTEM_NAMEMAX+1 );
+
+   struct fskit_dir_handle* dh = fskit_opendir( core, path, 0, 0, &rc );
+   if( rc != 0 ) {
+      fskit_error("fskit_opendir('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   // read the first entry, and remember where we are
+   dents = fskit_readdir( core, dh, 1, &num_read, &rc );
+   if( rc != 0 || num_read != 1 ) {
+      fskit_error("fskit_readdir('%s') rc = %d, num_read = %" PRIu64 "\n", path, rc, num_read );
+      return -EIO;
+   }
+
+   strcpy( after_rewind, dents[0]->name );
+   fskit_dir_entry_free_list( dents );
+
+   loc = fskit_telldir( dh );
+
+   // same place, same offset
+   if( fskit_telldir( dh ) != loc ) {
+      fskit_error("telldir('%s'): second call at the same position gave a new offset\n", path );
+      return -EIO;
+   }
+
+   dents = fskit_readdir( core, dh, 1, &num_read, &rc );
+   if( rc != 0 || num_read != 1 ) {
+      fskit_error("fskit_readdir('%s') rc = %d, num_read = %" PRIu64 "\n", path, rc, num_read );
+      return -EIO;
+   }
+
+   strcpy( after_tell, dents[0]->name );
+   fskit_dir_entry_free_list( dents );
+
+   // read to the end
+   while( true ) {
+
+      dents = fskit_readdir( core, dh, 1, &num_read, &rc );
+      if( rc != 0 ) {
+         fskit_error("fskit_readdir('%s') rc = %d\n", path, rc );
+         return rc;
+      }
+
+      if( dents == NULL ) {
+         break;
+      }
+
+      fskit_dir_entry_free_list( dents );
+   }
+
+   // seek back
+   fskit_seekdir( dh, loc );
+
+   dents = fskit_readdir( core, dh, 1, &num_read, &rc );
+   if( rc != 0 || num_read != 1 || strcmp( dents[0]->name, after_tell ) != 0 ) {
+      fskit_error("seekdir('%s'): expected '%s', got rc = %d\n", path, after_tell, rc );
+      return -EIO;
+   }
+
+   fskit_dir_entry_free_list( dents );
+
+   // start over
+   fskit_rewinddir( dh );
+
+   dents = fskit_readdir( core, dh, 1, &num_read, &rc );
+   if( rc != 0 || num_read != 1 || strcmp( dents[0]->name, after_rewind ) != 0 ) {
+      fskit_error("rewinddir('%s'): expected '%s', got rc = %d\n", path, after_rewind, rc );
+      return -EIO;
+   }
+
+   fskit_dir_entry_free_list( dents );
+
+   return fskit_closedir( core, dh );
+}
+
+// read a directory into a small packed buffer, and check that it yields the same names as fskit_listdir
+int fskit_test_readdir_packed( struct fskit_core* core, char const* path ) {
+
+   int rc = 0;
+   ssize_t len = 0;
+   uint64_t num_listed = 0;
+   uint64_t num_packed = 0;
+   char buf[64];
+   struct fskit_readdir_cookie cookie;
+   struct fskit_dir_entry** dents = NULL;
+
+   memset( &cookie, 0, sizeof(struct fskit_readdir_cookie) );
+
+   struct fskit_dir_handle* dh = fskit_opendir( core, path, 0, 0, &rc );
+   if( rc != 0 ) {
+      fskit_error("fskit_opendir('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   dents = fskit_listdir( core, dh, &num_listed, &rc );
+   if( dents == NULL ) {
+      fskit_error("fskit_listdir('%s') rc = %d\n", path, rc );
+      return -EIO;
+   }
+
+   // a buffer too small for any record is rejected
+   len = fskit_readdir_packed( core, dh, &cookie, buf, 8 );
+   if( len != -EINVAL ) {
+      fskit_error("fskit_readdir_packed('%s', 8 bytes) rc = %zd\n", path, len );
+      return -EIO;
+   }
+
+   while( (len = fskit_readdir_packed( core, dh, &cookie, buf, sizeof(buf) )) > 0 ) {
+
+      for( struct fskit_packed_dirent* d = (struct fskit_packed_dirent*)buf; (char*)d < buf + len; d = FSKIT_PACKED_DIRENT_NEXT( d ) ) {
+
+         if( num_packed >= num_listed || strcmp( d->name, dents[num_packed]->name ) != 0 || d->file_id != dents[num_packed]->file_id || d->namelen != strlen( d->name ) ) {
+            fskit_error("fskit_readdir_packed('%s'): mismatch at %" PRIu64 " ('%s')\n", path, num_packed, d->name );
+            return -EIO;
+         }
+
+         num_packed++;
+      }
+   }
+
+   if( len < 0 || num_packed != num_listed ) {
+      fskit_error("fskit_readdir_packed('%s') rc = %zd, read %" PRIu64 " of %" PRIu64 "\n", path, len, num_packed, num_listed );
+      return -EIO;
+   }
+
+   fskit_dir_entry_free_list( dents );
+
+   return fskit_closedir( core, dh );
+}
+
+#define CONTENDED_ENTRIES 64
+#define CONTENDED_ROUNDS 1000
+
+struct contended_remover {
+   struct fskit_core* core;
+   char const* path;
+   int first;
+   bool* stop;
+   int errors;
+};
+
+// remove and re-create every other child of path, alternating between directories and files, until told to stop
+static void* contended_remover_main( void* arg ) {
+
+   struct contended_remover* r = (struct contended_remover*)arg;
+   char child[100];
+   int rc = 0;
+
+   while( !__atomic_load_n( r->stop, __ATOMIC_RELAXED ) ) {
+
+      for( int i = r->first; i < CONTENDED_ENTRIES; i += 2 ) {
+
+         snprintf( child, sizeof(child), "%s/%d", r->path, i );
+
+         if( i % 4 < 2 ) {
+
+            rc = fskit_rmdir( r->core, child, 0, 0 );
+            if( rc == 0 ) {
+               rc = fskit_mkdir( r->core, child, 0755, 0, 0 );
+            }
+         }
+         else {
+
+            rc = fskit_unlink( r->core, child, 0, 0 );
+            if( rc == 0 ) {
+               rc = fskit_mknod( r->core, child, S_IFREG | 0644, 0, 0, 0 );
+            }
+         }
+
+         if( rc != 0 ) {
+            fskit_error("remove/re-create '%s' rc = %d\n", child, rc );
+            r->errors++;
+            return NULL;
+         }
+      }
+   }
+
+   return NULL;
+}
+
+// list a directory while other threads unlink and rmdir its children.
+// readdir doesn't lock the children; build with TSAN=1 to check that it doesn't race with their removal.
+int fskit_test_readdir_contended( struct fskit_core* core, char const* path ) {
+
+   int rc = 0;
+   char child[100];
+   uint64_t num_read = 0;
+   ssize_t len = 0;
+   char buf[4096];
+   bool stop = false;
+   struct contended_remover removers[2];
+   pthread_t threads[2];
+   struct fskit_dir_entry** dents = NULL;
+   struct fskit_readdir_cookie cookie;
+
+   rc = fskit_mkdir( core, path, 0755, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   for( int i = 0; i < CONTENDED_ENTRIES; i++ ) {
+
+      snprintf( child, sizeof(child), "%s/%d", path, i );
+
+      rc = (i % 4 < 2 ? fskit_mkdir( core, child, 0755, 0, 0 ) : fskit_mknod( core, child, S_IFREG | 0644, 0, 0, 0 ));
+      if( rc != 0 ) {
+         fskit_error("create '%s' rc = %d\n", child, rc );
+         return rc;
+      }
+   }
+
+   for( int i = 0; i < 2; i++ ) {
+
+      removers[i].core = core;
+      removers[i].path = path;
+      removers[i].first = i;
+      removers[i].stop = &stop;
+      removers[i].errors = 0;
+
+      pthread_create( &threads[i], NULL, contended_remover_main, &removers[i] );
+   }
+
+   for( int round = 0; round < CONTENDED_ROUNDS && rc == 0; round++ ) {
+
+      struct fskit_dir_handle* dh = fskit_opendir( core, path, 0, 0, &rc );
+      if( dh == NULL ) {
+         fskit_error("fskit_opendir('%s') rc = %d\n", path, rc );
+         break;
+      }
+
+      dents = fskit_listdir( core, dh, &num_read, &rc );
+      if( dents == NULL || num_read > CONTENDED_ENTRIES + 2 ) {
+         fskit_error("fskit_listdir('%s') rc = %d, read %" PRIu64 "\n", path, rc, num_read );
+         rc = -EIO;
+      }
+      else {
+         fskit_dir_entry_free_list( dents );
+      }
+
+      memset( &cookie, 0, sizeof(cookie) );
+
+      while( rc == 0 && (len = fskit_readdir_packed( core, dh, &cookie, buf, sizeof(buf) )) > 0 );
+
+      if( rc == 0 && len < 0 ) {
+         fskit_error("fskit_readdir_packed('%s') rc = %zd\n", path, len );
+         rc = (int)len;
+      }
+
+      fskit_closedir( core, dh );
+   }
+
+   __atomic_store_n( &stop, true, __ATOMIC_RELAXED );
+
+   for( int i = 0; i < 2; i++ ) {
+
+      pthread_join( threads[i], NULL );
+
+      if( removers[i].errors != 0 ) {
+         rc = -EIO;
+      }
+   }
+
+   return rc;
+}
+
 int main( int argc, char** argv ) {
 
    struct fskit_core* core = NULL;
@@ -119,6 +397,24 @@ int main( int argc, char** argv ) {
       exit(1);
    }
 
+   rc = fskit_test_readdir_seek( core, "/root" );
+   if( rc != 0 ) {
+      fskit_error("fskit_test_readdir_seek('/root') rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_test_readdir_packed( core, "/root" );
+   if( rc != 0 ) {
+      fskit_error("fskit_test_readdir_packed('/root') rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_test_readdir_contended( core, "/contended" );
+   if( rc != 0 ) {
+      fskit_error("fskit_test_readdir_contended('/contended') rc = %d\n", rc );
+      exit(1);
+   }
+
    fskit_print_tree( stdout, fskit_core_get_root( core ) );
 
    fskit_test_end( core, &output );
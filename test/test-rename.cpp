@@ -21,6 +21,45 @@
 
 #include "test-rename.h"
 
+static unsigned int last_rename_flags = 0;
+static struct fskit_entry* last_rename_dest = NULL;
+
+// remember what the last rename asked for
+int rename_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char const* new_path, struct fskit_entry* dest ) {
+
+   last_rename_flags = fskit_route_metadata_get_rename_flags( route_metadata );
+   last_rename_dest = dest;
+   return 0;
+}
+
+// check that path resolves (or doesn't), and to which type
+static void check_path( struct fskit_core* core, char const* path, int type ) {
+
+   int rc = 0;
+   struct fskit_entry* fent = fskit_entry_resolve_path( core, path, 0, 0, false, &rc );
+
+   if( type < 0 ) {
+      if( fent != NULL ) {
+         fskit_error("'%s' exists\n", path );
+         exit(1);
+      }
+
+      return;
+   }
+
+   if( fent == NULL ) {
+      fskit_error("fskit_entry_resolve_path('%s') rc = %d\n", path, rc );
+      exit(1);
+   }
+
+   if( fskit_entry_get_type( fent ) != type ) {
+      fskit_error("'%s' has type %d, expected %d\n", path, fskit_entry_get_type( fent ), type );
+      exit(1);
+   }
+
+   fskit_entry_unlock( fent );
+}
+
 int main( int argc, char** argv ) {
 
    struct fskit_core* core = NULL;
@@ -129,6 +168,187 @@ int main( int argc, char** argv ) {
    printf("Rename /d/a$i to /a$i\n");
    fskit_print_tree( stdout, fskit_core_get_root( core ) );
 
+   // directories can't be moved beneath themselves, and can't replace their own ancestors
+   char const* dirs[] = { "/p", "/p/q", "/p/q/r", NULL };
+   for( int i = 0; dirs[i] != NULL; i++ ) {
+
+      rc = fskit_mkdir( core, dirs[i], 0755, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mkdir('%s') rc = %d\n", dirs[i], rc );
+         exit(1);
+      }
+   }
+
+   struct { char const* from; char const* to; int expected; } bad_renames[] = {
+      { "/p", "/p/q/r/x", -EINVAL },
+      { "/p/q", "/p/q/x", -EINVAL },
+      { "/p/q/r", "/p", -ENOTEMPTY },
+      { "/p/q/r", "/a0", -ENOTDIR },
+      { "/a1", "/a0/x", -ENOTDIR },
+      { NULL, NULL, 0 }
+   };
+
+   for( int i = 0; bad_renames[i].from != NULL; i++ ) {
+
+      rc = fskit_rename( core, bad_renames[i].from, bad_renames[i].to, 0, 0 );
+      if( rc != bad_renames[i].expected ) {
+         fskit_error("fskit_rename('%s', '%s') rc = %d, expected %d\n", bad_renames[i].from, bad_renames[i].to, rc, bad_renames[i].expected );
+         exit(1);
+      }
+   }
+
+   // move a directory up and across; its .. must follow it
+   rc = fskit_rename( core, "/p/q/r", "/d0/r", 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_rename('/p/q/r', '/d0/r') rc = %d\n", rc );
+      exit(1);
+   }
+
+   struct fskit_entry* d0 = fskit_entry_resolve_path( core, "/d0", 0, 0, false, &rc );
+   if( d0 == NULL ) {
+      fskit_error("fskit_entry_resolve_path('/d0') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fskit_entry_unlock( d0 );
+
+   struct fskit_entry* r_parent = fskit_entry_resolve_path( core, "/d0/r/..", 0, 0, false, &rc );
+   if( r_parent != d0 ) {
+      fskit_error("'/d0/r/..' is %p, expected %p (rc = %d)\n", r_parent, d0, rc );
+      exit(1);
+   }
+
+   fskit_entry_unlock( r_parent );
+
+   // ...and back down, into a different subtree
+   rc = fskit_rename( core, "/d0/r", "/p/q/r2", 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_rename('/d0/r', '/p/q/r2') rc = %d\n", rc );
+      exit(1);
+   }
+
+   printf("Move /p/q/r to /d0/r to /p/q/r2\n");
+   fskit_print_tree( stdout, fskit_core_get_root( core ) );
+
+   // swap a freshly-built directory into place
+   rc = fskit_route_rename( core, FSKIT_ROUTE_ANY, rename_cb, FSKIT_SEQUENTIAL );
+   if( rc < 0 ) {
+      fskit_error("fskit_route_rename rc = %d\n", rc );
+      exit(1);
+   }
+
+   char const* mknods[] = { "/d1/file", "/stage/new1", "/stage/new2", "/live/old", NULL };
+   char const* mkdirs[] = { "/stage", "/live", NULL };
+
+   for( int i = 0; mkdirs[i] != NULL; i++ ) {
+
+      rc = fskit_mkdir( core, mkdirs[i], 0755, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mkdir('%s') rc = %d\n", mkdirs[i], rc );
+         exit(1);
+      }
+   }
+
+   for( int i = 0; mknods[i] != NULL; i++ ) {
+
+      rc = fskit_mknod( core, mknods[i], S_IFREG | 0644, 0, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mknod('%s') rc = %d\n", mknods[i], rc );
+         exit(1);
+      }
+   }
+
+   rc = fskit_rename2( core, "/stage", "/live", 0, 0, FSKIT_RENAME_EXCHANGE );
+   if( rc != 0 ) {
+      fskit_error("fskit_rename2('/stage', '/live', EXCHANGE) rc = %d\n", rc );
+      exit(1);
+   }
+
+   if( last_rename_flags != FSKIT_RENAME_EXCHANGE || last_rename_dest == NULL ) {
+      fskit_error("rename route got flags %x, dest %p\n", last_rename_flags, last_rename_dest );
+      exit(1);
+   }
+
+   check_path( core, "/live/new1", FSKIT_ENTRY_TYPE_FILE );
+   check_path( core, "/live/new2", FSKIT_ENTRY_TYPE_FILE );
+   check_path( core, "/live/old", -1 );
+   check_path( core, "/stage/old", FSKIT_ENTRY_TYPE_FILE );
+
+   // swap a directory with a file in another directory; the directory's .. must follow it
+   rc = fskit_rename2( core, "/live", "/d1/file", 0, 0, FSKIT_RENAME_EXCHANGE );
+   if( rc != 0 ) {
+      fskit_error("fskit_rename2('/live', '/d1/file', EXCHANGE) rc = %d\n", rc );
+      exit(1);
+   }
+
+   check_path( core, "/live", FSKIT_ENTRY_TYPE_FILE );
+   check_path( core, "/d1/file/new1", FSKIT_ENTRY_TYPE_FILE );
+
+   struct fskit_entry* d1 = fskit_entry_resolve_path( core, "/d1", 0, 0, false, &rc );
+   fskit_entry_unlock( d1 );
+
+   struct fskit_entry* file_parent = fskit_entry_resolve_path( core, "/d1/file/..", 0, 0, false, &rc );
+   if( file_parent != d1 ) {
+      fskit_error("'/d1/file/..' is %p, expected %p (rc = %d)\n", file_parent, d1, rc );
+      exit(1);
+   }
+
+   fskit_entry_unlock( file_parent );
+
+   struct { char const* from; char const* to; unsigned int flags; int expected; } flag_renames[] = {
+      { "/d1/file", "/live", FSKIT_RENAME_EXCHANGE, 0 },
+      { "/a0", "/a1", FSKIT_RENAME_NOREPLACE, -EEXIST },
+      { "/a0", "/a0new", FSKIT_RENAME_NOREPLACE, 0 },
+      { "/a0new", "/nope", FSKIT_RENAME_EXCHANGE, -ENOENT },
+      { "/a0new", "/a1", FSKIT_RENAME_EXCHANGE | FSKIT_RENAME_NOREPLACE, -EINVAL },
+      { "/a0new", "/a1", 0x80, -EINVAL },
+      { "/p", "/p/q/r2", FSKIT_RENAME_EXCHANGE, -EINVAL },
+      { "/p/q/r2", "/p", FSKIT_RENAME_EXCHANGE, -EINVAL },
+      { NULL, NULL, 0, 0 }
+   };
+
+   for( int i = 0; flag_renames[i].from != NULL; i++ ) {
+
+      rc = fskit_rename2( core, flag_renames[i].from, flag_renames[i].to, 0, 0, flag_renames[i].flags );
+      if( rc != flag_renames[i].expected ) {
+         fskit_error("fskit_rename2('%s', '%s', %x) rc = %d, expected %d\n", flag_renames[i].from, flag_renames[i].to, flag_renames[i].flags, rc, flag_renames[i].expected );
+         exit(1);
+      }
+   }
+
+   check_path( core, "/live/new1", FSKIT_ENTRY_TYPE_FILE );
+   check_path( core, "/d1/file", FSKIT_ENTRY_TYPE_FILE );
+   check_path( core, "/a0new", FSKIT_ENTRY_TYPE_FILE );
+   check_path( core, "/a1", FSKIT_ENTRY_TYPE_FILE );
+
+   printf("Exchange /stage and /live\n");
+   fskit_print_tree( stdout, fskit_core_get_root( core ) );
+
+   // move a directory with children; it must leave its old parent entirely
+   char const* full[] = { "/full", "/full/c0", "/full/c1", "/full/c2", NULL };
+   for( int i = 0; full[i] != NULL; i++ ) {
+
+      rc = fskit_mkdir( core, full[i], 0755, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mkdir('%s') rc = %d\n", full[i], rc );
+         exit(1);
+      }
+   }
+
+   rc = fskit_rename( core, "/full", "/d2/full", 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_rename('/full', '/d2/full') rc = %d\n", rc );
+      exit(1);
+   }
+
+   check_path( core, "/full", -1 );
+   check_path( core, "/d2/full/c0", FSKIT_ENTRY_TYPE_DIR );
+   check_path( core, "/d2/full/c1", FSKIT_ENTRY_TYPE_DIR );
+   check_path( core, "/d2/full/c2", FSKIT_ENTRY_TYPE_DIR );
+
+   printf("Move /full to /d2/full\n");
+   fskit_print_tree( stdout, fskit_core_get_root( core ) );
+
    fskit_test_end( core, &output );
 
    return 0;
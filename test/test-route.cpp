@@ -116,6 +116,74 @@ int setmetadata_cb( struct fskit_core* core, struct fskit_route_metadata* route_
    return 0;
 }
 
+static int lone_read_calls = 0;
+
+int lone_read_cb( struct fskit_core* core, struct fskit_route_metadata* route_metadata, struct fskit_entry* fent, char* buf, size_t buflen, off_t offset, void* handle_data ) {
+   lone_read_calls++;
+   memset( buf, 'x', buflen );
+   return buflen;
+}
+
+// read path through whatever read route matches it
+static int lone_read( struct fskit_core* core, char const* path, char* buf, size_t buflen ) {
+
+   int rc = 0;
+   struct fskit_file_handle* fh = NULL;
+
+   fh = fskit_create( core, path, 0, 0, 0644, &rc );
+   if( rc != 0 ) {
+      fskit_error("fskit_create('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   fskit_close( core, fh );
+
+   fh = fskit_open( core, path, 0, 0, O_RDONLY, 0, &rc );
+   if( rc != 0 ) {
+      fskit_error("fskit_open('%s') rc = %d\n", path, rc );
+      return rc;
+   }
+
+   rc = fskit_read( core, fh, buf, buflen, 0 );
+
+   fskit_close( core, fh );
+   fskit_unlink( core, path, 0, 0 );
+   return rc;
+}
+
+// install a lone regex read route, and check that it runs only for the paths it matches.
+// a path it does not match gets the no-route result, so fskit_read reads nothing.
+int fskit_test_route_lone_regex( struct fskit_core* core ) {
+
+   int rc = 0;
+   int rh = 0;
+   char buf[10];
+
+   rh = fskit_route_read( core, "/lone-[0-9]+", lone_read_cb, FSKIT_CONCURRENT );
+   if( rh < 0 ) {
+      fskit_error("fskit_route_read rc = %d\n", rh );
+      return rh;
+   }
+
+   memset( buf, 0, 10 );
+
+   rc = lone_read( core, "/lone-1", buf, 10 );
+   if( rc != 10 || lone_read_calls != 1 || buf[0] != 'x' || buf[9] != 'x' ) {
+      fskit_error("read /lone-1: rc = %d, %d calls\n", rc, lone_read_calls );
+      return -EIO;
+   }
+
+   memset( buf, 0, 10 );
+
+   rc = lone_read( core, "/other", buf, 10 );
+   if( rc != 0 || lone_read_calls != 1 || buf[0] != 0 ) {
+      fskit_error("read /other: rc = %d, %d calls\n", rc, lone_read_calls );
+      return -EIO;
+   }
+
+   return fskit_unroute_read( core, rh );
+}
+
 int main( int argc, char** argv ) {
    struct fskit_core* core = NULL;
    int rc;
@@ -131,6 +199,13 @@ int main( int argc, char** argv ) {
       exit(1);
    }
 
+   // a lone route that is not FSKIT_ROUTE_ANY
+   rc = fskit_test_route_lone_regex( core );
+   if( rc != 0 ) {
+      fskit_error("fskit_test_route_lone_regex rc = %d\n", rc );
+      exit(1);
+   }
+
    // install routes
    create_rh = fskit_route_create( core, "/test-file", create_cb, FSKIT_SEQUENTIAL );
    if( create_rh < 0 ) {
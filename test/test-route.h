@@ -25,4 +25,6 @@
 #include "common.h"
 #include <fskit/route.h>
 
+#include <sys/sysmacros.h>
+
 #endif
@@ -0,0 +1,354 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-snapshot.h"
+
+#define NUM_THREADS     4
+#define THREAD_ROUNDS   20
+
+struct worker_args {
+   struct fskit_core* core;
+   int id;
+};
+
+// replace a file's contents
+static void write_file( struct fskit_core* core, char const* path, char const* contents, size_t len ) {
+
+   int rc = 0;
+   ssize_t nw = 0;
+
+   struct fskit_file_handle* fh = fskit_open( core, path, 0, 0, O_WRONLY | O_TRUNC, 0644, &rc );
+   if( fh == NULL && rc == -ENOENT ) {
+      fh = fskit_open( core, path, 0, 0, O_CREAT | O_WRONLY, 0644, &rc );
+   }
+
+   if( fh == NULL ) {
+      fskit_error("fskit_open('%s') rc = %d\n", path, rc );
+      exit(1);
+   }
+
+   nw = fskit_write( core, fh, (char*)contents, len, 0 );
+   if( nw != (ssize_t)len ) {
+      fskit_error("fskit_write('%s') rc = %zd\n", path, nw );
+      exit(1);
+   }
+
+   fskit_close( core, fh );
+}
+
+// check a file's contents
+static void check_file( struct fskit_core* core, char const* path, char const* contents, size_t len ) {
+
+   int rc = 0;
+   ssize_t nr = 0;
+   char* buf = (char*)calloc( len + 1, 1 );
+
+   if( buf == NULL ) {
+      exit(1);
+   }
+
+   struct fskit_file_handle* fh = fskit_open( core, path, 0, 0, O_RDONLY, 0, &rc );
+   if( fh == NULL ) {
+      fskit_error("fskit_open('%s') rc = %d\n", path, rc );
+      exit(1);
+   }
+
+   nr = fskit_read( core, fh, buf, len + 1, 0 );
+   if( nr != (ssize_t)len || memcmp( buf, contents, len ) != 0 ) {
+      fskit_error("'%s' has %zd bytes '%.*s', expected %zu bytes '%.*s'\n", path, nr, (int)(nr > 0 ? nr : 0), buf, len, (int)len, contents );
+      exit(1);
+   }
+
+   fskit_close( core, fh );
+   free( buf );
+}
+
+static void check_stat( struct fskit_core* core, char const* path, int expected_rc, struct stat* sb ) {
+
+   int rc = fskit_stat( core, path, 0, 0, sb );
+   if( rc != expected_rc ) {
+      fskit_error("fskit_stat('%s') rc = %d, expected %d\n", path, rc, expected_rc );
+      exit(1);
+   }
+}
+
+// NOTE: stat falls back to the stat route for a missing entry, so open it instead
+static void check_absent( struct fskit_core* core, char const* path ) {
+
+   int rc = 0;
+
+   struct fskit_file_handle* fh = fskit_open( core, path, 0, 0, O_RDONLY, 0, &rc );
+   if( fh != NULL || rc != -ENOENT ) {
+      fskit_error("fskit_open('%s') rc = %d, expected %d\n", path, rc, -ENOENT );
+      exit(1);
+   }
+}
+
+// clone the tree, change both sides, and check that neither sees the other's changes
+static void* worker_main( void* arg ) {
+
+   struct worker_args* args = (struct worker_args*)arg;
+   char path[100];
+   char file_path[200];
+   char contents[100];
+   int rc = 0;
+
+   for( int i = 0; i < THREAD_ROUNDS; i++ ) {
+
+      snprintf( path, sizeof(path), "/copy-%d-%d", args->id, i );
+
+      rc = fskit_clone( args->core, "/src", path, 0, 0 );
+      fskit_test_check_rc( "fskit_clone", path, rc, 0 );
+
+      // our own file in the source
+      snprintf( file_path, sizeof(file_path), "/src/sub/worker-%d", args->id );
+      snprintf( contents, sizeof(contents), "round %d", i + 1 );
+      write_file( args->core, file_path, contents, strlen(contents) );
+
+      // the clone still has the old one
+      snprintf( file_path, sizeof(file_path), "%s/sub/worker-%d", path, args->id );
+      snprintf( contents, sizeof(contents), "round %d", i );
+
+      if( i > 0 ) {
+         check_file( args->core, file_path, contents, strlen(contents) );
+      }
+
+      write_file( args->core, file_path, "mine", 4 );
+      check_file( args->core, file_path, "mine", 4 );
+      check_file( args->core, "/src/a", "alpha", 5 );
+
+      rc = fskit_deferred_remove_all( args->core, path, NULL );
+      fskit_test_check_rc( "fskit_deferred_remove_all", path, rc, 0 );
+   }
+
+   return NULL;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   int rc;
+   void* output = NULL;
+   struct stat sb;
+   struct stat sb2;
+   char buf[100];
+   char* big = NULL;
+   char* big2 = NULL;
+   size_t big_len = 5 * FSKIT_DATA_PAGE_SIZE + 17;
+   pthread_t threads[NUM_THREADS];
+   struct worker_args args[NUM_THREADS];
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_data_route( core, FSKIT_ROUTE_ANY );
+   if( rc != 0 ) {
+      fskit_error("fskit_data_route rc = %d\n", rc );
+      exit(1);
+   }
+
+   big = (char*)malloc( big_len );
+   big2 = (char*)malloc( big_len );
+   if( big == NULL || big2 == NULL ) {
+      exit(1);
+   }
+
+   for( size_t i = 0; i < big_len; i++ ) {
+      big[i] = 'a' + (i % 26);
+      big2[i] = 'A' + (i % 26);
+   }
+
+   // /src/{a, big, link, sub/{b, deep/{c, d}}, empty}
+   fskit_test_check_rc( "fskit_mkdir", "/src", fskit_mkdir( core, "/src", 0755, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mkdir", "/src/sub", fskit_mkdir( core, "/src/sub", 0750, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mkdir", "/src/sub/deep", fskit_mkdir( core, "/src/sub/deep", 0755, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mkdir", "/src/empty", fskit_mkdir( core, "/src/empty", 0755, 0, 0 ), 0 );
+
+   write_file( core, "/src/a", "alpha", 5 );
+   write_file( core, "/src/big", big, big_len );
+   write_file( core, "/src/sub/b", "beta", 4 );
+   write_file( core, "/src/sub/deep/c", "gamma", 5 );
+   write_file( core, "/src/sub/deep/d", "delta", 5 );
+
+   fskit_test_check_rc( "fskit_symlink", "/src/link", fskit_symlink( core, "a", "/src/link", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_setxattr", "/src/a", fskit_setxattr( core, "/src/a", 0, 0, "user.test", "value", 5, 0 ), 0 );
+
+   // bad clones
+   fskit_test_check_rc( "fskit_clone", "/nope", fskit_clone( core, "/nope", "/copy", 0, 0 ), -ENOENT );
+   fskit_test_check_rc( "fskit_clone", "/src/sub/copy", fskit_clone( core, "/src", "/src/sub/copy", 0, 0 ), -EINVAL );
+   fskit_test_check_rc( "fskit_clone", "/src/a", fskit_clone( core, "/src/sub", "/src/a", 0, 0 ), -EEXIST );
+   fskit_test_check_rc( "fskit_clone", "/src/a/copy", fskit_clone( core, "/src/sub", "/src/a/copy", 0, 0 ), -ENOTDIR );
+
+   // clone it, and check that everything came along
+   fskit_test_check_rc( "fskit_clone", "/copy", fskit_clone( core, "/src", "/copy", 0, 0 ), 0 );
+
+   check_file( core, "/copy/a", "alpha", 5 );
+   check_file( core, "/copy/big", big, big_len );
+   check_file( core, "/copy/sub/b", "beta", 4 );
+
+   memset( buf, 0, sizeof(buf) );
+   rc = fskit_readlink( core, "/copy/link", 0, 0, buf, sizeof(buf) );
+   if( rc < 0 || strcmp( buf, "a" ) != 0 ) {
+      fskit_error("fskit_readlink('/copy/link') rc = %d, '%s'\n", rc, buf );
+      exit(1);
+   }
+
+   memset( buf, 0, sizeof(buf) );
+   rc = fskit_getxattr( core, "/copy/a", 0, 0, "user.test", buf, sizeof(buf) );
+   if( rc != 5 || strcmp( buf, "value" ) != 0 ) {
+      fskit_error("fskit_getxattr('/copy/a') rc = %d, '%s'\n", rc, buf );
+      exit(1);
+   }
+
+   check_stat( core, "/src/sub", 0, &sb );
+   check_stat( core, "/copy/sub", 0, &sb2 );
+
+   if( (sb2.st_mode & 0777) != 0750 || sb.st_ino == sb2.st_ino ) {
+      fskit_error("/copy/sub has mode %o, inode %" PRIu64 " (source inode %" PRIu64 ")\n", sb2.st_mode, (uint64_t)sb2.st_ino, (uint64_t)sb.st_ino );
+      exit(1);
+   }
+
+   // writes on either side stay on that side, including in directories the copy hasn't visited yet
+   write_file( core, "/copy/a", "ALPHA", 5 );
+   write_file( core, "/src/sub/b", "BETA", 4 );
+   write_file( core, "/src/sub/deep/c", "GAMMA", 5 );
+   write_file( core, "/src/sub/deep/e", "epsilon", 7 );
+   fskit_test_check_rc( "fskit_unlink", "/src/sub/deep/d", fskit_unlink( core, "/src/sub/deep/d", 0, 0 ), 0 );
+
+   check_file( core, "/src/a", "alpha", 5 );
+   check_file( core, "/copy/a", "ALPHA", 5 );
+   check_file( core, "/copy/sub/b", "beta", 4 );
+   check_file( core, "/copy/sub/deep/c", "gamma", 5 );
+   check_file( core, "/copy/sub/deep/d", "delta", 5 );
+   check_absent( core, "/copy/sub/deep/e" );
+
+   // partial overwrite of a shared multi-page file
+   {
+      struct fskit_file_handle* fh = fskit_open( core, "/copy/big", 0, 0, O_WRONLY, 0, &rc );
+      if( fh == NULL ) {
+         fskit_error("fskit_open('/copy/big') rc = %d\n", rc );
+         exit(1);
+      }
+
+      fskit_write( core, fh, big2 + FSKIT_DATA_PAGE_SIZE - 3, 6, FSKIT_DATA_PAGE_SIZE - 3 );
+      fskit_close( core, fh );
+
+      memcpy( big2, big, FSKIT_DATA_PAGE_SIZE - 3 );
+      memcpy( big2 + FSKIT_DATA_PAGE_SIZE + 3, big + FSKIT_DATA_PAGE_SIZE + 3, big_len - FSKIT_DATA_PAGE_SIZE - 3 );
+
+      check_file( core, "/copy/big", big2, big_len );
+      check_file( core, "/src/big", big, big_len );
+   }
+
+   // clones of clones
+   fskit_test_check_rc( "fskit_clone", "/copy2", fskit_clone( core, "/copy", "/copy2", 0, 0 ), 0 );
+   write_file( core, "/copy/sub/deep/c", "copy", 4 );
+   check_file( core, "/copy2/sub/deep/c", "gamma", 5 );
+   check_file( core, "/copy2/a", "ALPHA", 5 );
+
+   // snapshots are read-only
+   fskit_test_check_rc( "fskit_snapshot", "/snap", fskit_snapshot( core, "/src", "/snap", 0, 0 ), 0 );
+   check_stat( core, "/snap/sub/deep/c", 0, &sb );
+
+   if( (sb.st_mode & 0777) != 0444 ) {
+      fskit_error("/snap/sub/deep/c has mode %o\n", sb.st_mode );
+      exit(1);
+   }
+
+   check_stat( core, "/snap/sub", 0, &sb );
+
+   if( (sb.st_mode & 0777) != 0550 ) {
+      fskit_error("/snap/sub has mode %o\n", sb.st_mode );
+      exit(1);
+   }
+
+   {
+      struct fskit_file_handle* fh = fskit_open( core, "/snap/a", 1, 1, O_WRONLY, 0, &rc );
+      if( fh != NULL || rc != -EACCES ) {
+         fskit_error("fskit_open('/snap/a', O_WRONLY) rc = %d, expected %d\n", rc, -EACCES );
+         exit(1);
+      }
+   }
+
+   // a handle opened before a snapshot doesn't change the snapshot, even in directories it hasn't visited yet
+   {
+      struct fskit_file_handle* fh = fskit_open( core, "/src/sub/deep/e", 0, 0, O_WRONLY, 0, &rc );
+      if( fh == NULL ) {
+         fskit_error("fskit_open('/src/sub/deep/e') rc = %d\n", rc );
+         exit(1);
+      }
+
+      fskit_test_check_rc( "fskit_snapshot", "/snap-open", fskit_snapshot( core, "/src", "/snap-open", 0, 0 ), 0 );
+      fskit_test_check_rc( "fskit_write", "/src/sub/deep/e", fskit_write( core, fh, "EPSILON", 7, 0 ), 7 );
+
+      fskit_test_check_rc( "fskit_snapshot", "/snap-open2", fskit_snapshot( core, "/src", "/snap-open2", 0, 0 ), 0 );
+      fskit_test_check_rc( "fskit_ftrunc", "/src/sub/deep/e", fskit_ftrunc( core, fh, 3 ), 0 );
+
+      fskit_close( core, fh );
+
+      check_file( core, "/snap-open/sub/deep/e", "epsilon", 7 );
+      check_file( core, "/snap-open2/sub/deep/e", "EPSILON", 7 );
+      check_file( core, "/src/sub/deep/e", "EPS", 3 );
+   }
+
+   // removing directories that haven't been filled in yet
+   fskit_test_check_rc( "fskit_clone", "/e", fskit_clone( core, "/src/empty", "/e", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_rmdir", "/e", fskit_rmdir( core, "/e", 0, 0 ), 0 );
+
+   fskit_test_check_rc( "fskit_clone", "/s", fskit_clone( core, "/src/sub", "/s", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_rmdir", "/s", fskit_rmdir( core, "/s", 0, 0 ), -ENOTEMPTY );
+   fskit_test_check_rc( "fskit_deferred_remove_all", "/s", fskit_deferred_remove_all( core, "/s", NULL ), 0 );
+
+   // removing the source doesn't take the clones with it
+   fskit_test_check_rc( "fskit_clone", "/copy3", fskit_clone( core, "/src", "/copy3", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_rmdir", "/src/empty", fskit_rmdir( core, "/src/empty", 0, 0 ), 0 );
+   check_stat( core, "/copy3/empty", 0, &sb );
+
+   // a clone taken and changed while others change the source
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+
+      args[i].core = core;
+      args[i].id = i;
+
+      pthread_create( &threads[i], NULL, worker_main, &args[i] );
+   }
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   fskit_test_check_rc( "fskit_deferred_remove_all", "/src", fskit_deferred_remove_all( core, "/src", NULL ), 0 );
+
+   check_file( core, "/snap/a", "alpha", 5 );
+   check_file( core, "/snap/sub/b", "BETA", 4 );
+   check_file( core, "/snap/sub/deep/e", "epsilon", 7 );
+   check_file( core, "/copy3/sub/deep/c", "GAMMA", 5 );
+   check_file( core, "/copy3/big", big, big_len );
+
+   free( big );
+   free( big2 );
+
+   fskit_test_end( core, &output );
+
+   return 0;
+}
@@ -21,6 +21,53 @@
 
 #include "test-stat.h"
 
+#define RACE_ROUNDS 1000
+
+static volatile bool race_done = false;
+
+static void* stat_main( void* arg ) {
+
+   struct fskit_core* core = (struct fskit_core*)arg;
+   struct stat sb;
+
+   while( !__atomic_load_n( &race_done, __ATOMIC_ACQUIRE ) ) {
+      fskit_stat( core, "/race", 0, 0, &sb );
+   }
+
+   return NULL;
+}
+
+// stat a file while it gets unlinked and freed, so the stat's unlock can be the last thing to touch it
+static int fskit_test_stat_unlink_race( struct fskit_core* core ) {
+
+   int rc = 0;
+   pthread_t statter;
+   struct fskit_file_handle* fh = NULL;
+
+   pthread_create( &statter, NULL, stat_main, core );
+
+   for( int i = 0; i < RACE_ROUNDS && rc == 0; i++ ) {
+
+      fh = fskit_create( core, "/race", 0, 0, 0644, &rc );
+      if( fh == NULL ) {
+         fskit_error("fskit_create('/race') rc = %d\n", rc );
+         break;
+      }
+
+      fskit_close( core, fh );
+
+      rc = fskit_unlink( core, "/race", 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_unlink('/race') rc = %d\n", rc );
+      }
+   }
+
+   __atomic_store_n( &race_done, true, __ATOMIC_RELEASE );
+   pthread_join( statter, NULL );
+
+   return rc;
+}
+
 int main( int argc, char** argv ) {
 
    struct fskit_core* core = NULL;
@@ -66,6 +113,11 @@ int main( int argc, char** argv ) {
                name_buf, sb.st_dev, sb.st_ino, sb.st_mode, sb.st_nlink, sb.st_uid, sb.st_gid, sb.st_rdev, sb.st_size, sb.st_blksize, sb.st_blocks );
    }
 
+   rc = fskit_test_stat_unlink_race( core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
    fskit_print_tree( stdout, fskit_core_get_root( core ) );
 
    fskit_test_end( core, &output );
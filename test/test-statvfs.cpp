@@ -0,0 +1,289 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-statvfs.h"
+
+#define NUM_THREADS     4
+#define THREAD_FILES    500
+
+// check one usage count
+static void check_count( char const* what, uint64_t count, uint64_t expected ) {
+
+   if( count != expected ) {
+      fskit_error("%s = %" PRIu64 ", expected %" PRIu64 "\n", what, count, expected );
+      exit(1);
+   }
+}
+
+static void check_usage( struct fskit_core* core, uint64_t inodes, uint64_t dirents, uint64_t xattr_bytes, uint64_t data_bytes ) {
+
+   struct fskit_usage_info info;
+
+   fskit_core_get_usage( core, &info );
+
+   check_count( "inodes", info.inodes, inodes );
+   check_count( "dirents", info.dirents, dirents );
+   check_count( "xattr_bytes", info.xattr_bytes, xattr_bytes );
+   check_count( "data_bytes", info.data_bytes, data_bytes );
+}
+
+// write to a file, and return what fskit_write returned
+static ssize_t write_file( struct fskit_core* core, char const* path, size_t len, off_t offset ) {
+
+   int rc = 0;
+   ssize_t nw = 0;
+   char* buf = (char*)calloc( len + 1, 1 );
+
+   struct fskit_file_handle* fh = fskit_open( core, path, 0, 0, O_WRONLY, 0644, &rc );
+   if( fh == NULL && rc == -ENOENT ) {
+      fh = fskit_open( core, path, 0, 0, O_CREAT | O_WRONLY, 0644, &rc );
+   }
+
+   if( fh == NULL || buf == NULL ) {
+      fskit_error("fskit_open('%s') rc = %d\n", path, rc );
+      exit(1);
+   }
+
+   nw = fskit_write( core, fh, buf, len, offset );
+
+   fskit_close( core, fh );
+   free( buf );
+
+   return nw;
+}
+
+// create and remove files, concurrently with other threads
+static void* worker_main( void* arg ) {
+
+   struct fskit_core* core = (struct fskit_core*)arg;
+   char path[100];
+   int rc = 0;
+
+   for( int i = 0; i < THREAD_FILES; i++ ) {
+
+      snprintf( path, sizeof(path), "/threads/%lx-%d", (unsigned long)pthread_self(), i );
+
+      rc = fskit_mknod( core, path, S_IFREG | 0644, 0, 0, 0 );
+      fskit_test_check_rc( "fskit_mknod", path, rc, 0 );
+
+      if( i % 2 == 0 ) {
+
+         rc = fskit_unlink( core, path, 0, 0 );
+         fskit_test_check_rc( "fskit_unlink", path, rc, 0 );
+      }
+   }
+
+   return NULL;
+}
+
+// grow one file from many threads, truncating it now and then, so the size changes race
+static void* grower_main( void* arg ) {
+
+   struct fskit_core* core = (struct fskit_core*)arg;
+   static uint64_t next_block = 0;
+   char buf[10];
+   int rc = 0;
+
+   memset( buf, 'x', sizeof(buf) );
+
+   struct fskit_file_handle* fh = fskit_open( core, "/grow", 0, 0, O_WRONLY, 0644, &rc );
+   fskit_test_check_rc( "fskit_open", "/grow", (fh == NULL ? rc : 0), 0 );
+
+   for( int i = 0; i < THREAD_FILES; i++ ) {
+
+      off_t offset = __sync_fetch_and_add( &next_block, 1 ) * sizeof(buf);
+
+      fskit_test_check_rc( "fskit_write", "/grow", (int)fskit_write( core, fh, buf, sizeof(buf), offset ), sizeof(buf) );
+
+      if( i % 64 == 63 ) {
+         fskit_test_check_rc( "fskit_trunc", "/grow", fskit_trunc( core, "/grow", 0, 0, offset / 2 ), 0 );
+      }
+   }
+
+   fskit_close( core, fh );
+   return NULL;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   struct fskit_usage_info info;
+   struct fskit_file_handle* fh = NULL;
+   struct statvfs vfs;
+   struct stat sb;
+   pthread_t threads[NUM_THREADS];
+   int rc = 0;
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   rc = fskit_data_route( core, FSKIT_ROUTE_ANY );
+   if( rc != 0 ) {
+      fskit_error("fskit_data_route rc = %d\n", rc );
+      exit(1);
+   }
+
+   // just the root
+   check_usage( core, 1, 0, 0, 0 );
+
+   // /a/{f1, hard, fifo, sym}
+   fskit_test_check_rc( "fskit_mkdir", "/a", fskit_mkdir( core, "/a", 0755, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_write", "/a/f1", (int)write_file( core, "/a/f1", 100, 0 ), 100 );
+   fskit_test_check_rc( "fskit_link", "/a/hard", fskit_link( core, "/a/f1", "/a/hard", 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mknod", "/a/fifo", fskit_mknod( core, "/a/fifo", S_IFIFO | 0644, 0, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_symlink", "/a/sym", fskit_symlink( core, "f1", "/a/sym", 0, 0 ), 0 );
+
+   check_usage( core, 5, 5, 0, 100 );
+
+   fskit_core_get_usage( core, &info );
+   check_count( "dirs", info.inodes_by_type[ FSKIT_ENTRY_TYPE_DIR ], 2 );
+   check_count( "files", info.inodes_by_type[ FSKIT_ENTRY_TYPE_FILE ], 1 );
+   check_count( "fifos", info.inodes_by_type[ FSKIT_ENTRY_TYPE_FIFO ], 1 );
+   check_count( "symlinks", info.inodes_by_type[ FSKIT_ENTRY_TYPE_LNK ], 1 );
+
+   // xattrs count their names and values
+   fskit_test_check_rc( "fskit_setxattr", "/a/f1", fskit_setxattr( core, "/a/f1", 0, 0, "user.x", "abc", 3, 0 ), 0 );
+   check_usage( core, 5, 5, 9, 100 );
+
+   fskit_test_check_rc( "fskit_setxattr", "/a/f1", fskit_setxattr( core, "/a/f1", 0, 0, "user.x", "abcdef", 6, 0 ), 0 );
+   fskit_test_check_rc( "fskit_setxattr", "/a", fskit_setxattr( core, "/a", 0, 0, "user.y", "", 0, 0 ), 0 );
+   check_usage( core, 5, 5, 18, 100 );
+
+   fskit_test_check_rc( "fskit_removexattr", "/a/f1", fskit_removexattr( core, "/a/f1", 0, 0, "user.x" ), 0 );
+   check_usage( core, 5, 5, 6, 100 );
+
+   // sizes follow writes and truncates
+   fskit_test_check_rc( "fskit_write", "/a/f1", (int)write_file( core, "/a/f1", 50, 200 ), 50 );
+   check_usage( core, 5, 5, 6, 250 );
+
+   fskit_test_check_rc( "fskit_trunc", "/a/f1", fskit_trunc( core, "/a/f1", 0, 0, 20 ), 0 );
+   check_usage( core, 5, 5, 6, 20 );
+
+   // removing a link only removes a name
+   fskit_test_check_rc( "fskit_unlink", "/a/hard", fskit_unlink( core, "/a/hard", 0, 0 ), 0 );
+   check_usage( core, 5, 4, 6, 20 );
+
+   fskit_test_check_rc( "fskit_unlink", "/a/f1", fskit_unlink( core, "/a/f1", 0, 0 ), 0 );
+   check_usage( core, 4, 3, 6, 0 );
+
+   fskit_test_check_rc( "fskit_rename", "/a/fifo", fskit_rename( core, "/a/fifo", "/fifo", 0, 0 ), 0 );
+   check_usage( core, 4, 3, 6, 0 );
+
+   // inode limit
+   fskit_test_check_rc( "fskit_core_set_limits", "/", fskit_core_set_limits( core, 6, 0 ), 0 );
+
+   fskit_test_check_rc( "fskit_mkdir", "/b", fskit_mkdir( core, "/b", 0755, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mknod", "/b/c", fskit_mknod( core, "/b/c", S_IFREG | 0644, 0, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_mknod", "/b/d", fskit_mknod( core, "/b/d", S_IFREG | 0644, 0, 0, 0 ), -ENOSPC );
+   fskit_test_check_rc( "fskit_mkdir", "/b/d", fskit_mkdir( core, "/b/d", 0755, 0, 0 ), -ENOSPC );
+   fskit_test_check_rc( "fskit_symlink", "/b/d", fskit_symlink( core, "c", "/b/d", 0, 0 ), -ENOSPC );
+
+   fh = fskit_open( core, "/b/d", 0, 0, O_CREAT | O_WRONLY, 0644, &rc );
+   fskit_test_check_rc( "fskit_open", "/b/d", (fh == NULL ? rc : 0), -ENOSPC );
+
+   check_usage( core, 6, 5, 6, 0 );
+
+   fskit_test_check_rc( "fskit_statvfs", "/", fskit_statvfs( core, "/", 0, 0, &vfs ), 0 );
+   check_count( "f_files", vfs.f_files, 6 );
+   check_count( "f_ffree", vfs.f_ffree, 0 );
+   check_count( "f_bsize", vfs.f_bsize, FSKIT_STATVFS_BLOCK_SIZE );
+
+   // a link doesn't need an inode
+   fskit_test_check_rc( "fskit_link", "/b/e", fskit_link( core, "/b/c", "/b/e", 0, 0 ), 0 );
+
+   // byte limit: 2 blocks, 6 bytes of which are in use
+   fskit_test_check_rc( "fskit_core_set_limits", "/", fskit_core_set_limits( core, 0, 2 * FSKIT_STATVFS_BLOCK_SIZE ), 0 );
+
+   fskit_test_check_rc( "fskit_write", "/b/c", (int)write_file( core, "/b/c", 2 * FSKIT_STATVFS_BLOCK_SIZE - 6, 0 ), 2 * FSKIT_STATVFS_BLOCK_SIZE - 6 );
+   fskit_test_check_rc( "fskit_write", "/b/c", (int)write_file( core, "/b/c", 1, 2 * FSKIT_STATVFS_BLOCK_SIZE - 6 ), -ENOSPC );
+   fskit_test_check_rc( "fskit_trunc", "/b/c", fskit_trunc( core, "/b/c", 0, 0, 2 * FSKIT_STATVFS_BLOCK_SIZE ), -ENOSPC );
+   fskit_test_check_rc( "fskit_setxattr", "/b/c", fskit_setxattr( core, "/b/c", 0, 0, "user.z", "1", 1, 0 ), -ENOSPC );
+
+   // overwriting doesn't need more space
+   fskit_test_check_rc( "fskit_write", "/b/c", (int)write_file( core, "/b/c", 100, 0 ), 100 );
+
+   fskit_test_check_rc( "fskit_statvfs", "/", fskit_statvfs( core, "/", 0, 0, &vfs ), 0 );
+   check_count( "f_blocks", vfs.f_blocks, 2 );
+   check_count( "f_bfree", vfs.f_bfree, 0 );
+
+   fskit_test_check_rc( "fskit_trunc", "/b/c", fskit_trunc( core, "/b/c", 0, 0, FSKIT_STATVFS_BLOCK_SIZE - 6 ), 0 );
+   fskit_test_check_rc( "fskit_statvfs", "/", fskit_statvfs( core, "/", 0, 0, &vfs ), 0 );
+   check_count( "f_bfree", vfs.f_bfree, 1 );
+
+   fskit_test_check_rc( "fskit_core_set_limits", "/", fskit_core_set_limits( core, 0, 0 ), 0 );
+
+   // recursive removal gives everything back
+   fskit_test_check_rc( "fskit_deferred_remove_all", "/b", fskit_deferred_remove_all( core, "/b", NULL ), 0 );
+   fskit_test_check_rc( "fskit_deferred_wait", "/b", fskit_deferred_wait( core ), 0 );
+   fskit_test_check_rc( "fskit_unlink", "/fifo", fskit_unlink( core, "/fifo", 0, 0 ), 0 );
+
+   check_usage( core, 3, 2, 6, 0 );
+
+   // clones are charged as they are filled in
+   fskit_test_check_rc( "fskit_mknod", "/a/g", fskit_mknod( core, "/a/g", S_IFREG | 0644, 0, 0, 0 ), 0 );
+   fskit_test_check_rc( "fskit_clone", "/copy", fskit_clone( core, "/a", "/copy", 0, 0 ), 0 );
+   check_usage( core, 5, 4, 12, 0 );
+
+   fskit_test_check_rc( "fskit_stat", "/copy/g", fskit_stat( core, "/copy/g", 0, 0, &sb ), 0 );
+   check_usage( core, 7, 6, 12, 0 );
+
+   // lots of threads at once
+   fskit_test_check_rc( "fskit_mkdir", "/threads", fskit_mkdir( core, "/threads", 0755, 0, 0 ), 0 );
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_create( &threads[i], NULL, worker_main, core );
+   }
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   check_usage( core, 8 + NUM_THREADS * THREAD_FILES / 2, 7 + NUM_THREADS * THREAD_FILES / 2, 12, 0 );
+
+   fskit_test_check_rc( "fskit_deferred_remove_all", "/threads", fskit_deferred_remove_all( core, "/threads", NULL ), 0 );
+   fskit_test_check_rc( "fskit_deferred_remove_all", "/copy", fskit_deferred_remove_all( core, "/copy", NULL ), 0 );
+   fskit_test_check_rc( "fskit_deferred_wait", "/", fskit_deferred_wait( core ), 0 );
+
+   check_usage( core, 4, 3, 6, 0 );
+
+   // concurrent writes and truncates charge exactly the final size
+   fskit_test_check_rc( "fskit_mknod", "/grow", fskit_mknod( core, "/grow", S_IFREG | 0644, 0, 0, 0 ), 0 );
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_create( &threads[i], NULL, grower_main, core );
+   }
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   fskit_test_check_rc( "fskit_stat", "/grow", fskit_stat( core, "/grow", 0, 0, &sb ), 0 );
+   check_usage( core, 5, 4, 6, sb.st_size );
+
+   fskit_test_check_rc( "fskit_unlink", "/grow", fskit_unlink( core, "/grow", 0, 0 ), 0 );
+   check_usage( core, 4, 3, 6, 0 );
+
+   fskit_test_end( core, NULL );
+
+   return 0;
+}
@@ -0,0 +1,493 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+// concurrent torture test: many threads run a random mix of namespace operations against one core,
+// over a small set of names so that they collide.  Afterwards, walk the tree and check its invariants.
+// usage: test-torture [NUM_THREADS [SECONDS [SEED]]]
+// build with TSAN=1 to run it under ThreadSanitizer.
+
+#include "test-torture.h"
+
+#include <vector>
+
+using namespace std;
+
+#define NUM_TOP         4       // top-level directories; these are never removed
+#define NUM_NAMES       8       // names in each top-level directory
+#define NUM_SUBNAMES    4       // names in each second-level directory
+#define NUM_STASH       8       // handles each thread may hold open at once
+
+#define OP_CREATE       0
+#define OP_MKDIR        1
+#define OP_RENAME       2
+#define OP_UNLINK       3
+#define OP_RMDIR        4
+#define OP_READDIR      5
+#define OP_OPEN         6
+#define OP_CLOSE        7
+#define OP_NUM_OPS      8
+
+static char const* op_names[OP_NUM_OPS] = {
+   "create", "mkdir", "rename", "unlink", "rmdir", "readdir", "open", "close"
+};
+
+struct torture_thread {
+   struct fskit_core* core;
+   unsigned int seed;
+   uint64_t ops[OP_NUM_OPS];
+   uint64_t errs[OP_NUM_OPS];
+   struct fskit_file_handle* stash[NUM_STASH];
+   int num_stash;
+};
+
+static int running = 1;
+static int failures = 0;
+
+// errors that colliding operations are expected to produce
+static bool expected_error( int rc ) {
+
+   switch( rc ) {
+      case -ENOENT:
+      case -EEXIST:
+      case -ENOTEMPTY:
+      case -ENOTDIR:
+      case -EISDIR:
+      case -EINVAL:
+      case -EBUSY:
+         return true;
+
+      default:
+         return false;
+   }
+}
+
+// tally an operation's result
+static void tally( struct torture_thread* thr, int op, char const* path, int rc ) {
+
+   thr->ops[op]++;
+
+   if( rc == 0 ) {
+      return;
+   }
+
+   if( expected_error( rc ) ) {
+      thr->errs[op]++;
+   }
+   else {
+      fskit_error("%s('%s') rc = %d\n", op_names[op], path, rc );
+      __atomic_add_fetch( &failures, 1, __ATOMIC_SEQ_CST );
+   }
+}
+
+// make a random path at the given depth (1 or 2) beneath a top-level directory
+static void random_path( struct torture_thread* thr, int depth, char* path, size_t len ) {
+
+   int top = rand_r( &thr->seed ) % NUM_TOP;
+   int name = rand_r( &thr->seed ) % NUM_NAMES;
+
+   if( depth == 1 ) {
+      snprintf( path, len, "/d%d/n%d", top, name );
+   }
+   else {
+      snprintf( path, len, "/d%d/n%d/m%d", top, name, rand_r( &thr->seed ) % NUM_SUBNAMES );
+   }
+}
+
+// close one of the handles we hold
+static void close_stashed( struct torture_thread* thr, int i ) {
+
+   int rc = fskit_close( thr->core, thr->stash[i] );
+   tally( thr, OP_CLOSE, "", rc );
+
+   thr->num_stash--;
+   thr->stash[i] = thr->stash[ thr->num_stash ];
+   thr->stash[ thr->num_stash ] = NULL;
+}
+
+// either hold onto a new handle for a while, or close it now
+static void stash_or_close( struct torture_thread* thr, struct fskit_file_handle* fh ) {
+
+   if( rand_r( &thr->seed ) % 2 == 0 ) {
+
+      tally( thr, OP_CLOSE, "", fskit_close( thr->core, fh ) );
+      return;
+   }
+
+   if( thr->num_stash == NUM_STASH ) {
+      close_stashed( thr, rand_r( &thr->seed ) % NUM_STASH );
+   }
+
+   thr->stash[ thr->num_stash ] = fh;
+   thr->num_stash++;
+}
+
+// list a directory through a directory handle
+static int list_dir( struct fskit_core* core, char const* path ) {
+
+   int rc = 0;
+   uint64_t num_read = 0;
+
+   struct fskit_dir_handle* dh = fskit_opendir( core, path, 0, 0, &rc );
+   if( dh == NULL ) {
+      return rc;
+   }
+
+   struct fskit_dir_entry** dents = fskit_listdir( core, dh, &num_read, &rc );
+   if( dents != NULL ) {
+      fskit_dir_entry_free_list( dents );
+   }
+
+   int close_rc = fskit_closedir( core, dh );
+   return (rc != 0 ? rc : close_rc);
+}
+
+// run random operations until told to stop
+static void* torture_main( void* arg ) {
+
+   struct torture_thread* thr = (struct torture_thread*)arg;
+   struct fskit_file_handle* fh = NULL;
+   char path[256];
+   char path2[256];
+   int depth = 0;
+   int rc = 0;
+
+   while( __atomic_load_n( &running, __ATOMIC_RELAXED ) ) {
+
+      int op = rand_r( &thr->seed ) % OP_NUM_OPS;
+      depth = 1 + rand_r( &thr->seed ) % 2;
+
+      random_path( thr, depth, path, sizeof(path) );
+
+      switch( op ) {
+
+         case OP_CREATE:
+
+            fh = fskit_create( thr->core, path, 0, 0, 0644, &rc );
+            tally( thr, op, path, rc );
+
+            if( fh != NULL ) {
+               stash_or_close( thr, fh );
+            }
+            break;
+
+         case OP_MKDIR:
+
+            random_path( thr, 1, path, sizeof(path) );
+            tally( thr, op, path, fskit_mkdir( thr->core, path, 0755, 0, 0 ) );
+            break;
+
+         case OP_RENAME:
+
+            random_path( thr, depth, path2, sizeof(path2) );
+            tally( thr, op, path, fskit_rename( thr->core, path, path2, 0, 0 ) );
+            break;
+
+         case OP_UNLINK:
+
+            tally( thr, op, path, fskit_unlink( thr->core, path, 0, 0 ) );
+            break;
+
+         case OP_RMDIR:
+
+            random_path( thr, 1, path, sizeof(path) );
+            tally( thr, op, path, fskit_rmdir( thr->core, path, 0, 0 ) );
+            break;
+
+         case OP_READDIR:
+
+            // list either a top-level directory or one of the directories beneath it
+            if( depth == 2 ) {
+               snprintf( path, sizeof(path), "/d%d", rand_r( &thr->seed ) % NUM_TOP );
+            }
+            else {
+               random_path( thr, 1, path, sizeof(path) );
+            }
+
+            tally( thr, op, path, list_dir( thr->core, path ) );
+            break;
+
+         case OP_OPEN:
+
+            fh = fskit_open( thr->core, path, 0, 0, O_RDONLY, 0, &rc );
+            tally( thr, op, path, rc );
+
+            if( fh != NULL ) {
+               stash_or_close( thr, fh );
+            }
+            break;
+
+         case OP_CLOSE:
+
+            if( thr->num_stash > 0 ) {
+               close_stashed( thr, rand_r( &thr->seed ) % thr->num_stash );
+            }
+            break;
+      }
+   }
+
+   while( thr->num_stash > 0 ) {
+      close_stashed( thr, thr->num_stash - 1 );
+   }
+
+   return NULL;
+}
+
+// find a named entry in a directory's child set
+static struct fskit_entry* find_child( struct fskit_entry* dir, char const* name ) {
+
+   fskit_entry_set_itr itr;
+
+   for( fskit_entry_set* dp = fskit_entry_set_begin( &itr, fskit_entry_get_children( dir ) ); dp != NULL; dp = fskit_entry_set_next( &itr ) ) {
+
+      if( strcmp( fskit_entry_set_name_at( dp ), name ) == 0 ) {
+         return fskit_entry_set_child_at( dp );
+      }
+   }
+
+   return NULL;
+}
+
+// walk the quiescent tree, and check that:
+// * every reachable entry is alive, has one link, and has no open handles or references
+// * every directory's child count matches its child set, and its . and .. are correct
+// * the core's usage counters account for exactly the reachable entries (i.e. nothing leaked)
+// * the memory report counts exactly the reachable directory entries and names
+// return the number of violations found
+static int check_tree( struct fskit_core* core, uint64_t* num_entries ) {
+
+   int bad = 0;
+   uint64_t num_dirents = 0;
+   uint64_t num_set_nodes = 0;
+   uint64_t name_bytes = 0;
+   fskit_entry_set_itr itr;
+   vector< struct fskit_entry* > frontier;
+   struct fskit_usage_info usage;
+   struct fskit_memory_report report;
+
+   struct fskit_entry* root = fskit_core_get_root( core );
+   frontier.push_back( root );
+
+   *num_entries = 0;
+
+   while( frontier.size() > 0 ) {
+
+      struct fskit_entry* node = frontier.back();
+      frontier.pop_back();
+
+      (*num_entries)++;
+
+      uint64_t file_id = fskit_entry_get_file_id( node );
+      int type = fskit_entry_get_type( node );
+
+      if( type == FSKIT_ENTRY_TYPE_DEAD || fskit_entry_get_deletion_in_progress( node ) ) {
+         fskit_error("%" PRIX64 ": reachable but dead\n", file_id );
+         bad++;
+         continue;
+      }
+
+      if( node != root && fskit_entry_get_link_count( node ) != 1 ) {
+         fskit_error("%" PRIX64 ": link count = %d, expected 1\n", file_id, fskit_entry_get_link_count( node ) );
+         bad++;
+      }
+
+      if( fskit_entry_get_open_count( node ) != 0 ) {
+         fskit_error("%" PRIX64 ": open count = %d, expected 0\n", file_id, fskit_entry_get_open_count( node ) );
+         bad++;
+      }
+
+      if( type != FSKIT_ENTRY_TYPE_DIR ) {
+         continue;
+      }
+
+      if( find_child( node, "." ) != node ) {
+         fskit_error("%" PRIX64 ": . is %p, expected %p\n", file_id, find_child( node, "." ), node );
+         bad++;
+      }
+
+      int64_t num_children = 0;
+
+      for( fskit_entry_set* dp = fskit_entry_set_begin( &itr, fskit_entry_get_children( node ) ); dp != NULL; dp = fskit_entry_set_next( &itr ) ) {
+
+         char const* name = fskit_entry_set_name_at( dp );
+         struct fskit_entry* child = fskit_entry_set_child_at( dp );
+
+         num_set_nodes++;
+         name_bytes += strlen( name ) + 1;
+
+         if( strcmp( name, "." ) == 0 || strcmp( name, ".." ) == 0 ) {
+            continue;
+         }
+
+         num_children++;
+         num_dirents++;
+
+         if( child == NULL ) {
+            fskit_error("%" PRIX64 ": child '%s' is NULL\n", file_id, name );
+            bad++;
+            continue;
+         }
+
+         if( fskit_entry_get_type( child ) == FSKIT_ENTRY_TYPE_DIR && find_child( child, ".." ) != node ) {
+            fskit_error("%" PRIX64 ": .. of '%s' is %p, expected %p\n", file_id, name, find_child( child, ".." ), node );
+            bad++;
+         }
+
+         frontier.push_back( child );
+      }
+
+      if( fskit_entry_get_num_children( node ) != num_children ) {
+         fskit_error("%" PRIX64 ": num_children = %" PRId64 ", but has %" PRId64 " children\n", file_id, fskit_entry_get_num_children( node ), num_children );
+         bad++;
+      }
+   }
+
+   fskit_core_get_usage( core, &usage );
+
+   if( usage.inodes != *num_entries || usage.dirents != num_dirents ) {
+      fskit_error("usage counts %" PRIu64 " inodes and %" PRIu64 " dirents, but %" PRIu64 " and %" PRIu64 " are reachable\n", usage.inodes, usage.dirents, *num_entries, num_dirents );
+      bad++;
+   }
+
+   fskit_core_memory_report( core, &report );
+
+   if( report.num_entry_set_nodes != num_set_nodes || report.names != name_bytes ) {
+      fskit_error("memory report counts %" PRIu64 " set nodes and %" PRIu64 " name bytes, but %" PRIu64 " and %" PRIu64 " are reachable\n", report.num_entry_set_nodes, report.names, num_set_nodes, name_bytes );
+      bad++;
+   }
+
+   return bad;
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   int num_threads = 8;
+   int seconds = 2;
+   unsigned int seed = 1;
+   uint64_t num_entries = 0;
+   uint64_t ops[OP_NUM_OPS];
+   uint64_t errs[OP_NUM_OPS];
+   uint64_t total = 0;
+   struct timespec ts_start, ts_end;
+   char path[256];
+   int rc = 0;
+
+   if( argc > 1 ) {
+      num_threads = atoi( argv[1] );
+   }
+   if( argc > 2 ) {
+      seconds = atoi( argv[2] );
+   }
+   if( argc > 3 ) {
+      seed = strtoul( argv[3], NULL, 10 );
+   }
+
+   if( num_threads <= 0 || seconds <= 0 ) {
+      fprintf( stderr, "Usage: %s [NUM_THREADS [SECONDS [SEED]]]\n", argv[0] );
+      exit(1);
+   }
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   for( int i = 0; i < NUM_TOP; i++ ) {
+
+      snprintf( path, sizeof(path), "/d%d", i );
+
+      rc = fskit_mkdir( core, path, 0755, 0, 0 );
+      if( rc != 0 ) {
+         fskit_error("fskit_mkdir('%s') rc = %d\n", path, rc );
+         exit(1);
+      }
+   }
+
+   vector< struct torture_thread > thrs( num_threads );
+   vector< pthread_t > threads( num_threads );
+
+   printf("%d threads, %d seconds, seed %u\n", num_threads, seconds, seed );
+
+   clock_gettime( CLOCK_MONOTONIC, &ts_start );
+
+   for( int i = 0; i < num_threads; i++ ) {
+
+      memset( &thrs[i], 0, sizeof(struct torture_thread) );
+      thrs[i].core = core;
+      thrs[i].seed = seed + i;
+
+      rc = pthread_create( &threads[i], NULL, torture_main, &thrs[i] );
+      if( rc != 0 ) {
+         fskit_error("pthread_create rc = %d\n", rc );
+         exit(1);
+      }
+   }
+
+   sleep( seconds );
+   __atomic_store_n( &running, 0, __ATOMIC_RELAXED );
+
+   for( int i = 0; i < num_threads; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   clock_gettime( CLOCK_MONOTONIC, &ts_end );
+
+   double elapsed = (ts_end.tv_sec - ts_start.tv_sec) + (ts_end.tv_nsec - ts_start.tv_nsec) / 1e9;
+
+   memset( ops, 0, sizeof(ops) );
+   memset( errs, 0, sizeof(errs) );
+
+   for( int i = 0; i < num_threads; i++ ) {
+      for( int op = 0; op < OP_NUM_OPS; op++ ) {
+         ops[op] += thrs[i].ops[op];
+         errs[op] += thrs[i].errs[op];
+      }
+   }
+
+   for( int op = 0; op < OP_NUM_OPS; op++ ) {
+
+      printf("%-8s %10" PRIu64 " ops %10" PRIu64 " errors %12.0f ops/sec\n", op_names[op], ops[op], errs[op], ops[op] / elapsed );
+      total += ops[op];
+   }
+
+   printf("%-8s %10" PRIu64 " ops %28.0f ops/sec\n", "total", total, total / elapsed );
+
+   if( failures != 0 ) {
+      fskit_error("%d operations failed unexpectedly\n", failures );
+      exit(1);
+   }
+
+   rc = check_tree( core, &num_entries );
+   if( rc != 0 ) {
+      fskit_error("%d invariant violations in %" PRIu64 " entries\n", rc, num_entries );
+      fskit_print_tree( stdout, fskit_core_get_root( core ) );
+      exit(1);
+   }
+
+   printf("%" PRIu64 " entries checked\n", num_entries );
+
+   rc = fskit_test_end( core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   return 0;
+}
@@ -21,6 +21,54 @@
 
 #include "test-unlink.h"
 
+#define RACE_ROUNDS 1000
+
+struct race_args {
+
+   struct fskit_core* core;
+   struct fskit_file_handle* fh;
+};
+
+static void* close_main( void* arg ) {
+
+   struct race_args* args = (struct race_args*)arg;
+
+   fskit_close( args->core, args->fh );
+   return NULL;
+}
+
+// unlink a file while another thread closes its last handle, so that either one may be the one to free it
+static int fskit_test_unlink_close_race( struct fskit_core* core ) {
+
+   int rc = 0;
+   pthread_t closer;
+   struct race_args args;
+
+   args.core = core;
+
+   for( int i = 0; i < RACE_ROUNDS; i++ ) {
+
+      args.fh = fskit_create( core, "/race", 0, 0, 0644, &rc );
+      if( args.fh == NULL ) {
+         fskit_error("fskit_create('/race') rc = %d\n", rc );
+         return rc;
+      }
+
+      pthread_create( &closer, NULL, close_main, &args );
+
+      rc = fskit_unlink( core, "/race", 0, 0 );
+
+      pthread_join( closer, NULL );
+
+      if( rc != 0 ) {
+         fskit_error("fskit_unlink('/race') rc = %d\n", rc );
+         return rc;
+      }
+   }
+
+   return 0;
+}
+
 int main( int argc, char** argv ) {
 
    struct fskit_core* core = NULL;
@@ -60,6 +108,45 @@ int main( int argc, char** argv ) {
       }
    }
 
+   // no parent to unlock
+   rc = fskit_unlink( core, "/nonexistent/0", 0, 0 );
+   if( rc != -ENOENT ) {
+      fskit_error("fskit_unlink('/nonexistent/0') rc = %d, expected %d\n", rc, -ENOENT );
+      exit(1);
+   }
+
+   // a directory with one child is not empty
+   rc = fskit_mkdir( core, "/dir", 0755, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mkdir('/dir') rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_mknod( core, "/dir/child", S_IFREG | 0644, 0, 0, 0 );
+   if( rc != 0 ) {
+      fskit_error("fskit_mknod('/dir/child') rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_unlink( core, "/dir", 0, 0 );
+   if( rc != -ENOTEMPTY ) {
+      fskit_error("fskit_unlink('/dir') rc = %d, expected %d\n", rc, -ENOTEMPTY );
+      exit(1);
+   }
+
+   struct fskit_entry* child = fskit_entry_resolve_path( core, "/dir/child", 0, 0, false, &rc );
+   if( child == NULL ) {
+      fskit_error("fskit_entry_resolve_path('/dir/child') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fskit_entry_unlock( child );
+
+   rc = fskit_test_unlink_close_race( core );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
    fskit_print_tree( stdout, fskit_core_get_root(core) );
 
    fskit_test_end( core, &output );
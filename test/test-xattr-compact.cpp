@@ -0,0 +1,201 @@
+/*
+   fskit: a library for creating multi-threaded in-RAM filesystems
+   Copyright (C) 2014  Jude Nelson
+
+   This program is dual-licensed: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License version 3 or later as
+   published by the Free Software Foundation. For the terms of this
+   license, see LICENSE.LGPLv3+ or <http://www.gnu.org/licenses/>.
+
+   You are free to use this program under the terms of the GNU Lesser General
+   Public License, but WITHOUT ANY WARRANTY; without even the implied
+   warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   See the GNU Lesser General Public License for more details.
+
+   Alternatively, you are free to use this program under the terms of the
+   Internet Software Consortium License, but WITHOUT ANY WARRANTY; without
+   even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+   For the terms of this license, see LICENSE.ISC or
+   <http://www.isc.org/downloads/software-support-policy/isc-license/>.
+*/
+
+#include "test-xattr-compact.h"
+
+// check that an attribute has the given value (or is absent, if value is NULL)
+static void check_xattr( struct fskit_core* core, char const* path, char const* name, char const* value, size_t value_len ) {
+
+   char buf[1024];
+
+   int rc = fskit_getxattr( core, path, 0, 0, name, buf, sizeof(buf) );
+
+   if( value == NULL ) {
+      if( rc != -ENOATTR ) {
+         fskit_error("fskit_getxattr('%s', '%s') rc = %d, expected %d\n", path, name, rc, -ENOATTR );
+         exit(1);
+      }
+
+      return;
+   }
+
+   if( rc != (int)value_len || memcmp( buf, value, value_len ) != 0 ) {
+      fskit_error("fskit_getxattr('%s', '%s') rc = %d, expected %zu\n", path, name, rc, value_len );
+      exit(1);
+   }
+}
+
+// check that the attribute names are exactly the given '\0'-separated list
+static void check_list( struct fskit_core* core, char const* path, char const* expected, int expected_len ) {
+
+   char buf[4096];
+
+   int rc = fskit_listxattr( core, path, 0, 0, NULL, 0 );
+   if( rc != expected_len ) {
+      fskit_error("fskit_listxattr('%s') length = %d, expected %d\n", path, rc, expected_len );
+      exit(1);
+   }
+
+   if( expected_len > 0 ) {
+
+      rc = fskit_listxattr( core, path, 0, 0, buf, expected_len - 1 );
+      if( rc != -ERANGE ) {
+         fskit_error("fskit_listxattr('%s') with a short buffer rc = %d\n", path, rc );
+         exit(1);
+      }
+   }
+
+   rc = fskit_listxattr( core, path, 0, 0, buf, sizeof(buf) );
+   if( rc != expected_len || memcmp( buf, expected, expected_len ) != 0 ) {
+      fskit_error("fskit_listxattr('%s') rc = %d, names differ\n", path, rc );
+      exit(1);
+   }
+}
+
+static void set_xattr( struct fskit_core* core, char const* path, char const* name, char const* value, size_t value_len, int flags, int expected_rc ) {
+
+   int rc = fskit_setxattr( core, path, 0, 0, name, value, value_len, flags );
+   if( rc != expected_rc ) {
+      fskit_error("fskit_setxattr('%s', '%s') rc = %d, expected %d\n", path, name, rc, expected_rc );
+      exit(1);
+   }
+}
+
+int main( int argc, char** argv ) {
+
+   struct fskit_core* core = NULL;
+   int rc;
+   void* output = NULL;
+   char name_buf[100];
+   char big[1000];
+   struct fskit_file_handle* fh = NULL;
+   struct fskit_entry* fent = NULL;
+
+   rc = fskit_test_begin( &core, NULL );
+   if( rc != 0 ) {
+      exit(1);
+   }
+
+   fh = fskit_create( core, "/a", 0, 0, 0644, &rc );
+   if( fh == NULL ) {
+      fskit_error("fskit_create('/a') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fskit_close( core, fh );
+
+   fh = fskit_create( core, "/b", 0, 0, 0644, &rc );
+   if( fh == NULL ) {
+      fskit_error("fskit_create('/b') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fskit_close( core, fh );
+
+   // nothing set yet
+   check_list( core, "/a", "", 0 );
+   check_xattr( core, "/a", "user.x", NULL, 0 );
+
+   // small attributes, out of order; listed sorted
+   set_xattr( core, "/a", "user.b", "2", 1, XATTR_CREATE, 0 );
+   set_xattr( core, "/a", "user.c", "33", 2, XATTR_CREATE, 0 );
+   set_xattr( core, "/a", "user.a", "", 0, XATTR_CREATE, 0 );
+
+   check_list( core, "/a", "user.a\0user.b\0user.c", 21 );
+   check_xattr( core, "/a", "user.a", "", 0 );
+   check_xattr( core, "/a", "user.b", "2", 1 );
+   check_xattr( core, "/a", "user.c", "33", 2 );
+
+   // the same names on another inode
+   set_xattr( core, "/b", "user.b", "bee", 3, 0, 0 );
+   check_xattr( core, "/b", "user.b", "bee", 3 );
+   check_xattr( core, "/a", "user.b", "2", 1 );
+
+   // flags
+   set_xattr( core, "/a", "user.b", "x", 1, XATTR_CREATE, -EEXIST );
+   set_xattr( core, "/a", "user.d", "x", 1, XATTR_REPLACE, -ENOATTR );
+   set_xattr( core, "/a", "user.b", "22", 2, XATTR_REPLACE, 0 );
+   check_xattr( core, "/a", "user.b", "22", 2 );
+   check_xattr( core, "/a", "user.c", "33", 2 );
+
+   // remove from the middle
+   rc = fskit_removexattr( core, "/a", 0, 0, "user.b" );
+   if( rc != 0 ) {
+      fskit_error("fskit_removexattr('/a', 'user.b') rc = %d\n", rc );
+      exit(1);
+   }
+
+   rc = fskit_removexattr( core, "/a", 0, 0, "user.b" );
+   if( rc != -ENOATTR ) {
+      fskit_error("fskit_removexattr('/a', 'user.b') again rc = %d\n", rc );
+      exit(1);
+   }
+
+   check_list( core, "/a", "user.a\0user.c", 14 );
+   check_xattr( core, "/a", "user.b", NULL, 0 );
+   check_xattr( core, "/b", "user.b", "bee", 3 );
+
+   // a large value moves the attributes out of the packed block, and they all survive
+   memset( big, 'z', sizeof(big) );
+   set_xattr( core, "/a", "user.big", big, sizeof(big), 0, 0 );
+
+   check_list( core, "/a", "user.a\0user.big\0user.c", 23 );
+   check_xattr( core, "/a", "user.a", "", 0 );
+   check_xattr( core, "/a", "user.big", big, sizeof(big) );
+   check_xattr( core, "/a", "user.c", "33", 2 );
+
+   set_xattr( core, "/a", "user.c", "x", 1, XATTR_CREATE, -EEXIST );
+
+   // so do many small ones
+   for( int i = 0; i < 20; i++ ) {
+
+      sprintf( name_buf, "user.%02d", i );
+      set_xattr( core, "/b", name_buf, name_buf, strlen(name_buf), XATTR_CREATE, 0 );
+
+      for( int j = 0; j <= i; j++ ) {
+
+         sprintf( name_buf, "user.%02d", j );
+         check_xattr( core, "/b", name_buf, name_buf, strlen(name_buf) );
+      }
+   }
+
+   check_xattr( core, "/b", "user.b", "bee", 3 );
+
+   // clear everything, then start over in a packed block
+   fent = fskit_entry_resolve_path( core, "/b", 0, 0, true, &rc );
+   if( fent == NULL ) {
+      fskit_error("fskit_entry_resolve_path('/b') rc = %d\n", rc );
+      exit(1);
+   }
+
+   fskit_fremovexattr_all( core, fent );
+   fskit_entry_unlock( fent );
+
+   check_list( core, "/b", "", 0 );
+
+   set_xattr( core, "/b", "user.a", "1", 1, XATTR_CREATE, 0 );
+   check_list( core, "/b", "user.a", 7 );
+   check_xattr( core, "/b", "user.a", "1", 1 );
+
+   fskit_test_end( core, &output );
+
+   return 0;
+}